@@ -169,6 +169,9 @@ DECLARE_SIMPLE (activate_export_as);
 COLD
 DECLARE_SIMPLE (activate_export_graph);
 
+COLD
+DECLARE_SIMPLE (activate_profile_graph);
+
 void
 activate_properties (GSimpleAction *action,
                   GVariant      *variant,
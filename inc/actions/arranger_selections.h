@@ -586,14 +586,19 @@ arranger_selections_action_new_edit_automation_function (
  * Wrapper over
  * arranger_selections_action_new_edit() for
  * automation functions.
+ *
+ * @param progress_info Optional progress info to
+ *   update while applying the function. If it gets
+ *   cancelled, no action is created.
  */
 WARN_UNUSED_RESULT
 UndoableAction *
 arranger_selections_action_new_edit_audio_function (
-  ArrangerSelections * sel_before,
-  AudioFunctionType    audio_func_type,
-  const char *         uri,
-  GError **            error);
+  ArrangerSelections *  sel_before,
+  AudioFunctionType     audio_func_type,
+  const char *          uri,
+  GenericProgressInfo * progress_info,
+  GError **             error);
 
 /**
  * Creates a new action for automation autofill.
@@ -810,10 +815,11 @@ arranger_selections_action_perform_edit_automation_function (
 
 bool
 arranger_selections_action_perform_edit_audio_function (
-  ArrangerSelections * sel_before,
-  AudioFunctionType    audio_func_type,
-  const char *         uri,
-  GError **            error);
+  ArrangerSelections *  sel_before,
+  AudioFunctionType     audio_func_type,
+  const char *          uri,
+  GenericProgressInfo * progress_info,
+  GError **             error);
 
 bool
 arranger_selections_action_perform_automation_fill (
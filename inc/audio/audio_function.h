@@ -32,6 +32,8 @@
 
 typedef struct ArrangerSelections ArrangerSelections;
 typedef struct Plugin Plugin;
+typedef struct GenericProgressInfo
+  GenericProgressInfo;
 
 /**
  * @addtogroup audio
@@ -39,6 +41,19 @@ typedef struct Plugin Plugin;
  * @{
  */
 
+/**
+ * Number of frames processed at a time.
+ *
+ * Functions that don't depend on previous audio
+ * (eg, invert, fades) process chunks in parallel.
+ */
+#define AUDIO_FUNCTION_CHUNK_FRAMES 65536
+
+/**
+ * Max number of threads used to process chunks.
+ */
+#define AUDIO_FUNCTION_MAX_THREADS 8
+
 typedef enum AudioFunctionType
 {
   AUDIO_FUNCTION_INVERT,
@@ -132,15 +147,19 @@ audio_function_get_plugin_uri_for_type (
  *   for the unchanged audio material (used in
  *   audio selection actions for the selections
  *   before the change).
+ * @param progress_info Optional progress info to
+ *   update while processing. If it gets cancelled,
+ *   processing stops and an error is returned.
  *
  * @return Non-zero if error.
  */
 int
 audio_function_apply (
-  ArrangerSelections * sel,
-  AudioFunctionType    type,
-  const char *         uri,
-  GError **            error);
+  ArrangerSelections *  sel,
+  AudioFunctionType     type,
+  const char *          uri,
+  GenericProgressInfo * progress_info,
+  GError **             error);
 
 /**
  * @}
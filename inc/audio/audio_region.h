@@ -122,8 +122,11 @@ audio_region_set_clip_id (
  * Replaces the region's frames from \ref
  * start_frames with \ref frames.
  *
- * @param duplicate_clip Whether to duplicate the
- *   clip (eg, when other regions refer to it).
+ * The clip is copied first if other regions play
+ * it, so that only this region is changed.
+ *
+ * @param duplicate_clip Whether to always
+ *   duplicate the clip.
  * @param frames Frames, interleaved.
  */
 void
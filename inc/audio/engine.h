@@ -78,6 +78,8 @@ typedef struct Project Project;
 typedef struct HardwareProcessor HardwareProcessor;
 typedef struct ObjectPool ObjectPool;
 typedef struct MPMCQueue MPMCQueue;
+typedef struct StretchCache StretchCache;
+typedef struct TempoMap TempoMap;
 
 /**
  * @addtogroup audio Audio
@@ -386,6 +388,34 @@ jack_transport_type_strings[] =
     AUDIO_ENGINE_NO_JACK_TRANSPORT    },
 };
 
+/**
+ * Flags for \ref
+ * AudioEngine.tempo_map_rebuild_pending.
+ */
+typedef enum EngineTempoMapRebuildFlags
+{
+  /** The tempo map needs to be rebuilt. */
+  ENGINE_TEMPO_MAP_REBUILD = 1 << 0,
+
+  /** The positions need to be updated based on
+   * their ticks after rebuilding (otherwise based
+   * on their frames). */
+  ENGINE_TEMPO_MAP_REBUILD_FROM_TICKS = 1 << 1,
+} EngineTempoMapRebuildFlags;
+
+/**
+ * A tempo map replaced in
+ * engine_update_tempo_map().
+ */
+typedef struct RetiredTempoMap
+{
+  TempoMap *    map;
+
+  /** \ref AudioEngine.cycle when the map was
+   * replaced. */
+  unsigned long cycle;
+} RetiredTempoMap;
+
 /**
  * Common struct to pass around during processing
  * to avoid repeating the data in function
@@ -451,6 +481,25 @@ typedef struct AudioEngine
   /** Size of MIDI port buffers in bytes. */
   size_t            midi_buf_size;
 
+  /**
+   * Silent buffer of \ref
+   * AudioEngine.block_length frames, shared by
+   * plugins for inputs that have no port.
+   *
+   * Must not be written to.
+   */
+  float *           silent_buf;
+
+  /**
+   * Buffer of \ref AudioEngine.block_length
+   * frames, shared by plugins for outputs that
+   * are discarded.
+   *
+   * Its contents are garbage and must never be
+   * read.
+   */
+  float *           scratch_buf;
+
   /** Sample rate. */
   sample_rate_t     sample_rate;
 
@@ -463,6 +512,41 @@ typedef struct AudioEngine
    */
   double            ticks_per_frame;
 
+  /**
+   * Tempo map for converting positions, rebuilt
+   * by engine_update_tempo_map().
+   *
+   * Must only be read once per cycle or draw, as
+   * it can be swapped in between.
+   */
+  TempoMap *        tempo_map;
+
+  /**
+   * Replaced tempo maps that may still be read
+   * by other threads (eg, the JACK timebase
+   * callback), along with the cycle they were
+   * replaced in (see \ref RetiredTempoMap).
+   *
+   * They are free'd in engine_process_events()
+   * once a full cycle has completed since.
+   */
+  GArray *          retired_tempo_maps;
+
+  /** Lock for \ref retired_tempo_maps. */
+  GMutex            retired_tempo_maps_lock;
+
+  /**
+   * Set when the tempo map needs to be rebuilt by
+   * the GTK thread, since it can't be built
+   * during processing (see \ref
+   * EngineTempoMapRebuildFlags).
+   *
+   * The engine keeps running: the new map, the
+   * frames per tick and the positions are
+   * published together between two cycles.
+   */
+  volatile guint    tempo_map_rebuild_pending;
+
   /** True iff buffer size callback fired. */
   int               buf_size_set;
 
@@ -515,6 +599,10 @@ typedef struct AudioEngine
   /** Audio file pool. */
   AudioPool *       pool;
 
+  /** Background time-stretching of pool
+   * clips. */
+  StretchCache *    stretch_cache;
+
   /**
    * Used during tests to pass input data for
    * recording.
@@ -932,6 +1020,33 @@ engine_resume (
   AudioEngine * self,
   EngineState * state);
 
+/**
+ * Skips processing cycles until
+ * engine_release_processing() is called, and waits
+ * for the current cycle to finish.
+ *
+ * Unlike engine_wait_for_pause(), the transport
+ * keeps its state and no panic is sent, so notes
+ * that are playing continue after the skipped
+ * cycles. This is used for short changes that the
+ * cycle's pre-processing (eg, MIDI input) also
+ * reads, which \ref Router.graph_access does not
+ * cover.
+ *
+ * @return Whether the engine was running, to pass
+ *   to engine_release_processing().
+ */
+NONNULL
+bool
+engine_hold_processing (
+  AudioEngine * self);
+
+NONNULL
+void
+engine_release_processing (
+  AudioEngine * self,
+  bool          held);
+
 /**
  * Waits for n processing cycles to finish.
  *
@@ -979,6 +1094,11 @@ engine_activate (
  * Updates frames per tick based on the time sig,
  * the BPM, and the sample rate
  *
+ * If called during processing kickoff while the
+ * tempo is not automated, the update is deferred
+ * to the GTK thread so that the frames per tick
+ * never disagree with the tempo map.
+ *
  * @param thread_check Whether to throw a warning
  *   if not called from GTK thread.
  * @param update_from_ticks Whether to update the
@@ -994,6 +1114,41 @@ engine_update_frames_per_tick (
   bool                thread_check,
   bool                update_from_ticks);
 
+/**
+ * Rebuilds \ref AudioEngine.tempo_map from the
+ * transport's time signature, the given BPM and
+ * the BPM automation.
+ *
+ * This must only be called from the GTK thread,
+ * during processing kickoff or while the engine
+ * is stopped. During processing kickoff the map
+ * is not built, it is only marked to be rebuilt
+ * by the GTK thread in engine_process_events().
+ *
+ * @param bpm BPM where there is no automation, or
+ *   0 to keep the current one.
+ *
+ * @return Whether the map changed.
+ */
+NONNULL
+bool
+engine_update_tempo_map (
+  AudioEngine * self,
+  bpm_t         bpm);
+
+/**
+ * Rebuilds the tempo map after the BPM automation
+ * may have changed and updates the positions if
+ * the tempo changed.
+ *
+ * Must be called from the GTK thread while the
+ * engine is paused.
+ */
+NONNULL
+void
+engine_update_tempo_automation (
+  AudioEngine * self);
+
 /**
  * GSourceFunc to be added using idle add.
  *
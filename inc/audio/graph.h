@@ -47,6 +47,7 @@
 #include <pthread.h>
 
 #include "audio/graph_node.h"
+#include "utils/thread_affinity.h"
 #include "utils/types.h"
 
 #include "zix/sem.h"
@@ -64,6 +65,10 @@ typedef struct GraphThread GraphThread;
 typedef struct Router Router;
 typedef struct ModulatorMacroProcessor
   ModulatorMacroProcessor;
+typedef struct PortConnection PortConnection;
+typedef struct GraphBufferPlan GraphBufferPlan;
+typedef struct MidiEvents MidiEvents;
+typedef struct ZixRingImpl ZixRing;
 
 /**
  * @addtogroup audio
@@ -79,6 +84,58 @@ typedef struct ModulatorMacroProcessor
 
 #define MAX_GRAPH_THREADS 128
 
+/**
+ * Max number of nodes pushed to the trigger queue
+ * at once.
+ */
+#define GRAPH_TRIGGER_BATCH_SIZE 32
+
+/**
+ * Sources and destinations of a port, along with
+ * any buffers it is missing or that need to grow,
+ * calculated during graph_setup().
+ *
+ * These are swapped with the port's members in
+ * graph_rechain() so that the graph can be set up
+ * without touching anything the processing
+ * threads use. After the swap, this holds the
+ * previous members until they are freed in the
+ * next graph_setup().
+ */
+typedef struct GraphPortConnections
+{
+  Port *            port;
+
+  Port **           srcs;
+  PortConnection ** src_connections;
+  int               num_srcs;
+  size_t            srcs_size;
+
+  Port **           dests;
+  PortConnection ** dest_connections;
+  int               num_dests;
+  size_t            dests_size;
+
+  /** Audio/CV buffer, if it needs to grow. */
+  float *           buf;
+  size_t            buf_size;
+
+  /** Shared buffer to use instead of the port's
+   * own buffer, if any (not owned). */
+  float *           shared_buf;
+
+  /** Event buffer and rings the port does not
+   * have yet, if any. */
+  MidiEvents *      midi_events;
+  ZixRing *         midi_ring;
+  ZixRing *         audio_ring;
+
+  /** Owner plugin and track to cache in the
+   * port, if any. */
+  Plugin *          plugin;
+  Track *           track;
+} GraphPortConnections;
+
 /**
  * Graph.
  */
@@ -152,6 +209,30 @@ typedef struct Graph
   GraphNode **         setup_terminal_nodes;
   size_t               num_setup_terminal_nodes;
 
+  GraphNode *          setup_bpm_node;
+  GraphNode *          setup_beats_per_bar_node;
+  GraphNode *          setup_beat_unit_node;
+
+  /** Port sources/dests for the setup.
+   * key = port, value = GraphPortConnections. */
+  GHashTable *         setup_port_connections;
+
+  /** External out ports for the setup. */
+  GPtrArray *          setup_external_out_ports;
+
+  /** Trigger queue for the setup, if the current
+   * one is too small. */
+  MPMCQueue *          setup_trigger_queue;
+
+  /** Shared port buffers for the setup. */
+  GraphBufferPlan *    setup_buffer_plan;
+
+  /**
+   * Whether a setup is waiting to be swapped in
+   * by graph_rechain().
+   */
+  volatile gint        setup_pending;
+
   /** Dummy member to make lookups work. */
   int                  initial_processor;
 
@@ -161,6 +242,21 @@ typedef struct Graph
   GraphThread *        main_thread;
   gint                 num_threads;
 
+  /** CPU affinity policy, read from the
+   * preferences by graph_start(). */
+  ThreadAffinityPolicy affinity_policy;
+
+  /**
+   * CPUs to place the threads on (see
+   * thread_affinity_get_cpus()).
+   *
+   * Each thread is pinned to a single one of
+   * these if the policy pins threads, otherwise
+   * all threads may run on all of them.
+   */
+  int *                affinity_cpus;
+  int                  num_affinity_cpus;
+
   /**
    * An array of pointers to ports that are exposed
    * to the backend and are outputs.
@@ -170,6 +266,22 @@ typedef struct Graph
    */
   GPtrArray *          external_out_ports;
 
+  /**
+   * Shared port buffers of the current chain, if
+   * any.
+   */
+  GraphBufferPlan *    buffer_plan;
+
+  /**
+   * Whether to let ports with disjoint lifetimes
+   * share buffers when setting up the graph.
+   *
+   * Can be disabled with the
+   * ZRYTHM_NO_BUFFER_SHARING environment
+   * variable.
+   */
+  bool                 share_port_buffers;
+
 } Graph;
 
 void
@@ -255,6 +367,24 @@ graph_get_max_route_playback_latency (
   Graph * graph,
   bool    use_setup_nodes);
 
+/**
+ * Pushes nodes that are ready to be processed to
+ * the trigger queue in one batch and wakes up as
+ * many idle threads as there are nodes left for
+ * them.
+ *
+ * To be called from a graph thread, which is
+ * expected to dequeue and process one of the nodes
+ * itself.
+ */
+HOT
+NONNULL
+void
+graph_push_ready_nodes (
+  Graph *       self,
+  GraphNode **  nodes,
+  size_t        num_nodes);
+
 /* called from a terminal node (from the Graph
  * worked-thread) to indicate it has completed
  * processing.
@@ -274,12 +404,20 @@ graph_update_latencies (
   bool    use_setup_nodes);
 
 /*
- * Adds the graph nodes and connections, then
- * rechains.
+ * Adds the graph nodes and connections to the
+ * setup chain.
+ *
+ * This does not modify anything used by the
+ * processing threads, so it can run while the
+ * graph is processing. When rechaining, the
+ * latencies are calculated here as well so that
+ * graph_rechain() only has to swap the chains.
  *
  * @param drop_unnecessary_ports Drops any ports
  *   that don't connect anywhere.
- * @param rechain Whether to rechain or not. If
+ * @param rechain Whether to allocate the port
+ *   buffers and mark the setup as pending so that
+ *   it can be swapped in by graph_rechain(). If
  *   we are just validating this should be 0.
  */
 void
@@ -288,6 +426,25 @@ graph_setup (
   const int drop_unnecessary_ports,
   const int rechain);
 
+/**
+ * Swaps the pending setup chain with the running
+ * chain.
+ *
+ * This only swaps pointers, so it is
+ * realtime-safe. It must be called between
+ * cycles, while holding the router's graph access
+ * semaphore.
+ *
+ * The previous chain is kept until the next
+ * graph_setup() so that any thread still finishing
+ * the previous cycle can safely access it.
+ */
+HOT
+NONNULL
+void
+graph_rechain (
+  Graph * self);
+
 /**
  * Adds a new connection for the given
  * src and dest ports and validates the graph.
@@ -307,6 +464,37 @@ graph_validate_with_connection (
   const Port * src,
   const Port * dest);
 
+/**
+ * Applies a single port connection change to the
+ * running graph without rebuilding it.
+ *
+ * Only the edge between the nodes of the ports
+ * and the sources/dests of the 2 ports are
+ * updated, and playback latencies are only
+ * recalculated along the affected routes.
+ *
+ * The connection must already be added to or
+ * removed from the port connections manager.
+ * This takes the router's graph access semaphore
+ * while patching.
+ *
+ * @param connected Whether the ports were
+ *   connected (otherwise disconnected).
+ *
+ * @return Whether the change was applied. If
+ *   not, nothing was changed and the graph needs
+ *   to be set up again with graph_setup(), eg
+ *   because a port that was left out of the graph
+ *   is needed now or vice versa.
+ */
+NONNULL
+bool
+graph_update_port_connection (
+  Graph * self,
+  Port *  src,
+  Port *  dest,
+  bool    connected);
+
 /**
  * Starts as many threads as there are cores.
  *
@@ -316,6 +504,16 @@ int
 graph_start (
   Graph * graph);
 
+/**
+ * Returns a newly allocated description of the
+ * CPUs that each thread runs on, one thread per
+ * line.
+ */
+NONNULL
+char *
+graph_get_thread_affinity_str (
+  Graph * self);
+
 /**
  * Returns a new graph.
  */
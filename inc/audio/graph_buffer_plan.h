@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Shared port buffers for the routing graph.
+ */
+
+#ifndef __AUDIO_GRAPH_BUFFER_PLAN_H__
+#define __AUDIO_GRAPH_BUFFER_PLAN_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "utils/types.h"
+
+#include <glib.h>
+
+typedef struct GraphNode GraphNode;
+typedef struct Port Port;
+
+/**
+ * @addtogroup audio
+ *
+ * @{
+ */
+
+/**
+ * Alignment of the shared buffers in bytes (one
+ * cache line).
+ */
+#define GRAPH_BUFFER_PLAN_ALIGNMENT 64
+
+/**
+ * Max number of nodes to visit when looking for
+ * a buffer to reuse.
+ *
+ * Buffers are mostly reused along a channel
+ * strip, so this only needs to cover a few
+ * strips.
+ */
+#define GRAPH_BUFFER_PLAN_MAX_ANCESTORS 256
+
+typedef struct GraphBufferPlanEntry
+  GraphBufferPlanEntry;
+
+/**
+ * A port using a shared buffer.
+ */
+typedef struct GraphBufferPlanEntry
+{
+  Port *                 port;
+
+  /** Node of the port. */
+  GraphNode *            node;
+
+  /** Shared buffer. */
+  float *                buf;
+
+  /** Entry that used the buffer before this
+   * one in each cycle, if any. */
+  GraphBufferPlanEntry * prev;
+
+  /** Entry that uses the buffer after this one
+   * in each cycle, if any. */
+  GraphBufferPlanEntry * next;
+} GraphBufferPlanEntry;
+
+/**
+ * Assignment of audio ports to a small set of
+ * shared buffers, calculated from the graph
+ * during graph_setup().
+ *
+ * A port only needs its buffer from the time its
+ * writer (the port node for inputs, the
+ * processor feeding it for outputs) starts until
+ * the port node and its children have run. The
+ * next port can reuse the buffer if its writer
+ * can only run after all of these, which is the
+ * case if it comes later in the graph. Buffers
+ * are mostly reused along a channel strip (eg,
+ * between the ports of consecutive inserts), so
+ * the working set of a cycle shrinks to roughly
+ * a few buffers per strip being processed in
+ * parallel.
+ *
+ * Each shared buffer is cleared by the writer
+ * node of the port that uses it next (see \ref
+ * GraphNode.shared_bufs), since the engine only
+ * clears buffers at the start of the cycle.
+ *
+ * When a cycle is split (eg, at the loop point),
+ * the data written in previous splits is not
+ * kept, so only the audio ring (written at the
+ * end of the block) may contain stale data for
+ * those frames.
+ *
+ * Only ports whose buffers are solely accessed
+ * by the nodes next to them are shared. Ports
+ * that are read from elsewhere (eg, channel
+ * outputs used by meters, the exporter and the
+ * monitor fader), external ports, CV ports and
+ * terminal ports keep their own buffers.
+ */
+typedef struct GraphBufferPlan
+{
+  /** Cache-aligned memory for all buffers. */
+  float *                pool;
+
+  /** Number of floats in each buffer, including
+   * padding. */
+  size_t                 buf_stride;
+
+  /** Number of shared buffers. */
+  int                    num_bufs;
+
+  /**
+   * Ports using a shared buffer, grouped by the
+   * node that clears their buffer.
+   *
+   * The nodes point to their group.
+   */
+  GraphBufferPlanEntry * entries;
+  int                    num_entries;
+
+  /** Entries by port. */
+  GHashTable *           port_entries;
+} GraphBufferPlan;
+
+/**
+ * Assigns shared buffers to the ports of the
+ * given nodes and points each clearing node to
+ * its entries.
+ *
+ * @param nodes Graph nodes (key = internal
+ *   pointer, value = graph node). The node IDs
+ *   must be their index.
+ * @param buf_size Number of floats needed in each
+ *   buffer.
+ */
+NONNULL
+GraphBufferPlan *
+graph_buffer_plan_new (
+  GHashTable * nodes,
+  size_t       buf_size);
+
+/**
+ * Returns the shared buffer of the port, or NULL
+ * if the port keeps its own buffer.
+ */
+NONNULL
+float *
+graph_buffer_plan_get_buf (
+  GraphBufferPlan * self,
+  const Port *      port);
+
+/**
+ * Returns whether the plan stays valid after
+ * adding or removing an edge between 2 port
+ * nodes.
+ *
+ * Adding an edge is only a problem if the source
+ * port's buffer is reused after it, since the new
+ * child may run too late. Removing an edge is only
+ * a problem if the reuse of a buffer relied on the
+ * ordering that the edge provided.
+ */
+NONNULL
+bool
+graph_buffer_plan_allows_edge_change (
+  GraphBufferPlan * self,
+  GraphNode *       src_node,
+  GraphNode *       dest_node,
+  bool              connected);
+
+NONNULL
+void
+graph_buffer_plan_free (
+  GraphBufferPlan * self);
+
+/**
+ * @}
+ */
+
+#endif
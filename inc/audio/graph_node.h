@@ -64,6 +64,8 @@ typedef struct ModulatorMacroProcessor
   ModulatorMacroProcessor;
 typedef struct EngineProcessTimeInfo
   EngineProcessTimeInfo;
+typedef struct GraphBufferPlanEntry
+  GraphBufferPlanEntry;
 
 /**
  * @addtogroup audio
@@ -172,6 +174,16 @@ typedef struct GraphNode
   /** The route's playback latency so far. */
   nframes_t     route_playback_latency;
 
+  /**
+   * Shared port buffers that start being used
+   * by this node and must be cleared before it is
+   * processed.
+   *
+   * These are owned by the GraphBufferPlan.
+   */
+  GraphBufferPlanEntry * shared_bufs;
+  int                    num_shared_bufs;
+
   GraphNodeType type;
 } GraphNode;
 
@@ -256,6 +268,18 @@ graph_node_connect (
   GraphNode * from,
   GraphNode * to);
 
+/**
+ * Removes the edge between the given nodes, if
+ * any.
+ *
+ * The nodes are marked as terminal/initial if
+ * they no longer have children/parents.
+ */
+void
+graph_node_disconnect (
+  GraphNode * from,
+  GraphNode * to);
+
 GraphNode *
 graph_node_new (
   Graph * graph,
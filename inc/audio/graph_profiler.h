@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Per-node profiler for the routing graph.
+ */
+
+#ifndef __AUDIO_GRAPH_PROFILER_H__
+#define __AUDIO_GRAPH_PROFILER_H__
+
+#include <stdbool.h>
+
+#include "utils/types.h"
+
+#include <glib.h>
+
+#include "zix/ring.h"
+
+typedef struct Graph Graph;
+typedef struct GraphNode GraphNode;
+
+/**
+ * @addtogroup audio
+ *
+ * @{
+ */
+
+/**
+ * Max samples to keep per thread.
+ */
+#define GRAPH_PROFILER_MAX_SAMPLES_PER_THREAD \
+  (1 << 16)
+
+/**
+ * Number of cycles to profile when not
+ * specified.
+ */
+#define GRAPH_PROFILER_DEFAULT_NUM_CYCLES 256
+
+/**
+ * Thread slot used for threads that are not
+ * graph threads (eg, the thread that kicks off
+ * the cycle).
+ */
+#define GRAPH_PROFILER_OTHER_THREAD 0
+
+/**
+ * A single run of a node.
+ */
+typedef struct GraphProfilerSample
+{
+  /** Node (only used as a key, never
+   * dereferenced after recording). */
+  const GraphNode * node;
+
+  /** Start time in nanoseconds. */
+  gint64            start;
+
+  /** End time in nanoseconds. */
+  gint64            end;
+
+  /** Cycle index, starting from 0. */
+  int               cycle;
+
+  /**
+   * Thread slot.
+   *
+   * This is \ref GRAPH_PROFILER_OTHER_THREAD or
+   * the graph thread ID + 2 (the main graph
+   * thread has ID -1).
+   */
+  int               thread;
+} GraphProfilerSample;
+
+/**
+ * Aggregated timings of a node, in nanoseconds.
+ */
+typedef struct GraphProfilerNodeStats
+{
+  /** Node name (owned by the profiler). */
+  const char * name;
+
+  int          num_samples;
+  gint64       min;
+  gint64       avg;
+  gint64       p99;
+  gint64       max;
+} GraphProfilerNodeStats;
+
+/**
+ * Records how long each graph node takes to
+ * process over a number of cycles.
+ *
+ * Each thread writes to its own lock-free ring so
+ * recording is real-time safe. The rings are
+ * drained from a non-realtime thread when the
+ * results are requested.
+ *
+ * A profile only covers a single graph: rebuilding
+ * the graph stops the current profile.
+ */
+typedef struct GraphProfiler
+{
+  /** Whether recording is in progress. */
+  volatile gint  enabled;
+
+  /** Whether a profile was started since the
+   * last reset. */
+  bool           started;
+
+  /** Current cycle, starting from 0. */
+  volatile gint  cycle;
+
+  /** Number of cycles to record. */
+  int            num_cycles;
+
+  /** One ring per thread slot. */
+  ZixRing **     rings;
+  int            num_rings;
+
+  /** Number of samples dropped because a ring
+   * was full. */
+  volatile gint  num_dropped;
+
+  /** Node names at the time the profile was
+   * started (key = node, value = name). */
+  GHashTable *   node_names;
+
+  /** Samples collected from the rings. */
+  GArray *       samples;
+} GraphProfiler;
+
+GraphProfiler *
+graph_profiler_new (void);
+
+/**
+ * Sets the thread slot of the calling thread.
+ *
+ * To be called once by each graph thread before
+ * processing.
+ *
+ * @param graph_thread_id The GraphThread ID.
+ */
+void
+graph_profiler_register_thread (
+  int graph_thread_id);
+
+/**
+ * Starts recording the next \ref num_cycles
+ * cycles of the given graph.
+ *
+ * Must be called while holding the router's graph
+ * access semaphore.
+ */
+NONNULL
+void
+graph_profiler_start (
+  GraphProfiler * self,
+  Graph *         graph,
+  int             num_cycles);
+
+/**
+ * Stops recording.
+ *
+ * Already recorded samples are kept.
+ */
+NONNULL
+void
+graph_profiler_stop (
+  GraphProfiler * self);
+
+/**
+ * To be called at the start of each cycle.
+ *
+ * Stops recording after the requested number of
+ * cycles.
+ */
+NONNULL
+HOT
+void
+graph_profiler_begin_cycle (
+  GraphProfiler * self);
+
+/**
+ * Returns whether node runs should be recorded.
+ */
+HOT
+static inline bool
+graph_profiler_is_recording (
+  GraphProfiler * self)
+{
+  return
+    self && g_atomic_int_get (&self->enabled);
+}
+
+/**
+ * Returns whether a started profile has
+ * finished recording.
+ */
+NONNULL
+bool
+graph_profiler_is_finished (
+  GraphProfiler * self);
+
+/**
+ * Returns the current time in nanoseconds.
+ */
+HOT
+gint64
+graph_profiler_get_time (void);
+
+/**
+ * Records a node run.
+ *
+ * This is realtime-safe.
+ */
+NONNULL
+HOT
+void
+graph_profiler_record (
+  GraphProfiler *   self,
+  const GraphNode * node,
+  gint64            start,
+  gint64            end);
+
+/**
+ * Returns the aggregated timings of each node,
+ * slowest (by average) first.
+ *
+ * Must be free'd with free().
+ */
+NONNULL
+GraphProfilerNodeStats *
+graph_profiler_get_node_stats (
+  GraphProfiler * self,
+  int *           num_stats);
+
+/**
+ * Prints the aggregated timings.
+ */
+NONNULL
+void
+graph_profiler_print (
+  GraphProfiler * self);
+
+/**
+ * Exports the recorded samples in the Chrome
+ * trace event format, which can be opened in
+ * chrome://tracing or Perfetto.
+ *
+ * @return Whether successful.
+ */
+NONNULL_ARGS (1, 2)
+bool
+graph_profiler_export_chrome_trace (
+  GraphProfiler * self,
+  const char *    path,
+  GError **       error);
+
+NONNULL
+void
+graph_profiler_free (
+  GraphProfiler * self);
+
+/**
+ * @}
+ */
+
+#endif
@@ -87,6 +87,13 @@ typedef struct GraphThread
   /** Pointer back to the graph. */
   Graph *           graph;
 
+  /**
+   * CPUs the thread is allowed to run on, as
+   * reported by the OS once the thread started
+   * (eg, "2-3"), or empty if unknown.
+   */
+  char              affinity[120];
+
 #ifdef HAVE_LSP_DSP
   /** LSP DSP context. */
   lsp_dsp_context_t lsp_ctx;
@@ -31,6 +31,7 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "audio/midi.h"
 #include "utils/types.h"
 #include "zix/sem.h"
 
@@ -48,8 +49,22 @@ typedef struct ChordDescriptor ChordDescriptor;
  * @{
  */
 
-/** Max events to hold in queues. */
-#define MAX_MIDI_EVENTS 2560
+/** Max events a buffer can grow to. */
+#define MAX_MIDI_EVENTS 10240
+
+/** Initial capacity of the buffers (the size
+ * they had when they were fixed). */
+#define MIDI_EVENTS_INITIAL_CAPACITY 2560
+
+/**
+ * Extra slots in each buffer that only note offs
+ * can use: one for each channel and pitch.
+ *
+ * A buffer that is full can still take the note
+ * offs of the notes that are playing, so it never
+ * leaves hanging notes.
+ */
+#define MIDI_EVENTS_NOTE_OFF_HEADROOM (16 * 128)
 
 /**
  * Type of MIDI event.
@@ -70,79 +85,136 @@ typedef enum MidiEventType
 
 /**
  * Backend-agnostic MIDI event descriptor.
+ *
+ * Only the raw MIDI data is stored. Use the
+ * midi_event_get_*() functions for the decoded
+ * values.
  */
 typedef struct MidiEvent
 {
-  /** The values below will be filled in
-   * depending on what event this is. */
-  MidiEventType  type;
-
-  /** -8192 to 8191. */
-  int            pitchbend;
-
-  /** The controller, for control events. */
-  midi_byte_t    controller;
-
-  /** Control value (also used for modulation
-   * wheel (0 ~ 127). */
-  midi_byte_t    control;
-
-  /** MIDI channel, starting from 1. */
-  midi_byte_t    channel;
-
-  /** Note value (0 ~ 127). */
-  midi_byte_t    note_pitch;
-
-  /** Velocity (0 ~ 127). */
-  midi_byte_t    velocity;
-
   /** Time of the MIDI event, in frames from the
    * start of the current cycle. */
   midi_time_t    time;
 
-  /** Time using g_get_monotonic_time (). */
-  gint64         systime;
-
   /** Raw MIDI data. */
   midi_byte_t    raw_buffer[3];
 
-  size_t         raw_buffer_sz;
+  uint8_t        raw_buffer_sz;
 
 } MidiEvent;
 
 typedef struct MidiEvents MidiEvents;
 typedef struct Port Port;
 
+/**
+ * Double-buffered queue for MidiEvents.
+ *
+ * Producers write to the buffer selected by \ref
+ * state without locking and the engine swaps the
+ * buffers in midi_events_dequeue(), then merges
+ * the events of the old buffer into the main
+ * events.
+ *
+ * A queue never grows. A larger queue is
+ * published instead and this one is freed once no
+ * producer can be using it anymore.
+ */
+typedef struct MidiEventsQueue
+{
+  /** The two buffers, part of a single
+   * allocation starting at the first buffer. */
+  MidiEvent *   events[2];
+
+  /** Number of events each buffer can hold, not
+   * counting \ref MIDI_EVENTS_NOTE_OFF_HEADROOM. */
+  int           capacity;
+
+  /**
+   * Queue state, packed into a single integer so
+   * that it can be updated atomically.
+   *
+   * Holds the index of the buffer being written to,
+   * the number of slots reserved in it and the
+   * number of slots that have been fully written.
+   */
+  volatile gint state;
+} MidiEventsQueue;
+
 /**
  * Container for passing midi events through ports.
  * This should be passed in the data field of MIDI Ports
+ *
+ * When an event does not fit it is dropped and
+ * counted, and the buffers are grown later
+ * between cycles (see
+ * midi_events_grow_if_dropped()). Note offs are
+ * never dropped, see \ref
+ * MIDI_EVENTS_NOTE_OFF_HEADROOM.
  */
 typedef struct MidiEvents
 {
   /** Event count. */
   volatile int num_events;
 
-  /** Events to use in this cycle. */
-  MidiEvent  events[MAX_MIDI_EVENTS];
+  /** Events to use in this cycle, sorted by
+   * time. */
+  MidiEvent *  events;
+
+  /** Number of events \ref events can hold, not
+   * counting \ref MIDI_EVENTS_NOTE_OFF_HEADROOM. */
+  int          capacity;
 
   /**
    * For queueing events from the GUI or from ALSA
    * at random times, since they run in different
    * threads.
    *
-   * Engine will copy them to the
-   * original MIDI events when ready to be processed
-   *
-   * Also has other uses.
+   * Replaced atomically when grown.
    */
-  MidiEvent  queued_events[MAX_MIDI_EVENTS];
-  volatile int num_queued_events;
+  MidiEventsQueue * queue;
 
-  /** Semaphore for exclusive read/write. */
-  ZixSem     access_sem;
+  /** Number of threads currently queueing
+   * events, used to know when a replaced \ref
+   * queue can be freed. */
+  volatile gint num_queue_writers;
+
+  /** Events dropped because \ref events was
+   * full, since the last time it was grown. */
+  volatile gint num_dropped;
+
+  /** Events dropped because the queue was full,
+   * since the last time it was grown. */
+  volatile gint num_queue_dropped;
+
+  /** Number of queued events that
+   * midi_events_dequeue() left for the next cycle.
+   *
+   * Only used by the engine thread. */
+  int          num_deferred;
+
+  /** Number of queued events that
+   * midi_events_clear() dropped while another
+   * thread was queueing, to skip in the next
+   * midi_events_dequeue().
+   *
+   * Only used by the engine thread. */
+  int          num_discarded;
 
 } MidiEvents;
 
+/**
+ * A MIDI event with the time it was processed,
+ * used for passing events to the UI through port
+ * ring buffers.
+ */
+typedef struct MidiRingEvent
+{
+  MidiEvent      ev;
+
+  /** Time using g_get_monotonic_time (). */
+  gint64         systime;
+} MidiRingEvent;
+
 /**
  * Used by Windows MME and RtMidi when adding events
  * to the ring.
@@ -166,6 +238,152 @@ midi_events_init (
 MidiEvents *
 midi_events_new (void);
 
+/**
+ * Grows the buffers so that the main events and
+ * each queue buffer can hold at least the given
+ * number of events (up to \ref MAX_MIDI_EVENTS).
+ *
+ * Other threads may keep queueing events, but
+ * this must not be called while the events are
+ * being processed.
+ */
+NONNULL
+void
+midi_events_reserve (
+  MidiEvents * self,
+  int          capacity);
+
+/**
+ * Doubles the capacity of the buffers that
+ * dropped events since they were last grown.
+ *
+ * Other threads may keep queueing events, but
+ * this must not be called while the events are
+ * being processed.
+ *
+ * @return Whether any buffer was grown.
+ */
+NONNULL
+bool
+midi_events_grow_if_dropped (
+  MidiEvents * self);
+
+/**
+ * Returns whether any MidiEvents dropped events
+ * since the last call, and resets the flag.
+ *
+ * Used to find out when to call
+ * midi_events_grow_if_dropped() without polling
+ * every buffer.
+ */
+bool
+midi_events_get_and_clear_overflow (void);
+
+/**
+ * Returns the memory used by the MidiEvents, in
+ * bytes.
+ */
+NONNULL
+size_t
+midi_events_get_memory_size (
+  const MidiEvents * self);
+
+/**
+ * Returns the type of the event.
+ */
+static inline MidiEventType
+midi_event_get_type (
+  const MidiEvent * ev)
+{
+  switch (ev->raw_buffer[0] & 0xf0)
+    {
+    case MIDI_CH1_NOTE_ON:
+      return MIDI_EVENT_TYPE_NOTE_ON;
+    case MIDI_CH1_NOTE_OFF:
+      return MIDI_EVENT_TYPE_NOTE_OFF;
+    case MIDI_CH1_PITCH_WHEEL_RANGE:
+      return MIDI_EVENT_TYPE_PITCHBEND;
+    case MIDI_CH1_CTRL_CHANGE:
+      return
+        ev->raw_buffer[1] == MIDI_ALL_NOTES_OFF ?
+          MIDI_EVENT_TYPE_ALL_NOTES_OFF :
+          MIDI_EVENT_TYPE_CONTROLLER;
+    default:
+      return MIDI_EVENT_TYPE_RAW;
+    }
+}
+
+/**
+ * Returns the MIDI channel starting from 1, or 0
+ * for system messages.
+ */
+static inline midi_byte_t
+midi_event_get_channel (
+  const MidiEvent * ev)
+{
+  if ((ev->raw_buffer[0] & 0xf0) ==
+        MIDI_SYSTEM_MESSAGE)
+    return 0;
+
+  return
+    (midi_byte_t) ((ev->raw_buffer[0] & 0xf) + 1);
+}
+
+/**
+ * Returns the note value (0 ~ 127) of note
+ * events.
+ */
+static inline midi_byte_t
+midi_event_get_note_pitch (
+  const MidiEvent * ev)
+{
+  return ev->raw_buffer[1];
+}
+
+/**
+ * Returns the velocity (0 ~ 127) of note events.
+ */
+static inline midi_byte_t
+midi_event_get_velocity (
+  const MidiEvent * ev)
+{
+  return ev->raw_buffer[2];
+}
+
+/**
+ * Returns the controller of control events.
+ */
+static inline midi_byte_t
+midi_event_get_controller (
+  const MidiEvent * ev)
+{
+  return ev->raw_buffer[1];
+}
+
+/**
+ * Returns the control value (0 ~ 127) of control
+ * events.
+ */
+static inline midi_byte_t
+midi_event_get_control (
+  const MidiEvent * ev)
+{
+  return ev->raw_buffer[2];
+}
+
+/**
+ * Returns the pitchbend value (-8192 to 8191) of
+ * pitchbend events.
+ */
+static inline int
+midi_event_get_pitchbend (
+  const MidiEvent * ev)
+{
+  return
+    (((ev->raw_buffer[2] & 0x7f) << 7) |
+       (ev->raw_buffer[1] & 0x7f)) - 8192;
+}
+
 /**
  * Copies the members from one MidiEvent to another.
  */
@@ -391,6 +609,10 @@ midi_events_panic (
 /**
  * Clears midi events.
  *
+ * Queued events must only be cleared from the
+ * engine thread. This never waits for other
+ * threads.
+ *
  * @param queued Clear queued events instead.
  */
 void
@@ -401,8 +623,8 @@ midi_events_clear (
 /**
  * Clears duplicates.
  *
- * @param queued Clear duplicates from queued events
- * instead.
+ * @param queued Not supported, queued events are
+ *   de-duplicated when dequeued.
  */
 void
 midi_events_clear_duplicates (
@@ -410,32 +632,29 @@ midi_events_clear_duplicates (
   const int    queued);
 
 /**
- * Copies the queue contents to the original struct
+ * Moves the queued events to the main events.
+ *
+ * The queue buffers are swapped and the events of
+ * the old buffer are merged into the main events
+ * sorted by time, without duplicates.
+ *
+ * Only other threads queue events. The engine
+ * thread writes its own events (eg, from regions)
+ * directly to the main events after calling this.
+ *
+ * This never blocks: if another thread is in the
+ * middle of queueing an event, the queued events
+ * are left for the next cycle. They are then
+ * moved to the start of that cycle since their
+ * times refer to the cycle they were meant for.
+ *
+ * To be called from the engine thread only.
  */
+NONNULL
 void
 midi_events_dequeue (
   MidiEvents * midi_events);
 
-/**
- * Returns if a note on event for the given note
- * exists in the given events.
- */
-int
-midi_events_check_for_note_on (
-  MidiEvents * midi_events,
-  int          note,
-  int          queued);
-
-/**
- * Deletes the midi event with a note on signal
- * from the queue, and returns if it deleted or not.
- */
-int
-midi_events_delete_note_on (
-  MidiEvents * midi_events,
-  int          note,
-  int          queued);
-
 #ifdef HAVE_JACK
 /**
  * Writes the events to the given JACK buffer.
@@ -448,6 +667,9 @@ midi_events_copy_to_jack (
 
 /**
  * Sorts the MidiEvents by time.
+ *
+ * @param queued Not supported, queued events are
+ *   sorted when dequeued.
  */
 void
 midi_events_sort (
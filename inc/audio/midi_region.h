@@ -148,10 +148,11 @@ midi_region_pop_unended_note (
   int       pitch);
 
 /**
- * Fills MIDI event queue from the region.
+ * Fills MIDI events from the region.
  *
- * The events are dequeued right after the call to
- * this function.
+ * The events are written directly to the main
+ * events, sorted by time, so this must only be
+ * called from the engine thread.
  *
  * @note The caller already splits calls to this
  *   function at each sub-loop inside the region,
@@ -210,6 +210,14 @@ typedef struct Port
    */
   float *             buf;
 
+  /**
+   * The port's own buffer while \ref Port.buf
+   * points to a buffer shared with other ports.
+   *
+   * @see GraphBufferPlan.
+   */
+  float *             own_buf;
+
   /**
    * Contains raw MIDI data (MIDI ports only)
    */
@@ -726,6 +734,32 @@ void
 port_allocate_bufs (
   Port * self);
 
+/**
+ * Creates any buffers used during DSP that the
+ * port doesn't have yet, without attaching them
+ * to the port.
+ *
+ * @return The size the audio buffer needs to
+ *   have, in frames, or 0 if the current one is
+ *   large enough.
+ */
+NONNULL
+size_t
+port_create_missing_bufs (
+  const Port *  self,
+  MidiEvents ** midi_events,
+  ZixRing **    midi_ring,
+  ZixRing **    audio_ring);
+
+/**
+ * Points \ref Port.buf back to the port's own
+ * buffer if it was using a shared buffer.
+ */
+NONNULL
+void
+port_restore_own_buf (
+  Port * self);
+
 /**
  * Frees buffers.
  *
@@ -30,6 +30,8 @@
 
 #include "utils/yaml.h"
 
+typedef struct MusicalTime MusicalTime;
+
 /**
  * @addtogroup audio
  *
@@ -497,6 +499,25 @@ void
 position_change_sign (
   Position * pos);
 
+/**
+ * Splits the position into bars, beats,
+ * sixteenths and ticks.
+ *
+ * This is cheaper than calling
+ * position_get_bars(), position_get_beats(),
+ * etc. separately.
+ *
+ * @param start_at_one Start at 1 or -1 instead of
+ *   0.
+ */
+NONNULL
+HOT
+void
+position_get_musical_time (
+  const Position * pos,
+  bool             start_at_one,
+  MusicalTime *    time);
+
 /**
  * Gets the bars of the position.
  *
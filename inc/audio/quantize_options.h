@@ -47,8 +47,6 @@
 #define QUANTIZE_OPTIONS_EDITOR \
   (PROJECT->quantize_opts_editor)
 
-#define MAX_SNAP_POINTS 120096
-
 typedef struct QuantizeOptions
 {
   int              schema_version;
@@ -75,18 +73,6 @@ typedef struct QuantizeOptions
 
   /** Number of ticks for randomization. */
   double           rand_ticks;
-
-  /**
-   * Quantize points.
-   *
-   * These only take into account note_length,
-   * note_type and swing. They don't take into
-   * account the amount % or randomization ticks.
-   *
-   * Not to be serialized.
-   */
-  Position         q_points[MAX_SNAP_POINTS];
-  int              num_q_points;
 } QuantizeOptions;
 
 static const cyaml_schema_field_t
@@ -124,13 +110,6 @@ quantize_options_init (
   QuantizeOptions * self,
   NoteLength        note_length);
 
-/**
- * Updates snap points.
- */
-void
-quantize_options_update_quantize_points (
-  QuantizeOptions * self);
-
 float
 quantize_options_get_swing (
   QuantizeOptions * self);
@@ -500,6 +500,9 @@ region_gen_name (
  * This should be called right after changing the
  * region's size.
  *
+ * Audio is stretched in the background (see
+ * StretchCache).
+ *
  * @param ratio The ratio to stretch by.
  */
 NONNULL
@@ -49,6 +49,7 @@
 #include <pthread.h>
 
 #include "audio/engine.h"
+#include "audio/time_info_snapshot.h"
 #include "utils/types.h"
 
 #include "zix/ring.h"
@@ -67,6 +68,7 @@ typedef struct Track Track;
 typedef struct Plugin Plugin;
 typedef struct Position Position;
 typedef struct ControlPortChange ControlPortChange;
+typedef struct GraphProfiler GraphProfiler;
 typedef struct EngineProcessTimeInfo
   EngineProcessTimeInfo;
 
@@ -109,6 +111,25 @@ typedef struct Router
    * for BPM/time signature changes. */
   ZixRing *             ctrl_port_change_queue;
 
+  /** Per-node profiler. */
+  GraphProfiler *       profiler;
+
+  /**
+   * Musical time at the start of the current
+   * cycle and, if the loop point is met during
+   * the cycle, at the loop start.
+   *
+   * Only valid on the processing threads while
+   * \ref callback_in_progress is true (see
+   * router_get_time_info()).
+   */
+  TimeInfoSnapshot      time_infos[2];
+  int                   num_time_infos;
+
+  /** Forge used to build the LV2 positions in
+   * \ref time_infos. */
+  LV2_Atom_Forge        time_info_forge;
+
 } Router;
 
 Router *
@@ -124,6 +145,24 @@ router_recalc_graph (
   Router * self,
   bool     soft);
 
+/**
+ * Updates the graph after the given ports were
+ * connected or disconnected.
+ *
+ * The running graph is patched in place if
+ * possible, otherwise it is recalculated.
+ *
+ * @param connected Whether the ports were
+ *   connected (otherwise disconnected).
+ */
+NONNULL
+void
+router_update_port_connection (
+  Router * self,
+  Port *   src,
+  Port *   dest,
+  bool     connected);
+
 /**
  * Starts a new cycle.
  */
@@ -132,6 +171,40 @@ router_start_cycle (
   Router *              self,
   EngineProcessTimeInfo time_nfo);
 
+/**
+ * Returns the musical time at the given position
+ * for plugins.
+ *
+ * This returns the snapshot computed at the start
+ * of the cycle when called from a processing
+ * thread for a position it was computed for
+ * (which is the case unless the plugin is latency
+ * compensated). Otherwise, @p tmp is filled in
+ * and returned.
+ *
+ * This is realtime-safe.
+ */
+NONNULL
+HOT
+const TimeInfoSnapshot *
+router_get_time_info (
+  Router *           self,
+  long               g_start_frames,
+  TimeInfoSnapshot * tmp);
+
+/**
+ * Starts profiling the next \ref num_cycles
+ * cycles.
+ *
+ * The results can be obtained from \ref
+ * Router.profiler once
+ * graph_profiler_is_finished() returns true.
+ */
+void
+router_start_profiling (
+  Router * self,
+  int      num_cycles);
+
 /**
  * Returns the max playback latency of the trigger
  * nodes.
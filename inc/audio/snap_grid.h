@@ -50,7 +50,6 @@
 /* if any snapping is enabled */
 #define SNAP_GRID_ANY_SNAP(sg) \
   (sg->snap_to_grid || sg->snap_to_events)
-#define SNAP_GRID_DEFAULT_MAX_BAR 10000
 
 typedef enum NoteLength
 {
@@ -151,17 +150,6 @@ typedef struct SnapGrid
    * See NoteLengthType.
    */
   NoteLengthType   length_type;
-
-  /**
-   * Snap points to be used by the grid and by
-   * position
-   * to calculate previous/next snap point.
-   *
-   * Cache.
-   */
-  Position *       snap_points;
-  int              num_snap_points;
-  size_t           snap_points_size;
 } SnapGrid;
 
 static const cyaml_strval_t
@@ -262,24 +250,12 @@ snap_grid_get_ticks_from_length_and_type (
   NoteLength length,
   NoteType   type);
 
-/**
- * Updates snap points.
- */
-void
-snap_grid_update_snap_points (
-  SnapGrid * self,
-  int        max_bars);
-
-#define snap_grid_update_snap_points_default(sg) \
-  snap_grid_update_snap_points ( \
-    sg, SNAP_GRID_DEFAULT_MAX_BAR)
-
 /**
  * Gets a snap point's length in ticks.
  */
 int
 snap_grid_get_snap_ticks (
-  SnapGrid * self);
+  const SnapGrid * self);
 
 /**
  * Gets a the default length in ticks.
@@ -300,22 +276,33 @@ snap_grid_stringize (
   NoteType   note_type);
 
 /**
- * Returns the next or previous SnapGrid point.
+ * Gets the next or previous grid point.
  *
- * Must not be free'd.
+ * Grid points are calculated from the snap length,
+ * so this takes constant time regardless of the
+ * project length.
  *
  * @param self Snap grid to search in.
- * @param pos Position to search for.
- * @param return_prev 1 to return the previous
- * element or 0 to return the next.
+ * @param pos Position to search for. Must be
+ *   positive.
+ * @param return_prev True to return the previous
+ *   point or false to return the next.
+ * @param include_equal Whether to return \ref pos
+ *   itself if it is a grid point.
+ * @param ret_pos Position to set. Will be set to
+ *   \ref pos if no point was found.
+ *
+ * @return Whether a point was found.
  */
-PURE
+HOT
 NONNULL
-Position *
+bool
 snap_grid_get_nearby_snap_point (
   const SnapGrid * const self,
   const Position *       pos,
-  const int              return_prev);
+  const bool             return_prev,
+  const bool             include_equal,
+  Position *             ret_pos);
 
 SnapGrid *
 snap_grid_clone (
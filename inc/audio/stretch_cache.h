@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Background time-stretching of audio clips.
+ */
+
+#ifndef __AUDIO_STRETCH_CACHE_H__
+#define __AUDIO_STRETCH_CACHE_H__
+
+#include <stdbool.h>
+
+#include "audio/region_identifier.h"
+#include "utils/audio.h"
+#include "utils/types.h"
+
+#include <glib.h>
+
+typedef struct ZRegion ZRegion;
+
+/**
+ * @addtogroup audio
+ *
+ * @{
+ */
+
+#define STRETCH_CACHE (AUDIO_ENGINE->stretch_cache)
+
+/**
+ * Max number of stretch jobs running in
+ * parallel.
+ */
+#define STRETCH_CACHE_MAX_THREADS 4
+
+/**
+ * Ratios closer than this are considered equal.
+ */
+#define STRETCH_CACHE_RATIO_EPSILON 0.000001
+
+typedef enum StretchCacheEntryState
+{
+  /** Waiting for or being processed by a
+   * worker. */
+  STRETCH_CACHE_ENTRY_PENDING,
+
+  /** Stretched by a worker but not added to the
+   * pool yet. */
+  STRETCH_CACHE_ENTRY_STRETCHED,
+
+  /** The stretched clip is in the pool. */
+  STRETCH_CACHE_ENTRY_READY,
+
+  /** Stretching failed. */
+  STRETCH_CACHE_ENTRY_FAILED,
+} StretchCacheEntryState;
+
+/**
+ * A region waiting for a stretch job.
+ *
+ * Regions are identified by the object itself
+ * rather than by their identifier, since the
+ * identifier of another region can become equal
+ * to it after a move, delete or undo.
+ */
+typedef struct StretchCacheWaitingRegion
+{
+  /** The region (not owned). It may have been
+   * free'd, so it is only compared against the
+   * regions in the project. */
+  ZRegion *        region;
+
+  /** Pool ID of the clip the region was using,
+   * to check that it was not switched to another
+   * clip in the meantime. */
+  int              clip_id;
+} StretchCacheWaitingRegion;
+
+/**
+ * A clip stretched by a given ratio.
+ */
+typedef struct StretchCacheEntry
+{
+  /** Pool ID of the clip that was stretched (never
+   * a clip created by the cache). */
+  int              base_clip_id;
+
+  /** Time ratio relative to the base clip. */
+  double           ratio;
+
+  /** Pool ID of the stretched clip, or -1 if not
+   * ready. */
+  int              clip_id;
+
+  /** StretchCacheEntryState. */
+  volatile gint    state;
+
+  /** Copy of the base clip's frames for the
+   * worker (interleaved). */
+  float *          src_frames;
+  long             src_num_frames;
+  channels_t       channels;
+  sample_rate_t    samplerate;
+
+  /** Name and bit depth of the base clip. */
+  char *           name;
+  BitDepth         bit_depth;
+
+  /** Stretched frames (interleaved), until added
+   * to the pool. */
+  float *          frames;
+  long             num_frames;
+
+  /** Regions to switch to the stretched clip when
+   * it is ready (StretchCacheWaitingRegion). */
+  GArray *         regions;
+} StretchCacheEntry;
+
+/**
+ * Time-stretches audio clips on worker threads and
+ * keeps the results so that switching back to a
+ * previous ratio (eg, when toggling between 2
+ * tempos) is instant.
+ *
+ * Regions keep playing their current clip until
+ * the stretched one is ready, at which point they
+ * are switched to it from the main thread.
+ *
+ * Results are keyed by the clip they were
+ * originally stretched from and the total ratio, so
+ * stretching a stretched clip reuses the original
+ * audio instead of stretching it again.
+ */
+typedef struct StretchCache
+{
+  /** Entries (StretchCacheEntry). */
+  GPtrArray *      entries;
+
+  /** Worker threads. */
+  GThreadPool *    thread_pool;
+
+  /** Timeout for applying finished jobs. */
+  guint            source_id;
+} StretchCache;
+
+/**
+ * Creates the cache and starts the timeout that
+ * applies finished jobs.
+ *
+ * Must be called from the GTK thread.
+ */
+StretchCache *
+stretch_cache_new (void);
+
+/**
+ * Stretches the audio of the region by the given
+ * ratio.
+ *
+ * If the result is cached, the region is switched
+ * to it immediately, otherwise a job is started
+ * and the region keeps using its current clip
+ * until the job is finished.
+ *
+ * Must be called from the GTK thread.
+ *
+ * @return Whether the region was switched
+ *   immediately.
+ */
+NONNULL
+bool
+stretch_cache_stretch_region (
+  StretchCache * self,
+  ZRegion *      region,
+  double         ratio);
+
+/**
+ * Adds the clips of finished jobs to the pool and
+ * switches the waiting regions to them.
+ *
+ * Called periodically from the GTK thread. If the
+ * engine is running, this is done between
+ * cycles.
+ *
+ * @return G_SOURCE_CONTINUE.
+ */
+NONNULL
+int
+stretch_cache_process_finished (
+  StretchCache * self);
+
+/**
+ * Waits for all jobs to finish and applies them.
+ *
+ * Used in tests.
+ */
+NONNULL
+void
+stretch_cache_wait (
+  StretchCache * self);
+
+/**
+ * Forgets any entries that refer to the given
+ * pool clip.
+ *
+ * To be called when the clip is removed from the
+ * pool.
+ */
+NONNULL
+void
+stretch_cache_remove_clip (
+  StretchCache * self,
+  int            clip_id);
+
+/**
+ * Forgets the given region if it is waiting for
+ * a job.
+ *
+ * To be called when the region is freed.
+ */
+NONNULL
+void
+stretch_cache_remove_region (
+  StretchCache *  self,
+  const ZRegion * region);
+
+NONNULL
+void
+stretch_cache_free (
+  StretchCache * self);
+
+/**
+ * @}
+ */
+
+#endif
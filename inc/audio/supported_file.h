@@ -36,6 +36,11 @@
  * @{
  */
 
+/**
+ * Number of peaks in a waveform thumbnail.
+ */
+#define SUPPORTED_FILE_THUMBNAIL_SIZE 32
+
 /**
  * File type.
  */
@@ -91,6 +96,31 @@ typedef struct SupportedFile
   /** Hidden or not. */
   int             hidden;
 
+  /**
+   * Whether the audio metadata below is filled
+   * in.
+   *
+   * If false, the file must be opened to get
+   * its info.
+   */
+  bool            has_metadata;
+
+  /** Length in milliseconds. */
+  long            length;
+  int             channels;
+  int             sample_rate;
+  int             bit_rate;
+  int             bit_depth;
+  float           bpm;
+
+  /** Whether \ref SupportedFile.thumbnail is
+   * filled in. */
+  bool            has_thumbnail;
+
+  /** Peaks of the waveform (0 to 1). */
+  float           thumbnail[
+    SUPPORTED_FILE_THUMBNAIL_SIZE];
+
   /** MIDI file, if midi. */
   //MidiFile *     midi_file;
 
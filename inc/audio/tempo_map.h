@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Precomputed tables for converting between
+ * frames, ticks and bars/beats/sixteenths.
+ */
+
+#ifndef __AUDIO_TEMPO_MAP_H__
+#define __AUDIO_TEMPO_MAP_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "utils/types.h"
+
+/**
+ * @addtogroup audio
+ *
+ * @{
+ */
+
+/**
+ * Length in ticks of the constant-tempo segments
+ * that tempo ramps are split into (a 32nd note).
+ */
+#define TEMPO_MAP_RAMP_STEP 120.0
+
+/**
+ * A range of the timeline with a constant tempo.
+ *
+ * The segment lasts until the start of the next
+ * one. The first segment also covers negative
+ * positions.
+ */
+typedef struct TempoMapSegment
+{
+  /** Start position in ticks. */
+  double       start_ticks;
+
+  /** Start position in (fractional) frames. */
+  double       start_frames;
+
+  bpm_t        bpm;
+
+  double       frames_per_tick;
+
+  /** Reciprocal of
+   * \ref TempoMapSegment.frames_per_tick. */
+  double       ticks_per_frame;
+} TempoMapSegment;
+
+/**
+ * A position split into bars, beats, sixteenths
+ * and ticks.
+ */
+typedef struct MusicalTime
+{
+  /** Same as position_get_bars(). */
+  int          bars;
+
+  /** Same as position_get_beats(). */
+  int          beats;
+
+  /** Same as position_get_sixteenths(). */
+  int          sixteenths;
+
+  /** Same as position_get_ticks(). */
+  double       ticks;
+
+  /** Ticks since the start of the beat. */
+  double       beat_ticks;
+
+  /** Ticks since the start of the bar. */
+  double       bar_ticks;
+} MusicalTime;
+
+/**
+ * Tempo segments and time signature constants
+ * for converting positions without divisions.
+ *
+ * Maps are immutable once built. When the tempo,
+ * BPM automation or time signature changes a new
+ * map is built and swapped in by the engine, so
+ * any thread can use the map it got for the rest
+ * of the cycle.
+ */
+typedef struct TempoMap
+{
+  /** Segments sorted by start position. */
+  TempoMapSegment * segments;
+  int               num_segments;
+  size_t            segments_size;
+
+  /** BPM where there is no automation. */
+  bpm_t             bpm;
+
+  /** Whether the segments come from BPM
+   * automation. */
+  bool              automated;
+
+  sample_rate_t     sample_rate;
+  int               beats_per_bar;
+  int               sixteenths_per_beat;
+  double            ticks_per_beat;
+  double            ticks_per_bar;
+
+  /** Reciprocals of the above, so positions are
+   * split with multiplications only. */
+  double            beats_per_tick;
+  double            bars_per_tick;
+  double            sixteenths_per_tick;
+} TempoMap;
+
+/**
+ * Creates a map without segments for the given
+ * time signature.
+ *
+ * @param ticks_per_beat Ticks per beat, as in
+ *   \ref Transport.ticks_per_beat.
+ * @param bpm BPM where there is no automation.
+ */
+TempoMap *
+tempo_map_new (
+  int           beats_per_bar,
+  int           ticks_per_beat,
+  sample_rate_t sample_rate,
+  bpm_t         bpm);
+
+/**
+ * Appends a segment starting at the given
+ * position.
+ *
+ * Segments must be added in order, starting
+ * at 0. A segment with the same BPM as the
+ * previous one is not added.
+ */
+NONNULL
+void
+tempo_map_add_segment (
+  TempoMap * self,
+  double     start_ticks,
+  bpm_t      bpm);
+
+/**
+ * Returns the frames per tick for the given BPM,
+ * same as \ref AudioEngine.frames_per_tick.
+ */
+NONNULL
+PURE
+double
+tempo_map_get_frames_per_tick (
+  const TempoMap * self,
+  bpm_t            bpm);
+
+/**
+ * Returns the index of the segment containing
+ * the given ticks.
+ */
+NONNULL
+PURE
+int
+tempo_map_get_segment_at_ticks (
+  const TempoMap * self,
+  double           ticks);
+
+/**
+ * Returns the index of the segment containing
+ * the given frames.
+ */
+NONNULL
+PURE
+int
+tempo_map_get_segment_at_frames (
+  const TempoMap * self,
+  long             frames);
+
+/**
+ * Returns the BPM at the given ticks.
+ */
+NONNULL
+HOT
+bpm_t
+tempo_map_get_bpm_at_ticks (
+  const TempoMap * self,
+  double           ticks);
+
+/**
+ * Returns the BPM at the given frames.
+ */
+NONNULL
+HOT
+bpm_t
+tempo_map_get_bpm_at_frames (
+  const TempoMap * self,
+  long             frames);
+
+/**
+ * Converts frames to ticks.
+ */
+NONNULL
+HOT
+double
+tempo_map_frames_to_ticks (
+  const TempoMap * self,
+  long             frames);
+
+/**
+ * Converts ticks to frames, rounding to the
+ * nearest frame.
+ */
+NONNULL
+HOT
+long
+tempo_map_ticks_to_frames (
+  const TempoMap * self,
+  double           ticks);
+
+/**
+ * Converts an array of frames to ticks.
+ *
+ * Sorted input (such as the positions in a
+ * cycle) only looks up the segment once.
+ */
+NONNULL
+HOT
+void
+tempo_map_frames_to_ticks_array (
+  const TempoMap * self,
+  const long *     frames,
+  double *         ticks,
+  size_t           num_positions);
+
+/**
+ * Converts an array of ticks to frames.
+ *
+ * @see tempo_map_frames_to_ticks_array().
+ */
+NONNULL
+HOT
+void
+tempo_map_ticks_to_frames_array (
+  const TempoMap * self,
+  const double *   ticks,
+  long *           frames,
+  size_t           num_positions);
+
+/**
+ * Splits the given ticks into bars, beats,
+ * sixteenths and ticks.
+ *
+ * @param start_at_one Start the bars, beats and
+ *   sixteenths at 1 or -1 instead of 0.
+ */
+NONNULL
+HOT
+void
+tempo_map_get_musical_time (
+  const TempoMap * self,
+  double           ticks,
+  bool             start_at_one,
+  MusicalTime *    time);
+
+/**
+ * Splits an array of ticks into bars, beats,
+ * sixteenths and ticks.
+ *
+ * @see tempo_map_get_musical_time().
+ */
+NONNULL
+HOT
+void
+tempo_map_get_musical_time_array (
+  const TempoMap * self,
+  const double *   ticks,
+  MusicalTime *    times,
+  size_t           num_positions,
+  bool             start_at_one);
+
+/**
+ * Returns whether the maps have the same time
+ * signature and (almost) the same tempo
+ * segments.
+ */
+NONNULL
+bool
+tempo_map_is_equal (
+  const TempoMap * a,
+  const TempoMap * b);
+
+NONNULL
+void
+tempo_map_free (
+  TempoMap * self);
+
+/**
+ * @}
+ */
+
+#endif
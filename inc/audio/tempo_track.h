@@ -31,6 +31,8 @@
 #include "audio/track.h"
 #include "utils/types.h"
 
+typedef struct TempoMap TempoMap;
+
 /**
  * @addtogroup audio
  *
@@ -94,12 +96,30 @@ tempo_track_clear (
 
 /**
  * Returns the BPM at the given pos.
+ *
+ * This is a lookup in the engine's tempo map, so
+ * it is cheap to call during processing.
  */
 bpm_t
 tempo_track_get_bpm_at_pos (
   Track *    track,
   Position * pos);
 
+/**
+ * Fills the tempo map with segments from the BPM
+ * automation, using the map's BPM where there is
+ * no automation.
+ *
+ * Ramps between automation points are split into
+ * constant segments of \ref TEMPO_MAP_RAMP_STEP
+ * ticks.
+ */
+NONNULL
+void
+tempo_track_fill_tempo_map (
+  Track *    self,
+  TempoMap * map);
+
 /**
  * Returns the current BPM.
  */
@@ -114,8 +134,6 @@ tempo_track_get_current_bpm_as_str (
 /**
  * Sets the BPM.
  *
- * @param update_snap_points Whether to update the
- *   snap points.
  * @param stretch_audio_region Whether to stretch
  *   audio regions. This should only be true when
  *   the BPM change is final.
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Musical time at a position, computed once per
+ * cycle and shared by all plugins.
+ */
+
+#ifndef __AUDIO_TIME_INFO_SNAPSHOT_H__
+#define __AUDIO_TIME_INFO_SNAPSHOT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <lv2/atom/atom.h>
+#include <lv2/atom/forge.h>
+
+/**
+ * @addtogroup audio
+ *
+ * @{
+ */
+
+/**
+ * Transport state and musical time at the start
+ * of a (split) processing cycle, as reported to
+ * plugins.
+ *
+ * This is immutable once filled in.
+ */
+typedef struct TimeInfoSnapshot
+{
+  /** Global frames this was computed for. */
+  long         g_start_frames;
+
+  bool         rolling;
+
+  float        bpm;
+  int          beats_per_bar;
+  int          beat_unit;
+  int          ticks_per_beat;
+
+  /** Bar, starting from 1. */
+  int          bar;
+
+  /** Beat in the bar, starting from 1. */
+  int          beat;
+
+  /** Ticks since the start of the beat. */
+  double       beat_ticks;
+
+  /** Ticks since the start of the bar. */
+  double       bar_ticks;
+
+  /** A time:Position object for LV2 plugins. */
+  union
+  {
+    LV2_Atom   atom;
+    uint8_t    buf[256];
+  } lv2_pos;
+} TimeInfoSnapshot;
+
+/**
+ * Initializes a forge for building the LV2
+ * position objects.
+ *
+ * The forge can be copied afterwards.
+ */
+NONNULL
+void
+time_info_snapshot_init_forge (
+  LV2_Atom_Forge * forge);
+
+/**
+ * Fills in the snapshot for the given position
+ * from the current transport and tempo.
+ *
+ * This is realtime-safe.
+ *
+ * @param forge A forge initialized with
+ *   time_info_snapshot_init_forge(). Its buffer
+ *   is changed.
+ */
+NONNULL
+HOT
+void
+time_info_snapshot_fill (
+  TimeInfoSnapshot * self,
+  LV2_Atom_Forge *   forge,
+  long               g_start_frames);
+
+/**
+ * @}
+ */
+
+#endif
@@ -526,6 +526,22 @@ typedef struct Track
   /** Pointer to owner tracklist selections, if
    * any. */
   TracklistSelections * ts;
+
+  /**
+   * Sorted start and end positions (in ticks) of
+   * the regions in the lanes, used when snapping
+   * to events.
+   *
+   * Cache, see track_get_snap_event_ticks().
+   * Not to be serialized.
+   */
+  double *            snap_event_ticks;
+  int                 num_snap_event_ticks;
+  size_t              snap_event_ticks_size;
+
+  /** Arranger object index generation the snap
+   * events were calculated at. */
+  unsigned int        snap_events_generation;
 } Track;
 
 static const cyaml_schema_field_t
@@ -1018,7 +1034,11 @@ track_remove_region (
  *
  * @param stereo_ports StereoPorts to fill.
  * @param midi_events MidiEvents to fill (from
- *   Piano Roll Port for example).
+ *   Piano Roll Port for example). The events are
+ *   inserted directly into the main events, sorted
+ *   by time, so this must only be called from the
+ *   engine thread. Duplicates are removed at the
+ *   end.
  */
 void
 track_fill_events (
@@ -1087,6 +1107,24 @@ ZRegion *
 track_get_last_region (
   Track *    track);
 
+/**
+ * Returns the start and end positions of the
+ * regions in the track lanes in ticks, sorted.
+ *
+ * The result is cached and only recalculated when
+ * arranger objects change, so repeated lookups
+ * (eg, when snapping during a drag) only need a
+ * binary search.
+ *
+ * @param[out] num_ticks Number of positions
+ *   returned.
+ */
+NONNULL
+const double *
+track_get_snap_event_ticks (
+  Track * self,
+  int *   num_ticks);
+
 /**
  * Set track lanes visible and fire events.
  */
@@ -34,6 +34,7 @@
 typedef struct StereoPorts StereoPorts;
 typedef struct Port Port;
 typedef struct Track Track;
+typedef struct AutomationTrack AutomationTrack;
 typedef struct MidiMappings MidiMappings;
 typedef struct EngineProcessTimeInfo
   EngineProcessTimeInfo;
@@ -54,6 +55,35 @@ typedef struct EngineProcessTimeInfo
   (self->track \
    && track_is_in_active_project (self->track))
 
+/**
+ * Index of a MIDI automatable (see
+ * track_processor_get_midi_automatable()).
+ *
+ * CCs come first, followed by the pitch bend,
+ * polyphonic key pressure and channel pressure of
+ * each channel.
+ *
+ * @param ch Channel, starting from 0.
+ */
+#define TRACK_PROCESSOR_MIDI_CC_IDX(ch,cc) \
+  ((ch) * 128 + (cc))
+#define TRACK_PROCESSOR_PITCH_BEND_IDX(ch) \
+  (128 * 16 + (ch))
+#define TRACK_PROCESSOR_POLY_KEY_PRESSURE_IDX(ch) \
+  (128 * 16 + 16 + (ch))
+#define TRACK_PROCESSOR_CHANNEL_PRESSURE_IDX(ch) \
+  (128 * 16 + 32 + (ch))
+
+/** Number of MIDI automatables. */
+#define TRACK_PROCESSOR_NUM_MIDI_AUTOMATABLES \
+  (128 * 16 + 48)
+
+/** Number of words in a bitmap of MIDI
+ * automatables. */
+#define TRACK_PROCESSOR_MIDI_AUTOMATABLES_WORDS \
+  ((TRACK_PROCESSOR_NUM_MIDI_AUTOMATABLES + 31) \
+   / 32)
+
 /**
  * A TrackProcessor is a processor that is used as
  * the first entry point when processing a track.
@@ -129,9 +159,18 @@ typedef struct TrackProcessor
 
   /* --- MIDI controls --- */
 
-  /** Mappings to each CC port. */
+  /**
+   * Mappings to each MIDI CC port that was
+   * created, or NULL if there are none.
+   */
   MidiMappings *   cc_mappings;
 
+  /*
+   * The MIDI controls are only created when
+   * needed (when automated or recorded into), so
+   * any of the following may be NULL.
+   */
+
   /** MIDI CC control ports, 16 channels. */
   Port *           midi_cc[128 * 16];
 
@@ -156,6 +195,39 @@ typedef struct TrackProcessor
    */
   Port *           channel_pressure[16];
 
+  /**
+   * Bitmap of MIDI controls whose value changed
+   * since it was last sent, by MIDI automatable
+   * index.
+   *
+   * This is so that only the changed controls
+   * are checked during processing.
+   */
+  volatile guint   dirty_midi_automatables[
+    TRACK_PROCESSOR_MIDI_AUTOMATABLES_WORDS];
+
+  /**
+   * Bitmap of MIDI controls that received MIDI
+   * input while recording but don't have a port
+   * yet, by MIDI automatable index.
+   *
+   * The ports are created later from the GTK
+   * thread.
+   */
+  volatile guint   pending_midi_automatables[
+    TRACK_PROCESSOR_MIDI_AUTOMATABLES_WORDS];
+
+  /**
+   * Last normalized value received for each MIDI
+   * control in \ref pending_midi_automatables.
+   *
+   * The port is set to it when it is created, so
+   * no input is lost while the port doesn't
+   * exist.
+   */
+  float            pending_midi_automatable_values[
+    TRACK_PROCESSOR_NUM_MIDI_AUTOMATABLES];
+
   /* --- end MIDI controls --- */
 
   /**
@@ -355,6 +427,88 @@ track_processor_append_ports (
   TrackProcessor * self,
   GPtrArray *      ports);
 
+/**
+ * Returns the MIDI automatable index of the given
+ * MIDI automatable port.
+ */
+NONNULL
+int
+track_processor_get_midi_automatable_idx (
+  const PortIdentifier * id);
+
+/**
+ * Returns a newly allocated label for the MIDI
+ * automatable at the given index.
+ */
+char *
+track_processor_get_midi_automatable_label (
+  int idx);
+
+/**
+ * Returns the MIDI automatable port at the given
+ * index, or NULL if it wasn't created yet.
+ */
+NONNULL
+Port *
+track_processor_get_midi_automatable (
+  const TrackProcessor * self,
+  int                    idx);
+
+/**
+ * Creates the MIDI automatable port at the given
+ * index and its automation track, if they don't
+ * exist yet.
+ *
+ * Must be called from the GTK thread while
+ * processing is held (see
+ * engine_hold_processing()). The graph must be
+ * recalculated afterwards.
+ *
+ * @return The automation track of the port.
+ */
+NONNULL
+AutomationTrack *
+track_processor_ensure_midi_automatable (
+  TrackProcessor * self,
+  int              idx);
+
+/**
+ * Marks the value of the given MIDI automatable
+ * port as changed so that it gets sent during the
+ * next cycle.
+ *
+ * Real-time safe.
+ */
+NONNULL
+void
+track_processor_mark_midi_automatable_dirty (
+  Port * port);
+
+/**
+ * Returns whether any MIDI controls without a port
+ * received MIDI input since the last call and
+ * clears the flag.
+ */
+bool
+track_processor_get_and_clear_pending (void);
+
+/**
+ * Creates the ports and automation tracks of the
+ * MIDI controls that received MIDI input while
+ * recording.
+ *
+ * Must be called from the GTK thread while
+ * processing is held (see
+ * engine_hold_processing()). The graph must be
+ * recalculated afterwards.
+ *
+ * @return Whether any port was created.
+ */
+NONNULL
+bool
+track_processor_create_pending_midi_automatables (
+  TrackProcessor * self);
+
 /**
  * Frees the TrackProcessor.
  */
@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Time-axis index of arranger objects used for
+ * hit-testing and culling.
+ */
+
+#ifndef __GUI_BACKEND_ARRANGER_OBJECT_INDEX_H__
+#define __GUI_BACKEND_ARRANGER_OBJECT_INDEX_H__
+
+#include <stdbool.h>
+
+#include "utils/types.h"
+
+#include <glib.h>
+
+typedef struct ArrangerObject ArrangerObject;
+
+/**
+ * @addtogroup gui_backend
+ *
+ * @{
+ */
+
+/**
+ * Number of buckets used when indexing by pitch.
+ */
+#define ARRANGER_OBJECT_INDEX_NUM_PITCHES 128
+
+/**
+ * An indexed object.
+ */
+typedef struct ArrangerObjectIndexEntry
+{
+  /** Start of the drawn extent in ticks. */
+  double           start_ticks;
+
+  /**
+   * End of the drawn extent in ticks.
+   *
+   * For objects without length this is still past
+   * \ref start_ticks if they are drawn wider than
+   * a point (labels, automation curves, etc.).
+   */
+  double           end_ticks;
+
+  ArrangerObject * obj;
+} ArrangerObjectIndexEntry;
+
+/**
+ * Node of the interval tree of a bucket.
+ */
+typedef struct ArrangerObjectIndexNode
+{
+  /** The entry, as it was when it was added. */
+  ArrangerObjectIndexEntry         entry;
+
+  /** Maximum end position in this subtree. */
+  double                           max_end_ticks;
+
+  struct ArrangerObjectIndexNode * left;
+  struct ArrangerObjectIndexNode * right;
+
+  /** Height of this subtree. */
+  int                              height;
+
+  /** Bucket the node is in. */
+  int                              bucket;
+} ArrangerObjectIndexNode;
+
+/**
+ * Interval tree of entries.
+ *
+ * This is an AVL tree ordered by start position,
+ * where each node also keeps the maximum end
+ * position of its subtree. Adding or removing an
+ * entry is O(log n). Finding the k entries that
+ * overlap a range is O(min (n, k log n)), since
+ * subtrees that start after the range or end
+ * before it are skipped.
+ */
+typedef struct ArrangerObjectIndexBucket
+{
+  ArrangerObjectIndexNode * root;
+  int                       num_entries;
+} ArrangerObjectIndexBucket;
+
+/**
+ * Function that returns the extent an object
+ * covers when drawn, in ticks, in the same frame
+ * of reference as its positions.
+ */
+typedef void (*ArrangerObjectIndexExtentFunc) (
+  ArrangerObject * obj,
+  double *         start_ticks,
+  double *         end_ticks,
+  void *           user_data);
+
+/**
+ * Index over the objects of a single container
+ * (eg, the regions of a lane or the MIDI notes of
+ * a region).
+ *
+ * Positions are stored as they are in the objects,
+ * so for objects with region-local positions the
+ * index stays valid when the region is moved.
+ *
+ * Entries are added, removed and moved one at a
+ * time as objects change (see
+ * ArrangerObjectIndexCache).
+ */
+typedef struct ArrangerObjectIndex
+{
+  /** 1 bucket, or one per pitch. */
+  ArrangerObjectIndexBucket * buckets;
+  int                         num_buckets;
+
+  /** Number of objects in the index. */
+  int                         num_objs;
+
+  /** Object to its ArrangerObjectIndexNode, to
+   * find the entry after the object moved. */
+  GHashTable *                nodes;
+
+  /** Container the index is cached for, if
+   * any. */
+  const void *                container;
+
+  /** Extent function, or NULL to use the
+   * object positions. */
+  ArrangerObjectIndexExtentFunc extent_func;
+  void *                      extent_user_data;
+} ArrangerObjectIndex;
+
+/**
+ * Indices of an arranger, keyed by container.
+ *
+ * Caches are registered globally on creation so
+ * that object changes can be applied to every
+ * index that contains the object.
+ */
+typedef struct ArrangerObjectIndexCache
+{
+  /** Container to ArrangerObjectIndex. */
+  GHashTable *                  indices;
+
+  /** Indexed object to ArrangerObjectIndex. */
+  GHashTable *                  obj_indices;
+
+  ArrangerObjectIndexExtentFunc extent_func;
+  void *                        extent_user_data;
+} ArrangerObjectIndexCache;
+
+/**
+ * Function to call for each object found.
+ */
+typedef void (*ArrangerObjectIndexFunc) (
+  ArrangerObject * obj,
+  void *           user_data);
+
+/**
+ * Builds an index for the given objects.
+ *
+ * @param by_pitch Whether to put the objects in
+ *   separate buckets by pitch. Only valid for
+ *   MIDI notes.
+ * @param extent_func Function to get the drawn
+ *   extent of each object, or NULL to use the
+ *   object positions.
+ */
+ArrangerObjectIndex *
+arranger_object_index_new (
+  ArrangerObject **             objs,
+  int                           num_objs,
+  bool                          by_pitch,
+  ArrangerObjectIndexExtentFunc extent_func,
+  void *                        extent_user_data);
+
+/**
+ * Adds an object to the index.
+ */
+NONNULL
+void
+arranger_object_index_add (
+  ArrangerObjectIndex * self,
+  ArrangerObject *      obj);
+
+/**
+ * Removes an object from the index.
+ *
+ * @return Whether the object was found.
+ */
+NONNULL
+bool
+arranger_object_index_remove (
+  ArrangerObjectIndex * self,
+  ArrangerObject *      obj);
+
+/**
+ * Moves the object's entry after its position,
+ * pitch or drawn extent changed.
+ *
+ * @return Whether the object was found.
+ */
+NONNULL
+bool
+arranger_object_index_update (
+  ArrangerObjectIndex * self,
+  ArrangerObject *      obj);
+
+/**
+ * Calls \ref func for each object that may overlap
+ * the given range.
+ *
+ * Objects that are certain not to overlap are
+ * skipped, but the caller is still expected to do
+ * any exact checks.
+ *
+ * @param start_ticks Range start, in the same
+ *   frame of reference as the object positions.
+ * @param end_ticks Range end (inclusive).
+ * @param min_pitch Lowest pitch to check, if the
+ *   index is by pitch.
+ * @param max_pitch Highest pitch to check, if the
+ *   index is by pitch.
+ */
+HOT
+NONNULL_ARGS (1, 6)
+void
+arranger_object_index_foreach_in_range (
+  ArrangerObjectIndex *   self,
+  double                  start_ticks,
+  double                  end_ticks,
+  int                     min_pitch,
+  int                     max_pitch,
+  ArrangerObjectIndexFunc func,
+  void *                  user_data);
+
+/**
+ * Returns whether the index can be used for a
+ * container with \ref num_objs objects.
+ */
+NONNULL
+bool
+arranger_object_index_is_valid (
+  ArrangerObjectIndex * self,
+  int                   num_objs,
+  bool                  by_pitch);
+
+NONNULL
+void
+arranger_object_index_free (
+  ArrangerObjectIndex * self);
+
+/**
+ * Creates and registers a new cache.
+ */
+ArrangerObjectIndexCache *
+arranger_object_index_cache_new (
+  ArrangerObjectIndexExtentFunc extent_func,
+  void *                        extent_user_data);
+
+/**
+ * Calls \ref func for each of the objects of the
+ * given container that may overlap the given
+ * range, building the container's index if
+ * needed.
+ *
+ * See arranger_object_index_foreach_in_range().
+ *
+ * @param container The object owning the array
+ *   (lane, region, etc.).
+ */
+NONNULL_ARGS (1, 2, 10)
+void
+arranger_object_index_cache_foreach_in_range (
+  ArrangerObjectIndexCache * self,
+  const void *               container,
+  ArrangerObject **          objs,
+  int                        num_objs,
+  bool                       by_pitch,
+  double                     start_ticks,
+  double                     end_ticks,
+  int                        min_pitch,
+  int                        max_pitch,
+  ArrangerObjectIndexFunc    func,
+  void *                     user_data);
+
+/**
+ * Drops all indices in the cache.
+ *
+ * To be called when the drawn extents of all
+ * objects change (eg, on zoom).
+ */
+NONNULL
+void
+arranger_object_index_cache_clear (
+  ArrangerObjectIndexCache * self);
+
+/**
+ * Unregisters and frees the cache.
+ */
+NONNULL
+void
+arranger_object_index_cache_free (
+  ArrangerObjectIndexCache * self);
+
+/**
+ * To be called after an object was added to a
+ * container.
+ */
+NONNULL
+void
+arranger_object_index_object_added (
+  const void *     container,
+  ArrangerObject * obj);
+
+/**
+ * To be called after an object was removed from
+ * its container, or before it is freed.
+ */
+NONNULL
+void
+arranger_object_index_object_removed (
+  ArrangerObject * obj);
+
+/**
+ * To be called after the position, pitch or drawn
+ * extent of an object changed.
+ */
+NONNULL
+void
+arranger_object_index_object_changed (
+  ArrangerObject * obj);
+
+/**
+ * To be called before a container is freed.
+ */
+NONNULL
+void
+arranger_object_index_container_freed (
+  const void * container);
+
+/**
+ * Returns a counter that is bumped on every
+ * object change, for other caches that depend on
+ * object positions.
+ */
+unsigned int
+arranger_object_index_get_generation (void);
+
+/**
+ * @}
+ */
+
+#endif
@@ -91,6 +91,19 @@ typedef struct ArrangerSelections
   ArrangerSelectionsType type;
 
   int                    magic;
+
+  /**
+   * Set of the selected objects, used for
+   * constant-time lookups and removals.
+   *
+   * Each object maps to its index in its array,
+   * plus 1.
+   *
+   * Kept in sync with the object arrays of the
+   * child struct. Created lazily and not
+   * serialized.
+   */
+  GHashTable *           objects_set;
 } ArrangerSelections;
 
 static const cyaml_schema_field_t
@@ -176,6 +189,22 @@ arranger_selections_add_object (
   ArrangerSelections * self,
   ArrangerObject *     obj);
 
+/**
+ * Appends the given objects to the selections.
+ *
+ * Unlike calling arranger_object_select() for
+ * each object, this does not look up the
+ * selections or log each object, so it should be
+ * used when selecting many objects at once (eg,
+ * select all).
+ */
+NONNULL
+void
+arranger_selections_add_objects (
+  ArrangerSelections * self,
+  ArrangerObject **    objs,
+  int                  num_objs);
+
 /**
  * Sets the values of each object in the dest
  * selections to the values in the src selections.
@@ -434,6 +463,12 @@ arranger_selections_contains_object_with_property (
 
 /**
  * Removes the arranger object from the selections.
+ *
+ * This takes constant time: the last object of
+ * the same type takes the place of the removed
+ * one, so the order of the objects is not kept.
+ * Use arranger_selections_sort_by_indices() if
+ * the order matters.
  */
 NONNULL
 void
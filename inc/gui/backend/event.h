@@ -327,6 +327,14 @@ typedef enum EventType
    * Arg: ZRegion pointer.
    */
   ET_AUDIO_REGION_GAIN_CHANGED,
+
+  /**
+   * The files in the current file browser
+   * location changed (eg, after indexing).
+   *
+   * Arg: None.
+   */
+  ET_FILE_BROWSER_FILES_CHANGED,
 } EventType;
 
 /**
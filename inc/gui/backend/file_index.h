@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Persistent index of the files shown in the file
+ * browser, updated in the background.
+ */
+
+#ifndef __GUI_BACKEND_FILE_INDEX_H__
+#define __GUI_BACKEND_FILE_INDEX_H__
+
+#include <stdbool.h>
+
+#include "audio/supported_file.h"
+#include "utils/yaml.h"
+
+#include <gio/gio.h>
+
+/**
+ * @addtogroup gui_backend
+ *
+ * @{
+ */
+
+#define FILE_INDEX_SCHEMA_VERSION 1
+
+#define FILE_INDEX_FILENAME "file_index.yaml"
+
+/**
+ * Audio files longer than this (in ms) are not
+ * decoded, so they get no BPM or thumbnail.
+ */
+#define FILE_INDEX_MAX_ANALYSIS_LENGTH 60000
+
+/**
+ * An indexed file.
+ */
+typedef struct FileIndexEntry
+{
+  /** File name. */
+  char *           name;
+
+  ZFileType        type;
+  int              hidden;
+
+  /** Whether this is a symbolic link. */
+  int              symlink;
+
+  /** Modification time when indexed. */
+  gint64           mtime;
+
+  /** Whether the audio metadata below was read. */
+  int              has_metadata;
+
+  /** Length in milliseconds. */
+  gint64           length;
+  int              channels;
+  int              sample_rate;
+  int              bit_rate;
+  int              bit_depth;
+  float            bpm;
+
+  /**
+   * Peaks as a string of
+   * \ref SUPPORTED_FILE_THUMBNAIL_SIZE 2-digit
+   * hex values, or NULL if not decoded.
+   */
+  char *           thumbnail;
+
+  /** Case-folded name, used for searching. */
+  char *           search_key;
+
+  /** Whether the audio metadata is still to be
+   * read. Not saved. */
+  bool             needs_metadata;
+} FileIndexEntry;
+
+static const cyaml_schema_field_t
+  file_index_entry_fields_schema[] =
+{
+  YAML_FIELD_STRING_PTR (
+    FileIndexEntry, name),
+  YAML_FIELD_ENUM (
+    FileIndexEntry, type, file_type_strings),
+  YAML_FIELD_INT (
+    FileIndexEntry, hidden),
+  YAML_FIELD_INT (
+    FileIndexEntry, symlink),
+  YAML_FIELD_INT (
+    FileIndexEntry, mtime),
+  YAML_FIELD_INT (
+    FileIndexEntry, has_metadata),
+  YAML_FIELD_INT (
+    FileIndexEntry, length),
+  YAML_FIELD_INT (
+    FileIndexEntry, channels),
+  YAML_FIELD_INT (
+    FileIndexEntry, sample_rate),
+  YAML_FIELD_INT (
+    FileIndexEntry, bit_rate),
+  YAML_FIELD_INT (
+    FileIndexEntry, bit_depth),
+  YAML_FIELD_FLOAT (
+    FileIndexEntry, bpm),
+  YAML_FIELD_STRING_PTR_OPTIONAL (
+    FileIndexEntry, thumbnail),
+
+  CYAML_FIELD_END
+};
+
+static const cyaml_schema_value_t
+  file_index_entry_schema =
+{
+  YAML_VALUE_PTR (
+    FileIndexEntry, file_index_entry_fields_schema),
+};
+
+/**
+ * The indexed contents of a directory.
+ */
+typedef struct FileIndexDir
+{
+  /** Absolute path. */
+  char *            path;
+
+  /** Modification time when indexed. */
+  gint64            mtime;
+
+  FileIndexEntry ** entries;
+  int               num_entries;
+  size_t            entries_size;
+} FileIndexDir;
+
+static const cyaml_schema_field_t
+  file_index_dir_fields_schema[] =
+{
+  YAML_FIELD_STRING_PTR (
+    FileIndexDir, path),
+  YAML_FIELD_INT (
+    FileIndexDir, mtime),
+  YAML_FIELD_DYN_PTR_ARRAY_VAR_COUNT_OPT (
+    FileIndexDir, entries,
+    file_index_entry_schema),
+
+  CYAML_FIELD_END
+};
+
+static const cyaml_schema_value_t
+  file_index_dir_schema =
+{
+  YAML_VALUE_PTR (
+    FileIndexDir, file_index_dir_fields_schema),
+};
+
+/**
+ * The on-disk form of the index.
+ */
+typedef struct FileIndexCache
+{
+  int              schema_version;
+
+  FileIndexDir **  dirs;
+  int              num_dirs;
+  size_t           dirs_size;
+} FileIndexCache;
+
+static const cyaml_schema_field_t
+  file_index_cache_fields_schema[] =
+{
+  YAML_FIELD_INT (
+    FileIndexCache, schema_version),
+  YAML_FIELD_DYN_PTR_ARRAY_VAR_COUNT_OPT (
+    FileIndexCache, dirs,
+    file_index_dir_schema),
+
+  CYAML_FIELD_END
+};
+
+static const cyaml_schema_value_t
+  file_index_cache_schema =
+{
+  YAML_VALUE_PTR (
+    FileIndexCache, file_index_cache_fields_schema),
+};
+
+/**
+ * Index of the files in the file browser
+ * locations.
+ *
+ * Directories are listed and audio files are
+ * analyzed in a separate thread. The GTK thread
+ * only reads from the index, so browsing never
+ * touches the disk apart from checking the
+ * modification time of the directory.
+ *
+ * A listing is published as soon as the names
+ * and types are known. The audio metadata is
+ * read afterwards, one file at a time and only
+ * while no directory is waiting to be listed.
+ *
+ * Directories are re-indexed when their
+ * modification time changes, or when the watched
+ * directory reports changes. Files whose
+ * modification time did not change keep their
+ * metadata.
+ */
+typedef struct FileIndex
+{
+  /**
+   * Indexed directories, by path.
+   *
+   * Only changed by the indexer thread, under
+   * \ref FileIndex.lock.
+   */
+  GHashTable *     dirs;
+
+  /** Protects \ref FileIndex.dirs, the pending
+   * jobs and the current directory. */
+  GMutex           lock;
+
+  /** Queue of FileIndexJob. */
+  GAsyncQueue *    jobs;
+
+  /** Paths of the indexed directories with files
+   * whose audio metadata is still to be read.
+   * Only used by the indexer thread. */
+  GQueue *         metadata_dirs;
+
+  /** Paths of the browsed directories queued
+   * for indexing. */
+  GHashTable *     pending_dirs;
+
+  /** Directory currently shown in the browser. */
+  char *           cur_dir;
+
+  /** Monitor of the current directory. */
+  GFileMonitor *   monitor;
+  char *           monitored_dir;
+
+  GThread *        thread;
+
+  /** Set to 1 to stop the thread. */
+  volatile gint    terminate;
+
+  /** Whether there are changes not saved to the
+   * cache file yet. Only used by the indexer. */
+  bool             dirty;
+
+  /** Path to the cache file. */
+  char *           cache_path;
+} FileIndex;
+
+/**
+ * Creates the index and starts the indexer
+ * thread.
+ *
+ * The cache file is loaded from the thread.
+ *
+ * @param cache_path Path to the cache file.
+ */
+NONNULL
+FileIndex *
+file_index_new (
+  const char * cache_path);
+
+/**
+ * Appends a SupportedFile for each indexed file in
+ * the given directory.
+ *
+ * If the directory is not indexed or has changed,
+ * it is queued for indexing and
+ * ET_FILE_BROWSER_FILES_CHANGED is sent when done,
+ * and again as the audio metadata of its files is
+ * read.
+ *
+ * @return Whether the directory was indexed. If
+ *   false, nothing was added.
+ */
+NONNULL
+bool
+file_index_get_files (
+  FileIndex *  self,
+  const char * dir_path,
+  GPtrArray *  files);
+
+/**
+ * Queues the given directory and all its
+ * subdirectories for indexing in the background.
+ */
+NONNULL
+void
+file_index_add_library (
+  FileIndex *  self,
+  const char * dir_path);
+
+/**
+ * Re-indexes the given directory when its
+ * contents change.
+ *
+ * Only one directory is watched at a time.
+ */
+NONNULL
+void
+file_index_watch_dir (
+  FileIndex *  self,
+  const char * dir_path);
+
+/**
+ * Returns the indexed files whose name contains
+ * the given string, ignoring case.
+ *
+ * @param max_results Maximum number of results,
+ *   or -1 for no limit.
+ *
+ * @return A new array of SupportedFile.
+ */
+NONNULL
+GPtrArray *
+file_index_search (
+  FileIndex *  self,
+  const char * query,
+  int          max_results);
+
+/**
+ * Saves the index to the cache file.
+ *
+ * Must only be called from the indexer thread or
+ * after it stopped.
+ */
+NONNULL
+void
+file_index_save (
+  FileIndex * self);
+
+/**
+ * Stops the thread, saves and frees the index.
+ */
+NONNULL
+void
+file_index_free (
+  FileIndex * self);
+
+/**
+ * @}
+ */
+
+#endif
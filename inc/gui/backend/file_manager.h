@@ -23,6 +23,7 @@
 #include <stdbool.h>
 
 typedef struct SupportedFile SupportedFile;
+typedef struct FileIndex FileIndex;
 
 /**
  * @addtogroup gui_backend
@@ -109,6 +110,10 @@ typedef struct FileManager
    */
   FileBrowserLocation *    selection;
 
+  /** Background index of the files in the
+   * locations. */
+  FileIndex *              index;
+
 } FileManager;
 
 /**
@@ -49,6 +49,8 @@ typedef struct AutomationPoint AutomationPoint;
 typedef struct _GtkEventControllerMotion
   GtkEventControllerMotion;
 typedef struct ArrangerObject ArrangerObject;
+typedef struct ArrangerObjectIndexCache
+  ArrangerObjectIndexCache;
 typedef struct ArrangerSelections ArrangerSelections;
 typedef struct EditorSettings EditorSettings;
 typedef struct ObjectPool ObjectPool;
@@ -389,6 +391,23 @@ typedef struct _ArrangerWidget
    */
   bool           first_draw;
 
+  /**
+   * Time-axis indices of the objects in each
+   * container (lane, region, etc.), used for
+   * hit-testing.
+   */
+  ArrangerObjectIndexCache * obj_index_cache;
+
+  /**
+   * Zoom levels the indices were built at.
+   *
+   * The indexed extents include parts drawn in
+   * pixels (labels, points, etc.), so the indices
+   * are dropped when these change.
+   */
+  double         obj_indices_px_per_tick;
+  double         obj_indices_px_per_key;
+
   /** Cached setting. */
   TransportDisplay ruler_display;
 
@@ -507,14 +526,12 @@ arranger_widget_get_scrolled_window (
 /**
  * Get all objects currently present in the arranger.
  *
- * @param objs Array to fill in.
- * @param size Array size to fill in.
+ * @return A new array of ArrangerObject's, to be
+ *   freed with g_ptr_array_unref().
  */
-void
+GPtrArray *
 arranger_widget_get_all_objects (
-  ArrangerWidget *  self,
-  ArrangerObject ** objs,
-  int *             size);
+  ArrangerWidget *  self);
 
 /**
  * Wrapper for ui_px_to_pos depending on the
@@ -124,6 +124,15 @@ typedef struct _AutomatableSelectorPopoverWidget
    * Automatable.
    */
   Port *       selected_port;
+
+  /**
+   * MIDI automatable index of the selected MIDI
+   * control, or -1.
+   *
+   * MIDI controls that are not used yet don't have
+   * a port, so their port is created when closing.
+   */
+  int          selected_midi_automatable;
 } AutomatableSelectorPopoverWidget;
 
 /**
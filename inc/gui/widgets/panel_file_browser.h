@@ -75,6 +75,17 @@ typedef struct _PanelFileBrowserWidget
   bool                 first_draw;
 } PanelFileBrowserWidget;
 
+/**
+ * Recreates the file list from the files in the
+ * file manager.
+ *
+ * To be called after the file manager reloaded
+ * its files.
+ */
+void
+panel_file_browser_refresh_files (
+  PanelFileBrowserWidget * self);
+
 PanelFileBrowserWidget *
 panel_file_browser_widget_new (void);
 
@@ -178,6 +178,15 @@ typedef struct _PluginBrowserWidget
   /** Current search string. */
   char *               current_search;
 
+  /**
+   * Bitset of the visible rows, indexed like the
+   * plugin search index.
+   */
+  uint64_t *           visible_plugins;
+
+  /** Idle source to update the visible rows. */
+  guint                refilter_source_id;
+
   /** Symbol map for string interning. */
   Symap *              symap;
 } PluginBrowserWidget;
@@ -46,6 +46,7 @@ typedef struct _ProjectToolbarWidget
   GtkToolButton *    open;
   GtkToolButton *    export_as;
   GtkToolButton *    export_graph;
+  GtkToolButton *    profile_graph;
 } ProjectToolbarWidget;
 
 #endif
@@ -58,6 +58,8 @@ guile_actions_undo_manager_define_module (void);
 void
 guile_audio_channel_define_module (void);
 void
+guile_audio_graph_profiler_define_module (void);
+void
 guile_audio_midi_note_define_module (void);
 void
 guile_audio_midi_region_define_module (void);
@@ -69,8 +69,29 @@ typedef struct CarlaNativePlugin
   //uint32_t                 num_midi_events;
   //NativeMidiEvent          midi_events[200];
   NativeTimeInfo   time_info;
+
+  /**
+   * Buffers passed to the native plugin, one per
+   * audio input/output of the native descriptor.
+   *
+   * Allocated when instantiating.
+   */
+  float **         inbufs;
+  float **         outbufs;
+
+  /**
+   * Patchbay groups and ports reported by carla.
+   *
+   * Only used while connecting the plugin inside
+   * the patchbay.
+   */
+  GArray *         patchbay_groups;
+  GArray *         patchbay_ports;
 #endif
 
+  /** Carla plugin variant used. */
+  CarlaPluginType  carla_type;
+
   /** Pointer back to Plugin. */
   Plugin *         plugin;
 
@@ -18,24 +18,41 @@
 #define __PLUGINS_LV2_WORKER_H__
 
 #include "zix/ring.h"
-#include "zix/sem.h"
-#include "zix/thread.h"
 
 #include <lilv/lilv.h>
 
 #include "lv2/worker/worker.h"
 
+#include <glib.h>
+
 typedef struct Lv2Plugin Lv2Plugin;
 
-typedef struct {
+/**
+ * Size of the request and response rings, which
+ * is also the maximum size of a request.
+ */
+#define LV2_WORKER_RING_SIZE 4096
+
+typedef struct Lv2Worker {
 	Lv2Plugin *                 plugin;       ///< Pointer back to the plugin
 	ZixRing*                    requests;   ///< Requests to the worker
 	ZixRing*                    responses;  ///< Responses from the worker
+	void*                       request;    ///< Worker request buffer
 	void*                       response;   ///< Worker response buffer
-	ZixSem                      sem;        ///< Worker semaphore
-	ZixThread                   thread;     ///< Worker thread
 	const LV2_Worker_Interface* iface;      ///< Plugin worker interface
 	bool                        threaded;   ///< Run work in another thread
+
+	/**
+	 * Number of requests not consumed yet.
+	 *
+	 * The worker is queued in the worker pool
+	 * while this is non-zero.
+	 */
+	volatile gint               num_pending;
+
+	/** Time the worker was last queued in the
+	 * pool, in microseconds. */
+	gint64                      queued_time;
 } Lv2Worker;
 
 void
@@ -51,6 +68,28 @@ lv2_worker_init (
 void
 lv2_worker_finish (Lv2Worker* worker);
 
+/**
+ * Runs the next pending request of a threaded
+ * worker.
+ *
+ * To be called by the worker pool from the thread
+ * that dequeued the worker.
+ *
+ * @return Whether there are more pending
+ *   requests (in which case the worker must be
+ *   queued again).
+ */
+bool
+lv2_worker_run_next_request (Lv2Worker* worker);
+
+/**
+ * Returns whether the worker's plugin is on an
+ * audible track, in which case its work is
+ * prioritized.
+ */
+bool
+lv2_worker_is_audible (Lv2Worker* worker);
+
 /**
  * Called from plugins during run() to request that
  * Zrythm calls the work() method in a non-realtime
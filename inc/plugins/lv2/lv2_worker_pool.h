@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Thread pool shared by the LV2 workers.
+ */
+
+#ifndef __PLUGINS_LV2_WORKER_POOL_H__
+#define __PLUGINS_LV2_WORKER_POOL_H__
+
+#include <stdbool.h>
+
+#include "zix/sem.h"
+
+#include <glib.h>
+
+typedef struct MPMCQueue MPMCQueue;
+typedef struct Lv2Worker Lv2Worker;
+
+/**
+ * @addtogroup lv2
+ *
+ * @{
+ */
+
+/**
+ * Maximum number of threads in the pool.
+ */
+#define LV2_WORKER_POOL_MAX_THREADS 4
+
+/**
+ * Maximum number of workers that can use the
+ * pool at the same time.
+ *
+ * Each worker is queued at most once, so this is
+ * also the size of the queues.
+ */
+#define LV2_WORKER_POOL_MAX_WORKERS 4096
+
+/**
+ * Statistics of the pool since the last reset.
+ *
+ * Times are in microseconds.
+ */
+typedef struct Lv2WorkerPoolStats
+{
+  int          num_threads;
+
+  /** Workers currently using the pool. */
+  int          num_workers;
+
+  /** Jobs run. */
+  int          num_jobs;
+
+  /** Jobs run for plugins on audible tracks. */
+  int          num_priority_jobs;
+
+  /** Highest number of threads that were
+   * running jobs at the same time. */
+  int          max_busy_threads;
+
+  /** Time from a worker getting queued until a
+   * thread picked it up. */
+  gint64       min_wake_latency;
+  gint64       avg_wake_latency;
+  gint64       max_wake_latency;
+} Lv2WorkerPoolStats;
+
+/**
+ * A fixed-size pool of threads that runs the
+ * work() requests of all threaded LV2 workers.
+ *
+ * Each worker has its own request ring and is
+ * queued in the pool at most once, while it has
+ * pending requests. Only the thread that dequeued
+ * a worker reads its ring, so the requests of each
+ * plugin run in order and never concurrently.
+ *
+ * After running one request the worker is queued
+ * again if it has more, so that a burst of
+ * requests from one plugin doesn't starve the
+ * others. Workers of plugins on audible tracks
+ * are queued with priority.
+ *
+ * The threads are only started when the first
+ * worker is added.
+ */
+typedef struct Lv2WorkerPool
+{
+  GThread *      threads[
+    LV2_WORKER_POOL_MAX_THREADS];
+  int            num_threads;
+
+  /** Workers of plugins on audible tracks. */
+  MPMCQueue *    priority_queue;
+
+  /** Other workers. */
+  MPMCQueue *    queue;
+
+  /** Posted once for each queued worker. */
+  ZixSem         sem;
+
+  volatile gint  terminate;
+
+  /** Number of workers added. */
+  volatile gint  num_workers;
+
+  /** Threads currently running a job. */
+  volatile gint  num_busy_threads;
+
+  /** Lock for the statistics below. */
+  GMutex         stats_lock;
+
+  int            num_jobs;
+  int            num_priority_jobs;
+  int            max_busy_threads;
+  gint64         min_wake_latency;
+  gint64         total_wake_latency;
+  gint64         max_wake_latency;
+} Lv2WorkerPool;
+
+Lv2WorkerPool *
+lv2_worker_pool_new (void);
+
+/**
+ * Registers a threaded worker, starting the
+ * threads if not started yet.
+ *
+ * @return Whether successful. If false, the worker
+ *   should run its work immediately instead.
+ */
+NONNULL
+bool
+lv2_worker_pool_add_worker (
+  Lv2WorkerPool * self,
+  Lv2Worker *     worker);
+
+/**
+ * Waits for the pending requests of the worker to
+ * be consumed and unregisters it.
+ *
+ * The plugin must not schedule any more work.
+ */
+NONNULL
+void
+lv2_worker_pool_remove_worker (
+  Lv2WorkerPool * self,
+  Lv2Worker *     worker);
+
+/**
+ * Queues a worker that has new requests.
+ *
+ * This is realtime-safe.
+ */
+NONNULL
+HOT
+void
+lv2_worker_pool_push (
+  Lv2WorkerPool * self,
+  Lv2Worker *     worker);
+
+/**
+ * Fills in the statistics since the last reset.
+ */
+NONNULL
+void
+lv2_worker_pool_get_stats (
+  Lv2WorkerPool *      self,
+  Lv2WorkerPoolStats * stats);
+
+/**
+ * Resets the statistics.
+ */
+NONNULL
+void
+lv2_worker_pool_reset_stats (
+  Lv2WorkerPool * self);
+
+/**
+ * Stops the threads and frees the pool.
+ *
+ * All workers must have been removed.
+ */
+NONNULL
+void
+lv2_worker_pool_free (
+  Lv2WorkerPool * self);
+
+/**
+ * @}
+ */
+
+#endif
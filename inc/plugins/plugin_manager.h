@@ -58,6 +58,8 @@ typedef struct PluginCollections PluginCollections;
   plugin_manager_get_node (PLUGIN_MANAGER, uri)
 
 typedef struct PluginDescriptor PluginDescriptor;
+typedef struct Lv2WorkerPool Lv2WorkerPool;
+typedef struct PluginSearchIndex PluginSearchIndex;
 
 /**
  * The PluginManager is responsible for scanning
@@ -101,6 +103,13 @@ typedef struct PluginManager
 
   char *                 lv2_path;
 
+  /** Threads running the work of LV2 plugins. */
+  Lv2WorkerPool *        lv2_worker_pool;
+
+  /** Index of \ref PluginManager.plugin_descriptors
+   * for the plugin browser. */
+  PluginSearchIndex *    search_index;
+
   /** Whether the plugin manager has been set up
    * already. */
   bool                   setup;
@@ -136,6 +145,19 @@ plugin_manager_scan_plugins (
   const double    max_progress,
   double *        progress);
 
+/**
+ * Rebuilds the search index from the current
+ * plugin descriptors.
+ *
+ * This is done after scanning, so it only needs
+ * to be called if the descriptors are changed
+ * afterwards.
+ */
+NONNULL
+void
+plugin_manager_update_search_index (
+  PluginManager * self);
+
 /**
  * Returns the PluginDescriptor instance for the
  * given URI.
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Search index of the scanned plugin descriptors.
+ */
+
+#ifndef __PLUGINS_PLUGIN_SEARCH_INDEX_H__
+#define __PLUGINS_PLUGIN_SEARCH_INDEX_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "plugins/plugin_descriptor.h"
+
+#include <glib.h>
+
+typedef struct PluginCollection PluginCollection;
+
+/**
+ * @addtogroup plugins
+ *
+ * @{
+ */
+
+#define PLUGIN_SEARCH_INDEX_NUM_CATEGORIES \
+  ((int) G_N_ELEMENTS ( \
+     plugin_descriptor_category_strings))
+#define PLUGIN_SEARCH_INDEX_NUM_PROTOCOLS \
+  ((int) G_N_ELEMENTS (plugin_protocol_strings))
+
+/**
+ * Returns whether the descriptor at the given
+ * index is set in the bitset.
+ */
+#define plugin_search_index_bitset_get(bits,idx) \
+  (((bits)[(idx) / 64] >> ((idx) % 64)) & 1)
+
+/**
+ * Plugin types that can be filtered.
+ */
+typedef enum PluginSearchType
+{
+  PLUGIN_SEARCH_TYPE_INSTRUMENT,
+  PLUGIN_SEARCH_TYPE_EFFECT,
+  PLUGIN_SEARCH_TYPE_MODULATOR,
+  PLUGIN_SEARCH_TYPE_MIDI_MODIFIER,
+  NUM_PLUGIN_SEARCH_TYPES,
+} PluginSearchType;
+
+/**
+ * Criteria to filter the plugins with.
+ *
+ * Plugins are matched if they match any of the
+ * given categories, any of the given authors,
+ * any of the given protocols, all of the given
+ * types, the collection and the search string.
+ * Empty criteria match everything.
+ */
+typedef struct PluginSearchFilter
+{
+  const ZPluginCategory * categories;
+  int                     num_categories;
+
+  const char * const *    authors;
+  int                     num_authors;
+
+  const PluginProtocol *  protocols;
+  int                     num_protocols;
+
+  /** Whether each PluginSearchType is required. */
+  bool                    types[
+    NUM_PLUGIN_SEARCH_TYPES];
+
+  /** Collection the plugins must be part of, or
+   * NULL. */
+  PluginCollection *      collection;
+
+  /** String to look for in the name, author or
+   * category, ignoring case, or NULL. */
+  const char *            search;
+} PluginSearchFilter;
+
+/**
+ * Index of the plugin descriptors for fast
+ * filtering in the plugin browser.
+ *
+ * Each category, protocol, type and author has a
+ * bitset of the descriptors it applies to, where
+ * bit N is the descriptor at index N. Text search
+ * uses posting lists of the 1, 2 and 3-byte
+ * n-grams of the case-folded name, author and
+ * category, so a query only has to check the
+ * descriptors that contain all its trigrams.
+ *
+ * The index must be rebuilt when the descriptors
+ * change.
+ */
+typedef struct PluginSearchIndex
+{
+  /** Descriptors indexed (not owned). */
+  PluginDescriptor ** descriptors;
+  int                 num_descriptors;
+
+  /** Number of 64-bit words in each bitset. */
+  size_t              num_words;
+
+  /** Bitsets for each ZPluginCategory. */
+  uint64_t *          categories[
+    PLUGIN_SEARCH_INDEX_NUM_CATEGORIES];
+
+  /** Bitsets for each PluginProtocol. */
+  uint64_t *          protocols[
+    PLUGIN_SEARCH_INDEX_NUM_PROTOCOLS];
+
+  /** Bitsets for each PluginSearchType. */
+  uint64_t *          types[NUM_PLUGIN_SEARCH_TYPES];
+
+  /** Bitsets by author name. */
+  GHashTable *        authors;
+
+  /**
+   * Sorted arrays of descriptor indices (guint)
+   * by n-gram.
+   *
+   * The keys are the bytes of the n-gram packed
+   * into an integer with the length in the most
+   * significant byte.
+   */
+  GHashTable *        ngrams;
+
+  /** Case-folded search text of each
+   * descriptor. */
+  char **             keys;
+} PluginSearchIndex;
+
+/**
+ * Builds an index for the given descriptors.
+ *
+ * The descriptors must outlive the index.
+ *
+ * @param descriptors Array of PluginDescriptor.
+ */
+NONNULL
+PluginSearchIndex *
+plugin_search_index_new (
+  GPtrArray * descriptors);
+
+/**
+ * Returns a new bitset with no bits set, sized
+ * for this index.
+ *
+ * Must be free'd with free().
+ */
+NONNULL
+uint64_t *
+plugin_search_index_new_bitset (
+  PluginSearchIndex * self);
+
+/**
+ * Sets the bits of the descriptors matching the
+ * filter in the given bitset and clears the rest.
+ *
+ * @param result A bitset from
+ *   plugin_search_index_new_bitset().
+ *
+ * @return The number of matching descriptors.
+ */
+NONNULL
+int
+plugin_search_index_filter (
+  PluginSearchIndex *        self,
+  const PluginSearchFilter * filter,
+  uint64_t *                 result);
+
+NONNULL
+void
+plugin_search_index_free (
+  PluginSearchIndex * self);
+
+/**
+ * @}
+ */
+
+#endif
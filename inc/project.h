@@ -392,7 +392,12 @@ static const cyaml_schema_value_t
  */
 typedef struct ProjectSaveData
 {
-  /** Project clone (with memcpy). */
+  /**
+   * Deep clone of the project to serialize.
+   *
+   * Only the undo manager is shared with the live
+   * project instead of cloned.
+   */
   Project * project;
 
   /** Full path to save to. */
@@ -408,6 +413,16 @@ typedef struct ProjectSaveData
   /** Whether an error occured during saving. */
   bool      has_error;
 
+  /**
+   * Whether the project is serialized in another
+   * thread.
+   *
+   * If so, the undo manager is locked until the
+   * thread finishes, so the shared undo history
+   * does not change while being serialized.
+   */
+  bool      async;
+
   GenericProgressInfo progress_info;
 } ProjectSaveData;
 
@@ -449,6 +464,10 @@ project_create_default (
  * @param is_template Load the project as a
  *   template and create a new project from it.
  *
+ * Without a UI, newer backups are ignored and
+ * failing to load the file is an error (instead
+ * of offering to create a new project).
+ *
  * @return 0 if successful, non-zero otherwise.
  */
 COLD
@@ -566,11 +585,18 @@ project_get_existing_yaml (
  * Deep-clones the given project.
  *
  * To be used during save on the main thread.
+ *
+ * @param share_undo_manager Whether to reference
+ *   the undo manager of @p src instead of cloning
+ *   it. The caller must make sure that it does
+ *   not change while the clone is used and unset
+ *   it before freeing the clone.
  */
 NONNULL
 Project *
 project_clone (
-  const Project * src);
+  const Project * src,
+  bool            share_undo_manager);
 
 /**
  * Creates an empty project object.
@@ -60,6 +60,8 @@ typedef struct UserShortcuts UserShortcuts;
 
 /* ---- Preferences ---- */
 #define S_P_DSP_PAN SETTINGS->preferences_dsp_pan
+#define S_P_DSP_THREADS \
+  SETTINGS->preferences_dsp_threads
 #define S_P_EDITING_AUDIO \
   SETTINGS->preferences_editing_audio
 #define S_P_EDITING_AUTOMATION \
@@ -114,6 +116,7 @@ typedef struct Settings
   /** All preferences_* settings are to be shown in
    * the preferences dialog. */
   GSettings * preferences_dsp_pan;
+  GSettings * preferences_dsp_threads;
   GSettings * preferences_editing_audio;
   GSettings * preferences_editing_automation;
   GSettings * preferences_editing_undo;
@@ -110,6 +110,35 @@ mpmc_queue_dequeue (
   MPMCQueue * self,
   void **     data);
 
+/**
+ * Pushes up to @p num_data elements with a single
+ * update of the enqueue position.
+ *
+ * @return The number of elements pushed (less than
+ *   @p num_data only if the queue is full).
+ */
+HOT
+NONNULL
+size_t
+mpmc_queue_push_back_batch (
+  MPMCQueue *          self,
+  void * const * const data,
+  size_t               num_data);
+
+/**
+ * Dequeues up to @p max_data elements with a
+ * single update of the dequeue position.
+ *
+ * @return The number of elements dequeued.
+ */
+HOT
+NONNULL
+size_t
+mpmc_queue_dequeue_batch (
+  MPMCQueue * self,
+  void **     data,
+  size_t      max_data);
+
 /**
  * @}
  */
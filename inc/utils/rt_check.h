@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Detection of real-time violations on audio
+ * threads.
+ */
+
+#ifndef __UTILS_RT_CHECK_H__
+#define __UTILS_RT_CHECK_H__
+
+#include <stdbool.h>
+
+#include <glib.h>
+
+/**
+ * @addtogroup utils
+ *
+ * @{
+ */
+
+/**
+ * Environment variable that enables the checks
+ * when set to 1.
+ */
+#define RT_CHECK_ENV "ZRYTHM_RT_CHECK"
+
+/**
+ * Max number of violations to keep (the rest are
+ * only counted).
+ */
+#define RT_CHECK_MAX_VIOLATIONS 128
+
+/**
+ * Max number of backtrace frames to keep per
+ * violation.
+ */
+#define RT_CHECK_MAX_FRAMES 24
+
+typedef enum RtCheckViolationType
+{
+  RT_CHECK_VIOLATION_ALLOC,
+  RT_CHECK_VIOLATION_FREE,
+  RT_CHECK_VIOLATION_LOCK,
+  RT_CHECK_VIOLATION_LOG,
+} RtCheckViolationType;
+
+/**
+ * A call that is not allowed on real-time
+ * threads.
+ */
+typedef struct RtCheckViolation
+{
+  RtCheckViolationType type;
+
+  /** Name of the function called (static
+   * string). */
+  const char *         func;
+
+  /** Return addresses, resolved when
+   * printing. */
+  void *               frames[RT_CHECK_MAX_FRAMES];
+  int                  num_frames;
+} RtCheckViolation;
+
+/**
+ * Log of violations.
+ *
+ * Slots are claimed with an atomic increment, so
+ * recording never blocks or allocates.
+ */
+typedef struct RtCheck
+{
+  /** Whether checks are enabled. */
+  volatile gint    enabled;
+
+  /** Number of violations recorded (may exceed
+   * RT_CHECK_MAX_VIOLATIONS). */
+  volatile gint    num_violations;
+
+  /** Number of violations whose slot is fully
+   * written. */
+  volatile gint    num_written;
+
+  RtCheckViolation violations[
+    RT_CHECK_MAX_VIOLATIONS];
+} RtCheck;
+
+/**
+ * Enables or disables the checks.
+ *
+ * Allocation and blocking calls are only seen if
+ * the executable interposes them (see
+ * tests/helpers/rt_check.c). Log calls are always
+ * seen through the Zrythm log writer.
+ */
+void
+rt_check_set_enabled (
+  bool enabled);
+
+/**
+ * Returns whether the checks are enabled and the
+ * current thread is registered.
+ */
+bool
+rt_check_is_active (void);
+
+/**
+ * Marks the current thread as a real-time thread.
+ *
+ * To be called by the threads that
+ * router_is_processing_thread() returns true for,
+ * from the thread itself.
+ */
+void
+rt_check_register_thread (void);
+
+/**
+ * Unmarks the current thread (eg, when it is
+ * about to terminate).
+ */
+void
+rt_check_unregister_thread (void);
+
+/**
+ * Records a violation with a backtrace if the
+ * checks are active on the current thread.
+ *
+ * Safe to call from allocation functions.
+ *
+ * @param func Name of the function called.
+ */
+void
+rt_check_record (
+  RtCheckViolationType type,
+  const char *         func);
+
+/**
+ * Returns the number of violations so far.
+ */
+int
+rt_check_get_num_violations (void);
+
+/**
+ * Logs the recorded violations with their
+ * backtraces.
+ *
+ * Must not be called from a real-time thread.
+ */
+void
+rt_check_print_violations (void);
+
+/**
+ * Forgets the recorded violations.
+ *
+ * Must not be called while real-time threads are
+ * running.
+ */
+void
+rt_check_clear (void);
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * CPU affinity of real-time threads.
+ */
+
+#ifndef __UTILS_THREAD_AFFINITY_H__
+#define __UTILS_THREAD_AFFINITY_H__
+
+#include <stdbool.h>
+
+#include <glib.h>
+
+/**
+ * @addtogroup utils
+ *
+ * @{
+ */
+
+/** Max number of CPUs that can be used. */
+#define THREAD_AFFINITY_MAX_CPUS 1024
+
+/**
+ * Policy for placing threads on CPUs.
+ *
+ * Must match the "thread-affinity-policy" enum in
+ * the GSettings schema.
+ */
+typedef enum ThreadAffinityPolicy
+{
+  /** Let the OS schedule threads on any CPU. */
+  THREAD_AFFINITY_POLICY_NONE,
+
+  /** Pin each thread to a CPU from a
+   * user-provided list. */
+  THREAD_AFFINITY_POLICY_CORE_LIST,
+
+  /** Pin each thread to a different physical
+   * core. */
+  THREAD_AFFINITY_POLICY_PHYSICAL_CORES,
+
+  /** Let threads float, but only on one logical
+   * CPU per physical core (ie, never on SMT
+   * siblings). */
+  THREAD_AFFINITY_POLICY_NO_SMT_SIBLINGS,
+
+  /** Pin each thread to a CPU isolated from the
+   * scheduler with the isolcpus kernel
+   * parameter. */
+  THREAD_AFFINITY_POLICY_ISOLATED_CORES,
+} ThreadAffinityPolicy;
+
+static const char * thread_affinity_policy_str[] =
+{
+  __("None"),
+  __("Core list"),
+  __("One per physical core"),
+  __("Avoid SMT siblings"),
+  __("Isolated cores"),
+};
+
+/** Nicks used in the GSettings schema. */
+static const char * thread_affinity_policy_nicks[] =
+{
+  "none",
+  "core-list",
+  "physical-cores",
+  "no-smt-siblings",
+  "isolated-cores",
+};
+
+static inline const char *
+thread_affinity_policy_to_string (
+  ThreadAffinityPolicy policy)
+{
+  return thread_affinity_policy_str[policy];
+}
+
+/**
+ * Returns the policy with the given nick (see
+ * thread_affinity_policy_nicks), or -1 if
+ * invalid.
+ */
+int
+thread_affinity_policy_from_nick (
+  const char * nick);
+
+/**
+ * Parses a CPU list in the kernel's format (eg,
+ * "0-3,8,10-11").
+ *
+ * @param[out] cpus Array to fill, in ascending
+ *   order without duplicates.
+ *
+ * @return The number of CPUs, or -1 if the string
+ *   is malformed.
+ */
+int
+thread_affinity_parse_cpu_list (
+  const char * str,
+  int *        cpus,
+  int          max_cpus);
+
+/**
+ * Returns a newly allocated CPU list in the
+ * kernel's format (eg, "0-3,8").
+ */
+char *
+thread_affinity_cpu_list_to_string (
+  const int * cpus,
+  int         num_cpus);
+
+/**
+ * Fills in the CPUs that threads should be
+ * placed on for the given policy, in the order
+ * threads should be assigned to them.
+ *
+ * @param core_list CPU list to use with
+ *   THREAD_AFFINITY_POLICY_CORE_LIST.
+ *
+ * @return The number of CPUs, or 0 if the policy
+ *   is THREAD_AFFINITY_POLICY_NONE, not supported
+ *   on this platform or no CPUs are available for
+ *   it.
+ */
+int
+thread_affinity_get_cpus (
+  ThreadAffinityPolicy policy,
+  const char *         core_list,
+  int *                cpus,
+  int                  max_cpus);
+
+/**
+ * Returns whether each thread should be pinned to
+ * a single CPU from thread_affinity_get_cpus()
+ * for the given policy, as opposed to allowing it
+ * on all of them.
+ */
+bool
+thread_affinity_policy_pins_threads (
+  ThreadAffinityPolicy policy);
+
+/**
+ * Restricts the calling thread to the given CPUs.
+ *
+ * Does not allocate, so it can be called from a
+ * real-time thread.
+ *
+ * @return Whether successful.
+ */
+bool
+thread_affinity_set_current_thread (
+  const int * cpus,
+  int         num_cpus);
+
+/**
+ * Fills in the CPUs that the calling thread may
+ * run on.
+ *
+ * Does not allocate.
+ *
+ * @return The number of CPUs, or -1 if not
+ *   supported on this platform.
+ */
+int
+thread_affinity_get_current_thread (
+  int * cpus,
+  int   max_cpus);
+
+/**
+ * @}
+ */
+
+#endif
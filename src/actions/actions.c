@@ -34,6 +34,7 @@
 #include "audio/automation_function.h"
 #include "audio/graph.h"
 #include "audio/graph_export.h"
+#include "audio/graph_profiler.h"
 #include "audio/instrument_track.h"
 #include "audio/midi.h"
 #include "audio/midi_function.h"
@@ -64,6 +65,7 @@
 #include "gui/widgets/dialogs/string_entry_dialog.h"
 #include "gui/widgets/event_viewer.h"
 #include "gui/widgets/dialogs/export_dialog.h"
+#include "gui/widgets/dialogs/generic_progress_dialog.h"
 #include "gui/widgets/file_browser_window.h"
 #include "gui/widgets/foldable_notebook.h"
 #include "gui/widgets/header.h"
@@ -957,6 +959,59 @@ activate_export_graph (
 #endif
 }
 
+/**
+ * Waits for the profile started by
+ * activate_profile_graph() to finish and exports
+ * it.
+ */
+static int
+export_graph_profile_when_finished (
+  void * data)
+{
+  GraphProfiler * profiler = ROUTER->profiler;
+  if (!graph_profiler_is_finished (profiler))
+    return G_SOURCE_CONTINUE;
+
+  graph_profiler_print (profiler);
+
+  char * exports_dir =
+    project_get_path (
+      PROJECT, PROJECT_PATH_EXPORTS, false);
+  char * path =
+    g_build_filename (
+      exports_dir, "graph-profile.json", NULL);
+  GError * err = NULL;
+  bool success =
+    graph_profiler_export_chrome_trace (
+      profiler, path, &err);
+  if (success)
+    {
+      char * msg =
+        g_strdup_printf (
+          _("Graph profile exported to %s"), path);
+      ui_show_notification (msg);
+      g_free (msg);
+    }
+  else
+    {
+      HANDLE_ERROR (
+        err, "%s",
+        _("Failed to export graph profile"));
+    }
+  g_free (exports_dir);
+  g_free (path);
+
+  return G_SOURCE_REMOVE;
+}
+
+DEFINE_SIMPLE (activate_profile_graph)
+{
+  router_start_profiling (
+    ROUTER, GRAPH_PROFILER_DEFAULT_NUM_CYCLES);
+  g_timeout_add (
+    100, export_graph_profile_when_finished, NULL);
+}
+
 void
 activate_properties (GSimpleAction *action,
                   GVariant      *variant,
@@ -2488,6 +2543,8 @@ do_audio_func (
 
   GError * err = NULL;
   bool ret;
+  GenericProgressInfo progress_info = { 0 };
+  GenericProgressDialogWidget * progress_dialog;
   if (!arranger_selections_validate (sel))
     {
       goto free_audio_sel_and_return;
@@ -2495,14 +2552,42 @@ do_audio_func (
 
   zix_sem_wait (&PROJECT->save_sem);
 
+  /* the function processes UI events while it
+   * runs, so the dialog is updated and can cancel
+   * it */
+  strcpy (
+    progress_info.label_str,
+    _("Applying audio function..."));
+  strcpy (progress_info.label_done_str, _("Done"));
+  progress_dialog =
+    generic_progress_dialog_widget_new ();
+  generic_progress_dialog_widget_setup (
+    progress_dialog,
+    audio_function_type_to_string (type),
+    &progress_info, true, true);
+  gtk_window_set_transient_for (
+    GTK_WINDOW (progress_dialog),
+    GTK_WINDOW (MAIN_WINDOW));
+  gtk_window_set_modal (
+    GTK_WINDOW (progress_dialog), true);
+  gtk_widget_show (GTK_WIDGET (progress_dialog));
+
   ret =
     arranger_selections_action_perform_edit_audio_function (
-      sel, type, uri, &err);
+      sel, type, uri, &progress_info, &err);
+  gtk_widget_destroy (GTK_WIDGET (progress_dialog));
   if (!ret)
     {
-      HANDLE_ERROR (
-        err, "%s",
-        _("Failed to apply automation function"));
+      if (progress_info.cancelled)
+        {
+          g_clear_error (&err);
+        }
+      else
+        {
+          HANDLE_ERROR (
+            err, "%s",
+            _("Failed to apply audio function"));
+        }
     }
 
   zix_sem_post (&PROJECT->save_sem);
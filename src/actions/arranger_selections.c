@@ -591,10 +591,11 @@ arranger_selections_action_new_edit_automation_function (
  */
 UndoableAction *
 arranger_selections_action_new_edit_audio_function (
-  ArrangerSelections * sel_before,
-  AudioFunctionType    audio_func_type,
-  const char *         uri,
-  GError **            error)
+  ArrangerSelections *  sel_before,
+  AudioFunctionType     audio_func_type,
+  const char *          uri,
+  GenericProgressInfo * progress_info,
+  GError **             error)
 {
   /* prepare selections before */
   ArrangerSelections * sel_before_clone =
@@ -606,7 +607,7 @@ arranger_selections_action_new_edit_audio_function (
   int ret =
     audio_function_apply (
       sel_before_clone, AUDIO_FUNCTION_INVALID,
-      NULL, &err);
+      NULL, NULL, &err);
   if (ret != 0)
     {
       PROPAGATE_PREFIXED_ERROR (
@@ -622,7 +623,8 @@ arranger_selections_action_new_edit_audio_function (
   g_debug ("applying actual audio func...");
   ret =
     audio_function_apply (
-      sel_after, audio_func_type, uri, &err);
+      sel_after, audio_func_type, uri,
+      progress_info, &err);
   if (ret != 0)
     {
       PROPAGATE_PREFIXED_ERROR (
@@ -1067,15 +1069,16 @@ arranger_selections_action_perform_edit_automation_function (
 
 bool
 arranger_selections_action_perform_edit_audio_function (
-  ArrangerSelections * sel_before,
-  AudioFunctionType    audio_func_type,
-  const char *         uri,
-  GError **            error)
+  ArrangerSelections *  sel_before,
+  AudioFunctionType     audio_func_type,
+  const char *          uri,
+  GenericProgressInfo * progress_info,
+  GError **             error)
 {
   UNDO_MANAGER_PERFORM_AND_PROPAGATE_ERR (
     arranger_selections_action_new_edit_audio_function,
     error, sel_before, audio_func_type, uri,
-    error);
+    progress_info, error);
 }
 
 bool
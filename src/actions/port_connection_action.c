@@ -149,7 +149,10 @@ port_connection_action_do_or_undo (
             PORT_CONNECTIONS_MGR,
             &src->id, &dest->id);
         }
-      router_recalc_graph (ROUTER, F_NOT_SOFT);
+      router_update_port_connection (
+        ROUTER, src, dest,
+        (self->type == PORT_CONNECTION_CONNECT) ==
+          _do);
       break;
     case PORT_CONNECTION_ENABLE:
       prj_connection->enabled = _do ? true : false;
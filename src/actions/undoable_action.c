@@ -331,6 +331,11 @@ undoable_action_do (
 
   if (undoable_action_needs_pause (self))
     {
+      /* the action may have changed the BPM
+       * automation */
+      engine_update_tempo_automation (
+        AUDIO_ENGINE);
+
       /* restart engine */
       engine_resume (AUDIO_ENGINE, &state);
     }
@@ -424,6 +429,11 @@ undoable_action_undo (
 
   if (undoable_action_needs_pause (self))
     {
+      /* the action may have changed the BPM
+       * automation */
+      engine_update_tempo_automation (
+        AUDIO_ENGINE);
+
       /* restart engine */
       engine_resume (AUDIO_ENGINE, &state);
     }
@@ -33,6 +33,7 @@
 #include "utils/dsp.h"
 #include "utils/error.h"
 #include "utils/flags.h"
+#include "utils/objects.h"
 #include "utils/string.h"
 #include "zrythm_app.h"
 
@@ -41,6 +42,7 @@
 typedef enum
 {
   Z_AUDIO_AUDIO_FUNCTION_ERROR_INVALID_POSITIONS,
+  Z_AUDIO_AUDIO_FUNCTION_ERROR_CANCELLED,
 } ZAudioAudioFunctionError;
 
 #define Z_AUDIO_AUDIO_FUNCTION_ERROR \
@@ -111,6 +113,50 @@ audio_function_get_icon_name_for_type (
   g_return_val_if_reached (NULL);
 }
 
+
+/**
+ * Returns whether the progress info was
+ * cancelled.
+ */
+static inline bool
+is_cancelled (
+  GenericProgressInfo * progress_info)
+{
+  return progress_info && progress_info->cancelled;
+}
+
+/**
+ * Processes pending UI events so that a progress
+ * dialog can be redrawn and cancelled while a
+ * function is applied from the GTK thread.
+ *
+ * Only called when a progress info is given,
+ * since the caller must be prepared for the main
+ * loop to run.
+ */
+static void
+process_ui_events (void)
+{
+  if (!ZRYTHM_HAVE_UI || !ZRYTHM_APP_IS_GTK_THREAD)
+    return;
+
+  while (g_main_context_pending (NULL))
+    {
+      g_main_context_iteration (NULL, false);
+    }
+}
+
+static void
+set_cancelled_error (
+  GError ** error)
+{
+  g_set_error_literal (
+    error,
+    Z_AUDIO_AUDIO_FUNCTION_ERROR,
+    Z_AUDIO_AUDIO_FUNCTION_ERROR_CANCELLED,
+    _("Cancelled"));
+}
+
 /**
  * @param frames Interleaved frames.
  * @param num_frames Number of frames per channel.
@@ -120,11 +166,12 @@ audio_function_get_icon_name_for_type (
  */
 static int
 apply_plugin (
-  const char * uri,
-  float *      frames,
-  size_t       num_frames,
-  channels_t   channels,
-  GError **    error)
+  const char *          uri,
+  float *               frames,
+  size_t                num_frames,
+  channels_t            channels,
+  GenericProgressInfo * progress_info,
+  GError **             error)
 {
   PluginDescriptor * descr =
     plugin_manager_find_plugin_from_uri (
@@ -251,6 +298,16 @@ apply_plugin (
       r_out = l_out;
     }
 
+  /* offset of the right channel in the frames (the
+   * left channel is used for both in mono
+   * clips) */
+  size_t r_ch = channels > 1 ? 1 : 0;
+
+  /* the plugin keeps state between blocks, so the
+   * audio is streamed through it one block at a
+   * time. the output lags the input by the
+   * latency, so it can be written over the frames
+   * that were already read */
   size_t step =
     MIN (AUDIO_ENGINE->block_length, num_frames);
   size_t i = 0; /* frames processed */
@@ -258,12 +315,20 @@ apply_plugin (
   nframes_t latency = pl->latency;
   while (i < num_frames)
     {
+      if (is_cancelled (progress_info))
+        {
+          set_cancelled_error (error);
+          plugin_gtk_close_ui (pl);
+          plugin_free (pl);
+          return -1;
+        }
+
       for (size_t j = 0; j < step; j++)
         {
           l_in->buf[j] =
             frames[(i + j) * channels];
           r_in->buf[j] =
-            frames[(i + j) * channels + 1];
+            frames[(i + j) * channels + r_ch];
         }
       lv2_ui_read_and_apply_events (
         pl->lv2, step);
@@ -280,9 +345,10 @@ apply_plugin (
             actual_j,
             fabsf (l_out->buf[j]));
 #endif
-          frames[actual_j * channels] =
+          frames[actual_j * (long) channels] =
             l_out->buf[j];
-          frames[actual_j * channels + 1] =
+          frames[actual_j * (long) channels +
+                 (long) r_ch] =
             r_out->buf[j];
         }
       if (i > latency)
@@ -292,6 +358,13 @@ apply_plugin (
         }
       i += step;
       step = MIN (step, num_frames - i);
+
+      if (progress_info)
+        {
+          progress_info->progress =
+            (double) i / (double) num_frames;
+          process_ui_events ();
+        }
     }
 
   /* handle latency */
@@ -320,9 +393,10 @@ apply_plugin (
             actual_j,
             fabsf (l_out->buf[j]));
 #endif
-          frames[actual_j * channels] =
+          frames[actual_j * (long) channels] =
             l_out->buf[j];
-          frames[actual_j * channels + 1] =
+          frames[actual_j * (long) channels +
+                 (long) r_ch] =
             r_out->buf[j];
         }
       i += step;
@@ -337,6 +411,318 @@ apply_plugin (
   return 0;
 }
 
+typedef struct AudioFunctionJob
+  AudioFunctionJob;
+
+/**
+ * Processes the given frames of a chunk.
+ *
+ * @param start Frame to start at.
+ * @param num_frames Number of frames in the chunk.
+ */
+typedef void (*AudioFunctionChunkFunc) (
+  AudioFunctionJob * job,
+  size_t             chunk,
+  size_t             start,
+  size_t             num_frames);
+
+/**
+ * State shared by the chunks of a function.
+ */
+typedef struct AudioFunctionJob
+{
+  AudioFunctionType      type;
+
+  /** Original frames of the selected range
+   * (interleaved). */
+  const float *          src;
+
+  /** Frames to write to (interleaved). Initially
+   * a copy of \ref AudioFunctionJob.src. */
+  float *                dest;
+
+  /** Number of frames per channel. */
+  size_t                 num_frames;
+  size_t                 channels;
+
+  /** Nudge amount in frames. */
+  size_t                 nudge_frames;
+
+  /** Gain to normalize with. */
+  float                  gain;
+
+  /** Peak of each chunk. */
+  float *                peaks;
+
+  /** Function to run on each chunk. */
+  AudioFunctionChunkFunc func;
+
+  size_t                 num_chunks;
+
+  /** Number of passes over the chunks needed
+   * (used for the progress). */
+  size_t                 num_passes;
+
+  /** Number of chunks processed in all
+   * passes. */
+  volatile gint          chunks_done;
+
+  /** Number of chunks of the current pass not
+   * finished or skipped yet. */
+  volatile gint          chunks_pending;
+
+  GenericProgressInfo *  progress_info;
+} AudioFunctionJob;
+
+static void
+scan_peak (
+  AudioFunctionJob * job,
+  size_t             chunk,
+  size_t             start,
+  size_t             num_frames)
+{
+  float peak = 0.f;
+  dsp_abs_max (
+    &job->dest[start * job->channels], &peak,
+    num_frames * job->channels);
+  job->peaks[chunk] = peak;
+}
+
+static void
+apply_gain (
+  AudioFunctionJob * job,
+  size_t             chunk,
+  size_t             start,
+  size_t             num_frames)
+{
+  dsp_mul_k2 (
+    &job->dest[start * job->channels], job->gain,
+    num_frames * job->channels);
+}
+
+static void
+apply_fade (
+  AudioFunctionJob * job,
+  size_t             chunk,
+  size_t             start,
+  size_t             num_frames)
+{
+  /* the fade runs over the interleaved samples */
+  size_t offset = start * job->channels;
+  size_t total = job->num_frames * job->channels;
+  size_t size = num_frames * job->channels;
+  if (job->type == AUDIO_FUNCTION_LINEAR_FADE_IN)
+    {
+      dsp_linear_fade_in (
+        &job->dest[offset], offset, total, size);
+    }
+  else
+    {
+      dsp_linear_fade_out (
+        &job->dest[offset], offset, total, size);
+    }
+}
+
+static void
+apply_nudge (
+  AudioFunctionJob * job,
+  size_t             chunk,
+  size_t             start,
+  size_t             num_frames)
+{
+  size_t ch = job->channels;
+  size_t nudge = job->nudge_frames;
+  size_t end = start + num_frames;
+  float * dest = &job->dest[start * ch];
+
+  if (job->type == AUDIO_FUNCTION_NUDGE_LEFT)
+    {
+      /* frame i = original frame i + nudge, or
+       * silence past the end */
+      size_t src_end = job->num_frames - nudge;
+      size_t num_copied =
+        src_end > start ?
+          MIN (src_end, end) - start : 0;
+      dsp_copy (
+        dest, &job->src[(start + nudge) * ch],
+        num_copied * ch);
+      dsp_fill (
+        &dest[num_copied * ch], 0.f,
+        (num_frames - num_copied) * ch);
+    }
+  else
+    {
+      /* frame i = original frame i - nudge, or
+       * silence before the start */
+      size_t num_silent =
+        nudge > start ?
+          MIN (nudge, end) - start : 0;
+      dsp_fill (dest, 0.f, num_silent * ch);
+      if (num_silent < num_frames)
+        {
+          dsp_copy (
+            &dest[num_silent * ch],
+            &job->src[
+              (start + num_silent - nudge) * ch],
+            (num_frames - num_silent) * ch);
+        }
+    }
+}
+
+static void
+apply_reverse (
+  AudioFunctionJob * job,
+  size_t             chunk,
+  size_t             start,
+  size_t             num_frames)
+{
+  size_t ch = job->channels;
+  for (size_t i = start; i < start + num_frames;
+       i++)
+    {
+      size_t src_i = (job->num_frames - i) - 1;
+      for (size_t j = 0; j < ch; j++)
+        {
+          job->dest[i * ch + j] =
+            job->src[src_i * ch + j];
+        }
+    }
+}
+
+static void
+process_chunk (
+  AudioFunctionJob * job,
+  size_t             chunk)
+{
+  /* skip the remaining chunks when cancelled */
+  if (is_cancelled (job->progress_info))
+    return;
+
+  size_t start =
+    chunk * AUDIO_FUNCTION_CHUNK_FRAMES;
+  size_t num_frames =
+    MIN (
+      AUDIO_FUNCTION_CHUNK_FRAMES,
+      job->num_frames - start);
+  job->func (job, chunk, start, num_frames);
+
+  g_atomic_int_inc (&job->chunks_done);
+}
+
+static void
+chunk_worker (
+  gpointer data,
+  gpointer user_data)
+{
+  AudioFunctionJob * job =
+    (AudioFunctionJob *) user_data;
+  process_chunk (
+    job, GPOINTER_TO_SIZE (data) - 1);
+  g_atomic_int_dec_and_test (&job->chunks_pending);
+}
+
+/**
+ * Updates the progress info from the chunks
+ * done.
+ *
+ * Only called from the thread applying the
+ * function so that the progress never goes back.
+ */
+static void
+update_progress (
+  AudioFunctionJob * job)
+{
+  if (!job->progress_info)
+    return;
+
+  job->progress_info->progress =
+    (double) g_atomic_int_get (&job->chunks_done) /
+    (double) (job->num_chunks * job->num_passes);
+}
+
+/**
+ * Runs the given function on all chunks.
+ *
+ * The chunks are processed in parallel, so the
+ * function must only depend on the chunk.
+ *
+ * @return Non-zero if cancelled.
+ */
+static int
+run_chunks (
+  AudioFunctionJob *     job,
+  AudioFunctionChunkFunc func)
+{
+  job->func = func;
+
+  GThreadPool * thread_pool = NULL;
+  if (job->num_chunks > 1)
+    {
+      size_t num_threads =
+        MIN (
+          (size_t) g_get_num_processors (),
+          AUDIO_FUNCTION_MAX_THREADS);
+      num_threads =
+        MIN (num_threads, job->num_chunks);
+      GError * err = NULL;
+      thread_pool =
+        g_thread_pool_new (
+          chunk_worker, job, (int) num_threads,
+          false, &err);
+      if (!thread_pool)
+        {
+          g_warning (
+            "failed to create thread pool: %s",
+            err->message);
+          g_error_free (err);
+        }
+    }
+
+  if (thread_pool)
+    {
+      g_atomic_int_set (
+        &job->chunks_pending, (gint) job->num_chunks);
+      for (size_t i = 0; i < job->num_chunks; i++)
+        {
+          g_thread_pool_push (
+            thread_pool, GSIZE_TO_POINTER (i + 1),
+            NULL);
+        }
+
+      /* keep the progress and the UI updated until
+       * all chunks are done */
+      if (job->progress_info)
+        {
+          while (g_atomic_int_get (
+                   &job->chunks_pending) > 0)
+            {
+              update_progress (job);
+              process_ui_events ();
+              g_usleep (1000);
+            }
+        }
+
+      /* wait for all chunks */
+      g_thread_pool_free (thread_pool, false, true);
+    }
+  else
+    {
+      for (size_t i = 0; i < job->num_chunks; i++)
+        {
+          process_chunk (job, i);
+          if (job->progress_info)
+            {
+              update_progress (job);
+              process_ui_events ();
+            }
+        }
+    }
+
+  update_progress (job);
+
+  return is_cancelled (job->progress_info);
+}
+
 /**
  * Applies the given action to the given selections.
  *
@@ -349,15 +735,19 @@ apply_plugin (
  *   for the unchanged audio material (used in
  *   audio selection actions for the selections
  *   before the change).
+ * @param progress_info Optional progress info to
+ *   update while processing. If it gets cancelled,
+ *   processing stops and an error is returned.
  *
  * @return Non-zero if error.
  */
 int
 audio_function_apply (
-  ArrangerSelections * sel,
-  AudioFunctionType    type,
-  const char *         uri,
-  GError **            error)
+  ArrangerSelections *  sel,
+  AudioFunctionType     type,
+  const char *          uri,
+  GenericProgressInfo * progress_info,
+  GError **             error)
 {
   g_message (
     "applying %s...",
@@ -402,51 +792,71 @@ audio_function_apply (
   position_add_frames (
     &end, - r->base.pos.frames);
 
-  /* create a copy of the frames to be replaced */
   size_t num_frames =
     (size_t) (end.frames - start.frames);
-
-  /* interleaved frames */
   size_t channels = orig_clip->channels;
-  float src_frames[num_frames * channels];
-  float frames[num_frames * channels];
-  dsp_copy (
-    &frames[0],
-    &orig_clip->frames[
-      start.frames * (long) channels],
-    num_frames * channels);
-  dsp_copy (
-    &src_frames[0], &frames[0],
-    num_frames * channels);
+  g_return_val_if_fail (num_frames > 0, -1);
 
   long nudge_frames =
     position_get_frames_from_ticks (
       ARRANGER_SELECTIONS_DEFAULT_NUDGE_TICKS);
-  size_t nudge_frames_all_channels =
-    channels * (size_t) nudge_frames;
-  size_t num_frames_excl_nudge;
-
   g_debug (
     "num frames %zu, nudge_frames %ld",
     num_frames, nudge_frames);
   g_return_val_if_fail (nudge_frames > 0, -1);
 
+  /* the new clip starts as a copy of the selected
+   * range and is processed in place, reading the
+   * original frames from the region's clip where
+   * needed, so no other copies of the range are
+   * made */
+  AudioClip * clip =
+    audio_clip_new_from_float_array (
+      &orig_clip->frames[
+        start.frames * (long) channels],
+      (long) num_frames, (channels_t) channels,
+      BIT_DEPTH_32, orig_clip->name);
+  g_return_val_if_fail (clip, -1);
+
+  AudioFunctionJob job = {
+    .type = type,
+    .src =
+      &orig_clip->frames[
+        start.frames * (long) channels],
+    .dest = clip->frames,
+    .num_frames = num_frames,
+    .channels = channels,
+    .nudge_frames = (size_t) nudge_frames,
+    .num_chunks =
+      (num_frames + AUDIO_FUNCTION_CHUNK_FRAMES - 1)
+      / AUDIO_FUNCTION_CHUNK_FRAMES,
+    .num_passes = 1,
+    .progress_info = progress_info,
+  };
+
+  int ret = 0;
   switch (type)
     {
     case AUDIO_FUNCTION_INVERT:
-      dsp_mul_k2 (
-        &frames[0], -1.f, num_frames * channels);
+      job.gain = -1.f;
+      ret = run_chunks (&job, apply_gain);
       break;
     case AUDIO_FUNCTION_NORMALIZE_PEAK:
       /* peak-normalize */
       {
+        job.num_passes = 2;
+        job.peaks =
+          object_new_n (job.num_chunks, float);
+        ret = run_chunks (&job, scan_peak);
         float abs_peak = 0.f;
         dsp_abs_max (
-          &frames[0], &abs_peak,
-          num_frames * channels);
-        dsp_mul_k2 (
-          &frames[0], 1.f / abs_peak,
-          num_frames * channels);
+          job.peaks, &abs_peak, job.num_chunks);
+        free (job.peaks);
+        if (ret == 0 && abs_peak > 0.f)
+          {
+            job.gain = 1.f / abs_peak;
+            ret = run_chunks (&job, apply_gain);
+          }
       }
       break;
     case AUDIO_FUNCTION_NORMALIZE_RMS:
@@ -456,92 +866,67 @@ audio_function_apply (
       /* TODO lufs-normalize */
       break;
     case AUDIO_FUNCTION_LINEAR_FADE_IN:
-      dsp_linear_fade_in (
-        &frames[0], num_frames * channels);
-      break;
     case AUDIO_FUNCTION_LINEAR_FADE_OUT:
-      dsp_linear_fade_out (
-        &frames[0], num_frames * channels);
+      ret = run_chunks (&job, apply_fade);
       break;
     case AUDIO_FUNCTION_NUDGE_LEFT:
-      g_return_val_if_fail (
-        (long) num_frames > nudge_frames, -1);
-      num_frames_excl_nudge =
-        num_frames - (size_t) nudge_frames;
-      dsp_copy (
-        &frames[0],
-        &src_frames[nudge_frames_all_channels],
-        channels * num_frames_excl_nudge);
-      dsp_fill (
-        &frames[
-          channels * num_frames_excl_nudge],
-        0.f,
-        nudge_frames_all_channels);
-      break;
     case AUDIO_FUNCTION_NUDGE_RIGHT:
-      g_return_val_if_fail (
-        (long) num_frames > nudge_frames, -1);
-      num_frames_excl_nudge =
-        num_frames - (size_t) nudge_frames;
-      dsp_copy (
-        &frames[nudge_frames], &src_frames[0],
-        channels * num_frames_excl_nudge);
-      dsp_fill (
-        &frames[0], 0.f,
-        nudge_frames_all_channels);
-      break;
-    case AUDIO_FUNCTION_REVERSE:
-      for (size_t i = 0; i < num_frames; i++)
+      if ((long) num_frames <= nudge_frames)
         {
-          for (size_t j = 0; j < channels; j++)
-            {
-              frames[i * channels + j] =
-                orig_clip->frames[
-                  ((size_t) start.frames +
-                   ((num_frames - i) - 1)) *
-                    channels + j];
-            }
+          audio_clip_free (clip);
+          g_return_val_if_reached (-1);
         }
+      ret = run_chunks (&job, apply_nudge);
+      break;
+    case AUDIO_FUNCTION_REVERSE:
+      ret = run_chunks (&job, apply_reverse);
       break;
     case AUDIO_FUNCTION_EXT_PROGRAM:
       {
         AudioClip * tmp_clip =
           audio_clip_new_from_float_array (
-            src_frames, (long) num_frames, channels,
+            job.src, (long) num_frames,
+            (channels_t) channels,
             BIT_DEPTH_32, "tmp-clip");
         tmp_clip =
           audio_clip_edit_in_ext_program (tmp_clip);
         if (!tmp_clip)
-          return -1;
-        dsp_copy (
-          &frames[0], &tmp_clip->frames[0],
-          MIN (
-            num_frames,
-            (size_t) tmp_clip->num_frames) *
-          channels);
-        if ((size_t) tmp_clip->num_frames
-            < num_frames)
           {
-            dsp_fill (
-              &frames[0], 0.f,
-              (num_frames
-               - (size_t) tmp_clip->num_frames)
-              * channels);
+            audio_clip_free (clip);
+            return -1;
           }
+        size_t num_copied =
+          MIN (
+            num_frames,
+            (size_t) tmp_clip->num_frames);
+        dsp_copy (
+          &clip->frames[0], &tmp_clip->frames[0],
+          num_copied * channels);
+        dsp_fill (
+          &clip->frames[num_copied * channels], 0.f,
+          (num_frames - num_copied) * channels);
+        audio_clip_free (tmp_clip);
       }
       break;
     case AUDIO_FUNCTION_CUSTOM_PLUGIN:
       {
-        g_return_val_if_fail (uri, -1);
+        if (!uri)
+          {
+            audio_clip_free (clip);
+            g_return_val_if_reached (-1);
+          }
         GError * err = NULL;
-        int ret =
+        ret =
           apply_plugin (
-            uri, frames, num_frames, channels, &err);
+            uri, clip->frames, num_frames,
+            (channels_t) channels, progress_info,
+            &err);
         if (ret != 0)
           {
             PROPAGATE_PREFIXED_ERROR (
               error, err, "%s",
               _("Failed to apply plugin"));
+            audio_clip_free (clip);
             return ret;
           }
       }
@@ -554,6 +939,13 @@ audio_function_apply (
       break;
     }
 
+  if (ret != 0)
+    {
+      set_cancelled_error (error);
+      audio_clip_free (clip);
+      return -1;
+    }
+
 #if 0
   char * tmp =
     g_strdup_printf (
@@ -566,10 +958,13 @@ audio_function_apply (
   g_free (tmp);
 #endif
 
-  AudioClip * clip =
-    audio_clip_new_from_float_array (
-      &frames[0], (long) num_frames,
-      channels, BIT_DEPTH_32, orig_clip->name);
+  /* the channel caches were made from the
+   * unprocessed frames */
+  if (type != AUDIO_FUNCTION_INVALID)
+    {
+      audio_clip_update_channel_caches (clip, 0);
+    }
+
   audio_pool_add_clip (AUDIO_POOL, clip);
   g_message (
     "writing %s to pool (id %d)",
@@ -581,9 +976,12 @@ audio_function_apply (
 
   if (type != AUDIO_FUNCTION_INVALID)
     {
-      /* replace the frames in the region */
+      /* replace the frames in the region (only the
+       * range is kept in the new clip, and the
+       * region's clip is copied only if other
+       * regions play it) */
       audio_region_replace_frames (
-        r, frames, (size_t) start.frames,
+        r, clip->frames, (size_t) start.frames,
         num_frames, F_NO_DUPLICATE_CLIP);
     }
 
@@ -596,6 +994,11 @@ audio_function_apply (
         S_UI, "audio-function", type);
     }
 
+  if (progress_info)
+    {
+      progress_info->progress = 1.0;
+    }
+
   EVENTS_PUSH (ET_EDITOR_FUNCTION_APPLIED, NULL);
 
   return 0;
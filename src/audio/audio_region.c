@@ -22,6 +22,7 @@
 #include "audio/clip.h"
 #include "audio/fade.h"
 #include "audio/pool.h"
+#include "audio/stretch_cache.h"
 #include "audio/stretcher.h"
 #include "audio/tempo_track.h"
 #include "audio/track.h"
@@ -212,12 +213,46 @@ audio_region_set_clip_id (
   /* TODO update identifier - needed? */
 }
 
+/**
+ * Returns whether another region in the project
+ * plays the region's clip.
+ */
+static bool
+is_clip_shared (
+  ZRegion * self)
+{
+  for (int i = 0; i < TRACKLIST->num_tracks; i++)
+    {
+      Track * track = TRACKLIST->tracks[i];
+      if (track->type != TRACK_TYPE_AUDIO)
+        continue;
+
+      for (int j = 0; j < track->num_lanes; j++)
+        {
+          TrackLane * lane = track->lanes[j];
+          for (int k = 0; k < lane->num_regions; k++)
+            {
+              ZRegion * r = lane->regions[k];
+              if (r != self &&
+                  r->id.type == REGION_TYPE_AUDIO &&
+                  r->pool_id == self->pool_id)
+                return true;
+            }
+        }
+    }
+
+  return false;
+}
+
 /**
  * Replaces the region's frames from \ref
  * start_frames with \ref frames.
  *
- * @param duplicate_clip Whether to duplicate the
- *   clip (eg, when other regions refer to it).
+ * The clip is copied first if other regions play
+ * it, so that only this region is changed.
+ *
+ * @param duplicate_clip Whether to always
+ *   duplicate the clip.
  * @param frames Frames, interleaved.
  */
 void
@@ -231,11 +266,8 @@ audio_region_replace_frames (
   AudioClip * clip = audio_region_get_clip (self);
   g_return_if_fail (clip);
 
-  if (duplicate_clip)
+  if (duplicate_clip || is_clip_shared (self))
     {
-      g_warn_if_reached ();
-
-      /* TODO delete */
       int prev_id = clip->pool_id;
       int id =
         audio_pool_duplicate_clip (
@@ -247,11 +279,31 @@ audio_region_replace_frames (
 
       self->pool_id = clip->pool_id;
     }
+  else if (STRETCH_CACHE)
+    {
+      /* stretched versions of the clip (or the
+       * clip itself if it is a stretched version)
+       * no longer match */
+      stretch_cache_remove_clip (
+        STRETCH_CACHE, clip->pool_id);
+    }
 
   dsp_copy (
     &clip->frames[start_frame * clip->channels],
     frames, num_frames * clip->channels);
 
+  /* update the channel caches used during
+   * playback */
+  for (unsigned int i = 0; i < clip->channels; i++)
+    {
+      for (size_t j = start_frame;
+           j < start_frame + num_frames; j++)
+        {
+          clip->ch_frames[i][j] =
+            clip->frames[j * clip->channels + i];
+        }
+    }
+
   audio_clip_write_to_pool (
     clip, false, F_NOT_BACKUP);
 
@@ -636,6 +688,13 @@ audio_region_validate (
 void
 audio_region_free_members (ZRegion * self)
 {
+  /* the address may be reused by a new region */
+  if (PROJECT && AUDIO_ENGINE && STRETCH_CACHE)
+    {
+      stretch_cache_remove_region (
+        STRETCH_CACHE, self);
+    }
+
   object_free_w_func_and_null (
     audio_clip_free, self->clip);
 }
@@ -23,6 +23,7 @@
 #include "audio/automation_region.h"
 #include "audio/position.h"
 #include "audio/region.h"
+#include "gui/backend/arranger_object_index.h"
 #include "gui/backend/automation_selections.h"
 #include "gui/backend/event.h"
 #include "gui/backend/event_manager.h"
@@ -149,6 +150,9 @@ automation_region_add_ap (
   /* re-sort */
   automation_region_force_sort (self);
 
+  arranger_object_index_object_added (
+    self, (ArrangerObject *) ap);
+
   if (pub_events)
     {
       EVENTS_PUSH (ET_ARRANGER_OBJECT_CREATED, ap);
@@ -280,6 +284,9 @@ automation_region_remove_ap (
   array_delete (
     self->aps, self->num_aps, ap);
 
+  arranger_object_index_object_removed (
+    (ArrangerObject *) ap);
+
   if (!freeing_region)
     {
       for (int i = 0; i < self->num_aps; i++)
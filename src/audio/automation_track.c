@@ -25,6 +25,7 @@
 #include "audio/control_port.h"
 #include "audio/instrument_track.h"
 #include "audio/track.h"
+#include "gui/backend/arranger_object_index.h"
 #include "gui/backend/event_manager.h"
 #include "gui/widgets/arranger.h"
 #include "gui/widgets/center_dock.h"
@@ -280,6 +281,9 @@ automation_track_insert_region (
   region_set_automation_track (region, self);
   region->id.idx = idx;
   region_update_identifier (region);
+
+  arranger_object_index_object_added (
+    self, (ArrangerObject *) region);
 }
 
 AutomationTracklist *
@@ -646,6 +650,9 @@ automation_track_remove_region (
   array_delete (
     self->regions, self->num_regions, region);
 
+  arranger_object_index_object_removed (
+    (ArrangerObject *) region);
+
   for (int i = region->id.idx;
        i < self->num_regions; i++)
     {
@@ -974,6 +981,8 @@ automation_track_clone (
 void
 automation_track_free (AutomationTrack * self)
 {
+  arranger_object_index_container_freed (self);
+
   for (int i = 0; i < self->num_regions; i++)
     {
       object_free_w_func_and_null_cast (
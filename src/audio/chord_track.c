@@ -23,6 +23,7 @@
 #include "audio/chord_track.h"
 #include "audio/scale.h"
 #include "audio/track.h"
+#include "gui/backend/arranger_object_index.h"
 #include "gui/backend/event.h"
 #include "gui/backend/event_manager.h"
 #include "project.h"
@@ -90,6 +91,9 @@ chord_track_insert_chord_region (
   self->chord_regions[idx] = region;
   region->id.idx = idx;
   region_update_identifier (region);
+
+  arranger_object_index_object_added (
+    self, (ArrangerObject *) region);
 }
 
 /**
@@ -291,6 +295,9 @@ chord_track_remove_region (
     self->chord_regions, self->num_chord_regions,
     region);
 
+  arranger_object_index_object_removed (
+    (ArrangerObject *) region);
+
   for (int i = region->id.idx;
        i < self->num_chord_regions; i++)
     {
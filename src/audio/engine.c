@@ -66,11 +66,17 @@
 #include "audio/midi_event.h"
 #include "audio/midi_mapping.h"
 #include "audio/pool.h"
+#include "audio/port.h"
 #include "audio/recording_manager.h"
+#include "audio/rtmidi_device.h"
 #include "audio/router.h"
 #include "audio/sample_playback.h"
 #include "audio/sample_processor.h"
+#include "audio/stretch_cache.h"
+#include "audio/tempo_map.h"
 #include "audio/tempo_track.h"
+#include "audio/track_processor.h"
+#include "audio/tracklist.h"
 #include "audio/transport.h"
 #include "gui/backend/event.h"
 #include "gui/backend/event_manager.h"
@@ -83,6 +89,7 @@
 #include "utils/arrays.h"
 #include "utils/dsp.h"
 #include "utils/flags.h"
+#include "utils/math.h"
 #include "utils/mpmc_queue.h"
 #include "utils/object_pool.h"
 #include "utils/objects.h"
@@ -138,6 +145,107 @@ engine_set_buffer_size (
 #endif
 }
 
+/**
+ * Returns whether the current tempo map already
+ * includes the BPM automation being played back,
+ * in which case changes to the BPM port during
+ * processing don't need a new map.
+ */
+static bool
+tempo_map_has_current_automation (
+  AudioEngine * self)
+{
+  Transport * transport = self->transport;
+  const TempoMap * cur = self->tempo_map;
+  return
+    cur && cur->automated &&
+    transport->ticks_per_beat > 0 &&
+    cur->beats_per_bar ==
+      transport->ticks_per_bar /
+        transport->ticks_per_beat &&
+    math_doubles_equal (
+      cur->ticks_per_beat,
+      (double) transport->ticks_per_beat) &&
+    cur->sample_rate == self->sample_rate;
+}
+
+/**
+ * Updates the positions of the transport and the
+ * tracks after the tempo changed.
+ *
+ * @param update_from_ticks Whether to update the
+ *   positions based on ticks (true) or frames
+ *   (false).
+ */
+static void
+update_positions (
+  AudioEngine * self,
+  bool          update_from_ticks)
+{
+  transport_update_positions (
+    self->transport, update_from_ticks);
+
+  for (int i = 0; i < TRACKLIST->num_tracks; i++)
+    {
+      track_update_positions (
+        TRACKLIST->tracks[i], update_from_ticks);
+    }
+}
+
+static void
+set_frames_per_tick (
+  AudioEngine *       self,
+  const int           beats_per_bar,
+  const bpm_t         bpm,
+  const sample_rate_t sample_rate)
+{
+  g_message (
+    "frames per tick before: %f | "
+    "ticks per frame before: %f",
+    self->frames_per_tick,
+    self->ticks_per_frame);
+
+  self->frames_per_tick =
+    (((double) sample_rate * 60.0 *
+       (double) beats_per_bar) /
+    ((double) bpm *
+       (double) self->transport->ticks_per_bar));
+  self->ticks_per_frame =
+    1.0 / self->frames_per_tick;
+
+  g_message (
+    "frames per tick after: %f | "
+    "ticks per frame after: %f",
+    self->frames_per_tick,
+    self->ticks_per_frame);
+}
+
+/**
+ * Returns whether the engine must be locked
+ * before changing what the graph reads, and locks
+ * it between cycles if so.
+ */
+static bool
+lock_between_cycles (
+  AudioEngine * self)
+{
+  bool lock =
+    self->router && engine_get_run (self);
+  if (lock)
+    zix_sem_wait (&self->router->graph_access);
+
+  return lock;
+}
+
+static void
+unlock_between_cycles (
+  AudioEngine * self,
+  bool          locked)
+{
+  if (locked)
+    zix_sem_post (&self->router->graph_access);
+}
+
 /**
  * Updates frames per tick based on the time sig,
  * the BPM, and the sample rate
@@ -182,37 +290,287 @@ engine_update_frames_per_tick (
     sample_rate > 0 &&
     self->transport->ticks_per_bar > 0);
 
-  g_message (
-    "frames per tick before: %f | "
-    "ticks per frame before: %f",
-    self->frames_per_tick,
-    self->ticks_per_frame);
+  /* the tempo map can't be built during
+   * processing, so the GTK thread builds it and
+   * publishes it together with the new frames per
+   * tick and positions (see
+   * rebuild_pending_tempo_map()) */
+  if (g_thread_self () != zrythm_app->gtk_thread &&
+      engine_get_run (self) &&
+      !tempo_map_has_current_automation (self))
+    {
+      g_atomic_int_or (
+        &self->tempo_map_rebuild_pending,
+        ENGINE_TEMPO_MAP_REBUILD |
+          (update_from_ticks ?
+             ENGINE_TEMPO_MAP_REBUILD_FROM_TICKS :
+             0u));
+      return;
+    }
 
-  self->frames_per_tick =
-    (((double) sample_rate * 60.0 *
-       (double) beats_per_bar) /
-    ((double) bpm *
-       (double) self->transport->ticks_per_bar));
-  self->ticks_per_frame =
-    1.0 / self->frames_per_tick;
+  set_frames_per_tick (
+    self, beats_per_bar, bpm, sample_rate);
 
-  g_message (
-    "frames per tick after: %f | "
-    "ticks per frame after: %f",
-    self->frames_per_tick,
-    self->ticks_per_frame);
+  /* the current map already has the automation
+   * being played back */
+  if (g_thread_self () != zrythm_app->gtk_thread &&
+      engine_get_run (self))
+    return;
 
-  /* update positions */
-  transport_update_positions (
-    self->transport, update_from_ticks);
+  engine_update_tempo_map (self, bpm);
 
-  for (int i = 0; i < TRACKLIST->num_tracks; i++)
+  update_positions (self, update_from_ticks);
+}
+
+/**
+ * Builds a tempo map from the transport's time
+ * signature, the given BPM and the BPM
+ * automation.
+ *
+ * @return The new map, or NULL if it would be the
+ *   same as the current one.
+ */
+static TempoMap *
+build_tempo_map (
+  AudioEngine * self,
+  bpm_t         bpm)
+{
+  Transport * transport = self->transport;
+  int beats_per_bar =
+    transport->ticks_per_bar /
+      transport->ticks_per_beat;
+
+  if (bpm <= 0 && self->tempo_map)
     {
-      track_update_positions (
-        TRACKLIST->tracks[i], update_from_ticks);
+      bpm = self->tempo_map->bpm;
+    }
+  else if (bpm <= 0 && self->frames_per_tick > 0)
+    {
+      bpm =
+        (bpm_t)
+        (((double) self->sample_rate * 60.0 *
+           (double) beats_per_bar) /
+         (self->frames_per_tick *
+           (double) transport->ticks_per_bar));
+    }
+
+  /* nothing to convert with yet */
+  if (bpm <= 0 || self->sample_rate == 0)
+    return NULL;
+
+  TempoMap * map =
+    tempo_map_new (
+      beats_per_bar, transport->ticks_per_beat,
+      self->sample_rate, bpm);
+  g_return_val_if_fail (map, NULL);
+
+  Track * tempo_track =
+    self->project && self->project->tracklist ?
+      self->project->tracklist->tempo_track : NULL;
+  if (tempo_track && tempo_track->bpm_port->at)
+    {
+      tempo_track_fill_tempo_map (
+        tempo_track, map);
+    }
+  else
+    {
+      tempo_map_add_segment (map, 0.0, bpm);
+    }
+
+  if (self->tempo_map &&
+      tempo_map_is_equal (self->tempo_map, map))
+    {
+      tempo_map_free (map);
+      return NULL;
+    }
+
+  return map;
+}
+
+/**
+ * Publishes the given tempo map and retires the
+ * current one until no thread can be reading it.
+ *
+ * If the engine is running, it must be locked
+ * with lock_between_cycles().
+ */
+static void
+swap_tempo_map (
+  AudioEngine * self,
+  TempoMap *    map)
+{
+  TempoMap * prev = self->tempo_map;
+  g_atomic_pointer_set (&self->tempo_map, map);
+
+  /* threads outside the graph (eg, the JACK
+   * timebase callback) may still be reading the
+   * previous map */
+  if (prev)
+    {
+      RetiredTempoMap retired = {
+        .map = prev, .cycle = self->cycle, };
+      g_mutex_lock (&self->retired_tempo_maps_lock);
+      if (!self->retired_tempo_maps)
+        {
+          self->retired_tempo_maps =
+            g_array_new (
+              false, false,
+              sizeof (RetiredTempoMap));
+        }
+      g_array_append_val (
+        self->retired_tempo_maps, retired);
+      g_mutex_unlock (
+        &self->retired_tempo_maps_lock);
     }
 }
 
+/**
+ * Rebuilds \ref AudioEngine.tempo_map from the
+ * transport's time signature, the given BPM and
+ * the BPM automation.
+ *
+ * This must only be called from the GTK thread,
+ * during processing kickoff or while the engine
+ * is stopped. During processing kickoff the map
+ * is not built, it is only marked to be rebuilt
+ * by the GTK thread in engine_process_events().
+ *
+ * @param bpm BPM where there is no automation, or
+ *   0 to keep the current one.
+ *
+ * @return Whether the map changed.
+ */
+bool
+engine_update_tempo_map (
+  AudioEngine * self,
+  bpm_t         bpm)
+{
+  Transport * transport = self->transport;
+  g_return_val_if_fail (
+    transport && transport->ticks_per_beat > 0,
+    false);
+
+  if (g_thread_self () != zrythm_app->gtk_thread &&
+      engine_get_run (self))
+    {
+      if (!tempo_map_has_current_automation (self))
+        {
+          g_atomic_int_or (
+            &self->tempo_map_rebuild_pending,
+            ENGINE_TEMPO_MAP_REBUILD);
+        }
+      return false;
+    }
+
+  TempoMap * map = build_tempo_map (self, bpm);
+  if (!map)
+    return false;
+
+  bool locked = lock_between_cycles (self);
+  swap_tempo_map (self, map);
+  unlock_between_cycles (self, locked);
+
+  return true;
+}
+
+/**
+ * Frees the retired tempo maps that can no longer
+ * be read.
+ *
+ * @param all Free all maps, eg when freeing the
+ *   engine.
+ */
+static void
+free_retired_tempo_maps (
+  AudioEngine * self,
+  bool          all)
+{
+  g_mutex_lock (&self->retired_tempo_maps_lock);
+  GArray * arr = self->retired_tempo_maps;
+  for (guint i = 0; arr && i < arr->len;)
+    {
+      RetiredTempoMap * retired =
+        &g_array_index (arr, RetiredTempoMap, i);
+
+      /* the cycle running when the map was
+       * replaced may have read it, so wait for the
+       * next one to complete too */
+      if (all || self->cycle >= retired->cycle + 2)
+        {
+          tempo_map_free (retired->map);
+          g_array_remove_index_fast (arr, i);
+        }
+      else
+        {
+          i++;
+        }
+    }
+  g_mutex_unlock (&self->retired_tempo_maps_lock);
+}
+
+/**
+ * Rebuilds the tempo map if it was marked to be
+ * rebuilt during processing.
+ *
+ * Must be called from the GTK thread. The engine
+ * keeps running: the map is built first, then the
+ * frames per tick, the map and the positions are
+ * all updated between two cycles so that they
+ * never disagree.
+ */
+static void
+rebuild_pending_tempo_map (
+  AudioEngine * self,
+  guint         pending)
+{
+  if (!(pending & ENGINE_TEMPO_MAP_REBUILD) ||
+      !P_TEMPO_TRACK)
+    return;
+
+  int beats_per_bar =
+    tempo_track_get_beats_per_bar (P_TEMPO_TRACK);
+  bpm_t bpm =
+    tempo_track_get_current_bpm (P_TEMPO_TRACK);
+  g_return_if_fail (
+    beats_per_bar > 0 && bpm > 0 &&
+    self->sample_rate > 0 &&
+    self->transport->ticks_per_bar > 0);
+
+  TempoMap * map = build_tempo_map (self, bpm);
+
+  bool locked = lock_between_cycles (self);
+  set_frames_per_tick (
+    self, beats_per_bar, bpm, self->sample_rate);
+  if (map)
+    swap_tempo_map (self, map);
+  update_positions (
+    self,
+    pending & ENGINE_TEMPO_MAP_REBUILD_FROM_TICKS);
+  unlock_between_cycles (self, locked);
+}
+
+/**
+ * Rebuilds the tempo map after the BPM automation
+ * may have changed and updates the positions if
+ * the tempo changed.
+ *
+ * Must be called from the GTK thread while the
+ * engine is paused.
+ */
+void
+engine_update_tempo_automation (
+  AudioEngine * self)
+{
+  if (!engine_update_tempo_map (self, 0))
+    return;
+
+  g_message (
+    "tempo map changed, updating positions");
+
+  /* keep the musical positions */
+  update_positions (self, true);
+}
+
 /**
  * Cleans duplicate events and copies the events
  * to the given array.
@@ -257,6 +615,83 @@ clean_duplicates_and_copy (
     }
 }
 
+/**
+ * Grows the MIDI event buffers that dropped
+ * events.
+ *
+ * The engine keeps running. The buffers are
+ * grown between two cycles.
+ */
+static void
+grow_midi_buffers (
+  AudioEngine * self)
+{
+  GPtrArray * ports = g_ptr_array_new ();
+  port_get_all (ports);
+
+  bool held = engine_hold_processing (self);
+  for (size_t i = 0; i < ports->len; i++)
+    {
+      Port * port = g_ptr_array_index (ports, i);
+      if (port->id.type != TYPE_EVENT ||
+          !port->midi_events)
+        continue;
+
+      midi_events_grow_if_dropped (
+        port->midi_events);
+#ifdef HAVE_RTMIDI
+      for (int j = 0; j < port->num_rtmidi_ins;
+           j++)
+        {
+          midi_events_grow_if_dropped (
+            port->rtmidi_ins[j]->events);
+        }
+#endif
+    }
+  if (self->sample_processor &&
+      self->sample_processor->midi_events)
+    {
+      midi_events_grow_if_dropped (
+        self->sample_processor->midi_events);
+    }
+  engine_release_processing (self, held);
+
+  object_free_w_func_and_null (
+    g_ptr_array_unref, ports);
+}
+
+/**
+ * Creates the ports of the MIDI controls that
+ * received MIDI input while recording and
+ * recalculates the graph if any were created.
+ *
+ * The engine keeps running. The ports are
+ * created between two cycles.
+ */
+static void
+create_pending_midi_automatables (
+  AudioEngine * self)
+{
+  bool held = engine_hold_processing (self);
+  bool created = false;
+  for (int i = 0; i < TRACKLIST->num_tracks; i++)
+    {
+      Track * track = TRACKLIST->tracks[i];
+      if (track->processor &&
+          track_processor_create_pending_midi_automatables (
+            track->processor))
+        {
+          created = true;
+        }
+    }
+  engine_release_processing (self, held);
+
+  if (created)
+    {
+      router_recalc_graph (ROUTER, F_NOT_SOFT);
+    }
+}
+
 /**
  * GSourceFunc to be added using idle add.
  *
@@ -286,10 +721,29 @@ engine_process_events (
   clean_duplicates_and_copy (
     self, events, &num_events);
 
+  /* MIDI buffers can't grow while they are
+   * processed, so events that didn't fit were
+   * dropped. they are grown without pausing */
+  bool grow_midi =
+    midi_events_get_and_clear_overflow ();
+
+  /* MIDI controls recorded into don't have ports
+   * if they weren't used before. they are created
+   * without pausing */
+  bool create_midi_automatables =
+    track_processor_get_and_clear_pending ();
+
+  /* the tempo map can't be built during
+   * processing. it is rebuilt without pausing */
+  guint tempo_map_rebuild =
+    g_atomic_int_and (
+      &self->tempo_map_rebuild_pending, 0);
+
   /*g_debug ("%d EVENTS, waiting for pause", num_events);*/
 
   EngineState state;
-  if (self->activated && num_events > 0)
+  bool pause = num_events > 0;
+  if (self->activated && pause)
     {
       /* pause engine */
       engine_wait_for_pause (self, &state, F_FORCE);
@@ -357,12 +811,26 @@ engine_process_events (
   /*g_usleep (8000);*/
   /*project_validate (PROJECT);*/
 
-  if (self->activated && num_events > 0)
+  if (self->activated && pause)
     {
       /* continue engine */
       engine_resume (self, &state);
     }
 
+  if (grow_midi)
+    {
+      grow_midi_buffers (self);
+    }
+  if (create_midi_automatables)
+    {
+      create_pending_midi_automatables (self);
+    }
+
+  rebuild_pending_tempo_map (
+    self, tempo_map_rebuild);
+
+  free_retired_tempo_maps (self, false);
+
   self->last_events_processed =
     g_get_monotonic_time ();
 
@@ -735,6 +1203,7 @@ init_common (
     AUDIO_ENGINE_SCHEMA_VERSION;
   self->metronome = metronome_new ();
   self->router = router_new ();
+  self->stretch_cache = stretch_cache_new ();
 
   /* get audio backend */
   AudioBackend ab_code = AUDIO_BACKEND_DUMMY;
@@ -940,6 +1409,8 @@ engine_init_loaded (
 
   self->project = project;
 
+  g_mutex_init (&self->retired_tempo_maps_lock);
+
   audio_pool_init_loaded (self->pool);
 
   Track * tempo_track = NULL;
@@ -1028,6 +1499,8 @@ engine_new (
       project->audio_engine = self;
     }
 
+  g_mutex_init (&self->retired_tempo_maps_lock);
+
   self->sample_rate = 44000;
   self->transport = transport_new (self);
   self->pool = audio_pool_new ();
@@ -1181,6 +1654,38 @@ engine_resume (
     &self->run, (guint) state->running);
 }
 
+/**
+ * Skips processing cycles until
+ * engine_release_processing() is called, and waits
+ * for the current cycle to finish.
+ *
+ * @return Whether the engine was running.
+ */
+bool
+engine_hold_processing (
+  AudioEngine * self)
+{
+  if (!engine_get_run (self))
+    return false;
+
+  g_atomic_int_set (&self->run, 0);
+  while (g_atomic_int_get (&self->cycle_running))
+    {
+      g_usleep (100);
+    }
+
+  return true;
+}
+
+void
+engine_release_processing (
+  AudioEngine * self,
+  bool          held)
+{
+  if (held)
+    g_atomic_int_set (&self->run, 1);
+}
+
 /**
  * Waits for n processing cycles to finish.
  *
@@ -1331,6 +1836,12 @@ engine_realloc_port_buffers (
     "reallocating buffers...",
     AUDIO_ENGINE->block_length);
 
+  object_zero_and_free (self->silent_buf);
+  self->silent_buf = object_new_n (nframes, float);
+  object_zero_and_free (self->scratch_buf);
+  self->scratch_buf =
+    object_new_n (nframes, float);
+
   /* not needed anymore, buffers are allocated
    * during graph recalc */
 #if 0
@@ -2193,6 +2704,10 @@ engine_free (
 
   object_free_w_func_and_null (
     router_free, self->router);
+  object_free_w_func_and_null (
+    stretch_cache_free, self->stretch_cache);
+  object_zero_and_free (self->silent_buf);
+  object_zero_and_free (self->scratch_buf);
 
   switch (self->audio_backend)
     {
@@ -2248,6 +2763,12 @@ engine_free (
     control_room_free, self->control_room);
   object_free_w_func_and_null (
     transport_free, self->transport);
+  object_free_w_func_and_null (
+    tempo_map_free, self->tempo_map);
+  free_retired_tempo_maps (self, true);
+  object_free_w_func_and_null (
+    g_array_unref, self->retired_tempo_maps);
+  g_mutex_clear (&self->retired_tempo_maps_lock);
 
   object_free_w_func_and_null (
     object_pool_free, self->ev_pool);
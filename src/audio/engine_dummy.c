@@ -63,7 +63,7 @@ engine_dummy_setup (
   /* Set audio engine properties */
   self->midi_buf_size = 4096;
 
-  if (ZRYTHM_HAVE_UI && zrythm_app->buf_size > 0)
+  if (zrythm_app->buf_size > 0)
     {
       self->block_length =
         (nframes_t) zrythm_app->buf_size;
@@ -30,6 +30,7 @@
 #include "audio/midi.h"
 #include "audio/router.h"
 #include "audio/port.h"
+#include "audio/tempo_map.h"
 #include "audio/tempo_track.h"
 #include "audio/transport.h"
 #include "gui/widgets/main_window.h"
@@ -419,19 +420,14 @@ timebase_cb (
   pos->frame = (jack_nframes_t) PLAYHEAD->frames;
 
   /* BBT */
-  pos->bar = position_get_bars (PLAYHEAD, true);
-  pos->beat = position_get_beats (PLAYHEAD, true);
+  MusicalTime time;
+  position_get_musical_time (PLAYHEAD, true, &time);
+  pos->bar = time.bars;
+  pos->beat = time.beats;
   pos->tick =
-    position_get_sixteenths (PLAYHEAD, true) *
-    TICKS_PER_SIXTEENTH_NOTE +
-    (int) floor (position_get_ticks (PLAYHEAD));
-  Position bar_start;
-  position_set_to_bar (
-    &bar_start, position_get_bars (PLAYHEAD, true));
-  pos->bar_start_tick =
-    (double)
-    (PLAYHEAD->ticks -
-     bar_start.ticks);
+    time.sixteenths * TICKS_PER_SIXTEENTH_NOTE +
+    (int) floor (time.ticks);
+  pos->bar_start_tick = time.bar_ticks;
   pos->beats_per_bar =
     (float)
     tempo_track_get_beats_per_bar (P_TEMPO_TRACK);
@@ -33,6 +33,7 @@
 #include "audio/master_track.h"
 #include "audio/router.h"
 #include "audio/position.h"
+#include "audio/tempo_map.h"
 #include "audio/tempo_track.h"
 #include "audio/transport.h"
 #include "gui/widgets/main_window.h"
@@ -390,14 +391,23 @@ export_audio (
   do
     {
       /* calculate number of frames to process
-       * this time */
+       * this time, at the tempo at the
+       * playhead */
+      const TempoMap * map =
+        AUDIO_ENGINE->tempo_map;
+      long playhead_frames = PLAYHEAD->frames;
       double nticks =
         stop_pos.ticks -
           TRANSPORT->playhead_pos.ticks;
+      double frames_per_tick =
+        tempo_map_get_frames_per_tick (
+          map,
+          tempo_map_get_bpm_at_ticks (
+            map, TRANSPORT->playhead_pos.ticks));
       nframes =
         (nframes_t)
         MIN (
-          (long) ceil (AUDIO_ENGINE->frames_per_tick * nticks),
+          (long) ceil (frames_per_tick * nticks),
           (long) AUDIO_ENGINE->block_length);
       g_return_val_if_fail (nframes > 0, -1);
 
@@ -465,7 +475,10 @@ export_audio (
 
       covered_frames += nframes;
       covered_ticks +=
-        AUDIO_ENGINE->ticks_per_frame * nframes;
+        tempo_map_frames_to_ticks (
+          map, playhead_frames + (long) nframes) -
+        tempo_map_frames_to_ticks (
+          map, playhead_frames);
 #if 0
       long expected_nframes =
         TRANSPORT->playhead_pos.frames -
@@ -1268,12 +1268,13 @@ fader_process (
 
                   if (self->midi_mode ==
                         MIDI_FADER_MODE_VEL_MULTIPLIER &&
-                      ev->type ==
+                      midi_event_get_type (ev) ==
                         MIDI_EVENT_TYPE_NOTE_ON)
                     {
                       int new_vel =
                         (int)
-                        ((float) ev->velocity *
+                        ((float)
+                           midi_event_get_velocity (ev) *
                          self->amp->control);
                       midi_event_set_velocity (
                         ev,
@@ -40,9 +40,11 @@
 #include "audio/engine.h"
 #include "audio/fader.h"
 #include "audio/graph.h"
+#include "audio/graph_buffer_plan.h"
 #include "audio/graph_node.h"
 #include "audio/graph_thread.h"
 #include "audio/hardware_processor.h"
+#include "audio/midi_event.h"
 #include "audio/port.h"
 #include "audio/router.h"
 #include "audio/sample_processor.h"
@@ -50,6 +52,7 @@
 #include "audio/tracklist.h"
 #include "plugins/plugin.h"
 #include "project.h"
+#include "settings/settings.h"
 #include "utils/arrays.h"
 #include "utils/audio.h"
 #include "utils/env.h"
@@ -60,6 +63,11 @@
 #include "utils/objects.h"
 #include "utils/stoat.h"
 #include "utils/string.h"
+#include "zrythm.h"
+
+#include "zix/ring.h"
+
+#include <glib/gi18n.h>
 
 /* called from a terminal node (from the Graph
  * worked-thread) to indicate it has completed
@@ -114,16 +122,60 @@ graph_on_reached_terminal_node (
         (unsigned int) self->n_terminal_nodes);
 
       /* and start the initial nodes */
-      for (size_t i = 0;
-           i < self->n_init_triggers; ++i)
+      graph_push_ready_nodes (
+        self, self->init_trigger_list,
+        self->n_init_triggers);
+      /* continue in worker-thread */
+    }
+}
+
+void
+graph_push_ready_nodes (
+  Graph *       self,
+  GraphNode **  nodes,
+  size_t        num_nodes)
+{
+  size_t num_pushed = 0;
+  while (num_pushed < num_nodes)
+    {
+      size_t num_to_push =
+        MIN (
+          num_nodes - num_pushed,
+          GRAPH_TRIGGER_BATCH_SIZE);
+      g_atomic_int_add (
+        &self->trigger_queue_size,
+        (gint) num_to_push);
+      size_t batch_pushed =
+        mpmc_queue_push_back_batch (
+          self->trigger_queue,
+          (void * const *) &nodes[num_pushed],
+          num_to_push);
+      num_pushed += batch_pushed;
+      if (G_UNLIKELY (batch_pushed < num_to_push))
         {
-          g_atomic_int_inc (
-            &self->trigger_queue_size);
-          mpmc_queue_push_back_node (
-            self->trigger_queue,
-            self->init_trigger_list[i]);
+          /* the queue is sized for all nodes so
+           * this should never happen */
+          g_atomic_int_add (
+            &self->trigger_queue_size,
+            - (gint) (num_to_push - batch_pushed));
+          num_nodes = num_pushed;
+          break;
         }
-      /* continue in worker-thread */
+    }
+
+  if (num_nodes < 2)
+    return;
+
+  /* wake up one idle thread per node, except for
+   * the node this thread will process */
+  guint idle_cnt =
+    (guint)
+    g_atomic_int_get (&self->idle_thread_cnt);
+  guint wakeup =
+    MIN (idle_cnt, (guint) num_nodes - 1);
+  for (guint i = 0; i < wakeup; i++)
+    {
+      zix_sem_post (&self->trigger);
     }
 }
 
@@ -183,87 +235,252 @@ is_valid (
   return true;
 }
 
+static void
+port_connections_free (
+  GraphPortConnections * self)
+{
+  free (self->srcs);
+  free (self->src_connections);
+  free (self->dests);
+  free (self->dest_connections);
+  free (self->buf);
+  object_free_w_func_and_null (
+    midi_events_free, self->midi_events);
+  object_free_w_func_and_null (
+    zix_ring_free, self->midi_ring);
+  object_free_w_func_and_null (
+    zix_ring_free, self->audio_ring);
+
+  object_zero_and_free (self);
+}
+
+/**
+ * Frees the setup chain.
+ *
+ * After graph_rechain() this is the previous
+ * chain.
+ */
 static void
 clear_setup (
   Graph * self)
 {
   g_hash_table_remove_all (
     self->setup_graph_nodes);
+  g_hash_table_remove_all (
+    self->setup_port_connections);
   self->num_setup_init_triggers = 0;
   self->num_setup_terminal_nodes = 0;
+  self->setup_bpm_node = NULL;
+  self->setup_beats_per_bar_node = NULL;
+  self->setup_beat_unit_node = NULL;
+  object_free_w_func_and_null (
+    g_ptr_array_unref,
+    self->setup_external_out_ports);
+  object_free_w_func_and_null (
+    mpmc_queue_free, self->setup_trigger_queue);
+  object_free_w_func_and_null (
+    graph_buffer_plan_free,
+    self->setup_buffer_plan);
 }
 
+#define SWAP_PTRS(type,a,b) \
+  { \
+    type tmp_ = a; \
+    a = b; \
+    b = tmp_; \
+  }
+
+/**
+ * Swaps the sources/dests (and buffers, if any)
+ * in \ref conns with the port's, caches the
+ * owner plugin/track in the port and points the
+ * port to its shared buffer, if any.
+ */
 static void
+swap_port_connections (
+  GraphPortConnections * conns)
+{
+  Port * port = conns->port;
+  SWAP_PTRS (
+    Port **, port->srcs, conns->srcs);
+  SWAP_PTRS (
+    PortConnection **, port->src_connections,
+    conns->src_connections);
+  SWAP_PTRS (
+    int, port->num_srcs, conns->num_srcs);
+  SWAP_PTRS (
+    size_t, port->srcs_size,
+    conns->srcs_size);
+  SWAP_PTRS (
+    Port **, port->dests, conns->dests);
+  SWAP_PTRS (
+    PortConnection **, port->dest_connections,
+    conns->dest_connections);
+  SWAP_PTRS (
+    int, port->num_dests, conns->num_dests);
+  SWAP_PTRS (
+    size_t, port->dests_size,
+    conns->dests_size);
+  if (conns->buf)
+    {
+      float ** own_buf =
+        port->own_buf ? &port->own_buf : &port->buf;
+      SWAP_PTRS (float *, *own_buf, conns->buf);
+      SWAP_PTRS (
+        size_t, port->last_buf_sz,
+        conns->buf_size);
+    }
+  if (conns->midi_events)
+    {
+      SWAP_PTRS (
+        MidiEvents *, port->midi_events,
+        conns->midi_events);
+    }
+  if (conns->midi_ring)
+    {
+      SWAP_PTRS (
+        ZixRing *, port->midi_ring,
+        conns->midi_ring);
+    }
+  if (conns->audio_ring)
+    {
+      SWAP_PTRS (
+        ZixRing *, port->audio_ring,
+        conns->audio_ring);
+    }
+  if (conns->plugin)
+    port->plugin = conns->plugin;
+  if (conns->track)
+    port->track = conns->track;
+  if (conns->shared_buf)
+    {
+      if (!port->own_buf)
+        port->own_buf = port->buf;
+      port->buf = conns->shared_buf;
+    }
+  else
+    {
+      port_restore_own_buf (port);
+    }
+
+  /* the previous members are no longer
+   * attached to a live port */
+  conns->port = NULL;
+}
+
+/**
+ * Swaps the pending setup chain with the running
+ * chain.
+ *
+ * This only swaps pointers, so it is
+ * realtime-safe. It must be called between
+ * cycles, while holding the router's graph access
+ * semaphore.
+ *
+ * The previous chain is kept until the next
+ * graph_setup() so that any thread still finishing
+ * the previous cycle can safely access it.
+ */
+void
 graph_rechain (
   Graph * self)
 {
-  /*g_warn_if_fail (*/
-    /*g_atomic_int_get (*/
-      /*&self->terminal_refcnt) == 0);*/
+  if (!g_atomic_int_get (&self->setup_pending))
+    return;
+
   g_warn_if_fail (
     g_atomic_int_get (
       &self->trigger_queue_size) == 0);
 
-  /* --- swap setup nodes with graph nodes --- */
-  g_return_if_fail (
-    self->graph_nodes && self->setup_graph_nodes);
-  GHashTable * tmp =
-    g_hash_table_new_full (
-      g_direct_hash, g_direct_equal, NULL, NULL);
-  GHashTableIter iter;
-  gpointer key, value;
-  g_hash_table_iter_init (
-    &iter, self->graph_nodes);
-  while (g_hash_table_iter_next (
-           &iter, &key, &value))
+  SWAP_PTRS (
+    GHashTable *, self->graph_nodes,
+    self->setup_graph_nodes);
+  SWAP_PTRS (
+    GraphNode **, self->init_trigger_list,
+    self->setup_init_trigger_list);
+  SWAP_PTRS (
+    size_t, self->n_init_triggers,
+    self->num_setup_init_triggers);
+  SWAP_PTRS (
+    GraphNode **, self->terminal_nodes,
+    self->setup_terminal_nodes);
+  size_t num_terminal_nodes =
+    (size_t) self->n_terminal_nodes;
+  self->n_terminal_nodes =
+    (gint) self->num_setup_terminal_nodes;
+  self->num_setup_terminal_nodes =
+    num_terminal_nodes;
+  SWAP_PTRS (
+    GraphNode *, self->bpm_node,
+    self->setup_bpm_node);
+  SWAP_PTRS (
+    GraphNode *, self->beats_per_bar_node,
+    self->setup_beats_per_bar_node);
+  SWAP_PTRS (
+    GraphNode *, self->beat_unit_node,
+    self->setup_beat_unit_node);
+  SWAP_PTRS (
+    GPtrArray *, self->external_out_ports,
+    self->setup_external_out_ports);
+  if (self->setup_trigger_queue)
     {
-      g_hash_table_insert (tmp, key, value);
+      SWAP_PTRS (
+        MPMCQueue *, self->trigger_queue,
+        self->setup_trigger_queue);
     }
-  g_hash_table_steal_all (self->graph_nodes);
+  SWAP_PTRS (
+    GraphBufferPlan *, self->buffer_plan,
+    self->setup_buffer_plan);
 
+  /* swap the port sources/dests */
+  GHashTableIter iter;
+  gpointer value;
   g_hash_table_iter_init (
-    &iter, self->setup_graph_nodes);
+    &iter, self->setup_port_connections);
   while (g_hash_table_iter_next (
-           &iter, &key, &value))
+           &iter, NULL, &value))
     {
-      g_hash_table_insert (
-        self->graph_nodes, key, value);
+      swap_port_connections (
+        (GraphPortConnections *) value);
     }
-  g_hash_table_steal_all (self->setup_graph_nodes);
 
-  g_hash_table_iter_init (&iter, tmp);
-  while (g_hash_table_iter_next (
-           &iter, &key, &value))
-    {
-      g_hash_table_insert (
-        self->setup_graph_nodes, key, value);
-    }
-
-  /* --- end --- */
-
-  array_dynamic_swap (
-    &self->init_trigger_list,
-    &self->n_init_triggers,
-    &self->setup_init_trigger_list,
-    &self->num_setup_init_triggers);
-  array_dynamic_swap (
-    &self->terminal_nodes,
-    &self->n_terminal_nodes,
-    &self->setup_terminal_nodes,
-    &self->num_setup_terminal_nodes);
-
-  /*self->n_terminal_nodes =*/
-    /*(int) self->num_setup_terminal_nodes;*/
   g_atomic_int_set (
     &self->terminal_refcnt,
     (guint) self->n_terminal_nodes);
 
-  mpmc_queue_reserve (
-    self->trigger_queue,
-    (size_t)
-    g_hash_table_size (self->graph_nodes));
+  g_atomic_int_set (&self->setup_pending, 0);
+}
 
-  clear_setup (self);
+#undef SWAP_PTRS
+
+/**
+ * Updates the latency of the plugins in the setup
+ * chain that the running chain doesn't process.
+ *
+ * Plugins are run to get their latency, so this
+ * can't be done for plugins that are being
+ * processed. Those already report their latency
+ * changes while processing.
+ */
+static void
+update_new_plugin_latencies (
+  Graph * self)
+{
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init (
+    &iter, self->setup_graph_nodes);
+  while (g_hash_table_iter_next (
+           &iter, NULL, &value))
+    {
+      GraphNode * node = (GraphNode *) value;
+      if (node->type != ROUTE_NODE_TYPE_PLUGIN ||
+          g_hash_table_contains (
+            self->graph_nodes, node->pl))
+        continue;
+
+      plugin_update_latency (node->pl);
+    }
 }
 
 static void
@@ -383,50 +600,30 @@ graph_destroy (
 }
 
 /**
- * Add the port to the nodes.
- *
- * @param drop_if_unnecessary Drops the port
- *   if it doesn't connect anywhere.
- *
- * @return The graph node, if created.
+ * Returns the current sources and destinations
+ * of the port according to the port connections
+ * manager.
  */
-static GraphNode *
-add_port (
-  Graph *    self,
-  Port *     port,
-  const bool drop_if_unnecessary)
+static GraphPortConnections *
+get_port_connections (
+  Port * port)
 {
-  PortOwnerType owner = port->id.owner_type;
-
-  if (owner == PORT_OWNER_TYPE_PLUGIN)
-    {
-      port->plugin = port_get_plugin (port, true);
-      g_return_val_if_fail (
-        IS_PLUGIN_AND_NONNULL (port->plugin),
-        NULL);
-    }
-
-  if (port->id.track_name_hash != 0)
-    {
-      port->track = port_get_track (port, true);
-      g_return_val_if_fail (
-        IS_TRACK_AND_NONNULL (port->track), NULL);
-    }
+  GraphPortConnections * conns =
+    object_new (GraphPortConnections);
+  conns->port = port;
 
-  /* reset port sources/dests */
   GPtrArray * srcs = g_ptr_array_new ();
   int num_srcs =
     port_connections_manager_get_sources_or_dests (
       PORT_CONNECTIONS_MGR, srcs, &port->id,
       true);
-  port->srcs_size = (size_t) num_srcs;
-  port->srcs =
-    object_realloc_n (
-      port->srcs, 0, port->srcs_size, Port *);
-  port->src_connections =
-    object_realloc_n (
-      port->src_connections, 0, port->srcs_size,
-      PortConnection *);
+  conns->srcs_size = (size_t) num_srcs;
+  conns->srcs =
+    object_new_n (
+      MAX (conns->srcs_size, 1), Port *);
+  conns->src_connections =
+    object_new_n (
+      MAX (conns->srcs_size, 1), PortConnection *);
 #if 0
   if (num_srcs > 0)
     g_debug (
@@ -439,12 +636,12 @@ add_port (
         (PortConnection *)
         g_ptr_array_index (srcs, i);
 
-      port->srcs[i] =
+      conns->srcs[i] =
         port_find_from_identifier (conn->src_id);
-      g_return_val_if_fail (port->srcs[i], NULL);
-      port->src_connections[i] = conn;
+      g_return_val_if_fail (conns->srcs[i], NULL);
+      conns->src_connections[i] = conn;
     }
-  port->num_srcs = num_srcs;
+  conns->num_srcs = num_srcs;
   g_ptr_array_unref (srcs);
 
   GPtrArray * dests = g_ptr_array_new ();
@@ -452,14 +649,13 @@ add_port (
     port_connections_manager_get_sources_or_dests (
       PORT_CONNECTIONS_MGR, dests, &port->id,
       false);
-  port->dests_size = (size_t) num_dests;
-  port->dests =
-    object_realloc_n (
-      port->dests, 0, port->dests_size, Port *);
-  port->dest_connections =
-    object_realloc_n (
-      port->dest_connections, 0, port->dests_size,
-      PortConnection *);
+  conns->dests_size = (size_t) num_dests;
+  conns->dests =
+    object_new_n (
+      MAX (conns->dests_size, 1), Port *);
+  conns->dest_connections =
+    object_new_n (
+      MAX (conns->dests_size, 1), PortConnection *);
 #if 0
   if (num_dests > 0)
     g_debug (
@@ -472,43 +668,53 @@ add_port (
         (PortConnection *)
         g_ptr_array_index (dests, i);
 
-      port->dests[i] =
+      conns->dests[i] =
         port_find_from_identifier (conn->dest_id);
-      g_return_val_if_fail (port->dests[i], NULL);
-      port->dest_connections[i] = conn;
+      g_return_val_if_fail (conns->dests[i], NULL);
+      conns->dest_connections[i] = conn;
     }
-  port->num_dests = num_dests;
+  conns->num_dests = num_dests;
   g_ptr_array_unref (dests);
 
-  if (drop_if_unnecessary)
+  return conns;
+}
+
+/**
+ * Returns whether the port can be left out of
+ * the graph given its sources/dests.
+ */
+static bool
+is_port_unnecessary (
+  Port *                 port,
+  GraphPortConnections * conns)
+{
+  PortOwnerType owner = port->id.owner_type;
+
+  /* skip unnecessary control ports */
+  if (port->id.type == TYPE_CONTROL
+      && port->id.flags & PORT_FLAG_AUTOMATABLE)
     {
-      /* skip unnecessary control ports */
-      if (port->id.type == TYPE_CONTROL
-          && port->id.flags & PORT_FLAG_AUTOMATABLE)
+      AutomationTrack * found_at = port->at;
+      if (!found_at)
         {
-          AutomationTrack * found_at = port->at;
-          if (!found_at)
-            {
 #if 0
-              found_at =
-                automation_track_find_from_port (
-                  port, port->track, true);
+          found_at =
+            automation_track_find_from_port (
+              port, port->track, true);
 #endif
-            }
-          g_return_val_if_fail (found_at, NULL);
-          if (found_at->num_regions == 0
-              && port->num_srcs == 0)
-            {
-              return NULL;
-            }
+        }
+      g_return_val_if_fail (found_at, true);
+      if (found_at->num_regions == 0
+          && conns->num_srcs == 0)
+        {
+          return true;
         }
     }
 
   /* drop ports without sources and dests */
-  if (
-    drop_if_unnecessary
-    && port->num_dests == 0
-    && port->num_srcs == 0
+  return
+    conns->num_dests == 0
+    && conns->num_srcs == 0
     && owner != PORT_OWNER_TYPE_PLUGIN
     && owner != PORT_OWNER_TYPE_FADER
     && owner != PORT_OWNER_TYPE_TRACK_PROCESSOR
@@ -521,15 +727,76 @@ add_port (
     && owner != PORT_OWNER_TYPE_AUDIO_ENGINE
     && owner != PORT_OWNER_TYPE_HW
     && owner != PORT_OWNER_TYPE_TRANSPORT
-    && !(port->id.flags & PORT_FLAG_MANUAL_PRESS))
+    && !(port->id.flags & PORT_FLAG_MANUAL_PRESS);
+}
+
+/**
+ * Allocates the buffers the port is missing in
+ * \ref conns, to be swapped in when rechaining.
+ */
+static void
+prepare_bufs (
+  GraphPortConnections * conns)
+{
+  size_t buf_size =
+    port_create_missing_bufs (
+      conns->port, &conns->midi_events,
+      &conns->midi_ring, &conns->audio_ring);
+  if (buf_size > 0)
+    {
+      conns->buf = object_new_n (buf_size, float);
+      conns->buf_size = buf_size;
+    }
+}
+
+/**
+ * Add the port to the nodes.
+ *
+ * @param drop_if_unnecessary Drops the port
+ *   if it doesn't connect anywhere.
+ *
+ * @return The graph node, if created.
+ */
+static GraphNode *
+add_port (
+  Graph *    self,
+  Port *     port,
+  const bool drop_if_unnecessary)
+{
+  PortOwnerType owner = port->id.owner_type;
+
+  /* calculate the port sources/dests without
+   * touching the port (they are swapped in when
+   * rechaining) */
+  GraphPortConnections * conns =
+    get_port_connections (port);
+  g_return_val_if_fail (conns, NULL);
+  g_hash_table_insert (
+    self->setup_port_connections, port, conns);
+
+  if (owner == PORT_OWNER_TYPE_PLUGIN)
+    {
+      conns->plugin = port_get_plugin (port, true);
+      g_return_val_if_fail (
+        IS_PLUGIN_AND_NONNULL (conns->plugin),
+        NULL);
+    }
+
+  if (port->id.track_name_hash != 0)
+    {
+      conns->track = port_get_track (port, true);
+      g_return_val_if_fail (
+        IS_TRACK_AND_NONNULL (conns->track),
+        NULL);
+    }
+
+  if (drop_if_unnecessary
+      && is_port_unnecessary (port, conns))
     {
       return NULL;
     }
   else
     {
-      /* allocate buffers to be used during
-       * DSP */
-      port_allocate_bufs (port);
       return
         graph_create_node (
           self, ROUTE_NODE_TYPE_PORT, port);
@@ -546,10 +813,15 @@ connect_port (
 {
   GraphNode * node =
     graph_find_node_from_port (self, port);
+  GraphPortConnections * conns =
+    (GraphPortConnections *)
+    g_hash_table_lookup (
+      self->setup_port_connections, port);
+  g_return_if_fail (conns);
   GraphNode * node2;
-  for (int j = 0; j < port->num_srcs; j++)
+  for (int j = 0; j < conns->num_srcs; j++)
     {
-      Port * src = port->srcs[j];
+      Port * src = conns->srcs[j];
       node2 =
         graph_find_node_from_port (self, src);
       g_warn_if_fail (node);
@@ -560,9 +832,9 @@ connect_port (
 #endif
       graph_node_connect (node2, node);
     }
-  for (int j = 0; j < port->num_dests; j++)
+  for (int j = 0; j < conns->num_dests; j++)
     {
-      Port * dest = port->dests[j];
+      Port * dest = conns->dests[j];
       node2 =
         graph_find_node_from_port (self, dest);
       g_warn_if_fail (node);
@@ -651,12 +923,20 @@ graph_update_latencies (
 }
 
 /*
- * Adds the graph nodes and connections, then
- * rechains.
+ * Adds the graph nodes and connections to the
+ * setup chain.
+ *
+ * This does not modify anything used by the
+ * processing threads, so it can run while the
+ * graph is processing. When rechaining, the
+ * latencies are calculated here as well so that
+ * graph_rechain() only has to swap the chains.
  *
  * @param drop_unnecessary_ports Drops any ports
  *   that don't connect anywhere.
- * @param rechain Whether to rechain or not. If
+ * @param rechain Whether to allocate the port
+ *   buffers and mark the setup as pending so that
+ *   it can be swapped in by graph_rechain(). If
  *   we are just validating this should be 0.
  */
 void
@@ -667,6 +947,11 @@ graph_setup (
 {
   GraphNode * node, * node2;
 
+  /* free the previous chain (or any setup that
+   * was never swapped in) */
+  g_atomic_int_set (&self->setup_pending, 0);
+  clear_setup (self);
+
   /* ========================
    * first add all the nodes
    * ======================== */
@@ -715,7 +1000,6 @@ graph_setup (
             continue;
 
           add_plugin (self, pl);
-          plugin_update_latency (pl);
         }
 
       /* add the modulator macro processors */
@@ -760,7 +1044,6 @@ graph_setup (
             continue;
 
           add_plugin (self, pl);
-          plugin_update_latency (pl);
         }
 
       /* add sends */
@@ -786,9 +1069,8 @@ graph_setup (
         }
     }
 
-  object_free_w_func_and_null (
-    g_ptr_array_unref, self->external_out_ports);
-  self->external_out_ports = g_ptr_array_new ();
+  self->setup_external_out_ports =
+    g_ptr_array_new ();
 
   /* add ports */
   Port * port;
@@ -815,7 +1097,7 @@ graph_setup (
           port->internal_type == INTERNAL_JACK_PORT)
         {
           g_ptr_array_add (
-            self->external_out_ports, port);
+            self->setup_external_out_ports, port);
         }
 #endif
 
@@ -1018,48 +1300,22 @@ graph_setup (
         }
       if (track_type_has_piano_roll (tr->type))
         {
-          for (int j = 0; j < 16; j++)
+          /* only the MIDI controls in use have
+           * ports */
+          for (int j = 0;
+               j < TRACK_PROCESSOR_NUM_MIDI_AUTOMATABLES;
+               j++)
             {
-              for (int k = 0; k < 128; k++)
-                {
-                  port =
-                    tr->processor->midi_cc[j * 128 + k];
-                  node2 =
-                    graph_find_node_from_port (
-                      self, port);
-                  if (node2)
-                    {
-                      graph_node_connect (
-                        node2, node);
-                    }
-                }
-
               port =
-                tr->processor->pitch_bend[j];
-              node2 =
-                graph_find_node_from_port (
-                  self, port);
-              if (node2 || !drop_unnecessary_ports)
-                {
-                  graph_node_connect (node2, node);
-                }
-
-              port =
-                tr->processor->poly_key_pressure[j];
-              node2 =
-                graph_find_node_from_port (
-                  self, port);
-              if (node2 || !drop_unnecessary_ports)
-                {
-                  graph_node_connect (node2, node);
-                }
+                track_processor_get_midi_automatable (
+                  tr->processor, j);
+              if (!port)
+                continue;
 
-              port =
-                tr->processor->channel_pressure[j];
               node2 =
                 graph_find_node_from_port (
                   self, port);
-              if (node2 || !drop_unnecessary_ports)
+              if (node2)
                 {
                   graph_node_connect (node2, node);
                 }
@@ -1067,16 +1323,16 @@ graph_setup (
         }
       if (tr->type == TRACK_TYPE_TEMPO)
         {
-          self->bpm_node = NULL;
-          self->beats_per_bar_node = NULL;
-          self->beat_unit_node = NULL;
+          self->setup_bpm_node = NULL;
+          self->setup_beats_per_bar_node = NULL;
+          self->setup_beat_unit_node = NULL;
 
           port = tr->bpm_port;
           node2 =
             graph_find_node_from_port (self, port);
           if (node2 || !drop_unnecessary_ports)
             {
-              self->bpm_node = node2;
+              self->setup_bpm_node = node2;
               graph_node_connect (node2, node);
             }
           port = tr->beats_per_bar_port;
@@ -1084,7 +1340,7 @@ graph_setup (
             graph_find_node_from_port (self, port);
           if (node2 || !drop_unnecessary_ports)
             {
-              self->beats_per_bar_node = node2;
+              self->setup_beats_per_bar_node = node2;
               graph_node_connect (node2, node);
             }
           port = tr->beat_unit_port;
@@ -1092,7 +1348,7 @@ graph_setup (
             graph_find_node_from_port (self, port);
           if (node2 || !drop_unnecessary_ports)
             {
-              self->beat_unit_node = node2;
+              self->setup_beat_unit_node = node2;
               graph_node_connect (node2, node);
             }
           graph_node_connect (
@@ -1418,27 +1674,78 @@ graph_setup (
    * processor
    * ======================== */
 
+  if (rechain)
+    update_new_plugin_latencies (self);
   graph_update_latencies (self, true);
 
-  /* ========================
-   * set up caches to tracks, channels, plugins,
-   * automation tracks, etc.
-   *
-   * this is because indices can be changed by the
-   * GUI thread while the graph is running
-   * TODO or maybe not needed since there is a lock
-   * now
-   * ======================== */
-
-  clip_editor_set_caches (CLIP_EDITOR);
-  tracklist_set_caches (TRACKLIST);
-
   /*graph_print (self);*/
 
   g_ptr_array_unref (ports);
 
+  /* allocate the buffers the ports in the graph
+   * will need during DSP */
   if (rechain)
-    graph_rechain (self);
+    {
+      g_hash_table_iter_init (
+        &iter, self->setup_graph_nodes);
+      while (g_hash_table_iter_next (
+               &iter, NULL, &value))
+        {
+          node = (GraphNode *) value;
+          if (node->type != ROUTE_NODE_TYPE_PORT)
+            continue;
+
+          GraphPortConnections * conns =
+            (GraphPortConnections *)
+            g_hash_table_lookup (
+              self->setup_port_connections,
+              node->port);
+          g_return_if_fail (conns);
+          prepare_bufs (conns);
+        }
+    }
+
+  /* the running trigger queue can't be resized
+   * while processing, so use a new one if it is
+   * too small */
+  size_t num_nodes =
+    g_hash_table_size (self->setup_graph_nodes);
+  if (self->trigger_queue->buffer_mask + 1 <
+        num_nodes)
+    {
+      self->setup_trigger_queue =
+        mpmc_queue_new ();
+      mpmc_queue_reserve (
+        self->setup_trigger_queue, num_nodes);
+    }
+
+  /* let ports with disjoint lifetimes share
+   * buffers (the ports are pointed to them when
+   * rechaining) */
+  if (rechain && self->share_port_buffers)
+    {
+      self->setup_buffer_plan =
+        graph_buffer_plan_new (
+          self->setup_graph_nodes,
+          MAX (AUDIO_ENGINE->block_length, 1));
+      for (int i = 0;
+           i < self->setup_buffer_plan->num_entries;
+           i++)
+        {
+          GraphBufferPlanEntry * entry =
+            &self->setup_buffer_plan->entries[i];
+          GraphPortConnections * conns =
+            (GraphPortConnections *)
+            g_hash_table_lookup (
+              self->setup_port_connections,
+              entry->port);
+          g_return_if_fail (conns);
+          conns->shared_buf = entry->buf;
+        }
+    }
+
+  if (rechain)
+    g_atomic_int_set (&self->setup_pending, 1);
 }
 
 /**
@@ -1489,7 +1796,368 @@ graph_validate_with_connection (
 }
 
 /**
- * Starts as many threads as there are cores.
+ * Returns whether \ref to can be reached from
+ * \ref from.
+ */
+static bool
+node_reaches (
+  GraphNode *  from,
+  GraphNode *  to,
+  GHashTable * visited)
+{
+  if (from == to)
+    return true;
+  if (g_hash_table_contains (visited, from))
+    return false;
+  g_hash_table_add (visited, from);
+
+  for (int i = 0; i < from->n_childnodes; i++)
+    {
+      if (node_reaches (
+            from->childnodes[i], to, visited))
+        return true;
+    }
+
+  return false;
+}
+
+/**
+ * Adds the node and all nodes leading to it to
+ * both \ref nodes and \ref nodes_arr.
+ */
+static void
+add_ancestors (
+  GraphNode *  node,
+  GHashTable * nodes,
+  GPtrArray *  nodes_arr)
+{
+  if (g_hash_table_contains (nodes, node))
+    return;
+  g_hash_table_add (nodes, node);
+  g_ptr_array_add (nodes_arr, node);
+
+  for (int i = 0; i < node->init_refcount; i++)
+    {
+      add_ancestors (
+        node->parentnodes[i], nodes, nodes_arr);
+    }
+}
+
+/**
+ * Recalculates the route playback latency of the
+ * node from its children.
+ *
+ * This gives the same result as
+ * graph_update_latencies() as long as the
+ * children that are not in \ref stale are up to
+ * date.
+ *
+ * @param stale Nodes whose route latency needs to
+ *   be recalculated. Nodes are removed as they
+ *   are recalculated.
+ */
+static nframes_t
+recalc_route_playback_latency (
+  GraphNode *  node,
+  GHashTable * stale)
+{
+  if (!g_hash_table_remove (stale, node))
+    return node->route_playback_latency;
+
+  nframes_t latency = node->playback_latency;
+  for (int i = 0; i < node->n_childnodes; i++)
+    {
+      latency =
+        MAX (
+          latency,
+          recalc_route_playback_latency (
+            node->childnodes[i], stale));
+    }
+  node->route_playback_latency = latency;
+
+  return latency;
+}
+
+/**
+ * Adds or removes the node from the initial and
+ * terminal node lists according to its flags.
+ */
+static void
+update_initial_and_terminal_lists (
+  Graph *     self,
+  GraphNode * node)
+{
+  bool in_terminals =
+    array_contains (
+      self->terminal_nodes,
+      self->n_terminal_nodes, node);
+  if (node->terminal && !in_terminals)
+    {
+      self->terminal_nodes =
+        (GraphNode **) realloc (
+          self->terminal_nodes,
+          (size_t) (1 + self->n_terminal_nodes) *
+            sizeof (GraphNode *));
+      self->terminal_nodes[
+        self->n_terminal_nodes++] = node;
+    }
+  else if (!node->terminal && in_terminals)
+    {
+      array_delete (
+        self->terminal_nodes,
+        self->n_terminal_nodes, node);
+    }
+
+  bool in_triggers =
+    array_contains (
+      self->init_trigger_list,
+      (int) self->n_init_triggers, node);
+  if (node->initial && !in_triggers)
+    {
+      self->init_trigger_list =
+        (GraphNode **) realloc (
+          self->init_trigger_list,
+          (1 + self->n_init_triggers) *
+            sizeof (GraphNode *));
+      self->init_trigger_list[
+        self->n_init_triggers++] = node;
+    }
+  else if (!node->initial && in_triggers)
+    {
+      array_delete (
+        self->init_trigger_list,
+        self->n_init_triggers, node);
+    }
+}
+
+/**
+ * Applies a single port connection change to the
+ * running graph without rebuilding it.
+ *
+ * Only the edge between the nodes of the ports
+ * and the sources/dests of the 2 ports are
+ * updated, and playback latencies are only
+ * recalculated along the affected routes.
+ *
+ * The connection must already be added to or
+ * removed from the port connections manager.
+ * This takes the router's graph access semaphore
+ * while patching.
+ *
+ * @param connected Whether the ports were
+ *   connected (otherwise disconnected).
+ *
+ * @return Whether the change was applied. If
+ *   not, nothing was changed and the graph needs
+ *   to be set up again with graph_setup(), eg
+ *   because a port that was left out of the graph
+ *   is needed now or vice versa.
+ */
+bool
+graph_update_port_connection (
+  Graph * self,
+  Port *  src,
+  Port *  dest,
+  bool    connected)
+{
+  /* a pending setup does not know about this
+   * change and would undo it */
+  if (g_atomic_int_get (&self->setup_pending))
+    return false;
+
+  /* the running nodes only change in
+   * graph_rechain(), which only happens after a
+   * graph_setup() */
+  GraphNode * src_node =
+    (GraphNode *)
+    g_hash_table_lookup (self->graph_nodes, src);
+  GraphNode * dest_node =
+    (GraphNode *)
+    g_hash_table_lookup (self->graph_nodes, dest);
+  if (!src_node || !dest_node)
+    return false;
+
+  if (connected)
+    {
+      GHashTable * visited =
+        g_hash_table_new (NULL, NULL);
+      bool creates_cycle =
+        node_reaches (dest_node, src_node, visited);
+      g_hash_table_destroy (visited);
+      if (creates_cycle)
+        return false;
+    }
+
+  if (self->buffer_plan &&
+      !graph_buffer_plan_allows_edge_change (
+        self->buffer_plan, src_node, dest_node,
+        connected))
+    return false;
+
+  GraphPortConnections * src_conns =
+    get_port_connections (src);
+  GraphPortConnections * dest_conns =
+    get_port_connections (dest);
+  if (!src_conns || !dest_conns ||
+      (!connected &&
+       (is_port_unnecessary (src, src_conns) ||
+        is_port_unnecessary (dest, dest_conns))))
+    {
+      object_free_w_func_and_null (
+        port_connections_free, src_conns);
+      object_free_w_func_and_null (
+        port_connections_free, dest_conns);
+      return false;
+    }
+
+  /* keep using the same buffers */
+  src_conns->shared_buf =
+    src->own_buf ? src->buf : NULL;
+  dest_conns->shared_buf =
+    dest->own_buf ? dest->buf : NULL;
+
+  /* the routes through the source are the only
+   * ones whose latency may go down */
+  GHashTable * stale = NULL;
+  GPtrArray * stale_nodes = NULL;
+  if (!connected)
+    {
+      stale = g_hash_table_new (NULL, NULL);
+      stale_nodes = g_ptr_array_new ();
+      add_ancestors (src_node, stale, stale_nodes);
+    }
+
+  zix_sem_wait (&self->router->graph_access);
+
+  if (connected)
+    {
+      graph_node_connect (src_node, dest_node);
+      graph_node_set_route_playback_latency (
+        src_node,
+        dest_node->route_playback_latency);
+    }
+  else
+    {
+      graph_node_disconnect (src_node, dest_node);
+      for (size_t i = 0; i < stale_nodes->len; i++)
+        {
+          recalc_route_playback_latency (
+            (GraphNode *)
+            g_ptr_array_index (stale_nodes, i),
+            stale);
+        }
+    }
+
+  update_initial_and_terminal_lists (
+    self, src_node);
+  update_initial_and_terminal_lists (
+    self, dest_node);
+
+  swap_port_connections (src_conns);
+  swap_port_connections (dest_conns);
+
+  g_atomic_int_set (
+    &self->terminal_refcnt,
+    (guint) self->n_terminal_nodes);
+
+  zix_sem_post (&self->router->graph_access);
+
+  /* these now hold the previous sources/dests */
+  port_connections_free (src_conns);
+  port_connections_free (dest_conns);
+  if (stale)
+    {
+      g_hash_table_destroy (stale);
+      g_ptr_array_unref (stale_nodes);
+    }
+
+  return true;
+}
+
+/**
+ * Reads the CPU affinity preferences (or their
+ * environment overrides) and fills in the CPUs
+ * to place the threads on.
+ */
+static void
+init_affinity (
+  Graph * self)
+{
+  self->affinity_policy =
+    THREAD_AFFINITY_POLICY_NONE;
+  char * core_list = NULL;
+  if (ZRYTHM && SETTINGS && S_P_DSP_THREADS)
+    {
+      self->affinity_policy =
+        (ThreadAffinityPolicy)
+        g_settings_get_enum (
+          S_P_DSP_THREADS, "affinity-policy");
+      core_list =
+        g_settings_get_string (
+          S_P_DSP_THREADS, "affinity-cores");
+    }
+
+  const char * env_policy =
+    g_getenv ("ZRYTHM_DSP_THREAD_AFFINITY");
+  if (env_policy)
+    {
+      int policy =
+        thread_affinity_policy_from_nick (
+          env_policy);
+      if (policy >= 0)
+        {
+          self->affinity_policy =
+            (ThreadAffinityPolicy) policy;
+        }
+      else
+        {
+          g_warning (
+            "invalid thread affinity policy '%s'",
+            env_policy);
+        }
+    }
+  const char * env_cores =
+    g_getenv ("ZRYTHM_DSP_THREAD_CORES");
+  if (env_cores)
+    {
+      g_free (core_list);
+      core_list = g_strdup (env_cores);
+    }
+
+  if (!self->affinity_cpus)
+    {
+      self->affinity_cpus =
+        object_new_n (
+          THREAD_AFFINITY_MAX_CPUS, int);
+    }
+  self->num_affinity_cpus =
+    thread_affinity_get_cpus (
+      self->affinity_policy, core_list,
+      self->affinity_cpus,
+      THREAD_AFFINITY_MAX_CPUS);
+  g_free (core_list);
+
+  if (self->affinity_policy !=
+        THREAD_AFFINITY_POLICY_NONE)
+    {
+      char * cpus_str =
+        thread_affinity_cpu_list_to_string (
+          self->affinity_cpus,
+          self->num_affinity_cpus);
+      g_message (
+        "DSP thread affinity: %s (CPUs: %s)",
+        thread_affinity_policy_to_string (
+          self->affinity_policy),
+        self->num_affinity_cpus > 0 ?
+          cpus_str : "none available, ignoring");
+      g_free (cpus_str);
+    }
+}
+
+/**
+ * Starts as many threads as there are cores, or
+ * as there are cores to place them on if a CPU
+ * affinity policy is used.
  *
  * @return 1 if graph started, 0 otherwise.
  */
@@ -1497,14 +2165,35 @@ int
 graph_start (
   Graph * graph)
 {
-  int num_cores =
-    MIN (
-      MAX_GRAPH_THREADS,
-      audio_get_num_cores ());
+  init_affinity (graph);
+
+  /* dedicated cores are used up entirely (the
+   * main thread takes one), otherwise leave one
+   * core for the rest of the system */
+  int num_cores = audio_get_num_cores ();
+  int default_num_threads = num_cores - 2;
+  if (graph->num_affinity_cpus > 0)
+    {
+      if (graph->affinity_policy ==
+            THREAD_AFFINITY_POLICY_CORE_LIST ||
+          graph->affinity_policy ==
+            THREAD_AFFINITY_POLICY_ISOLATED_CORES)
+        {
+          default_num_threads =
+            graph->num_affinity_cpus - 1;
+        }
+      else
+        {
+          default_num_threads =
+            graph->num_affinity_cpus - 2;
+        }
+    }
   graph->num_threads =
     env_get_int (
       "ZRYTHM_DSP_THREADS",
-      num_cores - 2);
+      MIN (
+        MAX_GRAPH_THREADS - 1,
+        default_num_threads));
   g_warn_if_fail (graph->num_threads >= 0);
 
   graph->num_threads =
@@ -1553,6 +2242,41 @@ graph_start (
   return 1;
 }
 
+char *
+graph_get_thread_affinity_str (
+  Graph * self)
+{
+  GString * str = g_string_new (NULL);
+  for (int i = 0; i < self->num_threads + 1; i++)
+    {
+      GraphThread * thread =
+        i < self->num_threads ?
+          self->threads[i] : self->main_thread;
+      if (!thread)
+        continue;
+
+      if (str->len > 0)
+        {
+          g_string_append_c (str, '\n');
+        }
+      if (thread->id == -1)
+        {
+          g_string_append (str, _("Main thread"));
+        }
+      else
+        {
+          g_string_append_printf (
+            str, _("Thread %d"), thread->id);
+        }
+      g_string_append_printf (
+        str, ": %s",
+        thread->affinity[0] ?
+          thread->affinity : _("unknown"));
+    }
+
+  return g_string_free (str, false);
+}
+
 /**
  * Returns a new graph.
  */
@@ -1578,6 +2302,13 @@ graph_new (
     g_hash_table_new_full (
       g_direct_hash, g_direct_equal, NULL,
       (GDestroyNotify) graph_node_free);
+  self->setup_port_connections =
+    g_hash_table_new_full (
+      g_direct_hash, g_direct_equal, NULL,
+      (GDestroyNotify) port_connections_free);
+  self->external_out_ports = g_ptr_array_new ();
+  self->share_port_buffers =
+    !env_get_int ("ZRYTHM_NO_BUFFER_SHARING", 0);
 
   zix_sem_init (&self->callback_start, 0);
   zix_sem_init (&self->callback_done, 0);
@@ -1909,6 +2640,24 @@ graph_free (
 
   object_free_w_func_and_null (
     g_ptr_array_unref, self->external_out_ports);
+  object_free_w_func_and_null (
+    g_hash_table_unref,
+    self->setup_port_connections);
+  object_free_w_func_and_null (
+    g_ptr_array_unref,
+    self->setup_external_out_ports);
+  object_free_w_func_and_null (
+    mpmc_queue_free, self->trigger_queue);
+  object_free_w_func_and_null (
+    mpmc_queue_free, self->setup_trigger_queue);
+  object_zero_and_free (
+    self->setup_terminal_nodes);
+  object_free_w_func_and_null (
+    graph_buffer_plan_free, self->buffer_plan);
+  object_free_w_func_and_null (
+    graph_buffer_plan_free,
+    self->setup_buffer_plan);
+  object_zero_and_free (self->affinity_cpus);
 
   zix_sem_destroy (&self->callback_start);
   zix_sem_destroy (&self->callback_done);
@@ -0,0 +1,587 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio/graph_buffer_plan.h"
+#include "audio/graph_node.h"
+#include "audio/port.h"
+#include "utils/objects.h"
+
+#include <glib.h>
+
+/**
+ * A port that can use a shared buffer.
+ */
+typedef struct Candidate
+{
+  GraphNode * node;
+
+  /** Node that writes to the buffer first. */
+  GraphNode * writer;
+
+  /** Position of the writer in the topological
+   * order. */
+  int         writer_pos;
+
+  /** Position of the node in the topological
+   * order. */
+  int         node_pos;
+} Candidate;
+
+static int
+candidate_cmp (
+  const void * _a,
+  const void * _b)
+{
+  const Candidate * a = (const Candidate *) _a;
+  const Candidate * b = (const Candidate *) _b;
+  if (a->writer_pos != b->writer_pos)
+    return a->writer_pos - b->writer_pos;
+  return a->node_pos - b->node_pos;
+}
+
+/**
+ * Returns whether the buffer of the port is only
+ * accessed by the nodes next to the port's node.
+ */
+static bool
+is_port_shareable (
+  Port * port,
+  size_t buf_size)
+{
+  if (port->id.type != TYPE_AUDIO)
+    return false;
+
+  switch (port->id.owner_type)
+    {
+    case PORT_OWNER_TYPE_PLUGIN:
+    case PORT_OWNER_TYPE_TRACK_PROCESSOR:
+    case PORT_OWNER_TYPE_CHANNEL_SEND:
+      break;
+    case PORT_OWNER_TYPE_FADER:
+      /* post-fader outputs are read by the
+       * monitor fader when listening */
+      if (!(port->id.flags2 & PORT_FLAG2_PREFADER))
+        return false;
+      break;
+    default:
+      return false;
+    }
+
+  return port->min_buf_size <= buf_size;
+}
+
+/**
+ * Returns the node that writes to the port's
+ * buffer first in each cycle, or NULL if the
+ * port's buffer can't be shared.
+ */
+static GraphNode *
+get_writer (
+  GraphNode * node)
+{
+  /* terminal ports may be read after the
+   * cycle */
+  if (node->n_childnodes == 0)
+    return NULL;
+
+  if (node->port->id.flow == FLOW_OUTPUT)
+    {
+      /* outputs are written by the processor
+       * feeding them */
+      if (node->init_refcount != 1 ||
+          node->parentnodes[0]->type ==
+            ROUTE_NODE_TYPE_PORT)
+        return NULL;
+
+      return node->parentnodes[0];
+    }
+
+  /* inputs are written by their own node (which
+   * sums the sources), so the parents must not
+   * write to them */
+  for (int i = 0; i < node->init_refcount; i++)
+    {
+      GraphNodeType type =
+        node->parentnodes[i]->type;
+      if (type != ROUTE_NODE_TYPE_PORT &&
+          type != ROUTE_NODE_TYPE_INITIAL_PROCESSOR)
+        return NULL;
+    }
+
+  return node;
+}
+
+static float *
+alloc_pool (
+  size_t size)
+{
+  float * pool =
+#if defined (_WOE32) || defined (__APPLE__)
+    malloc (
+#else
+    aligned_alloc (
+      GRAPH_BUFFER_PLAN_ALIGNMENT,
+#endif
+      size);
+  g_return_val_if_fail (pool, NULL);
+  memset (pool, 0, size);
+
+  return pool;
+}
+
+/**
+ * Assigns shared buffers to the ports of the
+ * given nodes and points each clearing node to
+ * its entries.
+ *
+ * @param nodes Graph nodes (key = internal
+ *   pointer, value = graph node). The node IDs
+ *   must be their index.
+ * @param buf_size Number of floats needed in each
+ *   buffer.
+ */
+GraphBufferPlan *
+graph_buffer_plan_new (
+  GHashTable * nodes,
+  size_t       buf_size)
+{
+  GraphBufferPlan * self =
+    object_new (GraphBufferPlan);
+  self->port_entries =
+    g_hash_table_new (NULL, NULL);
+
+  const size_t floats_per_line =
+    GRAPH_BUFFER_PLAN_ALIGNMENT / sizeof (float);
+  self->buf_stride =
+    ((MAX (buf_size, 1) + floats_per_line - 1) /
+       floats_per_line) * floats_per_line;
+
+  int num_nodes = (int) g_hash_table_size (nodes);
+  if (num_nodes == 0)
+    return self;
+
+  GraphNode ** by_id =
+    object_new_n ((size_t) num_nodes, GraphNode *);
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init (&iter, nodes);
+  while (g_hash_table_iter_next (
+           &iter, NULL, &value))
+    {
+      GraphNode * node = (GraphNode *) value;
+      if (node->id < 0 || node->id >= num_nodes ||
+          by_id[node->id])
+        {
+          g_critical (
+            "invalid node ID %d", node->id);
+          free (by_id);
+          return self;
+        }
+      by_id[node->id] = node;
+    }
+
+  /* sort the nodes topologically */
+  int * order =
+    object_new_n ((size_t) num_nodes, int);
+  int * pos =
+    object_new_n ((size_t) num_nodes, int);
+  int * refcounts =
+    object_new_n ((size_t) num_nodes, int);
+  int num_ordered = 0;
+  for (int i = 0; i < num_nodes; i++)
+    {
+      refcounts[i] = by_id[i]->init_refcount;
+      if (refcounts[i] == 0)
+        order[num_ordered++] = i;
+    }
+  for (int i = 0; i < num_ordered; i++)
+    {
+      GraphNode * node = by_id[order[i]];
+      pos[node->id] = i;
+      for (int j = 0; j < node->n_childnodes; j++)
+        {
+          int child_id = node->childnodes[j]->id;
+          if (--refcounts[child_id] == 0)
+            order[num_ordered++] = child_id;
+        }
+    }
+  free (refcounts);
+  if (num_ordered != num_nodes)
+    {
+      g_critical ("graph has cycles");
+      free (by_id);
+      free (order);
+      free (pos);
+      return self;
+    }
+
+  /* find the ports that can share buffers */
+  Candidate * candidates =
+    object_new_n ((size_t) num_nodes, Candidate);
+  int num_candidates = 0;
+  for (int i = 0; i < num_nodes; i++)
+    {
+      GraphNode * node = by_id[order[i]];
+      if (node->type != ROUTE_NODE_TYPE_PORT ||
+          !is_port_shareable (
+            node->port, buf_size))
+        continue;
+
+      GraphNode * writer = get_writer (node);
+      if (!writer)
+        continue;
+
+      Candidate * c = &candidates[num_candidates++];
+      c->node = node;
+      c->writer = writer;
+      c->writer_pos = pos[writer->id];
+      c->node_pos = i;
+    }
+  free (order);
+
+  /* go through the ports in the order their
+   * buffers start being used */
+  qsort (
+    candidates, (size_t) num_candidates,
+    sizeof (Candidate), candidate_cmp);
+
+  int * candidate_of_node =
+    object_new_n ((size_t) num_nodes, int);
+  for (int i = 0; i < num_nodes; i++)
+    candidate_of_node[i] = -1;
+  for (int i = 0; i < num_candidates; i++)
+    candidate_of_node[candidates[i].node->id] = i;
+
+  int * buf_of_candidate =
+    object_new_n (
+      (size_t) MAX (num_candidates, 1), int);
+  int * owner_of_buf =
+    object_new_n (
+      (size_t) MAX (num_candidates, 1), int);
+  for (int i = 0; i < num_candidates; i++)
+    buf_of_candidate[i] = -1;
+  int * stamps =
+    object_new_n ((size_t) num_nodes, int);
+  GraphNode * visited[
+    GRAPH_BUFFER_PLAN_MAX_ANCESTORS];
+  for (int i = 0; i < num_candidates; i++)
+    {
+      Candidate * c = &candidates[i];
+      int stamp = i + 1;
+
+      /* find the nodes that always run before the
+       * writer */
+      int num_visited = 0;
+      for (int j = 0;
+           j < c->writer->init_refcount &&
+             num_visited <
+               GRAPH_BUFFER_PLAN_MAX_ANCESTORS;
+           j++)
+        {
+          GraphNode * parent =
+            c->writer->parentnodes[j];
+          if (stamps[parent->id] == stamp)
+            continue;
+          stamps[parent->id] = stamp;
+          visited[num_visited++] = parent;
+        }
+      for (int j = 0;
+           j < num_visited &&
+             num_visited <
+               GRAPH_BUFFER_PLAN_MAX_ANCESTORS;
+           j++)
+        {
+          GraphNode * node = visited[j];
+          for (int k = 0;
+               k < node->init_refcount &&
+                 num_visited <
+                   GRAPH_BUFFER_PLAN_MAX_ANCESTORS;
+               k++)
+            {
+              GraphNode * parent =
+                node->parentnodes[k];
+              if (stamps[parent->id] == stamp)
+                continue;
+              stamps[parent->id] = stamp;
+              visited[num_visited++] = parent;
+            }
+        }
+
+      /* reuse the buffer of the nearest port whose
+       * readers all run before the writer */
+      int buf = -1;
+      for (int j = 0; j < num_visited; j++)
+        {
+          GraphNode * node = visited[j];
+          int owner = candidate_of_node[node->id];
+          if (owner < 0 ||
+              buf_of_candidate[owner] < 0 ||
+              owner_of_buf[
+                buf_of_candidate[owner]] != owner)
+            continue;
+
+          bool readers_done = true;
+          for (int k = 0; k < node->n_childnodes;
+               k++)
+            {
+              if (stamps[node->childnodes[k]->id] !=
+                    stamp)
+                {
+                  readers_done = false;
+                  break;
+                }
+            }
+          if (readers_done)
+            {
+              buf = buf_of_candidate[owner];
+              break;
+            }
+        }
+      if (buf < 0)
+        buf = self->num_bufs++;
+
+      buf_of_candidate[i] = buf;
+      owner_of_buf[buf] = i;
+    }
+  free (stamps);
+  free (candidate_of_node);
+  free (owner_of_buf);
+
+  /* create the entries */
+  if (num_candidates > 0)
+    {
+      self->pool =
+        alloc_pool (
+          (size_t) self->num_bufs *
+            self->buf_stride * sizeof (float));
+      self->entries =
+        object_new_n (
+          (size_t) num_candidates,
+          GraphBufferPlanEntry);
+    }
+  GraphBufferPlanEntry ** last_entries =
+    object_new_n (
+      (size_t) MAX (self->num_bufs, 1),
+      GraphBufferPlanEntry *);
+  for (int i = 0; self->pool && i < num_candidates;
+       i++)
+    {
+      Candidate * c = &candidates[i];
+      int buf = buf_of_candidate[i];
+      GraphBufferPlanEntry * entry =
+        &self->entries[self->num_entries++];
+      entry->port = c->node->port;
+      entry->node = c->node;
+      entry->buf =
+        &self->pool[(size_t) buf * self->buf_stride];
+      entry->prev = last_entries[buf];
+      if (entry->prev)
+        entry->prev->next = entry;
+      last_entries[buf] = entry;
+
+      if (c->writer->num_shared_bufs == 0)
+        c->writer->shared_bufs = entry;
+      c->writer->num_shared_bufs++;
+
+      g_hash_table_insert (
+        self->port_entries, entry->port, entry);
+    }
+  free (last_entries);
+  free (buf_of_candidate);
+  free (candidates);
+  free (by_id);
+  free (pos);
+
+  g_message (
+    "%d ports share %d buffers",
+    self->num_entries, self->num_bufs);
+
+  return self;
+}
+
+/**
+ * Returns the shared buffer of the port, or NULL
+ * if the port keeps its own buffer.
+ */
+float *
+graph_buffer_plan_get_buf (
+  GraphBufferPlan * self,
+  const Port *      port)
+{
+  GraphBufferPlanEntry * entry =
+    (GraphBufferPlanEntry *)
+    g_hash_table_lookup (self->port_entries, port);
+  return entry ? entry->buf : NULL;
+}
+
+/**
+ * Adds the node and all nodes connected to it in
+ * the given direction to \ref nodes.
+ *
+ * @param skip_src,skip_dest Edge to ignore, if
+ *   any.
+ */
+static void
+add_connected_nodes (
+  GraphNode *  node,
+  GHashTable * nodes,
+  bool         upstream,
+  GraphNode *  skip_src,
+  GraphNode *  skip_dest)
+{
+  GPtrArray * stack = g_ptr_array_new ();
+  g_ptr_array_add (stack, node);
+  g_hash_table_add (nodes, node);
+  while (stack->len > 0)
+    {
+      GraphNode * cur =
+        (GraphNode *)
+        g_ptr_array_remove_index_fast (
+          stack, stack->len - 1);
+      int num =
+        upstream ?
+          cur->init_refcount : cur->n_childnodes;
+      for (int i = 0; i < num; i++)
+        {
+          GraphNode * next =
+            upstream ?
+              cur->parentnodes[i] :
+              cur->childnodes[i];
+          if (upstream ?
+                (cur == skip_dest &&
+                 next == skip_src) :
+                (cur == skip_src &&
+                 next == skip_dest))
+            continue;
+          if (g_hash_table_contains (nodes, next))
+            continue;
+          g_hash_table_add (nodes, next);
+          g_ptr_array_add (stack, next);
+        }
+    }
+  g_ptr_array_unref (stack);
+}
+
+/**
+ * Returns whether the plan stays valid after
+ * adding or removing an edge between 2 port
+ * nodes.
+ *
+ * Adding an edge is only a problem if the source
+ * port's buffer is reused after it, since the new
+ * child may run too late. Removing an edge is only
+ * a problem if the reuse of a buffer relied on the
+ * ordering that the edge provided.
+ */
+bool
+graph_buffer_plan_allows_edge_change (
+  GraphBufferPlan * self,
+  GraphNode *       src_node,
+  GraphNode *       dest_node,
+  bool              connected)
+{
+  if (self->num_entries == 0)
+    return true;
+
+  if (connected)
+    {
+      GraphBufferPlanEntry * entry =
+        (GraphBufferPlanEntry *)
+        g_hash_table_lookup (
+          self->port_entries, src_node->port);
+      return !entry || !entry->next;
+    }
+
+  /* a reuse can only depend on the edge if the
+   * previous user of the buffer is upstream of
+   * the edge and the next one downstream */
+  GHashTable * upstream =
+    g_hash_table_new (NULL, NULL);
+  add_connected_nodes (
+    src_node, upstream, true, NULL, NULL);
+  GHashTable * downstream =
+    g_hash_table_new (NULL, NULL);
+  add_connected_nodes (
+    dest_node, downstream, false, NULL, NULL);
+
+  bool allowed = true;
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init (&iter, downstream);
+  while (allowed &&
+         g_hash_table_iter_next (
+           &iter, &key, NULL))
+    {
+      GraphNode * node = (GraphNode *) key;
+      for (int i = 0;
+           allowed && i < node->num_shared_bufs;
+           i++)
+        {
+          GraphBufferPlanEntry * prev =
+            node->shared_bufs[i].prev;
+          if (!prev ||
+              !g_hash_table_contains (
+                upstream, prev->node))
+            continue;
+
+          /* check that the readers of the previous
+           * port still run before this node
+           * without the edge */
+          GHashTable * ancestors =
+            g_hash_table_new (NULL, NULL);
+          add_connected_nodes (
+            node, ancestors, true, src_node,
+            dest_node);
+          for (int j = 0;
+               j < prev->node->n_childnodes; j++)
+            {
+              GraphNode * reader =
+                prev->node->childnodes[j];
+              if (reader == node ||
+                  !g_hash_table_contains (
+                    ancestors, reader))
+                {
+                  allowed = false;
+                  break;
+                }
+            }
+          g_hash_table_destroy (ancestors);
+        }
+    }
+
+  g_hash_table_destroy (upstream);
+  g_hash_table_destroy (downstream);
+
+  return allowed;
+}
+
+void
+graph_buffer_plan_free (
+  GraphBufferPlan * self)
+{
+  free (self->pool);
+  free (self->entries);
+  object_free_w_func_and_null (
+    g_hash_table_destroy, self->port_entries);
+
+  object_zero_and_free (self);
+}
@@ -41,7 +41,9 @@
 #include "audio/engine.h"
 #include "audio/fader.h"
 #include "audio/graph.h"
+#include "audio/graph_buffer_plan.h"
 #include "audio/graph_node.h"
+#include "audio/graph_profiler.h"
 #include "audio/master_track.h"
 #include "audio/midi_event.h"
 #include "audio/port.h"
@@ -55,6 +57,7 @@
 #include "plugins/plugin.h"
 #include "project.h"
 #include "utils/arrays.h"
+#include "utils/dsp.h"
 #include "utils/mpmc_queue.h"
 #include "utils/objects.h"
 
@@ -227,6 +230,28 @@ graph_node_print (
   g_message ("%s", str);
 }
 
+/**
+ * Decrements the number of unprocessed parents of
+ * the node.
+ *
+ * @return Whether the node can now be processed.
+ */
+static inline bool
+dec_refcount (
+  GraphNode * self)
+{
+  if (g_atomic_int_dec_and_test (&self->refcount))
+    {
+      /* reset reference count for next cycle */
+      g_atomic_int_set (
+        &self->refcount,
+        (unsigned int) self->init_refcount);
+      return true;
+    }
+
+  return false;
+}
+
 static void
 on_node_finish (
   GraphNode * self)
@@ -234,7 +259,10 @@ on_node_finish (
   int feeds = 0;
 
   /* notify downstream nodes that depend on this
-   * node */
+   * node and push the ones that became ready in
+   * batches */
+  GraphNode * ready[GRAPH_TRIGGER_BATCH_SIZE];
+  size_t num_ready = 0;
   for (int i = 0; i < self->n_childnodes; ++i)
     {
 #if 0
@@ -247,8 +275,22 @@ on_node_finish (
           /*self->childnodes[i]->*/
             /*route_playback_latency);*/
 #endif
-      graph_node_trigger (self->childnodes[i]);
       feeds = 1;
+      if (!dec_refcount (self->childnodes[i]))
+        continue;
+
+      ready[num_ready++] = self->childnodes[i];
+      if (num_ready == GRAPH_TRIGGER_BATCH_SIZE)
+        {
+          graph_push_ready_nodes (
+            self->graph, ready, num_ready);
+          num_ready = 0;
+        }
+    }
+  if (num_ready > 0)
+    {
+      graph_push_ready_nodes (
+        self->graph, ready, num_ready);
     }
 
   /* if there are no outgoing edges, this is a
@@ -376,6 +418,13 @@ graph_node_process (
   /*g_message (*/
     /*"processing %s", graph_node_get_name (node));*/
 
+  GraphProfiler * profiler =
+    node->graph->router->profiler;
+  bool profiling =
+    graph_profiler_is_recording (profiler);
+  gint64 profile_start =
+    profiling ? graph_profiler_get_time () : 0;
+
   /* skip BPM during cycle (already processed in
    * router_start_cycle()) */
   if (G_UNLIKELY (
@@ -386,6 +435,17 @@ graph_node_process (
       goto node_process_finish;
     }
 
+  /* clear the shared buffers that this node
+   * starts using, since they still contain the
+   * data of the previous port that used them */
+  for (int i = 0; i < node->num_shared_bufs; i++)
+    {
+      dsp_fill (
+        &node->shared_bufs[i].buf[
+          time_nfo.local_offset],
+        DENORMAL_PREVENTION_VAL, time_nfo.nframes);
+    }
+
   /* figure out if we are doing a no-roll */
   if (node->route_playback_latency <
         AUDIO_ENGINE->remaining_latency_preroll)
@@ -480,6 +540,13 @@ graph_node_process (
     }
 
 node_process_finish:
+  if (profiling)
+    {
+      graph_profiler_record (
+        profiler, node, profile_start,
+        graph_profiler_get_time ());
+    }
+
   if (node->graph->router->callback_in_progress)
     {
       on_node_finish (node);
@@ -495,21 +562,13 @@ graph_node_trigger (
   GraphNode * self)
 {
   /* check if we can run */
-  if (g_atomic_int_dec_and_test (&self->refcount))
+  if (dec_refcount (self))
     {
-      /* reset reference count for next cycle */
-      g_atomic_int_set (
-        &self->refcount,
-        (unsigned int) self->init_refcount);
-
       /* all nodes that feed this node have
        * completed, so this node be processed
        * now. */
-      g_atomic_int_inc (
-        &self->graph->trigger_queue_size);
-      /*g_message ("triggering node, pushing back");*/
-      mpmc_queue_push_back_node (
-        self->graph->trigger_queue, self);
+      graph_push_ready_nodes (
+        self->graph, &self, 1);
     }
 }
 
@@ -641,6 +700,35 @@ graph_node_connect (
   g_warn_if_fail (!from->terminal && !to->initial);
 }
 
+/**
+ * Removes the edge between the given nodes, if
+ * any.
+ *
+ * The nodes are marked as terminal/initial if
+ * they no longer have children/parents.
+ */
+void
+graph_node_disconnect (
+  GraphNode * from,
+  GraphNode * to)
+{
+  g_return_if_fail (from && to);
+  if (!array_contains (
+        from->childnodes,
+        from->n_childnodes,
+        to))
+    return;
+
+  array_delete (
+    from->childnodes, from->n_childnodes, to);
+  array_delete (
+    to->parentnodes, to->init_refcount, from);
+  to->refcount = to->init_refcount;
+
+  from->terminal = from->n_childnodes == 0;
+  to->initial = to->init_refcount == 0;
+}
+
 GraphNode *
 graph_node_new (
   Graph * graph,
@@ -0,0 +1,675 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-config.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio/graph.h"
+#include "audio/graph_node.h"
+#include "audio/graph_profiler.h"
+#include "plugins/lv2/lv2_worker_pool.h"
+#include "plugins/plugin_manager.h"
+#include "utils/objects.h"
+#include "zrythm.h"
+
+#include <glib.h>
+#include <glib/gi18n.h>
+
+typedef enum
+{
+  Z_AUDIO_GRAPH_PROFILER_ERROR_NO_SAMPLES,
+} ZAudioGraphProfilerError;
+
+#define Z_AUDIO_GRAPH_PROFILER_ERROR \
+  z_audio_graph_profiler_error_quark ()
+GQuark z_audio_graph_profiler_error_quark (void);
+G_DEFINE_QUARK (
+  z-audio-graph-profiler-error-quark, z_audio_graph_profiler_error)
+
+/** Thread slot + 1 of each thread (0 if not
+ * registered). */
+static GPrivate thread_slot;
+
+GraphProfiler *
+graph_profiler_new (void)
+{
+  GraphProfiler * self =
+    object_new (GraphProfiler);
+
+  self->node_names =
+    g_hash_table_new_full (
+      NULL, NULL, NULL, g_free);
+  self->samples =
+    g_array_new (
+      false, false, sizeof (GraphProfilerSample));
+
+  /* make sure the thread-local key is created
+   * outside realtime threads */
+  g_private_get (&thread_slot);
+
+  return self;
+}
+
+/**
+ * Sets the thread slot of the calling thread.
+ *
+ * To be called once by each graph thread before
+ * processing.
+ *
+ * @param graph_thread_id The GraphThread ID.
+ */
+void
+graph_profiler_register_thread (
+  int graph_thread_id)
+{
+  /* stored as slot + 1 so that unregistered
+   * threads (NULL) map to the "other" slot */
+  g_private_set (
+    &thread_slot,
+    GINT_TO_POINTER (graph_thread_id + 3));
+}
+
+static int
+get_thread_slot (void)
+{
+  int slot =
+    GPOINTER_TO_INT (g_private_get (&thread_slot));
+  if (slot == 0)
+    return GRAPH_PROFILER_OTHER_THREAD;
+  return slot - 1;
+}
+
+static void
+free_rings (
+  GraphProfiler * self)
+{
+  for (int i = 0; i < self->num_rings; i++)
+    {
+      object_free_w_func_and_null (
+        zix_ring_free, self->rings[i]);
+    }
+  free (self->rings);
+  self->rings = NULL;
+  self->num_rings = 0;
+}
+
+/**
+ * Returns the LV2 worker pool, if any.
+ */
+static Lv2WorkerPool *
+get_lv2_worker_pool (void)
+{
+  if (ZRYTHM && PLUGIN_MANAGER)
+    return PLUGIN_MANAGER->lv2_worker_pool;
+
+  return NULL;
+}
+
+/**
+ * Starts recording the next \ref num_cycles
+ * cycles of the given graph.
+ *
+ * Must be called while holding the router's graph
+ * access semaphore.
+ */
+void
+graph_profiler_start (
+  GraphProfiler * self,
+  Graph *         graph,
+  int             num_cycles)
+{
+  g_return_if_fail (num_cycles > 0);
+
+  g_atomic_int_set (&self->enabled, 0);
+
+  /* forget the previous profile */
+  g_hash_table_remove_all (self->node_names);
+  g_array_set_size (self->samples, 0);
+  free_rings (self);
+
+  /* remember the node names so that the results
+   * can be reported even after the graph is
+   * rebuilt */
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init (
+    &iter, graph->graph_nodes);
+  while (g_hash_table_iter_next (
+           &iter, NULL, &value))
+    {
+      GraphNode * node = (GraphNode *) value;
+      g_hash_table_insert (
+        self->node_names, node,
+        graph_node_get_name (node));
+    }
+
+  /* one ring for other threads, one for the
+   * main graph thread and one per worker */
+  size_t num_nodes =
+    g_hash_table_size (self->node_names);
+  size_t samples_per_thread =
+    MIN (
+      num_nodes * (size_t) num_cycles + 1,
+      GRAPH_PROFILER_MAX_SAMPLES_PER_THREAD);
+  self->num_rings = graph->num_threads + 2;
+  self->rings =
+    object_new_n (
+      (size_t) self->num_rings, ZixRing *);
+  for (int i = 0; i < self->num_rings; i++)
+    {
+      self->rings[i] =
+        zix_ring_new (
+          (uint32_t)
+          (samples_per_thread *
+             sizeof (GraphProfilerSample)));
+      zix_ring_mlock (self->rings[i]);
+    }
+
+  /* report the LV2 work done during this
+   * profile only */
+  Lv2WorkerPool * pool = get_lv2_worker_pool ();
+  if (pool)
+    {
+      lv2_worker_pool_reset_stats (pool);
+    }
+
+  self->num_cycles = num_cycles;
+  self->started = true;
+  g_atomic_int_set (&self->num_dropped, 0);
+  g_atomic_int_set (&self->cycle, -1);
+  g_atomic_int_set (&self->enabled, 1);
+
+  g_message (
+    "profiling %d cycles of %zu nodes",
+    num_cycles, num_nodes);
+}
+
+/**
+ * Stops recording.
+ *
+ * Already recorded samples are kept.
+ */
+void
+graph_profiler_stop (
+  GraphProfiler * self)
+{
+  g_atomic_int_set (&self->enabled, 0);
+}
+
+/**
+ * To be called at the start of each cycle.
+ *
+ * Stops recording after the requested number of
+ * cycles.
+ */
+void
+graph_profiler_begin_cycle (
+  GraphProfiler * self)
+{
+  if (!g_atomic_int_get (&self->enabled))
+    return;
+
+  int cycle =
+    g_atomic_int_add (&self->cycle, 1) + 1;
+  if (cycle >= self->num_cycles)
+    {
+      g_atomic_int_set (&self->enabled, 0);
+    }
+}
+
+/**
+ * Returns whether a started profile has
+ * finished recording.
+ */
+bool
+graph_profiler_is_finished (
+  GraphProfiler * self)
+{
+  return
+    self->started &&
+    !g_atomic_int_get (&self->enabled);
+}
+
+/**
+ * Returns the current time in nanoseconds.
+ */
+gint64
+graph_profiler_get_time (void)
+{
+#ifdef _WOE32
+  return g_get_monotonic_time () * 1000;
+#else
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return
+    (gint64) ts.tv_sec * 1000000000 +
+    (gint64) ts.tv_nsec;
+#endif
+}
+
+/**
+ * Records a node run.
+ *
+ * This is realtime-safe.
+ */
+void
+graph_profiler_record (
+  GraphProfiler *   self,
+  const GraphNode * node,
+  gint64            start,
+  gint64            end)
+{
+  int slot = get_thread_slot ();
+  if (G_UNLIKELY (slot >= self->num_rings))
+    {
+      g_atomic_int_inc (&self->num_dropped);
+      return;
+    }
+
+  GraphProfilerSample sample = {
+    .node = node,
+    .start = start,
+    .end = end,
+    .cycle = g_atomic_int_get (&self->cycle),
+    .thread = slot,
+  };
+  ZixRing * ring = self->rings[slot];
+  if (zix_ring_write_space (ring) <
+        sizeof (GraphProfilerSample))
+    {
+      g_atomic_int_inc (&self->num_dropped);
+      return;
+    }
+  zix_ring_write (
+    ring, &sample, sizeof (GraphProfilerSample));
+}
+
+/**
+ * Moves the samples from the rings to the sample
+ * array.
+ */
+static void
+collect_samples (
+  GraphProfiler * self)
+{
+  for (int i = 0; i < self->num_rings; i++)
+    {
+      ZixRing * ring = self->rings[i];
+      GraphProfilerSample sample;
+      while (zix_ring_read_space (ring) >=
+               sizeof (GraphProfilerSample))
+        {
+          zix_ring_read (
+            ring, &sample,
+            sizeof (GraphProfilerSample));
+          g_array_append_val (
+            self->samples, sample);
+        }
+    }
+}
+
+static inline gint64
+get_duration (
+  const GraphProfilerSample * sample)
+{
+  return sample->end - sample->start;
+}
+
+/**
+ * Sorts by node, then by duration.
+ */
+static int
+sample_node_cmpfunc (
+  const void * _a,
+  const void * _b)
+{
+  const GraphProfilerSample * a =
+    (const GraphProfilerSample *) _a;
+  const GraphProfilerSample * b =
+    (const GraphProfilerSample *) _b;
+  if ((uintptr_t) a->node < (uintptr_t) b->node)
+    return -1;
+  else if ((uintptr_t) a->node >
+             (uintptr_t) b->node)
+    return 1;
+
+  gint64 a_dur = get_duration (a);
+  gint64 b_dur = get_duration (b);
+  if (a_dur < b_dur)
+    return -1;
+  else if (a_dur > b_dur)
+    return 1;
+  return 0;
+}
+
+static int
+stats_cmpfunc (
+  const void * _a,
+  const void * _b)
+{
+  const GraphProfilerNodeStats * a =
+    (const GraphProfilerNodeStats *) _a;
+  const GraphProfilerNodeStats * b =
+    (const GraphProfilerNodeStats *) _b;
+  if (a->avg > b->avg)
+    return -1;
+  else if (a->avg < b->avg)
+    return 1;
+  return 0;
+}
+
+/**
+ * Returns the aggregated timings of each node,
+ * slowest (by average) first.
+ *
+ * Must be free'd with free().
+ */
+GraphProfilerNodeStats *
+graph_profiler_get_node_stats (
+  GraphProfiler * self,
+  int *           num_stats)
+{
+  collect_samples (self);
+
+  *num_stats = 0;
+  size_t num_samples = self->samples->len;
+  if (num_samples == 0)
+    return NULL;
+
+  GraphProfilerSample * sorted =
+    object_new_n (
+      num_samples, GraphProfilerSample);
+  memcpy (
+    sorted, self->samples->data,
+    num_samples * sizeof (GraphProfilerSample));
+  qsort (
+    sorted, num_samples,
+    sizeof (GraphProfilerSample),
+    sample_node_cmpfunc);
+
+  GraphProfilerNodeStats * stats =
+    object_new_n (
+      g_hash_table_size (self->node_names),
+      GraphProfilerNodeStats);
+  size_t run_start = 0;
+  for (size_t i = 1; i <= num_samples; i++)
+    {
+      if (i < num_samples &&
+          sorted[i].node == sorted[run_start].node)
+        continue;
+
+      /* samples from run_start to i are of the
+       * same node, sorted by duration */
+      const GraphProfilerSample * run =
+        &sorted[run_start];
+      size_t run_len = i - run_start;
+      run_start = i;
+
+      const char * name =
+        g_hash_table_lookup (
+          self->node_names, run[0].node);
+      if (!name)
+        continue;
+
+      gint64 sum = 0;
+      for (size_t j = 0; j < run_len; j++)
+        {
+          sum += get_duration (&run[j]);
+        }
+      size_t p99_idx =
+        (run_len * 99 + 99) / 100 - 1;
+
+      GraphProfilerNodeStats * stat =
+        &stats[(*num_stats)++];
+      stat->name = name;
+      stat->num_samples = (int) run_len;
+      stat->min = get_duration (&run[0]);
+      stat->max = get_duration (&run[run_len - 1]);
+      stat->avg = sum / (gint64) run_len;
+      stat->p99 = get_duration (&run[p99_idx]);
+    }
+  free (sorted);
+
+  qsort (
+    stats, (size_t) *num_stats,
+    sizeof (GraphProfilerNodeStats),
+    stats_cmpfunc);
+
+  return stats;
+}
+
+/**
+ * Prints the aggregated timings.
+ */
+void
+graph_profiler_print (
+  GraphProfiler * self)
+{
+  int num_stats = 0;
+  GraphProfilerNodeStats * stats =
+    graph_profiler_get_node_stats (
+      self, &num_stats);
+
+  GString * gstr = g_string_new (NULL);
+  g_string_append_printf (
+    gstr,
+    "graph profile (%d nodes, %d samples "
+    "dropped, times in us):\n",
+    num_stats,
+    g_atomic_int_get (&self->num_dropped));
+  for (int i = 0; i < num_stats; i++)
+    {
+      GraphProfilerNodeStats * stat = &stats[i];
+      g_string_append_printf (
+        gstr,
+        "  %s: min %.3f avg %.3f p99 %.3f "
+        "max %.3f (%d runs)\n",
+        stat->name,
+        (double) stat->min / 1000.0,
+        (double) stat->avg / 1000.0,
+        (double) stat->p99 / 1000.0,
+        (double) stat->max / 1000.0,
+        stat->num_samples);
+    }
+
+  Lv2WorkerPool * pool = get_lv2_worker_pool ();
+  if (pool)
+    {
+      Lv2WorkerPoolStats pool_stats;
+      lv2_worker_pool_get_stats (
+        pool, &pool_stats);
+      g_string_append_printf (
+        gstr,
+        "LV2 worker pool: %d threads (max %d "
+        "busy), %d workers, %d jobs (%d "
+        "prioritized), wake latency in us: "
+        "min %" G_GINT64_FORMAT
+        " avg %" G_GINT64_FORMAT
+        " max %" G_GINT64_FORMAT "\n",
+        pool_stats.num_threads,
+        pool_stats.max_busy_threads,
+        pool_stats.num_workers,
+        pool_stats.num_jobs,
+        pool_stats.num_priority_jobs,
+        pool_stats.min_wake_latency,
+        pool_stats.avg_wake_latency,
+        pool_stats.max_wake_latency);
+    }
+
+  char * str = g_string_free (gstr, false);
+  g_message ("%s", str);
+  g_free (str);
+
+  free (stats);
+}
+
+static void
+append_json_string (
+  GString *    gstr,
+  const char * str)
+{
+  g_string_append_c (gstr, '"');
+  for (const char * c = str; *c; c++)
+    {
+      switch (*c)
+        {
+        case '"':
+          g_string_append (gstr, "\\\"");
+          break;
+        case '\\':
+          g_string_append (gstr, "\\\\");
+          break;
+        default:
+          if ((unsigned char) *c < 0x20)
+            {
+              g_string_append_printf (
+                gstr, "\\u%04x",
+                (unsigned int) *c);
+            }
+          else
+            {
+              g_string_append_c (gstr, *c);
+            }
+          break;
+        }
+    }
+  g_string_append_c (gstr, '"');
+}
+
+/**
+ * Exports the recorded samples in the Chrome
+ * trace event format, which can be opened in
+ * chrome://tracing or Perfetto.
+ *
+ * @return Whether successful.
+ */
+bool
+graph_profiler_export_chrome_trace (
+  GraphProfiler * self,
+  const char *    path,
+  GError **       error)
+{
+  collect_samples (self);
+
+  size_t num_samples = self->samples->len;
+  if (num_samples == 0)
+    {
+      g_set_error (
+        error, Z_AUDIO_GRAPH_PROFILER_ERROR,
+        Z_AUDIO_GRAPH_PROFILER_ERROR_NO_SAMPLES,
+        "%s", _("No graph profiling samples"));
+      return false;
+    }
+
+  GraphProfilerSample * samples =
+    (GraphProfilerSample *) self->samples->data;
+  gint64 time_origin = samples[0].start;
+  for (size_t i = 1; i < num_samples; i++)
+    {
+      time_origin =
+        MIN (time_origin, samples[i].start);
+    }
+
+  GString * gstr = g_string_new (NULL);
+  g_string_append (
+    gstr,
+    "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+  /* thread names */
+  for (int i = 0; i < self->num_rings; i++)
+    {
+      char * thread_name;
+      if (i == GRAPH_PROFILER_OTHER_THREAD)
+        thread_name = g_strdup ("Kickoff thread");
+      else if (i == 1)
+        thread_name = g_strdup ("Graph main thread");
+      else
+        thread_name =
+          g_strdup_printf (
+            "Graph worker %d", i - 2);
+      g_string_append_printf (
+        gstr,
+        "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+        "\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+        i == 0 ? "" : ",", i);
+      append_json_string (gstr, thread_name);
+      g_string_append (gstr, "}}");
+      g_free (thread_name);
+    }
+
+  /* node runs */
+  for (size_t i = 0; i < num_samples; i++)
+    {
+      GraphProfilerSample * sample = &samples[i];
+      const char * name =
+        g_hash_table_lookup (
+          self->node_names, sample->node);
+      if (!name)
+        continue;
+
+      g_string_append (gstr, ",{\"name\":");
+      append_json_string (gstr, name);
+      g_string_append_printf (
+        gstr,
+        ",\"cat\":\"node\",\"ph\":\"X\","
+        "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,"
+        "\"tid\":%d,\"args\":{\"cycle\":%d}}",
+        (double) (sample->start - time_origin) /
+          1000.0,
+        (double) get_duration (sample) / 1000.0,
+        sample->thread, sample->cycle);
+    }
+  g_string_append (gstr, "]}\n");
+
+  bool ret =
+    g_file_set_contents (
+      path, gstr->str, (gssize) gstr->len, error);
+  g_string_free (gstr, true);
+
+  if (ret)
+    {
+      g_message (
+        "exported %zu graph profiling samples "
+        "to %s", num_samples, path);
+    }
+
+  return ret;
+}
+
+void
+graph_profiler_free (
+  GraphProfiler * self)
+{
+  g_atomic_int_set (&self->enabled, 0);
+
+  free_rings (self);
+  object_free_w_func_and_null (
+    g_hash_table_destroy, self->node_names);
+  if (self->samples)
+    {
+      g_array_free (self->samples, true);
+      self->samples = NULL;
+    }
+
+  object_zero_and_free (self);
+}
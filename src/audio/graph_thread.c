@@ -40,15 +40,86 @@
 #include "audio/engine.h"
 #include "audio/graph.h"
 #include "audio/graph_node.h"
+#include "audio/graph_profiler.h"
 #include "audio/graph_thread.h"
 #include "audio/router.h"
 #include "project.h"
 #include "utils/mpmc_queue.h"
 #include "utils/objects.h"
+#include "utils/rt_check.h"
+#include "utils/thread_affinity.h"
 
 /* uncomment to show debug messages */
 /*#define DEBUG_THREADS 1*/
 
+/**
+ * Places the calling thread on its CPU(s)
+ * according to the graph's affinity policy and
+ * remembers where it ended up.
+ *
+ * Allocates, so it must be called before the
+ * thread is registered as a real-time thread.
+ */
+static void
+apply_affinity (
+  GraphThread * thread)
+{
+  Graph * graph = thread->graph;
+  if (graph->num_affinity_cpus > 0)
+    {
+      bool ret;
+      if (thread_affinity_policy_pins_threads (
+            graph->affinity_policy))
+        {
+          /* the main thread takes the slot after
+           * the workers */
+          int idx =
+            thread->id == -1 ?
+              graph->num_threads : thread->id;
+          ret =
+            thread_affinity_set_current_thread (
+              &graph->affinity_cpus[
+                idx % graph->num_affinity_cpus],
+              1);
+        }
+      else
+        {
+          ret =
+            thread_affinity_set_current_thread (
+              graph->affinity_cpus,
+              graph->num_affinity_cpus);
+        }
+      if (!ret)
+        {
+          g_warning (
+            "[%d]: failed to set CPU affinity",
+            thread->id);
+        }
+    }
+
+  int * cpus =
+    object_new_n (THREAD_AFFINITY_MAX_CPUS, int);
+  int num_cpus =
+    thread_affinity_get_current_thread (
+      cpus, THREAD_AFFINITY_MAX_CPUS);
+  if (num_cpus > 0)
+    {
+      char * str =
+        thread_affinity_cpu_list_to_string (
+          cpus, num_cpus);
+      g_strlcpy (
+        thread->affinity, str,
+        sizeof (thread->affinity));
+      g_free (str);
+    }
+  free (cpus);
+
+  g_message (
+    "[%d]: running on CPU(s) %s", thread->id,
+    thread->affinity[0] ?
+      thread->affinity : "unknown");
+}
+
 static void *
 worker_thread (void * arg)
 {
@@ -60,6 +131,15 @@ worker_thread (void * arg)
    * allocation is done later on */
   g_thread_self ();
 
+  /* the main thread was already placed in
+   * main_thread() */
+  if (thread->id != -1)
+    {
+      apply_affinity (thread);
+    }
+
+  graph_profiler_register_thread (thread->id);
+
   g_message (
     "WORKER THREAD %d created (num threads %d)",
     thread->id, graph->num_threads);
@@ -77,12 +157,18 @@ worker_thread (void * arg)
     }
 #endif
 
+  /* from here on this thread must not allocate,
+   * log or block (other than on the trigger
+   * semaphore) */
+  rt_check_register_thread ();
+
   for (;;)
     {
       to_run = NULL;
 
       if (g_atomic_int_get (&graph->terminate))
         {
+          rt_check_unregister_thread ();
           if (thread->id == -1)
             {
               g_message ("terminating main thread");
@@ -108,33 +194,9 @@ worker_thread (void * arg)
               &graph->trigger_queue_size));
           graph_node_print (to_run);
 #endif
-          /* Wake up idle threads, but at most as
-           * many as there's work in the trigger
-           * queue that can be processed by other
-           * threads.
-           * This thread as not yet decreased
-           * _trigger_queue_size. */
-          guint idle_cnt =
-            (guint)
-            g_atomic_int_get (
-              &graph->idle_thread_cnt);
-          guint work_avail =
-            (guint)
-            g_atomic_int_get (
-              &graph->trigger_queue_size);
-          guint wakeup =
-            MIN (idle_cnt + 1, work_avail);
-#ifdef DEBUG_THREADS
-          g_message (
-            "[%d]: Waking up %u idle threads (idle count %u), work available -> %u",
-            thread->id, wakeup - 1,
-            idle_cnt, work_avail);
-#endif
-
-          for (guint i = 1; i < wakeup; ++i)
-            {
-              zix_sem_post (&graph->trigger);
-            }
+          /* idle threads were already woken up
+           * for this node when it was pushed (see
+           * graph_push_ready_nodes()) */
         }
 
       while (!to_run)
@@ -163,6 +225,17 @@ worker_thread (void * arg)
                 graph->num_threads);
             }
 
+          /* a node may have been pushed before this
+           * thread was counted as idle, in which
+           * case nobody woke us up for it */
+          if (mpmc_queue_dequeue_node (
+                graph->trigger_queue, &to_run))
+            {
+              g_atomic_int_dec_and_test (
+                &graph->idle_thread_cnt);
+              break;
+            }
+
           zix_sem_wait (&graph->trigger);
 
           if (g_atomic_int_get (&graph->terminate))
@@ -200,6 +273,8 @@ worker_thread (void * arg)
 
 terminate_thread:
 
+  rt_check_unregister_thread ();
+
 #ifdef HAVE_LSP_DSP
   if (ZRYTHM_USE_OPTIMIZED_DSP)
     {
@@ -217,6 +292,8 @@ main_thread (void * arg)
   GraphThread * thread = (GraphThread *) arg;
   Graph * self = thread->graph;
 
+  apply_affinity (thread);
+
   /* Wait until all worker threads are active */
   while (
     g_atomic_int_get (&self->idle_thread_cnt) !=
@@ -242,15 +319,9 @@ main_thread (void * arg)
   /* bootstrap trigger-list.
    * (later this is done by
    * Graph_reached_terminal_node)*/
-  for (size_t i = 0;
-       i < self->n_init_triggers; ++i)
-    {
-      g_atomic_int_inc (&self->trigger_queue_size);
-      /*g_message ("[main] pushing back node %d during bootstrap", i);*/
-      mpmc_queue_push_back_node (
-        self->trigger_queue,
-        self->init_trigger_list[i]);
-    }
+  graph_push_ready_nodes (
+    self, self->init_trigger_list,
+    self->n_init_triggers);
 
   /* after setup, the main-thread just becomes
    * a normal worker */
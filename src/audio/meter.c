@@ -93,6 +93,14 @@ meter_get_value (
           return;
         }
 
+      /* the port's buffer may be shared with
+       * other ports, so use the last block
+       * written to the ring */
+      float * last_block =
+        &buf[
+          (blocks_read - 1) *
+            AUDIO_ENGINE->block_length];
+
       switch (self->algorithm)
         {
         case METER_ALGORITHM_RMS:
@@ -107,7 +115,7 @@ meter_get_value (
         case METER_ALGORITHM_TRUE_PEAK:
           true_peak_dsp_process (
             self->true_peak_processor,
-            &port->buf[0],
+            last_block,
             (int) AUDIO_ENGINE->block_length);
           amp =
             true_peak_dsp_read_f (
@@ -116,7 +124,7 @@ meter_get_value (
         case METER_ALGORITHM_K:
           kmeter_dsp_process (
             self->kmeter_processor,
-            &port->buf[0],
+            last_block,
             (int) AUDIO_ENGINE->block_length);
           kmeter_dsp_read (
             self->kmeter_processor, &amp, &max_amp);
@@ -124,7 +132,7 @@ meter_get_value (
         case METER_ALGORITHM_DIGITAL_PEAK:
           peak_dsp_process (
             self->peak_processor,
-            &port->buf[0],
+            last_block,
             (int) AUDIO_ENGINE->block_length);
           peak_dsp_read (
             self->peak_processor, &amp, &max_amp);
@@ -138,11 +146,11 @@ meter_get_value (
       bool on = false;
       if (port->write_ring_buffers)
         {
-          MidiEvent event;
+          MidiRingEvent event;
           while (
             zix_ring_peek (
               port->midi_ring, &event,
-              sizeof (MidiEvent)) > 0)
+              sizeof (MidiRingEvent)) > 0)
             {
               if (event.systime >
                     self->last_midi_trigger_time)
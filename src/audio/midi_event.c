@@ -49,6 +49,33 @@
 #include "project.h"
 #include "utils/objects.h"
 
+/** Number of bits for each count in the queue
+ * state. */
+#define QUEUE_COUNT_BITS 15
+#define QUEUE_COUNT_MASK ((1 << QUEUE_COUNT_BITS) - 1)
+#define QUEUE_RESERVED_SHIFT QUEUE_COUNT_BITS
+#define QUEUE_BUF_SHIFT (2 * QUEUE_COUNT_BITS)
+
+#define queue_state_get_buf(x) \
+  ((x) >> QUEUE_BUF_SHIFT)
+#define queue_state_get_reserved(x) \
+  (((x) >> QUEUE_RESERVED_SHIFT) & QUEUE_COUNT_MASK)
+#define queue_state_get_committed(x) \
+  ((x) & QUEUE_COUNT_MASK)
+
+G_STATIC_ASSERT (
+  MAX_MIDI_EVENTS + MIDI_EVENTS_NOTE_OFF_HEADROOM <=
+    QUEUE_COUNT_MASK);
+G_STATIC_ASSERT (sizeof (MidiEvent) == 8);
+
+/**
+ * Number of bits in the bitmap used for finding
+ * duplicates: note ons, note offs and controllers
+ * for each channel, then pitchbends and all notes
+ * off for each channel.
+ */
+#define DUP_BITMAP_NUM_BITS (3 * 16 * 128 + 2 * 16)
+
 static const char * midi_event_type_strings[] =
 {
   "pitchbend",
@@ -56,8 +83,12 @@ static const char * midi_event_type_strings[] =
   "note off",
   "note on",
   "all notes off",
+  "raw",
 };
 
+/** Set when any MidiEvents drops an event. */
+static volatile gint overflowed = 0;
+
 /**
  * Prints a message saying unknown event, with
  * information about the given event.
@@ -93,6 +124,273 @@ print_unknown_event_message (
     }
 }
 
+HOT
+static int
+midi_event_cmpfunc (
+  const void * _a,
+  const void * _b)
+{
+  const MidiEvent * a =
+    (MidiEvent const *) _a;
+  const MidiEvent * b =
+    (MidiEvent const *) _b;
+  if (a->time == b->time)
+    {
+      return
+        (int) midi_event_get_type (a) -
+        (int) midi_event_get_type (b);
+    }
+  return (int) a->time - (int) b->time;
+}
+
+/**
+ * Returns whether the given raw MIDI data stops
+ * notes, in which case it may use \ref
+ * MIDI_EVENTS_NOTE_OFF_HEADROOM.
+ */
+static inline bool
+is_note_off (
+  const midi_byte_t * buf)
+{
+  switch (buf[0] & 0xf0)
+    {
+    case MIDI_CH1_NOTE_OFF:
+      return true;
+    case MIDI_CH1_NOTE_ON:
+      return buf[2] == 0;
+    case MIDI_CH1_CTRL_CHANGE:
+      return buf[1] == MIDI_ALL_NOTES_OFF;
+    default:
+      return false;
+    }
+}
+
+/**
+ * Returns the number of events a buffer with the
+ * given capacity can take.
+ */
+static inline int
+get_limit (
+  const int  capacity,
+  const bool note_off)
+{
+  return
+    note_off ?
+      capacity + MIDI_EVENTS_NOTE_OFF_HEADROOM :
+      capacity;
+}
+
+/**
+ * Counts an event that didn't fit in a buffer so
+ * that the buffer is grown later.
+ */
+static inline void
+drop_event (
+  MidiEvents * self,
+  const bool   queued)
+{
+  g_atomic_int_inc (
+    queued ?
+      &self->num_queue_dropped : &self->num_dropped);
+  g_atomic_int_set (&overflowed, 1);
+}
+
+/**
+ * Moves the last main event back to its position
+ * by time.
+ *
+ * Events are mostly produced in order, so this
+ * usually doesn't move anything.
+ */
+static inline void
+sort_last_event (
+  MidiEvents * self)
+{
+  int i = self->num_events - 1;
+  MidiEvent ev = self->events[i];
+  while (i > 0 &&
+         midi_event_cmpfunc (
+           &self->events[i - 1], &ev) > 0)
+    {
+      self->events[i] = self->events[i - 1];
+      i--;
+    }
+  self->events[i] = ev;
+}
+
+/**
+ * Returns the next event to fill in, or NULL if
+ * there is no space left.
+ *
+ * For queued events, this reserves a slot in the
+ * current queue buffer without locking so it can
+ * be called from any thread. The event must be
+ * committed with commit_event() after it is
+ * filled in.
+ *
+ * @param note_off Whether the event will stop
+ *   notes, see is_note_off().
+ * @param[out] queue The queue the slot was
+ *   reserved in, to pass to commit_event().
+ */
+static inline MidiEvent *
+reserve_event (
+  MidiEvents *       self,
+  const bool         queued,
+  const bool         note_off,
+  MidiEventsQueue ** queue)
+{
+  *queue = NULL;
+  if (!queued)
+    {
+      if (self->num_events >=
+            get_limit (self->capacity, note_off))
+        {
+          drop_event (self, queued);
+          return NULL;
+        }
+
+      return &self->events[self->num_events];
+    }
+
+  /* announce the write before looking up the
+   * queue so that a replaced queue is not freed
+   * while it is written to */
+  g_atomic_int_inc (&self->num_queue_writers);
+  MidiEventsQueue * q =
+    (MidiEventsQueue *)
+    g_atomic_pointer_get (&self->queue);
+
+  gint state, reserved;
+  do
+    {
+      state = g_atomic_int_get (&q->state);
+      reserved = queue_state_get_reserved (state);
+      if (reserved >=
+            get_limit (q->capacity, note_off))
+        {
+          drop_event (self, queued);
+          g_atomic_int_dec_and_test (
+            &self->num_queue_writers);
+          return NULL;
+        }
+    } while (
+      !g_atomic_int_compare_and_exchange (
+         &q->state, state,
+         state + (1 << QUEUE_RESERVED_SHIFT)));
+
+  *queue = q;
+  return
+    &q->events[
+      queue_state_get_buf (state)][reserved];
+}
+
+/**
+ * Marks the event returned by reserve_event() as
+ * ready.
+ *
+ * Main events are kept sorted by time.
+ *
+ * @param queue The queue returned by
+ *   reserve_event().
+ */
+static inline void
+commit_event (
+  MidiEvents *      self,
+  const bool        queued,
+  MidiEventsQueue * queue)
+{
+  if (queued)
+    {
+      g_atomic_int_inc (&queue->state);
+      g_atomic_int_dec_and_test (
+        &self->num_queue_writers);
+    }
+  else
+    {
+      self->num_events++;
+      sort_last_event (self);
+    }
+}
+
+/**
+ * Returns the queued events that can be read.
+ *
+ * If another thread is in the middle of queueing
+ * an event, no events are returned.
+ */
+static MidiEvent *
+get_queued_events (
+  MidiEvents * self,
+  int *        num_events)
+{
+  MidiEventsQueue * q =
+    (MidiEventsQueue *)
+    g_atomic_pointer_get (&self->queue);
+  gint state = g_atomic_int_get (&q->state);
+  int reserved = queue_state_get_reserved (state);
+  *num_events =
+    reserved == queue_state_get_committed (state) ?
+      reserved : 0;
+
+  return q->events[queue_state_get_buf (state)];
+}
+
+/**
+ * Returns the index of the given event in the
+ * duplicates bitmap, or -1 if the event type is
+ * not indexed.
+ */
+static inline int
+get_dup_bitmap_idx (
+  const MidiEvent * ev)
+{
+  int channel = ev->raw_buffer[0] & 0xf;
+  switch (midi_event_get_type (ev))
+    {
+    case MIDI_EVENT_TYPE_NOTE_ON:
+      return
+        channel * 128 +
+        (midi_event_get_note_pitch (ev) & 0x7f);
+    case MIDI_EVENT_TYPE_NOTE_OFF:
+      return
+        16 * 128 + channel * 128 +
+        (midi_event_get_note_pitch (ev) & 0x7f);
+    case MIDI_EVENT_TYPE_CONTROLLER:
+      return
+        2 * 16 * 128 + channel * 128 +
+        (midi_event_get_controller (ev) & 0x7f);
+    case MIDI_EVENT_TYPE_PITCHBEND:
+      return 3 * 16 * 128 + channel;
+    case MIDI_EVENT_TYPE_ALL_NOTES_OFF:
+      return 3 * 16 * 128 + 16 + channel;
+    default:
+      return -1;
+    }
+}
+
+/**
+ * Appends the event to the main events, keeping
+ * them sorted by time.
+ */
+static inline void
+insert_sorted (
+  MidiEvents *      self,
+  const MidiEvent * ev)
+{
+  if (self->num_events >=
+        get_limit (
+          self->capacity,
+          is_note_off (ev->raw_buffer)))
+    {
+      drop_event (self, F_NOT_QUEUED);
+      return;
+    }
+
+  self->events[self->num_events++] = *ev;
+  sort_last_event (self);
+}
+
 /**
  * Appends the events from src to dest
  *
@@ -168,8 +466,14 @@ midi_events_append_w_filter (
             }
         }
 
-      g_return_if_fail (
-        dest->num_events < MAX_MIDI_EVENTS);
+      if (dest->num_events >=
+            get_limit (
+              dest->capacity,
+              is_note_off (src_ev->raw_buffer)))
+        {
+          drop_event (dest, F_NOT_QUEUED);
+          continue;
+        }
 
       dest_ev =
         &dest->events[dest->num_events++];
@@ -198,7 +502,6 @@ midi_events_set_channel (
   for (int i = 0; i < self->num_events; i++)
     {
       MidiEvent * ev = &self->events[i];
-      ev->channel = channel;
 
       /* do this on all MIDI events that have
        * channels */
@@ -233,6 +536,12 @@ midi_events_set_channel (
 
 /**
  * Clears midi events.
+ *
+ * Queued events must only be cleared from the
+ * engine thread. This never waits for other
+ * threads: if one is in the middle of queueing,
+ * the events queued so far are dropped in the
+ * next midi_events_dequeue() instead.
  */
 REALTIME
 void
@@ -242,7 +551,27 @@ midi_events_clear (
 {
   if (queued)
     {
-      self->num_queued_events = 0;
+      MidiEventsQueue * q =
+        (MidiEventsQueue *)
+        g_atomic_pointer_get (&self->queue);
+      gint state = g_atomic_int_get (&q->state);
+      int reserved =
+        queue_state_get_reserved (state);
+      self->num_deferred = 0;
+      if (reserved ==
+            queue_state_get_committed (state) &&
+          g_atomic_int_compare_and_exchange (
+            &q->state, state,
+            state & ~((1 << QUEUE_BUF_SHIFT) - 1)))
+        {
+          self->num_discarded = 0;
+        }
+      else
+        {
+          /* slots are reserved in order, so these
+           * are the first events in the buffer */
+          self->num_discarded = reserved;
+        }
     }
   else
     {
@@ -251,126 +580,256 @@ midi_events_clear (
 }
 
 /**
- * Returns if a note on event for the given note
- * exists in the given events.
+ * Inits the MidiEvents struct.
  */
-int
-midi_events_check_for_note_on (
-  MidiEvents * self,
-  int          note,
-  int          queued)
+void
+midi_events_init (
+  MidiEvents * self)
 {
-  /*g_message ("waiting check note on");*/
-  zix_sem_wait (&self->access_sem);
+  self->num_events = 0;
+  g_atomic_int_set (&self->num_queue_writers, 0);
+  g_atomic_int_set (&self->num_dropped, 0);
+  g_atomic_int_set (&self->num_queue_dropped, 0);
+  self->num_deferred = 0;
+  self->num_discarded = 0;
+
+  midi_events_reserve (
+    self, MIDI_EVENTS_INITIAL_CAPACITY);
+}
 
-  MidiEvent * ev;
-  for (int i = 0;
-       i < queued ?
-         self->num_queued_events :
-         self->num_events;
-       i++)
-    {
-      if (queued)
-        ev = &self->queued_events[i];
-      else
-        ev = &self->events[i];
+/**
+ * Allocates and inits a MidiEvents struct.
+ */
+MidiEvents *
+midi_events_new (void)
+{
+  MidiEvents * self = object_new (MidiEvents);
 
-      if (ev->type == MIDI_EVENT_TYPE_NOTE_ON &&
-          ev->note_pitch == note)
-        return 1;
+  midi_events_init (self);
+
+  return self;
+}
+
+/**
+ * Grows the main events so that they can hold
+ * at least the given number of events.
+ */
+static void
+grow_events (
+  MidiEvents * self,
+  int          capacity)
+{
+  capacity = MIN (capacity, MAX_MIDI_EVENTS);
+  if (capacity <= self->capacity)
+    return;
+
+  MidiEvent * events =
+    object_new_n (
+      (size_t) get_limit (capacity, true),
+      MidiEvent);
+  if (self->events)
+    {
+      memcpy (
+        events, self->events,
+        (size_t) self->num_events *
+          sizeof (MidiEvent));
+      free (self->events);
     }
+  self->events = events;
+  self->capacity = capacity;
+}
+
+/**
+ * Creates an empty queue whose buffers can each
+ * hold the given number of events.
+ */
+static MidiEventsQueue *
+queue_new (
+  int capacity)
+{
+  MidiEventsQueue * self =
+    object_new (MidiEventsQueue);
+  int limit = get_limit (capacity, true);
+  self->events[0] =
+    object_new_n ((size_t) limit * 2, MidiEvent);
+  self->events[1] = &self->events[0][limit];
+  self->capacity = capacity;
 
-  zix_sem_post (&self->access_sem);
-  /*g_message ("posted check note on");*/
+  return self;
+}
 
-  return 0;
+static void
+queue_free (
+  MidiEventsQueue * self)
+{
+  free (self->events[0]);
+
+  object_zero_and_free (self);
 }
 
 /**
- * Deletes the midi event with a note on signal
- * from the queue, and returns if it deleted or not.
+ * Grows the queue so that each buffer can hold at
+ * least the given number of events.
+ *
+ * Other threads may keep queueing events while
+ * this is called: a new queue is published and
+ * the old one is only freed after every thread
+ * that could be writing to it is done. Its
+ * pending events are then moved to the new
+ * queue.
  */
-int
-midi_events_delete_note_on (
+static void
+grow_queue (
   MidiEvents * self,
-  int note,
-  int queued)
+  int          capacity)
 {
-  /*g_message ("waiting delete note on");*/
-  zix_sem_wait (&self->access_sem);
-
-  MidiEvent * ev, * ev2, * next_ev;
-  int match = 0;
-  for (int i = queued ?
-         self->num_queued_events - 1 :
-         self->num_events - 1;
-       i >= 0; i--)
+  capacity = MIN (capacity, MAX_MIDI_EVENTS);
+  MidiEventsQueue * old_q =
+    (MidiEventsQueue *)
+    g_atomic_pointer_get (&self->queue);
+  if (old_q && capacity <= old_q->capacity)
+    return;
+
+  MidiEventsQueue * q = queue_new (capacity);
+  g_atomic_pointer_set (&self->queue, q);
+  if (!old_q)
+    return;
+
+  /* writers that got the old queue are counted
+   * before they looked it up, so once there are
+   * no writers nobody can be using it */
+  while (g_atomic_int_get (
+           &self->num_queue_writers) > 0)
     {
-      ev = queued ?
-        &self->queued_events[i] :
-        &self->events[i];
-      if (ev->type == MIDI_EVENT_TYPE_NOTE_ON &&
-          ev->note_pitch == note)
-        {
-          match = 1;
-
-          if (queued)
-            --self->num_queued_events;
-          else
-            --self->num_events;
-
-          for (int ii = i;
-               ii < queued ?
-                 self->num_queued_events :
-                 self->num_events;
-               ii++)
-            {
-              if (queued)
-                {
-                  ev2 = &self->queued_events[ii];
-                  next_ev =
-                    &self->queued_events[ii + 1];
-                }
-              else
-                {
-                  ev2 = &self->events[ii];
-                  next_ev =
-                    &self->events[ii + 1];
-                }
-              midi_event_copy (ev2, next_ev);
-            }
-        }
+      g_thread_yield ();
     }
 
-  zix_sem_post (&self->access_sem);
+  /* the other buffer was already dequeued */
+  gint state = g_atomic_int_get (&old_q->state);
+  MidiEvent * pending =
+    old_q->events[queue_state_get_buf (state)];
+  int num_pending =
+    queue_state_get_committed (state);
+  for (int i = 0; i < num_pending; i++)
+    {
+      MidiEventsQueue * cur_q;
+      MidiEvent * ev =
+        reserve_event (
+          self, F_QUEUED,
+          is_note_off (pending[i].raw_buffer),
+          &cur_q);
+      if (!ev)
+        continue;
+
+      *ev = pending[i];
+      commit_event (self, F_QUEUED, cur_q);
+    }
 
-  return match;
+  queue_free (old_q);
 }
 
 /**
- * Inits the MidiEvents struct.
+ * Grows the buffers so that the main events and
+ * each queue buffer can hold at least the given
+ * number of events (up to \ref MAX_MIDI_EVENTS).
+ *
+ * Must not be called while the events are being
+ * processed or queued.
  */
 void
-midi_events_init (
+midi_events_reserve (
+  MidiEvents * self,
+  int          capacity)
+{
+  grow_events (self, capacity);
+  grow_queue (self, capacity);
+}
+
+/**
+ * Doubles the capacity of the buffers that
+ * dropped events since they were last grown.
+ *
+ * Must not be called while the events are being
+ * processed or queued.
+ *
+ * @return Whether any buffer was grown.
+ */
+bool
+midi_events_grow_if_dropped (
   MidiEvents * self)
 {
-  self->num_events = 0;
-  self->num_queued_events = 0;
+  bool grown = false;
+  int num_dropped =
+    g_atomic_int_get (&self->num_dropped);
+  if (num_dropped > 0 &&
+      self->capacity < MAX_MIDI_EVENTS)
+    {
+      g_message (
+        "%d MIDI event(s) dropped, growing buffer "
+        "from %d events",
+        num_dropped, self->capacity);
+      grow_events (
+        self,
+        MAX (
+          self->capacity * 2,
+          self->capacity + num_dropped));
+      grown = true;
+    }
+  int num_queue_dropped =
+    g_atomic_int_get (&self->num_queue_dropped);
+  int queue_capacity = self->queue->capacity;
+  if (num_queue_dropped > 0 &&
+      queue_capacity < MAX_MIDI_EVENTS)
+    {
+      g_message (
+        "%d queued MIDI event(s) dropped, growing "
+        "queue from %d events",
+        num_queue_dropped, queue_capacity);
+      grow_queue (
+        self,
+        MAX (
+          queue_capacity * 2,
+          queue_capacity + num_queue_dropped));
+      grown = true;
+    }
+  g_atomic_int_set (&self->num_dropped, 0);
+  g_atomic_int_set (&self->num_queue_dropped, 0);
 
-  zix_sem_init (&self->access_sem, 1);
+  return grown;
 }
 
 /**
- * Allocates and inits a MidiEvents struct.
+ * Returns whether any MidiEvents dropped events
+ * since the last call, and resets the flag.
+ *
+ * Used to find out when to call
+ * midi_events_grow_if_dropped() without polling
+ * every buffer.
  */
-MidiEvents *
-midi_events_new (void)
+bool
+midi_events_get_and_clear_overflow (void)
 {
-  MidiEvents * self = object_new (MidiEvents);
-
-  midi_events_init (self);
+  return
+    g_atomic_int_compare_and_exchange (
+      &overflowed, 1, 0);
+}
 
-  return self;
+/**
+ * Returns the memory used by the MidiEvents, in
+ * bytes.
+ */
+size_t
+midi_events_get_memory_size (
+  const MidiEvents * self)
+{
+  return
+    sizeof (MidiEvents) +
+    ((size_t) get_limit (self->capacity, true) +
+       (size_t)
+         get_limit (self->queue->capacity, true) *
+         2) *
+      sizeof (MidiEvent) +
+    sizeof (MidiEventsQueue);
 }
 
 /**
@@ -390,17 +849,21 @@ midi_events_has_note_on (
     {
       for (int i = 0; i < self->num_events; i++)
         {
-          if (self->events[i].type ==
+          if (midi_event_get_type (
+                &self->events[i]) ==
                 MIDI_EVENT_TYPE_NOTE_ON)
             return 1;
         }
     }
   if (check_queued)
     {
-      for (int i = 0;
-           i < self->num_queued_events; i++)
+      int num_queued;
+      MidiEvent * queued_events =
+        get_queued_events (self, &num_queued);
+      for (int i = 0; i < num_queued; i++)
         {
-          if (self->queued_events[i].type ==
+          if (midi_event_get_type (
+                &queued_events[i]) ==
                 MIDI_EVENT_TYPE_NOTE_ON)
             return 1;
         }
@@ -410,7 +873,23 @@ midi_events_has_note_on (
 }
 
 /**
- * Copies the queue contents to the original struct
+ * Moves the queued events to the main events.
+ *
+ * The queue buffers are swapped and the events of
+ * the old buffer are merged into the main events
+ * sorted by time, without duplicates.
+ *
+ * Only other threads queue events. The engine
+ * thread writes its own events (eg, from regions)
+ * directly to the main events after calling this.
+ *
+ * This never blocks: if another thread is in the
+ * middle of queueing an event, the queued events
+ * are left for the next cycle. They are then
+ * moved to the start of that cycle since their
+ * times refer to the cycle they were meant for.
+ *
+ * To be called from the engine thread only.
  */
 REALTIME
 NONNULL
@@ -418,24 +897,54 @@ void
 midi_events_dequeue (
   MidiEvents * self)
 {
-  /*g_message ("waiting dequeue");*/
-  zix_sem_wait (&self->access_sem);
+  self->num_events = 0;
 
-  MidiEvent * ev, * q_ev;
-  for (int i = 0;
-       i < self->num_queued_events; i++)
+  MidiEventsQueue * q =
+    (MidiEventsQueue *)
+    g_atomic_pointer_get (&self->queue);
+  gint state = g_atomic_int_get (&q->state);
+  int num_queued = queue_state_get_reserved (state);
+  if (num_queued == 0)
+    return;
+
+  /* swap the buffers - fails if a slot is still
+   * being written or another thread reserved a
+   * slot in the meantime */
+  int buf = queue_state_get_buf (state);
+  if (queue_state_get_committed (state) !=
+        num_queued ||
+      !g_atomic_int_compare_and_exchange (
+         &q->state, state,
+         (1 - buf) << QUEUE_BUF_SHIFT))
     {
-      q_ev = &self->queued_events[i];
-      ev = &self->events[i];
-
-      midi_event_copy (ev, q_ev);
+      /* slots are reserved in order, so the events
+       * meant for this cycle are the first ones in
+       * the buffer */
+      self->num_deferred = num_queued;
+      return;
     }
 
-  self->num_events = self->num_queued_events;
-  self->num_queued_events = 0;
+  /* no other thread can write to the old buffer
+   * until the next swap */
+  MidiEvent * queued_events = q->events[buf];
+  int num_deferred =
+    MIN (self->num_deferred, num_queued);
+  int num_discarded =
+    MIN (self->num_discarded, num_queued);
+  self->num_discarded = 0;
+  for (int i = num_discarded; i < num_queued; i++)
+    {
+      /* events left over from the previous cycle
+       * are late, play them right away */
+      if (i < num_deferred)
+        queued_events[i].time = 0;
+
+      insert_sorted (self, &queued_events[i]);
+    }
+  self->num_deferred = 0;
 
-  zix_sem_post (&self->access_sem);
-  /*g_message ("posted dequeue");*/
+  midi_events_clear_duplicates (
+    self, F_NOT_QUEUED);
 }
 
 /**
@@ -448,27 +957,21 @@ midi_events_add_all_notes_off (
   midi_time_t  time,
   bool         queued)
 {
-  MidiEvent * ev;
-  if (queued)
-    ev =
-      &self->queued_events[self->num_queued_events];
-  else
-    ev =
-      &self->events[self->num_events];
+  MidiEventsQueue * q;
+  MidiEvent * ev =
+    reserve_event (self, queued, true, &q);
+  if (!ev)
+    return;
 
-  ev->type = MIDI_EVENT_TYPE_ALL_NOTES_OFF;
-  ev->channel = channel;
   ev->time = time;
   ev->raw_buffer[0] =
     (midi_byte_t)
     (MIDI_CH1_CTRL_CHANGE | (channel - 1));
   ev->raw_buffer[1] = MIDI_ALL_NOTES_OFF;
   ev->raw_buffer[2] = 0x00;
+  ev->raw_buffer_sz = 3;
 
-  if (queued)
-    self->num_queued_events++;
-  else
-    self->num_events++;
+  commit_event (self, queued, q);
 }
 
 void
@@ -476,14 +979,12 @@ midi_events_panic (
   MidiEvents * self,
   bool         queued)
 {
-  zix_sem_wait (&self->access_sem);
   /*g_message ("sending PANIC");*/
   for (midi_byte_t i = 0; i < 16; i++)
     {
       midi_events_add_all_notes_off (
         self, i, 0, queued);
     }
-  zix_sem_post (&self->access_sem);
 }
 
 static int
@@ -497,8 +998,9 @@ sort_events_func (
   if (a->time == b->time)
     {
       return
-        a->type == MIDI_EVENT_TYPE_NOTE_ON ?
-          -1 : 1;
+        midi_event_get_type (a) ==
+          MIDI_EVENT_TYPE_NOTE_ON ?
+            -1 : 1;
     }
 
   return (int) a->time - (int) b->time;
@@ -565,17 +1067,12 @@ midi_events_add_note_off (
   midi_time_t  time,
   int          queued)
 {
-  MidiEvent * ev;
-  if (queued)
-    ev =
-      &self->queued_events[self->num_queued_events];
-  else
-    ev =
-      &self->events[self->num_events];
+  MidiEventsQueue * q;
+  MidiEvent * ev =
+    reserve_event (self, queued, true, &q);
+  if (!ev)
+    return;
 
-  ev->type = MIDI_EVENT_TYPE_NOTE_OFF;
-  ev->channel = channel;
-  ev->note_pitch = note_pitch;
   ev->time = time;
   ev->raw_buffer[0] =
     (midi_byte_t)
@@ -584,10 +1081,7 @@ midi_events_add_note_off (
   ev->raw_buffer[2] = 90;
   ev->raw_buffer_sz = 3;
 
-  if (queued)
-    self->num_queued_events++;
-  else
-    self->num_events++;
+  commit_event (self, queued, q);
 }
 
 void
@@ -604,28 +1098,22 @@ midi_events_add_raw (
       g_return_if_reached ();
     }
 
-  MidiEvent * ev;
-  if (queued)
-    ev =
-      &self->queued_events[self->num_queued_events];
-  else
-    ev =
-      &self->events[self->num_events];
+  MidiEventsQueue * q;
+  MidiEvent * ev =
+    reserve_event (
+      self, queued,
+      buf_sz == 3 && is_note_off (buf), &q);
+  if (!ev)
+    return;
 
-  ev->type = MIDI_EVENT_TYPE_RAW;
-  ev->channel = 0;
-  ev->controller = 0;
-  ev->control = 0;
   ev->time = time;
   for (size_t i = 0; i < buf_sz; i++)
     {
       ev->raw_buffer[i] = buf[i];
     }
+  ev->raw_buffer_sz = (uint8_t) buf_sz;
 
-  if (queued)
-    self->num_queued_events++;
-  else
-    self->num_events++;
+  commit_event (self, queued, q);
 }
 
 /**
@@ -643,18 +1131,14 @@ midi_events_add_control_change (
   midi_time_t  time,
   int          queued)
 {
-  MidiEvent * ev;
-  if (queued)
-    ev =
-      &self->queued_events[self->num_queued_events];
-  else
-    ev =
-      &self->events[self->num_events];
+  MidiEventsQueue * q;
+  MidiEvent * ev =
+    reserve_event (
+      self, queued,
+      controller == MIDI_ALL_NOTES_OFF, &q);
+  if (!ev)
+    return;
 
-  ev->type = MIDI_EVENT_TYPE_CONTROLLER;
-  ev->channel = channel;
-  ev->controller = controller;
-  ev->control = control;
   ev->time = time;
   ev->raw_buffer[0] =
     (midi_byte_t)
@@ -663,10 +1147,7 @@ midi_events_add_control_change (
   ev->raw_buffer[2] = control;
   ev->raw_buffer_sz = 3;
 
-  if (queued)
-    self->num_queued_events++;
-  else
-    self->num_events++;
+  commit_event (self, queued, q);
 }
 
 /**
@@ -684,16 +1165,12 @@ midi_events_add_pitchbend (
   midi_time_t  time,
   int          queued)
 {
-  MidiEvent * ev;
-  if (queued)
-    ev =
-      &self->queued_events[self->num_queued_events];
-  else
-    ev =
-      &self->events[self->num_events];
+  MidiEventsQueue * q;
+  MidiEvent * ev =
+    reserve_event (self, queued, false, &q);
+  if (!ev)
+    return;
 
-  ev->type = MIDI_EVENT_TYPE_PITCHBEND;
-  ev->pitchbend = pitchbend;
   ev->time = time;
   ev->raw_buffer[0] =
     (midi_byte_t)
@@ -703,52 +1180,25 @@ midi_events_add_pitchbend (
     &ev->raw_buffer[2]);
   ev->raw_buffer_sz = 3;
 
-  if (queued)
-    self->num_queued_events++;
-  else
-    self->num_events++;
-}
-
-HOT
-static int
-midi_event_cmpfunc (
-  const void * _a,
-  const void * _b)
-{
-  const MidiEvent * a =
-    (MidiEvent const *) _a;
-  const MidiEvent * b =
-    (MidiEvent const *) _b;
-  if (a->time == b->time)
-    {
-      return (int) a->type - (int) b->type;
-    }
-  return (int) a->time - (int) b->time;
+  commit_event (self, queued, q);
 }
 
 /**
  * Sorts the MidiEvents by time.
+ *
+ * @param queued Not supported, queued events are
+ *   sorted when dequeued.
  */
 void
 midi_events_sort (
   MidiEvents * self,
   const bool   queued)
 {
-  MidiEvent * events;
-  size_t num_events;
-  if (queued)
-    {
-      events = self->queued_events;
-      num_events = (size_t) self->num_queued_events;
-    }
-  else
-    {
-      events = self->events;
-      num_events = (size_t) self->num_events;
-    }
+  g_return_if_fail (!queued);
+
   qsort (
-    events, num_events, sizeof (MidiEvent),
-    midi_event_cmpfunc);
+    self->events, (size_t) self->num_events,
+    sizeof (MidiEvent), midi_event_cmpfunc);
 }
 
 /**
@@ -773,18 +1223,13 @@ midi_events_add_note_on (
     __func__, channel, note_pitch, velocity, time);
 #endif
 
-  MidiEvent * ev;
-  if (queued)
-    ev =
-      &self->queued_events[self->num_queued_events];
-  else
-    ev =
-      &self->events[self->num_events];
+  MidiEventsQueue * q;
+  MidiEvent * ev =
+    reserve_event (
+      self, queued, velocity == 0, &q);
+  if (!ev)
+    return;
 
-  ev->type = MIDI_EVENT_TYPE_NOTE_ON;
-  ev->channel = channel;
-  ev->note_pitch = note_pitch;
-  ev->velocity = velocity;
   ev->time = time;
   ev->raw_buffer[0] =
     (midi_byte_t)
@@ -793,10 +1238,7 @@ midi_events_add_note_on (
   ev->raw_buffer[2] = velocity;
   ev->raw_buffer_sz = 3;
 
-  if (queued)
-    self->num_queued_events++;
-  else
-    self->num_events++;
+  commit_event (self, queued, q);
 }
 
 /**
@@ -931,28 +1373,22 @@ midi_events_delete_event (
   const MidiEvent * ev,
   const bool        queued)
 {
-  MidiEvent * arr =
-    queued ?
-      self->queued_events :
-      self->events;
-#define NUM_EVENTS \
-  (queued ? self->num_queued_events : \
-   self->num_events)
+  /* queued not implemented */
+  g_return_if_fail (!queued);
 
-  for (int i = 0; i < NUM_EVENTS; i++)
+  for (int i = 0; i < self->num_events; i++)
     {
-      MidiEvent * cur_ev = &arr[i];
+      MidiEvent * cur_ev = &self->events[i];
       if (cur_ev == ev)
         {
-          for (int k = i; k < NUM_EVENTS - 1; k++)
+          for (int k = i; k < self->num_events - 1;
+               k++)
             {
               midi_event_copy (
-                &arr[k + 1], &arr[k]);
+                &self->events[k],
+                &self->events[k + 1]);
             }
-          if (queued)
-            self->num_queued_events--;
-          else
-            self->num_events--;
+          self->num_events--;
           i--;
         }
     }
@@ -963,7 +1399,6 @@ midi_event_set_velocity (
   MidiEvent * ev,
   midi_byte_t vel)
 {
-  ev->velocity = vel;
   ev->raw_buffer[2] = vel;
 }
 
@@ -972,7 +1407,7 @@ midi_event_print (
   const MidiEvent * ev)
 {
   char raw[300];
-  sprintf (raw, "Raw (%zu):", ev->raw_buffer_sz);
+  sprintf (raw, "Raw (%u):", ev->raw_buffer_sz);
   for (size_t i = 0; i < ev->raw_buffer_sz;
        i++)
     {
@@ -992,9 +1427,11 @@ midi_event_print (
     "Velocity: %u\n"
     "Time: %u\n"
     "%s",
-    midi_event_type_strings[ev->type], ev->channel,
-    ev->note_pitch,
-    ev->velocity, ev->time, raw);
+    midi_event_type_strings[
+      midi_event_get_type (ev)],
+    midi_event_get_channel (ev),
+    midi_event_get_note_pitch (ev),
+    midi_event_get_velocity (ev), ev->time, raw);
 
   g_message ("%s", msg);
 }
@@ -1004,16 +1441,9 @@ midi_events_are_equal (
   const MidiEvent * src,
   const MidiEvent * dest)
 {
+  /* the decoded values all come from the raw
+   * data */
   int ret =
-    dest->type == src->type &&
-    dest->pitchbend == src->pitchbend &&
-    dest->controller == src->controller &&
-    dest->control == src->control &&
-    dest->channel == src->channel &&
-    dest->note_pitch == src->note_pitch &&
-    (src->type != MIDI_EVENT_TYPE_NOTE_ON ||
-      (src->type == MIDI_EVENT_TYPE_NOTE_ON &&
-       dest->velocity == src->velocity)) &&
     dest->time == src->time &&
     dest->raw_buffer[0] == src->raw_buffer[0] &&
     dest->raw_buffer[1] == src->raw_buffer[1] &&
@@ -1026,71 +1456,81 @@ midi_events_print (
   MidiEvents * self,
   const int    queued)
 {
-  MidiEvent * arr =
-    queued ?
-      self->queued_events :
-      self->events;
-  MidiEvent * ev1;
-#define NUM_EVENTS \
-  (queued ? self->num_queued_events : \
-   self->num_events)
-
-  int i;
-  for (i = 0; i < NUM_EVENTS; i++)
+  MidiEvent * arr = self->events;
+  int num_events = self->num_events;
+  if (queued)
     {
-      ev1 = &arr[i];
-      midi_event_print (ev1);
+      arr = get_queued_events (self, &num_events);
+    }
+
+  for (int i = 0; i < num_events; i++)
+    {
+      midi_event_print (&arr[i]);
     }
 }
 
 /**
  * Clears duplicates.
  *
- * @param queued Clear duplicates from queued events
- * instead.
+ * Events that can have duplicates are first looked
+ * up in a bitmap indexed by type, channel and note
+ * or controller, so the events only need to be
+ * compared when there is a hit.
+ *
+ * @param queued Not supported, queued events are
+ *   de-duplicated when dequeued.
  */
 void
 midi_events_clear_duplicates (
   MidiEvents * self,
   const int    queued)
 {
-  MidiEvent * arr =
-    queued ?
-      self->queued_events :
-      self->events;
-  MidiEvent * ev1, * ev2;
-#define NUM_EVENTS \
-  (queued ? self->num_queued_events : \
-   self->num_events)
-
-  int i, j, k;
-  for (i = 0; i < NUM_EVENTS; i++)
+  g_return_if_fail (!queued);
+
+  uint8_t bitmap[DUP_BITMAP_NUM_BITS / 8] = { 0 };
+  int num_kept = 0;
+  for (int i = 0; i < self->num_events; i++)
     {
-      ev1 = &arr[i];
+      MidiEvent * ev = &self->events[i];
+      int idx = get_dup_bitmap_idx (ev);
 
-      for (j = i + 1; j < NUM_EVENTS; j++)
+      bool is_dup = false;
+      if (idx < 0 ||
+          bitmap[idx / 8] & (1 << (idx % 8)))
         {
-          ev2 = &arr[j];
-
-          if (midi_events_are_equal (ev1, ev2))
+          for (int j = 0; j < num_kept; j++)
             {
-#if 0
-              g_message (
-                "removing duplicate MIDI event");
-#endif
-              for (k = j; k < NUM_EVENTS; k++)
+              if (midi_events_are_equal (
+                    &self->events[j], ev))
                 {
-                  midi_event_copy (
-                    &arr[k], &arr[k + 1]);
+                  is_dup = true;
+                  break;
                 }
-              if (queued)
-                self->num_queued_events--;
-              else
-                self->num_events--;
-              j--;
             }
         }
+      if (is_dup)
+        {
+#if 0
+          g_message (
+            "removing duplicate MIDI event");
+#endif
+          continue;
+        }
+
+      if (idx >= 0)
+        {
+          bitmap[idx / 8] |=
+            (uint8_t) (1 << (idx % 8));
+        }
+      if (num_kept != i)
+        {
+          midi_event_copy (
+            &self->events[num_kept], ev);
+        }
+      num_kept++;
     }
+
+  self->num_events = num_kept;
 }
 
 /**
@@ -1100,7 +1540,9 @@ void
 midi_events_free (
   MidiEvents * self)
 {
-  zix_sem_destroy (&self->access_sem);
+  free (self->events);
+  object_free_w_func_and_null (
+    queue_free, self->queue);
 
   object_zero_and_free (self);
 }
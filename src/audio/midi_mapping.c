@@ -279,11 +279,35 @@ apply_mapping (
     }
 }
 
+/**
+ * Applies the given buffer to the matching ports.
+ */
+void
+midi_mappings_apply (
+  MidiMappings * self,
+  midi_byte_t *  buf)
+{
+  for (int i = 0; i < self->num_mappings; i++)
+    {
+      MidiMapping * mapping = self->mappings[i];
+
+      if (g_atomic_int_get (&mapping->enabled) &&
+          mapping->key[0] == buf[0] &&
+          mapping->key[1] == buf[1])
+        {
+          apply_mapping (mapping, buf);
+        }
+    }
+}
+
 /**
  * Applies the events to the appropriate mapping.
  *
  * This is used only for TrackProcessor.cc_mappings.
  *
+ * Only the CCs that have a port are mapped, so
+ * the mappings are looked up by their key.
+ *
  * @note Must only be called while transport is
  *   recording.
  */
@@ -299,42 +323,11 @@ midi_mappings_apply_from_cc_events (
   for (int i = 0; i < events->num_events; i++)
     {
       MidiEvent * ev = &events->events[i];
-      if (ev->raw_buffer[0] >=
-            (midi_byte_t) MIDI_CH1_CTRL_CHANGE &&
-          ev->raw_buffer[0] <=
-            (midi_byte_t)
-            (MIDI_CH1_CTRL_CHANGE | 15))
+      if (midi_event_get_type (ev) ==
+            MIDI_EVENT_TYPE_CONTROLLER)
         {
-          midi_byte_t channel =
-            (midi_byte_t)
-            ((ev->raw_buffer[0] & 0xf) + 1);
-          midi_byte_t controller = ev->raw_buffer[1];
-          MidiMapping * mapping =
-            self->mappings[
-              (channel - 1) * 128 + controller];
-          apply_mapping (
-            mapping, ev->raw_buffer);
-        }
-    }
-}
-
-/**
- * Applies the given buffer to the matching ports.
- */
-void
-midi_mappings_apply (
-  MidiMappings * self,
-  midi_byte_t *  buf)
-{
-  for (int i = 0; i < self->num_mappings; i++)
-    {
-      MidiMapping * mapping = self->mappings[i];
-
-      if (g_atomic_int_get (&mapping->enabled) &&
-          mapping->key[0] == buf[0] &&
-          mapping->key[1] == buf[1])
-        {
-          apply_mapping (mapping, buf);
+          midi_mappings_apply (
+            self, ev->raw_buffer);
         }
     }
 }
@@ -24,6 +24,7 @@
 #include "audio/position.h"
 #include "audio/track.h"
 #include "audio/velocity.h"
+#include "gui/backend/arranger_object_index.h"
 #include "gui/backend/midi_arranger_selections.h"
 #include "gui/widgets/arranger.h"
 #include "gui/widgets/bot_dock_edge.h"
@@ -309,16 +310,18 @@ midi_note_set_val (
       MidiEvents * midi_events =
         track->processor->piano_roll->midi_events;
 
-      zix_sem_wait (&midi_events->access_sem);
       TrackLane * lane =
         region_get_lane (region);
       midi_events_add_note_off (
         midi_events, lane->midi_ch,
         midi_note->val, 0, 1);
-      zix_sem_post (&midi_events->access_sem);
     }
 
   midi_note->val = val;
+
+  /* the note moves to another pitch bucket */
+  arranger_object_index_object_changed (
+    (ArrangerObject *) midi_note);
 }
 
 /**
@@ -46,6 +46,7 @@
 #include "audio/region.h"
 #include "audio/tempo_track.h"
 #include "audio/track.h"
+#include "gui/backend/arranger_object_index.h"
 #include "gui/backend/event.h"
 #include "gui/backend/event_manager.h"
 #include "gui/widgets/bot_dock_edge.h"
@@ -193,6 +194,9 @@ midi_region_insert_midi_note (
         mn, self, i);
     }
 
+  arranger_object_index_object_added (
+    self, (ArrangerObject *) midi_note);
+
   if (pub_events)
     {
       EVENTS_PUSH (
@@ -364,6 +368,9 @@ midi_region_remove_midi_note (
     region->midi_notes, region->num_midi_notes,
     midi_note);
 
+  arranger_object_index_object_removed (
+    (ArrangerObject *) midi_note);
+
   for (int i = 0; i < region->num_midi_notes; i++)
     {
       midi_note_set_region_and_index (
@@ -984,6 +991,8 @@ midi_region_get_as_events (
   const int       full)
 {
   MidiEvents * events = midi_events_new ();
+  midi_events_reserve (
+    events, self->num_midi_notes * 2);
 
   ArrangerObject * self_obj =
     (ArrangerObject *) self;
@@ -1042,15 +1051,16 @@ send_notes_off_at (
     }
 
   midi_events_add_all_notes_off (
-    midi_events, channel, time, F_QUEUED);
+    midi_events, channel, time, F_NOT_QUEUED);
 
 }
 
 /**
- * Fills MIDI event queue from the region.
+ * Fills MIDI events from the region.
  *
- * The events are dequeued right after the call to
- * this function.
+ * The events are written directly to the main
+ * events, sorted by time, so this must only be
+ * called from the engine thread.
  *
  * @note The caller already splits calls to this
  *   function at each sub-loop inside the region,
@@ -1159,14 +1169,14 @@ midi_region_fill_midi_events (
                 midi_events,
                 midi_region_get_midi_ch (self),
                 mn->val, mn->vel->vel,
-                _time, F_QUEUED);
+                _time, F_NOT_QUEUED);
             }
           else if (co)
             {
               midi_events_add_note_ons_from_chord_descr (
                 midi_events, descr, 1,
                 VELOCITY_DEFAULT, _time,
-                F_QUEUED);
+                F_NOT_QUEUED);
             }
         }
 
@@ -1212,7 +1222,7 @@ midi_region_fill_midi_events (
               midi_events_add_note_off (
                 midi_events,
                 midi_region_get_midi_ch (self),
-                mn->val, _time, F_QUEUED);
+                mn->val, _time, F_NOT_QUEUED);
             }
           else if (co)
             {
@@ -1224,7 +1234,7 @@ midi_region_fill_midi_events (
                     {
                       midi_events_add_note_off (
                         midi_events, 1, l + 36,
-                        _time, F_QUEUED);
+                        _time, F_NOT_QUEUED);
                     }
                 }
             }
@@ -21,7 +21,9 @@
 
 #include "actions/undo_manager.h"
 #include "audio/clip.h"
+#include "audio/engine.h"
 #include "audio/pool.h"
+#include "audio/stretch_cache.h"
 #include "audio/track.h"
 #include "audio/tracklist.h"
 #include "project.h"
@@ -325,6 +327,14 @@ audio_pool_remove_clip (
     audio_pool_get_clip (self, clip_id);
   g_return_if_fail (clip);
 
+  /* the ID may be reused */
+  if (PROJECT && AUDIO_ENGINE &&
+      self == AUDIO_POOL && STRETCH_CACHE)
+    {
+      stretch_cache_remove_clip (
+        STRETCH_CACHE, clip_id);
+    }
+
   if (free_and_remove_file)
     {
       audio_clip_remove_and_free (clip, backup);
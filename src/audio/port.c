@@ -39,6 +39,7 @@
 #include "audio/rtaudio_device.h"
 #include "audio/rtmidi_device.h"
 #include "audio/tempo_track.h"
+#include "audio/track_processor.h"
 #include "audio/windows_mme_device.h"
 #include "gui/backend/event.h"
 #include "gui/backend/event_manager.h"
@@ -94,7 +95,7 @@ port_allocate_bufs (
         zix_ring_free, self->midi_ring);
       self->midi_ring =
         zix_ring_new (
-          sizeof (MidiEvent) * (size_t) 11);
+          sizeof (MidiRingEvent) * (size_t) 11);
       break;
     case TYPE_AUDIO:
     case TYPE_CV:
@@ -104,6 +105,7 @@ port_allocate_bufs (
         self->audio_ring =
           zix_ring_new (
             sizeof (float) * AUDIO_RING_SIZE);
+        port_restore_own_buf (self);
         object_zero_and_free (self->buf);
         size_t max =
           MAX (
@@ -118,6 +120,90 @@ port_allocate_bufs (
     }
 }
 
+/**
+ * Creates any buffers used during DSP that the
+ * port doesn't have yet, without attaching them
+ * to the port.
+ *
+ * This does not modify the port, so it can be
+ * called while the port is processed.
+ *
+ * @param[out] midi_events Set to a new event
+ *   buffer if the port needs one, or NULL.
+ * @param[out] midi_ring Set to a new MIDI ring
+ *   if the port needs one, or NULL.
+ * @param[out] audio_ring Set to a new audio ring
+ *   if the port needs one, or NULL.
+ *
+ * @return The size the audio buffer needs to
+ *   have, in frames, or 0 if the current one is
+ *   large enough.
+ */
+size_t
+port_create_missing_bufs (
+  const Port *  self,
+  MidiEvents ** midi_events,
+  ZixRing **    midi_ring,
+  ZixRing **    audio_ring)
+{
+  *midi_events = NULL;
+  *midi_ring = NULL;
+  *audio_ring = NULL;
+
+  switch (self->id.type)
+    {
+    case TYPE_EVENT:
+      if (!self->midi_events)
+        *midi_events = midi_events_new ();
+      if (!self->midi_ring)
+        {
+          *midi_ring =
+            zix_ring_new (
+              sizeof (MidiRingEvent) * (size_t) 11);
+        }
+      break;
+    case TYPE_AUDIO:
+    case TYPE_CV:
+      {
+        if (!self->audio_ring)
+          {
+            *audio_ring =
+              zix_ring_new (
+                sizeof (float) * AUDIO_RING_SIZE);
+          }
+        size_t max =
+          MAX (
+            AUDIO_ENGINE->block_length,
+            self->min_buf_size);
+        max = MAX (max, 1);
+        float * own_buf =
+          self->own_buf ? self->own_buf : self->buf;
+        if (!own_buf || self->last_buf_sz < max)
+          return max;
+      }
+      break;
+    default:
+      break;
+    }
+
+  return 0;
+}
+
+/**
+ * Points \ref Port.buf back to the port's own
+ * buffer if it was using a shared buffer.
+ */
+void
+port_restore_own_buf (
+  Port * self)
+{
+  if (self->own_buf)
+    {
+      self->buf = self->own_buf;
+      self->own_buf = NULL;
+    }
+}
+
 /**
  * Frees buffers.
  *
@@ -134,6 +220,7 @@ port_free_bufs (
     zix_ring_free, self->midi_ring);
   object_free_w_func_and_null (
     zix_ring_free, self->audio_ring);
+  port_restore_own_buf (self);
   object_zero_and_free (self->buf);
 }
 
@@ -2541,6 +2628,12 @@ port_set_control_value (
       self->last_change = g_get_monotonic_time ();
       self->value_changed_from_reading = false;
 
+      if (id->flags & PORT_FLAG_MIDI_AUTOMATABLE)
+        {
+          track_processor_mark_midi_automatable_dirty (
+            self);
+        }
+
       /* if bpm, update engine */
       if (id->flags & PORT_FLAG_BPM)
         {
@@ -2912,16 +3005,18 @@ port_process (
                i < events->num_events; i++)
             {
               MidiEvent * ev = &events->events[i];
-              switch (ev->type)
+              switch (midi_event_get_type (ev))
                 {
                 case MIDI_EVENT_TYPE_NOTE_ON:
                   piano_roll_add_current_note (
-                    PIANO_ROLL, ev->note_pitch);
+                    PIANO_ROLL,
+                    midi_event_get_note_pitch (ev));
                   events_processed = true;
                   break;
                 case MIDI_EVENT_TYPE_NOTE_OFF:
                   piano_roll_remove_current_note (
-                    PIANO_ROLL, ev->note_pitch);
+                    PIANO_ROLL,
+                    midi_event_get_note_pitch (ev));
                   events_processed = true;
                   break;
                 case MIDI_EVENT_TYPE_ALL_NOTES_OFF:
@@ -3119,20 +3214,21 @@ port_process (
                 {
                   if (zix_ring_write_space (
                         port->midi_ring) <
-                        sizeof (MidiEvent))
+                        sizeof (MidiRingEvent))
                     {
                       zix_ring_skip (
                         port->midi_ring,
-                        sizeof (MidiEvent));
+                        sizeof (MidiRingEvent));
                     }
 
-                  MidiEvent * ev =
-                    &events->events[i];
-                  ev->systime =
-                    g_get_monotonic_time ();
+                  MidiRingEvent ring_ev = {
+                    .ev = events->events[i],
+                    .systime =
+                      g_get_monotonic_time (),
+                  };
                   zix_ring_write (
-                    port->midi_ring, ev,
-                    sizeof (MidiEvent));
+                    port->midi_ring, &ring_ev,
+                    sizeof (MidiRingEvent));
                 }
             }
           else
@@ -3278,28 +3374,32 @@ port_process (
             }
         }
 
-      if (local_offset + nframes ==
-            AUDIO_ENGINE->block_length)
-        {
-          size_t size =
-            sizeof (float) *
-            (size_t) AUDIO_ENGINE->block_length;
-          size_t write_space_avail =
-            zix_ring_write_space (
-              port->audio_ring);
-
-          /* move the read head 8 blocks to make
-           * space if no space avail to write */
-          if (write_space_avail / size < 1)
-            {
-              zix_ring_skip (
-                port->audio_ring, size * 8);
-            }
+      /* write the frames of this sub-cycle to the
+       * ring now, since a shared buffer may hold
+       * another port's data by the end of the
+       * cycle */
+      {
+        size_t block_size =
+          sizeof (float) *
+          (size_t) AUDIO_ENGINE->block_length;
+        size_t size =
+          sizeof (float) * (size_t) nframes;
+        size_t write_space_avail =
+          zix_ring_write_space (
+            port->audio_ring);
+
+        /* move the read head 8 blocks to make
+         * space if no space avail to write */
+        if (write_space_avail < size)
+          {
+            zix_ring_skip (
+              port->audio_ring, block_size * 8);
+          }
 
-          zix_ring_write (
-            port->audio_ring, &port->buf[0],
-            size);
-        }
+        zix_ring_write (
+          port->audio_ring,
+          &port->buf[local_offset], size);
+      }
 
       /* if track output (to be shown on mixer) */
       if (id->owner_type ==
@@ -3588,6 +3688,12 @@ port_process (
                 port->control = result;
                 port_forward_control_change_event (
                   port);
+                if (port->id.flags &
+                      PORT_FLAG_MIDI_AUTOMATABLE)
+                  {
+                    track_processor_mark_midi_automatable_dirty (
+                      port);
+                  }
               }
           }
       }
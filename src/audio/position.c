@@ -22,7 +22,9 @@
 #include "audio/engine.h"
 #include "audio/position.h"
 #include "audio/snap_grid.h"
+#include "audio/tempo_map.h"
 #include "audio/tempo_track.h"
+#include "audio/track.h"
 #include "audio/transport.h"
 #include "gui/widgets/arranger.h"
 #include "gui/widgets/bot_dock_edge.h"
@@ -35,7 +37,6 @@
 #include "gui/widgets/timeline_ruler.h"
 #include "gui/widgets/top_bar.h"
 #include "project.h"
-#include "utils/algorithms.h"
 #include "utils/math.h"
 #include "utils/objects.h"
 
@@ -74,11 +75,10 @@ void
 position_update_ticks_from_frames (
   Position * self)
 {
-  g_return_if_fail (
-    AUDIO_ENGINE->ticks_per_frame > 0);
+  const TempoMap * map = AUDIO_ENGINE->tempo_map;
+  g_return_if_fail (map && map->num_segments > 0);
   self->ticks =
-    (double)
-    self->frames * AUDIO_ENGINE->ticks_per_frame;
+    tempo_map_frames_to_ticks (map, self->frames);
 }
 
 /**
@@ -88,11 +88,10 @@ long
 position_get_frames_from_ticks (
   double ticks)
 {
+  const TempoMap * map = AUDIO_ENGINE->tempo_map;
   g_return_val_if_fail (
-    AUDIO_ENGINE->frames_per_tick > 0, -1);
-  return
-    math_round_double_to_long (
-      (ticks * AUDIO_ENGINE->frames_per_tick));
+    map && map->num_segments > 0, -1);
+  return tempo_map_ticks_to_frames (map, ticks);
 }
 
 /**
@@ -256,6 +255,29 @@ closest_snap_point (
     }
 }
 
+/**
+ * Returns the index of the first position in the
+ * given sorted array that is after \ref ticks.
+ */
+static inline int
+get_first_event_after (
+  const double * events,
+  const int      num_events,
+  const double   ticks)
+{
+  int lo = 0;
+  int hi = num_events;
+  while (lo < hi)
+    {
+      int mid = lo + (hi - lo) / 2;
+      if (events[mid] <= ticks)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return lo;
+}
+
 /**
  * Gets the previous snap point.
  *
@@ -293,55 +315,29 @@ get_prev_snap_point (
     }
 
   bool snapped = false;
-  Position * snap_point = NULL;
   if (sg->snap_to_grid)
     {
-      snap_point =
-        (Position *)
-        algorithms_binary_search_nearby (
-          pos, sg->snap_points,
-          (size_t) sg->num_snap_points,
-          sizeof (Position), position_cmp_func,
-          true, true);
-    }
-  if (snap_point)
-    {
-      position_set_to_pos (prev_sp, snap_point);
-      snapped = true;
+      snapped =
+        snap_grid_get_nearby_snap_point (
+          sg, pos, true, true, prev_sp);
     }
 
   if (track)
     {
-      for (int i = 0; i < track->num_lanes; i++)
+      int num_events;
+      const double * events =
+        track_get_snap_event_ticks (
+          track, &num_events);
+      int idx =
+        get_first_event_after (
+          events, num_events, pos->ticks) - 1;
+      if (idx >= 0 &&
+          (!snapped ||
+           events[idx] > prev_sp->ticks))
         {
-          TrackLane * lane = track->lanes[i];
-          for (int j = 0; j < lane->num_regions;
-               j++)
-            {
-              ZRegion * r = lane->regions[j];
-              ArrangerObject * r_obj =
-                (ArrangerObject *) r;
-              snap_point = &r_obj->pos;
-              if (position_is_before_or_equal (
-                    snap_point, pos) &&
-                  position_is_after (
-                    snap_point, prev_sp))
-                {
-                  position_set_to_pos (
-                    prev_sp, snap_point);
-                  snapped = true;
-                }
-              snap_point = &r_obj->end_pos;
-              if (position_is_before_or_equal (
-                    snap_point, pos) &&
-                  position_is_after (
-                    snap_point, prev_sp))
-                {
-                  position_set_to_pos (
-                    prev_sp, snap_point);
-                  snapped = true;
-                }
-            }
+          position_from_ticks (
+            prev_sp, events[idx]);
+          snapped = true;
         }
     }
   else if (region)
@@ -395,54 +391,29 @@ get_next_snap_point (
     }
 
   bool snapped = false;
-  Position * snap_point = NULL;
   if (sg->snap_to_grid)
     {
-      snap_point =
-        algorithms_binary_search_nearby (
-          pos, sg->snap_points,
-          (size_t) sg->num_snap_points,
-          sizeof (Position), position_cmp_func,
-          false, false);
-    }
-  if (snap_point)
-    {
-      position_set_to_pos (next_sp, snap_point);
-      snapped = true;
+      snapped =
+        snap_grid_get_nearby_snap_point (
+          sg, pos, false, false, next_sp);
     }
 
   if (track)
     {
-      for (int i = 0; i < track->num_lanes; i++)
+      int num_events;
+      const double * events =
+        track_get_snap_event_ticks (
+          track, &num_events);
+      int idx =
+        get_first_event_after (
+          events, num_events, pos->ticks);
+      if (idx < num_events &&
+          (!snapped ||
+           events[idx] < next_sp->ticks))
         {
-          TrackLane * lane = track->lanes[i];
-          for (int j = 0; j < lane->num_regions;
-               j++)
-            {
-              ZRegion * r = lane->regions[j];
-              ArrangerObject * r_obj =
-                (ArrangerObject *) r;
-              snap_point = &r_obj->pos;
-              if (position_is_after (
-                    snap_point, pos) &&
-                  position_is_before (
-                    snap_point, next_sp))
-                {
-                  position_set_to_pos (
-                    next_sp, snap_point);
-                  snapped = true;
-                }
-              snap_point = &r_obj->end_pos;
-              if (position_is_after (
-                    snap_point, pos) &&
-                  position_is_before (
-                    snap_point, next_sp))
-                {
-                  position_set_to_pos (
-                    next_sp, snap_point);
-                  snapped = true;
-                }
-            }
+          position_from_ticks (
+            next_sp, events[idx]);
+          snapped = true;
         }
     }
   else if (region)
@@ -743,19 +714,16 @@ position_to_string_full (
   char *           buf,
   int              decimal_places)
 {
-  int bars = position_get_bars (pos, true);
-  int beats = position_get_beats (pos, true);
-  int sixteenths =
-    position_get_sixteenths (pos, true);
-  double ticks = position_get_ticks (pos);
-  g_return_if_fail (bars > -80000);
+  MusicalTime time;
+  position_get_musical_time (pos, true, &time);
+  g_return_if_fail (time.bars > -80000);
   char template[32];
   sprintf (
     template, "%%d.%%d.%%d.%%.%df", decimal_places);
   sprintf (
     buf, template,
-    bars, abs (beats), abs (sixteenths),
-    fabs (ticks));
+    time.bars, abs (time.beats),
+    abs (time.sixteenths), fabs (time.ticks));
 }
 
 /**
@@ -922,6 +890,39 @@ position_change_sign (
   pos->frames = - pos->frames;
 }
 
+/**
+ * Splits the position into bars, beats,
+ * sixteenths and ticks.
+ *
+ * This is cheaper than calling
+ * position_get_bars(), position_get_beats(),
+ * etc. separately.
+ *
+ * @param start_at_one Start at 1 or -1 instead of
+ *   0.
+ */
+void
+position_get_musical_time (
+  const Position * pos,
+  bool             start_at_one,
+  MusicalTime *    time)
+{
+  const TempoMap * map =
+    ZRYTHM && PROJECT && AUDIO_ENGINE ?
+      AUDIO_ENGINE->tempo_map : NULL;
+  if (!map)
+    {
+      g_critical ("no tempo map");
+      *time = (MusicalTime) {
+        .bars = -1, .beats = -1,
+        .sixteenths = -1, .ticks = -1 };
+      return;
+    }
+
+  tempo_map_get_musical_time (
+    map, pos->ticks, start_at_one, time);
+}
+
 /**
  * Gets the bars of the position.
  *
@@ -936,30 +937,10 @@ position_get_bars (
   const Position * pos,
   bool  start_at_one)
 {
-  g_return_val_if_fail (
-    ZRYTHM && PROJECT && TRANSPORT &&
-    TRANSPORT->ticks_per_bar > 0, -1);
-
-  double total_bars =
-    pos->ticks / TRANSPORT->ticks_per_bar;
-  if (total_bars >= 0.0)
-    {
-      int ret = (int) floor (total_bars);
-      if (start_at_one)
-        {
-          ret++;
-        }
-      return ret;
-    }
-  else
-    {
-      int ret = (int) ceil (total_bars);
-      if (start_at_one)
-        {
-          ret--;
-        }
-      return ret;
-    }
+  MusicalTime time;
+  position_get_musical_time (
+    pos, start_at_one, &time);
+  return time.bars;
 }
 
 /**
@@ -976,40 +957,10 @@ position_get_beats (
   const Position * pos,
   bool  start_at_one)
 {
-  g_return_val_if_fail (
-    ZRYTHM && PROJECT && TRANSPORT &&
-    TRANSPORT->ticks_per_bar > 0 &&
-    TRANSPORT->ticks_per_beat > 0 &&
-    P_TEMPO_TRACK, -1);
-
-  int beats_per_bar =
-    tempo_track_get_beats_per_bar (P_TEMPO_TRACK);
-  g_return_val_if_fail (beats_per_bar > 0, -1);
-
-  double total_bars =
-    (double) position_get_bars (pos, false);
-  double total_beats =
-    pos->ticks / TRANSPORT->ticks_per_beat;
-  total_beats -=
-    (double) (total_bars * beats_per_bar);
-  if (total_beats >= 0.0)
-    {
-      int ret = (int) floor (total_beats);
-      if (start_at_one)
-        {
-          ret++;
-        }
-      return ret;
-    }
-  else
-    {
-      int ret = (int) ceil (total_beats);
-      if (start_at_one)
-        {
-          ret--;
-        }
-      return ret;
-    }
+  MusicalTime time;
+  position_get_musical_time (
+    pos, start_at_one, &time);
+  return time.beats;
 }
 
 /**
@@ -1026,38 +977,10 @@ position_get_sixteenths (
   const Position * pos,
   bool  start_at_one)
 {
-  g_return_val_if_fail (
-    ZRYTHM && PROJECT && TRANSPORT &&
-    TRANSPORT->sixteenths_per_beat > 0, -1);
-
-  double total_beats =
-    (double) position_get_total_beats (pos, true);
-  /*g_message ("total beats %f", total_beats);*/
-  double total_sixteenths =
-    pos->ticks / TICKS_PER_SIXTEENTH_NOTE_DBL;
-  /*g_message ("total sixteenths %f",*/
-    /*total_sixteenths);*/
-  total_sixteenths -=
-    (double)
-    (total_beats * TRANSPORT->sixteenths_per_beat);
-  if (total_sixteenths >= 0.0)
-    {
-      int ret = (int) floor (total_sixteenths);
-      if (start_at_one)
-        {
-          ret++;
-        }
-      return ret;
-    }
-  else
-    {
-      int ret = (int) ceil (total_sixteenths);
-      if (start_at_one)
-        {
-          ret--;
-        }
-      return ret;
-    }
+  MusicalTime time;
+  position_get_musical_time (
+    pos, start_at_one, &time);
+  return time.sixteenths;
 }
 
 /**
@@ -1070,13 +993,9 @@ double
 position_get_ticks (
   const Position * pos)
 {
-  double total_sixteenths =
-    position_get_total_sixteenths (pos, true);
-  /*g_debug ("total sixteenths %f", total_sixteenths);*/
-  return
-    pos->ticks -
-    (total_sixteenths *
-     TICKS_PER_SIXTEENTH_NOTE_DBL);
+  MusicalTime time;
+  position_get_musical_time (pos, false, &time);
+  return time.ticks;
 }
 
 bool
@@ -26,55 +26,12 @@
 #include "audio/snap_grid.h"
 #include "audio/transport.h"
 #include "project.h"
-#include "utils/algorithms.h"
 #include "utils/objects.h"
 #include "utils/pcg_rand.h"
 #include "zrythm.h"
 
 #include <gtk/gtk.h>
 
-/**
- * Updates snap points.
- */
-void
-quantize_options_update_quantize_points (
-  QuantizeOptions * self)
-{
-  Position tmp, end_pos;
-  position_init (&tmp);
-  position_set_to_bar (
-    &end_pos,
-    TRANSPORT->total_bars + 1);
-  self->num_q_points = 0;
-  position_set_to_pos (
-    &self->q_points[self->num_q_points++],
-    &tmp);
-  long ticks =
-    snap_grid_get_ticks_from_length_and_type (
-      self->note_length,
-      self->note_type);
-  long swing_offset =
-    (long)
-    (((float) self->swing / 100.f) *
-    (float) ticks / 2.f);
-  while (position_is_before (&tmp, &end_pos))
-    {
-      position_add_ticks (
-        &tmp, ticks);
-
-      /* delay every second point by swing */
-      if ((self->num_q_points + 1) % 2 == 0)
-        {
-          position_add_ticks (
-            &tmp, swing_offset);
-        }
-
-      position_set_to_pos (
-        &self->q_points[self->num_q_points++],
-        &tmp);
-    }
-}
-
 void
 quantize_options_init (
   QuantizeOptions * self,
@@ -83,7 +40,6 @@ quantize_options_init (
   self->schema_version =
     QUANTIZE_OPTIONS_SCHEMA_VERSION;
   self->note_length = note_length;
-  self->num_q_points = 0;
   self->note_type = NOTE_TYPE_NORMAL;
   self->amount = 100;
   self->adj_start = 1;
@@ -154,42 +110,78 @@ quantize_options_stringize (
       note_length, note_type);
 }
 
-static Position *
-get_prev_point (
-  QuantizeOptions * self,
-  Position *        pos)
+/**
+ * Returns the quantize point at the given index in
+ * ticks.
+ *
+ * Quantize points are multiples of the note length,
+ * with every second point delayed by the swing
+ * amount.
+ *
+ * @param ticks Note length in ticks.
+ */
+static inline double
+get_point_ticks (
+  const QuantizeOptions * self,
+  const double            ticks,
+  const long              idx)
 {
-  g_return_val_if_fail (
-    pos->frames >= 0 && pos->ticks >= 0, NULL);
+  double point_ticks = (double) idx * ticks;
+  if (idx % 2 == 1)
+    {
+      point_ticks +=
+        ((double) self->swing / 100.0) *
+        ticks / 2.0;
+    }
 
-  Position * prev_point =
-    (Position *)
-    algorithms_binary_search_nearby (
-      pos, self->q_points,
-      (size_t) self->num_q_points,
-      sizeof (Position), position_cmp_func,
-      true, true);
+  return point_ticks;
+}
+
+/**
+ * Gets the quantize point at or before the given
+ * position.
+ */
+static void
+get_prev_point (
+  const QuantizeOptions * self,
+  const double            ticks,
+  const Position *        pos,
+  Position *              prev_point)
+{
+  long idx = (long) floor (pos->ticks / ticks);
+  if (idx > 0 &&
+      get_point_ticks (self, ticks, idx) >
+        pos->ticks)
+    {
+      idx--;
+    }
 
-  return prev_point;
+  position_from_ticks (
+    prev_point,
+    get_point_ticks (self, ticks, idx));
 }
 
-static Position *
+/**
+ * Gets the quantize point at or after the given
+ * position.
+ */
+static void
 get_next_point (
-  QuantizeOptions * self,
-  Position *        pos)
+  const QuantizeOptions * self,
+  const double            ticks,
+  const Position *        pos,
+  Position *              next_point)
 {
-  g_return_val_if_fail (
-    pos->frames >= 0 && pos->ticks >= 0, NULL);
-
-  Position * next_point =
-    (Position *)
-    algorithms_binary_search_nearby (
-      pos, self->q_points,
-      (size_t) self->num_q_points,
-      sizeof (Position), position_cmp_func,
-      false, true);
+  long idx = (long) floor (pos->ticks / ticks);
+  if (get_point_ticks (self, ticks, idx) <
+        pos->ticks)
+    {
+      idx++;
+    }
 
-  return next_point;
+  position_from_ticks (
+    next_point,
+    get_point_ticks (self, ticks, idx));
 }
 
 /**
@@ -208,12 +200,18 @@ quantize_options_quantize_position (
   QuantizeOptions * self,
   Position *        pos)
 {
-  Position * prev_point =
-    get_prev_point (self, pos);
-  Position * next_point =
-    get_next_point (self, pos);
   g_return_val_if_fail (
-    prev_point && next_point, 0);
+    pos->frames >= 0 && pos->ticks >= 0, 0);
+
+  double ticks =
+    (double)
+    snap_grid_get_ticks_from_length_and_type (
+      self->note_length, self->note_type);
+  g_return_val_if_fail (ticks > 0, 0);
+
+  Position prev_point, next_point;
+  get_prev_point (self, ticks, pos, &prev_point);
+  get_next_point (self, ticks, pos, &next_point);
 
   const double upper = self->rand_ticks;
   const double lower = - self->rand_ticks;
@@ -224,15 +222,15 @@ quantize_options_quantize_position (
 
   /* if previous point is closer */
   double diff;
-  if (pos->ticks - prev_point->ticks <=
-      next_point->ticks - pos->ticks)
+  if (pos->ticks - prev_point.ticks <=
+      next_point.ticks - pos->ticks)
     {
-      diff = prev_point->ticks - pos->ticks;
+      diff = prev_point.ticks - pos->ticks;
     }
   /* if next point is closer */
   else
     {
-      diff = next_point->ticks - pos->ticks;
+      diff = next_point.ticks - pos->ticks;
     }
 
   /* multiply by amount */
@@ -268,8 +266,6 @@ quantize_options_clone (
   opts->swing = src->swing;
   opts->rand_ticks = src->rand_ticks;
 
-  quantize_options_update_quantize_points (opts);
-
   return opts;
 }
 
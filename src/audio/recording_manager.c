@@ -1208,19 +1208,21 @@ handle_midi_event (
   MidiNote * mn;
   ArrangerObject * mn_obj;
   MidiEvent * mev = &ev->midi_event;
-  switch (mev->type)
+  switch (midi_event_get_type (mev))
     {
       case MIDI_EVENT_TYPE_NOTE_ON:
         g_return_if_fail (region);
         midi_region_start_unended_note (
           region, &local_pos, &local_end_pos,
-          mev->note_pitch, mev->velocity, 1);
+          midi_event_get_note_pitch (mev),
+          midi_event_get_velocity (mev), 1);
         break;
       case MIDI_EVENT_TYPE_NOTE_OFF:
         g_return_if_fail (region);
         mn =
           midi_region_pop_unended_note (
-            region, mev->note_pitch);
+            region,
+            midi_event_get_note_pitch (mev));
         if (mn)
           {
             mn_obj =
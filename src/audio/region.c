@@ -31,7 +31,7 @@
 #include "audio/region.h"
 #include "audio/region_link_group_manager.h"
 #include "audio/router.h"
-#include "audio/stretcher.h"
+#include "audio/stretch_cache.h"
 #include "audio/track.h"
 #include "gui/widgets/automation_region.h"
 #include "gui/widgets/bot_dock_edge.h"
@@ -278,6 +278,9 @@ region_move_to_track (
  * This should be called right after changing the
  * region's size.
  *
+ * Audio is stretched in the background (see
+ * StretchCache).
+ *
  * @param ratio The ratio to stretch by.
  */
 void
@@ -320,51 +323,10 @@ region_stretch (
         }
       break;
     case REGION_TYPE_AUDIO:
-      {
-        g_return_if_fail (
-          router_is_processing_thread (ROUTER));
-        AudioClip * clip =
-          audio_region_get_clip (self);
-        int new_clip_id =
-          audio_pool_duplicate_clip (
-            AUDIO_POOL, clip->pool_id,
-            F_NO_WRITE_FILE);
-        AudioClip * new_clip =
-          audio_pool_get_clip (
-            AUDIO_POOL, new_clip_id);
-        audio_region_set_clip_id (
-          self, new_clip->pool_id);
-        Stretcher * stretcher =
-          stretcher_new_rubberband (
-            AUDIO_ENGINE->sample_rate,
-            new_clip->channels, ratio, 1.0, false);
-        ssize_t returned_frames =
-          stretcher_stretch_interleaved (
-            stretcher, new_clip->frames,
-            (size_t) new_clip->num_frames,
-            &new_clip->frames);
-        g_warn_if_fail (returned_frames > 0);
-        new_clip->num_frames = returned_frames;
-        audio_clip_write_to_pool (
-          new_clip, F_NO_PARTS, F_NOT_BACKUP);
-        (void) obj;
-        /* readjust end position to match the
-         * number of frames exactly */
-        Position new_end_pos;
-        position_from_frames (
-          &new_end_pos, returned_frames);
-        arranger_object_set_position (
-          obj, &new_end_pos,
-          ARRANGER_OBJECT_POSITION_TYPE_LOOP_END,
-          F_NO_VALIDATE);
-        position_add_frames (
-          &new_end_pos, obj->pos.frames);
-        arranger_object_set_position (
-          obj, &new_end_pos,
-          ARRANGER_OBJECT_POSITION_TYPE_END,
-          F_NO_VALIDATE);
-        stretcher_free (stretcher);
-      }
+      /* the region keeps playing its current clip
+       * until the stretched one is ready */
+      stretch_cache_stretch_region (
+        STRETCH_CACHE, self, ratio);
       break;
     default:
       g_critical ("unimplemented");
@@ -48,6 +48,7 @@
 #include "audio/engine_pa.h"
 #endif
 #include "audio/graph.h"
+#include "audio/graph_profiler.h"
 #include "audio/graph_thread.h"
 #include "audio/master_track.h"
 #include "audio/midi.h"
@@ -57,8 +58,11 @@
 #include "audio/router.h"
 #include "audio/stretcher.h"
 #include "audio/tempo_track.h"
+#include "audio/time_info_snapshot.h"
 #include "audio/track.h"
 #include "audio/track_processor.h"
+#include "audio/tracklist.h"
+#include "gui/backend/clip_editor.h"
 #include "project.h"
 #include "utils/arrays.h"
 #include "utils/flags.h"
@@ -90,6 +94,82 @@ router_get_max_route_playback_latency (
   return router->max_route_playback_latency;
 }
 
+/**
+ * Computes the musical time for the positions
+ * that the plugins will be processed at, so that
+ * each plugin doesn't have to.
+ */
+static void
+update_time_infos (
+  Router *                      self,
+  const EngineProcessTimeInfo * time_nfo)
+{
+  time_info_snapshot_fill (
+    &self->time_infos[0], &self->time_info_forge,
+    time_nfo->g_start_frames);
+  self->num_time_infos = 1;
+
+  /* same as the loop split in
+   * graph_node_process() */
+  nframes_t frames_to_loop_end =
+    transport_is_loop_point_met (
+      TRANSPORT, time_nfo->g_start_frames,
+      time_nfo->nframes);
+  if (frames_to_loop_end > 0 &&
+      frames_to_loop_end < time_nfo->nframes)
+    {
+      time_info_snapshot_fill (
+        &self->time_infos[1],
+        &self->time_info_forge,
+        (time_nfo->g_start_frames +
+           frames_to_loop_end +
+           TRANSPORT->loop_start_pos.frames) -
+          TRANSPORT->loop_end_pos.frames);
+      self->num_time_infos = 2;
+    }
+}
+
+/**
+ * Returns the musical time at the given position
+ * for plugins.
+ *
+ * This returns the snapshot computed at the start
+ * of the cycle when called from a processing
+ * thread for a position it was computed for
+ * (which is the case unless the plugin is latency
+ * compensated). Otherwise, @p tmp is filled in
+ * and returned.
+ *
+ * This is realtime-safe.
+ */
+const TimeInfoSnapshot *
+router_get_time_info (
+  Router *           self,
+  long               g_start_frames,
+  TimeInfoSnapshot * tmp)
+{
+  if (self->callback_in_progress &&
+      router_is_processing_thread (self))
+    {
+      for (int i = 0; i < self->num_time_infos;
+           i++)
+        {
+          if (self->time_infos[i].g_start_frames ==
+                g_start_frames)
+            {
+              return &self->time_infos[i];
+            }
+        }
+    }
+
+  /* use a copy since the router's forge may be
+   * in use */
+  LV2_Atom_Forge forge = self->time_info_forge;
+  time_info_snapshot_fill (
+    tmp, &forge, g_start_frames);
+  return tmp;
+}
+
 /**
  * Starts a new cycle.
  */
@@ -117,6 +197,8 @@ router_start_cycle (
       return;
     }
 
+  graph_profiler_begin_cycle (self->profiler);
+
   self->global_offset =
     self->max_route_playback_latency -
     AUDIO_ENGINE->remaining_latency_preroll;
@@ -169,6 +251,9 @@ router_start_cycle (
         self->graph->beat_unit_node, time_nfo);
     }
 
+  /* after the tempo ports were processed */
+  update_time_infos (self, &time_nfo);
+
   self->callback_in_progress = true;
   zix_sem_post (&self->graph->callback_start);
   zix_sem_wait (&self->graph->callback_done);
@@ -177,6 +262,22 @@ router_start_cycle (
   zix_sem_post (&self->graph_access);
 }
 
+/**
+ * Sets up the caches to tracks, channels, plugins,
+ * automation tracks, etc. used during processing.
+ *
+ * These are single pointers that the processing
+ * threads only read, so this is done after the new
+ * chain was swapped in without holding graph
+ * access.
+ */
+static void
+set_caches (void)
+{
+  clip_editor_set_caches (CLIP_EDITOR);
+  tracklist_set_caches (TRACKLIST);
+}
+
 /**
  * Recalculates the process acyclic directed graph.
  *
@@ -196,6 +297,8 @@ router_recalc_graph (
     {
       self->graph = graph_new (self);
       graph_setup (self->graph, 1, 1);
+      graph_rechain (self->graph);
+      set_caches ();
       graph_start (self->graph);
       return;
     }
@@ -208,14 +311,75 @@ router_recalc_graph (
     }
   else
     {
-      zix_sem_wait (&self->graph_access);
+      /* profiles only cover a single graph */
+      graph_profiler_stop (self->profiler);
+
+      /* set up the new chain while the current
+       * one keeps processing, then swap it in
+       * between cycles */
       graph_setup (self->graph, 1, 1);
+      zix_sem_wait (&self->graph_access);
+      graph_rechain (self->graph);
       zix_sem_post (&self->graph_access);
+      set_caches ();
     }
 
   g_message ("done");
 }
 
+/**
+ * Updates the graph after the given ports were
+ * connected or disconnected.
+ *
+ * The running graph is patched in place if
+ * possible, otherwise it is recalculated.
+ *
+ * @param connected Whether the ports were
+ *   connected (otherwise disconnected).
+ */
+void
+router_update_port_connection (
+  Router * self,
+  Port *   src,
+  Port *   dest,
+  bool     connected)
+{
+  if (self->graph &&
+      graph_update_port_connection (
+        self->graph, src, dest, connected))
+    {
+      g_message (
+        "patched graph for %s %s %s",
+        src->id.label,
+        connected ? "=>" : "=/=>",
+        dest->id.label);
+      return;
+    }
+
+  router_recalc_graph (self, F_NOT_SOFT);
+}
+
+/**
+ * Starts profiling the next \ref num_cycles
+ * cycles.
+ *
+ * The results can be obtained from \ref
+ * Router.profiler once
+ * graph_profiler_is_finished() returns true.
+ */
+void
+router_start_profiling (
+  Router * self,
+  int      num_cycles)
+{
+  g_return_if_fail (self && self->graph);
+
+  zix_sem_wait (&self->graph_access);
+  graph_profiler_start (
+    self->profiler, self->graph, num_cycles);
+  zix_sem_post (&self->graph_access);
+}
+
 /**
  * Queues a control port change to be applied
  * when processing starts.
@@ -260,6 +424,11 @@ router_new (void)
     zix_ring_new (
       sizeof (ControlPortChange) * (size_t) 24);
 
+  self->profiler = graph_profiler_new ();
+
+  time_info_snapshot_init_forge (
+    &self->time_info_forge);
+
   g_message ("done");
 
   return self;
@@ -357,6 +526,9 @@ router_free (
   object_free_w_func_and_null (
     zix_ring_free, self->ctrl_port_change_queue);
 
+  object_free_w_func_and_null (
+    graph_profiler_free, self->profiler);
+
   object_zero_and_free (self);
 
   g_debug ("%s: done", __func__);
@@ -17,14 +17,14 @@
  * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <math.h>
+
 #include "audio/engine.h"
 #include "audio/snap_grid.h"
 #include "audio/transport.h"
 #include "project.h"
 #include "settings/settings.h"
-#include "utils/algorithms.h"
-#include "utils/arrays.h"
-#include "utils/mem.h"
+#include "utils/math.h"
 #include "utils/objects.h"
 
 #include <gtk/gtk.h>
@@ -106,7 +106,7 @@ snap_grid_get_ticks_from_length_and_type (
  */
 int
 snap_grid_get_snap_ticks (
-  SnapGrid * self)
+  const SnapGrid * self)
 {
   return
     snap_grid_get_ticks_from_length_and_type (
@@ -151,52 +151,6 @@ snap_grid_get_default_ticks (
     }
 }
 
-static void
-add_snap_point (
-  SnapGrid * self,
-  Position * snap_point)
-{
-  array_double_size_if_full (
-    self->snap_points, self->num_snap_points,
-    self->snap_points_size, Position);
-  position_from_ticks (
-    &self->snap_points[self->num_snap_points++],
-    snap_point->ticks);
-  /*position_set_to_pos (*/
-    /*&self->snap_points[self->num_snap_points++],*/
-    /*snap_point);*/
-}
-
-/**
- * Updates snap points.
- */
-void
-snap_grid_update_snap_points (
-  SnapGrid * self,
-  int        max_bars)
-{
-  POSITION_INIT_ON_STACK (tmp);
-  Position end_pos;
-  position_set_to_bar (
-    &end_pos, max_bars);
-  self->num_snap_points = 0;
-  add_snap_point (self, &tmp);
-  long ticks = snap_grid_get_snap_ticks (self);
-  g_warn_if_fail (TRANSPORT->ticks_per_bar > 0);
-  while (tmp.ticks < end_pos.ticks)
-    {
-      tmp.ticks += ticks;
-      add_snap_point (self, &tmp);
-    }
-#if 0
-  while (position_is_before (&tmp, &end_pos))
-    {
-      position_add_ticks (&tmp, ticks);
-      add_snap_point (self, &tmp);
-    }
-#endif
-}
-
 void
 snap_grid_init (
   SnapGrid *   self,
@@ -205,17 +159,12 @@ snap_grid_init (
 {
   self->schema_version = SNAP_GRID_SCHEMA_VERSION;
   self->type = type;
-  self->num_snap_points = 0;
   self->snap_note_length = note_length;
   self->snap_note_type = NOTE_TYPE_NORMAL;
   self->default_note_length = note_length;
   self->default_note_type = NOTE_TYPE_NORMAL;
   self->snap_to_grid = true;
   self->length_type = NOTE_LENGTH_LINK;
-
-  self->snap_points_size = 128;
-  self->snap_points =
-    object_new_n (self->snap_points_size, Position);
 }
 
 static const char *
@@ -252,31 +201,70 @@ snap_grid_stringize (
 }
 
 /**
- * Returns the next or previous SnapGrid Point.
+ * Gets the next or previous grid point.
+ *
+ * Grid points are calculated from the snap length,
+ * so this takes constant time regardless of the
+ * project length.
  *
  * @param self Snap grid to search in.
- * @param pos Position to search for.
- * @param return_prev 1 to return the previous
- * element or 0 to return the next.
+ * @param pos Position to search for. Must be
+ *   positive.
+ * @param return_prev True to return the previous
+ *   point or false to return the next.
+ * @param include_equal Whether to return \ref pos
+ *   itself if it is a grid point.
+ * @param ret_pos Position to set. Will be set to
+ *   \ref pos if no point was found.
+ *
+ * @return Whether a point was found.
  */
-Position *
+bool
 snap_grid_get_nearby_snap_point (
   const SnapGrid * const self,
   const Position *       pos,
-  const int              return_prev)
+  const bool             return_prev,
+  const bool             include_equal,
+  Position *             ret_pos)
 {
+  position_set_to_pos (ret_pos, pos);
   g_return_val_if_fail (
-    pos->frames >= 0 && pos->ticks >= 0, NULL);
+    pos->frames >= 0 && pos->ticks >= 0, false);
+
+  double snap_ticks =
+    (double) snap_grid_get_snap_ticks (self);
+  g_return_val_if_fail (snap_ticks > 0, false);
+
+  /* grid point at or before pos */
+  double ticks =
+    floor (pos->ticks / snap_ticks) * snap_ticks;
+  if (ticks > pos->ticks)
+    {
+      /* rounding error */
+      ticks -= snap_ticks;
+    }
+
+  bool is_equal =
+    math_doubles_equal (ticks, pos->ticks);
+  if (return_prev)
+    {
+      if (is_equal && !include_equal)
+        {
+          ticks -= snap_ticks;
+        }
+      if (ticks < 0)
+        {
+          return false;
+        }
+    }
+  else if (!is_equal || !include_equal)
+    {
+      ticks += snap_ticks;
+    }
 
-  Position * ret_pos =
-    (Position *)
-    algorithms_binary_search_nearby (
-      pos, self->snap_points,
-      (size_t) self->num_snap_points,
-      sizeof (Position), position_cmp_func,
-      return_prev, false);
+  position_from_ticks (ret_pos, ticks);
 
-  return ret_pos;
+  return true;
 }
 
 SnapGrid *
@@ -0,0 +1,596 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio/audio_region.h"
+#include "audio/clip.h"
+#include "audio/engine.h"
+#include "audio/pool.h"
+#include "audio/region.h"
+#include "audio/router.h"
+#include "audio/stretch_cache.h"
+#include "audio/stretcher.h"
+#include "audio/track.h"
+#include "audio/track_lane.h"
+#include "audio/tracklist.h"
+#include "gui/backend/arranger_object.h"
+#include "gui/backend/event.h"
+#include "gui/backend/event_manager.h"
+#include "project.h"
+#include "utils/flags.h"
+#include "utils/objects.h"
+
+#include <glib.h>
+
+static StretchCacheEntry *
+entry_new (
+  AudioClip * base_clip,
+  double      ratio)
+{
+  StretchCacheEntry * self =
+    object_new (StretchCacheEntry);
+
+  self->base_clip_id = base_clip->pool_id;
+  self->ratio = ratio;
+  self->clip_id = -1;
+  self->channels = base_clip->channels;
+  self->samplerate = AUDIO_ENGINE->sample_rate;
+  self->name = g_strdup (base_clip->name);
+  self->bit_depth = base_clip->bit_depth;
+  self->src_num_frames = base_clip->num_frames;
+  size_t num_samples =
+    (size_t) base_clip->num_frames *
+      base_clip->channels;
+  self->src_frames =
+    object_new_n (MAX (num_samples, 1), float);
+  memcpy (
+    self->src_frames, base_clip->frames,
+    num_samples * sizeof (float));
+  self->regions =
+    g_array_new (
+      false, false,
+      sizeof (StretchCacheWaitingRegion));
+  g_atomic_int_set (
+    &self->state, STRETCH_CACHE_ENTRY_PENDING);
+
+  return self;
+}
+
+static void
+entry_free (
+  StretchCacheEntry * self)
+{
+  object_zero_and_free (self->src_frames);
+  object_zero_and_free (self->frames);
+  g_free_and_null (self->name);
+  object_free_w_func_and_null (
+    g_array_unref, self->regions);
+
+  object_zero_and_free (self);
+}
+
+/**
+ * Stretches the entry's frames (called from a
+ * worker thread).
+ */
+static void
+stretch_entry (
+  StretchCacheEntry * entry,
+  StretchCache *      self)
+{
+  Stretcher * stretcher =
+    stretcher_new_rubberband (
+      entry->samplerate, entry->channels,
+      entry->ratio, 1.0, false);
+  ssize_t returned_frames =
+    stretcher_stretch_interleaved (
+      stretcher, entry->src_frames,
+      (size_t) entry->src_num_frames,
+      &entry->frames);
+  stretcher_free (stretcher);
+  object_zero_and_free (entry->src_frames);
+
+  if (returned_frames <= 0)
+    {
+      g_warning (
+        "failed to stretch clip '%s' by %f",
+        entry->name, entry->ratio);
+      g_atomic_int_set (
+        &entry->state, STRETCH_CACHE_ENTRY_FAILED);
+      return;
+    }
+
+  entry->num_frames = (long) returned_frames;
+  g_atomic_int_set (
+    &entry->state, STRETCH_CACHE_ENTRY_STRETCHED);
+}
+
+/**
+ * Waits for the current cycle to finish and keeps
+ * the engine from starting another one, so that
+ * the pool and the regions can be changed while
+ * it is running.
+ *
+ * @return Whether the engine was locked.
+ */
+static bool
+lock_engine (void)
+{
+  bool lock =
+    ROUTER && engine_get_run (AUDIO_ENGINE);
+  if (lock)
+    zix_sem_wait (&ROUTER->graph_access);
+
+  return lock;
+}
+
+static void
+unlock_engine (
+  bool locked)
+{
+  if (locked)
+    zix_sem_post (&ROUTER->graph_access);
+}
+
+/**
+ * Switches the region to the given clip and
+ * readjusts its end position to match the number
+ * of frames exactly.
+ *
+ * The engine must be locked with lock_engine(),
+ * since the region is read while processing.
+ */
+static void
+switch_region_to_clip (
+  ZRegion *   region,
+  AudioClip * clip)
+{
+  ArrangerObject * obj = (ArrangerObject *) region;
+
+  audio_region_set_clip_id (region, clip->pool_id);
+
+  Position new_end_pos;
+  position_from_frames (
+    &new_end_pos, clip->num_frames);
+  arranger_object_set_position (
+    obj, &new_end_pos,
+    ARRANGER_OBJECT_POSITION_TYPE_LOOP_END,
+    F_NO_VALIDATE);
+  position_add_frames (
+    &new_end_pos, obj->pos.frames);
+  arranger_object_set_position (
+    obj, &new_end_pos,
+    ARRANGER_OBJECT_POSITION_TYPE_END,
+    F_NO_VALIDATE);
+
+  obj->use_cache = false;
+
+  EVENTS_PUSH (ET_ARRANGER_OBJECT_CHANGED, obj);
+}
+
+/**
+ * Returns the region in the project that is still
+ * waiting, or NULL if it was removed or switched to
+ * another clip since.
+ */
+static ZRegion *
+find_waiting_region (
+  const StretchCacheWaitingRegion * waiting)
+{
+  ZRegion * region = NULL;
+  for (int i = 0;
+       !region && i < TRACKLIST->num_tracks; i++)
+    {
+      Track * track = TRACKLIST->tracks[i];
+      for (int j = 0;
+           !region && j < track->num_lanes; j++)
+        {
+          TrackLane * lane = track->lanes[j];
+          for (int k = 0; k < lane->num_regions;
+               k++)
+            {
+              if (lane->regions[k] ==
+                    waiting->region)
+                {
+                  region = lane->regions[k];
+                  break;
+                }
+            }
+        }
+    }
+
+  if (!region ||
+      region->id.type != REGION_TYPE_AUDIO ||
+      region->pool_id != waiting->clip_id)
+    {
+      return NULL;
+    }
+
+  return region;
+}
+
+/**
+ * Removes the region from the list of regions
+ * waiting for a job and returns the entry it was
+ * waiting for, if any.
+ */
+static StretchCacheEntry *
+remove_waiting_region (
+  StretchCache *  self,
+  const ZRegion * region)
+{
+  for (size_t i = 0; i < self->entries->len; i++)
+    {
+      StretchCacheEntry * entry =
+        g_ptr_array_index (self->entries, i);
+      for (size_t j = 0; j < entry->regions->len;
+           j++)
+        {
+          StretchCacheWaitingRegion * waiting =
+            &g_array_index (
+              entry->regions,
+              StretchCacheWaitingRegion, j);
+          if (waiting->region == region)
+            {
+              g_array_remove_index (
+                entry->regions, (guint) j);
+              return entry;
+            }
+        }
+    }
+
+  return NULL;
+}
+
+static StretchCacheEntry *
+find_entry (
+  StretchCache * self,
+  int            base_clip_id,
+  double         ratio)
+{
+  for (size_t i = 0; i < self->entries->len; i++)
+    {
+      StretchCacheEntry * entry =
+        g_ptr_array_index (self->entries, i);
+      if (entry->base_clip_id == base_clip_id &&
+          fabs (entry->ratio - ratio) <
+            STRETCH_CACHE_RATIO_EPSILON)
+        return entry;
+    }
+
+  return NULL;
+}
+
+static StretchCacheEntry *
+find_entry_for_result (
+  StretchCache * self,
+  int            clip_id)
+{
+  for (size_t i = 0; i < self->entries->len; i++)
+    {
+      StretchCacheEntry * entry =
+        g_ptr_array_index (self->entries, i);
+      if (entry->clip_id == clip_id)
+        return entry;
+    }
+
+  return NULL;
+}
+
+/**
+ * Creates the cache and starts the timeout that
+ * applies finished jobs.
+ *
+ * Must be called from the GTK thread.
+ */
+StretchCache *
+stretch_cache_new (void)
+{
+  StretchCache * self = object_new (StretchCache);
+
+  self->entries =
+    g_ptr_array_new_with_free_func (
+      (GDestroyNotify) entry_free);
+
+  GError * err = NULL;
+  self->thread_pool =
+    g_thread_pool_new (
+      (GFunc) stretch_entry, self,
+      STRETCH_CACHE_MAX_THREADS, false, &err);
+  if (!self->thread_pool)
+    {
+      g_critical (
+        "failed to create thread pool: %s",
+        err->message);
+      g_error_free (err);
+    }
+
+  self->source_id =
+    g_timeout_add (
+      40,
+      (GSourceFunc) stretch_cache_process_finished,
+      self);
+
+  return self;
+}
+
+/**
+ * Stretches the audio of the region by the given
+ * ratio.
+ *
+ * If the result is cached, the region is switched
+ * to it immediately, otherwise a job is started
+ * and the region keeps using its current clip
+ * until the job is finished.
+ *
+ * Must be called from the GTK thread.
+ *
+ * @return Whether the region was switched
+ *   immediately.
+ */
+bool
+stretch_cache_stretch_region (
+  StretchCache * self,
+  ZRegion *      region,
+  double         ratio)
+{
+  g_return_val_if_fail (
+    region->id.type == REGION_TYPE_AUDIO, false);
+  AudioClip * clip = audio_region_get_clip (region);
+  g_return_val_if_fail (clip, false);
+
+  /* find the ratio relative to the original
+   * audio, taking into account any stretch the
+   * region is still waiting for */
+  int base_clip_id = clip->pool_id;
+  double total_ratio = ratio;
+  StretchCacheEntry * prev_entry =
+    remove_waiting_region (self, region);
+  if (!prev_entry)
+    {
+      prev_entry =
+        find_entry_for_result (self, clip->pool_id);
+    }
+  if (prev_entry && prev_entry->base_clip_id >= 0)
+    {
+      base_clip_id = prev_entry->base_clip_id;
+      total_ratio = prev_entry->ratio * ratio;
+    }
+
+  AudioClip * base_clip =
+    audio_pool_get_clip (AUDIO_POOL, base_clip_id);
+  g_return_val_if_fail (base_clip, false);
+
+  /* back to the original audio */
+  if (fabs (total_ratio - 1.0) <
+        STRETCH_CACHE_RATIO_EPSILON)
+    {
+      bool locked = lock_engine ();
+      switch_region_to_clip (region, base_clip);
+      unlock_engine (locked);
+      return true;
+    }
+
+  StretchCacheEntry * entry =
+    find_entry (self, base_clip_id, total_ratio);
+  if (entry &&
+      g_atomic_int_get (&entry->state) ==
+        STRETCH_CACHE_ENTRY_READY)
+    {
+      g_message (
+        "using cached stretch of clip '%s' by %f",
+        base_clip->name, total_ratio);
+      AudioClip * cached_clip =
+        audio_pool_get_clip (
+          AUDIO_POOL, entry->clip_id);
+      bool locked = lock_engine ();
+      switch_region_to_clip (region, cached_clip);
+      unlock_engine (locked);
+      return true;
+    }
+
+  if (!entry ||
+      g_atomic_int_get (&entry->state) ==
+        STRETCH_CACHE_ENTRY_FAILED)
+    {
+      if (entry)
+        g_ptr_array_remove (self->entries, entry);
+
+      g_message (
+        "stretching clip '%s' by %f in the "
+        "background",
+        base_clip->name, total_ratio);
+      entry = entry_new (base_clip, total_ratio);
+      g_ptr_array_add (self->entries, entry);
+      g_thread_pool_push (
+        self->thread_pool, entry, NULL);
+    }
+
+  StretchCacheWaitingRegion waiting = {
+    .region = region,
+    .clip_id = region->pool_id,
+  };
+  g_array_append_val (entry->regions, waiting);
+
+  return false;
+}
+
+/**
+ * Adds the clips of finished jobs to the pool and
+ * switches the waiting regions to them.
+ *
+ * Called periodically from the GTK thread. If the
+ * engine is running, this is done between
+ * cycles.
+ *
+ * @return G_SOURCE_CONTINUE.
+ */
+int
+stretch_cache_process_finished (
+  StretchCache * self)
+{
+  for (size_t i = 0; i < self->entries->len; i++)
+    {
+      StretchCacheEntry * entry =
+        g_ptr_array_index (self->entries, i);
+      if (g_atomic_int_get (&entry->state) !=
+            STRETCH_CACHE_ENTRY_STRETCHED)
+        continue;
+
+      AudioClip * clip =
+        audio_clip_new_from_float_array (
+          entry->frames, entry->num_frames,
+          entry->channels, entry->bit_depth,
+          entry->name);
+      object_zero_and_free (entry->frames);
+
+      /* adding to the pool may reallocate the
+       * clips the engine is reading, so the pool
+       * and the regions are only changed between
+       * cycles */
+      bool locked = lock_engine ();
+      audio_pool_add_clip (AUDIO_POOL, clip);
+      for (size_t j = 0; j < entry->regions->len;
+           j++)
+        {
+          ZRegion * region =
+            find_waiting_region (
+              &g_array_index (
+                entry->regions,
+                StretchCacheWaitingRegion, j));
+          if (region)
+            switch_region_to_clip (region, clip);
+        }
+      unlock_engine (locked);
+
+      audio_clip_write_to_pool (
+        clip, F_NO_PARTS, F_NOT_BACKUP);
+      entry->clip_id = clip->pool_id;
+      g_atomic_int_set (
+        &entry->state, STRETCH_CACHE_ENTRY_READY);
+      g_array_set_size (entry->regions, 0);
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+/**
+ * Waits for all jobs to finish and applies them.
+ *
+ * Used in tests.
+ */
+void
+stretch_cache_wait (
+  StretchCache * self)
+{
+  bool pending = true;
+  while (pending)
+    {
+      pending = false;
+      for (size_t i = 0; i < self->entries->len;
+           i++)
+        {
+          StretchCacheEntry * entry =
+            g_ptr_array_index (self->entries, i);
+          if (g_atomic_int_get (&entry->state) ==
+                STRETCH_CACHE_ENTRY_PENDING)
+            {
+              pending = true;
+              break;
+            }
+        }
+      if (pending)
+        g_usleep (1000);
+    }
+
+  stretch_cache_process_finished (self);
+}
+
+/**
+ * Forgets any entries that refer to the given
+ * pool clip.
+ *
+ * To be called when the clip is removed from the
+ * pool.
+ */
+void
+stretch_cache_remove_clip (
+  StretchCache * self,
+  int            clip_id)
+{
+  for (size_t i = self->entries->len; i > 0; i--)
+    {
+      StretchCacheEntry * entry =
+        g_ptr_array_index (self->entries, i - 1);
+      if (entry->base_clip_id != clip_id &&
+          entry->clip_id != clip_id)
+        continue;
+
+      /* jobs in progress can't be freed, but must
+       * not match the ID anymore since it may be
+       * reused */
+      if (g_atomic_int_get (&entry->state) ==
+            STRETCH_CACHE_ENTRY_PENDING)
+        {
+          entry->base_clip_id = -1;
+        }
+      else
+        {
+          g_ptr_array_remove_index (
+            self->entries, (guint) (i - 1));
+        }
+    }
+}
+
+/**
+ * Forgets the given region if it is waiting for
+ * a job.
+ *
+ * To be called when the region is freed.
+ */
+void
+stretch_cache_remove_region (
+  StretchCache *  self,
+  const ZRegion * region)
+{
+  remove_waiting_region (self, region);
+}
+
+void
+stretch_cache_free (
+  StretchCache * self)
+{
+  g_source_remove_and_zero (self->source_id);
+
+  /* drop queued jobs and wait for running ones */
+  if (self->thread_pool)
+    {
+      g_thread_pool_free (
+        self->thread_pool, true, true);
+      self->thread_pool = NULL;
+    }
+
+  object_free_w_func_and_null (
+    g_ptr_array_unref, self->entries);
+
+  object_zero_and_free (self);
+}
@@ -315,10 +315,14 @@ stretcher_stretch_interleaved (
 
   g_message ("input samples: %zu", in_samples_size);
 
-  /* create the de-interleaved array */
+  /* create the de-interleaved array (on the heap
+   * since clips can be long and this may run on
+   * a worker thread with a small stack) */
   unsigned int channels = self->channels;
-  float in_buffers_l[in_samples_size];
-  float in_buffers_r[in_samples_size];
+  float * in_buffers_l =
+    object_new_n (MAX (in_samples_size, 1), float);
+  float * in_buffers_r =
+    object_new_n (MAX (in_samples_size, 1), float);
   for (size_t i = 0; i < in_samples_size; i++)
     {
       in_buffers_l[i] = in_samples[i * channels];
@@ -452,7 +456,10 @@ stretcher_stretch_interleaved (
             i * (size_t) channels + ch] =
               out_samples[ch][i];
         }
+      free (out_samples[ch]);
     }
+  free (in_buffers_l);
+  free (in_buffers_r);
 
   return (ssize_t) total_out_frames;
 }
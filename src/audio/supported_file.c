@@ -129,9 +129,8 @@ supported_file_clone (
 {
   SupportedFile * dest = object_new (SupportedFile);
 
-  dest->type = src->type;
+  *dest = *src;
   dest->abs_path = g_strdup (src->abs_path);
-  dest->hidden = src->hidden;
   dest->label = g_strdup (src->label);
 
   return dest;
@@ -271,17 +270,23 @@ supported_file_should_autoplay (
 
   if (supported_file_type_is_audio (self->type))
     {
-      AudioEncoder * enc =
-        audio_encoder_new_from_file (
-          self->abs_path);
-      if (!enc)
-        return false;
+      long length = self->length;
+      if (!self->has_metadata)
+        {
+          AudioEncoder * enc =
+            audio_encoder_new_from_file (
+              self->abs_path);
+          if (!enc)
+            return false;
+
+          length = (long) enc->nfo.length;
+          audio_encoder_free (enc);
+        }
 
-      if ((enc->nfo.length / 1000) > 60)
+      if ((length / 1000) > 60)
         {
           autoplay = false;
         }
-      audio_encoder_free (enc);
     }
 
   return autoplay;
@@ -301,14 +306,28 @@ supported_file_get_info_text_for_label (
   if (supported_file_type_is_audio (
         self->type))
     {
-      AudioEncoder * enc =
-        audio_encoder_new_from_file (
-          self->abs_path);
-      if (!enc)
+      /* use the indexed metadata if available */
+      SupportedFile nfo = *self;
+      if (!self->has_metadata)
         {
-          g_free (file_type_label);
-          return
-            g_strdup (_("Failed opening file"));
+          AudioEncoder * enc =
+            audio_encoder_new_from_file (
+              self->abs_path);
+          if (!enc)
+            {
+              g_free (file_type_label);
+              return
+                g_strdup (_("Failed opening file"));
+            }
+
+          nfo.sample_rate =
+            (int) enc->nfo.sample_rate;
+          nfo.length = (long) enc->nfo.length;
+          nfo.bpm = enc->nfo.bpm;
+          nfo.channels = (int) enc->nfo.channels;
+          nfo.bit_rate = (int) enc->nfo.bit_rate;
+          nfo.bit_depth = (int) enc->nfo.bit_depth;
+          audio_encoder_free (enc);
         }
 
       label =
@@ -319,15 +338,14 @@ supported_file_get_info_text_for_label (
           "Channel(s): %d | Bitrate: %'d.%d kb/s\n"
           "Bit depth: %d bits"),
           self->label,
-          enc->nfo.sample_rate,
-          enc->nfo.length / 1000,
-          enc->nfo.length % 1000,
-          (double) enc->nfo.bpm,
-          enc->nfo.channels,
-          enc->nfo.bit_rate / 1000,
-          (enc->nfo.bit_rate % 1000) / 100,
-          enc->nfo.bit_depth);
-      audio_encoder_free (enc);
+          nfo.sample_rate,
+          nfo.length / 1000,
+          nfo.length % 1000,
+          (double) nfo.bpm,
+          nfo.channels,
+          nfo.bit_rate / 1000,
+          (nfo.bit_rate % 1000) / 100,
+          nfo.bit_depth);
     }
   else
     label =
@@ -0,0 +1,539 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include "audio/position.h"
+#include "audio/tempo_map.h"
+#include "utils/arrays.h"
+#include "utils/math.h"
+#include "utils/objects.h"
+
+#include <glib.h>
+
+/**
+ * Creates a map without segments for the given
+ * time signature.
+ *
+ * @param ticks_per_beat Ticks per beat, as in
+ *   \ref Transport.ticks_per_beat.
+ * @param bpm BPM where there is no automation.
+ */
+TempoMap *
+tempo_map_new (
+  int           beats_per_bar,
+  int           ticks_per_beat,
+  sample_rate_t sample_rate,
+  bpm_t         bpm)
+{
+  g_return_val_if_fail (
+    beats_per_bar > 0 && ticks_per_beat > 0 &&
+    sample_rate > 0 && bpm > 0,
+    NULL);
+
+  TempoMap * self = object_new (TempoMap);
+
+  self->bpm = bpm;
+  self->sample_rate = sample_rate;
+  self->beats_per_bar = beats_per_bar;
+  self->sixteenths_per_beat =
+    ticks_per_beat / TICKS_PER_SIXTEENTH_NOTE;
+  self->ticks_per_beat = (double) ticks_per_beat;
+  self->ticks_per_bar =
+    (double) (ticks_per_beat * beats_per_bar);
+  self->beats_per_tick = 1.0 / self->ticks_per_beat;
+  self->bars_per_tick = 1.0 / self->ticks_per_bar;
+  self->sixteenths_per_tick =
+    1.0 / TICKS_PER_SIXTEENTH_NOTE_DBL;
+
+  return self;
+}
+
+/**
+ * Returns the frames per tick for the given BPM,
+ * same as \ref AudioEngine.frames_per_tick.
+ */
+double
+tempo_map_get_frames_per_tick (
+  const TempoMap * self,
+  bpm_t            bpm)
+{
+  return
+    ((double) self->sample_rate * 60.0 *
+       (double) self->beats_per_bar) /
+    ((double) bpm * self->ticks_per_bar);
+}
+
+/**
+ * Appends a segment starting at the given
+ * position.
+ *
+ * Segments must be added in order, starting
+ * at 0. A segment with the same BPM as the
+ * previous one is not added.
+ */
+void
+tempo_map_add_segment (
+  TempoMap * self,
+  double     start_ticks,
+  bpm_t      bpm)
+{
+  g_return_if_fail (bpm > 0);
+
+  double frames_per_tick =
+    tempo_map_get_frames_per_tick (self, bpm);
+  double start_frames = 0.0;
+  if (self->num_segments == 0)
+    {
+      g_return_if_fail (
+        math_doubles_equal (start_ticks, 0.0));
+    }
+  else
+    {
+      TempoMapSegment * prev =
+        &self->segments[self->num_segments - 1];
+      g_return_if_fail (
+        start_ticks > prev->start_ticks);
+      if (math_floats_equal (prev->bpm, bpm))
+        return;
+
+      start_frames =
+        prev->start_frames +
+        (start_ticks - prev->start_ticks) *
+          prev->frames_per_tick;
+    }
+
+  array_double_size_if_full (
+    self->segments, self->num_segments,
+    self->segments_size, TempoMapSegment);
+  TempoMapSegment * seg =
+    &self->segments[self->num_segments++];
+  seg->start_ticks = start_ticks;
+  seg->start_frames = start_frames;
+  seg->bpm = bpm;
+  seg->frames_per_tick = frames_per_tick;
+  seg->ticks_per_frame = 1.0 / frames_per_tick;
+}
+
+/**
+ * Returns the index of the segment containing
+ * the given ticks.
+ */
+int
+tempo_map_get_segment_at_ticks (
+  const TempoMap * self,
+  double           ticks)
+{
+  int lo = 0;
+  int hi = self->num_segments - 1;
+  while (lo < hi)
+    {
+      int mid = lo + (hi - lo + 1) / 2;
+      if (self->segments[mid].start_ticks <= ticks)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+
+  return lo;
+}
+
+/**
+ * Returns the index of the segment containing
+ * the given frames.
+ */
+int
+tempo_map_get_segment_at_frames (
+  const TempoMap * self,
+  long             frames)
+{
+  double dframes = (double) frames;
+  int lo = 0;
+  int hi = self->num_segments - 1;
+  while (lo < hi)
+    {
+      int mid = lo + (hi - lo + 1) / 2;
+      if (self->segments[mid].start_frames <=
+            dframes)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+
+  return lo;
+}
+
+/**
+ * Returns the segment for the given frames,
+ * checking the given segment and the one after
+ * it before searching.
+ */
+static inline int
+find_segment_at_frames (
+  const TempoMap * self,
+  int              hint,
+  long             frames)
+{
+  double dframes = (double) frames;
+  for (int i = hint;
+       i < hint + 2 && i < self->num_segments;
+       i++)
+    {
+      if ((i == 0 ||
+           self->segments[i].start_frames <=
+             dframes) &&
+          (i == self->num_segments - 1 ||
+           dframes <
+             self->segments[i + 1].start_frames))
+        {
+          return i;
+        }
+    }
+
+  return
+    tempo_map_get_segment_at_frames (
+      self, frames);
+}
+
+/**
+ * Same as find_segment_at_frames() for ticks.
+ */
+static inline int
+find_segment_at_ticks (
+  const TempoMap * self,
+  int              hint,
+  double           ticks)
+{
+  for (int i = hint;
+       i < hint + 2 && i < self->num_segments;
+       i++)
+    {
+      if ((i == 0 ||
+           self->segments[i].start_ticks <=
+             ticks) &&
+          (i == self->num_segments - 1 ||
+           ticks <
+             self->segments[i + 1].start_ticks))
+        {
+          return i;
+        }
+    }
+
+  return
+    tempo_map_get_segment_at_ticks (
+      self, ticks);
+}
+
+/**
+ * Returns the BPM at the given ticks.
+ */
+bpm_t
+tempo_map_get_bpm_at_ticks (
+  const TempoMap * self,
+  double           ticks)
+{
+  if (self->num_segments == 0)
+    return self->bpm;
+
+  int idx =
+    tempo_map_get_segment_at_ticks (self, ticks);
+  return self->segments[idx].bpm;
+}
+
+/**
+ * Returns the BPM at the given frames.
+ */
+bpm_t
+tempo_map_get_bpm_at_frames (
+  const TempoMap * self,
+  long             frames)
+{
+  if (self->num_segments == 0)
+    return self->bpm;
+
+  int idx =
+    tempo_map_get_segment_at_frames (
+      self, frames);
+  return self->segments[idx].bpm;
+}
+
+static inline double
+segment_frames_to_ticks (
+  const TempoMapSegment * seg,
+  long                    frames)
+{
+  return
+    seg->start_ticks +
+    ((double) frames - seg->start_frames) *
+      seg->ticks_per_frame;
+}
+
+static inline long
+segment_ticks_to_frames (
+  const TempoMapSegment * seg,
+  double                  ticks)
+{
+  return
+    math_round_double_to_long (
+      seg->start_frames +
+      (ticks - seg->start_ticks) *
+        seg->frames_per_tick);
+}
+
+/**
+ * Converts frames to ticks.
+ */
+double
+tempo_map_frames_to_ticks (
+  const TempoMap * self,
+  long             frames)
+{
+  g_return_val_if_fail (
+    self->num_segments > 0, 0.0);
+
+  int idx =
+    find_segment_at_frames (self, 0, frames);
+  return
+    segment_frames_to_ticks (
+      &self->segments[idx], frames);
+}
+
+/**
+ * Converts ticks to frames, rounding to the
+ * nearest frame.
+ */
+long
+tempo_map_ticks_to_frames (
+  const TempoMap * self,
+  double           ticks)
+{
+  g_return_val_if_fail (
+    self->num_segments > 0, 0);
+
+  int idx =
+    find_segment_at_ticks (self, 0, ticks);
+  return
+    segment_ticks_to_frames (
+      &self->segments[idx], ticks);
+}
+
+/**
+ * Converts an array of frames to ticks.
+ *
+ * Sorted input (such as the positions in a
+ * cycle) only looks up the segment once.
+ */
+void
+tempo_map_frames_to_ticks_array (
+  const TempoMap * self,
+  const long *     frames,
+  double *         ticks,
+  size_t           num_positions)
+{
+  g_return_if_fail (self->num_segments > 0);
+
+  int idx = 0;
+  for (size_t i = 0; i < num_positions; i++)
+    {
+      idx =
+        find_segment_at_frames (
+          self, idx, frames[i]);
+      ticks[i] =
+        segment_frames_to_ticks (
+          &self->segments[idx], frames[i]);
+    }
+}
+
+/**
+ * Converts an array of ticks to frames.
+ *
+ * @see tempo_map_frames_to_ticks_array().
+ */
+void
+tempo_map_ticks_to_frames_array (
+  const TempoMap * self,
+  const double *   ticks,
+  long *           frames,
+  size_t           num_positions)
+{
+  g_return_if_fail (self->num_segments > 0);
+
+  int idx = 0;
+  for (size_t i = 0; i < num_positions; i++)
+    {
+      idx =
+        find_segment_at_ticks (
+          self, idx, ticks[i]);
+      frames[i] =
+        segment_ticks_to_frames (
+          &self->segments[idx], ticks[i]);
+    }
+}
+
+/**
+ * Returns ticks / divisor rounded towards 0.
+ *
+ * The quotient from the reciprocal can be off by
+ * one near multiples of the divisor, so it is
+ * corrected with (exact) integer products.
+ */
+static inline double
+trunc_div (
+  double ticks,
+  double divisor,
+  double reciprocal)
+{
+  double q = trunc (ticks * reciprocal);
+  if (ticks >= 0.0)
+    {
+      if ((q + 1.0) * divisor <= ticks)
+        q += 1.0;
+      else if (q * divisor > ticks)
+        q -= 1.0;
+    }
+  else
+    {
+      if ((q - 1.0) * divisor >= ticks)
+        q -= 1.0;
+      else if (q * divisor < ticks)
+        q += 1.0;
+    }
+
+  return q;
+}
+
+/**
+ * Splits the given ticks into bars, beats,
+ * sixteenths and ticks.
+ *
+ * @param start_at_one Start the bars, beats and
+ *   sixteenths at 1 or -1 instead of 0.
+ */
+void
+tempo_map_get_musical_time (
+  const TempoMap * self,
+  double           ticks,
+  bool             start_at_one,
+  MusicalTime *    time)
+{
+  double total_bars =
+    trunc_div (
+      ticks, self->ticks_per_bar,
+      self->bars_per_tick);
+  double total_beats =
+    trunc_div (
+      ticks, self->ticks_per_beat,
+      self->beats_per_tick);
+  double total_sixteenths =
+    trunc_div (
+      ticks, TICKS_PER_SIXTEENTH_NOTE_DBL,
+      self->sixteenths_per_tick);
+
+  time->bars = (int) total_bars;
+  time->beats =
+    (int) total_beats -
+    time->bars * self->beats_per_bar;
+  time->sixteenths =
+    (int) total_sixteenths -
+    (int) total_beats * self->sixteenths_per_beat;
+  time->ticks =
+    ticks -
+    total_sixteenths * TICKS_PER_SIXTEENTH_NOTE_DBL;
+  time->beat_ticks =
+    ticks - total_beats * self->ticks_per_beat;
+  time->bar_ticks =
+    ticks - total_bars * self->ticks_per_bar;
+
+  if (start_at_one)
+    {
+      /* negative positions count from -1, except
+       * at the exact start of the bar/beat */
+      time->bars += ticks >= 0.0 ? 1 : -1;
+      time->beats +=
+        (ticks >= 0.0 || time->bar_ticks == 0.0) ?
+          1 : -1;
+      time->sixteenths +=
+        (ticks >= 0.0 || time->beat_ticks == 0.0) ?
+          1 : -1;
+    }
+}
+
+/**
+ * Splits an array of ticks into bars, beats,
+ * sixteenths and ticks.
+ *
+ * @see tempo_map_get_musical_time().
+ */
+void
+tempo_map_get_musical_time_array (
+  const TempoMap * self,
+  const double *   ticks,
+  MusicalTime *    times,
+  size_t           num_positions,
+  bool             start_at_one)
+{
+  for (size_t i = 0; i < num_positions; i++)
+    {
+      tempo_map_get_musical_time (
+        self, ticks[i], start_at_one, &times[i]);
+    }
+}
+
+/**
+ * Returns whether the maps have the same time
+ * signature and (almost) the same tempo
+ * segments.
+ */
+bool
+tempo_map_is_equal (
+  const TempoMap * a,
+  const TempoMap * b)
+{
+  if (a->sample_rate != b->sample_rate ||
+      a->beats_per_bar != b->beats_per_bar ||
+      !math_doubles_equal (
+        a->ticks_per_beat, b->ticks_per_beat) ||
+      a->automated != b->automated ||
+      !math_floats_equal (a->bpm, b->bpm) ||
+      a->num_segments != b->num_segments)
+    return false;
+
+  for (int i = 0; i < a->num_segments; i++)
+    {
+      const TempoMapSegment * sa =
+        &a->segments[i];
+      const TempoMapSegment * sb =
+        &b->segments[i];
+      if (!math_doubles_equal (
+             sa->start_ticks, sb->start_ticks) ||
+          !math_floats_equal (sa->bpm, sb->bpm))
+        return false;
+    }
+
+  return true;
+}
+
+void
+tempo_map_free (
+  TempoMap * self)
+{
+  object_zero_and_free (self->segments);
+
+  object_zero_and_free (self);
+}
@@ -17,11 +17,18 @@
  * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <float.h>
+#include <math.h>
 #include <stdlib.h>
 
+#include "audio/automation_point.h"
+#include "audio/automation_region.h"
 #include "audio/automation_track.h"
+#include "audio/control_port.h"
+#include "audio/engine.h"
 #include "audio/port.h"
 #include "audio/router.h"
+#include "audio/tempo_map.h"
 #include "audio/tempo_track.h"
 #include "audio/track.h"
 #include "gui/backend/event.h"
@@ -129,18 +136,299 @@ tempo_track_default (
 
 /**
  * Returns the BPM at the given pos.
+ *
+ * This is a lookup in the engine's tempo map, so
+ * it is cheap to call during processing.
  */
 bpm_t
 tempo_track_get_bpm_at_pos (
   Track *    self,
   Position * pos)
 {
-  AutomationTrack * at =
-    automation_track_find_from_port_id (
-      &self->bpm_port->id, false);
+  const TempoMap * map = AUDIO_ENGINE->tempo_map;
+
+  /* without automation the BPM port has the
+   * current BPM, including temporary changes */
+  if (!map || !map->automated)
+    {
+      return tempo_track_get_current_bpm (self);
+    }
+
+  return
+    tempo_map_get_bpm_at_ticks (map, pos->ticks);
+}
+
+/**
+ * Returns the region that
+ * automation_track_get_region_before_pos() would
+ * return for the given ticks.
+ */
+static ZRegion *
+get_region_before_ticks (
+  AutomationTrack * at,
+  double            ticks)
+{
+  ZRegion * latest_r = NULL;
+  double latest_distance = -DBL_MAX;
+  for (int i = at->num_regions - 1; i >= 0; i--)
+    {
+      ZRegion * r = at->regions[i];
+      ArrangerObject * r_obj =
+        (ArrangerObject *) r;
+      double distance_from_r_end =
+        r_obj->end_pos.ticks - ticks;
+      if (r_obj->pos.ticks <= ticks &&
+          distance_from_r_end > latest_distance)
+        {
+          latest_distance = distance_from_r_end;
+          latest_r = r;
+        }
+    }
+
+  return latest_r;
+}
+
+/**
+ * Returns the automated BPM at the given ticks,
+ * same as automation_track_get_val_at_pos() but
+ * without using frames, which depend on the map
+ * being built.
+ *
+ * @param bpm BPM to return where there is no
+ *   automation.
+ */
+static bpm_t
+get_automated_bpm_at_ticks (
+  Track *           self,
+  AutomationTrack * at,
+  double            ticks,
+  bpm_t             bpm)
+{
+  ZRegion * r =
+    get_region_before_ticks (at, ticks);
+  ArrangerObject * r_obj = (ArrangerObject *) r;
+  if (!r || arranger_object_get_muted (r_obj))
+    return bpm;
+
+  double loop_len =
+    arranger_object_get_loop_length_in_ticks (
+      r_obj);
+  g_return_val_if_fail (loop_len > 0, bpm);
+
+  /* if the region ends before the position, use
+   * the value just before the region's end */
+  bool at_end = ticks >= r_obj->end_pos.ticks;
+  if (at_end)
+    ticks = r_obj->end_pos.ticks;
+
+  double local =
+    (ticks - r_obj->pos.ticks) +
+    r_obj->clip_start_pos.ticks;
+  double loop_end = r_obj->loop_end_pos.ticks;
+  while (at_end ? local > loop_end :
+                  local >= loop_end)
+    {
+      local -= loop_len;
+    }
+
+  AutomationPoint * ap = NULL;
+  for (int i = r->num_aps - 1; i >= 0; i--)
+    {
+      ArrangerObject * ap_obj =
+        (ArrangerObject *) r->aps[i];
+      if (at_end ?
+            ap_obj->pos.ticks < local :
+            ap_obj->pos.ticks <= local)
+        {
+          ap = r->aps[i];
+          break;
+        }
+    }
+  if (!ap)
+    return bpm;
+
+  AutomationPoint * next_ap =
+    automation_region_get_next_ap (
+      r, ap, false, false);
+  if (!next_ap)
+    return ap->fvalue;
+
+  ArrangerObject * ap_obj = (ArrangerObject *) ap;
+  ArrangerObject * next_ap_obj =
+    (ArrangerObject *) next_ap;
+  double ap_len =
+    next_ap_obj->pos.ticks - ap_obj->pos.ticks;
+  if (ap_len <= 0)
+    return ap->fvalue;
+
+  double ratio =
+    (local - ap_obj->pos.ticks) / ap_len;
+  float result =
+    (float)
+    automation_point_get_normalized_value_in_curve (
+      ap, ratio);
+  result *=
+    fabsf (
+      ap->normalized_val - next_ap->normalized_val);
+  result +=
+    MIN (ap->normalized_val, next_ap->normalized_val);
+
   return
-    automation_track_get_val_at_pos (
-      at, pos, false, false);
+    control_port_normalized_val_to_real (
+      self->bpm_port, result);
+}
+
+static int
+cmp_ticks (
+  const void * a,
+  const void * b)
+{
+  double da = *(const double *) a;
+  double db = *(const double *) b;
+  return (da > db) - (da < db);
+}
+
+/**
+ * Adds the positions where the automated BPM
+ * may change abruptly in the given region.
+ */
+static void
+add_region_breakpoints (
+  ZRegion * r,
+  GArray *  points)
+{
+  ArrangerObject * r_obj = (ArrangerObject *) r;
+  double start = r_obj->pos.ticks;
+  double end = r_obj->end_pos.ticks;
+  double clip_start = r_obj->clip_start_pos.ticks;
+  double loop_start = r_obj->loop_start_pos.ticks;
+  double loop_end = r_obj->loop_end_pos.ticks;
+  double loop_len =
+    arranger_object_get_loop_length_in_ticks (
+      r_obj);
+  g_return_if_fail (loop_len > 0);
+
+  g_array_append_val (points, start);
+  g_array_append_val (points, end);
+
+  /* loop points */
+  double first_loop_end =
+    start + (loop_end - clip_start);
+  for (double t = first_loop_end; t < end;
+       t += loop_len)
+    {
+      g_array_append_val (points, t);
+    }
+
+  /* automation points in each repetition */
+  for (int i = 0; i < r->num_aps; i++)
+    {
+      ArrangerObject * ap_obj =
+        (ArrangerObject *) r->aps[i];
+      double ap_ticks = ap_obj->pos.ticks;
+      if (ap_ticks >= clip_start &&
+          ap_ticks < loop_end)
+        {
+          double t = start + (ap_ticks - clip_start);
+          if (t < end)
+            g_array_append_val (points, t);
+        }
+      if (ap_ticks < loop_start ||
+          ap_ticks >= loop_end)
+        continue;
+
+      for (double t =
+             first_loop_end +
+               (ap_ticks - loop_start);
+           t < end; t += loop_len)
+        {
+          g_array_append_val (points, t);
+        }
+    }
+}
+
+/**
+ * Fills the tempo map with segments from the BPM
+ * automation, using the map's BPM where there is
+ * no automation.
+ *
+ * Ramps between automation points are split into
+ * constant segments of \ref TEMPO_MAP_RAMP_STEP
+ * ticks.
+ */
+void
+tempo_track_fill_tempo_map (
+  Track *    self,
+  TempoMap * map)
+{
+  AutomationTrack * at = self->bpm_port->at;
+  g_return_if_fail (at);
+
+  if (at->num_regions == 0)
+    {
+      tempo_map_add_segment (map, 0.0, map->bpm);
+      return;
+    }
+
+  map->automated = true;
+
+  GArray * points =
+    g_array_new (false, false, sizeof (double));
+  for (int i = 0; i < at->num_regions; i++)
+    {
+      add_region_breakpoints (
+        at->regions[i], points);
+    }
+  g_array_sort (points, cmp_ticks);
+
+  double last = 0.0;
+  for (guint i = 0; i < points->len; i++)
+    {
+      double next =
+        g_array_index (points, double, i);
+      if (next <= last)
+        continue;
+
+      /* sample the middle of each step, the
+       * curve between 2 points is monotonic so
+       * if the first and last steps are equal
+       * the BPM is constant */
+      int num_steps =
+        (int) ceil (
+          (next - last) / TEMPO_MAP_RAMP_STEP);
+      double step = (next - last) / num_steps;
+      if (num_steps > 1 &&
+          math_floats_equal (
+            get_automated_bpm_at_ticks (
+              self, at, last + step / 2.0,
+              map->bpm),
+            get_automated_bpm_at_ticks (
+              self, at, next - step / 2.0,
+              map->bpm)))
+        {
+          num_steps = 1;
+          step = next - last;
+        }
+      for (int j = 0; j < num_steps; j++)
+        {
+          double t = last + j * step;
+          tempo_map_add_segment (
+            map, t,
+            get_automated_bpm_at_ticks (
+              self, at, t + step / 2.0,
+              map->bpm));
+        }
+      last = next;
+    }
+
+  /* the BPM does not change after the last
+   * region ends */
+  tempo_map_add_segment (
+    map, last,
+    get_automated_bpm_at_ticks (
+      self, at, last, map->bpm));
+
+  g_array_free (points, true);
 }
 
 /**
@@ -176,8 +464,6 @@ tempo_track_get_current_bpm_as_str (
 /**
  * Sets the BPM.
  *
- * @param update_snap_points Whether to update the
- *   snap points.
  * @param stretch_audio_region Whether to stretch
  *   audio regions. This should only be true when
  *   the BPM change is final.
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-config.h"
+
+#include "audio/position.h"
+#include "audio/tempo_map.h"
+#include "audio/tempo_track.h"
+#include "audio/time_info_snapshot.h"
+#include "audio/transport.h"
+#include "plugins/lv2/lv2_urid.h"
+#include "plugins/plugin_manager.h"
+#include "project.h"
+#include "zrythm.h"
+
+/**
+ * Initializes a forge for building the LV2
+ * position objects.
+ *
+ * The forge can be copied afterwards.
+ */
+void
+time_info_snapshot_init_forge (
+  LV2_Atom_Forge * forge)
+{
+  /* URIDs are global so any map will do */
+  LV2_URID_Map map = {
+    .handle = NULL,
+    .map = lv2_urid_map_uri,
+  };
+  lv2_atom_forge_init (forge, &map);
+}
+
+static void
+build_lv2_position (
+  TimeInfoSnapshot * self,
+  LV2_Atom_Forge *   forge)
+{
+  lv2_atom_forge_set_buffer (
+    forge, self->lv2_pos.buf,
+    sizeof (self->lv2_pos.buf));
+  LV2_Atom_Forge_Frame frame;
+  lv2_atom_forge_object (
+    forge, &frame, 0, PM_URIDS.time_Position);
+  lv2_atom_forge_key (
+    forge, PM_URIDS.time_frame);
+  lv2_atom_forge_long (
+    forge, self->g_start_frames);
+  lv2_atom_forge_key (
+    forge, PM_URIDS.time_speed);
+  lv2_atom_forge_float (
+    forge, self->rolling ? 1.f : 0.f);
+  lv2_atom_forge_key (
+    forge, PM_URIDS.time_barBeat);
+  lv2_atom_forge_float (
+    forge,
+    (float)
+    ((self->beat - 1) +
+       self->beat_ticks /
+         (double) self->ticks_per_beat));
+  lv2_atom_forge_key (
+    forge, PM_URIDS.time_bar);
+  lv2_atom_forge_long (forge, self->bar - 1);
+  lv2_atom_forge_key (
+    forge, PM_URIDS.time_beatUnit);
+  lv2_atom_forge_int (forge, self->beat_unit);
+  lv2_atom_forge_key (
+    forge, PM_URIDS.time_beatsPerBar);
+  lv2_atom_forge_float (
+    forge, (float) self->beats_per_bar);
+  lv2_atom_forge_key (
+    forge, PM_URIDS.time_beatsPerMinute);
+  lv2_atom_forge_float (forge, self->bpm);
+  lv2_atom_forge_pop (forge, &frame);
+}
+
+/**
+ * Fills in the snapshot for the given position
+ * from the current transport and tempo.
+ *
+ * This is realtime-safe.
+ *
+ * @param forge A forge initialized with
+ *   time_info_snapshot_init_forge(). Its buffer
+ *   is changed.
+ */
+void
+time_info_snapshot_fill (
+  TimeInfoSnapshot * self,
+  LV2_Atom_Forge *   forge,
+  long               g_start_frames)
+{
+  self->g_start_frames = g_start_frames;
+  self->rolling = TRANSPORT_IS_ROLLING;
+  self->beats_per_bar =
+    tempo_track_get_beats_per_bar (P_TEMPO_TRACK);
+  self->beat_unit =
+    tempo_track_get_beat_unit (P_TEMPO_TRACK);
+  self->ticks_per_beat = TRANSPORT->ticks_per_beat;
+
+  Position pos;
+  position_from_frames (&pos, g_start_frames);
+  self->bpm =
+    tempo_track_get_bpm_at_pos (
+      P_TEMPO_TRACK, &pos);
+  MusicalTime time;
+  position_get_musical_time (&pos, true, &time);
+  self->bar = time.bars;
+  self->beat = time.beats;
+  self->beat_ticks = time.beat_ticks;
+  self->bar_ticks = time.bar_ticks;
+
+  build_lv2_position (self, forge);
+}
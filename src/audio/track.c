@@ -46,6 +46,7 @@
 #include "audio/stretcher.h"
 #include "audio/tempo_track.h"
 #include "audio/track.h"
+#include "gui/backend/arranger_object_index.h"
 #include "gui/backend/event.h"
 #include "gui/backend/event_manager.h"
 #include "gui/widgets/arranger.h"
@@ -1703,6 +1704,89 @@ track_get_last_region (
   return last_region;
 }
 
+static int
+ticks_cmp (
+  const void * _a,
+  const void * _b)
+{
+  const double a = *(const double *) _a;
+  const double b = *(const double *) _b;
+  if (a < b)
+    return -1;
+  else if (a > b)
+    return 1;
+  return 0;
+}
+
+/**
+ * Returns the start and end positions of the
+ * regions in the track lanes in ticks, sorted.
+ *
+ * The result is cached and only recalculated when
+ * arranger objects change, so repeated lookups
+ * (eg, when snapping during a drag) only need a
+ * binary search.
+ *
+ * @param[out] num_ticks Number of positions
+ *   returned.
+ */
+const double *
+track_get_snap_event_ticks (
+  Track * self,
+  int *   num_ticks)
+{
+  unsigned int generation =
+    arranger_object_index_get_generation ();
+  if (self->snap_events_generation == generation)
+    {
+      *num_ticks = self->num_snap_event_ticks;
+      return self->snap_event_ticks;
+    }
+
+  size_t num_points = 0;
+  for (int i = 0; i < self->num_lanes; i++)
+    {
+      num_points +=
+        2 * (size_t) self->lanes[i]->num_regions;
+    }
+  if (num_points > self->snap_event_ticks_size)
+    {
+      self->snap_event_ticks =
+        g_realloc_n (
+          self->snap_event_ticks, num_points,
+          sizeof (double));
+      self->snap_event_ticks_size = num_points;
+    }
+
+  self->num_snap_event_ticks = 0;
+  for (int i = 0; i < self->num_lanes; i++)
+    {
+      TrackLane * lane = self->lanes[i];
+      for (int j = 0; j < lane->num_regions; j++)
+        {
+          ArrangerObject * r_obj =
+            (ArrangerObject *) lane->regions[j];
+          self->snap_event_ticks[
+            self->num_snap_event_ticks++] =
+              r_obj->pos.ticks;
+          self->snap_event_ticks[
+            self->num_snap_event_ticks++] =
+              r_obj->end_pos.ticks;
+        }
+    }
+  if (self->num_snap_event_ticks > 0)
+    {
+      qsort (
+        self->snap_event_ticks,
+        (size_t) self->num_snap_event_ticks,
+        sizeof (double), ticks_cmp);
+    }
+  self->snap_events_generation = generation;
+
+  *num_ticks = self->num_snap_event_ticks;
+  return self->snap_event_ticks;
+}
+
 /**
  * Generates automatables for the track.
  *
@@ -1756,37 +1840,9 @@ track_generate_automation_tracks (
         }
     }
 
-  if (track_type_has_piano_roll (track->type))
-    {
-      /* midi automatables */
-      for (int i = 0; i < 16; i++)
-        {
-          Port * cc = NULL;
-          for (int j = 0; j < 128; j++)
-            {
-              cc =
-                track->processor->midi_cc[
-                  i * 128 + j];
-              at = automation_track_new (cc);
-              automation_tracklist_add_at (atl, at);
-            }
-
-          cc =
-            track->processor->pitch_bend[i];
-          at = automation_track_new (cc);
-          automation_tracklist_add_at (atl, at);
-
-          cc =
-            track->processor->poly_key_pressure[i];
-          at = automation_track_new (cc);
-          automation_tracklist_add_at (atl, at);
-
-          cc =
-            track->processor->channel_pressure[i];
-          at = automation_track_new (cc);
-          automation_tracklist_add_at (atl, at);
-        }
-    }
+  /* MIDI automatables are added when their ports
+   * are created (see
+   * track_processor_ensure_midi_automatable()) */
 
   switch (track->type)
     {
@@ -2816,7 +2872,11 @@ track_update_positions (
  *
  * @param stereo_ports StereoPorts to fill.
  * @param midi_events MidiEvents to fill (from
- *   Piano Roll Port for example).
+ *   Piano Roll Port for example). The events are
+ *   inserted directly into the main events, sorted
+ *   by time, so this must only be called from the
+ *   engine thread. Duplicates are removed at the
+ *   end.
  */
 void
 track_fill_events (
@@ -2836,11 +2896,6 @@ track_fill_events (
   const long g_end_frames =
     g_start_frames + nframes;
 
-  if (midi_events)
-    {
-      zix_sem_wait (&midi_events->access_sem);
-    }
-
 #if 0
   g_message (
     "%s: TRACK %s STARTING from %ld, "
@@ -2985,21 +3040,16 @@ track_fill_events (
         }
     }
 
-#if 0
-  g_message ("TRACK %s ENDING", self->name);
-#endif
-
   if (midi_events)
     {
       midi_events_clear_duplicates (
-        midi_events, F_QUEUED);
-
-      /* sort events */
-      midi_events_sort (midi_events, F_QUEUED);
-
-      zix_sem_post (&midi_events->access_sem);
+        midi_events, F_NOT_QUEUED);
     }
 
+#if 0
+  g_message ("TRACK %s ENDING", self->name);
+#endif
+
 #undef g_start_frames
 #undef local_offset
 #undef nframes
@@ -3897,6 +3947,9 @@ track_free (Track * self)
   g_debug ("freeing track '%s' (pos %d)...",
     self->name, self->pos);
 
+  /* chord regions are indexed by track */
+  arranger_object_index_container_freed (self);
+
   if (self->widget &&
       GTK_IS_WIDGET (self->widget))
     gtk_widget_destroy (
@@ -3958,6 +4011,7 @@ track_free (Track * self)
   g_free_and_null (self->name);
   g_free_and_null (self->comment);
   g_free_and_null (self->icon_name);
+  g_free_and_null (self->snap_event_ticks);
 
   for (int i = 0; i < self->num_modulator_macros;
        i++)
@@ -23,6 +23,7 @@
 #include "audio/track.h"
 #include "audio/track_lane.h"
 #include "audio/tracklist.h"
+#include "gui/backend/arranger_object_index.h"
 #include "gui/backend/event.h"
 #include "gui/backend/event_manager.h"
 #include "gui/widgets/arranger.h"
@@ -217,6 +218,9 @@ track_lane_insert_region (
   region->id.idx = idx;
   region_update_identifier (region);
 
+  arranger_object_index_object_added (
+    self, (ArrangerObject *) region);
+
   if (region->id.type == REGION_TYPE_AUDIO)
     {
       AudioClip * clip =
@@ -388,6 +392,9 @@ track_lane_remove_region (
     deleted);
   g_return_if_fail (deleted);
 
+  arranger_object_index_object_removed (
+    (ArrangerObject *) region);
+
   for (int i = region->id.idx; i < self->num_regions;
        i++)
     {
@@ -457,6 +464,8 @@ void
 track_lane_free (
   TrackLane * self)
 {
+  arranger_object_index_container_freed (self);
+
   g_free_and_null (self->name);
 
   for (int i = 0; i < self->num_regions; i++)
@@ -21,6 +21,8 @@
 
 #include "audio/audio_region.h"
 #include "audio/audio_track.h"
+#include "audio/automation_track.h"
+#include "audio/automation_tracklist.h"
 #include "audio/channel.h"
 #include "audio/clip.h"
 #include "audio/control_port.h"
@@ -32,6 +34,8 @@
 #include "audio/midi_track.h"
 #include "audio/recording_manager.h"
 #include "audio/track.h"
+#include "gui/backend/event.h"
+#include "gui/backend/event_manager.h"
 #include "project.h"
 #include "settings/settings.h"
 #include "utils/arrays.h"
@@ -44,42 +48,83 @@
 
 #include <glib/gi18n.h>
 
+/** Whether any MIDI control without a port
+ * received MIDI input while recording. */
+static volatile gint pending_midi_automatables = 0;
+
+/**
+ * Marks all the existing MIDI controls as dirty
+ * so that their values get sent.
+ */
 static void
-init_common (
+mark_all_midi_automatables_dirty (
   TrackProcessor * self)
 {
-  if (self->midi_cc[0])
+  for (int i = 0;
+       i < TRACK_PROCESSOR_NUM_MIDI_AUTOMATABLES;
+       i++)
     {
-      self->cc_mappings = midi_mappings_new ();
-
-      for (size_t i = 0; i < 16; i++)
+      if (track_processor_get_midi_automatable (
+            self, i))
         {
-          for (size_t j = 0; j < 128; j++)
-            {
-              Port * cc_port =
-                self->midi_cc[i * 128 + j];
-              g_return_if_fail (cc_port);
-
-              /* set model bytes for CC:
-               * [0] = ctrl change + channel
-               * [1] = controller
-               * [2] (unused) = control */
-              midi_byte_t buf[3];
-              buf[0] =
-                (midi_byte_t)
-                (MIDI_CH1_CTRL_CHANGE | (midi_byte_t) i);
-              buf[1] = (midi_byte_t) j;
-              buf[2] = 0;
-
-              /* bind */
-              midi_mappings_bind_track (
-                self->cc_mappings, buf,
-                cc_port, F_NO_PUBLISH_EVENTS);
-            }
+          g_atomic_int_or (
+            &self->dirty_midi_automatables[i / 32],
+            1u << (i % 32));
         }
     }
 }
 
+/**
+ * Binds the given MIDI CC port so that MIDI input
+ * on its controller sets it while recording.
+ *
+ * @param idx MIDI automatable index of the port.
+ */
+static void
+bind_cc_mapping (
+  TrackProcessor * self,
+  int              idx,
+  Port *           port)
+{
+  if (idx >= TRACK_PROCESSOR_PITCH_BEND_IDX (0))
+    return;
+
+  if (!self->cc_mappings)
+    self->cc_mappings = midi_mappings_new ();
+
+  /* set model bytes for CC:
+   * [0] = ctrl change + channel
+   * [1] = controller
+   * [2] (unused) = control */
+  midi_byte_t buf[3];
+  buf[0] =
+    (midi_byte_t)
+    (MIDI_CH1_CTRL_CHANGE |
+       (midi_byte_t) (idx / 128));
+  buf[1] = (midi_byte_t) (idx % 128);
+  buf[2] = 0;
+
+  /* bind */
+  midi_mappings_bind_track (
+    self->cc_mappings, buf, port,
+    F_NO_PUBLISH_EVENTS);
+}
+
+static void
+init_common (
+  TrackProcessor * self)
+{
+  for (int i = 0;
+       i < TRACK_PROCESSOR_PITCH_BEND_IDX (0); i++)
+    {
+      Port * cc = self->midi_cc[i];
+      if (cc)
+        bind_cc_mapping (self, i, cc);
+    }
+
+  mark_all_midi_automatables_dirty (self);
+}
+
 /**
  * Inits fader after a project is loaded.
  */
@@ -141,74 +186,72 @@ init_midi_port (
     }
 }
 
-static void
-init_midi_cc_ports (
+/**
+ * Creates the port of the MIDI control at the
+ * given MIDI automatable index.
+ */
+static Port *
+create_midi_automatable (
   TrackProcessor * self,
-  int              loading)
+  int              idx)
 {
-#define INIT_MIDI_PORT(x,idx) \
-  x->id.flags |= PORT_FLAG_MIDI_AUTOMATABLE; \
-  x->id.flags |= PORT_FLAG_AUTOMATABLE; \
-  x->id.port_index = idx; \
-
-  char name[400];
-  for (int i = 0; i < 16; i++)
+  Port ** dest = NULL;
+  PortFlags2 flags2 = 0;
+  int port_index = idx;
+  if (idx < TRACK_PROCESSOR_PITCH_BEND_IDX (0))
     {
-      /* starting from 1 */
-      int channel = i + 1;
-
-      for (int j = 0; j < 128; j++)
-        {
-          sprintf (
-            name, "Ch%d %s", channel,
-            midi_get_cc_name (j));
-          Port * cc =
-            port_new_with_type_and_owner (
-              TYPE_CONTROL, FLOW_INPUT, name,
-              PORT_OWNER_TYPE_TRACK_PROCESSOR,
-              self);
-          INIT_MIDI_PORT (cc, i * 128 + j);
-          self->midi_cc[i * 128 + j] = cc;
-        }
+      dest = &self->midi_cc[idx];
+    }
+  else if (idx <
+             TRACK_PROCESSOR_POLY_KEY_PRESSURE_IDX (0))
+    {
+      port_index =
+        idx - TRACK_PROCESSOR_PITCH_BEND_IDX (0);
+      dest = &self->pitch_bend[port_index];
+      flags2 = PORT_FLAG2_MIDI_PITCH_BEND;
+    }
+  else if (idx <
+             TRACK_PROCESSOR_CHANNEL_PRESSURE_IDX (0))
+    {
+      port_index =
+        idx -
+        TRACK_PROCESSOR_POLY_KEY_PRESSURE_IDX (0);
+      dest = &self->poly_key_pressure[port_index];
+      flags2 = PORT_FLAG2_MIDI_POLY_KEY_PRESSURE;
+    }
+  else
+    {
+      port_index =
+        idx -
+        TRACK_PROCESSOR_CHANNEL_PRESSURE_IDX (0);
+      dest = &self->channel_pressure[port_index];
+      flags2 = PORT_FLAG2_MIDI_CHANNEL_PRESSURE;
+    }
 
-      sprintf (
-        name, "Ch%d Pitch bend", i + 1);
-      Port * cc =
-        port_new_with_type_and_owner (
-          TYPE_CONTROL, FLOW_INPUT, name,
-          PORT_OWNER_TYPE_TRACK_PROCESSOR, self);
-      INIT_MIDI_PORT (cc, i);
-      cc->maxf = 8191.f;
-      cc->minf = -8192.f;
-      cc->deff = 0.f;
-      cc->zerof = 0.f;
-      cc->id.flags2 |= PORT_FLAG2_MIDI_PITCH_BEND;
-      self->pitch_bend[i] = cc;
-
-      sprintf (
-        name, "Ch%d Poly key pressure", i + 1);
-      cc =
-        port_new_with_type_and_owner (
-          TYPE_CONTROL, FLOW_INPUT, name,
-          PORT_OWNER_TYPE_TRACK_PROCESSOR, self);
-      INIT_MIDI_PORT (cc, i);
-      cc->id.flags2 |=
-        PORT_FLAG2_MIDI_POLY_KEY_PRESSURE;
-      self->poly_key_pressure[i] = cc;
-
-      sprintf (
-        name, "Ch%d Channel pressure", i + 1);
-      cc =
-        port_new_with_type_and_owner (
-          TYPE_CONTROL, FLOW_INPUT, name,
-          PORT_OWNER_TYPE_TRACK_PROCESSOR, self);
-      INIT_MIDI_PORT (cc, i);
-      cc->id.flags2 |=
-        PORT_FLAG2_MIDI_CHANNEL_PRESSURE;
-      self->channel_pressure[i] = cc;
+  char * name =
+    track_processor_get_midi_automatable_label (
+      idx);
+  Port * port =
+    port_new_with_type_and_owner (
+      TYPE_CONTROL, FLOW_INPUT, name,
+      PORT_OWNER_TYPE_TRACK_PROCESSOR, self);
+  g_free (name);
+  port->id.flags |= PORT_FLAG_MIDI_AUTOMATABLE;
+  port->id.flags |= PORT_FLAG_AUTOMATABLE;
+  port->id.flags2 |= flags2;
+  port->id.port_index = port_index;
+  if (flags2 & PORT_FLAG2_MIDI_PITCH_BEND)
+    {
+      port->maxf = 8191.f;
+      port->minf = -8192.f;
+      port->deff = 0.f;
+      port->zerof = 0.f;
     }
 
-#undef INIT_MIDI_PORT
+  *dest = port;
+  bind_cc_mapping (self, idx, port);
+
+  return port;
 }
 
 /**
@@ -290,10 +333,6 @@ track_processor_new (
               self);
           self->piano_roll->id.flags =
             PORT_FLAG_PIANO_ROLL;
-          if (tr->type != TRACK_TYPE_CHORD)
-            {
-              init_midi_cc_ports (self, false);
-            }
         }
       break;
     case TYPE_AUDIO:
@@ -361,8 +400,6 @@ track_processor_new (
         F_NO_PUBLISH_EVENTS);
     }
 
-  init_common (self);
-
   return self;
 }
 
@@ -437,6 +474,266 @@ track_processor_append_ports (
     }
 }
 
+/**
+ * Returns the MIDI automatable index of the given
+ * MIDI automatable port.
+ */
+int
+track_processor_get_midi_automatable_idx (
+  const PortIdentifier * id)
+{
+  if (id->flags2 & PORT_FLAG2_MIDI_PITCH_BEND)
+    {
+      return
+        TRACK_PROCESSOR_PITCH_BEND_IDX (
+          id->port_index);
+    }
+  else if (id->flags2 &
+             PORT_FLAG2_MIDI_POLY_KEY_PRESSURE)
+    {
+      return
+        TRACK_PROCESSOR_POLY_KEY_PRESSURE_IDX (
+          id->port_index);
+    }
+  else if (id->flags2 &
+             PORT_FLAG2_MIDI_CHANNEL_PRESSURE)
+    {
+      return
+        TRACK_PROCESSOR_CHANNEL_PRESSURE_IDX (
+          id->port_index);
+    }
+  return id->port_index;
+}
+
+/**
+ * Returns a newly allocated label for the MIDI
+ * automatable at the given index.
+ */
+char *
+track_processor_get_midi_automatable_label (
+  int idx)
+{
+  /* channels start from 1 */
+  if (idx < TRACK_PROCESSOR_PITCH_BEND_IDX (0))
+    {
+      return
+        g_strdup_printf (
+          "Ch%d %s", idx / 128 + 1,
+          midi_get_cc_name (idx % 128));
+    }
+  else if (idx <
+             TRACK_PROCESSOR_POLY_KEY_PRESSURE_IDX (0))
+    {
+      return
+        g_strdup_printf (
+          "Ch%d Pitch bend",
+          idx - TRACK_PROCESSOR_PITCH_BEND_IDX (0) +
+            1);
+    }
+  else if (idx <
+             TRACK_PROCESSOR_CHANNEL_PRESSURE_IDX (0))
+    {
+      return
+        g_strdup_printf (
+          "Ch%d Poly key pressure",
+          idx -
+            TRACK_PROCESSOR_POLY_KEY_PRESSURE_IDX (0) +
+            1);
+    }
+  return
+    g_strdup_printf (
+      "Ch%d Channel pressure",
+      idx -
+        TRACK_PROCESSOR_CHANNEL_PRESSURE_IDX (0) +
+        1);
+}
+
+/**
+ * Returns the MIDI automatable port at the given
+ * index, or NULL if it wasn't created yet.
+ */
+Port *
+track_processor_get_midi_automatable (
+  const TrackProcessor * self,
+  int                    idx)
+{
+  if (idx < TRACK_PROCESSOR_PITCH_BEND_IDX (0))
+    {
+      return self->midi_cc[idx];
+    }
+  else if (idx <
+             TRACK_PROCESSOR_POLY_KEY_PRESSURE_IDX (0))
+    {
+      return
+        self->pitch_bend[
+          idx - TRACK_PROCESSOR_PITCH_BEND_IDX (0)];
+    }
+  else if (idx <
+             TRACK_PROCESSOR_CHANNEL_PRESSURE_IDX (0))
+    {
+      return
+        self->poly_key_pressure[
+          idx -
+          TRACK_PROCESSOR_POLY_KEY_PRESSURE_IDX (0)];
+    }
+  else if (idx <
+             TRACK_PROCESSOR_NUM_MIDI_AUTOMATABLES)
+    {
+      return
+        self->channel_pressure[
+          idx -
+          TRACK_PROCESSOR_CHANNEL_PRESSURE_IDX (0)];
+    }
+  g_return_val_if_reached (NULL);
+}
+
+/**
+ * Creates the MIDI automatable port at the given
+ * index and its automation track, if they don't
+ * exist yet.
+ *
+ * Must be called from the GTK thread while
+ * processing is held (see
+ * engine_hold_processing()). The graph must be
+ * recalculated afterwards.
+ *
+ * @return The automation track of the port.
+ */
+AutomationTrack *
+track_processor_ensure_midi_automatable (
+  TrackProcessor * self,
+  int              idx)
+{
+  Track * track = self->track;
+  g_return_val_if_fail (
+    IS_TRACK_AND_NONNULL (track) &&
+      track_type_has_piano_roll (track->type),
+    NULL);
+  g_return_val_if_fail (
+    idx >= 0 &&
+      idx < TRACK_PROCESSOR_NUM_MIDI_AUTOMATABLES,
+    NULL);
+
+  AutomationTracklist * atl =
+    track_get_automation_tracklist (track);
+  Port * port =
+    track_processor_get_midi_automatable (
+      self, idx);
+  if (port)
+    {
+      AutomationTrack * at =
+        automation_track_find_from_port (
+          port, track, true);
+      if (at)
+        return at;
+    }
+  else
+    {
+      port = create_midi_automatable (self, idx);
+    }
+
+  AutomationTrack * at = automation_track_new (port);
+  automation_tracklist_add_at (atl, at);
+  automation_track_set_caches (at);
+
+  return at;
+}
+
+/**
+ * Marks the value of the given MIDI automatable
+ * port as changed so that it gets sent during the
+ * next cycle.
+ *
+ * Real-time safe.
+ */
+void
+track_processor_mark_midi_automatable_dirty (
+  Port * port)
+{
+  /* the track is only looked up outside
+   * processing */
+  Track * track = port_get_track (port, false);
+  if (!track || !track->processor)
+    return;
+
+  int idx =
+    track_processor_get_midi_automatable_idx (
+      &port->id);
+  g_return_if_fail (
+    idx >= 0 &&
+      idx < TRACK_PROCESSOR_NUM_MIDI_AUTOMATABLES);
+  g_atomic_int_or (
+    &track->processor->dirty_midi_automatables[
+      idx / 32],
+    1u << (idx % 32));
+}
+
+/**
+ * Returns whether any MIDI controls without a port
+ * received MIDI input since the last call and
+ * clears the flag.
+ */
+bool
+track_processor_get_and_clear_pending (void)
+{
+  return
+    g_atomic_int_compare_and_exchange (
+      &pending_midi_automatables, 1, 0);
+}
+
+/**
+ * Creates the ports and automation tracks of the
+ * MIDI controls that received MIDI input while
+ * recording.
+ *
+ * Must be called from the GTK thread while
+ * processing is held (see
+ * engine_hold_processing()). The graph must be
+ * recalculated afterwards.
+ *
+ * @return Whether any port was created.
+ */
+bool
+track_processor_create_pending_midi_automatables (
+  TrackProcessor * self)
+{
+  bool created = false;
+  for (int i = 0;
+       i < TRACK_PROCESSOR_MIDI_AUTOMATABLES_WORDS;
+       i++)
+    {
+      guint bits =
+        g_atomic_int_and (
+          &self->pending_midi_automatables[i], 0);
+      while (bits)
+        {
+          int bit = g_bit_nth_lsf (bits, -1);
+          bits &= ~(1u << bit);
+          int idx = i * 32 + bit;
+          if (track_processor_get_midi_automatable (
+                self, idx))
+            continue;
+
+          AutomationTrack * at =
+            track_processor_ensure_midi_automatable (
+              self, idx);
+          g_return_val_if_fail (at, created);
+          port_set_control_value (
+            track_processor_get_midi_automatable (
+              self, idx),
+            self->pending_midi_automatable_values[
+              idx],
+            F_NORMALIZED, F_NO_PUBLISH_EVENTS);
+          at->created = true;
+          at->visible = true;
+          EVENTS_PUSH (ET_AUTOMATION_TRACK_ADDED, at);
+          created = true;
+        }
+    }
+
+  return created;
+}
+
 /**
  * Clears all buffers.
  */
@@ -780,61 +1077,141 @@ add_events_from_midi_cc_control_ports (
   const TrackProcessor * self,
   const nframes_t        local_offset)
 {
-  /* FIXME optimize (use caches) */
-  for (int i = 0; i < 16; i++)
+  /* the dirty bits are the only thing changed
+   * here */
+  TrackProcessor * tp = (TrackProcessor *) self;
+
+  for (int i = 0;
+       i < TRACK_PROCESSOR_MIDI_AUTOMATABLES_WORDS;
+       i++)
     {
-      /* starting from 1 */
-      int channel = i + 1;
-      Port * cc = NULL;
-      int offset = i * 128;
-      for (int j = 0; j < 128; j++)
+      if (G_LIKELY (
+            g_atomic_int_get (
+              &tp->dirty_midi_automatables[i]) ==
+              0))
+        continue;
+
+      guint bits =
+        g_atomic_int_and (
+          &tp->dirty_midi_automatables[i], 0);
+      while (bits)
         {
-          cc = self->midi_cc[offset + j];
-          if (G_LIKELY (
-                math_floats_equal (
-                  cc->last_sent_control,
-                  cc->control)))
+          int bit = g_bit_nth_lsf (bits, -1);
+          bits &= ~(1u << bit);
+          int idx = i * 32 + bit;
+          Port * cc =
+            track_processor_get_midi_automatable (
+              self, idx);
+          if (!cc ||
+              math_floats_equal (
+                cc->last_sent_control,
+                cc->control))
             continue;
 
-          midi_events_add_control_change (
-            self->midi_out->midi_events,
-            channel, (midi_byte_t) j,
-            math_round_float_to_type (
-              cc->control * 127.f, midi_byte_t),
-            local_offset, false);
+          if (idx <
+                TRACK_PROCESSOR_PITCH_BEND_IDX (0))
+            {
+              /* starting from 1 */
+              midi_events_add_control_change (
+                self->midi_out->midi_events,
+                (midi_byte_t) (idx / 128 + 1),
+                (midi_byte_t) (idx % 128),
+                math_round_float_to_type (
+                  cc->control * 127.f,
+                  midi_byte_t),
+                local_offset, false);
+            }
+          else if (cc->id.flags2 &
+                     PORT_FLAG2_MIDI_PITCH_BEND)
+            {
+              midi_events_add_pitchbend (
+                self->midi_out->midi_events,
+                (midi_byte_t)
+                (cc->id.port_index + 1),
+                math_round_float_to_int (
+                  cc->control),
+                local_offset, false);
+            }
+          /* TODO poly key pressure and channel
+           * pressure */
+
           cc->last_sent_control = cc->control;
         }
+    }
+}
 
-      cc = self->pitch_bend[i];
-      if (!math_floats_equal (
-            cc->last_sent_control, cc->control))
+/**
+ * Sets the values of the MIDI controls that are
+ * not covered by \ref TrackProcessor.cc_mappings
+ * from the MIDI input while recording.
+ *
+ * Controls that don't have a port yet keep their
+ * last value and are marked as pending so that
+ * their ports get created from the GTK thread.
+ */
+static void
+apply_midi_automatables_from_input (
+  const TrackProcessor * self)
+{
+  TrackProcessor * tp = (TrackProcessor *) self;
+  MidiEvents * events = self->midi_in->midi_events;
+  for (int i = 0; i < events->num_events; i++)
+    {
+      MidiEvent * ev = &events->events[i];
+      int channel = midi_event_get_channel (ev);
+      if (channel == 0)
+        continue;
+
+      int idx;
+      float val;
+      switch (midi_event_get_type (ev))
         {
-          midi_events_add_pitchbend (
-            self->midi_out->midi_events,
-            channel,
-            math_round_float_to_int (cc->control),
-            local_offset, false);
-          cc->last_sent_control = cc->control;
+        case MIDI_EVENT_TYPE_CONTROLLER:
+          idx =
+            TRACK_PROCESSOR_MIDI_CC_IDX (
+              channel - 1,
+              midi_event_get_controller (ev));
+          val =
+            (float) midi_event_get_control (ev) /
+            127.f;
+          break;
+        case MIDI_EVENT_TYPE_PITCHBEND:
+          idx =
+            TRACK_PROCESSOR_PITCH_BEND_IDX (
+              channel - 1);
+          val =
+            (float)
+            (midi_event_get_pitchbend (ev) + 8192) /
+            16383.f;
+          break;
+        default:
+          continue;
         }
 
-      /* TODO */
-#if 0
-      cc = self->poly_key_pressure[i];
-      midi_events_add_pitchbend (
-        self->midi_out->midi_events,
-        channel,
-        math_round_float_to_int (cc->control),
-        local_offset, false);
-      cc->last_sent_control = cc->control;
-
-      cc = self->channel_pressure[i];
-      midi_events_add_pitchbend (
-        self->midi_out->midi_events,
-        channel,
-        math_round_float_to_int (cc->control),
-        local_offset, false);
-      cc->last_sent_control = cc->control;
-#endif
+      Port * port =
+        track_processor_get_midi_automatable (
+          self, idx);
+      if (port)
+        {
+          /* CCs are applied by the mappings */
+          if (idx >=
+                TRACK_PROCESSOR_PITCH_BEND_IDX (0))
+            {
+              port_set_control_value (
+                port, val, F_NORMALIZED,
+                F_PUBLISH_EVENTS);
+            }
+        }
+      else
+        {
+          tp->pending_midi_automatable_values[idx] =
+            val;
+          g_atomic_int_or (
+            &tp->pending_midi_automatables[idx / 32],
+            1u << (idx % 32));
+          g_atomic_int_set (
+            &pending_midi_automatables, 1);
+        }
     }
 }
 
@@ -889,12 +1266,17 @@ track_processor_process (
     {
       Port * pr = self->piano_roll;
 
+      /* get the events queued from other threads,
+       * then write the engine's own events
+       * directly */
+      midi_events_dequeue (pr->midi_events);
+
       /* panic MIDI if necessary */
       if (g_atomic_int_get (
             &AUDIO_ENGINE->panic))
         {
           midi_events_panic (
-            pr->midi_events, 1);
+            pr->midi_events, F_NOT_QUEUED);
         }
       /* get events from track if playing */
       else if (TRANSPORT->play_state ==
@@ -911,7 +1293,6 @@ track_processor_process (
           track_fill_events (
             tr, time_nfo, pr->midi_events, NULL);
         }
-      midi_events_dequeue (pr->midi_events);
 #if 0
       if (pr->midi_events->num_events > 0)
         {
@@ -1060,6 +1441,13 @@ track_processor_process (
             F_NOT_QUEUED);
         }
 
+      /* update the other MIDI controls */
+      if (TRANSPORT->recording &&
+          track_type_has_piano_roll (tr->type))
+        {
+          apply_midi_automatables_from_input (self);
+        }
+
       midi_events_append (
         self->midi_in->midi_events,
         self->midi_out->midi_events, local_offset,
@@ -1080,7 +1468,9 @@ track_processor_process (
        * input content to the output ports.
        * this will also create automation for MIDI
        * CC, if any (see
-       * midi_mappings_apply_cc_events above) */
+       * midi_mappings_apply_from_cc_events() and
+       * apply_midi_automatables_from_input()
+       * above) */
       handle_recording (self, time_nfo);
     }
 
@@ -1127,6 +1517,30 @@ track_processor_copy_values (
     {
       dest->mono->control = src->mono->control;
     }
+
+  /* the automation tracks are copied with the
+   * track, so only create the ports */
+  for (int i = 0;
+       i < TRACK_PROCESSOR_NUM_MIDI_AUTOMATABLES;
+       i++)
+    {
+      Port * src_port =
+        track_processor_get_midi_automatable (
+          src, i);
+      if (!src_port)
+        continue;
+
+      Port * dest_port =
+        track_processor_get_midi_automatable (
+          dest, i);
+      if (!dest_port)
+        {
+          dest_port =
+            create_midi_automatable (dest, i);
+        }
+      dest_port->control = src_port->control;
+    }
+  mark_all_midi_automatables_dirty (dest);
 }
 
 /**
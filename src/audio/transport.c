@@ -506,6 +506,12 @@ transport_update_caches (
     (self->sixteenths_per_beat * beats_per_bar);
   g_warn_if_fail (self->ticks_per_bar > 0.0);
   g_warn_if_fail (self->ticks_per_beat > 0.0);
+
+  if (self->audio_engine)
+    {
+      engine_update_tempo_map (
+        self->audio_engine, 0);
+    }
 }
 
 void
@@ -692,14 +698,10 @@ transport_move_playhead (
                           piano_roll->
                             midi_events;
 
-                      zix_sem_wait (
-                        &midi_events->access_sem);
                       midi_events_add_note_off (
                         midi_events, 1,
                         midi_note->val,
                         0, 1);
-                      zix_sem_post (
-                        &midi_events->access_sem);
                     }
                 }
             }
@@ -1157,12 +1159,12 @@ void
 transport_move_backward (
   Transport * self)
 {
-  Position * pos =
-    snap_grid_get_nearby_snap_point (
-      SNAP_GRID_TIMELINE,
-      &self->playhead_pos, true);
+  Position pos;
+  snap_grid_get_nearby_snap_point (
+    SNAP_GRID_TIMELINE, &self->playhead_pos,
+    true, false, &pos);
   transport_move_playhead (
-    self, pos, F_PANIC, F_SET_CUE_POINT,
+    self, &pos, F_PANIC, F_SET_CUE_POINT,
     F_PUBLISH_EVENTS);
 }
 
@@ -1173,12 +1175,12 @@ void
 transport_move_forward (
   Transport * self)
 {
-  Position * pos =
-    snap_grid_get_nearby_snap_point (
-      SNAP_GRID_TIMELINE,
-      &self->playhead_pos, false);
+  Position pos;
+  snap_grid_get_nearby_snap_point (
+    SNAP_GRID_TIMELINE, &self->playhead_pos,
+    false, false, &pos);
   transport_move_playhead (
-    self, pos, F_PANIC, F_SET_CUE_POINT,
+    self, &pos, F_PANIC, F_SET_CUE_POINT,
     F_PUBLISH_EVENTS);
 }
 
@@ -27,6 +27,7 @@
 #include "audio/router.h"
 #include "audio/stretcher.h"
 #include "gui/backend/arranger_object.h"
+#include "gui/backend/arranger_object_index.h"
 #include "gui/backend/automation_selections.h"
 #include "gui/backend/chord_selections.h"
 #include "gui/backend/event.h"
@@ -337,6 +338,8 @@ arranger_object_set_to_object (
     default:
       break;
     }
+
+  arranger_object_index_object_changed (dest);
 }
 
 /**
@@ -707,12 +710,19 @@ arranger_object_set_position (
   if (validate &&
       !arranger_object_is_position_valid (
         self, pos, pos_type))
-    return;
+    {
+      /* positions may also have been changed
+       * directly before calling this */
+      arranger_object_index_object_changed (self);
+      return;
+    }
 
   Position * pos_ptr;
   pos_ptr = get_position_ptr (self, pos_type);
   g_return_if_fail (pos_ptr);
   position_set_to_pos (pos_ptr, pos);
+
+  arranger_object_index_object_changed (self);
 }
 
 /**
@@ -3888,6 +3898,13 @@ arranger_object_free (
 {
   g_return_if_fail (IS_ARRANGER_OBJECT (self));
 
+  arranger_object_index_object_removed (self);
+  if (self->type == ARRANGER_OBJECT_TYPE_REGION)
+    {
+      /* children are indexed by region */
+      arranger_object_index_container_freed (self);
+    }
+
   switch (self->type)
     {
     case TYPE (REGION):
@@ -0,0 +1,826 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "audio/midi_note.h"
+#include "gui/backend/arranger_object.h"
+#include "gui/backend/arranger_object_index.h"
+#include "utils/objects.h"
+
+#include <glib.h>
+
+/** Bumped on every change. */
+static volatile gint generation = 1;
+
+/**
+ * Registered caches.
+ *
+ * Objects may be changed outside the GTK thread
+ * (eg, when loading), so the caches are only
+ * accessed with this lock held.
+ */
+static GPtrArray * caches = NULL;
+static GRecMutex   caches_lock;
+
+static void
+get_extent (
+  ArrangerObjectIndex * self,
+  ArrangerObject *      obj,
+  double *              start_ticks,
+  double *              end_ticks)
+{
+  if (self->extent_func)
+    {
+      self->extent_func (
+        obj, start_ticks, end_ticks,
+        self->extent_user_data);
+      return;
+    }
+
+  *start_ticks = obj->pos.ticks;
+  *end_ticks =
+    arranger_object_type_has_length (obj->type) ?
+      obj->end_pos.ticks : obj->pos.ticks;
+}
+
+static int
+get_bucket (
+  ArrangerObjectIndex * self,
+  ArrangerObject *      obj)
+{
+  if (self->num_buckets == 1)
+    return 0;
+
+  g_return_val_if_fail (
+    obj->type == ARRANGER_OBJECT_TYPE_MIDI_NOTE,
+    0);
+  return ((MidiNote *) obj)->val;
+}
+
+/**
+ * Orders entries by start position, then by
+ * object so that every entry is unique.
+ */
+static int
+entry_cmp (
+  const ArrangerObjectIndexEntry * a,
+  const ArrangerObjectIndexEntry * b)
+{
+  if (a->start_ticks < b->start_ticks)
+    return -1;
+  else if (a->start_ticks > b->start_ticks)
+    return 1;
+  else if ((uintptr_t) a->obj < (uintptr_t) b->obj)
+    return -1;
+  else if ((uintptr_t) a->obj > (uintptr_t) b->obj)
+    return 1;
+  return 0;
+}
+
+static inline int
+node_get_height (
+  ArrangerObjectIndexNode * node)
+{
+  return node ? node->height : 0;
+}
+
+/**
+ * Recalculates the height and maximum end position
+ * of the node from its children.
+ */
+static void
+node_update (
+  ArrangerObjectIndexNode * node)
+{
+  node->height =
+    1 +
+    MAX (
+      node_get_height (node->left),
+      node_get_height (node->right));
+  double max_end = node->entry.end_ticks;
+  if (node->left)
+    max_end =
+      MAX (max_end, node->left->max_end_ticks);
+  if (node->right)
+    max_end =
+      MAX (max_end, node->right->max_end_ticks);
+  node->max_end_ticks = max_end;
+}
+
+static ArrangerObjectIndexNode *
+rotate_right (
+  ArrangerObjectIndexNode * node)
+{
+  ArrangerObjectIndexNode * left = node->left;
+  node->left = left->right;
+  left->right = node;
+  node_update (node);
+  node_update (left);
+  return left;
+}
+
+static ArrangerObjectIndexNode *
+rotate_left (
+  ArrangerObjectIndexNode * node)
+{
+  ArrangerObjectIndexNode * right = node->right;
+  node->right = right->left;
+  right->left = node;
+  node_update (node);
+  node_update (right);
+  return right;
+}
+
+/**
+ * Updates the node after one of its subtrees
+ * changed and rebalances it if needed.
+ *
+ * @return The new root of the subtree.
+ */
+static ArrangerObjectIndexNode *
+node_balance (
+  ArrangerObjectIndexNode * node)
+{
+  node_update (node);
+  int balance =
+    node_get_height (node->left) -
+    node_get_height (node->right);
+  if (balance > 1)
+    {
+      if (node_get_height (node->left->left) <
+            node_get_height (node->left->right))
+        node->left = rotate_left (node->left);
+      return rotate_right (node);
+    }
+  else if (balance < -1)
+    {
+      if (node_get_height (node->right->right) <
+            node_get_height (node->right->left))
+        node->right = rotate_right (node->right);
+      return rotate_left (node);
+    }
+  return node;
+}
+
+/**
+ * @return The new root of the subtree.
+ */
+static ArrangerObjectIndexNode *
+node_insert (
+  ArrangerObjectIndexNode * root,
+  ArrangerObjectIndexNode * node)
+{
+  if (!root)
+    return node;
+
+  if (entry_cmp (&node->entry, &root->entry) < 0)
+    root->left = node_insert (root->left, node);
+  else
+    root->right = node_insert (root->right, node);
+  return node_balance (root);
+}
+
+/**
+ * Detaches the first node of the subtree.
+ *
+ * @param[out] min The detached node.
+ * @return The new root of the subtree.
+ */
+static ArrangerObjectIndexNode *
+node_remove_min (
+  ArrangerObjectIndexNode *  root,
+  ArrangerObjectIndexNode ** min)
+{
+  if (!root->left)
+    {
+      *min = root;
+      return root->right;
+    }
+
+  root->left = node_remove_min (root->left, min);
+  return node_balance (root);
+}
+
+/**
+ * Detaches the given node from the subtree.
+ *
+ * @return The new root of the subtree.
+ */
+static ArrangerObjectIndexNode *
+node_remove (
+  ArrangerObjectIndexNode * root,
+  ArrangerObjectIndexNode * node)
+{
+  g_return_val_if_fail (root, NULL);
+
+  int cmp = entry_cmp (&node->entry, &root->entry);
+  if (cmp < 0)
+    {
+      root->left = node_remove (root->left, node);
+    }
+  else if (cmp > 0)
+    {
+      root->right = node_remove (root->right, node);
+    }
+  else
+    {
+      g_return_val_if_fail (root == node, root);
+      if (!node->right)
+        return node->left;
+
+      ArrangerObjectIndexNode * min;
+      ArrangerObjectIndexNode * right =
+        node_remove_min (node->right, &min);
+      min->left = node->left;
+      min->right = right;
+      root = min;
+    }
+  return node_balance (root);
+}
+
+/**
+ * Builds an index for the given objects.
+ *
+ * @param by_pitch Whether to put the objects in
+ *   separate buckets by pitch. Only valid for
+ *   MIDI notes.
+ * @param extent_func Function to get the drawn
+ *   extent of each object, or NULL to use the
+ *   object positions.
+ */
+ArrangerObjectIndex *
+arranger_object_index_new (
+  ArrangerObject **             objs,
+  int                           num_objs,
+  bool                          by_pitch,
+  ArrangerObjectIndexExtentFunc extent_func,
+  void *                        extent_user_data)
+{
+  ArrangerObjectIndex * self =
+    object_new (ArrangerObjectIndex);
+
+  self->extent_func = extent_func;
+  self->extent_user_data = extent_user_data;
+  self->num_buckets =
+    by_pitch ?
+      ARRANGER_OBJECT_INDEX_NUM_PITCHES : 1;
+  self->buckets =
+    object_new_n (
+      (size_t) self->num_buckets,
+      ArrangerObjectIndexBucket);
+  self->nodes =
+    g_hash_table_new_full (
+      NULL, NULL, NULL, g_free);
+
+  for (int i = 0; i < num_objs; i++)
+    {
+      arranger_object_index_add (self, objs[i]);
+    }
+
+  return self;
+}
+
+/**
+ * Adds an object to the index.
+ */
+void
+arranger_object_index_add (
+  ArrangerObjectIndex * self,
+  ArrangerObject *      obj)
+{
+  g_return_if_fail (
+    !g_hash_table_contains (self->nodes, obj));
+
+  ArrangerObjectIndexNode * node =
+    object_new (ArrangerObjectIndexNode);
+  node->entry.obj = obj;
+  get_extent (
+    self, obj, &node->entry.start_ticks,
+    &node->entry.end_ticks);
+  node->bucket = get_bucket (self, obj);
+  node_update (node);
+
+  ArrangerObjectIndexBucket * b =
+    &self->buckets[node->bucket];
+  b->root = node_insert (b->root, node);
+  b->num_entries++;
+  g_hash_table_insert (self->nodes, obj, node);
+
+  self->num_objs++;
+}
+
+/**
+ * Removes an object from the index.
+ *
+ * @return Whether the object was found.
+ */
+bool
+arranger_object_index_remove (
+  ArrangerObjectIndex * self,
+  ArrangerObject *      obj)
+{
+  /* the node keeps the position and pitch the
+   * object had when it was added */
+  ArrangerObjectIndexNode * node =
+    (ArrangerObjectIndexNode *)
+    g_hash_table_lookup (self->nodes, obj);
+  if (!node)
+    return false;
+
+  ArrangerObjectIndexBucket * b =
+    &self->buckets[node->bucket];
+  b->root = node_remove (b->root, node);
+  b->num_entries--;
+  g_hash_table_remove (self->nodes, obj);
+
+  self->num_objs--;
+
+  return true;
+}
+
+/**
+ * Moves the object's entry after its position,
+ * pitch or drawn extent changed.
+ *
+ * @return Whether the object was found.
+ */
+bool
+arranger_object_index_update (
+  ArrangerObjectIndex * self,
+  ArrangerObject *      obj)
+{
+  if (!arranger_object_index_remove (self, obj))
+    return false;
+
+  arranger_object_index_add (self, obj);
+  return true;
+}
+
+/**
+ * Calls \ref func for each entry in the subtree
+ * that overlaps the given range, in order.
+ */
+static void
+node_foreach_in_range (
+  ArrangerObjectIndexNode * node,
+  double                    start_ticks,
+  double                    end_ticks,
+  ArrangerObjectIndexFunc   func,
+  void *                    user_data)
+{
+  /* skip subtrees that end before the range */
+  if (!node || node->max_end_ticks < start_ticks)
+    return;
+
+  node_foreach_in_range (
+    node->left, start_ticks, end_ticks, func,
+    user_data);
+
+  /* this entry and the ones after it start after
+   * the range */
+  if (node->entry.start_ticks > end_ticks)
+    return;
+
+  if (node->entry.end_ticks >= start_ticks)
+    func (node->entry.obj, user_data);
+
+  node_foreach_in_range (
+    node->right, start_ticks, end_ticks, func,
+    user_data);
+}
+
+/**
+ * Calls \ref func for each object that may overlap
+ * the given range.
+ *
+ * Objects that are certain not to overlap are
+ * skipped, but the caller is still expected to do
+ * any exact checks.
+ *
+ * @param start_ticks Range start, in the same
+ *   frame of reference as the object positions.
+ * @param end_ticks Range end (inclusive).
+ * @param min_pitch Lowest pitch to check, if the
+ *   index is by pitch.
+ * @param max_pitch Highest pitch to check, if the
+ *   index is by pitch.
+ */
+void
+arranger_object_index_foreach_in_range (
+  ArrangerObjectIndex *   self,
+  double                  start_ticks,
+  double                  end_ticks,
+  int                     min_pitch,
+  int                     max_pitch,
+  ArrangerObjectIndexFunc func,
+  void *                  user_data)
+{
+  int first_bucket = 0;
+  int last_bucket = self->num_buckets - 1;
+  if (self->num_buckets > 1)
+    {
+      first_bucket =
+        CLAMP (min_pitch, 0, last_bucket);
+      last_bucket =
+        CLAMP (max_pitch, 0, last_bucket);
+    }
+
+  for (int i = first_bucket; i <= last_bucket; i++)
+    {
+      node_foreach_in_range (
+        self->buckets[i].root, start_ticks,
+        end_ticks, func, user_data);
+    }
+}
+
+/**
+ * Returns whether the index can be used for a
+ * container with \ref num_objs objects.
+ */
+bool
+arranger_object_index_is_valid (
+  ArrangerObjectIndex * self,
+  int                   num_objs,
+  bool                  by_pitch)
+{
+  return
+    self->num_objs == num_objs &&
+    (self->num_buckets > 1) == by_pitch;
+}
+
+void
+arranger_object_index_free (
+  ArrangerObjectIndex * self)
+{
+  /* frees the nodes */
+  object_free_w_func_and_null (
+    g_hash_table_destroy, self->nodes);
+  free (self->buckets);
+
+  object_zero_and_free (self);
+}
+
+/**
+ * Creates and registers a new cache.
+ */
+ArrangerObjectIndexCache *
+arranger_object_index_cache_new (
+  ArrangerObjectIndexExtentFunc extent_func,
+  void *                        extent_user_data)
+{
+  ArrangerObjectIndexCache * self =
+    object_new (ArrangerObjectIndexCache);
+
+  self->indices =
+    g_hash_table_new_full (
+      NULL, NULL, NULL,
+      (GDestroyNotify) arranger_object_index_free);
+  self->obj_indices =
+    g_hash_table_new (NULL, NULL);
+  self->extent_func = extent_func;
+  self->extent_user_data = extent_user_data;
+
+  g_rec_mutex_lock (&caches_lock);
+  if (!caches)
+    caches = g_ptr_array_new ();
+  g_ptr_array_add (caches, self);
+  g_rec_mutex_unlock (&caches_lock);
+
+  return self;
+}
+
+/**
+ * Removes the index of the given container and
+ * its objects from the cache.
+ */
+static void
+drop_index (
+  ArrangerObjectIndexCache * self,
+  const void *               container)
+{
+  ArrangerObjectIndex * index =
+    (ArrangerObjectIndex *)
+    g_hash_table_lookup (
+      self->indices, container);
+  if (!index)
+    return;
+
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init (&iter, index->nodes);
+  while (g_hash_table_iter_next (
+           &iter, &key, NULL))
+    {
+      if (g_hash_table_lookup (
+            self->obj_indices, key) == index)
+        {
+          g_hash_table_remove (
+            self->obj_indices, key);
+        }
+    }
+
+  g_hash_table_remove (self->indices, container);
+}
+
+/**
+ * Returns the index of the given container,
+ * building it if it does not exist or does not
+ * match the container.
+ */
+static ArrangerObjectIndex *
+get_index (
+  ArrangerObjectIndexCache * self,
+  const void *               container,
+  ArrangerObject **          objs,
+  int                        num_objs,
+  bool                       by_pitch)
+{
+  ArrangerObjectIndex * index =
+    (ArrangerObjectIndex *)
+    g_hash_table_lookup (
+      self->indices, container);
+  if (index &&
+      arranger_object_index_is_valid (
+        index, num_objs, by_pitch))
+    {
+      return index;
+    }
+
+  /* an object was added or removed without a
+   * notification, so rebuild this container */
+  drop_index (self, container);
+  index =
+    arranger_object_index_new (
+      objs, num_objs, by_pitch,
+      self->extent_func, self->extent_user_data);
+  index->container = container;
+  g_hash_table_insert (
+    self->indices, (gpointer) container, index);
+  for (int i = 0; i < num_objs; i++)
+    {
+      g_hash_table_replace (
+        self->obj_indices, objs[i], index);
+    }
+
+  return index;
+}
+
+/**
+ * Calls \ref func for each of the objects of the
+ * given container that may overlap the given
+ * range, building the container's index if
+ * needed.
+ *
+ * See arranger_object_index_foreach_in_range().
+ *
+ * @param container The object owning the array
+ *   (lane, region, etc.).
+ */
+void
+arranger_object_index_cache_foreach_in_range (
+  ArrangerObjectIndexCache * self,
+  const void *               container,
+  ArrangerObject **          objs,
+  int                        num_objs,
+  bool                       by_pitch,
+  double                     start_ticks,
+  double                     end_ticks,
+  int                        min_pitch,
+  int                        max_pitch,
+  ArrangerObjectIndexFunc    func,
+  void *                     user_data)
+{
+  g_rec_mutex_lock (&caches_lock);
+
+  ArrangerObjectIndex * index =
+    get_index (
+      self, container, objs, num_objs, by_pitch);
+  arranger_object_index_foreach_in_range (
+    index, start_ticks, end_ticks, min_pitch,
+    max_pitch, func, user_data);
+
+  g_rec_mutex_unlock (&caches_lock);
+}
+
+/**
+ * Drops all indices in the cache.
+ *
+ * To be called when the drawn extents of all
+ * objects change (eg, on zoom).
+ */
+void
+arranger_object_index_cache_clear (
+  ArrangerObjectIndexCache * self)
+{
+  g_rec_mutex_lock (&caches_lock);
+  g_hash_table_remove_all (self->obj_indices);
+  g_hash_table_remove_all (self->indices);
+  g_rec_mutex_unlock (&caches_lock);
+}
+
+/**
+ * Unregisters and frees the cache.
+ */
+void
+arranger_object_index_cache_free (
+  ArrangerObjectIndexCache * self)
+{
+  g_rec_mutex_lock (&caches_lock);
+  g_ptr_array_remove_fast (caches, self);
+  g_rec_mutex_unlock (&caches_lock);
+
+  object_free_w_func_and_null (
+    g_hash_table_destroy, self->obj_indices);
+  object_free_w_func_and_null (
+    g_hash_table_destroy, self->indices);
+
+  object_zero_and_free (self);
+}
+
+/**
+ * Returns whether changes to the object also
+ * change the drawn extent of other objects in the
+ * same container.
+ *
+ * The curve of an automation point is drawn up to
+ * the next point, so the whole region is
+ * re-indexed instead.
+ */
+static bool
+affects_neighbors (
+  ArrangerObject * obj)
+{
+  return
+    obj->type ==
+      ARRANGER_OBJECT_TYPE_AUTOMATION_POINT;
+}
+
+/**
+ * To be called after an object was added to a
+ * container.
+ */
+void
+arranger_object_index_object_added (
+  const void *     container,
+  ArrangerObject * obj)
+{
+  g_atomic_int_inc (&generation);
+
+  g_rec_mutex_lock (&caches_lock);
+  for (guint i = 0; caches && i < caches->len; i++)
+    {
+      ArrangerObjectIndexCache * cache =
+        (ArrangerObjectIndexCache *)
+        g_ptr_array_index (caches, i);
+      ArrangerObjectIndex * index =
+        (ArrangerObjectIndex *)
+        g_hash_table_lookup (
+          cache->indices, container);
+      if (!index)
+        continue;
+
+      if (affects_neighbors (obj))
+        {
+          drop_index (cache, container);
+          continue;
+        }
+
+      /* in case the object was not removed from
+       * its previous container */
+      ArrangerObjectIndex * prev_index =
+        (ArrangerObjectIndex *)
+        g_hash_table_lookup (
+          cache->obj_indices, obj);
+      if (prev_index)
+        {
+          arranger_object_index_remove (
+            prev_index, obj);
+        }
+
+      arranger_object_index_add (index, obj);
+      g_hash_table_replace (
+        cache->obj_indices, obj, index);
+    }
+  g_rec_mutex_unlock (&caches_lock);
+}
+
+/**
+ * To be called after an object was removed from
+ * its container, or before it is freed.
+ */
+void
+arranger_object_index_object_removed (
+  ArrangerObject * obj)
+{
+  g_atomic_int_inc (&generation);
+
+  g_rec_mutex_lock (&caches_lock);
+  for (guint i = 0; caches && i < caches->len; i++)
+    {
+      ArrangerObjectIndexCache * cache =
+        (ArrangerObjectIndexCache *)
+        g_ptr_array_index (caches, i);
+      ArrangerObjectIndex * index =
+        (ArrangerObjectIndex *)
+        g_hash_table_lookup (
+          cache->obj_indices, obj);
+      if (!index)
+        continue;
+
+      if (affects_neighbors (obj))
+        {
+          drop_index (cache, index->container);
+          continue;
+        }
+
+      arranger_object_index_remove (index, obj);
+      g_hash_table_remove (
+        cache->obj_indices, obj);
+    }
+  g_rec_mutex_unlock (&caches_lock);
+}
+
+/**
+ * To be called after the position, pitch or drawn
+ * extent of an object changed.
+ */
+void
+arranger_object_index_object_changed (
+  ArrangerObject * obj)
+{
+  g_atomic_int_inc (&generation);
+
+  g_rec_mutex_lock (&caches_lock);
+  for (guint i = 0; caches && i < caches->len; i++)
+    {
+      ArrangerObjectIndexCache * cache =
+        (ArrangerObjectIndexCache *)
+        g_ptr_array_index (caches, i);
+      ArrangerObjectIndex * index =
+        (ArrangerObjectIndex *)
+        g_hash_table_lookup (
+          cache->obj_indices, obj);
+      if (!index)
+        continue;
+
+      if (affects_neighbors (obj))
+        {
+          drop_index (cache, index->container);
+          continue;
+        }
+
+      arranger_object_index_update (index, obj);
+    }
+  g_rec_mutex_unlock (&caches_lock);
+}
+
+/**
+ * To be called before a container is freed.
+ */
+void
+arranger_object_index_container_freed (
+  const void * container)
+{
+  g_atomic_int_inc (&generation);
+
+  g_rec_mutex_lock (&caches_lock);
+  for (guint i = 0; caches && i < caches->len; i++)
+    {
+      ArrangerObjectIndexCache * cache =
+        (ArrangerObjectIndexCache *)
+        g_ptr_array_index (caches, i);
+      drop_index (cache, container);
+    }
+  g_rec_mutex_unlock (&caches_lock);
+}
+
+/**
+ * Returns a counter that is bumped on every
+ * object change, for other caches that depend on
+ * object positions.
+ */
+unsigned int
+arranger_object_index_get_generation (void)
+{
+  return
+    (unsigned int)
+    g_atomic_int_get (&generation);
+}
@@ -53,6 +53,82 @@
 #define TYPE(x) \
   (ARRANGER_SELECTIONS_TYPE_##x)
 
+/**
+ * Returns the set of selected objects, creating
+ * it from the object arrays if it does not exist
+ * yet.
+ *
+ * Each object maps to its index in its array,
+ * plus 1.
+ */
+static GHashTable *
+get_objects_set (
+  ArrangerSelections * self)
+{
+  if (G_LIKELY (self->objects_set))
+    return self->objects_set;
+
+  self->objects_set =
+    g_hash_table_new (NULL, NULL);
+
+  TimelineSelections * ts;
+  ChordSelections * cs;
+  MidiArrangerSelections * mas;
+  AutomationSelections * as;
+
+#define ADD_OBJS(sel,sc) \
+  for (int i = 0; i < sel->num_##sc##s; i++) \
+    { \
+      g_hash_table_insert ( \
+        self->objects_set, sel->sc##s[i], \
+        GINT_TO_POINTER (i + 1)); \
+    }
+
+  switch (self->type)
+    {
+    case TYPE (TIMELINE):
+      ts = (TimelineSelections *) self;
+      ADD_OBJS (ts, region);
+      ADD_OBJS (ts, scale_object);
+      ADD_OBJS (ts, marker);
+      break;
+    case TYPE (MIDI):
+      mas = (MidiArrangerSelections *) self;
+      ADD_OBJS (mas, midi_note);
+      break;
+    case TYPE (AUTOMATION):
+      as = (AutomationSelections *) self;
+      ADD_OBJS (as, automation_point);
+      break;
+    case TYPE (CHORD):
+      cs = (ChordSelections *) self;
+      ADD_OBJS (cs, chord_object);
+      break;
+    default:
+      break;
+    }
+
+#undef ADD_OBJS
+
+  return self->objects_set;
+}
+
+/**
+ * Drops the set of selected objects so that it
+ * gets recreated from the object arrays the next
+ * time it is needed.
+ *
+ * To be called after the object arrays are
+ * modified directly.
+ */
+static void
+invalidate_objects_set (
+  ArrangerSelections * self)
+{
+  object_free_w_func_and_null (
+    g_hash_table_destroy, self->objects_set);
+}
+
 /**
  * Inits the selections after loading a project.
  *
@@ -157,6 +233,9 @@ arranger_selections_init_loaded (
     }
 
 #undef SET_OBJ
+
+  /* the objects may have been replaced above */
+  invalidate_objects_set (self);
 }
 
 /**
@@ -337,13 +416,13 @@ arranger_selections_add_object (
       g_return_if_reached();
     }
 
+  GHashTable * set = get_objects_set (self);
+
 #define ADD_OBJ(sel,caps,cc,sc) \
   if (obj->type == ARRANGER_OBJECT_TYPE_##caps) \
     { \
       cc * sc = (cc *) obj; \
-      if (!array_contains ( \
-             sel->sc##s, sel->num_##sc##s, \
-             sc)) \
+      if (!g_hash_table_contains (set, sc)) \
         { \
           array_double_size_if_full ( \
             sel->sc##s, sel->num_##sc##s, \
@@ -352,6 +431,9 @@ arranger_selections_add_object (
             sel->sc##s, \
             sel->num_##sc##s, \
             sc); \
+          g_hash_table_insert ( \
+            set, sc, \
+            GINT_TO_POINTER (sel->num_##sc##s)); \
         } \
     }
 
@@ -414,6 +496,28 @@ arranger_selections_add_object (
 #undef ADD_OBJ
 }
 
+/**
+ * Appends the given objects to the selections.
+ *
+ * Unlike calling arranger_object_select() for
+ * each object, this does not look up the
+ * selections or log each object, so it should be
+ * used when selecting many objects at once (eg,
+ * select all).
+ */
+void
+arranger_selections_add_objects (
+  ArrangerSelections * self,
+  ArrangerObject **    objs,
+  int                  num_objs)
+{
+  for (int i = 0; i < num_objs; i++)
+    {
+      arranger_selections_add_object (
+        self, objs[i]);
+    }
+}
+
 /**
  * Sets the values of each object in the dest selections
  * to the values in the src selections.
@@ -504,7 +608,6 @@ arranger_selections_clone (
     case TYPE (TIMELINE):
       src_ts = (TimelineSelections *) self;
       new_ts = object_new (TimelineSelections);
-      new_ts->base = src_ts->base;
       arranger_selections_init (
         (ArrangerSelections *) new_ts,
         ARRANGER_SELECTIONS_TYPE_TIMELINE);
@@ -522,7 +625,6 @@ arranger_selections_clone (
       arranger_selections_init (
         (ArrangerSelections *) new_mas,
         ARRANGER_SELECTIONS_TYPE_MIDI);
-      new_mas->base = src_mas->base;
       CLONE_OBJS (
         src_mas, new_mas, MidiNote, midi_note);
       return ((ArrangerSelections *) new_mas);
@@ -533,7 +635,6 @@ arranger_selections_clone (
       arranger_selections_init (
         (ArrangerSelections *) new_as,
         ARRANGER_SELECTIONS_TYPE_AUTOMATION);
-      new_as->base = src_as->base;
       CLONE_OBJS (
         src_as, new_as, AutomationPoint,
         automation_point);
@@ -545,7 +646,6 @@ arranger_selections_clone (
       arranger_selections_init (
         (ArrangerSelections *) new_cs,
         ARRANGER_SELECTIONS_TYPE_CHORD);
-      new_cs->base = src_cs->base;
       CLONE_OBJS (
         src_cs, new_cs, ChordObject, chord_object);
       return ((ArrangerSelections *) new_cs);
@@ -555,8 +655,7 @@ arranger_selections_clone (
         object_new (AudioSelections);
       arranger_selections_init (
         (ArrangerSelections *) new_aus,
-        ARRANGER_SELECTIONS_TYPE_CHORD);
-      new_aus->base = src_aus->base;
+        ARRANGER_SELECTIONS_TYPE_AUDIO);
       new_aus->sel_start = src_aus->sel_start;
       new_aus->sel_end = src_aus->sel_end;
       new_aus->has_selection =
@@ -813,6 +912,9 @@ arranger_selections_sort_by_indices (
       g_warn_if_reached ();
       break;
     }
+
+  /* the indices in the set changed */
+  invalidate_objects_set (self);
 }
 
 /**
@@ -1358,9 +1460,8 @@ arranger_selections_select_all (
                   obj =
                     (ArrangerObject *)
                     lane->regions[k];
-                  arranger_object_select (
-                    obj, F_SELECT, F_APPEND,
-                    F_NO_PUBLISH_EVENTS);
+                  arranger_selections_add_object (
+                    self, obj);
                 }
             }
 
@@ -1388,9 +1489,8 @@ arranger_selections_select_all (
                       obj =
                         (ArrangerObject *)
                         at->regions[k];
-                      arranger_object_select (
-                        obj, F_SELECT, F_APPEND,
-                        F_NO_PUBLISH_EVENTS);
+                      arranger_selections_add_object (
+                        self, obj);
                     }
                 }
             }
@@ -1404,9 +1504,8 @@ arranger_selections_select_all (
           ZRegion * cr =
             P_CHORD_TRACK->chord_regions[j];
           obj = (ArrangerObject *) cr;
-          arranger_object_select (
-            obj, F_SELECT, F_APPEND,
-            F_NO_PUBLISH_EVENTS);
+          arranger_selections_add_object (
+            self, obj);
         }
 
       /* scales */
@@ -1416,9 +1515,8 @@ arranger_selections_select_all (
           obj =
             (ArrangerObject *)
             P_CHORD_TRACK->scales[i];
-          arranger_object_select (
-            obj, F_SELECT, F_APPEND,
-            F_NO_PUBLISH_EVENTS);
+          arranger_selections_add_object (
+            self, obj);
         }
 
       /* markers */
@@ -1430,9 +1528,8 @@ arranger_selections_select_all (
             P_MARKER_TRACK->markers[j];
           obj =
             (ArrangerObject *) marker;
-          arranger_object_select (
-            obj, F_SELECT, F_APPEND,
-            F_NO_PUBLISH_EVENTS);
+          arranger_selections_add_object (
+            self, obj);
         }
       break;
     case ARRANGER_SELECTIONS_TYPE_CHORD:
@@ -1449,9 +1546,8 @@ arranger_selections_select_all (
           g_return_if_fail (
             co->chord_index <
             CHORD_EDITOR->num_chords);
-          arranger_object_select (
-            obj, F_SELECT, F_APPEND,
-            F_NO_PUBLISH_EVENTS);
+          arranger_selections_add_object (
+            self, obj);
         }
       break;
     case ARRANGER_SELECTIONS_TYPE_MIDI:
@@ -1465,9 +1561,8 @@ arranger_selections_select_all (
           obj =
             (ArrangerObject *)
             mn;
-          arranger_object_select (
-            obj, F_SELECT, F_APPEND,
-            F_NO_PUBLISH_EVENTS);
+          arranger_selections_add_object (
+            self, obj);
         }
       break;
       break;
@@ -1483,9 +1578,8 @@ arranger_selections_select_all (
         {
           AutomationPoint * ap =  r->aps[i];
           obj = (ArrangerObject *) ap;
-          arranger_object_select (
-            obj, F_SELECT, F_APPEND,
-            F_NO_PUBLISH_EVENTS);
+          arranger_selections_add_object (
+            self, obj);
         }
       break;
     default:
@@ -1520,23 +1614,24 @@ arranger_selections_clear (
   MidiArrangerSelections * mas;
   AutomationSelections * as;
 
-/* use caches because ts->* will be operated on. */
+  if (self->objects_set)
+    {
+      g_hash_table_remove_all (
+        self->objects_set);
+    }
+
+/* empty the array first and then operate on the
+ * objects still stored in it */
 #define REMOVE_OBJS(sel,sc) \
   { \
     g_message ( \
       "%s", "clearing " #sc " selections"); \
     int num_##sc##s = sel->num_##sc##s; \
-    ArrangerObject * sc##s[num_##sc##s]; \
+    sel->num_##sc##s = 0; \
     for (i = 0; i < num_##sc##s; i++) \
       { \
-        sc##s[i] = \
+        ArrangerObject * sc = \
           (ArrangerObject *) sel->sc##s[i]; \
-      } \
-    for (i = 0; i < num_##sc##s; i++) \
-      { \
-        ArrangerObject * sc = sc##s[i]; \
-        arranger_selections_remove_object ( \
-          self, sc); \
         if (_free) \
           { \
             arranger_object_free (sc); \
@@ -1755,6 +1850,8 @@ arranger_selections_free_members (
   MidiArrangerSelections * mas;
   AutomationSelections * as;
 
+  invalidate_objects_set (self);
+
   switch (self->type)
     {
     case TYPE (TIMELINE):
@@ -1861,6 +1958,8 @@ arranger_selections_free_full (
 
 #undef FREE_OBJS
 
+  invalidate_objects_set (self);
+
   object_zero_and_free (self);
 }
 
@@ -1876,104 +1975,22 @@ arranger_selections_contains_object (
   ArrangerSelections * self,
   ArrangerObject *     obj)
 {
-  TimelineSelections * ts;
-  ChordSelections * cs;
-  MidiArrangerSelections * mas;
-  AutomationSelections * as;
-
   g_return_val_if_fail (
     IS_ARRANGER_SELECTIONS (self), 0);
 
-  switch (self->type)
+  /* velocities are selected through their midi
+   * notes */
+  if (obj->type == ARRANGER_OBJECT_TYPE_VELOCITY)
     {
-    case TYPE (TIMELINE):
-      ts = (TimelineSelections *) self;
-      switch (obj->type)
-        {
-        case ARRANGER_OBJECT_TYPE_REGION:
-          return
-            array_contains (
-              ts->regions, ts->num_regions, obj);
-          break;
-        case ARRANGER_OBJECT_TYPE_SCALE_OBJECT:
-          return
-            array_contains (
-              ts->scale_objects,
-              ts->num_scale_objects, obj);
-          break;
-        case ARRANGER_OBJECT_TYPE_MARKER:
-          return
-            array_contains (
-              ts->markers,
-              ts->num_markers, obj);
-          break;
-        default:
-          break;
-        }
-      break;
-    case TYPE (MIDI):
-      {
-        mas = (MidiArrangerSelections *) self;
-        switch (obj->type)
-          {
-          case ARRANGER_OBJECT_TYPE_VELOCITY:
-            {
-              Velocity * vel =
-                (Velocity *) obj;
-              MidiNote * mn =
-                velocity_get_midi_note (vel);
-              return
-                array_contains (
-                  mas->midi_notes,
-                  mas->num_midi_notes,
-                  mn);
-            }
-            break;
-          case ARRANGER_OBJECT_TYPE_MIDI_NOTE:
-            {
-              return
-                array_contains (
-                  mas->midi_notes,
-                  mas->num_midi_notes, obj);
-            }
-            break;
-          default:
-            g_return_val_if_reached (-1);
-          }
-      }
-      break;
-    case TYPE (AUTOMATION):
-      as = (AutomationSelections *) self;
-      switch (obj->type)
-        {
-        case ARRANGER_OBJECT_TYPE_AUTOMATION_POINT:
-          {
-            return
-              array_contains (
-                as->automation_points,
-                as->num_automation_points, obj);
-          }
-          break;
-        default:
-          g_return_val_if_reached (-1);
-        }
-      break;
-    case TYPE (CHORD):
-      cs = (ChordSelections *) self;
-      if (obj->type ==
-            ARRANGER_OBJECT_TYPE_CHORD_OBJECT)
-        {
-          return
-            array_contains (
-              cs->chord_objects,
-              cs->num_chord_objects, obj);
-        }
-      break;
-    default:
-      g_return_val_if_reached (0);
+      Velocity * vel = (Velocity *) obj;
+      obj =
+        (ArrangerObject *)
+        velocity_get_midi_note (vel);
     }
 
-  g_return_val_if_reached (0);
+  return
+    g_hash_table_contains (
+      get_objects_set (self), obj);
 }
 
 /**
@@ -2102,13 +2119,44 @@ arranger_selections_remove_object (
   MidiArrangerSelections * mas;
   AutomationSelections * as;
 
+  if (self->type == TYPE (MIDI) &&
+      obj->type == ARRANGER_OBJECT_TYPE_VELOCITY)
+    {
+      Velocity * vel = (Velocity *) obj;
+      obj =
+        (ArrangerObject *)
+        velocity_get_midi_note (vel);
+    }
+
+  /* nothing to do if not selected */
+  GHashTable * set = get_objects_set (self);
+  gpointer value;
+  if (!g_hash_table_lookup_extended (
+         set, obj, NULL, &value))
+    {
+      return;
+    }
+  g_hash_table_remove (set, obj);
+  int idx = GPOINTER_TO_INT (value) - 1;
+
+  /* move the last object into its place (the
+   * order of the objects is not kept) */
 #define REMOVE_OBJ(sel,caps,sc) \
-  if (obj->type == ARRANGER_OBJECT_TYPE_##caps && \
-      array_contains ( \
-        sel->sc##s, sel->num_##sc##s, obj)) \
+  if (obj->type == ARRANGER_OBJECT_TYPE_##caps) \
     { \
-      array_delete ( \
-        sel->sc##s, sel->num_##sc##s, obj); \
+      int last = sel->num_##sc##s - 1; \
+      g_return_if_fail ( \
+        idx <= last && \
+        (ArrangerObject *) sel->sc##s[idx] == \
+          obj); \
+      sel->sc##s[idx] = sel->sc##s[last]; \
+      sel->num_##sc##s--; \
+      if (idx < last) \
+        { \
+          g_hash_table_insert ( \
+            set, sel->sc##s[idx], \
+            GINT_TO_POINTER (idx + 1)); \
+        } \
     }
 
   switch (self->type)
@@ -2124,14 +2172,6 @@ arranger_selections_remove_object (
       break;
     case TYPE (MIDI):
       mas = (MidiArrangerSelections *) self;
-      if (obj->type ==
-            ARRANGER_OBJECT_TYPE_VELOCITY)
-        {
-          Velocity * vel = (Velocity *) obj;
-          obj =
-            (ArrangerObject *)
-            velocity_get_midi_note (vel);
-        }
       REMOVE_OBJ (
         mas, MIDI_NOTE, midi_note);
       break;
@@ -2664,19 +2704,26 @@ arranger_selections_get_all_objects (
   MidiArrangerSelections * mas;
   AutomationSelections * as;
 
+  if (self->type == TYPE (AUDIO))
+    {
+      *size = 0;
+      return NULL;
+    }
+
+  /* allocate once instead of growing the array
+   * for each object */
   ArrangerObject ** objs =
-    object_new_n (1, ArrangerObject *);
+    object_new_n (
+      (size_t)
+      MAX (
+        arranger_selections_get_num_objects (
+          self), 1),
+      ArrangerObject *);
   *size = 0;
 
 #define ADD_OBJ(sel,sc) \
   for (int i = 0; i < sel->num_##sc##s; i++) \
     { \
-      ArrangerObject ** new_objs = \
-        g_realloc ( \
-          objs, \
-          (size_t) (*size + 1) * \
-            sizeof (ArrangerObject *)); \
-      objs = new_objs; \
       objs[*size] = \
         (ArrangerObject *) sel->sc##s[i]; \
       (*size)++; \
@@ -20,6 +20,7 @@
 #include "zrythm-config.h"
 
 #include <math.h>
+#include <stdlib.h>
 
 #include "audio/audio_region.h"
 #include "audio/automation_region.h"
@@ -32,8 +33,10 @@
 #include "audio/router.h"
 #include "audio/stretcher.h"
 #include "audio/track.h"
+#include "gui/backend/arranger_object_index.h"
 #include "gui/backend/event.h"
 #include "gui/backend/event_manager.h"
+#include "gui/backend/file_manager.h"
 #include "gui/backend/clip_editor.h"
 #include "gui/backend/piano_roll.h"
 #include "gui/widgets/audio_arranger.h"
@@ -70,6 +73,7 @@
 #include "gui/widgets/monitor_section.h"
 #include "gui/widgets/midi_editor_space.h"
 #include "gui/widgets/mixer.h"
+#include "gui/widgets/panel_file_browser.h"
 #include "gui/widgets/piano_roll_keys.h"
 #include "gui/widgets/plugin_browser.h"
 #include "gui/widgets/plugin_strip_expander.h"
@@ -640,6 +644,27 @@ refresh_for_selections_type (
     }
 }
 
+/**
+ * Updates the index entries of the objects in the
+ * selections, in case their positions were changed
+ * directly.
+ */
+static void
+update_object_indices (
+  ArrangerSelections * sel)
+{
+  int size = 0;
+  ArrangerObject ** objs =
+    arranger_selections_get_all_objects (
+      sel, &size);
+  for (int i = 0; i < size; i++)
+    {
+      arranger_object_index_object_changed (
+        objs[i]);
+    }
+  free (objs);
+}
+
 static void
 on_arranger_selections_changed (
   ArrangerSelections * sel)
@@ -1261,14 +1286,23 @@ event_manager_process_event (
         ARRANGER_SELECTIONS (ev->arg));
       break;
     case ET_ARRANGER_SELECTIONS_MOVED:
+      update_object_indices (
+        ARRANGER_SELECTIONS (ev->arg));
       on_arranger_selections_moved (
         ARRANGER_SELECTIONS (ev->arg));
       break;
     case ET_ARRANGER_SELECTIONS_QUANTIZED:
+      update_object_indices (
+        ARRANGER_SELECTIONS (ev->arg));
       redraw_arranger_for_selections (
         ARRANGER_SELECTIONS (ev->arg));
       break;
     case ET_ARRANGER_SELECTIONS_ACTION_FINISHED:
+      if (ev->arg)
+        {
+          update_object_indices (
+            ARRANGER_SELECTIONS (ev->arg));
+        }
       redraw_all_arranger_bgs ();
       ruler_widget_redraw_whole (
         (RulerWidget *) MW_RULER);
@@ -1371,9 +1405,6 @@ event_manager_process_event (
       }
       break;
     case ET_TRANSPORT_TOTAL_BARS_CHANGED:
-      snap_grid_update_snap_points_default (
-        SNAP_GRID_TIMELINE);
-
       ruler_widget_refresh (
         (RulerWidget *) MW_RULER);
       ruler_widget_refresh (
@@ -1682,17 +1713,6 @@ event_manager_process_event (
       ruler_widget_refresh (EDITOR_RULER);
       gtk_widget_queue_draw (
         GTK_WIDGET (MW_DIGITAL_BPM));
-
-      /* these are only used in the UI so
-       * no need to update them during DSP */
-      snap_grid_update_snap_points_default (
-        SNAP_GRID_TIMELINE);
-      snap_grid_update_snap_points_default (
-        SNAP_GRID_EDITOR);
-      quantize_options_update_quantize_points (
-        QUANTIZE_OPTIONS_TIMELINE);
-      quantize_options_update_quantize_points (
-        QUANTIZE_OPTIONS_EDITOR);
       redraw_all_arranger_bgs ();
       break;
     case ET_CHANNEL_FADER_VAL_CHANGED:
@@ -1962,6 +1982,16 @@ event_manager_process_event (
       audio_arranger_widget_redraw_gain (
         MW_AUDIO_ARRANGER);
       break;
+    case ET_FILE_BROWSER_FILES_CHANGED:
+      file_manager_load_files (FILE_MANAGER);
+      if (MAIN_WINDOW && MW_CENTER_DOCK &&
+          MW_RIGHT_DOCK_EDGE &&
+          MW_PANEL_FILE_BROWSER)
+        {
+          panel_file_browser_refresh_files (
+            MW_PANEL_FILE_BROWSER);
+        }
+      break;
     default:
       g_warning (
         "event %d not implemented yet",
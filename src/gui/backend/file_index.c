@@ -0,0 +1,1043 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-config.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio/supported_file.h"
+#include "gui/backend/event.h"
+#include "gui/backend/event_manager.h"
+#include "gui/backend/file_index.h"
+#include "utils/audio.h"
+#include "utils/file.h"
+#include "utils/math.h"
+#include "utils/objects.h"
+#include "utils/string.h"
+#include "project.h"
+#include "zrythm.h"
+#include "zrythm_app.h"
+
+#include <glib/gstdio.h>
+
+#include <audec/audec.h>
+
+/**
+ * A directory to index.
+ */
+typedef struct FileIndexJob
+{
+  char * path;
+
+  /** Whether to also index the subdirectories. */
+  bool   recursive;
+
+  /** Whether to index the directory even if its
+   * modification time did not change. */
+  bool   force;
+} FileIndexJob;
+
+static void
+file_index_job_free (
+  FileIndexJob * job)
+{
+  g_free (job->path);
+  object_zero_and_free (job);
+}
+
+static void
+file_index_entry_free (
+  FileIndexEntry * self)
+{
+  g_free_and_null (self->name);
+  g_free_and_null (self->thumbnail);
+  g_free_and_null (self->search_key);
+
+  object_zero_and_free (self);
+}
+
+static void
+file_index_dir_free (
+  FileIndexDir * self)
+{
+  for (int i = 0; i < self->num_entries; i++)
+    {
+      file_index_entry_free (self->entries[i]);
+    }
+  object_zero_and_free_if_nonnull (self->entries);
+  g_free_and_null (self->path);
+
+  object_zero_and_free (self);
+}
+
+static gint64
+get_mtime (
+  const char * path)
+{
+  GStatBuf st;
+  if (g_stat (path, &st) != 0)
+    return -1;
+
+  return (gint64) st.st_mtime;
+}
+
+/**
+ * Queues a directory for indexing.
+ *
+ * @param priority Whether to index it before the
+ *   other queued directories. Only one such job
+ *   is queued per directory, so it should be
+ *   forced.
+ */
+static void
+queue_dir (
+  FileIndex *  self,
+  const char * path,
+  bool         recursive,
+  bool         force,
+  bool         priority)
+{
+  if (priority)
+    {
+      g_mutex_lock (&self->lock);
+      bool pending =
+        !g_hash_table_add (
+          self->pending_dirs, g_strdup (path));
+      g_mutex_unlock (&self->lock);
+      if (pending)
+        return;
+    }
+
+  FileIndexJob * job = object_new (FileIndexJob);
+  job->path = g_strdup (path);
+  job->recursive = recursive;
+  job->force = force;
+  if (priority)
+    {
+      g_async_queue_push_front (self->jobs, job);
+    }
+  else
+    {
+      g_async_queue_push (self->jobs, job);
+    }
+}
+
+/**
+ * Fills in the thumbnail with the peaks of the
+ * interleaved frames.
+ */
+static void
+set_thumbnail (
+  FileIndexEntry * entry,
+  const float *    frames,
+  size_t           num_frames,
+  int              channels)
+{
+  GString * str = g_string_new (NULL);
+  for (size_t i = 0;
+       i < SUPPORTED_FILE_THUMBNAIL_SIZE; i++)
+    {
+      size_t start =
+        (i * num_frames) /
+          SUPPORTED_FILE_THUMBNAIL_SIZE;
+      size_t end =
+        ((i + 1) * num_frames) /
+          SUPPORTED_FILE_THUMBNAIL_SIZE;
+      float peak = 0.f;
+      for (size_t j = start * (size_t) channels;
+           j < end * (size_t) channels; j++)
+        {
+          peak = MAX (peak, fabsf (frames[j]));
+        }
+      g_string_append_printf (
+        str, "%02x",
+        (unsigned int)
+        (CLAMP (peak, 0.f, 1.f) * 255.f));
+    }
+  entry->thumbnail = g_string_free (str, false);
+}
+
+/**
+ * Reads the info of the audio file and, if it is
+ * short enough, decodes it to detect the BPM and
+ * generate a thumbnail.
+ */
+static void
+read_audio_metadata (
+  FileIndexEntry * entry,
+  const char *     abs_path)
+{
+  AudecInfo nfo;
+  AudecHandle * handle = audec_open (abs_path, &nfo);
+  if (!handle)
+    {
+      g_message (
+        "%s: failed to open %s", __func__,
+        abs_path);
+      return;
+    }
+
+  entry->has_metadata = true;
+  entry->length = (gint64) nfo.length;
+  entry->channels = (int) nfo.channels;
+  entry->sample_rate = (int) nfo.sample_rate;
+  entry->bit_rate = (int) nfo.bit_rate;
+  entry->bit_depth = (int) nfo.bit_depth;
+  entry->bpm = nfo.bpm;
+
+  if (entry->length > FILE_INDEX_MAX_ANALYSIS_LENGTH ||
+      entry->channels <= 0)
+    {
+      audec_close (handle);
+      return;
+    }
+
+  float * frames = NULL;
+  ssize_t num_frames =
+    audec_read (
+      handle, &frames, (int) nfo.sample_rate);
+  audec_close (handle);
+  if (num_frames <= 0)
+    {
+      free (frames);
+      return;
+    }
+
+  set_thumbnail (
+    entry, frames, (size_t) num_frames,
+    entry->channels);
+
+  /* detect the BPM from the first channel if not
+   * tagged */
+  if (math_floats_equal (entry->bpm, 0.f))
+    {
+      float * ch_frames =
+        object_new_n ((size_t) num_frames, float);
+      for (ssize_t i = 0; i < num_frames; i++)
+        {
+          ch_frames[i] =
+            frames[i * entry->channels];
+        }
+      entry->bpm =
+        audio_detect_bpm (
+          ch_frames, (size_t) num_frames,
+          (unsigned int) nfo.sample_rate, NULL);
+      free (ch_frames);
+    }
+
+  free (frames);
+}
+
+static void
+set_search_key (
+  FileIndexEntry * entry)
+{
+  g_free (entry->search_key);
+  entry->search_key =
+    g_utf8_casefold (entry->name, -1);
+}
+
+/**
+ * Creates an entry for the given file.
+ *
+ * @return The entry, or NULL if the file could
+ *   not be queried.
+ */
+static FileIndexEntry *
+index_file (
+  const char * dir_path,
+  const char * name,
+  const FileIndexEntry * prev)
+{
+  char * abs_path =
+    g_build_filename (dir_path, name, NULL);
+  GFile * file = g_file_new_for_path (abs_path);
+  GFileInfo * info =
+    g_file_query_info (
+      file,
+      G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
+      G_FILE_ATTRIBUTE_STANDARD_IS_SYMLINK ","
+      G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+      G_FILE_ATTRIBUTE_TIME_MODIFIED,
+      G_FILE_QUERY_INFO_NONE, NULL, NULL);
+  g_object_unref (file);
+  if (!info)
+    {
+      g_message (
+        "failed to query file info for %s",
+        abs_path);
+      g_free (abs_path);
+      return NULL;
+    }
+
+  FileIndexEntry * entry =
+    object_new (FileIndexEntry);
+  entry->name = g_strdup (name);
+  entry->mtime =
+    (gint64)
+    g_file_info_get_attribute_uint64 (
+      info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+  /* force hidden if starts with . */
+  entry->hidden =
+    g_file_info_get_is_hidden (info) ||
+    name[0] == '.';
+  entry->symlink =
+    g_file_info_get_is_symlink (info);
+
+  if (g_file_info_get_file_type (info) ==
+        G_FILE_TYPE_DIRECTORY)
+    {
+      entry->type = FILE_TYPE_DIR;
+    }
+  else
+    {
+      entry->type = supported_file_get_type (name);
+    }
+  g_object_unref (info);
+
+  /* keep the metadata if the file did not
+   * change */
+  if (prev && prev->mtime == entry->mtime &&
+      prev->type == entry->type)
+    {
+      entry->has_metadata = prev->has_metadata;
+      entry->length = prev->length;
+      entry->channels = prev->channels;
+      entry->sample_rate = prev->sample_rate;
+      entry->bit_rate = prev->bit_rate;
+      entry->bit_depth = prev->bit_depth;
+      entry->bpm = prev->bpm;
+      entry->thumbnail = g_strdup (prev->thumbnail);
+      entry->needs_metadata = prev->needs_metadata;
+    }
+  else
+    {
+      /* read later, after the listing is
+       * published */
+      entry->needs_metadata =
+        supported_file_type_is_audio (entry->type);
+    }
+  set_search_key (entry);
+
+  g_free (abs_path);
+
+  return entry;
+}
+
+/**
+ * Lists the directory, reusing the entries of the
+ * previous listing for unchanged files.
+ *
+ * @return The new listing, or NULL if the
+ *   directory could not be opened.
+ */
+static FileIndexDir *
+index_dir (
+  const char *         path,
+  gint64               mtime,
+  const FileIndexDir * prev)
+{
+  GDir * gdir = g_dir_open (path, 0, NULL);
+  if (!gdir)
+    {
+      g_message ("Could not open dir %s", path);
+      return NULL;
+    }
+
+  GHashTable * prev_entries =
+    g_hash_table_new (g_str_hash, g_str_equal);
+  for (int i = 0; prev && i < prev->num_entries; i++)
+    {
+      g_hash_table_insert (
+        prev_entries, prev->entries[i]->name,
+        prev->entries[i]);
+    }
+
+  GPtrArray * entries = g_ptr_array_new ();
+  const char * name;
+  while ((name = g_dir_read_name (gdir)))
+    {
+      FileIndexEntry * entry =
+        index_file (
+          path, name,
+          g_hash_table_lookup (prev_entries, name));
+      if (entry)
+        {
+          g_ptr_array_add (entries, entry);
+        }
+    }
+  g_dir_close (gdir);
+  g_hash_table_destroy (prev_entries);
+
+  FileIndexDir * dir = object_new (FileIndexDir);
+  dir->path = g_strdup (path);
+  dir->mtime = mtime;
+  dir->num_entries = (int) entries->len;
+  dir->entries_size = entries->len;
+  dir->entries =
+    (FileIndexEntry **)
+    g_ptr_array_free (entries, false);
+
+  return dir;
+}
+
+/**
+ * Queues the directory for reading the audio
+ * metadata of its files, if any needs it.
+ */
+static void
+queue_metadata (
+  FileIndex *          self,
+  const FileIndexDir * dir)
+{
+  if (g_queue_find_custom (
+        self->metadata_dirs, dir->path,
+        (GCompareFunc) g_strcmp0))
+    return;
+
+  for (int i = 0; i < dir->num_entries; i++)
+    {
+      if (dir->entries[i]->needs_metadata)
+        {
+          g_queue_push_tail (
+            self->metadata_dirs,
+            g_strdup (dir->path));
+          return;
+        }
+    }
+}
+
+static void
+notify_if_cur_dir (
+  FileIndex *  self,
+  const char * path)
+{
+  g_mutex_lock (&self->lock);
+  bool is_cur_dir =
+    string_is_equal (self->cur_dir, path);
+  g_mutex_unlock (&self->lock);
+  if (is_cur_dir)
+    {
+      EVENTS_PUSH (
+        ET_FILE_BROWSER_FILES_CHANGED, NULL);
+    }
+}
+
+/**
+ * Reads the audio metadata of the next file in
+ * the given directory that needs it.
+ *
+ * @return Whether a file was read. If false, the
+ *   directory has no such files left.
+ */
+static bool
+read_next_metadata (
+  FileIndex *  self,
+  const char * path)
+{
+  /* only this thread changes the dirs so they
+   * can be read without locking */
+  FileIndexDir * dir =
+    g_hash_table_lookup (self->dirs, path);
+  FileIndexEntry * entry = NULL;
+  for (int i = 0; dir && i < dir->num_entries; i++)
+    {
+      if (dir->entries[i]->needs_metadata)
+        {
+          entry = dir->entries[i];
+          break;
+        }
+    }
+  if (!entry)
+    return false;
+
+  char * abs_path =
+    g_build_filename (path, entry->name, NULL);
+  FileIndexEntry tmp = { 0 };
+  read_audio_metadata (&tmp, abs_path);
+  g_free (abs_path);
+
+  g_mutex_lock (&self->lock);
+  entry->has_metadata = tmp.has_metadata;
+  entry->length = tmp.length;
+  entry->channels = tmp.channels;
+  entry->sample_rate = tmp.sample_rate;
+  entry->bit_rate = tmp.bit_rate;
+  entry->bit_depth = tmp.bit_depth;
+  entry->bpm = tmp.bpm;
+  g_free (entry->thumbnail);
+  entry->thumbnail = tmp.thumbnail;
+  entry->needs_metadata = false;
+  g_mutex_unlock (&self->lock);
+  self->dirty = true;
+
+  notify_if_cur_dir (self, path);
+
+  return true;
+}
+
+/**
+ * Queues the non-hidden subdirectories for
+ * recursive indexing.
+ */
+static void
+queue_subdirs (
+  FileIndex *          self,
+  const FileIndexDir * dir)
+{
+  for (int i = 0; i < dir->num_entries; i++)
+    {
+      const FileIndexEntry * entry =
+        dir->entries[i];
+      /* links are not followed to avoid
+       * cycles */
+      if (entry->type != FILE_TYPE_DIR ||
+          entry->hidden || entry->symlink)
+        continue;
+
+      char * path =
+        g_build_filename (
+          dir->path, entry->name, NULL);
+      queue_dir (self, path, true, false, false);
+      g_free (path);
+    }
+}
+
+static void
+process_job (
+  FileIndex *    self,
+  FileIndexJob * job)
+{
+  g_mutex_lock (&self->lock);
+  g_hash_table_remove (
+    self->pending_dirs, job->path);
+  g_mutex_unlock (&self->lock);
+
+  /* only this thread changes the dirs so they
+   * can be read without locking */
+  FileIndexDir * prev =
+    g_hash_table_lookup (self->dirs, job->path);
+  gint64 mtime = get_mtime (job->path);
+  FileIndexDir * dir = prev;
+  if (mtime < 0)
+    {
+      g_mutex_lock (&self->lock);
+      g_hash_table_remove (self->dirs, job->path);
+      g_mutex_unlock (&self->lock);
+      if (prev)
+        self->dirty = true;
+      dir = NULL;
+    }
+  else if (!prev || prev->mtime != mtime ||
+           job->force)
+    {
+      dir = index_dir (job->path, mtime, prev);
+      if (dir)
+        {
+          /* this frees the previous listing */
+          g_mutex_lock (&self->lock);
+          g_hash_table_replace (
+            self->dirs, dir->path, dir);
+          g_mutex_unlock (&self->lock);
+          self->dirty = true;
+        }
+    }
+
+  if (dir)
+    {
+      queue_metadata (self, dir);
+      if (job->recursive)
+        {
+          queue_subdirs (self, dir);
+        }
+    }
+
+  notify_if_cur_dir (self, job->path);
+}
+
+static void
+load_cache (
+  FileIndex * self)
+{
+  if (!file_exists (self->cache_path))
+    return;
+
+  char * yaml = NULL;
+  GError * err = NULL;
+  g_file_get_contents (
+    self->cache_path, &yaml, NULL, &err);
+  if (err)
+    {
+      g_warning (
+        "Failed to read file index %s: %s",
+        self->cache_path, err->message);
+      g_error_free (err);
+      return;
+    }
+
+  char version_str[120];
+  sprintf (
+    version_str, "---\nschema_version: %d\n",
+    FILE_INDEX_SCHEMA_VERSION);
+  if (!g_str_has_prefix (yaml, version_str))
+    {
+      g_message (
+        "Found old file index version. Purging "
+        "file.");
+      g_free (yaml);
+      g_unlink (self->cache_path);
+      return;
+    }
+
+  FileIndexCache * cache =
+    (FileIndexCache *)
+    yaml_deserialize (
+      yaml, &file_index_cache_schema);
+  g_free (yaml);
+  if (!cache)
+    {
+      g_warning (
+        "Failed to deserialize file index from "
+        "%s", self->cache_path);
+      return;
+    }
+
+  g_mutex_lock (&self->lock);
+  for (int i = 0; i < cache->num_dirs; i++)
+    {
+      FileIndexDir * dir = cache->dirs[i];
+      dir->entries_size = (size_t) dir->num_entries;
+      for (int j = 0; j < dir->num_entries; j++)
+        {
+          FileIndexEntry * entry = dir->entries[j];
+          set_search_key (entry);
+          entry->needs_metadata =
+            !entry->has_metadata &&
+            supported_file_type_is_audio (
+              entry->type);
+        }
+      g_hash_table_replace (
+        self->dirs, dir->path, dir);
+      queue_metadata (self, dir);
+    }
+  g_mutex_unlock (&self->lock);
+
+  g_message (
+    "Loaded %d indexed directories from %s",
+    cache->num_dirs, self->cache_path);
+
+  object_zero_and_free_if_nonnull (cache->dirs);
+  object_zero_and_free (cache);
+}
+
+static gpointer
+indexer_thread_func (
+  gpointer data)
+{
+  FileIndex * self = (FileIndex *) data;
+
+  load_cache (self);
+
+  for (;;)
+    {
+      FileIndexJob * job =
+        g_async_queue_try_pop (self->jobs);
+      if (!job)
+        {
+          /* read the metadata while no directory
+           * is waiting to be listed */
+          if (!g_queue_is_empty (self->metadata_dirs))
+            {
+              char * path =
+                g_queue_peek_head (
+                  self->metadata_dirs);
+              if (!read_next_metadata (self, path))
+                {
+                  g_queue_pop_head (
+                    self->metadata_dirs);
+                  g_free (path);
+                }
+              continue;
+            }
+
+          /* save while idle */
+          if (self->dirty)
+            {
+              file_index_save (self);
+            }
+          job = g_async_queue_pop (self->jobs);
+        }
+
+      if (g_atomic_int_get (&self->terminate))
+        {
+          file_index_job_free (job);
+          break;
+        }
+
+      process_job (self, job);
+      file_index_job_free (job);
+    }
+
+  return NULL;
+}
+
+/**
+ * Creates the index and starts the indexer
+ * thread.
+ *
+ * The cache file is loaded from the thread.
+ *
+ * @param cache_path Path to the cache file.
+ */
+FileIndex *
+file_index_new (
+  const char * cache_path)
+{
+  FileIndex * self = object_new (FileIndex);
+
+  self->cache_path = g_strdup (cache_path);
+  self->dirs =
+    g_hash_table_new_full (
+      g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) file_index_dir_free);
+  self->pending_dirs =
+    g_hash_table_new_full (
+      g_str_hash, g_str_equal, g_free, NULL);
+  self->jobs =
+    g_async_queue_new_full (
+      (GDestroyNotify) file_index_job_free);
+  self->metadata_dirs = g_queue_new ();
+  g_mutex_init (&self->lock);
+
+  self->thread =
+    g_thread_new (
+      "file-indexer", indexer_thread_func, self);
+
+  return self;
+}
+
+static SupportedFile *
+supported_file_new_from_entry (
+  const FileIndexDir *   dir,
+  const FileIndexEntry * entry)
+{
+  SupportedFile * file = object_new (SupportedFile);
+
+  file->abs_path =
+    g_build_filename (dir->path, entry->name, NULL);
+  file->label = g_strdup (entry->name);
+  file->type = entry->type;
+  file->hidden = entry->hidden;
+  file->has_metadata = entry->has_metadata;
+  file->length = (long) entry->length;
+  file->channels = entry->channels;
+  file->sample_rate = entry->sample_rate;
+  file->bit_rate = entry->bit_rate;
+  file->bit_depth = entry->bit_depth;
+  file->bpm = entry->bpm;
+  if (entry->thumbnail &&
+      strlen (entry->thumbnail) ==
+        SUPPORTED_FILE_THUMBNAIL_SIZE * 2)
+    {
+      file->has_thumbnail = true;
+      for (int i = 0;
+           i < SUPPORTED_FILE_THUMBNAIL_SIZE; i++)
+        {
+          char hex[3] = {
+            entry->thumbnail[i * 2],
+            entry->thumbnail[i * 2 + 1], '\0' };
+          file->thumbnail[i] =
+            (float) strtol (hex, NULL, 16) / 255.f;
+        }
+    }
+
+  return file;
+}
+
+/**
+ * Appends a SupportedFile for each indexed file in
+ * the given directory.
+ *
+ * If the directory is not indexed or has changed,
+ * it is queued for indexing and
+ * ET_FILE_BROWSER_FILES_CHANGED is sent when done,
+ * and again as the audio metadata of its files is
+ * read.
+ *
+ * @return Whether the directory was indexed. If
+ *   false, nothing was added.
+ */
+bool
+file_index_get_files (
+  FileIndex *  self,
+  const char * dir_path,
+  GPtrArray *  files)
+{
+  gint64 mtime = get_mtime (dir_path);
+
+  g_mutex_lock (&self->lock);
+  if (!string_is_equal (self->cur_dir, dir_path))
+    {
+      g_free (self->cur_dir);
+      self->cur_dir = g_strdup (dir_path);
+    }
+  const FileIndexDir * dir =
+    g_hash_table_lookup (self->dirs, dir_path);
+  bool indexed = dir != NULL;
+  bool stale = !dir || dir->mtime != mtime;
+  for (int i = 0; dir && i < dir->num_entries; i++)
+    {
+      g_ptr_array_add (
+        files,
+        supported_file_new_from_entry (
+          dir, dir->entries[i]));
+    }
+  g_mutex_unlock (&self->lock);
+
+  /* the stale listing is shown until the new one
+   * is ready */
+  if (stale && mtime >= 0)
+    {
+      queue_dir (self, dir_path, false, true, true);
+    }
+
+  return indexed;
+}
+
+/**
+ * Queues the given directory and all its
+ * subdirectories for indexing in the background.
+ */
+void
+file_index_add_library (
+  FileIndex *  self,
+  const char * dir_path)
+{
+  g_message (
+    "%s: indexing %s", __func__, dir_path);
+  queue_dir (self, dir_path, true, false, false);
+}
+
+static void
+on_monitor_changed (
+  GFileMonitor *    monitor,
+  GFile *           file,
+  GFile *           other_file,
+  GFileMonitorEvent event_type,
+  FileIndex *       self)
+{
+  switch (event_type)
+    {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+    case G_FILE_MONITOR_EVENT_MOVED_OUT:
+    case G_FILE_MONITOR_EVENT_RENAMED:
+      /* files may change without changing the
+       * modification time of the directory */
+      queue_dir (
+        self, self->monitored_dir, false, true,
+        true);
+      break;
+    default:
+      break;
+    }
+}
+
+/**
+ * Re-indexes the given directory when its
+ * contents change.
+ *
+ * Only one directory is watched at a time.
+ */
+void
+file_index_watch_dir (
+  FileIndex *  self,
+  const char * dir_path)
+{
+  if (string_is_equal (
+        self->monitored_dir, dir_path))
+    return;
+
+  object_free_w_func_and_null (
+    g_object_unref, self->monitor);
+  g_free_and_null (self->monitored_dir);
+
+  GFile * file = g_file_new_for_path (dir_path);
+  GError * err = NULL;
+  self->monitor =
+    g_file_monitor_directory (
+      file, G_FILE_MONITOR_WATCH_MOVES, NULL,
+      &err);
+  g_object_unref (file);
+  if (!self->monitor)
+    {
+      g_message (
+        "Failed to monitor %s: %s",
+        dir_path, err->message);
+      g_error_free (err);
+      return;
+    }
+
+  self->monitored_dir = g_strdup (dir_path);
+  g_signal_connect (
+    self->monitor, "changed",
+    G_CALLBACK (on_monitor_changed), self);
+}
+
+/**
+ * Returns the indexed files whose name contains
+ * the given string, ignoring case.
+ *
+ * @param max_results Maximum number of results,
+ *   or -1 for no limit.
+ *
+ * @return A new array of SupportedFile.
+ */
+GPtrArray *
+file_index_search (
+  FileIndex *  self,
+  const char * query,
+  int          max_results)
+{
+  GPtrArray * files =
+    g_ptr_array_new_with_free_func (
+      (GDestroyNotify) supported_file_free);
+  char * key = g_utf8_casefold (query, -1);
+
+  g_mutex_lock (&self->lock);
+  GHashTableIter iter;
+  gpointer val;
+  g_hash_table_iter_init (&iter, self->dirs);
+  while (g_hash_table_iter_next (&iter, NULL, &val))
+    {
+      const FileIndexDir * dir =
+        (const FileIndexDir *) val;
+      for (int i = 0; i < dir->num_entries; i++)
+        {
+          const FileIndexEntry * entry =
+            dir->entries[i];
+          if (entry->type == FILE_TYPE_DIR ||
+              !strstr (entry->search_key, key))
+            continue;
+
+          g_ptr_array_add (
+            files,
+            supported_file_new_from_entry (
+              dir, entry));
+          if (max_results >= 0 &&
+              (int) files->len >= max_results)
+            goto done;
+        }
+    }
+done:
+  g_mutex_unlock (&self->lock);
+
+  g_free (key);
+
+  return files;
+}
+
+/**
+ * Saves the index to the cache file.
+ *
+ * Must only be called from the indexer thread or
+ * after it stopped.
+ */
+void
+file_index_save (
+  FileIndex * self)
+{
+  /* the dirs are only changed by the indexer so
+   * they can be read without locking */
+  FileIndexCache cache = {
+    .schema_version = FILE_INDEX_SCHEMA_VERSION,
+  };
+  cache.dirs_size =
+    (size_t) g_hash_table_size (self->dirs);
+  cache.dirs =
+    object_new_n (cache.dirs_size, FileIndexDir *);
+  GHashTableIter iter;
+  gpointer val;
+  g_hash_table_iter_init (&iter, self->dirs);
+  while (g_hash_table_iter_next (&iter, NULL, &val))
+    {
+      cache.dirs[cache.num_dirs++] =
+        (FileIndexDir *) val;
+    }
+
+  char * yaml =
+    yaml_serialize (
+      &cache, &file_index_cache_schema);
+  object_zero_and_free_if_nonnull (cache.dirs);
+  g_return_if_fail (yaml);
+
+  GError * err = NULL;
+  if (!g_file_set_contents (
+         self->cache_path, yaml, -1, &err))
+    {
+      g_warning (
+        "Unable to write file index to %s: %s",
+        self->cache_path, err->message);
+      g_error_free (err);
+    }
+  else
+    {
+      self->dirty = false;
+    }
+  g_free (yaml);
+}
+
+/**
+ * Stops the thread, saves and frees the index.
+ */
+void
+file_index_free (
+  FileIndex * self)
+{
+  object_free_w_func_and_null (
+    g_object_unref, self->monitor);
+
+  /* wake up the thread with a dummy job */
+  g_atomic_int_set (&self->terminate, 1);
+  FileIndexJob * job = object_new (FileIndexJob);
+  g_async_queue_push_front (self->jobs, job);
+  g_thread_join (self->thread);
+
+  if (self->dirty)
+    {
+      file_index_save (self);
+    }
+
+  g_async_queue_unref (self->jobs);
+  g_queue_free_full (self->metadata_dirs, g_free);
+  g_hash_table_destroy (self->dirs);
+  g_hash_table_destroy (self->pending_dirs);
+  g_mutex_clear (&self->lock);
+  g_free_and_null (self->cur_dir);
+  g_free_and_null (self->monitored_dir);
+  g_free_and_null (self->cache_path);
+
+  object_zero_and_free (self);
+}
@@ -21,6 +21,7 @@
 #include <string.h>
 
 #include "audio/supported_file.h"
+#include "gui/backend/file_index.h"
 #include "gui/backend/file_manager.h"
 #include "settings/settings.h"
 #include "utils/arrays.h"
@@ -50,6 +51,15 @@ file_manager_new (void)
     g_ptr_array_new_with_free_func (
       (GDestroyNotify) file_browser_location_free);
 
+  char * zrythm_dir =
+    zrythm_get_dir (ZRYTHM_DIR_USER_TOP);
+  char * index_path =
+    g_build_filename (
+      zrythm_dir, FILE_INDEX_FILENAME, NULL);
+  self->index = file_index_new (index_path);
+  g_free (zrythm_dir);
+  g_free (index_path);
+
   /* add standard locations */
   FileBrowserLocation * fl =
     file_browser_location_new ();
@@ -90,6 +100,9 @@ file_manager_new (void)
           fl->special_location =
             FILE_MANAGER_NONE;
           g_ptr_array_add (self->locations, fl);
+
+          file_index_add_library (
+            self->index, bookmark);
         }
       g_strfreev (bookmarks);
 
@@ -125,20 +138,25 @@ alphaBetize (const void * _a,
   return -strcmp(a->label, b->label); /* aka: return strcmp(b, a); */
 }
 
+/**
+ * Loads the files from the index.
+ *
+ * If the location is not indexed yet, only the
+ * parent dir entry is added and the files are
+ * reloaded when the indexer is done.
+ */
 static void
 load_files_from_location (
   FileManager *         self,
   FileBrowserLocation * location)
 {
-  const gchar * file;
   SupportedFile * fd;
 
   g_ptr_array_remove_range (
     self->files, 0, self->files->len);
 
-  GDir * dir =
-    g_dir_open (location->path, 0, NULL);
-  if (!dir)
+  if (!g_file_test (
+         location->path, G_FILE_TEST_IS_DIR))
     {
       g_warning ("Could not open dir %s",
                  location->path);
@@ -166,64 +184,10 @@ load_files_from_location (
       fd = NULL;
     }
 
-  while ((file = g_dir_read_name (dir)))
-    {
-      fd = object_new (SupportedFile);
-      /*fd->dnd_type = UI_DND_TYPE_FILE_DESCRIPTOR;*/
-
-      /* set absolute path & label */
-      char * absolute_path =
-        g_strdup_printf (
-          "%s%s%s",
-          strlen (location->path) == 1 ?
-            "" : location->path,
-          G_DIR_SEPARATOR_S, file);
-      fd->abs_path = absolute_path;
-      fd->label = g_strdup (file);
-
-      GError * err = NULL;
-      GFile * gfile =
-        g_file_new_for_path (absolute_path);
-      GFileInfo * info =
-        g_file_query_info (
-          gfile, G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN,
-          G_FILE_QUERY_INFO_NONE, NULL, &err);
-      if (err)
-        {
-          g_warning (
-            "failed to query file info for %s",
-            absolute_path);
-        }
-      else
-        {
-          fd->hidden =
-            g_file_info_get_is_hidden (info);
-          g_object_unref (info);
-        }
-      g_object_unref (gfile);
-
-      /* set type */
-      if (g_file_test (
-            absolute_path, G_FILE_TEST_IS_DIR))
-        {
-          fd->type = FILE_TYPE_DIR;
-        }
-      else
-        {
-          fd->type = supported_file_get_type (file);
-        }
-
-      /* force hidden if starts with . */
-      if (file[0] == '.')
-        fd->hidden = true;
-
-      g_ptr_array_add (self->files, fd);
-      /*g_message ("File found: %s (%d - %d)",*/
-                 /*fd->abs_path,*/
-                 /*fd->type,*/
-                 /*fd->hidden);*/
-    }
-  g_dir_close (dir);
+  file_index_get_files (
+    self->index, location->path, self->files);
+  file_index_watch_dir (
+    self->index, location->path);
 
   g_ptr_array_sort (
     self->files, (GCompareFunc) alphaBetize);
@@ -330,6 +294,8 @@ file_manager_add_location_and_save (
   g_ptr_array_add (self->locations, loc);
 
   save_locations (self);
+
+  file_index_add_library (self->index, abs_path);
 }
 
 /**
@@ -387,6 +353,10 @@ file_manager_free (
 {
   g_ptr_array_free (self->files, true);
   g_ptr_array_free (self->locations, true);
+  object_free_w_func_and_null (
+    file_index_free, self->index);
+  object_free_w_func_and_null (
+    file_browser_location_free, self->selection);
 
   object_zero_and_free (self);
 }
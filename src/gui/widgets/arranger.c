@@ -31,6 +31,7 @@
 #include "audio/midi_region.h"
 #include "audio/track.h"
 #include "audio/transport.h"
+#include "gui/backend/arranger_object_index.h"
 #include "gui/backend/event.h"
 #include "gui/backend/event_manager.h"
 #include "gui/widgets/arranger.h"
@@ -69,6 +70,7 @@
 #include "gui/widgets/timeline_ruler.h"
 #include "gui/widgets/track.h"
 #include "gui/widgets/tracklist.h"
+#include "gui/widgets/velocity.h"
 #include "project.h"
 #include "settings/settings.h"
 #include "utils/arrays.h"
@@ -399,6 +401,121 @@ get_regions_in_editor_rect (
 }
 #endif
 
+/**
+ * Returns the extent of the object as drawn, in
+ * ticks, in the same frame of reference as its
+ * positions.
+ *
+ * Objects without length are still drawn past
+ * their position (labels, automation curves,
+ * drum hits centered on the note start, etc.),
+ * so the parts drawn in pixels are converted to
+ * ticks at the current zoom level, with 1 pixel
+ * of margin for rounding.
+ *
+ * Used as an ArrangerObjectIndexExtentFunc.
+ */
+static void
+get_object_extent_ticks (
+  ArrangerObject * obj,
+  double *         start_ticks,
+  double *         end_ticks,
+  void *           user_data)
+{
+  ArrangerWidget * self =
+    (ArrangerWidget *) user_data;
+  RulerWidget * ruler =
+    arranger_widget_get_ruler (self);
+  double ticks_per_px =
+    ruler->px_per_tick > 0.0 ?
+      1.0 / ruler->px_per_tick : 0.0;
+
+  double pos_ticks = obj->pos.ticks;
+  *start_ticks = pos_ticks;
+  *end_ticks =
+    arranger_object_type_has_length (obj->type) ?
+      obj->end_pos.ticks : pos_ticks;
+
+  double half_width_px = 0.0;
+  switch (obj->type)
+    {
+    case ARRANGER_OBJECT_TYPE_MIDI_NOTE:
+      if (self->type == TYPE (MIDI_MODIFIER))
+        {
+          /* the index of the velocity arranger
+           * holds the notes of the velocities,
+           * which are centered on the note start */
+          half_width_px = VELOCITY_WIDTH / 2.0;
+          *end_ticks = pos_ticks;
+        }
+      else
+        {
+          /* drum mode notes are drawn centered on
+           * the note start */
+          half_width_px =
+            (MW_PIANO_ROLL_KEYS->px_per_key + 1.0) /
+              2.0;
+        }
+      break;
+    case ARRANGER_OBJECT_TYPE_VELOCITY:
+      {
+        MidiNote * mn =
+          velocity_get_midi_note (
+            (Velocity *) obj);
+        g_return_if_fail (IS_MIDI_NOTE (mn));
+        pos_ticks = mn->base.pos.ticks;
+        *start_ticks = pos_ticks;
+        *end_ticks = pos_ticks;
+        half_width_px = VELOCITY_WIDTH / 2.0;
+      }
+      break;
+    case ARRANGER_OBJECT_TYPE_AUTOMATION_POINT:
+      {
+        /* the curve is drawn up to the next
+         * point */
+        ZRegion * r =
+          arranger_object_get_region (obj);
+        g_return_if_fail (
+          IS_REGION_AND_NONNULL (r));
+        AutomationPoint * next_ap =
+          automation_region_get_next_ap (
+            r, (AutomationPoint *) obj, false,
+            false);
+        if (next_ap)
+          {
+            *end_ticks =
+              MAX (
+                pos_ticks,
+                next_ap->base.pos.ticks);
+          }
+        half_width_px = AP_WIDGET_POINT_SIZE / 2.0;
+      }
+      break;
+    case ARRANGER_OBJECT_TYPE_CHORD_OBJECT:
+    case ARRANGER_OBJECT_TYPE_SCALE_OBJECT:
+    case ARRANGER_OBJECT_TYPE_MARKER:
+      /* labels start at the position */
+      arranger_object_set_full_rectangle (
+        obj, self);
+      *end_ticks =
+        pos_ticks +
+        (obj->full_rect.width + 1) * ticks_per_px;
+      break;
+    default:
+      break;
+    }
+
+  if (half_width_px > 0.0)
+    {
+      double half_width_ticks =
+        (half_width_px + 1.0) * ticks_per_px;
+      *start_ticks = pos_ticks - half_width_ticks;
+      *end_ticks =
+        MAX (
+          *end_ticks, pos_ticks + half_width_ticks);
+    }
+}
+
 typedef struct ObjectOverlapInfo
 {
   /**
@@ -428,9 +545,41 @@ typedef struct ObjectOverlapInfo
 
   ArrangerObject **  array;
   int *              array_size;
+
+  /** Array to append to instead of \ref array,
+   * if not NULL. */
+  GPtrArray *        ptr_array;
+
   ArrangerObject *   obj;
+
+  /** Arranger being checked. */
+  ArrangerWidget *   arranger;
+
+  /** Track of the regions being checked, if
+   * checking regions. */
+  Track *            track;
 } ObjectOverlapInfo;
 
+/**
+ * Adds the given object to the array being
+ * filled.
+ */
+static inline void
+add_hit_object (
+  ObjectOverlapInfo * nfo,
+  ArrangerObject *    obj)
+{
+  if (nfo->ptr_array)
+    {
+      g_ptr_array_add (nfo->ptr_array, obj);
+    }
+  else
+    {
+      nfo->array[*nfo->array_size] = obj;
+      (*nfo->array_size)++;
+    }
+}
+
 /**
  * Adds the object to the array if it or its
  * transient overlaps with the rectangle, or with
@@ -447,8 +596,6 @@ add_object_if_overlap (
   GdkRectangle * rect = nfo->rect;
   double x = nfo->x;
   double y = nfo->y;
-  ArrangerObject ** array = nfo->array;
-  int * array_size = nfo->array_size;
   ArrangerObject * obj = nfo->obj;
 
   g_return_val_if_fail (
@@ -463,64 +610,40 @@ add_object_if_overlap (
       return false;
     }
 
+  /* check this before getting the drawn extent,
+   * which sets the full rectangle for this
+   * arranger */
+  bool is_same_arranger =
+    arranger_object_get_arranger (obj) == self;
+  if (!is_same_arranger)
+    return false;
+
   /* --- optimization to skip expensive
    * calculations for most objects --- */
 
-  /* skip objects that end before the rect */
-  Position tmp;
-  if (arranger_object_type_has_length (obj->type))
-    {
-      if (arranger_object_type_has_global_pos (
-            obj->type))
-        {
-          tmp = obj->end_pos;
-        }
-      else
-        {
-          ZRegion * r =
-            arranger_object_get_region (obj);
-          g_return_val_if_fail (
-            IS_REGION_AND_NONNULL (r), false);
-          tmp = r->base.pos;
-          position_add_ticks (
-            &tmp, obj->end_pos.ticks);
-        }
-      if (position_is_before (
-            &tmp, &nfo->start_pos))
-        {
-          return false;
-        }
-    }
-
-  /* skip objects that start after the end */
-  if (arranger_object_type_has_global_pos (
-        obj->type))
-    {
-      tmp = obj->pos;
-    }
-  else
+  /* skip objects that are drawn entirely before
+   * or after the range */
+  double start_ticks, end_ticks;
+  get_object_extent_ticks (
+    obj, &start_ticks, &end_ticks, self);
+  if (!arranger_object_type_has_global_pos (
+         obj->type))
     {
       ZRegion * r =
         arranger_object_get_region (obj);
       g_return_val_if_fail (
         IS_REGION_AND_NONNULL (r), false);
-      tmp = r->base.pos;
-      position_add_ticks (
-        &tmp, obj->pos.ticks);
+      start_ticks += r->base.pos.ticks;
+      end_ticks += r->base.pos.ticks;
     }
-  if (position_is_after (
-        &obj->pos, &nfo->end_pos))
+  if (end_ticks < nfo->start_pos.ticks ||
+      start_ticks > nfo->end_pos.ticks)
     {
       return false;
     }
 
   /* --- end optimization --- */
 
-  bool is_same_arranger =
-    arranger_object_get_arranger (obj) == self;
-  if (!is_same_arranger)
-    return false;
-
   arranger_object_set_full_rectangle (obj, self);
   bool add = false;
   if (rect)
@@ -585,13 +708,177 @@ add_object_if_overlap (
 
   if (add)
     {
-      array[*array_size] = obj;
-      (*array_size)++;
+      add_hit_object (nfo, obj);
     }
 
   return add;
 }
 
+/**
+ * Callback for arranger_object_index_foreach_in_range().
+ */
+static void
+add_indexed_object_if_overlap (
+  ArrangerObject * obj,
+  void *           data)
+{
+  ObjectOverlapInfo * nfo =
+    (ObjectOverlapInfo *) data;
+  nfo->obj = obj;
+  add_object_if_overlap (nfo->arranger, nfo);
+}
+
+/**
+ * Adds the note's velocity to the array if it
+ * overlaps.
+ */
+static void
+add_velocity_if_overlap (
+  ArrangerObject * obj,
+  void *           data)
+{
+  MidiNote * mn = (MidiNote *) obj;
+  g_return_if_fail (IS_MIDI_NOTE (mn));
+  Velocity * vel = mn->vel;
+  g_return_if_fail (IS_ARRANGER_OBJECT (vel));
+  add_indexed_object_if_overlap (
+    (ArrangerObject *) vel, data);
+}
+
+/**
+ * Adds the region to the array if it overlaps,
+ * also checking its lane if lanes are visible.
+ */
+static void
+add_region_if_overlap (
+  ArrangerObject * obj,
+  void *           data)
+{
+  ObjectOverlapInfo * nfo =
+    (ObjectOverlapInfo *) data;
+  ArrangerWidget * self = nfo->arranger;
+  Track * track = nfo->track;
+  GdkRectangle * rect = nfo->rect;
+
+  ZRegion * r = (ZRegion *) obj;
+  g_warn_if_fail (IS_REGION (r));
+  nfo->obj = obj;
+  bool ret = add_object_if_overlap (self, nfo);
+  if (ret)
+    return;
+
+  /* check lanes */
+  if (!track->lanes_visible)
+    return;
+  GdkRectangle lane_rect;
+  region_get_lane_full_rect (r, &lane_rect);
+  if (((rect &&
+        ui_rectangle_overlap (&lane_rect, rect)) ||
+       (!rect &&
+        ui_is_point_in_rect_hit (
+          &lane_rect, true, true, nfo->x, nfo->y,
+          0, 0))) &&
+      arranger_object_get_arranger (obj) == self &&
+      !obj->deleted_temporarily)
+    {
+      add_hit_object (nfo, obj);
+    }
+}
+
+/**
+ * Returns whether the object indices should be
+ * used for hit-testing.
+ *
+ * While objects are being edited their positions
+ * change on every motion event, so a plain scan is
+ * cheaper than rebuilding the indices each time.
+ */
+static bool
+should_use_object_indices (
+  ArrangerWidget * self)
+{
+  switch (self->action)
+    {
+    case UI_OVERLAY_ACTION_NONE:
+    case UI_OVERLAY_ACTION_STARTING_SELECTION:
+    case UI_OVERLAY_ACTION_SELECTING:
+    case UI_OVERLAY_ACTION_STARTING_DELETE_SELECTION:
+    case UI_OVERLAY_ACTION_DELETE_SELECTING:
+      return true;
+    default:
+      break;
+    }
+  return false;
+}
+
+/**
+ * Calls \ref func for each of the given objects
+ * that may overlap with the range in \ref nfo,
+ * using the index if possible.
+ *
+ * @param container The object owning the array
+ *   (lane, region, etc.), used as the index key.
+ * @param offset_ticks Ticks to subtract from the
+ *   range for objects with local positions (the
+ *   region start), or 0.
+ * @param by_pitch Whether to index MIDI notes by
+ *   pitch.
+ */
+static void
+foreach_object_in_range (
+  ArrangerWidget *        self,
+  ObjectOverlapInfo *     nfo,
+  const void *            container,
+  ArrangerObject **       objs,
+  int                     num_objs,
+  double                  offset_ticks,
+  bool                    by_pitch,
+  int                     min_pitch,
+  int                     max_pitch,
+  ArrangerObjectIndexFunc func)
+{
+  if (num_objs == 0)
+    return;
+
+  if (!should_use_object_indices (self))
+    {
+      for (int i = 0; i < num_objs; i++)
+        {
+          func (objs[i], nfo);
+        }
+      return;
+    }
+
+  /* drop the indices if the zoom level changed,
+   * since the extents include parts drawn in
+   * pixels */
+  RulerWidget * ruler =
+    arranger_widget_get_ruler (self);
+  double px_per_key =
+    self->type == TYPE (MIDI) ?
+      MW_PIANO_ROLL_KEYS->px_per_key : 0.0;
+  if (!math_doubles_equal (
+         ruler->px_per_tick,
+         self->obj_indices_px_per_tick) ||
+      !math_doubles_equal (
+         px_per_key,
+         self->obj_indices_px_per_key))
+    {
+      arranger_object_index_cache_clear (
+        self->obj_index_cache);
+      self->obj_indices_px_per_tick =
+        ruler->px_per_tick;
+      self->obj_indices_px_per_key = px_per_key;
+    }
+
+  arranger_object_index_cache_foreach_in_range (
+    self->obj_index_cache, container, objs,
+    num_objs, by_pitch,
+    nfo->start_pos.ticks - offset_ticks,
+    nfo->end_pos.ticks - offset_ticks,
+    min_pitch, max_pitch, func, nfo);
+}
+
 /**
  * Fills in the given array with the
  * ArrangerObject's of the given type that appear
@@ -605,6 +892,8 @@ add_object_if_overlap (
  * @param y Y, or -1 to not check y.
  * @param array The array to fill.
  * @param array_size The size of the array to fill.
+ * @param ptr_array A GPtrArray to append to
+ *   instead of \ref array, or NULL.
  */
 static void
 get_hit_objects (
@@ -614,11 +903,16 @@ get_hit_objects (
   double             x,
   double             y,
   ArrangerObject **  array,
-  int *              array_size)
+  int *              array_size,
+  GPtrArray *        ptr_array)
 {
-  g_return_if_fail (self && array);
+  g_return_if_fail (
+    self && (ptr_array || (array && array_size)));
 
-  *array_size = 0;
+  if (array_size)
+    {
+      *array_size = 0;
+    }
   ArrangerObject * obj = NULL;
 
   /* skip if haven't drawn yet */
@@ -648,6 +942,9 @@ get_hit_objects (
     }
   nfo.array = array;
   nfo.array_size = array_size;
+  nfo.ptr_array = ptr_array;
+  nfo.arranger = self;
+  nfo.track = NULL;
 
   switch (self->type)
     {
@@ -730,66 +1027,28 @@ get_hit_objects (
                     }
                 }
 
+              nfo.track = track;
               for (int j = 0;
                    j < track->num_lanes; j++)
                 {
                   TrackLane * lane =
                     track->lanes[j];
-                  for (int k = 0;
-                       k < lane->num_regions;
-                       k++)
-                    {
-                      ZRegion *r =
-                        lane->regions[k];
-                      g_warn_if_fail (
-                        IS_REGION (r));
-                      obj =
-                        (ArrangerObject *) r;
-                      nfo.obj = obj;
-                      bool ret =
-                        add_object_if_overlap (
-                          self, &nfo);
-                      if (!ret)
-                        {
-                          /* check lanes */
-                          if (!track->
-                                lanes_visible)
-                            continue;
-                          GdkRectangle lane_rect;
-                          region_get_lane_full_rect (
-                            lane->regions[k],
-                            &lane_rect);
-                          if (((rect &&
-                               ui_rectangle_overlap (
-                                &lane_rect,
-                                rect)) ||
-                               (!rect &&
-                                ui_is_point_in_rect_hit (
-                                  &lane_rect,
-                                  true, true, x, y,
-                                  0, 0))) &&
-                              arranger_object_get_arranger (obj) ==  self &&
-                              !obj->deleted_temporarily)
-                            {
-                              array[*array_size] =
-                                obj;
-                              (*array_size)++;
-                            }
-                        }
-                    }
+                  foreach_object_in_range (
+                    self, &nfo, lane,
+                    (ArrangerObject **)
+                    lane->regions,
+                    lane->num_regions, 0, false,
+                    0, 0, add_region_if_overlap);
                 }
 
               /* chord regions */
-              for (int j = 0;
-                   j < track->num_chord_regions;
-                   j++)
-                {
-                  ZRegion * cr =
-                    track->chord_regions[j];
-                  obj = (ArrangerObject *) cr;
-                  nfo.obj = obj;
-                  add_object_if_overlap (self, &nfo);
-                }
+              foreach_object_in_range (
+                self, &nfo, track,
+                (ArrangerObject **)
+                track->chord_regions,
+                track->num_chord_regions, 0,
+                false, 0, 0,
+                add_indexed_object_if_overlap);
 
               /* automation regions */
               AutomationTracklist * atl =
@@ -808,17 +1067,13 @@ get_hit_objects (
                       if (!at->visible)
                         continue;
 
-                      for (int k = 0;
-                           k < at->num_regions;
-                           k++)
-                        {
-                          obj =
-                            (ArrangerObject *)
-                            at->regions[k];
-                          nfo.obj = obj;
-                          add_object_if_overlap (
-                            self, &nfo);
-                        }
+                      foreach_object_in_range (
+                        self, &nfo, at,
+                        (ArrangerObject **)
+                        at->regions,
+                        at->num_regions, 0, false,
+                        0, 0,
+                        add_indexed_object_if_overlap);
                     }
                 }
             }
@@ -868,16 +1123,46 @@ get_hit_objects (
           if (!r)
             break;
 
-          for (int i = 0; i < r->num_midi_notes;
-               i++)
+          /* only check the pitches in range (with
+           * 1 key of margin for rounding). in drum
+           * mode the rows are not in pitch order, so
+           * check all pitches */
+          Track * track =
+            arranger_object_get_track (
+              (ArrangerObject *) r);
+          bool drum_mode =
+            track && track->drum_mode;
+          int min_pitch = 0;
+          int max_pitch = 127;
+          double px_per_key =
+            MW_PIANO_ROLL_KEYS->px_per_key + 1.0;
+          if (rect && !drum_mode)
             {
-              MidiNote * mn = r->midi_notes[i];
-              obj =
-                (ArrangerObject *)
-                mn;
-              nfo.obj = obj;
-              add_object_if_overlap (self, &nfo);
+              max_pitch =
+                127 -
+                (int) ((double) rect->y / px_per_key)
+                + 1;
+              min_pitch =
+                127 -
+                (int)
+                ((double) (rect->y + rect->height) /
+                   px_per_key)
+                - 1;
+            }
+          else if (y >= 0.0 && !drum_mode)
+            {
+              max_pitch =
+                127 - (int) (y / px_per_key) + 1;
+              min_pitch = max_pitch - 2;
             }
+
+          foreach_object_in_range (
+            self, &nfo, r,
+            (ArrangerObject **) r->midi_notes,
+            r->num_midi_notes,
+            r->base.pos.ticks, true,
+            min_pitch, max_pitch,
+            add_indexed_object_if_overlap);
         }
       break;
     case TYPE (MIDI_MODIFIER):
@@ -890,19 +1175,14 @@ get_hit_objects (
           if (!r)
             break;
 
-          for (int i = 0; i < r->num_midi_notes;
-               i++)
-            {
-              MidiNote * mn = r->midi_notes[i];
-              g_return_if_fail (
-                IS_MIDI_NOTE (mn));
-              Velocity * vel = mn->vel;
-              g_return_if_fail (
-                IS_ARRANGER_OBJECT (vel));
-              obj = (ArrangerObject *) vel;
-              nfo.obj = obj;
-              add_object_if_overlap (self, &nfo);
-            }
+          /* velocities have the same positions
+           * as their notes */
+          foreach_object_in_range (
+            self, &nfo, r,
+            (ArrangerObject **) r->midi_notes,
+            r->num_midi_notes,
+            r->base.pos.ticks, false, 0, 0,
+            add_velocity_if_overlap);
         }
       break;
     case TYPE (CHORD):
@@ -915,16 +1195,16 @@ get_hit_objects (
           if (!r)
             break;
 
-          for (int i = 0; i < r->num_chord_objects;
-               i++)
+          /* chord objects are not indexed since
+           * their label width depends on the chord
+           * descriptor, which can change without
+           * the object changing */
+          for (int i = 0;
+               i < r->num_chord_objects; i++)
             {
-              ChordObject * co =
-                r->chord_objects[i];
               obj =
-                (ArrangerObject *) co;
-              g_return_if_fail (
-                co->chord_index <
-                CHORD_EDITOR->num_chords);
+                (ArrangerObject *)
+                r->chord_objects[i];
               nfo.obj = obj;
               add_object_if_overlap (self, &nfo);
             }
@@ -940,13 +1220,12 @@ get_hit_objects (
           if (!r)
             break;
 
-          for (int i = 0; i < r->num_aps; i++)
-            {
-              AutomationPoint * ap =  r->aps[i];
-              obj = (ArrangerObject *) ap;
-              nfo.obj = obj;
-              add_object_if_overlap (self, &nfo);
-            }
+          foreach_object_in_range (
+            self, &nfo, r,
+            (ArrangerObject **) r->aps,
+            r->num_aps, r->base.pos.ticks,
+            false, 0, 0,
+            add_indexed_object_if_overlap);
         }
       break;
     case TYPE (AUDIO):
@@ -978,7 +1257,8 @@ arranger_widget_get_hit_objects_in_rect (
   int *              array_size)
 {
   get_hit_objects (
-    self, type, rect, 0, 0, array, array_size);
+    self, type, rect, 0, 0, array, array_size,
+    NULL);
 }
 
 /**
@@ -1035,7 +1315,8 @@ arranger_widget_get_hit_objects_at_point (
   int *              array_size)
 {
   get_hit_objects (
-    self, type, NULL, x, y, array, array_size);
+    self, type, NULL, x, y, array, array_size,
+    NULL);
 }
 
 /**
@@ -1335,19 +1616,12 @@ arranger_widget_select_all (
 
   if (select)
     {
-      /* TODO move array to ArrangerWidget struct
-       * and allocate a large value dynamically
-       * during initialization */
-      ArrangerObject * objs[10000];
-      int num_objs = 0;
-      arranger_widget_get_all_objects (
-        self, objs, &num_objs);
-      for (int i = 0; i < num_objs; i++)
-        {
-          arranger_object_select (
-            objs[i], F_SELECT, F_APPEND,
-            F_NO_PUBLISH_EVENTS);
-        }
+      GPtrArray * objs =
+        arranger_widget_get_all_objects (self);
+      arranger_selections_add_objects (
+        sel, (ArrangerObject **) objs->pdata,
+        (int) objs->len);
+      g_ptr_array_unref (objs);
 
       if (fire_events)
         {
@@ -2992,6 +3266,74 @@ drag_begin (
   g_debug ("arranger drag begin done");
 }
 
+/**
+ * Selects the given objects, or adds them to the
+ * selections to delete if this is a select-delete
+ * operation.
+ *
+ * @param sel The selections to add the objects to
+ *   if not deleting.
+ */
+static void
+select_or_mark_objects_for_deletion (
+  ArrangerWidget *     self,
+  ArrangerSelections * sel,
+  ArrangerObject **    objs,
+  int                  num_objs,
+  bool                 delete)
+{
+  if (delete)
+    {
+      for (int i = 0; i < num_objs; i++)
+        {
+          ArrangerObject * obj = objs[i];
+          if (!arranger_object_is_deletable (obj))
+            continue;
+
+          arranger_selections_add_object (
+            self->sel_to_delete, obj);
+          obj->deleted_temporarily = true;
+        }
+    }
+  else
+    {
+      arranger_selections_add_objects (
+        sel, objs, num_objs);
+    }
+}
+
+/**
+ * Selects the objects of the given type in the
+ * given rectangle, or marks them for deletion if
+ * this is a select-delete operation.
+ *
+ * @param ignore_frozen Ignore frozen objects.
+ */
+static void
+select_or_mark_objects_in_rect (
+  ArrangerWidget *     self,
+  ArrangerSelections * sel,
+  ArrangerObjectType   type,
+  GdkRectangle *       rect,
+  bool                 ignore_frozen,
+  bool                 delete)
+{
+  GPtrArray * objs = g_ptr_array_new ();
+  get_hit_objects (
+    self, type, rect, 0, 0, NULL, NULL, objs);
+  int num_objs = (int) objs->len;
+  if (ignore_frozen)
+    {
+      filter_out_frozen_objects (
+        self, (ArrangerObject **) objs->pdata,
+        &num_objs);
+    }
+  select_or_mark_objects_for_deletion (
+    self, sel, (ArrangerObject **) objs->pdata,
+    num_objs, delete);
+  g_ptr_array_unref (objs);
+}
+
 /**
  * Selects objects for the given arranger in the
  * range from start_* to offset_*.
@@ -3049,8 +3391,6 @@ select_in_range (
         }
     }
 
-  ArrangerObject * objs[800];
-  int              num_objs = 0;
   GdkRectangle rect;
   if (in_range)
     {
@@ -3089,198 +3429,46 @@ select_in_range (
   switch (self->type)
     {
     case TYPE (CHORD):
-      arranger_widget_get_hit_objects_in_rect (
-        self, ARRANGER_OBJECT_TYPE_CHORD_OBJECT,
-        &rect, objs, &num_objs);
-      if (ignore_frozen)
-        {
-          filter_out_frozen_objects (
-            self, objs, &num_objs);
-        }
-      for (int i = 0; i < num_objs; i++)
-        {
-          ArrangerObject * obj = objs[i];
-          if (delete)
-            {
-              arranger_selections_add_object (
-                self->sel_to_delete, obj);
-              obj->deleted_temporarily = true;
-            }
-          else
-            {
-              arranger_object_select (
-                obj, F_SELECT, F_APPEND,
-                F_NO_PUBLISH_EVENTS);
-            }
-        }
+      select_or_mark_objects_in_rect (
+        self, arranger_sel,
+        ARRANGER_OBJECT_TYPE_CHORD_OBJECT,
+        &rect, ignore_frozen, delete);
       break;
     case TYPE (AUTOMATION):
-      arranger_widget_get_hit_objects_in_rect (
-        self, ARRANGER_OBJECT_TYPE_AUTOMATION_POINT,
-        &rect, objs, &num_objs);
-      if (ignore_frozen)
-        {
-          filter_out_frozen_objects (
-            self, objs, &num_objs);
-        }
-      for (int i = 0; i < num_objs; i++)
-        {
-          ArrangerObject * obj = objs[i];
-          if (delete)
-            {
-              arranger_selections_add_object (
-                self->sel_to_delete, obj);
-              obj->deleted_temporarily = true;
-            }
-          else
-            {
-              arranger_object_select (
-                obj, F_SELECT, F_APPEND,
-                F_NO_PUBLISH_EVENTS);
-            }
-        }
+      select_or_mark_objects_in_rect (
+        self, arranger_sel,
+        ARRANGER_OBJECT_TYPE_AUTOMATION_POINT,
+        &rect, ignore_frozen, delete);
       break;
     case TYPE (TIMELINE):
-      arranger_widget_get_hit_objects_in_rect (
-        self, ARRANGER_OBJECT_TYPE_REGION,
-        &rect, objs, &num_objs);
-      if (ignore_frozen)
-        {
-          filter_out_frozen_objects (
-            self, objs, &num_objs);
-        }
-      for (int i = 0; i < num_objs; i++)
-        {
-          ArrangerObject * obj = objs[i];
-          if (delete)
-            {
-              arranger_selections_add_object (
-                self->sel_to_delete, obj);
-              obj->deleted_temporarily = true;
-            }
-          else
-            {
-              /* select the enclosed region */
-              arranger_object_select (
-                obj, F_SELECT, F_APPEND,
-                F_NO_PUBLISH_EVENTS);
-            }
-        }
-      arranger_widget_get_hit_objects_in_rect (
-        self, ARRANGER_OBJECT_TYPE_SCALE_OBJECT,
-        &rect, objs, &num_objs);
-      if (ignore_frozen)
-        {
-          filter_out_frozen_objects (
-            self, objs, &num_objs);
-        }
-      for (int i = 0; i < num_objs; i++)
-        {
-          ArrangerObject * obj = objs[i];
-          if (delete)
-            {
-              arranger_selections_add_object (
-                self->sel_to_delete, obj);
-              obj->deleted_temporarily = true;
-            }
-          else
-            {
-              arranger_object_select (
-                obj, F_SELECT, F_APPEND,
-                F_NO_PUBLISH_EVENTS);
-            }
-        }
-      arranger_widget_get_hit_objects_in_rect (
-        self, ARRANGER_OBJECT_TYPE_MARKER,
-        &rect, objs, &num_objs);
-      if (ignore_frozen)
-        {
-          filter_out_frozen_objects (
-            self, objs, &num_objs);
-        }
-      for (int i = 0; i < num_objs; i++)
-        {
-          ArrangerObject * obj = objs[i];
-          if (delete)
-            {
-              if (arranger_object_is_deletable (
-                    obj))
-                {
-                  arranger_selections_add_object (
-                    self->sel_to_delete, obj);
-                  obj->deleted_temporarily = true;
-                }
-            }
-          else
-            {
-              arranger_object_select (
-                obj, F_SELECT, F_APPEND,
-                F_NO_PUBLISH_EVENTS);
-            }
-        }
+      select_or_mark_objects_in_rect (
+        self, arranger_sel,
+        ARRANGER_OBJECT_TYPE_REGION,
+        &rect, ignore_frozen, delete);
+      select_or_mark_objects_in_rect (
+        self, arranger_sel,
+        ARRANGER_OBJECT_TYPE_SCALE_OBJECT,
+        &rect, ignore_frozen, delete);
+      select_or_mark_objects_in_rect (
+        self, arranger_sel,
+        ARRANGER_OBJECT_TYPE_MARKER,
+        &rect, ignore_frozen, delete);
       break;
     case TYPE (MIDI):
-      arranger_widget_get_hit_objects_in_rect (
-        self, ARRANGER_OBJECT_TYPE_MIDI_NOTE,
-        &rect, objs, &num_objs);
-      if (ignore_frozen)
-        {
-          filter_out_frozen_objects (
-            self, objs, &num_objs);
-        }
-      for (int i = 0; i < num_objs; i++)
-        {
-          ArrangerObject * obj = objs[i];
-          if (delete)
-            {
-              arranger_selections_add_object (
-                self->sel_to_delete, obj);
-              obj->deleted_temporarily = true;
-            }
-          else
-            {
-              arranger_object_select (
-                obj, F_SELECT, F_APPEND,
-                F_NO_PUBLISH_EVENTS);
-            }
-        }
+      select_or_mark_objects_in_rect (
+        self, arranger_sel,
+        ARRANGER_OBJECT_TYPE_MIDI_NOTE,
+        &rect, ignore_frozen, delete);
       midi_arranger_selections_unlisten_note_diff (
         (MidiArrangerSelections *) prev_sel,
         (MidiArrangerSelections *)
         arranger_widget_get_selections (self));
       break;
     case TYPE (MIDI_MODIFIER):
-      arranger_widget_get_hit_objects_in_rect (
-        self, ARRANGER_OBJECT_TYPE_VELOCITY,
-        &rect, objs, &num_objs);
-      if (ignore_frozen)
-        {
-          filter_out_frozen_objects (
-            self, objs, &num_objs);
-        }
-      for (int i = 0; i < num_objs; i++)
-        {
-          ArrangerObject * obj = objs[i];
-          Velocity * vel =
-            (Velocity *) obj;
-          MidiNote * mn =
-            velocity_get_midi_note (vel);
-          ArrangerObject * mn_obj =
-            (ArrangerObject *) mn;
-
-          if (delete)
-            {
-              arranger_selections_add_object (
-                self->sel_to_delete, mn_obj);
-              obj->deleted_temporarily = true;
-            }
-          else
-            {
-              arranger_object_select (
-                mn_obj, F_SELECT, F_APPEND,
-                F_NO_PUBLISH_EVENTS);
-            }
-        }
+      select_or_mark_objects_in_rect (
+        self, arranger_sel,
+        ARRANGER_OBJECT_TYPE_VELOCITY,
+        &rect, ignore_frozen, delete);
       break;
     default:
       break;
@@ -5327,14 +5515,12 @@ arranger_widget_get_scrolled_window (
  * Get all objects currently present in the
  * arranger.
  *
- * @param objs Array to fill in.
- * @param size Array size to fill in.
+ * @return A new array of ArrangerObject's, to be
+ *   freed with g_ptr_array_unref().
  */
-void
+GPtrArray *
 arranger_widget_get_all_objects (
-  ArrangerWidget *  self,
-  ArrangerObject ** objs,
-  int *             size)
+  ArrangerWidget *  self)
 {
   GdkRectangle rect = {
     0, 0,
@@ -5344,9 +5530,12 @@ arranger_widget_get_all_objects (
       GTK_WIDGET (self)),
   };
 
-  arranger_widget_get_hit_objects_in_rect (
-    self, ARRANGER_OBJECT_TYPE_ALL, &rect,
-    objs, size);
+  GPtrArray * objs = g_ptr_array_new ();
+  get_hit_objects (
+    self, ARRANGER_OBJECT_TYPE_ALL, &rect, 0, 0,
+    NULL, NULL, objs);
+
+  return objs;
 }
 
 RulerWidget *
@@ -6999,6 +7188,9 @@ finalize (
     g_object_unref, self->ap_layout);
   object_free_w_func_and_null (
     g_object_unref, self->audio_layout);
+  object_free_w_func_and_null (
+    arranger_object_index_cache_free,
+    self->obj_index_cache);
 
   G_OBJECT_CLASS (
     arranger_widget_parent_class)->
@@ -7021,6 +7213,10 @@ arranger_widget_init (
 {
   self->first_draw = true;
 
+  self->obj_index_cache =
+    arranger_object_index_cache_new (
+      get_object_extent_ticks, self);
+
   /* make widget able to notify */
   gtk_widget_add_events (
     GTK_WIDGET (self),
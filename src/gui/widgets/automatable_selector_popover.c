@@ -20,6 +20,8 @@
 #include "audio/automation_track.h"
 #include "audio/channel_track.h"
 #include "audio/engine.h"
+#include "audio/router.h"
+#include "audio/track_processor.h"
 #include "gui/backend/event.h"
 #include "gui/backend/event_manager.h"
 #include "gui/widgets/automatable_selector_popover.h"
@@ -43,6 +45,31 @@ on_closed (
   AutomatableSelectorPopoverWidget *self,
   gpointer                          user_data)
 {
+  /* create the selected MIDI control if it is not
+   * used yet */
+  if (!self->selected_port &&
+      self->selected_midi_automatable >= 0)
+    {
+      Track * track =
+        automation_track_get_track (self->owner);
+      g_return_if_fail (
+        IS_TRACK_AND_NONNULL (track));
+
+      bool held =
+        engine_hold_processing (AUDIO_ENGINE);
+      AutomationTrack * at =
+        track_processor_ensure_midi_automatable (
+          track->processor,
+          self->selected_midi_automatable);
+      engine_release_processing (
+        AUDIO_ENGINE, held);
+      router_recalc_graph (ROUTER, F_NOT_SOFT);
+      g_return_if_fail (at);
+
+      self->selected_port =
+        port_find_from_identifier (&at->port_id);
+    }
+
   /* if the selected automatable changed */
   Port * at_port =
     port_find_from_identifier (
@@ -102,6 +129,15 @@ update_info_label (
 
       gtk_label_set_text (
         self->info, label);
+      g_free (label);
+    }
+  else if (self->selected_midi_automatable >= 0)
+    {
+      char * label =
+        track_processor_get_midi_automatable_label (
+          self->selected_midi_automatable);
+      gtk_label_set_text (self->info, label);
+      g_free (label);
     }
   else
     {
@@ -196,16 +232,70 @@ create_model_for_ports (
   GtkListStore *list_store;
   GtkTreeIter iter;
 
-  /* file name, index */
+  /* icon, label, port, MIDI automatable index */
   list_store =
     gtk_list_store_new (
-      3,
+      4,
       G_TYPE_STRING,
       G_TYPE_STRING,
-      G_TYPE_POINTER);
+      G_TYPE_POINTER,
+      G_TYPE_INT);
 
   Track * track =
     automation_track_get_track (self->owner);
+
+  /* MIDI controls are listed even if they are not
+   * used yet (and have no port) */
+  if (self->selected_type >= AS_TYPE_MIDI_CH1 &&
+      self->selected_type <= AS_TYPE_MIDI_CH16)
+    {
+      int ch =
+        (int) self->selected_type -
+        AS_TYPE_MIDI_CH1;
+      int idxs[131];
+      for (int i = 0; i < 128; i++)
+        {
+          idxs[i] =
+            TRACK_PROCESSOR_MIDI_CC_IDX (ch, i);
+        }
+      idxs[128] =
+        TRACK_PROCESSOR_PITCH_BEND_IDX (ch);
+      idxs[129] =
+        TRACK_PROCESSOR_POLY_KEY_PRESSURE_IDX (ch);
+      idxs[130] =
+        TRACK_PROCESSOR_CHANNEL_PRESSURE_IDX (ch);
+      for (size_t i = 0; i < G_N_ELEMENTS (idxs);
+           i++)
+        {
+          Port * port =
+            track_processor_get_midi_automatable (
+              track->processor, idxs[i]);
+
+          /* skip if already in a visible lane */
+          AutomationTrack * at =
+            port ? port->at : NULL;
+          if (at && at->created && at->visible &&
+              at != self->owner)
+            continue;
+
+          char * label =
+            track_processor_get_midi_automatable_label (
+              idxs[i]);
+          gtk_list_store_append (
+            list_store, &iter);
+          gtk_list_store_set (
+            list_store, &iter,
+            0, "signal-midi",
+            1, label,
+            2, port,
+            3, idxs[i],
+            -1);
+          g_free (label);
+        }
+
+      return GTK_TREE_MODEL (list_store);
+    }
+
   AutomationTracklist * atl =
     track_get_automation_tracklist (track);
   for (int i = 0; i < atl->num_ats; i++)
@@ -234,37 +324,7 @@ create_model_for_ports (
         case AS_TYPE_MIDI_CH14:
         case AS_TYPE_MIDI_CH15:
         case AS_TYPE_MIDI_CH16:
-          /* skip non-channel automation tracks */
-          port =
-            port_find_from_identifier (&at->port_id);
-          if (!(port->id.flags &
-                  PORT_FLAG_MIDI_AUTOMATABLE))
-            continue;
-          /*g_message (*/
-            /*"port %s is a midi automatable",*/
-            /*port->id.label);*/
-
-          if (port->id.flags2 &
-                PORT_FLAG2_MIDI_PITCH_BEND ||
-              port->id.flags2 &
-                PORT_FLAG2_MIDI_POLY_KEY_PRESSURE ||
-              port->id.flags2 &
-                PORT_FLAG2_MIDI_CHANNEL_PRESSURE)
-            {
-              if ((int) self->selected_type !=
-                    (AS_TYPE_MIDI_CH1 +
-                       port->id.port_index))
-                continue;
-            }
-          else
-            {
-              if ((int) self->selected_type !=
-                    (AS_TYPE_MIDI_CH1 +
-                       port->id.port_index / 128))
-                continue;
-            }
-
-          strcpy (icon_name, "signal-midi");
+          /* handled above */
           break;
         case AS_TYPE_MACRO:
           /* skip non-channel automation tracks */
@@ -359,6 +419,7 @@ create_model_for_ports (
             0, icon_name,
             1, port->id.label,
             2, port,
+            3, -1,
             -1);
         }
     }
@@ -575,6 +636,7 @@ on_selection_changed (
               self->port_treeview));
 
           self->selected_port = NULL;
+          self->selected_midi_automatable = -1;
           update_info_label (self);
         }
       else if (model ==
@@ -586,6 +648,10 @@ on_selection_changed (
             g_value_get_pointer (&value);
 
           self->selected_port = port;
+          gtk_tree_model_get (
+            model, &iter,
+            3, &self->selected_midi_automatable,
+            -1);
           update_info_label (self);
         }
     }
@@ -653,6 +719,7 @@ automatable_selector_popover_widget_new (
       AUTOMATABLE_SELECTOR_POPOVER_WIDGET_TYPE, NULL);
 
   self->owner = owner;
+  self->selected_midi_automatable = -1;
 
   /* set selected type */
   self->selected_type = AS_TYPE_CHANNEL;
@@ -25,6 +25,7 @@
 #include "audio/quantize_options.h"
 #include "audio/router.h"
 #include "audio/snap_grid.h"
+#include "audio/tempo_map.h"
 #include "audio/tempo_track.h"
 #include "audio/transport.h"
 #include "gui/backend/event.h"
@@ -298,12 +299,13 @@ digital_meter_draw_cb (
         }
       else
         {
-          bars = position_get_bars (&pos, true);
-          beats = position_get_beats (&pos, true);
-          sixteenths =
-            position_get_sixteenths (&pos, true);
-          ticks =
-            (int) floor (position_get_ticks (&pos));
+          MusicalTime time;
+          position_get_musical_time (
+            &pos, true, &time);
+          bars = time.bars;
+          beats = time.beats;
+          sixteenths = time.sixteenths;
+          ticks = (int) floor (time.ticks);
 
           z_cairo_get_text_extents_for_widget (
             widget, self->seg7_layout,
@@ -637,19 +639,6 @@ on_change_finished (
   self->update_minutes = 0;
   self->update_seconds = 0;
   self->update_ms = 0;
-  /* FIXME super reduntant */
-  if (self->update_note_length ||
-      self->update_note_type)
-    {
-      snap_grid_update_snap_points_default (
-        SNAP_GRID_TIMELINE);
-      snap_grid_update_snap_points_default (
-        SNAP_GRID_EDITOR);
-      quantize_options_update_quantize_points (
-        QUANTIZE_OPTIONS_TIMELINE);
-      quantize_options_update_quantize_points (
-        QUANTIZE_OPTIONS_EDITOR);
-    }
   self->update_note_length = 0;
   self->update_note_type = 0;
   self->update_timesig_top = 0;
@@ -303,14 +303,20 @@ add_from_object (
 }
 
 #define ADD_FOREACH_IN_ARRANGER(arranger) \
-  arranger_widget_get_all_objects ( \
-    arranger, objs, &num_objs); \
-  for (int i = 0; i < num_objs; i++) \
-    { \
-      ArrangerObject * obj = objs[i]; \
-      add_from_object ( \
-        store, &iter, obj); \
-    } \
+  { \
+    GPtrArray * objs = \
+      arranger_widget_get_all_objects ( \
+        arranger); \
+    for (guint i = 0; i < objs->len; i++) \
+      { \
+        ArrangerObject * obj = \
+          (ArrangerObject *) \
+          g_ptr_array_index (objs, i); \
+        add_from_object ( \
+          store, &iter, obj); \
+      } \
+    g_ptr_array_unref (objs); \
+  }
 
 static GtkTreeModel *
 create_timeline_model (
@@ -342,8 +348,6 @@ create_timeline_model (
 
   /* add data to the list store (cheat by using
    * the timeline arranger children) */
-  ArrangerObject * objs[2000];
-  int              num_objs;
   ADD_FOREACH_IN_ARRANGER (MW_TIMELINE);
   ADD_FOREACH_IN_ARRANGER (MW_PINNED_TIMELINE);
 
@@ -386,8 +390,6 @@ create_midi_model (
       G_TYPE_POINTER);
 
   /* add data to the list */
-  ArrangerObject * objs[2000];
-  int              num_objs;
   ADD_FOREACH_IN_ARRANGER (
     MW_MIDI_ARRANGER);
 
@@ -417,8 +419,6 @@ create_chord_model (
       G_TYPE_POINTER);
 
   /* add data to the list */
-  ArrangerObject * objs[2000];
-  int              num_objs;
   ADD_FOREACH_IN_ARRANGER (
     MW_CHORD_ARRANGER);
 
@@ -451,8 +451,6 @@ create_automation_model (
       G_TYPE_POINTER);
 
   /* add data to the list */
-  ArrangerObject * objs[2000];
-  int              num_objs;
   ADD_FOREACH_IN_ARRANGER (
     MW_AUTOMATION_ARRANGER);
 
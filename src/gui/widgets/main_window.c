@@ -592,6 +592,7 @@ main_window_widget_init (MainWindowWidget * self)
     { "save-as", activate_save_as },
     { "export-as", activate_export_as },
     { "export-graph", activate_export_graph },
+    { "profile-graph", activate_profile_graph },
     { "properties", activate_properties },
 
     /* edit menu */
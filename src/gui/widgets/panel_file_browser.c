@@ -649,12 +649,7 @@ on_bookmark_row_activated (
 
   file_manager_set_selection (
     FILE_MANAGER, loc, true, true);
-  self->files_tree_model =
-    GTK_TREE_MODEL_FILTER (
-      create_model_for_files (self));
-  gtk_tree_view_set_model (
-    self->files_tree_view,
-    GTK_TREE_MODEL (self->files_tree_model));
+  panel_file_browser_refresh_files (self);
 }
 
 static void
@@ -685,12 +680,7 @@ on_file_row_activated (
       loc->label = g_path_get_basename (loc->path);
       file_manager_set_selection (
         FILE_MANAGER, loc, true, true);
-      self->files_tree_model =
-        GTK_TREE_MODEL_FILTER (
-          create_model_for_files (self));
-      gtk_tree_view_set_model (
-        self->files_tree_view,
-        GTK_TREE_MODEL (self->files_tree_model));
+      panel_file_browser_refresh_files (self);
     }
   else if (descr->type == FILE_TYPE_WAV ||
            descr->type == FILE_TYPE_OGG ||
@@ -867,6 +857,31 @@ refilter_files (
     self->files_tree_model);
 }
 
+/**
+ * Recreates the file list from the files in the
+ * file manager.
+ *
+ * To be called after the file manager reloaded
+ * its files.
+ */
+void
+panel_file_browser_refresh_files (
+  PanelFileBrowserWidget * self)
+{
+  /* the previous files were freed */
+  g_ptr_array_remove_range (
+    self->selected_files, 0,
+    self->selected_files->len);
+  self->cur_file = NULL;
+
+  self->files_tree_model =
+    GTK_TREE_MODEL_FILTER (
+      create_model_for_files (self));
+  gtk_tree_view_set_model (
+    self->files_tree_view,
+    GTK_TREE_MODEL (self->files_tree_model));
+}
+
 PanelFileBrowserWidget *
 panel_file_browser_widget_new ()
 {
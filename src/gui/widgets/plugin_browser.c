@@ -19,6 +19,9 @@
 
 #include "zrythm-config.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "actions/tracklist_selections.h"
 #include "audio/engine.h"
 #include "gui/backend/event.h"
@@ -34,6 +37,7 @@
 #include "plugins/lv2_plugin.h"
 #include "plugins/plugin.h"
 #include "plugins/plugin_manager.h"
+#include "plugins/plugin_search_index.h"
 #include "project.h"
 #include "settings/settings.h"
 #include "utils/error.h"
@@ -64,6 +68,7 @@ enum
   PL_COLUMN_ICON,
   PL_COLUMN_NAME,
   PL_COLUMN_DESCR,
+  PL_COLUMN_VISIBLE,
   PL_NUM_COLUMNS
 };
 
@@ -373,164 +378,92 @@ on_row_activated (
 }
 
 /**
- * Visible function for plugin tree model.
+ * Updates the visibility of the plugin rows based
+ * on the current filters.
  *
- * Used for filtering based on selected category.
+ * The matching plugins are looked up in the
+ * search index and only the rows whose visibility
+ * changed are updated.
  */
-static gboolean
-visible_func (
-  GtkTreeModel *model,
-  GtkTreeIter  *iter,
+static void
+update_plugin_visibility (
   PluginBrowserWidget * self)
 {
-  // Visible if row is non-empty and category
-  // matches selected
-  PluginDescriptor *descr;
+  if (!self->plugin_tree_model)
+    return;
 
-  gtk_tree_model_get (
-    model, iter, PL_COLUMN_DESCR, &descr, -1);
+  PluginSearchIndex * index =
+    PLUGIN_MANAGER->search_index;
+  g_return_if_fail (index);
 
-  int instruments_active, effects_active,
-      modulators_active, midi_modifiers_active;
-  instruments_active =
+  const char * authors[self->num_selected_authors + 1];
+  for (int i = 0; i < self->num_selected_authors;
+       i++)
+    {
+      authors[i] =
+        symap_unmap (
+          self->symap, self->selected_authors[i]);
+    }
+
+  PluginSearchFilter filter = {
+    .categories = self->selected_categories,
+    .num_categories = self->num_selected_categories,
+    .authors = authors,
+    .num_authors = self->num_selected_authors,
+    .protocols = self->selected_protocols,
+    .num_protocols = self->num_selected_protocols,
+    .collection = self->selected_collection,
+    .search = self->current_search,
+  };
+  filter.types[PLUGIN_SEARCH_TYPE_INSTRUMENT] =
     gtk_toggle_tool_button_get_active (
       self->toggle_instruments);
-  effects_active =
+  filter.types[PLUGIN_SEARCH_TYPE_EFFECT] =
     gtk_toggle_tool_button_get_active (
       self->toggle_effects);
-  modulators_active =
+  filter.types[PLUGIN_SEARCH_TYPE_MODULATOR] =
     gtk_toggle_tool_button_get_active (
       self->toggle_modulators);
-  midi_modifiers_active =
+  filter.types[PLUGIN_SEARCH_TYPE_MIDI_MODIFIER] =
     gtk_toggle_tool_button_get_active (
       self->toggle_midi_modifiers);
 
-  /* no filter, all visible */
-  if (self->num_selected_categories == 0 &&
-      self->num_selected_authors == 0 &&
-      self->num_selected_protocols == 0 &&
-      !self->selected_collection &&
-      !self->current_search &&
-      !instruments_active &&
-      !effects_active &&
-      !modulators_active &&
-      !midi_modifiers_active)
-    {
-      return true;
-    }
-
-  int visible = false;
-
-  /* not visible if category selected and plugin
-   * doesn't match */
-  if (self->num_selected_categories > 0)
-    {
-      visible = false;
-      for (int i = 0;
-           i < self->num_selected_categories; i++)
-        {
-          if (descr->category ==
-                self->selected_categories[i])
-            {
-              visible = true;
-              break;
-            }
-        }
-
-      /* not visible if the category is not one
-       * of the selected categories */
-      if (!visible)
-        return false;
-    }
-
-  /* not visible if author selected and plugin
-   * doesn't match */
-  if (self->num_selected_authors > 0)
-    {
-      visible = false;
-      if (descr->author)
-        {
-          for (int i = 0;
-               i < self->num_selected_authors; i++)
-            {
-              if (symap_map (
-                    self->symap, descr->author) ==
-                      self->selected_authors[i])
-                {
-                  visible = true;
-                  break;
-                }
-            }
-        }
-      else
-        {
-          visible = false;
-        }
+  uint64_t * visible =
+    plugin_search_index_new_bitset (index);
+  plugin_search_index_filter (
+    index, &filter, visible);
 
-      /* not visible if the author is not one
-       * of the selected authors */
-      if (!visible)
-        return false;
-    }
-
-  /* not visible if plugin is not part of
-   * selected collection */
-  if (self->selected_collection)
+  /* only touch the rows that changed */
+  GtkListStore * list_store =
+    GTK_LIST_STORE (
+      gtk_tree_model_filter_get_model (
+        self->plugin_tree_model));
+  GtkTreeIter iter;
+  bool valid =
+    gtk_tree_model_get_iter_first (
+      GTK_TREE_MODEL (list_store), &iter);
+  for (int i = 0;
+       valid && i < index->num_descriptors; i++)
     {
-      if (plugin_collection_contains_descriptor (
-            self->selected_collection, descr,
-            false))
+      bool was_visible =
+        plugin_search_index_bitset_get (
+          self->visible_plugins, i);
+      bool is_visible =
+        plugin_search_index_bitset_get (
+          visible, i);
+      if (was_visible != is_visible)
         {
-          visible = true;
-        }
-      else
-        {
-          return false;
+          gtk_list_store_set (
+            list_store, &iter,
+            PL_COLUMN_VISIBLE, is_visible, -1);
         }
+      valid =
+        gtk_tree_model_iter_next (
+          GTK_TREE_MODEL (list_store), &iter);
     }
 
-  /* not visible if plugin protocol is not one of
-   * selected protocols */
-  if (self->num_selected_protocols > 0)
-    {
-      visible = false;
-      for (int i = 0;
-           i < self->num_selected_protocols; i++)
-        {
-          if (descr->protocol ==
-                self->selected_protocols[i])
-            {
-              visible = true;
-              break;
-            }
-        }
-
-      if (!visible)
-        return false;
-    }
-
-  /* not visibile if plugin type doesn't match */
-  if (instruments_active &&
-      !plugin_descriptor_is_instrument (descr))
-    return false;
-  if (effects_active &&
-      !plugin_descriptor_is_effect (descr))
-    return false;
-  if (modulators_active &&
-      !plugin_descriptor_is_modulator (descr))
-    return false;
-  if (midi_modifiers_active &&
-      !plugin_descriptor_is_midi_modifier (descr))
-    return false;
-
-  if (self->current_search &&
-      !string_contains_substr_case_insensitive (
-        descr->name, self->current_search))
-    {
-      return false;
-    }
-
-  return true;
+  free (self->visible_plugins);
+  self->visible_plugins = visible;
 }
 
 static void
@@ -1365,8 +1298,7 @@ on_selection_changed (
           cat_selected_foreach,
         self);
 
-      gtk_tree_model_filter_refilter (
-        self->plugin_tree_model);
+      update_plugin_visibility (self);
     }
   else if (model == self->author_tree_model)
     {
@@ -1378,8 +1310,7 @@ on_selection_changed (
           author_selected_foreach,
         self);
 
-      gtk_tree_model_filter_refilter (
-        self->plugin_tree_model);
+      update_plugin_visibility (self);
     }
   else if (model ==
              GTK_TREE_MODEL (
@@ -1393,8 +1324,7 @@ on_selection_changed (
           protocol_selected_foreach,
         self);
 
-      gtk_tree_model_filter_refilter (
-        self->plugin_tree_model);
+      update_plugin_visibility (self);
     }
   else if (model ==
              GTK_TREE_MODEL (
@@ -1460,8 +1390,7 @@ on_selection_changed (
           self->selected_collection->name :
           "none");
 
-      gtk_tree_model_filter_refilter (
-        self->plugin_tree_model);
+      update_plugin_visibility (self);
     }
 
   g_list_free_full (
@@ -1643,11 +1572,32 @@ create_model_for_plugins (
   /*GtkTreePath *path;*/
   GtkTreeIter iter;
 
+  /* the rows must match the search index */
+  if (!PLUGIN_MANAGER->search_index ||
+      PLUGIN_MANAGER->search_index->
+        num_descriptors !=
+      (int) PLUGIN_MANAGER->plugin_descriptors->len)
+    {
+      plugin_manager_update_search_index (
+        PLUGIN_MANAGER);
+    }
+
+  /* all rows start visible */
+  free (self->visible_plugins);
+  self->visible_plugins =
+    plugin_search_index_new_bitset (
+      PLUGIN_MANAGER->search_index);
+  memset (
+    self->visible_plugins, 0xff,
+    MAX (PLUGIN_MANAGER->search_index->num_words, 1) *
+      sizeof (uint64_t));
+
   /* plugin name, index */
   list_store =
     gtk_list_store_new (
       PL_NUM_COLUMNS, G_TYPE_STRING,
-      G_TYPE_STRING, G_TYPE_POINTER);
+      G_TYPE_STRING, G_TYPE_POINTER,
+      G_TYPE_BOOLEAN);
 
   for (size_t i = 0;
        i < PLUGIN_MANAGER->plugin_descriptors->len;
@@ -1691,6 +1641,7 @@ create_model_for_plugins (
         PL_COLUMN_ICON, icon_name,
         PL_COLUMN_NAME, descr->name,
         PL_COLUMN_DESCR, descr,
+        PL_COLUMN_VISIBLE, true,
         -1);
     }
 
@@ -1698,10 +1649,9 @@ create_model_for_plugins (
     gtk_tree_model_filter_new (
       GTK_TREE_MODEL (list_store),
       NULL);
-  gtk_tree_model_filter_set_visible_func (
+  gtk_tree_model_filter_set_visible_column (
     GTK_TREE_MODEL_FILTER (model),
-    (GtkTreeModelFilterVisibleFunc) visible_func,
-    self, NULL);
+    PL_COLUMN_VISIBLE);
 
   return model;
 }
@@ -1710,8 +1660,8 @@ static bool
 refilter_source (
   PluginBrowserWidget * self)
 {
-  gtk_tree_model_filter_refilter (
-    self->plugin_tree_model);
+  self->refilter_source_id = 0;
+  update_plugin_visibility (self);
 
   return G_SOURCE_REMOVE;
 }
@@ -1746,10 +1696,12 @@ plugin_search_equal_func (
   GtkTreeIter next_iter = *iter;
   bool has_next =
     gtk_tree_model_iter_next (model, &next_iter);
-  if (match || !has_next)
+  if ((match || !has_next) &&
+      !self->refilter_source_id)
     {
-      g_idle_add (
-        (GSourceFunc) refilter_source, self);
+      self->refilter_source_id =
+        g_idle_add (
+          (GSourceFunc) refilter_source, self);
     }
 
   g_free (str);
@@ -2056,8 +2008,7 @@ toggles_changed (
         "plugin-browser-filter",
         PLUGIN_BROWSER_FILTER_NONE);
     }
-  gtk_tree_model_filter_refilter (
-    self->plugin_tree_model);
+  update_plugin_visibility (self);
 }
 
 static int
@@ -2139,8 +2090,7 @@ on_key_release (
 {
   g_free_and_null (self->current_search);
 
-  gtk_tree_model_filter_refilter (
-    self->plugin_tree_model);
+  update_plugin_visibility (self);
 
   g_message ("key release");
 
@@ -2152,6 +2102,11 @@ finalize (
   PluginBrowserWidget * self)
 {
   symap_free (self->symap);
+  free (self->visible_plugins);
+  if (self->refilter_source_id)
+    {
+      g_source_remove (self->refilter_source_id);
+    }
 
   G_OBJECT_CLASS (
     plugin_browser_widget_parent_class)->
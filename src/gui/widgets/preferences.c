@@ -22,6 +22,8 @@
 #include <locale.h>
 
 #include "audio/engine.h"
+#include "audio/graph.h"
+#include "audio/router.h"
 #include "gui/widgets/main_window.h"
 #include "gui/widgets/active_hardware_mb.h"
 #include "gui/widgets/preferences.h"
@@ -34,6 +36,7 @@
 #include "utils/objects.h"
 #include "utils/resources.h"
 #include "utils/string.h"
+#include "utils/thread_affinity.h"
 #include "utils/ui.h"
 #include "zrythm.h"
 #include "zrythm_app.h"
@@ -573,6 +576,9 @@ make_control (
           SET_STRV_IF_MATCH (
             "DSP", "Pan", "pan-law",
             pan_law_str);
+          SET_STRV_IF_MATCH (
+            "DSP", "Threads", "affinity-policy",
+            thread_affinity_policy_str);
 
 #undef SET_STRV_IF_MATCH
 
@@ -785,6 +791,43 @@ add_subgroup (
         }
     }
 
+  /* show where the DSP threads currently run */
+  if (string_is_equal (info->group_name, _("DSP"))
+      && string_is_equal (info->name, _("Threads"))
+      && ROUTER && ROUTER->graph)
+    {
+      GtkWidget * box =
+        gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 2);
+      gtk_widget_set_visible (box, true);
+      gtk_container_add (
+        GTK_CONTAINER (page_box), box);
+
+      GtkWidget * lbl =
+        plugin_gtk_new_label (
+          _("Current affinity"), false, false,
+          1.f, 0.f);
+      gtk_widget_set_visible (lbl, true);
+      gtk_container_add (
+        GTK_CONTAINER (box), lbl);
+      gtk_size_group_add_widget (
+        size_group, lbl);
+
+      char * affinity =
+        graph_get_thread_affinity_str (
+          ROUTER->graph);
+      GtkWidget * affinity_lbl =
+        gtk_label_new (affinity);
+      g_free (affinity);
+      gtk_label_set_xalign (
+        GTK_LABEL (affinity_lbl), 0.f);
+      gtk_label_set_selectable (
+        GTK_LABEL (affinity_lbl), true);
+      gtk_widget_set_visible (affinity_lbl, true);
+      gtk_widget_set_hexpand (affinity_lbl, true);
+      gtk_container_add (
+        GTK_CONTAINER (box), affinity_lbl);
+    }
+
   /* Remove label if no controls added */
   if (num_controls == 0)
     {
@@ -42,6 +42,8 @@ project_toolbar_widget_init (ProjectToolbarWidget * self)
   SET_TOOLTIP (open, _("Open Project"));
   SET_TOOLTIP (export_as, _("Export As"));
   SET_TOOLTIP (export_graph, _("Export Graph"));
+  SET_TOOLTIP (
+    profile_graph, _("Profile Graph Processing"));
 #undef SET_TOOLTIP
 }
 
@@ -67,6 +69,7 @@ project_toolbar_widget_class_init (ProjectToolbarWidgetClass * _klass)
   BIND_CHILD (open);
   BIND_CHILD (export_as);
   BIND_CHILD (export_graph);
+  BIND_CHILD (profile_graph);
 
 #undef BIND_CHILD
 }
@@ -1294,7 +1294,7 @@ on_audio_func_activate (
       bool ret =
         arranger_selections_action_perform_edit_audio_function (
           (ArrangerSelections *) sel,
-          data->audio_func, NULL, &err);
+          data->audio_func, NULL, NULL, &err);
       if (!ret)
         {
           HANDLE_ERROR (
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "guile/modules.h"
+
+#ifndef SNARF_MODE
+#include "audio/engine.h"
+#include "audio/graph_profiler.h"
+#include "audio/router.h"
+#include "project.h"
+#endif
+
+SCM_DEFINE (
+  s_graph_profiler_start,
+  "graph-profiler-start", 1, 0, 0,
+  (SCM num_cycles),
+  "Starts profiling the next @var{num_cycles} "
+  "processing cycles.")
+#define FUNC_NAME s_
+{
+  router_start_profiling (
+    ROUTER, scm_to_int (num_cycles));
+
+  return SCM_BOOL_T;
+}
+#undef FUNC_NAME
+
+SCM_DEFINE (
+  s_graph_profiler_is_finished,
+  "graph-profiler-is-finished", 0, 0, 0,
+  (),
+  "Returns whether the current profile has "
+  "finished recording.")
+#define FUNC_NAME s_
+{
+  return
+    scm_from_bool (
+      graph_profiler_is_finished (
+        ROUTER->profiler));
+}
+#undef FUNC_NAME
+
+SCM_DEFINE (
+  s_graph_profiler_print,
+  "graph-profiler-print", 0, 0, 0,
+  (),
+  "Prints the min/avg/p99/max processing time "
+  "of each node in the profile.")
+#define FUNC_NAME s_
+{
+  graph_profiler_print (ROUTER->profiler);
+
+  return SCM_BOOL_T;
+}
+#undef FUNC_NAME
+
+SCM_DEFINE (
+  s_graph_profiler_export_chrome_trace,
+  "graph-profiler-export-chrome-trace", 1, 0, 0,
+  (SCM path),
+  "Exports the profile to @var{path} in the Chrome "
+  "trace event format. Returns whether "
+  "successful.")
+#define FUNC_NAME s_
+{
+  char * str = scm_to_locale_string (path);
+  GError * err = NULL;
+  bool ret =
+    graph_profiler_export_chrome_trace (
+      ROUTER->profiler, str, &err);
+  if (!ret)
+    {
+      g_warning (
+        "failed to export graph profile: %s",
+        err->message);
+      g_error_free (err);
+    }
+  free (str);
+
+  return scm_from_bool (ret);
+}
+#undef FUNC_NAME
+
+static void
+init_module (void * data)
+{
+#ifndef SNARF_MODE
+#include "audio_graph_profiler.x"
+#endif
+  scm_c_export (
+    "graph-profiler-start",
+    "graph-profiler-is-finished",
+    "graph-profiler-print",
+    "graph-profiler-export-chrome-trace",
+    NULL);
+}
+
+void
+guile_audio_graph_profiler_define_module (void)
+{
+  scm_c_define_module (
+    "audio graph_profiler", init_module, NULL);
+}
@@ -69,6 +69,7 @@ guile_define_modules (void)
   guile_actions_port_connection_action_define_module ();
   guile_actions_undo_manager_define_module ();
   guile_audio_channel_define_module ();
+  guile_audio_graph_profiler_define_module ();
   guile_audio_midi_note_define_module ();
   guile_audio_midi_region_define_module ();
   guile_audio_port_define_module ();
@@ -26,6 +26,7 @@
 
 #include "audio/engine.h"
 #include "audio/midi_event.h"
+#include "audio/router.h"
 #include "audio/tempo_track.h"
 #include "audio/transport.h"
 #include "gui/backend/event.h"
@@ -99,6 +100,83 @@ get_plugin_type_from_protocol (
   g_return_val_if_reached (0);
 }
 
+/**
+ * A group (client) inside the patchbay of the
+ * native carla plugin.
+ */
+typedef struct PatchbayGroup
+{
+  uint id;
+
+  /** Carla plugin ID, or -1 for the inputs and
+   * outputs of the native plugin. */
+  int  plugin_id;
+} PatchbayGroup;
+
+/**
+ * A port inside the patchbay of the native carla
+ * plugin.
+ */
+typedef struct PatchbayPort
+{
+  uint group_id;
+  uint id;
+
+  /** PATCHBAY_PORT_* hints. */
+  int  hints;
+} PatchbayPort;
+
+/**
+ * Returns the carla plugin variant that has
+ * enough audio channels for the plugin.
+ */
+static CarlaPluginType
+get_carla_type (
+  const PluginDescriptor * descr)
+{
+  int num_channels =
+    MAX (
+      descr->num_audio_ins, descr->num_audio_outs);
+  if (num_channels <= 2)
+    return CARLA_PLUGIN_RACK;
+  else if (num_channels <= 16)
+    return CARLA_PLUGIN_PATCHBAY16;
+  else if (num_channels <= 32)
+    return CARLA_PLUGIN_PATCHBAY32;
+
+  if (num_channels > 64)
+    {
+      g_warning (
+        "%s has %d audio channels but only 64 "
+        "are supported",
+        descr->name, num_channels);
+    }
+  return CARLA_PLUGIN_PATCHBAY64;
+}
+
+static const NativePluginDescriptor *
+get_native_plugin_descriptor (
+  CarlaPluginType type)
+{
+  switch (type)
+    {
+    case CARLA_PLUGIN_RACK:
+      return carla_get_native_rack_plugin ();
+    case CARLA_PLUGIN_PATCHBAY:
+      return carla_get_native_patchbay_plugin ();
+    case CARLA_PLUGIN_PATCHBAY16:
+      return carla_get_native_patchbay16_plugin ();
+    case CARLA_PLUGIN_PATCHBAY32:
+      return carla_get_native_patchbay32_plugin ();
+    case CARLA_PLUGIN_PATCHBAY64:
+      return carla_get_native_patchbay64_plugin ();
+    default:
+      break;
+    }
+
+  g_return_val_if_reached (NULL);
+}
+
 void
 carla_native_plugin_init_loaded (
   CarlaNativePlugin * self)
@@ -351,11 +429,221 @@ engine_callback (
             ET_PLUGIN_CRASHED, self->plugin);
         }
       break;
+    case ENGINE_CALLBACK_PATCHBAY_CLIENT_ADDED:
+      if (self->patchbay_groups)
+        {
+          PatchbayGroup group = {
+            .id = plugin_id,
+            .plugin_id = val2,
+          };
+          g_array_append_val (
+            self->patchbay_groups, group);
+        }
+      break;
+    case ENGINE_CALLBACK_PATCHBAY_PORT_ADDED:
+      if (self->patchbay_ports)
+        {
+          PatchbayPort port = {
+            .group_id = plugin_id,
+            .id = (uint) val1,
+            .hints = val2,
+          };
+          g_array_append_val (
+            self->patchbay_ports, port);
+        }
+      break;
     default:
       break;
     }
 }
 
+/**
+ * Index of the port lists used when connecting
+ * the patchbay.
+ */
+enum PatchbayPortList
+{
+  PATCHBAY_HOST_AUDIO_INS,
+  PATCHBAY_HOST_AUDIO_OUTS,
+  PATCHBAY_HOST_MIDI_INS,
+  PATCHBAY_HOST_MIDI_OUTS,
+  PATCHBAY_PLUGIN_AUDIO_INS,
+  PATCHBAY_PLUGIN_AUDIO_OUTS,
+  PATCHBAY_PLUGIN_MIDI_INS,
+  PATCHBAY_PLUGIN_MIDI_OUTS,
+  NUM_PATCHBAY_PORT_LISTS,
+};
+
+/**
+ * Returns the list the port belongs to, or -1 if
+ * it is not used.
+ */
+static int
+get_patchbay_port_list (
+  CarlaNativePlugin *  self,
+  const PatchbayPort * port)
+{
+  const PatchbayGroup * group = NULL;
+  for (guint i = 0;
+       i < self->patchbay_groups->len; i++)
+    {
+      const PatchbayGroup * cur =
+        &g_array_index (
+          self->patchbay_groups, PatchbayGroup, i);
+      if (cur->id == port->group_id)
+        {
+          group = cur;
+          break;
+        }
+    }
+  if (!group)
+    return -1;
+
+  /* the inputs of the native plugin are outputs
+   * inside the patchbay and vice versa */
+  bool is_input =
+    port->hints & PATCHBAY_PORT_IS_INPUT;
+  if (group->plugin_id < 0)
+    {
+      if (port->hints & PATCHBAY_PORT_TYPE_AUDIO)
+        {
+          return
+            is_input ?
+              PATCHBAY_HOST_AUDIO_OUTS :
+              PATCHBAY_HOST_AUDIO_INS;
+        }
+      else if (port->hints & PATCHBAY_PORT_TYPE_MIDI)
+        {
+          return
+            is_input ?
+              PATCHBAY_HOST_MIDI_OUTS :
+              PATCHBAY_HOST_MIDI_INS;
+        }
+    }
+  else if ((uint) group->plugin_id ==
+             self->carla_plugin_id)
+    {
+      if (port->hints & PATCHBAY_PORT_TYPE_AUDIO)
+        {
+          return
+            is_input ?
+              PATCHBAY_PLUGIN_AUDIO_INS :
+              PATCHBAY_PLUGIN_AUDIO_OUTS;
+        }
+      else if (port->hints & PATCHBAY_PORT_TYPE_MIDI)
+        {
+          return
+            is_input ?
+              PATCHBAY_PLUGIN_MIDI_INS :
+              PATCHBAY_PLUGIN_MIDI_OUTS;
+        }
+    }
+
+  return -1;
+}
+
+/**
+ * Connects the ports of the 2 lists in order.
+ */
+static void
+connect_patchbay_ports (
+  CarlaNativePlugin * self,
+  GArray *            srcs,
+  GArray *            dests)
+{
+  for (guint i = 0;
+       i < MIN (srcs->len, dests->len); i++)
+    {
+      const PatchbayPort * src =
+        &g_array_index (srcs, PatchbayPort, i);
+      const PatchbayPort * dest =
+        &g_array_index (dests, PatchbayPort, i);
+      bool ret =
+        carla_patchbay_connect (
+          self->host_handle, false,
+          src->group_id, src->id,
+          dest->group_id, dest->id);
+      if (!ret)
+        {
+          g_debug (
+            "failed to connect patchbay ports: %s",
+            carla_get_last_error (
+              self->host_handle));
+        }
+    }
+}
+
+/**
+ * Connects the plugin to the inputs and outputs
+ * of the native patchbay plugin.
+ *
+ * Unlike the rack, the patchbay does not connect
+ * the plugin by itself.
+ */
+static void
+connect_patchbay (
+  CarlaNativePlugin * self)
+{
+  /* collect the groups and ports from the
+   * engine callback */
+  self->patchbay_groups =
+    g_array_new (
+      false, true, sizeof (PatchbayGroup));
+  self->patchbay_ports =
+    g_array_new (
+      false, true, sizeof (PatchbayPort));
+  carla_patchbay_refresh (
+    self->host_handle, false);
+
+  GArray * lists[NUM_PATCHBAY_PORT_LISTS];
+  for (int i = 0; i < NUM_PATCHBAY_PORT_LISTS; i++)
+    {
+      lists[i] =
+        g_array_new (
+          false, true, sizeof (PatchbayPort));
+    }
+  for (guint i = 0;
+       i < self->patchbay_ports->len; i++)
+    {
+      const PatchbayPort * port =
+        &g_array_index (
+          self->patchbay_ports, PatchbayPort, i);
+      int list =
+        get_patchbay_port_list (self, port);
+      if (list >= 0)
+        {
+          g_array_append_val (lists[list], *port);
+        }
+    }
+
+  g_message (
+    "%s: connecting %u audio ins and %u audio "
+    "outs in the patchbay", __func__,
+    lists[PATCHBAY_PLUGIN_AUDIO_INS]->len,
+    lists[PATCHBAY_PLUGIN_AUDIO_OUTS]->len);
+  connect_patchbay_ports (
+    self, lists[PATCHBAY_HOST_AUDIO_INS],
+    lists[PATCHBAY_PLUGIN_AUDIO_INS]);
+  connect_patchbay_ports (
+    self, lists[PATCHBAY_PLUGIN_AUDIO_OUTS],
+    lists[PATCHBAY_HOST_AUDIO_OUTS]);
+  connect_patchbay_ports (
+    self, lists[PATCHBAY_HOST_MIDI_INS],
+    lists[PATCHBAY_PLUGIN_MIDI_INS]);
+  connect_patchbay_ports (
+    self, lists[PATCHBAY_PLUGIN_MIDI_OUTS],
+    lists[PATCHBAY_HOST_MIDI_OUTS]);
+
+  for (int i = 0; i < NUM_PATCHBAY_PORT_LISTS; i++)
+    {
+      g_array_free (lists[i], true);
+    }
+  g_array_free (self->patchbay_groups, true);
+  self->patchbay_groups = NULL;
+  g_array_free (self->patchbay_ports, true);
+  self->patchbay_ports = NULL;
+}
+
 void
 carla_native_plugin_populate_banks (
   CarlaNativePlugin * self)
@@ -458,36 +746,26 @@ carla_native_plugin_process (
   const nframes_t     nframes)
 {
 
-  self->time_info.playing =
-    TRANSPORT_IS_ROLLING;
+  TimeInfoSnapshot tmp;
+  const TimeInfoSnapshot * ti =
+    router_get_time_info (
+      ROUTER, g_start_frames, &tmp);
+  self->time_info.playing = ti->rolling;
   self->time_info.frame =
     (uint64_t) g_start_frames;
-  self->time_info.bbt.bar =
-    position_get_bars (PLAYHEAD, true);
-  self->time_info.bbt.beat =
-    position_get_beats (PLAYHEAD, true);
+  self->time_info.bbt.bar = ti->bar;
+  self->time_info.bbt.beat = ti->beat;
   self->time_info.bbt.tick =
-    position_get_sixteenths (PLAYHEAD, true) *
-      TICKS_PER_SIXTEENTH_NOTE +
-    (int) floor (position_get_ticks (PLAYHEAD));
-  Position bar_start;
-  position_set_to_bar (
-    &bar_start,
-    position_get_bars (PLAYHEAD, true));
+    (int) floor (ti->beat_ticks);
   self->time_info.bbt.barStartTick =
-    (double)
-    (PLAYHEAD->ticks - bar_start.ticks);
-  int beats_per_bar =
-    tempo_track_get_beats_per_bar (P_TEMPO_TRACK);
-  int beat_unit =
-    tempo_track_get_beat_unit (P_TEMPO_TRACK);
+    ti->bar_ticks;
   self->time_info.bbt.beatsPerBar =
-    (float) beats_per_bar;
-  self->time_info.bbt.beatType = (float) beat_unit;
+    (float) ti->beats_per_bar;
+  self->time_info.bbt.beatType =
+    (float) ti->beat_unit;
   self->time_info.bbt.ticksPerBeat =
-    TRANSPORT->ticks_per_beat;
-  self->time_info.bbt.beatsPerMinute =
-    tempo_track_get_current_bpm (P_TEMPO_TRACK);
+    ti->ticks_per_beat;
+  self->time_info.bbt.beatsPerMinute = ti->bpm;
 
   const PluginDescriptor * descr =
     self->plugin->setting->descr;
@@ -502,74 +780,51 @@ carla_native_plugin_process (
     case PROT_SFZ:
     case PROT_SF2:
     {
-      float * inbuf[2];
-      float dummy_inbuf1[nframes];
-      memset (
-        dummy_inbuf1, 0, nframes * sizeof (float));
-      float dummy_inbuf2[nframes];
-      memset (
-        dummy_inbuf2, 0, nframes * sizeof (float));
-      float * outbuf[2];
-      float dummy_outbuf1[nframes];
-      memset (
-        dummy_outbuf1, 0, nframes * sizeof (float));
-      float dummy_outbuf2[nframes];
-      memset (
-        dummy_outbuf2, 0, nframes * sizeof (float));
-      int i = 0;
-      int audio_ports = 0;
-      while (i < self->plugin->num_in_ports)
+      const NativePluginDescriptor * native_descr =
+        self->native_plugin_descriptor;
+
+      /* pass the audio ports in order and use
+       * the shared buffers for the rest of the
+       * channels */
+      int i;
+      uint32_t num_ins = 0;
+      for (i = 0;
+           i < self->plugin->num_in_ports &&
+             num_ins < native_descr->audioIns;
+           i++)
         {
           Port * port = self->plugin->in_ports[i];
           if (port->id.type == TYPE_AUDIO)
             {
-              inbuf[audio_ports++] =
-                &self->plugin->in_ports[i]->buf[
-                  local_offset];
+              self->inbufs[num_ins++] =
+                &port->buf[local_offset];
             }
-          if (audio_ports == 2)
-            break;
-          i++;
         }
-      switch (audio_ports)
+      for (; num_ins < native_descr->audioIns;
+           num_ins++)
         {
-        case 0:
-          inbuf[0] = dummy_inbuf1;
-          inbuf[1] = dummy_inbuf2;
-          break;
-        case 1:
-          inbuf[1] = dummy_inbuf2;
-          break;
-        default:
-          break;
+          self->inbufs[num_ins] =
+            AUDIO_ENGINE->silent_buf;
         }
 
-      i = 0;
-      audio_ports = 0;
-      while (i < self->plugin->num_out_ports)
+      uint32_t num_outs = 0;
+      for (i = 0;
+           i < self->plugin->num_out_ports &&
+             num_outs < native_descr->audioOuts;
+           i++)
         {
           Port * port = self->plugin->out_ports[i];
           if (port->id.type == TYPE_AUDIO)
             {
-              outbuf[audio_ports++] =
-                &self->plugin->out_ports[i]->buf[
-                  local_offset];
+              self->outbufs[num_outs++] =
+                &port->buf[local_offset];
             }
-          if (audio_ports == 2)
-            break;
-          i++;
         }
-      switch (audio_ports)
+      for (; num_outs < native_descr->audioOuts;
+           num_outs++)
         {
-        case 0:
-          outbuf[0] = dummy_outbuf1;
-          outbuf[1] = dummy_outbuf2;
-          break;
-        case 1:
-          outbuf[1] = dummy_outbuf2;
-          break;
-        default:
-          break;
+          self->outbufs[num_outs] =
+            AUDIO_ENGINE->scratch_buf;
         }
 
       /* get main midi port */
@@ -650,9 +905,9 @@ carla_native_plugin_process (
         }
 
       /*g_warn_if_reached ();*/
-      self->native_plugin_descriptor->process (
-        self->native_plugin_handle, inbuf, outbuf,
-        nframes, events,
+      native_descr->process (
+        self->native_plugin_handle, self->inbufs,
+        self->outbufs, nframes, events,
         (uint32_t) num_events_written);
       }
       break;
@@ -1145,9 +1400,17 @@ carla_native_plugin_instantiate (
 
   self->time_info.bbt.valid = 1;
 
+  /* use a patchbay if the plugin has more than
+   * 2 channels */
+  const PluginSetting * setting =
+    self->plugin->setting;
+  const PluginDescriptor * descr = setting->descr;
+  self->carla_type = get_carla_type (descr);
+
   /* instantiate the plugin to get its info */
   self->native_plugin_descriptor =
-    carla_get_native_rack_plugin ();
+    get_native_plugin_descriptor (
+      self->carla_type);
   self->native_plugin_handle =
     self->native_plugin_descriptor->instantiate (
       &self->native_host_descriptor);
@@ -1209,11 +1472,8 @@ carla_native_plugin_instantiate (
         NULL);
     }
 
-  const PluginSetting * setting =
-    self->plugin->setting;
   g_return_val_if_fail (
     setting->open_with_carla, -1);
-  const PluginDescriptor * descr = setting->descr;
   g_message (
     "%s: using bridge mode %s", __func__,
     carla_bridge_mode_strings[
@@ -1317,7 +1577,10 @@ carla_native_plugin_instantiate (
     self->host_handle, 0, \
     PLUGIN_OPTION_##x, true)
 
-  ENABLE_OPTION (FORCE_STEREO);
+  if (self->carla_type == CARLA_PLUGIN_RACK)
+    {
+      ENABLE_OPTION (FORCE_STEREO);
+    }
   ENABLE_OPTION (SEND_CONTROL_CHANGES);
   ENABLE_OPTION (SEND_CHANNEL_PRESSURE);
   ENABLE_OPTION (SEND_NOTE_AFTERTOUCH);
@@ -1331,6 +1594,24 @@ carla_native_plugin_instantiate (
   carla_set_engine_callback (
     self->host_handle, engine_callback, self);
 
+  if (self->carla_type != CARLA_PLUGIN_RACK)
+    {
+      connect_patchbay (self);
+    }
+
+  /* preallocate the buffer lists for
+   * processing */
+  object_zero_and_free (self->inbufs);
+  self->inbufs =
+    object_new_n (
+      self->native_plugin_descriptor->audioIns,
+      float *);
+  object_zero_and_free (self->outbufs);
+  self->outbufs =
+    object_new_n (
+      self->native_plugin_descriptor->audioOuts,
+      float *);
+
   if (use_state_file)
     {
       /* load the state */
@@ -1764,6 +2045,9 @@ carla_native_plugin_close (
       carla_host_handle_free (self->host_handle);
       self->host_handle = NULL;
     }
+
+  object_zero_and_free (self->inbufs);
+  object_zero_and_free (self->outbufs);
 }
 
 /**
@@ -35,9 +35,13 @@
 */
 
 #include "audio/engine.h"
+#include "audio/track.h"
 #include "plugins/lv2_plugin.h"
 #include "plugins/lv2/lv2_worker.h"
+#include "plugins/lv2/lv2_worker_pool.h"
+#include "plugins/plugin_manager.h"
 #include "project.h"
+#include "zrythm.h"
 #include "zrythm_app.h"
 
 static LV2_Worker_Status
@@ -47,6 +51,12 @@ lv2_worker_respond (
   const void*               data)
 {
   Lv2Worker* worker = (Lv2Worker*)handle;
+  if (zix_ring_write_space (worker->responses) <
+        sizeof (size) + size)
+    {
+      return LV2_WORKER_ERR_NO_SPACE;
+    }
+
   zix_ring_write (
     worker->responses, (const char*)&size,
     sizeof(size));
@@ -56,51 +66,72 @@ lv2_worker_respond (
 }
 
 /**
- * Worker logic running in a separate thread (if
- * worker is threaded).
+ * Runs the next pending request of a threaded
+ * worker.
+ *
+ * To be called by the worker pool from the thread
+ * that dequeued the worker.
+ *
+ * @return Whether there are more pending
+ *   requests (in which case the worker must be
+ *   queued again).
  */
-static void*
-worker_func (void* data)
+bool
+lv2_worker_run_next_request (
+  Lv2Worker * worker)
 {
-  Lv2Worker* worker = (Lv2Worker*)data;
-  Lv2Plugin*       plugin   = worker->plugin;
-  void*       buf    = NULL;
-  while (true) {
-    zix_sem_wait(&worker->sem);
-    if (plugin->exit) {
-      break;
-    }
+  Lv2Plugin * plugin = worker->plugin;
 
-    uint32_t size = 0;
-    zix_ring_read (
-      worker->requests, (char*)&size, sizeof(size));
+  /* the request arena is as large as the ring so
+   * any request fits (see
+   * lv2_worker_schedule()) */
+  uint32_t size = 0;
+  zix_ring_read (
+    worker->requests, (char*)&size, sizeof(size));
+  zix_ring_read (
+    worker->requests, (char*)worker->request,
+    size);
 
-    if (!(buf = realloc (buf, size))) {
-      g_warning ("error: realloc() failed");
-      free (buf);
-      return NULL;
+  /* still consume the request when exiting so
+   * that lv2_worker_finish() can return */
+  if (!plugin->exit)
+    {
+      zix_sem_wait (&plugin->work_lock);
+      if (DEBUGGING)
+        {
+          char pl_str[700];
+          plugin_print (plugin->plugin, pl_str, 700);
+          g_debug (
+            "running work (threaded) for plugin %s",
+            pl_str);
+        }
+      worker->iface->work (
+        plugin->instance->lv2_handle,
+        lv2_worker_respond, worker, size,
+        worker->request);
+      zix_sem_post (&plugin->work_lock);
     }
 
-    zix_ring_read (
-      worker->requests, (char*)buf, size);
-
-    zix_sem_wait (&plugin->work_lock);
-    char pl_str[700];
-    plugin_print (plugin->plugin, pl_str, 700);
-    if (DEBUGGING)
-      {
-        g_debug (
-          "running work (threaded) for plugin %s",
-          pl_str);
-      }
-    worker->iface->work (
-      plugin->instance->lv2_handle,
-      lv2_worker_respond, worker, size, buf);
-    zix_sem_post (&plugin->work_lock);
-  }
-
-  free(buf);
-  return NULL;
+  return
+    !g_atomic_int_dec_and_test (
+      &worker->num_pending);
+}
+
+/**
+ * Returns whether the worker's plugin is on an
+ * audible track, in which case its work is
+ * prioritized.
+ */
+bool
+lv2_worker_is_audible (
+  Lv2Worker * worker)
+{
+  Plugin * pl = worker->plugin->plugin;
+  Track * track = pl ? pl->track : NULL;
+  return
+    track && track->channel
+    && track_is_enabled (track)
+    && !track_get_muted (track);
 }
 
 void
@@ -118,13 +149,30 @@ lv2_worker_init (
   worker->threaded = threaded;
   if (threaded)
     {
-      zix_thread_create (
-        &worker->thread, 4096, worker_func, worker);
-      worker->requests = zix_ring_new (4096);
+      worker->requests =
+        zix_ring_new (LV2_WORKER_RING_SIZE);
       zix_ring_mlock (worker->requests);
+      worker->request =
+        malloc (LV2_WORKER_RING_SIZE);
+      g_atomic_int_set (&worker->num_pending, 0);
+      if (!lv2_worker_pool_add_worker (
+             PLUGIN_MANAGER->lv2_worker_pool,
+             worker))
+        {
+          g_warning (
+            "too many LV2 workers, work for %s "
+            "will run in the processing thread",
+            plugin->plugin->setting->descr->name);
+          worker->threaded = false;
+          zix_ring_free (worker->requests);
+          worker->requests = NULL;
+          free (worker->request);
+          worker->request = NULL;
+        }
     }
-  worker->responses = zix_ring_new (4096);
-  worker->response  = malloc (4096);
+  worker->responses =
+    zix_ring_new (LV2_WORKER_RING_SIZE);
+  worker->response  = malloc (LV2_WORKER_RING_SIZE);
   zix_ring_mlock (worker->responses);
 }
 
@@ -134,15 +182,22 @@ lv2_worker_init (
 void
 lv2_worker_finish(Lv2Worker* worker)
 {
-  if (worker->requests) {
-    if (worker->threaded) {
-      zix_sem_post(&worker->sem);
-      zix_thread_join(worker->thread, NULL);
-      zix_ring_free(worker->requests);
+  if (worker->requests)
+    {
+      lv2_worker_pool_remove_worker (
+        PLUGIN_MANAGER->lv2_worker_pool, worker);
+      zix_ring_free (worker->requests);
+      worker->requests = NULL;
+      free (worker->request);
+      worker->request = NULL;
+    }
+  if (worker->responses)
+    {
+      zix_ring_free (worker->responses);
+      worker->responses = NULL;
+      free (worker->response);
+      worker->response = NULL;
     }
-    zix_ring_free(worker->responses);
-    free(worker->response);
-  }
 }
 
 /**
@@ -184,13 +239,27 @@ lv2_worker_schedule (
   else
     {
       /* Schedule a request to be executed by the
-       * worker thread */
+       * worker pool */
+      if (zix_ring_write_space (worker->requests) <
+            sizeof (size) + size)
+        {
+          return LV2_WORKER_ERR_NO_SPACE;
+        }
       zix_ring_write (
         worker->requests, (const char*)&size,
         sizeof(size));
       zix_ring_write (
         worker->requests, (const char*)data, size);
-      zix_sem_post (&worker->sem);
+
+      /* queue the worker unless it's already
+       * queued or running */
+      if (g_atomic_int_add (
+            &worker->num_pending, 1) == 0)
+        {
+          lv2_worker_pool_push (
+            PLUGIN_MANAGER->lv2_worker_pool,
+            worker);
+        }
     }
   return LV2_WORKER_SUCCESS;
 }
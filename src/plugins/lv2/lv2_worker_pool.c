@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-config.h"
+
+#include "plugins/lv2/lv2_worker.h"
+#include "plugins/lv2/lv2_worker_pool.h"
+#include "utils/mpmc_queue.h"
+#include "utils/objects.h"
+
+#include <glib.h>
+
+static void
+record_job (
+  Lv2WorkerPool * self,
+  gint64          wake_latency,
+  bool            priority,
+  int             num_busy)
+{
+  g_mutex_lock (&self->stats_lock);
+  if (self->num_jobs == 0 ||
+      wake_latency < self->min_wake_latency)
+    {
+      self->min_wake_latency = wake_latency;
+    }
+  if (wake_latency > self->max_wake_latency)
+    {
+      self->max_wake_latency = wake_latency;
+    }
+  self->total_wake_latency += wake_latency;
+  self->num_jobs++;
+  if (priority)
+    {
+      self->num_priority_jobs++;
+    }
+  if (num_busy > self->max_busy_threads)
+    {
+      self->max_busy_threads = num_busy;
+    }
+  g_mutex_unlock (&self->stats_lock);
+}
+
+static void *
+thread_func (
+  void * data)
+{
+  Lv2WorkerPool * self = (Lv2WorkerPool *) data;
+
+  for (;;)
+    {
+      zix_sem_wait (&self->sem);
+      if (g_atomic_int_get (&self->terminate))
+        break;
+
+      /* there is one post per queued worker, but
+       * another thread may have taken the worker
+       * this post was for from the other queue */
+      Lv2Worker * worker = NULL;
+      bool priority = true;
+      if (!mpmc_queue_dequeue (
+             self->priority_queue,
+             (void **) &worker))
+        {
+          priority = false;
+          if (!mpmc_queue_dequeue (
+                 self->queue, (void **) &worker))
+            {
+              continue;
+            }
+        }
+
+      gint64 wake_latency =
+        g_get_monotonic_time () -
+        worker->queued_time;
+      int num_busy =
+        g_atomic_int_add (
+          &self->num_busy_threads, 1) + 1;
+
+      /* after this returns false the worker may
+       * be freed, so it must not be accessed */
+      bool more =
+        lv2_worker_run_next_request (worker);
+      if (more)
+        {
+          /* queue it again instead of running all
+           * its requests so that other plugins get
+           * a chance */
+          lv2_worker_pool_push (self, worker);
+        }
+
+      g_atomic_int_dec_and_test (
+        &self->num_busy_threads);
+      record_job (
+        self, wake_latency, priority, num_busy);
+    }
+
+  return NULL;
+}
+
+static void
+start_threads (
+  Lv2WorkerPool * self)
+{
+  int num_threads =
+    CLAMP (
+      (int) g_get_num_processors () / 2, 1,
+      LV2_WORKER_POOL_MAX_THREADS);
+  for (int i = 0; i < num_threads; i++)
+    {
+      char * name =
+        g_strdup_printf ("lv2-worker-%d", i);
+      self->threads[i] =
+        g_thread_new (name, thread_func, self);
+      g_free (name);
+    }
+  self->num_threads = num_threads;
+
+  g_message (
+    "started %d LV2 worker threads",
+    num_threads);
+}
+
+Lv2WorkerPool *
+lv2_worker_pool_new (void)
+{
+  Lv2WorkerPool * self =
+    object_new (Lv2WorkerPool);
+
+  self->priority_queue = mpmc_queue_new ();
+  mpmc_queue_reserve (
+    self->priority_queue,
+    LV2_WORKER_POOL_MAX_WORKERS);
+  self->queue = mpmc_queue_new ();
+  mpmc_queue_reserve (
+    self->queue, LV2_WORKER_POOL_MAX_WORKERS);
+
+  zix_sem_init (&self->sem, 0);
+  g_mutex_init (&self->stats_lock);
+
+  return self;
+}
+
+/**
+ * Registers a threaded worker, starting the
+ * threads if not started yet.
+ *
+ * @return Whether successful. If false, the worker
+ *   should run its work immediately instead.
+ */
+bool
+lv2_worker_pool_add_worker (
+  Lv2WorkerPool * self,
+  Lv2Worker *     worker)
+{
+  g_return_val_if_fail (
+    !g_atomic_int_get (&self->terminate), false);
+
+  if (g_atomic_int_add (&self->num_workers, 1) >=
+        LV2_WORKER_POOL_MAX_WORKERS)
+    {
+      g_atomic_int_dec_and_test (
+        &self->num_workers);
+      return false;
+    }
+
+  /* workers are only added from the GTK thread */
+  if (self->num_threads == 0)
+    {
+      start_threads (self);
+    }
+
+  return true;
+}
+
+/**
+ * Waits for the pending requests of the worker to
+ * be consumed and unregisters it.
+ *
+ * The plugin must not schedule any more work.
+ */
+void
+lv2_worker_pool_remove_worker (
+  Lv2WorkerPool * self,
+  Lv2Worker *     worker)
+{
+  /* the requests are skipped once the plugin is
+   * exiting so this shouldn't take long */
+  while (g_atomic_int_get (&worker->num_pending) > 0)
+    {
+      g_usleep (100);
+    }
+
+  g_atomic_int_dec_and_test (&self->num_workers);
+}
+
+/**
+ * Queues a worker that has new requests.
+ *
+ * This is realtime-safe.
+ */
+void
+lv2_worker_pool_push (
+  Lv2WorkerPool * self,
+  Lv2Worker *     worker)
+{
+  worker->queued_time = g_get_monotonic_time ();
+  MPMCQueue * queue =
+    lv2_worker_is_audible (worker) ?
+      self->priority_queue : self->queue;
+
+  /* can't fail since each worker is queued at
+   * most once and there can't be more workers
+   * than the queue size */
+  int ret = mpmc_queue_push_back (queue, worker);
+  g_warn_if_fail (ret);
+
+  zix_sem_post (&self->sem);
+}
+
+/**
+ * Fills in the statistics since the last reset.
+ */
+void
+lv2_worker_pool_get_stats (
+  Lv2WorkerPool *      self,
+  Lv2WorkerPoolStats * stats)
+{
+  g_mutex_lock (&self->stats_lock);
+  stats->num_threads = self->num_threads;
+  stats->num_workers =
+    g_atomic_int_get (&self->num_workers);
+  stats->num_jobs = self->num_jobs;
+  stats->num_priority_jobs =
+    self->num_priority_jobs;
+  stats->max_busy_threads = self->max_busy_threads;
+  stats->min_wake_latency = self->min_wake_latency;
+  stats->avg_wake_latency =
+    self->num_jobs > 0 ?
+      self->total_wake_latency / self->num_jobs : 0;
+  stats->max_wake_latency = self->max_wake_latency;
+  g_mutex_unlock (&self->stats_lock);
+}
+
+/**
+ * Resets the statistics.
+ */
+void
+lv2_worker_pool_reset_stats (
+  Lv2WorkerPool * self)
+{
+  g_mutex_lock (&self->stats_lock);
+  self->num_jobs = 0;
+  self->num_priority_jobs = 0;
+  self->max_busy_threads = 0;
+  self->min_wake_latency = 0;
+  self->total_wake_latency = 0;
+  self->max_wake_latency = 0;
+  g_mutex_unlock (&self->stats_lock);
+}
+
+/**
+ * Stops the threads and frees the pool.
+ *
+ * All workers must have been removed.
+ */
+void
+lv2_worker_pool_free (
+  Lv2WorkerPool * self)
+{
+  g_warn_if_fail (
+    g_atomic_int_get (&self->num_workers) == 0);
+
+  g_atomic_int_set (&self->terminate, 1);
+  for (int i = 0; i < self->num_threads; i++)
+    {
+      zix_sem_post (&self->sem);
+    }
+  for (int i = 0; i < self->num_threads; i++)
+    {
+      g_thread_join (self->threads[i]);
+    }
+
+  object_free_w_func_and_null (
+    mpmc_queue_free, self->priority_queue);
+  object_free_w_func_and_null (
+    mpmc_queue_free, self->queue);
+  zix_sem_destroy (&self->sem);
+  g_mutex_clear (&self->stats_lock);
+
+  object_zero_and_free (self);
+}
@@ -81,6 +81,7 @@
 
 #include "audio/engine.h"
 #include "audio/midi_event.h"
+#include "audio/router.h"
 #include "audio/tempo_track.h"
 #include "audio/transport.h"
 #include "gui/backend/event.h"
@@ -396,6 +397,7 @@ create_port (
         {
           g_return_val_if_fail (
             IS_PORT_AND_NONNULL (port), NULL);
+          port_restore_own_buf (port);
           port->buf =
             g_realloc (
               port->buf,
@@ -2652,8 +2654,6 @@ lv2_plugin_instantiate (
 
   /*zix_sem_init (&self->exit_sem, 0);*/
 
-  zix_sem_init(&self->worker.sem, 0);
-
   /* Load preset, if specified */
   if (!state)
     {
@@ -3378,14 +3378,17 @@ lv2_plugin_process (
   g_return_if_fail (
     pl->instantiated && pl->activated);
 
+  TimeInfoSnapshot tmp;
+  const TimeInfoSnapshot * ti =
+    router_get_time_info (
+      ROUTER, g_start_frames, &tmp);
+
   /* If transport state is not as expected, then
    * something has changed */
   const bool xport_changed =
-    self->rolling != (TRANSPORT_IS_ROLLING) ||
+    self->rolling != ti->rolling ||
     self->gframes != g_start_frames ||
-    !math_floats_equal (
-      self->bpm,
-      tempo_track_get_current_bpm (P_TEMPO_TRACK));
+    !math_floats_equal (self->bpm, ti->bpm);
 # if 0
   if (xport_changed)
     {
@@ -3395,86 +3398,20 @@ lv2_plugin_process (
         "bpm %f %f",
         self->rolling,
         self->gframes, g_start_frames,
-        (double) self->bpm,
-        (double)
-          tempo_track_get_current_bpm (
-            P_TEMPO_TRACK));
+        (double) self->bpm, (double) ti->bpm);
     }
 #endif
 
   /* let the plugin know if transport state
-   * changed */
-  uint8_t   pos_buf[256];
-  LV2_Atom * lv2_pos = (LV2_Atom*) pos_buf;
-  if (xport_changed && self->want_position)
-    {
-      /* Build an LV2 position object to report
-       * change to plugin */
-      Position start_pos;
-      position_from_frames (
-        &start_pos, g_start_frames);
-      LV2_Atom_Forge * forge = &self->dsp_forge;
-      lv2_atom_forge_set_buffer (
-        forge, pos_buf, sizeof(pos_buf));
-      LV2_Atom_Forge_Frame frame;
-      lv2_atom_forge_object (
-        forge, &frame, 0,
-        PM_URIDS.time_Position);
-      lv2_atom_forge_key (
-        forge, PM_URIDS.time_frame);
-      lv2_atom_forge_long (
-        forge, g_start_frames);
-      lv2_atom_forge_key (
-        forge, PM_URIDS.time_speed);
-      lv2_atom_forge_float (
-        forge,
-        TRANSPORT->play_state == PLAYSTATE_ROLLING ?
-          1.0 : 0.0);
-      lv2_atom_forge_key (
-        forge, PM_URIDS.time_barBeat);
-      int bars =
-        position_get_bars (&start_pos, true);
-      int beats =
-        position_get_beats (&start_pos, true);
-      double ticks =
-        position_get_ticks (&start_pos);
-      lv2_atom_forge_float (
-        forge,
-        ((float) beats - 1) +
-        ((float) ticks /
-          (float) TRANSPORT->ticks_per_beat));
-      lv2_atom_forge_key (
-        forge, PM_URIDS.time_bar);
-      lv2_atom_forge_long (
-        forge, bars - 1);
-      lv2_atom_forge_key (
-        forge, PM_URIDS.time_beatUnit);
-      int beats_per_bar =
-        tempo_track_get_beats_per_bar (
-          P_TEMPO_TRACK);
-      int beat_unit =
-        tempo_track_get_beat_unit (P_TEMPO_TRACK);
-      lv2_atom_forge_int (forge, beat_unit);
-      lv2_atom_forge_key (
-        forge, PM_URIDS.time_beatsPerBar);
-      lv2_atom_forge_float (
-        forge, (float) beats_per_bar);
-      lv2_atom_forge_key (
-        forge, PM_URIDS.time_beatsPerMinute);
-      lv2_atom_forge_float (
-        forge,
-        tempo_track_get_current_bpm (
-          P_TEMPO_TRACK));
-    }
+   * changed (the position object is prebuilt in
+   * the snapshot) */
+  const LV2_Atom * lv2_pos = &ti->lv2_pos.atom;
 
   /* Update transport state to expected values for
    * next cycle */
-  if (TRANSPORT_IS_ROLLING)
+  if (ti->rolling)
     {
-      Position gpos;
-      position_from_frames (
-        &gpos, g_start_frames + nframes);
-      self->gframes = gpos.frames;
+      self->gframes = g_start_frames + nframes;
       self->rolling = 1;
     }
   else
@@ -3482,8 +3419,7 @@ lv2_plugin_process (
       self->gframes = g_start_frames;
       self->rolling = 0;
     }
-  self->bpm =
-    tempo_track_get_current_bpm (P_TEMPO_TRACK);
+  self->bpm = ti->bpm;
 
   /* Prepare port buffers */
   for (int p = 0; p < pl->num_lilv_ports; ++p)
@@ -3524,7 +3460,7 @@ lv2_plugin_process (
                 &iter, 0, 0,
                 lv2_pos->type, lv2_pos->size,
                 (const uint8_t*)
-                  LV2_ATOM_BODY (lv2_pos));
+                  LV2_ATOM_BODY_CONST (lv2_pos));
             }
 
           if (self->request_update)
@@ -3859,8 +3795,9 @@ lv2_plugin_free (
   /*zix_sem_wait (&self->exit_sem);*/
   self->exit = true;
 
-  /* Terminate the worker */
+  /* Terminate the workers */
   lv2_worker_finish (&self->worker);
+  lv2_worker_finish (&self->state_worker);
 
   /* Deactivate suil instance */
   object_free_w_func_and_null (
@@ -45,8 +45,10 @@
 #include "plugins/cached_plugin_descriptors.h"
 #include "plugins/carla/carla_discovery.h"
 #include "plugins/collections.h"
+#include "plugins/lv2/lv2_worker_pool.h"
 #include "plugins/plugin.h"
 #include "plugins/plugin_manager.h"
+#include "plugins/plugin_search_index.h"
 #include "plugins/lv2_plugin.h"
 #include "settings/settings.h"
 #include "utils/arrays.h"
@@ -426,6 +428,7 @@ plugin_manager_new (void)
   create_and_load_lilv_word (self);
   init_symap (self);
   load_bundled_lv2_plugins (self);
+  self->lv2_worker_pool = lv2_worker_pool_new ();
 
   /* init vst/dssi/ladspa */
   self->cached_plugin_descriptors =
@@ -1157,7 +1160,10 @@ plugin_manager_scan_plugins (
   self->lilv_plugins = lilv_plugins;
 
   if (getenv ("ZRYTHM_SKIP_PLUGIN_SCAN"))
-    return;
+    {
+      plugin_manager_update_search_index (self);
+      return;
+    }
 
   double size =
     (double) lilv_plugins_size (lilv_plugins);
@@ -1381,9 +1387,30 @@ plugin_manager_scan_plugins (
     "%s: %d Plugins scanned.",
     __func__, self->plugin_descriptors->len);
 
+  plugin_manager_update_search_index (self);
+
   /*print_plugins ();*/
 }
 
+/**
+ * Rebuilds the search index from the current
+ * plugin descriptors.
+ *
+ * This is done after scanning, so it only needs
+ * to be called if the descriptors are changed
+ * afterwards.
+ */
+void
+plugin_manager_update_search_index (
+  PluginManager * self)
+{
+  object_free_w_func_and_null (
+    plugin_search_index_free, self->search_index);
+  self->search_index =
+    plugin_search_index_new (
+      self->plugin_descriptors);
+}
+
 /**
  * Returns the PluginDescriptor instance for the
  * given URI.
@@ -1468,6 +1495,10 @@ void
 plugin_manager_clear_plugins (
   PluginManager * self)
 {
+  /* the index points to the descriptors */
+  object_free_w_func_and_null (
+    plugin_search_index_free, self->search_index);
+
   g_ptr_array_remove_range (
     self->plugin_descriptors,
     0, self->plugin_descriptors->len);
@@ -1486,6 +1517,9 @@ plugin_manager_free (
 {
   g_message ("%s: Freeing...", __func__);
 
+  object_free_w_func_and_null (
+    lv2_worker_pool_free, self->lv2_worker_pool);
+
   symap_free (self->symap);
   zix_sem_destroy (&self->symap_lock);
 
@@ -1501,6 +1535,8 @@ plugin_manager_free (
   object_free_w_func_and_null (
     lilv_world_free, self->lilv_world);
 
+  object_free_w_func_and_null (
+    plugin_search_index_free, self->search_index);
   g_ptr_array_unref (self->plugin_descriptors);
 
   object_free_w_func_and_null (
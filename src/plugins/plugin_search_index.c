@@ -0,0 +1,499 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "plugins/collection.h"
+#include "plugins/plugin_descriptor.h"
+#include "plugins/plugin_search_index.h"
+#include "utils/objects.h"
+
+/** Maximum length of an indexed n-gram. */
+#define MAX_NGRAM_LEN 3
+
+static inline void
+bitset_set (
+  uint64_t * bits,
+  int        idx)
+{
+  bits[idx / 64] |= (uint64_t) 1 << (idx % 64);
+}
+
+static inline void
+bitset_clear (
+  uint64_t * bits,
+  int        idx)
+{
+  bits[idx / 64] &= ~((uint64_t) 1 << (idx % 64));
+}
+
+/**
+ * Packs the first @p len bytes of @p str into a
+ * hash table key.
+ */
+static inline gpointer
+get_ngram_key (
+  const char * str,
+  size_t       len)
+{
+  guint key = (guint) len << 24;
+  for (size_t i = 0; i < len; i++)
+    {
+      key |=
+        (guint) (unsigned char) str[i] << (i * 8);
+    }
+  return GUINT_TO_POINTER (key);
+}
+
+static void
+add_ngrams (
+  PluginSearchIndex * self,
+  const char *        key,
+  int                 idx)
+{
+  size_t len = strlen (key);
+  for (size_t i = 0; i < len; i++)
+    {
+      for (size_t n = 1;
+           n <= MAX_NGRAM_LEN && i + n <= len; n++)
+        {
+          gpointer ngram_key =
+            get_ngram_key (&key[i], n);
+          GArray * postings =
+            g_hash_table_lookup (
+              self->ngrams, ngram_key);
+          if (!postings)
+            {
+              postings =
+                g_array_new (
+                  false, false, sizeof (guint));
+              g_hash_table_insert (
+                self->ngrams, ngram_key, postings);
+            }
+
+          /* descriptors are added in order so
+           * duplicates are at the end */
+          if (postings->len > 0 &&
+              g_array_index (
+                postings, guint,
+                postings->len - 1) == (guint) idx)
+            continue;
+
+          guint uidx = (guint) idx;
+          g_array_append_val (postings, uidx);
+        }
+    }
+}
+
+/**
+ * Builds an index for the given descriptors.
+ *
+ * The descriptors must outlive the index.
+ *
+ * @param descriptors Array of PluginDescriptor.
+ */
+PluginSearchIndex *
+plugin_search_index_new (
+  GPtrArray * descriptors)
+{
+  PluginSearchIndex * self =
+    object_new (PluginSearchIndex);
+
+  self->num_descriptors = (int) descriptors->len;
+  self->num_words =
+    ((size_t) self->num_descriptors + 63) / 64;
+  self->descriptors =
+    object_new_n (
+      (size_t) self->num_descriptors,
+      PluginDescriptor *);
+  self->keys =
+    object_new_n (
+      (size_t) self->num_descriptors, char *);
+  for (int i = 0;
+       i < PLUGIN_SEARCH_INDEX_NUM_CATEGORIES; i++)
+    {
+      self->categories[i] =
+        plugin_search_index_new_bitset (self);
+    }
+  for (int i = 0;
+       i < PLUGIN_SEARCH_INDEX_NUM_PROTOCOLS; i++)
+    {
+      self->protocols[i] =
+        plugin_search_index_new_bitset (self);
+    }
+  for (int i = 0; i < NUM_PLUGIN_SEARCH_TYPES; i++)
+    {
+      self->types[i] =
+        plugin_search_index_new_bitset (self);
+    }
+  self->authors =
+    g_hash_table_new_full (
+      g_str_hash, g_str_equal, g_free, free);
+  self->ngrams =
+    g_hash_table_new_full (
+      NULL, NULL, NULL,
+      (GDestroyNotify) g_array_unref);
+
+  for (int i = 0; i < self->num_descriptors; i++)
+    {
+      PluginDescriptor * descr =
+        g_ptr_array_index (descriptors, (guint) i);
+      self->descriptors[i] = descr;
+
+      if ((int) descr->category >= 0 &&
+          (int) descr->category <
+            PLUGIN_SEARCH_INDEX_NUM_CATEGORIES)
+        {
+          bitset_set (
+            self->categories[descr->category], i);
+        }
+      if ((int) descr->protocol >= 0 &&
+          (int) descr->protocol <
+            PLUGIN_SEARCH_INDEX_NUM_PROTOCOLS)
+        {
+          bitset_set (
+            self->protocols[descr->protocol], i);
+        }
+      if (plugin_descriptor_is_instrument (descr))
+        bitset_set (
+          self->types[PLUGIN_SEARCH_TYPE_INSTRUMENT],
+          i);
+      if (plugin_descriptor_is_effect (descr))
+        bitset_set (
+          self->types[PLUGIN_SEARCH_TYPE_EFFECT], i);
+      if (plugin_descriptor_is_modulator (descr))
+        bitset_set (
+          self->types[PLUGIN_SEARCH_TYPE_MODULATOR],
+          i);
+      if (plugin_descriptor_is_midi_modifier (descr))
+        bitset_set (
+          self->types[
+            PLUGIN_SEARCH_TYPE_MIDI_MODIFIER], i);
+
+      if (descr->author)
+        {
+          uint64_t * author_bits =
+            g_hash_table_lookup (
+              self->authors, descr->author);
+          if (!author_bits)
+            {
+              author_bits =
+                plugin_search_index_new_bitset (
+                  self);
+              g_hash_table_insert (
+                self->authors,
+                g_strdup (descr->author),
+                author_bits);
+            }
+          bitset_set (author_bits, i);
+        }
+
+      /* the parts are separated by newlines so
+       * that queries don't match across them */
+      char * text =
+        g_strdup_printf (
+          "%s\n%s\n%s",
+          descr->name ? descr->name : "",
+          descr->author ? descr->author : "",
+          descr->category_str ?
+            descr->category_str : "");
+      self->keys[i] = g_utf8_casefold (text, -1);
+      g_free (text);
+
+      add_ngrams (self, self->keys[i], i);
+    }
+
+  g_message (
+    "%s: indexed %d descriptors (%u n-grams)",
+    __func__, self->num_descriptors,
+    g_hash_table_size (self->ngrams));
+
+  return self;
+}
+
+/**
+ * Returns a new bitset with no bits set, sized
+ * for this index.
+ *
+ * Must be free'd with free().
+ */
+uint64_t *
+plugin_search_index_new_bitset (
+  PluginSearchIndex * self)
+{
+  /* allocate at least one word so that the
+   * result is never NULL */
+  return
+    object_new_n (
+      MAX (self->num_words, 1), uint64_t);
+}
+
+/**
+ * ANDs @p result with the OR of the given
+ * bitsets.
+ */
+static void
+intersect_with_union (
+  PluginSearchIndex * self,
+  uint64_t *          result,
+  uint64_t **         sets,
+  int                 num_sets)
+{
+  for (size_t w = 0; w < self->num_words; w++)
+    {
+      uint64_t word = 0;
+      for (int i = 0; i < num_sets; i++)
+        {
+          if (sets[i])
+            word |= sets[i][w];
+        }
+      result[w] &= word;
+    }
+}
+
+/**
+ * ANDs @p result with the descriptors in the
+ * posting list of the given n-gram.
+ *
+ * @param tmp Scratch bitset.
+ */
+static void
+intersect_with_ngram (
+  PluginSearchIndex * self,
+  uint64_t *          result,
+  uint64_t *          tmp,
+  const char *        str,
+  size_t              len)
+{
+  GArray * postings =
+    g_hash_table_lookup (
+      self->ngrams, get_ngram_key (str, len));
+  if (!postings)
+    {
+      memset (
+        result, 0,
+        self->num_words * sizeof (uint64_t));
+      return;
+    }
+
+  memset (tmp, 0, self->num_words * sizeof (uint64_t));
+  for (guint i = 0; i < postings->len; i++)
+    {
+      bitset_set (
+        tmp,
+        (int) g_array_index (postings, guint, i));
+    }
+  for (size_t w = 0; w < self->num_words; w++)
+    {
+      result[w] &= tmp[w];
+    }
+}
+
+static void
+filter_by_search (
+  PluginSearchIndex * self,
+  const char *        search,
+  uint64_t *          result)
+{
+  char * query = g_utf8_casefold (search, -1);
+  size_t len = strlen (query);
+  if (len == 0)
+    {
+      g_free (query);
+      return;
+    }
+
+  uint64_t * tmp =
+    plugin_search_index_new_bitset (self);
+  if (len <= MAX_NGRAM_LEN)
+    {
+      /* exact */
+      intersect_with_ngram (
+        self, result, tmp, query, len);
+    }
+  else
+    {
+      for (size_t i = 0; i + MAX_NGRAM_LEN <= len;
+           i++)
+        {
+          intersect_with_ngram (
+            self, result, tmp, &query[i],
+            MAX_NGRAM_LEN);
+        }
+
+      /* the trigrams may appear in a different
+       * order, so check the candidates */
+      for (int i = 0; i < self->num_descriptors; i++)
+        {
+          if (plugin_search_index_bitset_get (
+                result, i) &&
+              !strstr (self->keys[i], query))
+            {
+              bitset_clear (result, i);
+            }
+        }
+    }
+  free (tmp);
+  g_free (query);
+}
+
+/**
+ * Sets the bits of the descriptors matching the
+ * filter in the given bitset and clears the rest.
+ *
+ * @param result A bitset from
+ *   plugin_search_index_new_bitset().
+ *
+ * @return The number of matching descriptors.
+ */
+int
+plugin_search_index_filter (
+  PluginSearchIndex *        self,
+  const PluginSearchFilter * filter,
+  uint64_t *                 result)
+{
+  /* start with everything */
+  memset (
+    result, 0xff,
+    self->num_words * sizeof (uint64_t));
+  if (self->num_descriptors % 64 != 0)
+    {
+      result[self->num_words - 1] =
+        ((uint64_t) 1 <<
+           (self->num_descriptors % 64)) - 1;
+    }
+
+  if (filter->num_categories > 0)
+    {
+      uint64_t * sets[filter->num_categories];
+      for (int i = 0; i < filter->num_categories; i++)
+        {
+          int cat = (int) filter->categories[i];
+          sets[i] =
+            cat >= 0 &&
+            cat < PLUGIN_SEARCH_INDEX_NUM_CATEGORIES ?
+              self->categories[cat] : NULL;
+        }
+      intersect_with_union (
+        self, result, sets, filter->num_categories);
+    }
+
+  if (filter->num_authors > 0)
+    {
+      uint64_t * sets[filter->num_authors];
+      for (int i = 0; i < filter->num_authors; i++)
+        {
+          sets[i] =
+            filter->authors[i] ?
+              g_hash_table_lookup (
+                self->authors, filter->authors[i]) :
+              NULL;
+        }
+      intersect_with_union (
+        self, result, sets, filter->num_authors);
+    }
+
+  if (filter->num_protocols > 0)
+    {
+      uint64_t * sets[filter->num_protocols];
+      for (int i = 0; i < filter->num_protocols; i++)
+        {
+          int prot = (int) filter->protocols[i];
+          sets[i] =
+            prot >= 0 &&
+            prot < PLUGIN_SEARCH_INDEX_NUM_PROTOCOLS ?
+              self->protocols[prot] : NULL;
+        }
+      intersect_with_union (
+        self, result, sets, filter->num_protocols);
+    }
+
+  for (int i = 0; i < NUM_PLUGIN_SEARCH_TYPES; i++)
+    {
+      if (filter->types[i])
+        {
+          intersect_with_union (
+            self, result, &self->types[i], 1);
+        }
+    }
+
+  if (filter->search)
+    {
+      filter_by_search (
+        self, filter->search, result);
+    }
+
+  /* collections are checked last since this is
+   * done per descriptor */
+  int count = 0;
+  for (int i = 0; i < self->num_descriptors; i++)
+    {
+      if (!plugin_search_index_bitset_get (
+             result, i))
+        continue;
+
+      if (filter->collection &&
+          !plugin_collection_contains_descriptor (
+            filter->collection,
+            self->descriptors[i], false))
+        {
+          bitset_clear (result, i);
+          continue;
+        }
+
+      count++;
+    }
+
+  return count;
+}
+
+void
+plugin_search_index_free (
+  PluginSearchIndex * self)
+{
+  for (int i = 0;
+       i < PLUGIN_SEARCH_INDEX_NUM_CATEGORIES; i++)
+    {
+      free (self->categories[i]);
+    }
+  for (int i = 0;
+       i < PLUGIN_SEARCH_INDEX_NUM_PROTOCOLS; i++)
+    {
+      free (self->protocols[i]);
+    }
+  for (int i = 0; i < NUM_PLUGIN_SEARCH_TYPES; i++)
+    {
+      free (self->types[i]);
+    }
+  for (int i = 0; i < self->num_descriptors; i++)
+    {
+      g_free (self->keys[i]);
+    }
+  free (self->keys);
+  free (self->descriptors);
+  object_free_w_func_and_null (
+    g_hash_table_destroy, self->authors);
+  object_free_w_func_and_null (
+    g_hash_table_destroy, self->ngrams);
+
+  object_zero_and_free (self);
+}
@@ -826,14 +826,6 @@ project_create_default (
     NOTE_LENGTH_1_8);
   clip_editor_init (self->clip_editor);
   timeline_init (self->timeline);
-  snap_grid_update_snap_points_default (
-    self->snap_grid_timeline);
-  snap_grid_update_snap_points_default (
-    self->snap_grid_editor);
-  quantize_options_update_quantize_points (
-    self->quantize_opts_timeline);
-  quantize_options_update_quantize_points (
-    self->quantize_opts_editor);
 
   if (have_ui)
     {
@@ -961,7 +953,16 @@ load (
         g_free (PROJECT->backup_dir);
       PROJECT->backup_dir =
         get_newer_backup (PROJECT);
-      if (PROJECT->backup_dir)
+      if (PROJECT->backup_dir && !ZRYTHM_HAVE_UI)
+        {
+          /* nobody to ask, so use the project as
+           * it was last saved */
+          g_message (
+            "ignoring newer backup %s",
+            PROJECT->backup_dir);
+          g_free_and_null (PROJECT->backup_dir);
+        }
+      else if (PROJECT->backup_dir)
         {
           g_message (
             "newer backup found %s",
@@ -1191,15 +1192,6 @@ load (
   tracklist_selections_init_loaded (
     self->tracklist_selections);
 
-  snap_grid_update_snap_points_default (
-    self->snap_grid_timeline);
-  snap_grid_update_snap_points_default (
-    self->snap_grid_editor);
-  quantize_options_update_quantize_points (
-    self->quantize_opts_timeline);
-  quantize_options_update_quantize_points (
-    self->quantize_opts_editor);
-
   region_link_group_manager_init_loaded (
     self->region_link_group_manager);
   port_connections_manager_init_loaded (
@@ -1263,6 +1255,10 @@ load (
  * @param is_template Load the project as a
  *   template and create a new project from it.
  *
+ * Without a UI, newer backups are ignored and
+ * failing to load the file is an error (instead
+ * of offering to create a new project).
+ *
  * @return 0 if successful, non-zero otherwise.
  */
 int
@@ -1277,7 +1273,13 @@ project_load (
   if (filename)
     {
       int ret = load (filename, is_template);
-      if (ret)
+      if (ret && !ZRYTHM_HAVE_UI)
+        {
+          g_warning (
+            "failed to load project %s", filename);
+          return -1;
+        }
+      else if (ret)
         {
           ui_show_error_message (
             NULL,
@@ -1561,8 +1563,13 @@ project_save_data_free (
   ProjectSaveData * self)
 {
   g_free_and_null (self->project_file_path);
-  object_free_w_func_and_null (
-    project_free, self->project);
+  if (self->project)
+    {
+      /* shared with the live project */
+      self->project->undo_manager = NULL;
+      object_free_w_func_and_null (
+        project_free, self->project);
+    }
 
   object_zero_and_free (self);
 }
@@ -1635,7 +1642,10 @@ serialize_project_thread (
     "%s: successfully saved project", __func__);
 
 serialize_end:
-  zix_sem_post (&UNDO_MANAGER->action_sem);
+  if (data->async)
+    {
+      zix_sem_post (&UNDO_MANAGER->action_sem);
+    }
   data->finished = true;
   return NULL;
 }
@@ -1700,7 +1710,11 @@ project_save (
   const bool   show_notification,
   const bool   async)
 {
-  /* pause engine */
+  /* pause engine - it stays paused while the
+   * plugin states are saved and the project
+   * (except for the undo history) is deep-cloned
+   * below, so this still grows with the size of
+   * the project */
   EngineState state;
   bool engine_paused = false;
   if (AUDIO_ENGINE->activated)
@@ -1935,10 +1949,25 @@ project_save (
       self, PROJECT_PATH_PROJECT_FILE, is_backup);
   data->show_notification = show_notification;
   data->is_backup = is_backup;
-  data->project = project_clone (PROJECT);
+  data->async = async;
+
+  /* the undo history can be larger than the rest
+   * of the project, so it is shared instead of
+   * cloned. it can't change until serialization
+   * finishes since the undo manager is locked (or
+   * this is all done in this thread) */
+  data->project = project_clone (PROJECT, true);
   data->project->tracklist_selections->free_tracks =
     true;
 
+  /* the clone doesn't depend on the engine so it
+   * can keep running while serializing */
+  if (engine_paused)
+    {
+      engine_resume (AUDIO_ENGINE, &state);
+      engine_paused = false;
+    }
+
   if (async)
     {
       g_thread_new (
@@ -1984,11 +2013,6 @@ project_save (
   if (ZRYTHM_TESTING)
     tracklist_validate (self->tracklist);
 
-  if (engine_paused)
-    {
-      engine_resume (AUDIO_ENGINE, &state);
-    }
-
   RETURN_OK;
 }
 
@@ -1996,10 +2020,17 @@ project_save (
  * Deep-clones the given project.
  *
  * To be used during save on the main thread.
+ *
+ * @param share_undo_manager Whether to reference
+ *   the undo manager of @p src instead of cloning
+ *   it. The caller must make sure that it does
+ *   not change while the clone is used and unset
+ *   it before freeing the clone.
  */
 Project *
 project_clone (
-  const Project * src)
+  const Project * src,
+  bool            share_undo_manager)
 {
   g_message ("cloning project...");
 
@@ -2076,8 +2107,16 @@ project_clone (
       src->port_connections_manager);
   self->midi_mappings =
     midi_mappings_clone (src->midi_mappings);
-  self->undo_manager =
-    undo_manager_clone (src->undo_manager);
+  if (share_undo_manager)
+    {
+      self->undo_manager =
+        (UndoManager *) src->undo_manager;
+    }
+  else
+    {
+      self->undo_manager =
+        undo_manager_clone (src->undo_manager);
+    }
 
   g_message ("finished cloning project");
 
@@ -98,6 +98,7 @@ settings_new (void)
     self->preferences_##a##_##b, NULL)
 
   NEW_PREFERENCES_SETTINGS (dsp, pan);
+  NEW_PREFERENCES_SETTINGS (dsp, threads);
   NEW_PREFERENCES_SETTINGS (editing, audio);
   NEW_PREFERENCES_SETTINGS (editing, automation);
   NEW_PREFERENCES_SETTINGS (editing, undo);
@@ -539,6 +540,7 @@ settings_free (
 
   FREE_SETTING (general);
   FREE_SETTING (preferences_dsp_pan);
+  FREE_SETTING (preferences_dsp_threads);
   FREE_SETTING (preferences_editing_audio);
   FREE_SETTING (preferences_editing_automation);
   FREE_SETTING (preferences_editing_undo);
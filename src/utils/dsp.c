@@ -232,16 +232,25 @@ dsp_mix_add2 (
 /**
  * Calculate linear fade in by multiplying from
  * 0 to 1.
+ *
+ * @param start_offset Offset of \ref dest in the
+ *   fade.
+ * @param total_size Total size of the fade.
+ * @param size Size of \ref dest.
  */
 NONNULL
 void
 dsp_linear_fade_in (
   float * dest,
+  size_t  start_offset,
+  size_t  total_size,
   size_t  size)
 {
   for (size_t i = 0; i < size; i++)
     {
-      float k = (float) i / (float) size;
+      float k =
+        (float) (start_offset + i) /
+        (float) total_size;
       dest[i] *= k;
     }
 }
@@ -249,16 +258,25 @@ dsp_linear_fade_in (
 /**
  * Calculate linear fade in by multiplying from
  * 1 to 0.
+ *
+ * @param start_offset Offset of \ref dest in the
+ *   fade.
+ * @param total_size Total size of the fade.
+ * @param size Size of \ref dest.
  */
 NONNULL
 void
 dsp_linear_fade_out (
   float * dest,
+  size_t  start_offset,
+  size_t  total_size,
   size_t  size)
 {
   for (size_t i = 0; i < size; i++)
     {
-      float k = (float) (size - i) / (float) size;
+      float k =
+        (float) (total_size - (start_offset + i)) /
+        (float) total_size;
       dest[i] *= k;
     }
 }
@@ -62,6 +62,7 @@
 #include "utils/mpmc_queue.h"
 #include "utils/object_pool.h"
 #include "utils/objects.h"
+#include "utils/rt_check.h"
 #include "utils/string.h"
 #include "zrythm.h"
 #include "zrythm_app.h"
@@ -919,6 +920,10 @@ log_writer (
   gsize n_fields,
   Log * self)
 {
+  /* logging allocates and may block */
+  rt_check_record (
+    RT_CHECK_VIOLATION_LOG, "g_log");
+
   char * str =
     log_writer_format_fields (
       log_level, fields, n_fields, F_NO_USE_COLOR);
@@ -35,6 +35,7 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
 
@@ -189,3 +190,160 @@ mpmc_queue_dequeue (
 
   return 1;
 }
+
+/**
+ * Pushes up to @p num_data elements with a single
+ * update of the enqueue position.
+ *
+ * Consecutive free slots are claimed at once, so
+ * contention with other producers is paid once
+ * per batch instead of once per element.
+ *
+ * @return The number of elements pushed (less than
+ *   @p num_data only if the queue is full).
+ */
+size_t
+mpmc_queue_push_back_batch (
+  MPMCQueue *          self,
+  void * const * const data,
+  size_t               num_data)
+{
+  size_t num_pushed = 0;
+  while (num_pushed < num_data)
+    {
+      gint pos =
+        g_atomic_int_get (&self->enqueue_pos);
+
+      /* count the free slots starting at pos */
+      size_t num_free = 0;
+      size_t num_wanted = num_data - num_pushed;
+      bool full = false;
+      while (num_free < num_wanted)
+        {
+          cell_t * cell =
+            &self->buffer[
+              (size_t) (pos + (gint) num_free) &
+                self->buffer_mask];
+          guint seq =
+            (guint)
+            g_atomic_int_get (&cell->sequence);
+          intptr_t dif =
+            (intptr_t) seq -
+            (intptr_t) (pos + (gint) num_free);
+          if (dif == 0)
+            {
+              num_free++;
+            }
+          else
+            {
+              /* dif < 0 means the slot is still
+               * occupied (queue full), dif > 0 that
+               * another producer got ahead of us */
+              full = dif < 0 && num_free == 0;
+              break;
+            }
+        }
+
+      if (G_UNLIKELY (full))
+        {
+          g_return_val_if_reached (num_pushed);
+        }
+      if (num_free == 0)
+        continue;
+
+      if (!g_atomic_int_compare_and_exchange (
+             &self->enqueue_pos, pos,
+             pos + (gint) num_free))
+        continue;
+
+      for (size_t i = 0; i < num_free; i++)
+        {
+          gint cur_pos = pos + (gint) i;
+          cell_t * cell =
+            &self->buffer[
+              (size_t) cur_pos & self->buffer_mask];
+          cell->data = data[num_pushed + i];
+          g_atomic_int_set (
+            &cell->sequence, cur_pos + 1);
+        }
+      num_pushed += num_free;
+    }
+
+  return num_pushed;
+}
+
+/**
+ * Dequeues up to @p max_data elements with a
+ * single update of the dequeue position.
+ *
+ * Only elements that are fully pushed are
+ * dequeued, so this may return less than what is
+ * in the queue.
+ *
+ * @return The number of elements dequeued.
+ */
+size_t
+mpmc_queue_dequeue_batch (
+  MPMCQueue * self,
+  void **     data,
+  size_t      max_data)
+{
+  for (;;)
+    {
+      gint pos =
+        g_atomic_int_get (&self->dequeue_pos);
+
+      /* count the published slots starting at
+       * pos */
+      size_t num_ready = 0;
+      bool retry = false;
+      while (num_ready < max_data)
+        {
+          cell_t * cell =
+            &self->buffer[
+              (size_t) (pos + (gint) num_ready) &
+                self->buffer_mask];
+          guint seq =
+            (guint)
+            g_atomic_int_get (&cell->sequence);
+          intptr_t dif =
+            (intptr_t) seq -
+            (intptr_t) (pos + (gint) num_ready + 1);
+          if (dif == 0)
+            {
+              num_ready++;
+            }
+          else
+            {
+              /* dif > 0 means another consumer got
+               * ahead of us */
+              retry = dif > 0 && num_ready == 0;
+              break;
+            }
+        }
+
+      if (retry)
+        continue;
+      if (num_ready == 0)
+        return 0;
+
+      if (!g_atomic_int_compare_and_exchange (
+             &self->dequeue_pos, pos,
+             pos + (gint) num_ready))
+        continue;
+
+      for (size_t i = 0; i < num_ready; i++)
+        {
+          gint cur_pos = pos + (gint) i;
+          cell_t * cell =
+            &self->buffer[
+              (size_t) cur_pos & self->buffer_mask];
+          data[i] = cell->data;
+          g_atomic_int_set (
+            &cell->sequence,
+            cur_pos + (gint) self->buffer_mask + 1);
+        }
+
+      return num_ready;
+    }
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WOE32
+#include <execinfo.h>
+#endif
+
+#include "utils/rt_check.h"
+
+#include <glib.h>
+
+static const char * violation_type_strings[] =
+{
+  "allocation",
+  "free",
+  "lock",
+  "log",
+};
+
+/** Global log (zeroed, so never allocated). */
+static RtCheck rt_check;
+
+/**
+ * Whether the current thread is a real-time
+ * thread.
+ *
+ * Thread-local storage is used instead of GPrivate
+ * because GPrivate may allocate on first use,
+ * which would recurse into the checks.
+ */
+static __thread bool is_rt_thread = false;
+
+/** Whether the current thread is recording a
+ * violation (to ignore calls made while
+ * recording). */
+static __thread bool recording = false;
+
+/**
+ * Enables or disables the checks.
+ *
+ * Allocation and blocking calls are only seen if
+ * the executable interposes them (see
+ * tests/helpers/rt_check.c). Log calls are always
+ * seen through the Zrythm log writer.
+ */
+void
+rt_check_set_enabled (
+  bool enabled)
+{
+#ifndef _WOE32
+  if (enabled)
+    {
+      /* the first call to backtrace() loads
+       * libgcc, which allocates, so do it here */
+      void * frames[2];
+      backtrace (frames, 2);
+    }
+#endif
+
+  g_atomic_int_set (&rt_check.enabled, enabled);
+}
+
+/**
+ * Returns whether the checks are enabled and the
+ * current thread is registered.
+ */
+bool
+rt_check_is_active (void)
+{
+  return
+    g_atomic_int_get (&rt_check.enabled) &&
+    is_rt_thread && !recording;
+}
+
+/**
+ * Marks the current thread as a real-time thread.
+ *
+ * To be called by the threads that
+ * router_is_processing_thread() returns true for,
+ * from the thread itself.
+ */
+void
+rt_check_register_thread (void)
+{
+  is_rt_thread = true;
+}
+
+/**
+ * Unmarks the current thread (eg, when it is
+ * about to terminate).
+ */
+void
+rt_check_unregister_thread (void)
+{
+  is_rt_thread = false;
+}
+
+/**
+ * Records a violation with a backtrace if the
+ * checks are active on the current thread.
+ *
+ * Safe to call from allocation functions.
+ *
+ * @param func Name of the function called.
+ */
+void
+rt_check_record (
+  RtCheckViolationType type,
+  const char *         func)
+{
+  if (!rt_check_is_active ())
+    return;
+
+  recording = true;
+
+  int idx =
+    g_atomic_int_add (&rt_check.num_violations, 1);
+  if (idx < RT_CHECK_MAX_VIOLATIONS)
+    {
+      RtCheckViolation * v =
+        &rt_check.violations[idx];
+      v->type = type;
+      v->func = func;
+#ifdef _WOE32
+      v->num_frames = 0;
+#else
+      v->num_frames =
+        backtrace (v->frames, RT_CHECK_MAX_FRAMES);
+#endif
+      g_atomic_int_inc (&rt_check.num_written);
+    }
+
+  recording = false;
+}
+
+/**
+ * Returns the number of violations so far.
+ */
+int
+rt_check_get_num_violations (void)
+{
+  return g_atomic_int_get (&rt_check.num_violations);
+}
+
+/**
+ * Logs the recorded violations with their
+ * backtraces.
+ *
+ * Must not be called from a real-time thread.
+ */
+void
+rt_check_print_violations (void)
+{
+  int num_violations =
+    rt_check_get_num_violations ();
+  int num_written =
+    MIN (
+      g_atomic_int_get (&rt_check.num_written),
+      RT_CHECK_MAX_VIOLATIONS);
+  if (num_violations == 0)
+    return;
+
+  g_message (
+    "%d real-time violation(s) (showing %d):",
+    num_violations, num_written);
+  for (int i = 0; i < num_written; i++)
+    {
+      RtCheckViolation * v =
+        &rt_check.violations[i];
+      GString * msg = g_string_new (NULL);
+      g_string_append_printf (
+        msg, "[%d] %s in %s()", i,
+        violation_type_strings[v->type], v->func);
+#ifndef _WOE32
+      char ** symbols =
+        backtrace_symbols (
+          v->frames, v->num_frames);
+      if (symbols)
+        {
+          /* skip the recording and interposed
+           * functions */
+          for (int j = 2; j < v->num_frames; j++)
+            {
+              g_string_append_printf (
+                msg, "\n  %s", symbols[j]);
+            }
+          free (symbols);
+        }
+#endif
+      char * str = g_string_free (msg, false);
+      g_message ("%s", str);
+      g_free (str);
+    }
+}
+
+/**
+ * Forgets the recorded violations.
+ *
+ * Must not be called while real-time threads are
+ * running.
+ */
+void
+rt_check_clear (void)
+{
+  g_atomic_int_set (&rt_check.num_violations, 0);
+  g_atomic_int_set (&rt_check.num_written, 0);
+}
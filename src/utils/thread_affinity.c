@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* for cpu_set_t and pthread_setaffinity_np() */
+#define _GNU_SOURCE
+
+#include "zrythm-config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "utils/thread_affinity.h"
+
+#include <glib.h>
+
+#define SYSFS_CPU_DIR "/sys/devices/system/cpu"
+
+static int
+cmp_int (
+  const void * a,
+  const void * b)
+{
+  return *(const int *) a - *(const int *) b;
+}
+
+/**
+ * Sorts the CPUs and removes duplicates.
+ *
+ * @return The new number of CPUs.
+ */
+static int
+sort_and_dedup (
+  int * cpus,
+  int   num_cpus)
+{
+  if (num_cpus < 2)
+    return num_cpus;
+
+  qsort (
+    cpus, (size_t) num_cpus, sizeof (int),
+    cmp_int);
+  int num_unique = 1;
+  for (int i = 1; i < num_cpus; i++)
+    {
+      if (cpus[i] != cpus[num_unique - 1])
+        {
+          cpus[num_unique++] = cpus[i];
+        }
+    }
+  return num_unique;
+}
+
+int
+thread_affinity_policy_from_nick (
+  const char * nick)
+{
+  for (size_t i = 0;
+       i < G_N_ELEMENTS (
+             thread_affinity_policy_nicks);
+       i++)
+    {
+      if (g_strcmp0 (
+            nick, thread_affinity_policy_nicks[i])
+          == 0)
+        {
+          return (int) i;
+        }
+    }
+
+  return -1;
+}
+
+int
+thread_affinity_parse_cpu_list (
+  const char * str,
+  int *        cpus,
+  int          max_cpus)
+{
+  g_return_val_if_fail (str && cpus, -1);
+
+  int num_cpus = 0;
+  const char * cur = str;
+  while (*cur)
+    {
+      while (g_ascii_isspace (*cur) || *cur == ',')
+        cur++;
+      if (!*cur)
+        break;
+
+      char * end;
+      long start = strtol (cur, &end, 10);
+      if (end == cur || start < 0)
+        return -1;
+      long last = start;
+      cur = end;
+      if (*cur == '-')
+        {
+          cur++;
+          last = strtol (cur, &end, 10);
+          if (end == cur || last < start)
+            return -1;
+          cur = end;
+        }
+      if (*cur && *cur != ',' &&
+          !g_ascii_isspace (*cur))
+        return -1;
+      if (last >= THREAD_AFFINITY_MAX_CPUS)
+        return -1;
+
+      for (long i = start;
+           i <= last && num_cpus < max_cpus; i++)
+        {
+          cpus[num_cpus++] = (int) i;
+        }
+    }
+
+  return sort_and_dedup (cpus, num_cpus);
+}
+
+char *
+thread_affinity_cpu_list_to_string (
+  const int * cpus,
+  int         num_cpus)
+{
+  GString * str = g_string_new (NULL);
+  for (int i = 0; i < num_cpus; i++)
+    {
+      int start = cpus[i];
+      while (i + 1 < num_cpus &&
+             cpus[i + 1] == cpus[i] + 1)
+        {
+          i++;
+        }
+      if (str->len > 0)
+        {
+          g_string_append_c (str, ',');
+        }
+      if (cpus[i] == start)
+        {
+          g_string_append_printf (str, "%d", start);
+        }
+      else
+        {
+          g_string_append_printf (
+            str, "%d-%d", start, cpus[i]);
+        }
+    }
+
+  return g_string_free (str, false);
+}
+
+#ifdef __linux__
+/**
+ * Parses a CPU list from a sysfs file.
+ *
+ * @return The number of CPUs, or -1 if the file
+ *   could not be read.
+ */
+static int
+read_sysfs_cpu_list (
+  const char * path,
+  int *        cpus,
+  int          max_cpus)
+{
+  char * contents = NULL;
+  if (!g_file_get_contents (
+         path, &contents, NULL, NULL))
+    {
+      return -1;
+    }
+
+  int num_cpus =
+    thread_affinity_parse_cpu_list (
+      contents, cpus, max_cpus);
+  g_free (contents);
+
+  return num_cpus;
+}
+
+/**
+ * Fills in the first logical CPU of each online
+ * physical core.
+ */
+static int
+get_physical_core_cpus (
+  int * cpus,
+  int   max_cpus)
+{
+  int * online =
+    g_new (int, THREAD_AFFINITY_MAX_CPUS);
+  int num_online =
+    read_sysfs_cpu_list (
+      SYSFS_CPU_DIR "/online", online,
+      THREAD_AFFINITY_MAX_CPUS);
+
+  int * siblings =
+    g_new (int, THREAD_AFFINITY_MAX_CPUS);
+  int num_cpus = 0;
+  for (int i = 0;
+       i < num_online && num_cpus < max_cpus; i++)
+    {
+      char * path =
+        g_strdup_printf (
+          SYSFS_CPU_DIR
+          "/cpu%d/topology/thread_siblings_list",
+          online[i]);
+      int num_siblings =
+        read_sysfs_cpu_list (
+          path, siblings,
+          THREAD_AFFINITY_MAX_CPUS);
+      g_free (path);
+
+      /* siblings are sorted, so the CPU is the
+       * first of its core if it is the smallest
+       * (or if the topology is unknown) */
+      if (num_siblings <= 0 ||
+          siblings[0] == online[i])
+        {
+          cpus[num_cpus++] = online[i];
+        }
+    }
+  g_free (online);
+  g_free (siblings);
+
+  return num_cpus;
+}
+#endif
+
+int
+thread_affinity_get_cpus (
+  ThreadAffinityPolicy policy,
+  const char *         core_list,
+  int *                cpus,
+  int                  max_cpus)
+{
+#ifdef __linux__
+  int num_cpus = 0;
+  switch (policy)
+    {
+    case THREAD_AFFINITY_POLICY_NONE:
+      return 0;
+    case THREAD_AFFINITY_POLICY_CORE_LIST:
+      num_cpus =
+        thread_affinity_parse_cpu_list (
+          core_list ? core_list : "", cpus,
+          max_cpus);
+      if (num_cpus < 0)
+        {
+          g_warning (
+            "invalid CPU list '%s'", core_list);
+        }
+      break;
+    case THREAD_AFFINITY_POLICY_PHYSICAL_CORES:
+    case THREAD_AFFINITY_POLICY_NO_SMT_SIBLINGS:
+      num_cpus =
+        get_physical_core_cpus (cpus, max_cpus);
+      break;
+    case THREAD_AFFINITY_POLICY_ISOLATED_CORES:
+      num_cpus =
+        read_sysfs_cpu_list (
+          SYSFS_CPU_DIR "/isolated", cpus,
+          max_cpus);
+      if (num_cpus == 0)
+        {
+          g_message (
+            "no isolated CPUs (see the isolcpus "
+            "kernel parameter)");
+        }
+      break;
+    }
+
+  return MAX (num_cpus, 0);
+#else
+  if (policy != THREAD_AFFINITY_POLICY_NONE)
+    {
+      g_message (
+        "thread affinity is not supported on this "
+        "platform");
+    }
+  return 0;
+#endif
+}
+
+bool
+thread_affinity_policy_pins_threads (
+  ThreadAffinityPolicy policy)
+{
+  return
+    policy == THREAD_AFFINITY_POLICY_CORE_LIST ||
+    policy ==
+      THREAD_AFFINITY_POLICY_PHYSICAL_CORES ||
+    policy ==
+      THREAD_AFFINITY_POLICY_ISOLATED_CORES;
+}
+
+bool
+thread_affinity_set_current_thread (
+  const int * cpus,
+  int         num_cpus)
+{
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO (&set);
+  for (int i = 0; i < num_cpus; i++)
+    {
+      if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE)
+        {
+          CPU_SET (cpus[i], &set);
+        }
+    }
+
+  return
+    pthread_setaffinity_np (
+      pthread_self (), sizeof (set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+int
+thread_affinity_get_current_thread (
+  int * cpus,
+  int   max_cpus)
+{
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO (&set);
+  if (pthread_getaffinity_np (
+        pthread_self (), sizeof (set), &set) != 0)
+    {
+      return -1;
+    }
+
+  int num_cpus = 0;
+  for (int i = 0;
+       i < CPU_SETSIZE && num_cpus < max_cpus; i++)
+    {
+      if (CPU_ISSET (i, &set))
+        {
+          cpus[num_cpus++] = i;
+        }
+    }
+
+  return num_cpus;
+#else
+  return -1;
+#endif
+}
@@ -56,6 +56,9 @@
 #include "actions/actions.h"
 #include "actions/undo_manager.h"
 #include "audio/engine.h"
+#include "audio/exporter.h"
+#include "audio/marker_track.h"
+#include "audio/master_track.h"
 #include "audio/router.h"
 #include "audio/quantize_options.h"
 #include "audio/track.h"
@@ -1042,6 +1045,30 @@ raise_open_file_limit ()
 #endif
 }
 
+/**
+ * Returns the path of the executable (to be
+ * free'd with free()), or NULL if unknown.
+ */
+static char *
+get_exe_path (void)
+{
+  char * exe_path = NULL;
+  int dirname_length, length;
+  length =
+    wai_getExecutablePath (
+      NULL, 0, &dirname_length);
+  if (length > 0)
+  {
+    exe_path =
+      (char *) malloc ((size_t) length + 1);
+    wai_getExecutablePath (
+      exe_path, length, &dirname_length);
+    exe_path[length] = '\0';
+  }
+
+  return exe_path;
+}
+
 /**
  * First function that gets called afted CLI args
  * are parsed and processed.
@@ -1066,19 +1093,7 @@ zrythm_app_startup (
       prefs, "first-run"), true);
   g_object_unref (G_OBJECT (prefs));
 
-  char * exe_path = NULL;
-  int dirname_length, length;
-  length =
-    wai_getExecutablePath (
-      NULL, 0, &dirname_length);
-  if (length > 0)
-  {
-    exe_path =
-      (char *) malloc ((size_t) length + 1);
-    wai_getExecutablePath (
-      exe_path, length, &dirname_length);
-    exe_path[length] = '\0';
-  }
+  char * exe_path = get_exe_path ();
 
   ZRYTHM =
     zrythm_new (
@@ -1725,6 +1740,189 @@ gen_project (
 #endif
 }
 
+/**
+ * Exports the song range to the given WAV file.
+ *
+ * @return Whether successful.
+ */
+static bool
+render_to_file (
+  const char * file,
+  ExportMode   mode)
+{
+  ExportSettings * info = export_settings_default ();
+  info->format = AUDIO_FORMAT_WAV;
+  info->depth =
+    (BitDepth)
+    g_settings_get_enum (S_EXPORT, "bit-depth");
+  info->dither =
+    g_settings_get_boolean (S_EXPORT, "dither");
+  info->artist = g_strdup ("");
+  info->title = g_strdup ("");
+  info->genre = g_strdup ("");
+  info->time_range = TIME_RANGE_SONG;
+  info->mode = mode;
+  info->bounce_with_parents = true;
+  info->file_uri = g_strdup (file);
+
+  int ret = exporter_export (info);
+  if (ret == 0)
+    {
+      fprintf (stdout, "%s\n", file);
+    }
+  export_settings_free (info);
+
+  return ret == 0;
+}
+
+/**
+ * Loads the project and renders it offline to the
+ * output file (or to one file per track in the
+ * output directory if @p stems is true) without
+ * creating any UI, then prints the render speed
+ * and peak memory usage and exits.
+ */
+static void
+render_project (
+  ZrythmApp *  self,
+  const char * filepath,
+  bool         stems)
+{
+  verify_file_exists (filepath);
+  verify_output_exists (self);
+
+  localization_init (false, false);
+  fftw_make_planner_thread_safe ();
+  fftwf_make_planner_thread_safe ();
+  audec_init ();
+#ifdef HAVE_LSP_DSP
+  lsp_dsp_init ();
+#endif
+
+  /* the exporter drives the engine, so no devices
+   * are needed */
+  g_free_and_null (self->audio_backend);
+  g_free_and_null (self->midi_backend);
+  self->audio_backend = g_strdup ("none");
+  self->midi_backend = g_strdup ("none");
+
+  char * exe_path = get_exe_path ();
+  ZRYTHM =
+    zrythm_new (exe_path, false, false, true);
+  free (exe_path);
+  ZRYTHM->debug = env_get_int ("ZRYTHM_DEBUG", 0);
+  zrythm_init_user_dirs_and_files (ZRYTHM);
+  plugin_manager_scan_plugins (
+    ZRYTHM->plugin_manager, 1.0, NULL);
+
+  if (project_load (filepath, false) != 0)
+    {
+      fprintf (
+        stderr, _("Failed to load project %s\n"),
+        filepath);
+      exit (EXIT_FAILURE);
+    }
+
+  ArrangerObject * start =
+    (ArrangerObject *)
+    marker_track_get_start_marker (P_MARKER_TRACK);
+  ArrangerObject * end =
+    (ArrangerObject *)
+    marker_track_get_end_marker (P_MARKER_TRACK);
+  double song_secs =
+    (double)
+    (position_to_frames (&end->pos) -
+       position_to_frames (&start->pos)) /
+    (double) AUDIO_ENGINE->sample_rate;
+
+  gint64 start_time = g_get_monotonic_time ();
+  int num_files = 0;
+  bool success = true;
+  if (stems)
+    {
+      io_mkdir (self->output_file);
+      for (int i = 0; i < TRACKLIST->num_tracks;
+           i++)
+        {
+          Track * track = TRACKLIST->tracks[i];
+          if (!track_type_has_channel (
+                 track->type) ||
+              track == P_MASTER_TRACK)
+            continue;
+
+          tracklist_mark_all_tracks_for_bounce (
+            TRACKLIST, false);
+          track_mark_for_bounce (
+            track, F_BOUNCE, F_MARK_REGIONS,
+            F_MARK_CHILDREN, F_MARK_PARENTS);
+
+          char * name =
+            string_convert_to_filename (
+              track->name);
+          char * basename =
+            g_strdup_printf ("%s.wav", name);
+          char * file =
+            g_build_filename (
+              self->output_file, basename, NULL);
+          success =
+            render_to_file (
+              file, EXPORT_MODE_TRACKS);
+          g_free (name);
+          g_free (basename);
+          g_free (file);
+
+          track->bounce = false;
+
+          if (!success)
+            break;
+          num_files++;
+        }
+    }
+  else
+    {
+      success =
+        render_to_file (
+          self->output_file, EXPORT_MODE_FULL);
+      if (success)
+        num_files++;
+    }
+  double wall_secs =
+    (double) (g_get_monotonic_time () - start_time)
+    / 1000000.0;
+
+  if (!success)
+    {
+      fprintf (stderr, "%s\n", _("Render failed"));
+      exit (EXIT_FAILURE);
+    }
+
+  fprintf (
+    stdout,
+    _("Rendered %d file(s) of %.2f seconds in "
+    "%.2f seconds (%.1fx realtime)\n"),
+    num_files, song_secs, wall_secs,
+    wall_secs > 0 ?
+      (song_secs * num_files) / wall_secs : 0);
+
+#ifndef _WOE32
+  struct rusage usage;
+  if (getrusage (RUSAGE_SELF, &usage) == 0)
+    {
+      /* bytes on macOS, kilobytes elsewhere */
+#ifdef __APPLE__
+      long peak_kb = usage.ru_maxrss / 1024;
+#else
+      long peak_kb = usage.ru_maxrss;
+#endif
+      fprintf (
+        stdout, _("Peak memory usage: %ld MiB\n"),
+        peak_kb / 1024);
+    }
+#endif
+
+  exit (EXIT_SUCCESS);
+}
+
 static bool
 reset_to_factory (void)
 {
@@ -1780,6 +1978,16 @@ on_handle_local_options (
         opts, "gen-project", "^ay", &filepath);
       gen_project (self, filepath);
     }
+  else if (g_variant_dict_contains (
+             opts, "render"))
+    {
+      char * filepath = NULL;
+      g_variant_dict_lookup (
+        opts, "render", "^ay", &filepath);
+      render_project (
+        self, filepath,
+        g_variant_dict_contains (opts, "stems"));
+    }
   else if (g_variant_dict_contains (
              opts, "reset-to-factory"))
     {
@@ -1902,6 +2110,17 @@ add_option_entries (
         G_OPTION_ARG_FILENAME, NULL,
         _("Generate a project from SCRIPT-FILE"),
         "SCRIPT-FILE" },
+      { "render", 0,
+        G_OPTION_FLAG_NONE,
+        G_OPTION_ARG_FILENAME, NULL,
+        _("Render PROJECT-FILE to the output file "
+        "without a UI"),
+        "PROJECT-FILE" },
+      { "stems", 0, G_OPTION_FLAG_NONE,
+        G_OPTION_ARG_NONE, NULL,
+        _("Render one file per track into the "
+        "output directory (with --render)"),
+        NULL },
       { "pretty", 0, G_OPTION_FLAG_NONE,
         G_OPTION_ARG_NONE, &self->pretty_print,
         _("Print output in user-friendly way"),
@@ -1963,6 +2182,8 @@ add_option_entries (
     _("Examples:\n"
     "  --zpj-to-yaml a.zpj > b.yaml        Convert a a.zpj to YAML and save to b.yaml\n"
     "  --gen-project a.scm -o myproject    Generate myproject from a.scm\n"
+    "  --render a.zpj -o a.wav             Render a.zpj to a.wav without a UI\n"
+    "  --render a.zpj --stems -o stems     Render each track of a.zpj into stems/\n"
     "  -p --pretty                         Pretty-print current settings\n\n"
     "Please report issues to %s\n"),
     ISSUE_TRACKER_URL);
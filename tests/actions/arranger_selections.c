@@ -1741,7 +1741,7 @@ test_audio_functions ()
   /* invert */
   arranger_selections_action_perform_edit_audio_function (
     (ArrangerSelections *) AUDIO_SELECTIONS,
-    AUDIO_FUNCTION_INVERT, NULL, NULL);
+    AUDIO_FUNCTION_INVERT, NULL, NULL, NULL);
 
   verify_audio_function (
     inverted_frames, frames_per_channel);
@@ -1767,6 +1767,123 @@ test_audio_functions ()
   test_helper_zrythm_cleanup ();
 }
 
+static void
+test_chunked_audio_functions ()
+{
+  rebootstrap_timeline ();
+
+  Track * track =
+    tracklist_find_track_by_name (
+      TRACKLIST, AUDIO_TRACK_NAME);
+  TrackLane * lane = track->lanes[3];
+  ZRegion * region = lane->regions[0];
+  ArrangerObject * r_obj =
+    (ArrangerObject *) region;
+  arranger_object_select (
+    r_obj, F_SELECT, F_NO_APPEND, F_NO_PUBLISH_EVENTS);
+  AUDIO_SELECTIONS->region_id = region->id;
+  AUDIO_SELECTIONS->has_selection = true;
+  AUDIO_SELECTIONS->sel_start = r_obj->pos;
+  AUDIO_SELECTIONS->sel_end = r_obj->end_pos;
+
+  /* the clip must span multiple chunks */
+  AudioClip * orig_clip =
+    audio_region_get_clip (region);
+  size_t channels = orig_clip->channels;
+  size_t num_frames =
+    (size_t)
+    (r_obj->end_pos.frames - r_obj->pos.frames);
+  g_assert_cmpuint (
+    num_frames, >, AUDIO_FUNCTION_CHUNK_FRAMES);
+  size_t total_frames = num_frames * channels;
+  float * orig_frames =
+    object_new_n (total_frames, float);
+  float * expected_frames =
+    object_new_n (total_frames, float);
+  dsp_copy (
+    orig_frames, orig_clip->frames, total_frames);
+
+  /* reverse */
+  for (size_t i = 0; i < num_frames; i++)
+    {
+      for (size_t j = 0; j < channels; j++)
+        {
+          expected_frames[i * channels + j] =
+            orig_frames[
+              (num_frames - i - 1) * channels + j];
+        }
+    }
+  arranger_selections_action_perform_edit_audio_function (
+    (ArrangerSelections *) AUDIO_SELECTIONS,
+    AUDIO_FUNCTION_REVERSE, NULL, NULL, NULL);
+  verify_audio_function (
+    expected_frames, num_frames);
+  undo_manager_undo (UNDO_MANAGER, NULL);
+  verify_audio_function (orig_frames, num_frames);
+
+  /* fade out over the whole selection */
+  dsp_copy (
+    expected_frames, orig_frames, total_frames);
+  dsp_linear_fade_out (
+    expected_frames, 0, total_frames,
+    total_frames);
+  arranger_selections_action_perform_edit_audio_function (
+    (ArrangerSelections *) AUDIO_SELECTIONS,
+    AUDIO_FUNCTION_LINEAR_FADE_OUT, NULL, NULL,
+    NULL);
+  verify_audio_function (
+    expected_frames, num_frames);
+  undo_manager_undo (UNDO_MANAGER, NULL);
+  verify_audio_function (orig_frames, num_frames);
+
+  /* progress is reported through the action */
+  GenericProgressInfo action_progress_info = { 0 };
+  g_assert_true (
+    arranger_selections_action_perform_edit_audio_function (
+      (ArrangerSelections *) AUDIO_SELECTIONS,
+      AUDIO_FUNCTION_INVERT, NULL,
+      &action_progress_info, NULL));
+  g_assert_cmpfloat_with_epsilon (
+    action_progress_info.progress, 1.0, 0.0001);
+  undo_manager_undo (UNDO_MANAGER, NULL);
+  verify_audio_function (orig_frames, num_frames);
+
+  /* cancelled functions don't change anything */
+  GenericProgressInfo progress_info = { 0 };
+  progress_info.cancelled = true;
+  GError * err = NULL;
+  int ret =
+    audio_function_apply (
+      (ArrangerSelections *) AUDIO_SELECTIONS,
+      AUDIO_FUNCTION_INVERT, NULL, &progress_info,
+      &err);
+  g_assert_cmpint (ret, !=, 0);
+  g_assert_nonnull (err);
+  g_error_free (err);
+  verify_audio_function (orig_frames, num_frames);
+
+  /* progress is reported */
+  progress_info.cancelled = false;
+  ret =
+    audio_function_apply (
+      (ArrangerSelections *) AUDIO_SELECTIONS,
+      AUDIO_FUNCTION_NORMALIZE_PEAK, NULL,
+      &progress_info, NULL);
+  g_assert_cmpint (ret, ==, 0);
+  g_assert_cmpfloat_with_epsilon (
+    progress_info.progress, 1.0, 0.0001);
+  AudioClip * clip = audio_region_get_clip (region);
+  float peak = 0.f;
+  dsp_abs_max (clip->frames, &peak, total_frames);
+  g_assert_cmpfloat_with_epsilon (
+    peak, 1.f, 0.0001f);
+
+  free (orig_frames);
+  free (expected_frames);
+
+  test_helper_zrythm_cleanup ();
+}
+
 static void
 test_automation_fill ()
 {
@@ -3459,6 +3576,9 @@ main (int argc, char *argv[])
   g_test_add_func (
     TEST_PREFIX "test audio functions",
     (GTestFunc) test_audio_functions);
+  g_test_add_func (
+    TEST_PREFIX "test chunked audio functions",
+    (GTestFunc) test_chunked_audio_functions);
   g_test_add_func (
     TEST_PREFIX "test create timeline",
     (GTestFunc) test_create_timeline);
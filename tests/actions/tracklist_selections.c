@@ -964,8 +964,26 @@ test_ins_track_deletion_w_automation (void)
   g_assert_true (
     track_validate (track));
 
-  /* get the filter cutoff automation track */
-  at = atl->ats[141];
+  /* get the automation track of the first
+   * automatable filter parameter (the MIDI
+   * controls don't have automation tracks until
+   * they are used, so the indices moved) */
+  Plugin * filter = track->channel->inserts[0];
+  g_assert_nonnull (filter);
+  at = NULL;
+  for (int i = 0; i < filter->num_in_ports; i++)
+    {
+      Port * filter_port = filter->in_ports[i];
+      if (filter_port->id.flags &
+            PORT_FLAG_AUTOMATABLE)
+        {
+          at =
+            automation_track_find_from_port (
+              filter_port, track, true);
+          break;
+        }
+    }
+  g_assert_nonnull (at);
   at->created = true;
   at->visible = true;
 
@@ -21,7 +21,9 @@
 
 #include "actions/tracklist_selections.h"
 #include "audio/midi_region.h"
+#include "audio/pool.h"
 #include "audio/region.h"
+#include "audio/stretch_cache.h"
 #include "audio/transport.h"
 #include "project.h"
 #include "utils/flags.h"
@@ -222,6 +224,188 @@ test_detect_bpm (void)
   test_helper_zrythm_cleanup ();
 }
 
+static void
+test_stretch_in_background (void)
+{
+  test_helper_zrythm_init ();
+
+  Position pos;
+  position_set_to_bar (&pos, 2);
+
+  /* create audio track with region */
+  char * filepath =
+    g_build_filename (
+      TESTS_SRCDIR,
+      "test_start_with_signal.mp3", NULL);
+  SupportedFile * file =
+    supported_file_new_from_path (filepath);
+  int num_tracks_before = TRACKLIST->num_tracks;
+  track_create_with_action (
+    TRACK_TYPE_AUDIO, NULL, file, &pos,
+    num_tracks_before, 1, NULL);
+
+  Track * track =
+    TRACKLIST->tracks[num_tracks_before];
+  ZRegion * r = track->lanes[0]->regions[0];
+  AudioClip * orig_clip = audio_region_get_clip (r);
+  int orig_clip_id = orig_clip->pool_id;
+  long orig_frames = orig_clip->num_frames;
+
+  /* the region keeps its clip until the job is
+   * done */
+  region_stretch (r, 2.0);
+  g_assert_cmpint (r->pool_id, ==, orig_clip_id);
+
+  stretch_cache_wait (STRETCH_CACHE);
+  int stretched_clip_id = r->pool_id;
+  g_assert_cmpint (
+    stretched_clip_id, !=, orig_clip_id);
+  AudioClip * stretched_clip =
+    audio_region_get_clip (r);
+  g_assert_cmpint (
+    labs (
+      stretched_clip->num_frames - orig_frames * 2),
+    <=, 1);
+  g_assert_cmpint (
+    ((ArrangerObject *) r)->loop_end_pos.frames, ==,
+    stretched_clip->num_frames);
+
+  /* stretching back uses the original clip */
+  g_assert_true (
+    stretch_cache_stretch_region (
+      STRETCH_CACHE, r, 0.5));
+  g_assert_cmpint (r->pool_id, ==, orig_clip_id);
+
+  /* stretching again uses the cached clip */
+  g_assert_true (
+    stretch_cache_stretch_region (
+      STRETCH_CACHE, r, 2.0));
+  g_assert_cmpint (
+    r->pool_id, ==, stretched_clip_id);
+
+  test_helper_zrythm_cleanup ();
+}
+
+/**
+ * Applies a stretch while the engine is playing
+ * the region.
+ */
+static void
+test_stretch_while_processing (void)
+{
+  test_helper_zrythm_init ();
+
+  Position pos;
+  position_set_to_bar (&pos, 1);
+
+  char * filepath =
+    g_build_filename (
+      TESTS_SRCDIR,
+      "test_start_with_signal.mp3", NULL);
+  SupportedFile * file =
+    supported_file_new_from_path (filepath);
+  int num_tracks_before = TRACKLIST->num_tracks;
+  track_create_with_action (
+    TRACK_TYPE_AUDIO, NULL, file, &pos,
+    num_tracks_before, 1, NULL);
+
+  Track * track =
+    TRACKLIST->tracks[num_tracks_before];
+  ZRegion * r = track->lanes[0]->regions[0];
+  int orig_clip_id = r->pool_id;
+
+  /* the dummy engine keeps processing in its own
+   * thread */
+  g_assert_true (engine_get_run (AUDIO_ENGINE));
+  transport_request_roll (TRANSPORT);
+
+  /* applied between cycles, with the pool
+   * growing while the region is played */
+  for (int i = 0; i < 4; i++)
+    {
+      region_stretch (r, i % 2 == 0 ? 2.0 : 0.5);
+    }
+  region_stretch (r, 1.5);
+  stretch_cache_wait (STRETCH_CACHE);
+  g_assert_cmpint (r->pool_id, !=, orig_clip_id);
+  g_assert_nonnull (audio_region_get_clip (r));
+
+  /* the engine is still processing */
+  unsigned long cycle = AUDIO_ENGINE->cycle;
+  for (int i = 0; i < 1000; i++)
+    {
+      if (AUDIO_ENGINE->cycle > cycle)
+        break;
+
+      g_usleep (1000);
+    }
+  g_assert_cmpuint (
+    AUDIO_ENGINE->cycle, >, cycle);
+
+  transport_request_pause (TRANSPORT);
+  g_free (filepath);
+  supported_file_free (file);
+
+  test_helper_zrythm_cleanup ();
+}
+
+/**
+ * Replaces a region while its stretch is still
+ * pending and checks that the result is not
+ * applied to the region now at its position.
+ */
+static void
+test_stretch_replaced_region (void)
+{
+  test_helper_zrythm_init ();
+
+  Position pos;
+  position_set_to_bar (&pos, 2);
+
+  char * filepath =
+    g_build_filename (
+      TESTS_SRCDIR,
+      "test_start_with_signal.mp3", NULL);
+  SupportedFile * file =
+    supported_file_new_from_path (filepath);
+  int num_tracks_before = TRACKLIST->num_tracks;
+  track_create_with_action (
+    TRACK_TYPE_AUDIO, NULL, file, &pos,
+    num_tracks_before, 1, NULL);
+
+  Track * track =
+    TRACKLIST->tracks[num_tracks_before];
+  ZRegion * r = track->lanes[0]->regions[0];
+  int orig_clip_id = r->pool_id;
+
+  /* keep the old region alive so its address
+   * is not reused by the new one */
+  region_stretch (r, 2.0);
+  track_remove_region (
+    track, r, F_NO_PUBLISH_EVENTS, F_NO_FREE);
+
+  ZRegion * new_r =
+    audio_region_new (
+      -1, filepath, true, NULL, 0, NULL, 0, 0,
+      &pos, track_get_name_hash (track), 0, 0);
+  track_add_region (
+    track, new_r, NULL, 0, F_GEN_NAME,
+    F_NO_PUBLISH_EVENTS);
+  int new_clip_id = new_r->pool_id;
+  g_assert_true (
+    track->lanes[0]->regions[0] == new_r);
+
+  stretch_cache_wait (STRETCH_CACHE);
+  g_assert_cmpint (new_r->pool_id, ==, new_clip_id);
+  g_assert_cmpint (r->pool_id, ==, orig_clip_id);
+
+  arranger_object_free ((ArrangerObject *) r);
+  g_free (filepath);
+  supported_file_free (file);
+
+  test_helper_zrythm_cleanup ();
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -241,6 +425,15 @@ main (int argc, char *argv[])
   g_test_add_func (
     TEST_PREFIX "test detect bpm",
     (GTestFunc) test_detect_bpm);
+  g_test_add_func (
+    TEST_PREFIX "test stretch in background",
+    (GTestFunc) test_stretch_in_background);
+  g_test_add_func (
+    TEST_PREFIX "test stretch while processing",
+    (GTestFunc) test_stretch_while_processing);
+  g_test_add_func (
+    TEST_PREFIX "test stretch replaced region",
+    (GTestFunc) test_stretch_replaced_region);
 
   return g_test_run ();
 }
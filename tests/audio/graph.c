@@ -0,0 +1,519 @@
+/*
+ * Copyright (C) 2020-2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-test-config.h"
+
+#include "actions/port_connection_action.h"
+#include "actions/undo_manager.h"
+#include "audio/channel.h"
+#include "audio/engine.h"
+#include "audio/graph.h"
+#include "audio/graph_buffer_plan.h"
+#include "audio/graph_node.h"
+#include "audio/master_track.h"
+#include "audio/router.h"
+#include "audio/supported_file.h"
+#include "audio/track.h"
+#include "audio/track_processor.h"
+#include "audio/tracklist.h"
+#include "audio/transport.h"
+#include "project.h"
+#include "utils/arrays.h"
+#include "utils/audio.h"
+#include "utils/flags.h"
+#include "utils/objects.h"
+
+#include "tests/helpers/project.h"
+#include "tests/helpers/zrythm.h"
+
+#include "zix/ring.h"
+
+#include <glib.h>
+
+static void
+check_track_is_live (
+  Track * track)
+{
+  Graph * graph = ROUTER->graph;
+  g_assert_false (
+    g_atomic_int_get (&graph->setup_pending));
+  g_assert_nonnull (
+    g_hash_table_lookup (
+      graph->graph_nodes, track->channel->fader));
+  g_assert_nonnull (
+    g_hash_table_lookup (
+      graph->graph_nodes,
+      track->channel->stereo_out->l));
+
+  /* the port connections were swapped in */
+  Port * l = track->channel->stereo_out->l;
+  g_assert_cmpint (l->num_dests, ==, 1);
+  g_assert_true (
+    l->dests[0] ==
+      P_MASTER_TRACK->processor->stereo_in->l);
+}
+
+static void
+test_rechain_while_processing (void)
+{
+  test_helper_zrythm_init ();
+
+  track_create_empty_with_action (
+    TRACK_TYPE_AUDIO_BUS, NULL);
+  Track * track =
+    TRACKLIST->tracks[TRACKLIST->num_tracks - 1];
+  check_track_is_live (track);
+
+  /* recalculate while the engine is processing */
+  for (int i = 0; i < 8; i++)
+    {
+      router_recalc_graph (ROUTER, F_NOT_SOFT);
+      check_track_is_live (track);
+      engine_wait_n_cycles (AUDIO_ENGINE, 1);
+    }
+
+  /* recalculate while the engine is not
+   * processing */
+  AUDIO_ENGINE->stop_dummy_audio_thread = true;
+  g_usleep (1000000);
+  router_recalc_graph (ROUTER, F_NOT_SOFT);
+  check_track_is_live (track);
+  engine_process (
+    AUDIO_ENGINE, AUDIO_ENGINE->block_length);
+
+  test_helper_zrythm_cleanup ();
+}
+
+/**
+ * Returns the node in the setup chain of \ref
+ * other that corresponds to \ref node.
+ */
+static GraphNode *
+find_equivalent_node (
+  Graph *     other,
+  GraphNode * node)
+{
+  void * key =
+    node->type ==
+      ROUTE_NODE_TYPE_INITIAL_PROCESSOR ?
+        &other->initial_processor :
+        graph_node_get_pointer (node);
+  return
+    (GraphNode *)
+    g_hash_table_lookup (
+      other->setup_graph_nodes, key);
+}
+
+/**
+ * Checks that the running graph is the same as a
+ * graph set up from scratch.
+ */
+static void
+check_matches_full_rebuild (void)
+{
+  Graph * graph = ROUTER->graph;
+  g_assert_false (
+    g_atomic_int_get (&graph->setup_pending));
+
+  Graph * full = graph_new (ROUTER);
+  graph_setup (full, 1, 0);
+
+  g_assert_cmpuint (
+    g_hash_table_size (graph->graph_nodes), ==,
+    g_hash_table_size (full->setup_graph_nodes));
+  g_assert_cmpuint (
+    graph->n_init_triggers, ==,
+    full->num_setup_init_triggers);
+  g_assert_cmpuint (
+    (size_t) graph->n_terminal_nodes, ==,
+    full->num_setup_terminal_nodes);
+
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init (
+    &iter, graph->graph_nodes);
+  while (g_hash_table_iter_next (
+           &iter, NULL, &value))
+    {
+      GraphNode * node = (GraphNode *) value;
+      GraphNode * full_node =
+        find_equivalent_node (full, node);
+      g_assert_nonnull (full_node);
+      g_assert_cmpint (
+        node->type, ==, full_node->type);
+      g_assert_cmpint (
+        node->initial, ==, full_node->initial);
+      g_assert_cmpint (
+        node->terminal, ==, full_node->terminal);
+      g_assert_cmpint (
+        node->init_refcount, ==,
+        full_node->init_refcount);
+      g_assert_cmpint (
+        node->refcount, ==, node->init_refcount);
+      g_assert_cmpuint (
+        node->playback_latency, ==,
+        full_node->playback_latency);
+      g_assert_cmpuint (
+        node->route_playback_latency, ==,
+        full_node->route_playback_latency);
+
+      g_assert_cmpint (
+        node->n_childnodes, ==,
+        full_node->n_childnodes);
+      for (int i = 0; i < node->n_childnodes; i++)
+        {
+          GraphNode * child =
+            find_equivalent_node (
+              full, node->childnodes[i]);
+          g_assert_nonnull (child);
+          g_assert_true (
+            array_contains (
+              full_node->childnodes,
+              full_node->n_childnodes, child));
+        }
+
+      g_assert_cmpint (
+        node->initial, ==,
+        array_contains (
+          graph->init_trigger_list,
+          (int) graph->n_init_triggers, node));
+      g_assert_cmpint (
+        node->terminal, ==,
+        array_contains (
+          graph->terminal_nodes,
+          graph->n_terminal_nodes, node));
+    }
+
+  graph_free (full);
+}
+
+static void
+test_update_port_connection (void)
+{
+  test_helper_zrythm_init ();
+
+  track_create_empty_with_action (
+    TRACK_TYPE_AUDIO_BUS, NULL);
+  Track * src_track =
+    TRACKLIST->tracks[TRACKLIST->num_tracks - 1];
+  track_create_empty_with_action (
+    TRACK_TYPE_AUDIO_BUS, NULL);
+  Track * dest_track =
+    TRACKLIST->tracks[TRACKLIST->num_tracks - 1];
+  check_matches_full_rebuild ();
+
+  Graph * graph = ROUTER->graph;
+  GHashTable * graph_nodes = graph->graph_nodes;
+  Port * src = src_track->channel->stereo_out->l;
+  Port * dest =
+    dest_track->processor->stereo_in->l;
+  Port * master_in =
+    P_MASTER_TRACK->processor->stereo_in->l;
+
+  /* connect while the engine is processing */
+  port_connection_action_perform_connect (
+    &src->id, &dest->id, NULL);
+  engine_wait_n_cycles (AUDIO_ENGINE, 1);
+
+  /* the running graph was patched instead of
+   * being replaced */
+  g_assert_true (graph->graph_nodes == graph_nodes);
+  g_assert_cmpint (src->num_dests, ==, 2);
+  g_assert_cmpint (dest->num_srcs, ==, 1);
+  g_assert_true (dest->srcs[0] == src);
+  check_matches_full_rebuild ();
+
+  /* disconnect the default route */
+  port_connection_action_perform_disconnect (
+    &src->id, &master_in->id, NULL);
+  engine_wait_n_cycles (AUDIO_ENGINE, 1);
+  g_assert_true (graph->graph_nodes == graph_nodes);
+  g_assert_cmpint (src->num_dests, ==, 1);
+  g_assert_true (src->dests[0] == dest);
+  check_matches_full_rebuild ();
+
+  /* undo/redo */
+  for (int i = 0; i < 2; i++)
+    {
+      undo_manager_undo (UNDO_MANAGER, NULL);
+      check_matches_full_rebuild ();
+    }
+  g_assert_cmpint (src->num_dests, ==, 1);
+  g_assert_true (src->dests[0] == master_in);
+  for (int i = 0; i < 2; i++)
+    {
+      undo_manager_redo (UNDO_MANAGER, NULL);
+      check_matches_full_rebuild ();
+    }
+  g_assert_true (graph->graph_nodes == graph_nodes);
+
+  /* a full rebuild still works after patching */
+  router_recalc_graph (ROUTER, F_NOT_SOFT);
+  check_matches_full_rebuild ();
+  engine_wait_n_cycles (AUDIO_ENGINE, 1);
+
+  test_helper_zrythm_cleanup ();
+}
+
+static bool
+runs_before (
+  GraphNode *  node,
+  GraphNode *  other,
+  GHashTable * visited)
+{
+  for (int i = 0; i < other->init_refcount; i++)
+    {
+      GraphNode * parent = other->parentnodes[i];
+      if (parent == node)
+        return true;
+      if (g_hash_table_contains (visited, parent))
+        continue;
+      g_hash_table_add (visited, parent);
+      if (runs_before (node, parent, visited))
+        return true;
+    }
+  return false;
+}
+
+static void
+test_share_port_buffers (void)
+{
+  test_helper_zrythm_init ();
+
+  for (int i = 0; i < 4; i++)
+    {
+      track_create_empty_with_action (
+        TRACK_TYPE_AUDIO_BUS, NULL);
+    }
+  Track * track =
+    TRACKLIST->tracks[TRACKLIST->num_tracks - 1];
+  engine_wait_n_cycles (AUDIO_ENGINE, 1);
+
+  Graph * graph = ROUTER->graph;
+  GraphBufferPlan * plan = graph->buffer_plan;
+  g_assert_nonnull (plan);
+  g_assert_cmpint (plan->num_bufs, >, 0);
+  g_assert_cmpint (
+    plan->num_bufs, <, plan->num_entries);
+
+  for (int i = 0; i < plan->num_entries; i++)
+    {
+      GraphBufferPlanEntry * entry =
+        &plan->entries[i];
+      g_assert_true (
+        entry->port->buf == entry->buf);
+      g_assert_nonnull (entry->port->own_buf);
+      if (!entry->prev)
+        continue;
+
+      /* the previous port's readers are done
+       * before the buffer is cleared again */
+      GraphNode * writer =
+        entry->port->id.flow == FLOW_OUTPUT ?
+          entry->node->parentnodes[0] : entry->node;
+      GraphNode * prev_node = entry->prev->node;
+      for (int j = 0; j < prev_node->n_childnodes;
+           j++)
+        {
+          GHashTable * visited =
+            g_hash_table_new (NULL, NULL);
+          g_assert_true (
+            runs_before (
+              prev_node->childnodes[j], writer,
+              visited));
+          g_hash_table_destroy (visited);
+        }
+    }
+
+  /* ports read outside the graph keep their own
+   * buffers */
+  Port * stereo_out = track->channel->stereo_out->l;
+  g_assert_null (stereo_out->own_buf);
+  g_assert_null (
+    graph_buffer_plan_get_buf (plan, stereo_out));
+
+  /* the ports get their own buffers back when
+   * sharing is disabled */
+  Port * processor_out =
+    track->processor->stereo_out->l;
+  g_assert_nonnull (processor_out->own_buf);
+  graph->share_port_buffers = false;
+  router_recalc_graph (ROUTER, F_NOT_SOFT);
+  engine_wait_n_cycles (AUDIO_ENGINE, 1);
+  g_assert_null (graph->buffer_plan);
+  g_assert_null (processor_out->own_buf);
+
+  test_helper_zrythm_cleanup ();
+}
+
+#define LOOP_TEST_NUM_CYCLES 4
+
+/**
+ * Processes a few cycles starting half a cycle
+ * before the loop end and collects the master
+ * output and the frames written to the ring of
+ * \ref port.
+ */
+static void
+process_across_loop (
+  bool    share,
+  Port *  port,
+  float * out,
+  float * ring)
+{
+  Graph * graph = ROUTER->graph;
+  graph->share_port_buffers = share;
+  router_recalc_graph (ROUTER, F_NOT_SOFT);
+  if (share)
+    {
+      g_assert_nonnull (graph->buffer_plan);
+      g_assert_nonnull (
+        graph_buffer_plan_get_buf (
+          graph->buffer_plan, port));
+    }
+  else
+    {
+      g_assert_null (graph->buffer_plan);
+    }
+
+  nframes_t block_length =
+    AUDIO_ENGINE->block_length;
+  Position pos;
+  position_set_to_pos (
+    &pos, &TRANSPORT->loop_end_pos);
+  position_add_frames (
+    &pos, - (long) (block_length / 2));
+  transport_move_playhead (
+    TRANSPORT, &pos, F_NO_PANIC, false,
+    F_NO_PUBLISH_EVENTS);
+  TRANSPORT->play_state = PLAYSTATE_ROLLING;
+  zix_ring_reset (port->audio_ring);
+
+  Port * master_out =
+    P_MASTER_TRACK->channel->stereo_out->l;
+  for (int i = 0; i < LOOP_TEST_NUM_CYCLES; i++)
+    {
+      engine_process (AUDIO_ENGINE, block_length);
+      memcpy (
+        &out[(size_t) i * block_length],
+        master_out->buf,
+        block_length * sizeof (float));
+    }
+
+  /* the ring has every frame of every cycle */
+  uint32_t size =
+    (uint32_t)
+    (LOOP_TEST_NUM_CYCLES * block_length *
+       sizeof (float));
+  g_assert_cmpuint (
+    zix_ring_read_space (port->audio_ring), ==,
+    size);
+  zix_ring_read (port->audio_ring, ring, size);
+}
+
+static void
+test_share_port_buffers_across_loop (void)
+{
+  test_helper_zrythm_init ();
+
+  test_project_stop_dummy_engine ();
+
+  /* loop over the start of an audio region so
+   * that the cycle at the loop end is split */
+  nframes_t block_length =
+    AUDIO_ENGINE->block_length;
+  transport_set_loop (TRANSPORT, true);
+  position_set_to_bar (
+    &TRANSPORT->loop_start_pos, 1);
+  position_set_to_bar (
+    &TRANSPORT->loop_end_pos, 1);
+  position_add_frames (
+    &TRANSPORT->loop_end_pos,
+    (long) block_length * 2);
+
+  char * filepath =
+    g_build_filename (
+      TESTS_SRCDIR,
+      "test_start_with_signal.mp3", NULL);
+  SupportedFile * file =
+    supported_file_new_from_path (filepath);
+  g_free (filepath);
+  int num_tracks_before = TRACKLIST->num_tracks;
+  track_create_with_action (
+    TRACK_TYPE_AUDIO, NULL, file,
+    &TRANSPORT->loop_start_pos,
+    num_tracks_before, 1, NULL);
+  supported_file_free (file);
+  Track * track =
+    TRACKLIST->tracks[num_tracks_before];
+  Port * port = track->processor->stereo_out->l;
+
+  size_t num_frames =
+    LOOP_TEST_NUM_CYCLES * block_length;
+  float * out[2], * ring[2];
+  for (int i = 0; i < 2; i++)
+    {
+      out[i] = object_new_n (num_frames, float);
+      ring[i] = object_new_n (num_frames, float);
+    }
+  process_across_loop (
+    false, port, out[0], ring[0]);
+  process_across_loop (
+    true, port, out[1], ring[1]);
+
+  g_assert_false (
+    audio_frames_empty (out[0], num_frames));
+  g_assert_true (
+    audio_frames_equal (
+      out[0], out[1], num_frames, 0.000001f));
+  g_assert_true (
+    audio_frames_equal (
+      ring[0], ring[1], num_frames, 0.000001f));
+
+  for (int i = 0; i < 2; i++)
+    {
+      free (out[i]);
+      free (ring[i]);
+    }
+
+  test_helper_zrythm_cleanup ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+#define TEST_PREFIX "/audio/graph/"
+
+  g_test_add_func (
+    TEST_PREFIX "test rechain while processing",
+    (GTestFunc) test_rechain_while_processing);
+  g_test_add_func (
+    TEST_PREFIX "test update port connection",
+    (GTestFunc) test_update_port_connection);
+  g_test_add_func (
+    TEST_PREFIX "test share port buffers",
+    (GTestFunc) test_share_port_buffers);
+  g_test_add_func (
+    TEST_PREFIX "test share port buffers across loop",
+    (GTestFunc) test_share_port_buffers_across_loop);
+
+  return g_test_run ();
+}
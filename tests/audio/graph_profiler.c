@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2020-2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-test-config.h"
+
+#include <string.h>
+
+#include "audio/engine.h"
+#include "audio/graph.h"
+#include "audio/graph_profiler.h"
+#include "audio/router.h"
+#include "project.h"
+
+#include "tests/helpers/zrythm.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#define NUM_CYCLES 4
+
+static void
+test_profile_cycles (void)
+{
+  test_helper_zrythm_init ();
+
+  /* stop dummy audio engine processing so we can
+   * process manually */
+  AUDIO_ENGINE->stop_dummy_audio_thread = true;
+  g_usleep (1000000);
+
+  GraphProfiler * profiler = ROUTER->profiler;
+  g_assert_false (
+    graph_profiler_is_finished (profiler));
+
+  router_start_profiling (ROUTER, NUM_CYCLES);
+  g_assert_true (
+    graph_profiler_is_recording (profiler));
+
+  for (int i = 0; i < NUM_CYCLES + 2; i++)
+    {
+      engine_process (
+        AUDIO_ENGINE, AUDIO_ENGINE->block_length);
+    }
+  g_assert_true (
+    graph_profiler_is_finished (profiler));
+
+  int num_stats = 0;
+  GraphProfilerNodeStats * stats =
+    graph_profiler_get_node_stats (
+      profiler, &num_stats);
+  g_assert_cmpint (num_stats, >, 0);
+  g_assert_cmpint (
+    num_stats, <=,
+    (int)
+    g_hash_table_size (ROUTER->graph->graph_nodes));
+  for (int i = 0; i < num_stats; i++)
+    {
+      GraphProfilerNodeStats * stat = &stats[i];
+      g_assert_nonnull (stat->name);
+      g_assert_cmpint (stat->num_samples, >, 0);
+      g_assert_cmpint (stat->min, >=, 0);
+      g_assert_cmpint (stat->min, <=, stat->avg);
+      g_assert_cmpint (stat->avg, <=, stat->max);
+      g_assert_cmpint (stat->p99, <=, stat->max);
+      if (i > 0)
+        {
+          g_assert_cmpint (
+            stats[i - 1].avg, >=, stat->avg);
+        }
+    }
+  free (stats);
+
+  /* check that only the requested cycles were
+   * recorded */
+  GraphProfilerSample * samples =
+    (GraphProfilerSample *)
+    profiler->samples->data;
+  for (guint i = 0; i < profiler->samples->len;
+       i++)
+    {
+      g_assert_cmpint (samples[i].cycle, >=, 0);
+      g_assert_cmpint (
+        samples[i].cycle, <, NUM_CYCLES);
+      g_assert_cmpint (
+        samples[i].end, >=, samples[i].start);
+    }
+
+  /* export */
+  char * tmp_dir =
+    g_dir_make_tmp (
+      "zrythm_graph_profiler_XXXXXX", NULL);
+  char * path =
+    g_build_filename (
+      tmp_dir, "profile.json", NULL);
+  GError * err = NULL;
+  bool ret =
+    graph_profiler_export_chrome_trace (
+      profiler, path, &err);
+  g_assert_no_error (err);
+  g_assert_true (ret);
+
+  char * contents = NULL;
+  g_assert_true (
+    g_file_get_contents (
+      path, &contents, NULL, NULL));
+  g_assert_true (
+    g_str_has_prefix (
+      contents,
+      "{\"displayTimeUnit\":\"ns\","
+      "\"traceEvents\":["));
+  g_assert_nonnull (
+    strstr (contents, "\"ph\":\"X\""));
+  g_assert_nonnull (
+    strstr (contents, "\"thread_name\""));
+  g_free (contents);
+
+  g_unlink (path);
+  g_rmdir (tmp_dir);
+  g_free (path);
+  g_free (tmp_dir);
+
+  test_helper_zrythm_cleanup ();
+}
+
+/**
+ * Checks the aggregation with known durations.
+ */
+static void
+test_node_stats (void)
+{
+  test_helper_zrythm_init ();
+
+  AUDIO_ENGINE->stop_dummy_audio_thread = true;
+  g_usleep (1000000);
+
+  GraphProfiler * profiler = ROUTER->profiler;
+  router_start_profiling (ROUTER, 1);
+
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init (
+    &iter, ROUTER->graph->graph_nodes);
+  g_assert_true (
+    g_hash_table_iter_next (&iter, NULL, &value));
+  GraphNode * node = (GraphNode *) value;
+
+  /* record durations 1 to 100 in reverse order */
+  for (int i = 100; i >= 1; i--)
+    {
+      graph_profiler_record (
+        profiler, node, 1000, 1000 + i);
+    }
+  graph_profiler_stop (profiler);
+  g_assert_true (
+    graph_profiler_is_finished (profiler));
+
+  int num_stats = 0;
+  GraphProfilerNodeStats * stats =
+    graph_profiler_get_node_stats (
+      profiler, &num_stats);
+  g_assert_cmpint (num_stats, ==, 1);
+  g_assert_cmpint (stats[0].num_samples, ==, 100);
+  g_assert_cmpint (stats[0].min, ==, 1);
+  g_assert_cmpint (stats[0].max, ==, 100);
+  g_assert_cmpint (stats[0].avg, ==, 50);
+  g_assert_cmpint (stats[0].p99, ==, 99);
+  free (stats);
+
+  test_helper_zrythm_cleanup ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+#define TEST_PREFIX "/audio/graph_profiler/"
+
+  g_test_add_func (
+    TEST_PREFIX "test profile cycles",
+    (GTestFunc) test_profile_cycles);
+  g_test_add_func (
+    TEST_PREFIX "test node stats",
+    (GTestFunc) test_node_stats);
+
+  return g_test_run ();
+}
@@ -45,11 +45,473 @@ test_add_note_ons (void)
       MidiEvent * ev = &events->events[i];
 
       g_assert_cmpuint (ev->time, ==, _time);
-      g_assert_cmpuint (ev->velocity, ==, 121);
       g_assert_cmpuint (
-        ev->type, ==, MIDI_EVENT_TYPE_NOTE_ON);
+        midi_event_get_velocity (ev), ==, 121);
+      g_assert_cmpuint (
+        midi_event_get_type (ev), ==,
+        MIDI_EVENT_TYPE_NOTE_ON);
+    }
+
+  test_helper_zrythm_cleanup ();
+}
+
+static void
+test_dequeue (void)
+{
+  test_helper_zrythm_init ();
+
+  MidiEvents * events = midi_events_new ();
+
+  /* add events out of order with duplicates */
+  midi_events_add_note_on (
+    events, 1, 60, 90, 20, F_QUEUED);
+  midi_events_add_note_off (
+    events, 1, 60, 10, F_QUEUED);
+  midi_events_add_note_on (
+    events, 1, 60, 90, 20, F_QUEUED);
+  midi_events_add_note_on (
+    events, 2, 60, 90, 20, F_QUEUED);
+  midi_events_add_control_change (
+    events, 1, 7, 100, 5, F_QUEUED);
+  midi_events_add_control_change (
+    events, 1, 7, 100, 5, F_QUEUED);
+  midi_events_add_note_off (
+    events, 1, 60, 10, F_QUEUED);
+
+  midi_events_dequeue (events);
+  g_assert_cmpint (events->num_events, ==, 4);
+  g_assert_cmpuint (
+    midi_event_get_type (
+      &events->events[0]), ==,
+    MIDI_EVENT_TYPE_CONTROLLER);
+  g_assert_cmpuint (
+    midi_event_get_type (
+      &events->events[1]), ==,
+    MIDI_EVENT_TYPE_NOTE_OFF);
+  g_assert_cmpuint (events->events[2].time, ==, 20);
+  g_assert_cmpuint (events->events[3].time, ==, 20);
+  g_assert_cmpuint (
+    midi_event_get_channel (
+      &events->events[2]), !=,
+    midi_event_get_channel (
+      &events->events[3]));
+
+  /* queue is empty after dequeueing */
+  midi_events_dequeue (events);
+  g_assert_cmpint (events->num_events, ==, 0);
+
+  midi_events_free (events);
+
+  test_helper_zrythm_cleanup ();
+}
+
+static void
+test_dequeue_deferred (void)
+{
+  test_helper_zrythm_init ();
+
+  MidiEvents * events = midi_events_new ();
+
+  midi_events_add_note_on (
+    events, 1, 60, 90, 100, F_QUEUED);
+
+  /* pretend another thread has reserved the slot
+   * but not written it yet */
+  g_atomic_int_add (&events->queue->state, -1);
+  midi_events_dequeue (events);
+  g_assert_cmpint (events->num_events, ==, 0);
+
+  /* queue an event for the next cycle and let
+   * the writer finish */
+  midi_events_add_note_on (
+    events, 1, 62, 90, 50, F_QUEUED);
+  g_atomic_int_inc (&events->queue->state);
+
+  /* the deferred event is played at the start of
+   * the cycle and the new one keeps its time */
+  midi_events_dequeue (events);
+  g_assert_cmpint (events->num_events, ==, 2);
+  g_assert_cmpuint (events->events[0].time, ==, 0);
+  g_assert_cmpuint (
+    midi_event_get_note_pitch (
+      &events->events[0]), ==, 60);
+  g_assert_cmpuint (events->events[1].time, ==, 50);
+  g_assert_cmpuint (
+    midi_event_get_note_pitch (
+      &events->events[1]), ==, 62);
+
+  midi_events_free (events);
+
+  test_helper_zrythm_cleanup ();
+}
+
+static void
+test_engine_events_while_queueing (void)
+{
+  test_helper_zrythm_init ();
+
+  MidiEvents * events = midi_events_new ();
+
+  /* pretend another thread is in the middle of
+   * queueing an event */
+  midi_events_add_note_on (
+    events, 1, 60, 90, 100, F_QUEUED);
+  g_atomic_int_add (&events->queue->state, -1);
+  midi_events_dequeue (events);
+  g_assert_cmpint (events->num_events, ==, 0);
+
+  /* the engine's own events are written directly
+   * in order and keep their times */
+  midi_events_add_note_on (
+    events, 1, 64, 90, 30, F_NOT_QUEUED);
+  midi_events_add_note_off (
+    events, 1, 62, 10, F_NOT_QUEUED);
+  midi_events_add_control_change (
+    events, 1, 7, 100, 10, F_NOT_QUEUED);
+  midi_events_add_note_on (
+    events, 1, 65, 90, 40, F_NOT_QUEUED);
+  g_assert_cmpint (events->num_events, ==, 4);
+  g_assert_cmpuint (events->events[0].time, ==, 10);
+  g_assert_cmpuint (
+    midi_event_get_type (&events->events[0]), ==,
+    MIDI_EVENT_TYPE_CONTROLLER);
+  g_assert_cmpuint (events->events[1].time, ==, 10);
+  g_assert_cmpuint (
+    midi_event_get_type (&events->events[1]), ==,
+    MIDI_EVENT_TYPE_NOTE_OFF);
+  g_assert_cmpuint (events->events[2].time, ==, 30);
+  g_assert_cmpuint (events->events[3].time, ==, 40);
+
+  /* clearing the queue doesn't wait for the
+   * writer, and the event it was writing is
+   * dropped */
+  midi_events_clear (events, F_QUEUED);
+  g_atomic_int_inc (&events->queue->state);
+  midi_events_dequeue (events);
+  g_assert_cmpint (events->num_events, ==, 0);
+
+  /* events queued after the clear are kept */
+  midi_events_add_note_on (
+    events, 1, 62, 90, 50, F_QUEUED);
+  midi_events_dequeue (events);
+  g_assert_cmpint (events->num_events, ==, 1);
+  g_assert_cmpuint (events->events[0].time, ==, 50);
+
+  midi_events_free (events);
+
+  test_helper_zrythm_cleanup ();
+}
+
+#define NUM_THREADS 4
+#define NUM_EVENTS_PER_THREAD 500
+
+static void *
+queue_events_thread (
+  void * data)
+{
+  MidiEvents * events = (MidiEvents *) data;
+  for (int i = 0; i < NUM_EVENTS_PER_THREAD; i++)
+    {
+      midi_events_add_note_on (
+        events, 1, (midi_byte_t) (i % 128), 90,
+        (midi_time_t) i, F_QUEUED);
+    }
+
+  return NULL;
+}
+
+static void
+test_queue_from_threads (void)
+{
+  test_helper_zrythm_init ();
+
+  MidiEvents * events = midi_events_new ();
+
+  /* the buffers start small and are normally
+   * grown by the engine */
+  midi_events_reserve (
+    events, NUM_THREADS * NUM_EVENTS_PER_THREAD);
+
+  GThread * threads[NUM_THREADS];
+  for (int i = 0; i < NUM_THREADS; i++)
+    {
+      threads[i] =
+        g_thread_new (
+          "queue", queue_events_thread, events);
+    }
+  for (int i = 0; i < NUM_THREADS; i++)
+    {
+      g_thread_join (threads[i]);
+    }
+
+  /* all threads queued the same events, so the
+   * duplicates must be removed */
+  midi_events_dequeue (events);
+  g_assert_cmpint (
+    events->num_events, ==,
+    NUM_EVENTS_PER_THREAD);
+  for (int i = 0; i < events->num_events; i++)
+    {
+      g_assert_cmpuint (
+        events->events[i].time, ==, i);
+    }
+
+  midi_events_free (events);
+
+  test_helper_zrythm_cleanup ();
+}
+
+#define NUM_EVENTS_WHILE_GROWING 1000
+
+static void *
+queue_distinct_events_thread (
+  void * data)
+{
+  MidiEvents * events = (MidiEvents *) data;
+  for (int i = 0; i < NUM_EVENTS_WHILE_GROWING; i++)
+    {
+      midi_events_add_note_on (
+        events, 1, (midi_byte_t) (i % 128), 90,
+        (midi_time_t) i, F_QUEUED);
     }
 
+  return NULL;
+}
+
+static void
+test_grow_while_queueing (void)
+{
+  test_helper_zrythm_init ();
+
+  MidiEvents * events = midi_events_new ();
+
+  /* grow the queue while another thread (eg, the
+   * ALSA thread) keeps queueing into it */
+  GThread * thread =
+    g_thread_new (
+      "queue", queue_distinct_events_thread,
+      events);
+  for (int capacity =
+         MIDI_EVENTS_INITIAL_CAPACITY * 2;
+       capacity <= MAX_MIDI_EVENTS;
+       capacity *= 2)
+    {
+      midi_events_reserve (events, capacity);
+      g_thread_yield ();
+    }
+  g_thread_join (thread);
+
+  /* every event was either kept or counted as
+   * dropped */
+  int num_dropped =
+    g_atomic_int_get (&events->num_queue_dropped);
+  midi_events_dequeue (events);
+  g_assert_cmpint (
+    events->num_events + num_dropped, ==,
+    NUM_EVENTS_WHILE_GROWING);
+
+  midi_events_free (events);
+
+  test_helper_zrythm_cleanup ();
+}
+
+static void
+test_decode (void)
+{
+  test_helper_zrythm_init ();
+
+  MidiEvents * events = midi_events_new ();
+
+  midi_events_add_note_on (
+    events, 3, 64, 100, 0, F_NOT_QUEUED);
+  midi_events_add_control_change (
+    events, 16, 7, 80, 1, F_NOT_QUEUED);
+  midi_events_add_pitchbend (
+    events, 2, -8192, 2, F_NOT_QUEUED);
+  midi_events_add_pitchbend (
+    events, 2, 8191, 3, F_NOT_QUEUED);
+  midi_events_add_all_notes_off (
+    events, 5, 4, F_NOT_QUEUED);
+
+  MidiEvent * ev = &events->events[0];
+  g_assert_cmpuint (
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_ON);
+  g_assert_cmpuint (
+    midi_event_get_channel (ev), ==, 3);
+  g_assert_cmpuint (
+    midi_event_get_note_pitch (ev), ==, 64);
+  g_assert_cmpuint (
+    midi_event_get_velocity (ev), ==, 100);
+
+  ev = &events->events[1];
+  g_assert_cmpuint (
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_CONTROLLER);
+  g_assert_cmpuint (
+    midi_event_get_channel (ev), ==, 16);
+  g_assert_cmpuint (
+    midi_event_get_controller (ev), ==, 7);
+  g_assert_cmpuint (
+    midi_event_get_control (ev), ==, 80);
+
+  ev = &events->events[2];
+  g_assert_cmpuint (
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_PITCHBEND);
+  g_assert_cmpint (
+    midi_event_get_pitchbend (ev), ==, -8192);
+  ev = &events->events[3];
+  g_assert_cmpint (
+    midi_event_get_pitchbend (ev), ==, 8191);
+
+  ev = &events->events[4];
+  g_assert_cmpuint (
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_ALL_NOTES_OFF);
+  g_assert_cmpuint (
+    midi_event_get_channel (ev), ==, 5);
+
+  midi_events_free (events);
+
+  test_helper_zrythm_cleanup ();
+}
+
+static void
+test_grow (void)
+{
+  test_helper_zrythm_init ();
+
+  MidiEvents * events = midi_events_new ();
+  size_t initial_size =
+    midi_events_get_memory_size (events);
+  g_message (
+    "initial MIDI events size: %zu bytes",
+    initial_size);
+
+  /* the buffers used to be 3 fixed arrays of
+   * events of 48 bytes */
+  g_assert_cmpuint (
+    initial_size, <,
+    3 * MIDI_EVENTS_INITIAL_CAPACITY * 48);
+
+  /* overflow the main events and the queue */
+  midi_events_get_and_clear_overflow ();
+  int num_events =
+    MIDI_EVENTS_INITIAL_CAPACITY + 10;
+  for (int i = 0; i < num_events; i++)
+    {
+      midi_events_add_note_on (
+        events, 1, (midi_byte_t) (i % 128), 90,
+        (midi_time_t) i, F_NOT_QUEUED);
+      midi_events_add_note_on (
+        events, 1, (midi_byte_t) (i % 128), 90,
+        (midi_time_t) i, F_QUEUED);
+    }
+  g_assert_cmpint (
+    events->num_events, ==,
+    MIDI_EVENTS_INITIAL_CAPACITY);
+  g_assert_cmpint (events->num_dropped, ==, 10);
+  g_assert_cmpint (
+    events->num_queue_dropped, ==, 10);
+  g_assert_true (
+    midi_events_get_and_clear_overflow ());
+  g_assert_false (
+    midi_events_get_and_clear_overflow ());
+
+  /* the events are kept when growing */
+  g_assert_true (
+    midi_events_grow_if_dropped (events));
+  g_assert_cmpint (
+    events->capacity, >=, num_events);
+  g_assert_cmpint (
+    events->queue->capacity, >=, num_events);
+  g_assert_cmpint (
+    events->num_events, ==,
+    MIDI_EVENTS_INITIAL_CAPACITY);
+  for (int i = 0; i < events->num_events; i++)
+    {
+      g_assert_cmpuint (
+        events->events[i].time, ==, i);
+    }
+  g_assert_false (
+    midi_events_grow_if_dropped (events));
+  g_assert_cmpuint (
+    midi_events_get_memory_size (events), >,
+    initial_size);
+
+  midi_events_dequeue (events);
+  g_assert_cmpint (
+    events->num_events, ==,
+    MIDI_EVENTS_INITIAL_CAPACITY);
+
+  /* never grows past the max */
+  midi_events_reserve (
+    events, MAX_MIDI_EVENTS * 2);
+  g_assert_cmpint (
+    events->capacity, ==, MAX_MIDI_EVENTS);
+
+  midi_events_free (events);
+
+  test_helper_zrythm_cleanup ();
+}
+
+static void
+test_note_offs_never_dropped (void)
+{
+  test_helper_zrythm_init ();
+
+  MidiEvents * events = midi_events_new ();
+
+  /* fill the main events and the queue */
+  for (int i = 0;
+       i < MIDI_EVENTS_INITIAL_CAPACITY + 10; i++)
+    {
+      midi_events_add_note_on (
+        events, 1, (midi_byte_t) (i % 128), 90,
+        (midi_time_t) i, F_NOT_QUEUED);
+      midi_events_add_note_on (
+        events, 1, (midi_byte_t) (i % 128), 90,
+        (midi_time_t) i, F_QUEUED);
+    }
+  g_assert_cmpint (events->num_dropped, ==, 10);
+  g_assert_cmpint (
+    events->num_queue_dropped, ==, 10);
+
+  /* note offs for every channel and pitch still
+   * fit */
+  for (midi_byte_t ch = 1; ch <= 16; ch++)
+    {
+      for (midi_byte_t pitch = 0; pitch < 128;
+           pitch++)
+        {
+          midi_events_add_note_off (
+            events, ch, pitch,
+            MIDI_EVENTS_INITIAL_CAPACITY,
+            F_NOT_QUEUED);
+          midi_events_add_note_off (
+            events, ch, pitch,
+            MIDI_EVENTS_INITIAL_CAPACITY,
+            F_QUEUED);
+        }
+    }
+  g_assert_cmpint (events->num_dropped, ==, 10);
+  g_assert_cmpint (
+    events->num_queue_dropped, ==, 10);
+  g_assert_cmpint (
+    events->num_events, ==,
+    MIDI_EVENTS_INITIAL_CAPACITY +
+      MIDI_EVENTS_NOTE_OFF_HEADROOM);
+
+  /* anything else is dropped */
+  midi_events_add_note_on (
+    events, 1, 60, 90, 0, F_NOT_QUEUED);
+  midi_events_add_all_notes_off (
+    events, 1, 0, F_NOT_QUEUED);
+  g_assert_cmpint (events->num_dropped, ==, 12);
+
+  midi_events_free (events);
+
   test_helper_zrythm_cleanup ();
 }
 
@@ -63,6 +525,30 @@ main (int argc, char *argv[])
   g_test_add_func (
     TEST_PREFIX "test add note ons",
     (GTestFunc) test_add_note_ons);
+  g_test_add_func (
+    TEST_PREFIX "test dequeue",
+    (GTestFunc) test_dequeue);
+  g_test_add_func (
+    TEST_PREFIX "test dequeue deferred",
+    (GTestFunc) test_dequeue_deferred);
+  g_test_add_func (
+    TEST_PREFIX "test engine events while queueing",
+    (GTestFunc) test_engine_events_while_queueing);
+  g_test_add_func (
+    TEST_PREFIX "test queue from threads",
+    (GTestFunc) test_queue_from_threads);
+  g_test_add_func (
+    TEST_PREFIX "test grow while queueing",
+    (GTestFunc) test_grow_while_queueing);
+  g_test_add_func (
+    TEST_PREFIX "test decode",
+    (GTestFunc) test_decode);
+  g_test_add_func (
+    TEST_PREFIX "test grow",
+    (GTestFunc) test_grow);
+  g_test_add_func (
+    TEST_PREFIX "test note offs never dropped",
+    (GTestFunc) test_note_offs_never_dropped);
 
   return g_test_run ();
 }
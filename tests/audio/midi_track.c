@@ -128,19 +128,23 @@ test_fill_midi_events ()
     .g_start_frames = pos.frames,
     .local_offset = 0,
     .nframes = BUFFER_SIZE, };
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 1);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 1);
+  ev = &events->events[0];
   g_assert_nonnull (ev);
   g_assert_cmpuint (
-    ev->channel, ==, midi_region_get_midi_ch (r));
-  g_assert_cmpuint (ev->note_pitch, ==, pitch1);
-  g_assert_cmpuint (ev->velocity, ==, vel1);
+    midi_event_get_channel (ev), ==,
+    midi_region_get_midi_ch (r));
+  g_assert_cmpuint (
+    midi_event_get_note_pitch (ev), ==, pitch1);
+  g_assert_cmpuint (
+    midi_event_get_velocity (ev), ==, vel1);
   g_assert_cmpint (
     (long) ev->time, ==, pos.frames);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /*
    * Start: region start + 1
@@ -153,10 +157,11 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames + 1;
   time_nfo.local_offset = 1;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 0);
+    events->num_events, ==, 0);
 
   /*
    * Start: region start
@@ -169,11 +174,12 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = 1;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 1);
-  midi_events_clear (events, F_QUEUED);
+    events->num_events, ==, 1);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /*
    * Start: region start + BUFFER_SIZE
@@ -186,10 +192,11 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 0);
+    events->num_events, ==, 0);
 
   /*
    * Start: region end - (BUFFER_SIZE + 1)
@@ -205,10 +212,11 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 0);
+    events->num_events, ==, 0);
 
   /*
    * Start: region end - BUFFER_SIZE
@@ -224,21 +232,24 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 2);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 2);
+  ev = &events->events[0];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_NOTE_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_OFF);
   g_assert_cmpuint (
     ev->time, ==, BUFFER_SIZE - 1);
-  ev = &events->queued_events[1];
+  ev = &events->events[1];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_ALL_NOTES_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_ALL_NOTES_OFF);
   g_assert_cmpuint (
     ev->time, ==, BUFFER_SIZE - 1);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /*
    * Start: midi end - BUFFER_SIZE
@@ -259,16 +270,17 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 1);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 1);
+  ev = &events->events[0];
   g_assert_cmpuint (
     ev->time, ==, BUFFER_SIZE - 1);
   position_set_to_pos (
     &mn_obj->end_pos, &r_obj->end_pos);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /*
    * Start: (midi end - BUFFER_SIZE) + 1
@@ -288,16 +300,17 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 1);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 1);
+  ev = &events->events[0];
   g_assert_cmpuint (
     ev->time, ==, BUFFER_SIZE - 2);
   position_set_to_pos (
     &mn_obj->end_pos, &r_obj->end_pos);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /*
    * Start: region end - (BUFFER_SIZE - 1)
@@ -313,21 +326,24 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 2);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 2);
+  ev = &events->events[0];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_NOTE_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_OFF);
   g_assert_cmpuint (
     ev->time, ==, BUFFER_SIZE - 2);
-  ev = &events->queued_events[1];
+  ev = &events->events[1];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_ALL_NOTES_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_ALL_NOTES_OFF);
   g_assert_cmpuint (
     ev->time, ==, BUFFER_SIZE - 2);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /*
    * Initialization
@@ -370,10 +386,11 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = 512;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 0);
+    events->num_events, ==, 0);
 
   /*
    * Initialization
@@ -422,20 +439,23 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = 2000;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 2);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 2);
+  ev = &events->events[0];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_ALL_NOTES_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_ALL_NOTES_OFF);
   g_assert_cmpuint (ev->time, ==, 364);
-  ev = &events->queued_events[1];
+  ev = &events->events[1];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_NOTE_ON);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_ON);
   g_assert_cmpuint (
     ev->time, ==, 365);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /* -- REGION LOOP TESTS -- */
 
@@ -480,10 +500,11 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 0);
+    events->num_events, ==, 0);
   position_add_ticks (
     &mn_obj->pos, 1);
   position_update_frames_from_ticks (&mn_obj->pos);
@@ -501,10 +522,11 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 0);
+    events->num_events, ==, 0);
 
   /**
    * Start: frame after region end
@@ -519,10 +541,11 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 0);
+    events->num_events, ==, 0);
 
   /**
    * Start: before region start
@@ -537,14 +560,15 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 1);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 1);
+  ev = &events->events[0];
   g_assert_cmpuint (
     ev->time, ==, 10);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /**
    * Start: before region start
@@ -559,14 +583,15 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 1);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 1);
+  ev = &events->events[0];
   g_assert_cmpuint (
     ev->time, ==, 10);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /*
    * Initialization
@@ -613,26 +638,30 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
   g_assert_cmpint (
-    events->num_queued_events, ==, 3);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 3);
+  ev = &events->events[0];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_NOTE_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_OFF);
   g_assert_cmpuint (
     ev->time, ==, 9);
-  ev = &events->queued_events[1];
+  ev = &events->events[1];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_ALL_NOTES_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_ALL_NOTES_OFF);
   g_assert_cmpuint (
     ev->time, ==, 9);
-  ev = &events->queued_events[2];
+  ev = &events->events[2];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_NOTE_ON);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_ON);
   g_assert_cmpuint (
     ev->time, ==, 10);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /**
    * Premise: note ends on region end (no loops).
@@ -658,22 +687,25 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
-  midi_events_print (events, F_QUEUED);
+  midi_events_print (events, F_NOT_QUEUED);
   g_assert_cmpint (
-    events->num_queued_events, ==, 2);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 2);
+  ev = &events->events[0];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_NOTE_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_OFF);
   g_assert_cmpuint (
     ev->time, ==, 9);
-  ev = &events->queued_events[1];
+  ev = &events->events[1];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_ALL_NOTES_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_ALL_NOTES_OFF);
   g_assert_cmpuint (
     ev->time, ==, 9);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /**
    * Premise:
@@ -705,16 +737,18 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = BUFFER_SIZE;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
-  midi_events_print (events, F_QUEUED);
+  midi_events_print (events, F_NOT_QUEUED);
   g_assert_cmpint (
-    events->num_queued_events, ==, 1);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 1);
+  ev = &events->events[0];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_NOTE_ON);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_ON);
   g_assert_cmpuint (ev->time, ==, 0);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /**
    * Premise: note starts at 1.1.1.0 and ends right
@@ -745,33 +779,38 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = 30;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
-  midi_events_print (events, F_QUEUED);
+  midi_events_print (events, F_NOT_QUEUED);
   g_assert_cmpint (
-    events->num_queued_events, ==, 2);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 2);
+  ev = &events->events[0];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_NOTE_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_OFF);
   g_assert_cmpuint (ev->time, ==, 9);
-  ev = &events->queued_events[1];
+  ev = &events->events[1];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_ALL_NOTES_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_ALL_NOTES_OFF);
   g_assert_cmpuint (ev->time, ==, 29);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   position_set_to_pos (
     &pos, &TRANSPORT->loop_start_pos);
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = 10;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
-  ev = &events->queued_events[0];
+  ev = &events->events[0];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_NOTE_ON);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_ON);
   g_assert_cmpuint (ev->time, ==, 0);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /**
    *
@@ -803,20 +842,23 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = 50;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
-  midi_events_print (events, F_QUEUED);
+  midi_events_print (events, F_NOT_QUEUED);
   g_assert_cmpint (
-    events->num_queued_events, ==, 2);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 2);
+  ev = &events->events[0];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_NOTE_ON);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_ON);
   g_assert_cmpuint (ev->time, ==, 10);
-  ev = &events->queued_events[1];
+  ev = &events->events[1];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_ALL_NOTES_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_ALL_NOTES_OFF);
   g_assert_cmpuint (ev->time, ==, 39);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   /**
    * Premise: region loops back near the end.
@@ -847,24 +889,28 @@ test_fill_midi_events ()
   time_nfo.g_start_frames = pos.frames;
   time_nfo.local_offset = 0;
   time_nfo.nframes = 50;
+  midi_events_clear (events, F_NOT_QUEUED);
   track_fill_events (
     track, &time_nfo, events, NULL);
-  midi_events_print (events, F_QUEUED);
+  midi_events_print (events, F_NOT_QUEUED);
   g_assert_cmpint (
-    events->num_queued_events, ==, 3);
-  ev = &events->queued_events[0];
+    events->num_events, ==, 3);
+  ev = &events->events[0];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_ALL_NOTES_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_ALL_NOTES_OFF);
   g_assert_cmpuint (ev->time, ==, 4);
-  ev = &events->queued_events[1];
+  ev = &events->events[1];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_NOTE_ON);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_ON);
   g_assert_cmpuint (ev->time, ==, 5);
-  ev = &events->queued_events[2];
+  ev = &events->events[2];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_ALL_NOTES_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_ALL_NOTES_OFF);
   g_assert_cmpuint (ev->time, ==, 14);
-  midi_events_clear (events, F_QUEUED);
+  midi_events_clear (events, F_NOT_QUEUED);
 
   test_helper_zrythm_cleanup ();
 }
@@ -921,19 +967,25 @@ test_fill_midi_events_from_engine ()
     midi_events->num_events, ==, 3);
   MidiEvent * ev = &midi_events->events[0];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_NOTE_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_OFF);
   g_assert_cmpuint (ev->time, ==, 19);
-  g_assert_cmpuint (ev->note_pitch, ==, 35);
+  g_assert_cmpuint (
+    midi_event_get_note_pitch (ev), ==, 35);
   ev = &midi_events->events[1];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_ALL_NOTES_OFF);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_ALL_NOTES_OFF);
   g_assert_cmpuint (ev->time, ==, 19);
   ev = &midi_events->events[2];
   g_assert_cmpuint (
-    ev->type, ==, MIDI_EVENT_TYPE_NOTE_ON);
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_NOTE_ON);
   g_assert_cmpuint (ev->time, ==, 20);
-  g_assert_cmpuint (ev->note_pitch, ==, 35);
-  g_assert_cmpuint (ev->velocity, ==, 60);
+  g_assert_cmpuint (
+    midi_event_get_note_pitch (ev), ==, 35);
+  g_assert_cmpuint (
+    midi_event_get_velocity (ev), ==, 60);
 
   /* process again and check events are 0 */
   g_message ("--- processing engine...");
@@ -23,6 +23,8 @@
 
 #include "audio/engine_dummy.h"
 #include "audio/audio_track.h"
+#include "audio/quantize_options.h"
+#include "audio/snap_grid.h"
 #include "project.h"
 #include "utils/flags.h"
 #include "zrythm.h"
@@ -33,30 +35,125 @@
 #include <locale.h>
 
 static void
-test_update_snap_points ()
+test_get_nearby_snap_point (void)
 {
   test_helper_zrythm_init ();
 
   SnapGrid sg;
-  gint64 before, after;
-
   snap_grid_init (
     &sg, SNAP_GRID_TYPE_TIMELINE,
     NOTE_LENGTH_1_128);
+  sg.snap_note_type = NOTE_TYPE_TRIPLET;
+  double ticks =
+    (double) snap_grid_get_snap_ticks (&sg);
+  g_assert_cmpfloat (ticks, >, 0);
+
+  Position pos, ret;
+  bool found;
 
-#define TEST_WITH_MAX_BARS(x) \
-  before = g_get_monotonic_time (); \
-  snap_grid_update_snap_points ( \
-    &sg, x); \
-  after = g_get_monotonic_time (); \
-  g_message ("time %ld", after - before)
+  /* start of the timeline */
+  position_init (&pos);
+  found =
+    snap_grid_get_nearby_snap_point (
+      &sg, &pos, true, true, &ret);
+  g_assert_true (found);
+  g_assert_cmpfloat_with_epsilon (
+    ret.ticks, 0, 0.0001);
+  found =
+    snap_grid_get_nearby_snap_point (
+      &sg, &pos, true, false, &ret);
+  g_assert_false (found);
+  g_assert_true (position_is_equal (&ret, &pos));
+  found =
+    snap_grid_get_nearby_snap_point (
+      &sg, &pos, false, false, &ret);
+  g_assert_true (found);
+  g_assert_cmpfloat_with_epsilon (
+    ret.ticks, ticks, 0.0001);
 
-  TEST_WITH_MAX_BARS (100);
-  TEST_WITH_MAX_BARS (1000);
-#if 0
-  TEST_WITH_MAX_BARS (10000);
-  TEST_WITH_MAX_BARS (100000);
-#endif
+  /* far away position between grid points (the
+   * grid is not limited to a number of bars) */
+  position_from_ticks (
+    &pos, 1000000 * ticks + 1);
+  found =
+    snap_grid_get_nearby_snap_point (
+      &sg, &pos, true, true, &ret);
+  g_assert_true (found);
+  g_assert_cmpfloat_with_epsilon (
+    ret.ticks, 1000000 * ticks, 0.0001);
+  found =
+    snap_grid_get_nearby_snap_point (
+      &sg, &pos, false, true, &ret);
+  g_assert_true (found);
+  g_assert_cmpfloat_with_epsilon (
+    ret.ticks, 1000001 * ticks, 0.0001);
+
+  /* position on a grid point */
+  position_from_ticks (&pos, 20 * ticks);
+  found =
+    snap_grid_get_nearby_snap_point (
+      &sg, &pos, true, false, &ret);
+  g_assert_true (found);
+  g_assert_cmpfloat_with_epsilon (
+    ret.ticks, 19 * ticks, 0.0001);
+  found =
+    snap_grid_get_nearby_snap_point (
+      &sg, &pos, false, true, &ret);
+  g_assert_true (found);
+  g_assert_cmpfloat_with_epsilon (
+    ret.ticks, 20 * ticks, 0.0001);
+  found =
+    snap_grid_get_nearby_snap_point (
+      &sg, &pos, false, false, &ret);
+  g_assert_true (found);
+  g_assert_cmpfloat_with_epsilon (
+    ret.ticks, 21 * ticks, 0.0001);
+
+  test_helper_zrythm_cleanup ();
+}
+
+static void
+test_quantize_position (void)
+{
+  test_helper_zrythm_init ();
+
+  QuantizeOptions qo;
+  quantize_options_init (&qo, NOTE_LENGTH_1_4);
+  double ticks = TICKS_PER_QUARTER_NOTE;
+
+  Position pos;
+  double diff;
+
+  position_from_ticks (&pos, 1.4 * ticks);
+  diff =
+    quantize_options_quantize_position (
+      &qo, &pos);
+  g_assert_cmpfloat_with_epsilon (
+    diff, -0.4 * ticks, 0.0001);
+  g_assert_cmpfloat_with_epsilon (
+    pos.ticks, ticks, 0.0001);
+
+  /* every second point is delayed by the
+   * swing */
+  qo.swing = 50.f;
+  position_from_ticks (&pos, 1.1 * ticks);
+  diff =
+    quantize_options_quantize_position (
+      &qo, &pos);
+  g_assert_cmpfloat_with_epsilon (
+    pos.ticks, 1.25 * ticks, 0.0001);
+  position_from_ticks (&pos, 1.9 * ticks);
+  diff =
+    quantize_options_quantize_position (
+      &qo, &pos);
+  g_assert_cmpfloat_with_epsilon (
+    pos.ticks, 2 * ticks, 0.0001);
+  position_from_ticks (&pos, 3.2 * ticks);
+  diff =
+    quantize_options_quantize_position (
+      &qo, &pos);
+  g_assert_cmpfloat_with_epsilon (
+    pos.ticks, 3.25 * ticks, 0.0001);
 
   test_helper_zrythm_cleanup ();
 }
@@ -69,8 +166,11 @@ main (int argc, char *argv[])
 #define TEST_PREFIX "/audio/snap grid/"
 
   g_test_add_func (
-    TEST_PREFIX "test update snap points",
-    (GTestFunc) test_update_snap_points);
+    TEST_PREFIX "test get nearby snap point",
+    (GTestFunc) test_get_nearby_snap_point);
+  g_test_add_func (
+    TEST_PREFIX "test quantize position",
+    (GTestFunc) test_quantize_position);
 
   return g_test_run ();
 }
@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-test-config.h"
+
+#include <math.h>
+
+#include "audio/position.h"
+#include "audio/tempo_map.h"
+#include "utils/math.h"
+
+#include <glib.h>
+
+/**
+ * Rounds towards 0 like the division-based
+ * position functions.
+ */
+static int
+ref_trunc (
+  double val)
+{
+  return
+    val >= 0.0 ? (int) floor (val) : (int) ceil (val);
+}
+
+static int
+ref_start_at_one (
+  int    val,
+  double total)
+{
+  return total >= 0.0 ? val + 1 : val - 1;
+}
+
+/**
+ * Checks the map against the division-based
+ * calculations position_get_*() used before.
+ */
+static void
+check_musical_time (
+  const TempoMap * map,
+  double           ticks)
+{
+  double tpb = map->ticks_per_bar;
+  double tpbeat = map->ticks_per_beat;
+  int bpb = map->beats_per_bar;
+
+  double total_bars = ticks / tpb;
+  int bars = ref_trunc (total_bars);
+  double total_beats =
+    ticks / tpbeat - (double) (bars * bpb);
+  int beats = ref_trunc (total_beats);
+  double all_beats =
+    (double) (beats + bars * bpb);
+  double total_sixteenths =
+    ticks / TICKS_PER_SIXTEENTH_NOTE_DBL -
+    all_beats * map->sixteenths_per_beat;
+  int sixteenths = ref_trunc (total_sixteenths);
+  double rem_ticks =
+    ticks -
+    ref_trunc (ticks / TICKS_PER_SIXTEENTH_NOTE_DBL) *
+      TICKS_PER_SIXTEENTH_NOTE_DBL;
+
+  MusicalTime time;
+  tempo_map_get_musical_time (
+    map, ticks, false, &time);
+  g_assert_cmpint (time.bars, ==, bars);
+  g_assert_cmpint (time.beats, ==, beats);
+  g_assert_cmpint (time.sixteenths, ==, sixteenths);
+  g_assert_cmpfloat (time.ticks, ==, rem_ticks);
+  g_assert_cmpfloat (
+    time.beat_ticks, ==, ticks - all_beats * tpbeat);
+  g_assert_cmpfloat (
+    time.bar_ticks, ==, ticks - bars * tpb);
+
+  tempo_map_get_musical_time (
+    map, ticks, true, &time);
+  g_assert_cmpint (
+    time.bars, ==,
+    ref_start_at_one (bars, total_bars));
+  g_assert_cmpint (
+    time.beats, ==,
+    ref_start_at_one (beats, total_beats));
+  g_assert_cmpint (
+    time.sixteenths, ==,
+    ref_start_at_one (
+      sixteenths, total_sixteenths));
+  g_assert_cmpfloat (time.ticks, ==, rem_ticks);
+}
+
+static void
+test_musical_time (void)
+{
+  /* 4/4, 7/8 and 3/2 */
+  const int time_sigs[][2] = {
+    { 4, 960 }, { 7, 480 }, { 3, 1920 } };
+  for (size_t i = 0; i < G_N_ELEMENTS (time_sigs);
+       i++)
+    {
+      TempoMap * map =
+        tempo_map_new (
+          time_sigs[i][0], time_sigs[i][1],
+          44100, 120.f);
+
+      for (int j = -40000; j <= 40000; j += 37)
+        {
+          check_musical_time (map, (double) j);
+          check_musical_time (
+            map, (double) j + 0.4321);
+        }
+
+      /* around the bar and beat boundaries */
+      for (int j = -12; j <= 12; j++)
+        {
+          double ticks = j * map->ticks_per_bar;
+          check_musical_time (map, ticks);
+          check_musical_time (map, ticks - 0.25);
+          check_musical_time (map, ticks + 0.25);
+          check_musical_time (map, ticks - 1e-6);
+          check_musical_time (map, ticks + 1e-6);
+          ticks += map->ticks_per_beat;
+          check_musical_time (map, ticks);
+          check_musical_time (map, ticks - 1e-6);
+        }
+
+      /* the array version gives the same
+       * results */
+      double ticks[] = {
+        -7680.5, 0, 1, 3839.9, 3840, 100000.125 };
+      MusicalTime times[G_N_ELEMENTS (ticks)];
+      tempo_map_get_musical_time_array (
+        map, ticks, times, G_N_ELEMENTS (ticks),
+        true);
+      for (size_t j = 0; j < G_N_ELEMENTS (ticks);
+           j++)
+        {
+          MusicalTime time;
+          tempo_map_get_musical_time (
+            map, ticks[j], true, &time);
+          g_assert_cmpint (
+            times[j].bars, ==, time.bars);
+          g_assert_cmpint (
+            times[j].beats, ==, time.beats);
+          g_assert_cmpint (
+            times[j].sixteenths, ==,
+            time.sixteenths);
+          g_assert_cmpfloat (
+            times[j].ticks, ==, time.ticks);
+        }
+
+      tempo_map_free (map);
+    }
+}
+
+static void
+test_single_segment (void)
+{
+  /* 44100 Hz at 120 BPM in 4/4 */
+  double frames_per_tick =
+    (44100.0 * 60.0 * 4.0) / (120.0 * 3840.0);
+  double ticks_per_frame = 1.0 / frames_per_tick;
+  TempoMap * map =
+    tempo_map_new (4, 960, 44100, 120.f);
+  tempo_map_add_segment (map, 0.0, 120.f);
+  g_assert_cmpfloat (
+    map->segments[0].frames_per_tick, ==,
+    frames_per_tick);
+
+  /* same results as multiplying directly */
+  for (long frames = -100003; frames < 300000;
+       frames += 997)
+    {
+      g_assert_cmpfloat (
+        tempo_map_frames_to_ticks (map, frames), ==,
+        (double) frames * ticks_per_frame);
+    }
+  for (double ticks = -3000.3; ticks < 50000;
+       ticks += 123.45)
+    {
+      g_assert_cmpint (
+        tempo_map_ticks_to_frames (map, ticks), ==,
+        math_round_double_to_long (
+          ticks * frames_per_tick));
+    }
+
+  tempo_map_free (map);
+}
+
+static void
+test_multiple_segments (void)
+{
+  /* 20, 10 and 40 frames per tick at 48000 Hz,
+   * plus a segment with an unchanged BPM that is
+   * not added */
+  TempoMap * map =
+    tempo_map_new (4, 960, 48000, 150.f);
+  tempo_map_add_segment (map, 0.0, 150.f);
+  tempo_map_add_segment (map, 3840.0, 300.f);
+  tempo_map_add_segment (map, 5000.0, 300.f);
+  tempo_map_add_segment (map, 7680.0, 75.f);
+  g_assert_cmpint (map->num_segments, ==, 3);
+  g_assert_cmpfloat (
+    map->segments[1].frames_per_tick, ==, 10.0);
+  g_assert_cmpfloat (
+    map->segments[1].start_frames, ==, 76800.0);
+  g_assert_cmpfloat (
+    map->segments[2].start_frames, ==, 115200.0);
+
+  /* segment lookup */
+  g_assert_cmpint (
+    tempo_map_get_segment_at_ticks (map, -10.0),
+    ==, 0);
+  g_assert_cmpint (
+    tempo_map_get_segment_at_ticks (map, 3839.0),
+    ==, 0);
+  g_assert_cmpint (
+    tempo_map_get_segment_at_ticks (map, 3840.0),
+    ==, 1);
+  g_assert_cmpint (
+    tempo_map_get_segment_at_ticks (map, 1e9),
+    ==, 2);
+  g_assert_cmpint (
+    tempo_map_get_segment_at_frames (map, -10),
+    ==, 0);
+  g_assert_cmpint (
+    tempo_map_get_segment_at_frames (map, 76800),
+    ==, 1);
+  g_assert_cmpint (
+    tempo_map_get_segment_at_frames (map, 115199),
+    ==, 1);
+  g_assert_cmpint (
+    tempo_map_get_segment_at_frames (map, 115200),
+    ==, 2);
+
+  /* BPM lookup */
+  g_assert_cmpfloat (
+    tempo_map_get_bpm_at_ticks (map, -10.0), ==,
+    150.f);
+  g_assert_cmpfloat (
+    tempo_map_get_bpm_at_ticks (map, 3840.0), ==,
+    300.f);
+  g_assert_cmpfloat (
+    tempo_map_get_bpm_at_ticks (map, 7679.9), ==,
+    300.f);
+  g_assert_cmpfloat (
+    tempo_map_get_bpm_at_ticks (map, 1e6), ==,
+    75.f);
+  g_assert_cmpfloat (
+    tempo_map_get_bpm_at_frames (map, 76799), ==,
+    150.f);
+  g_assert_cmpfloat (
+    tempo_map_get_bpm_at_frames (map, 115200), ==,
+    75.f);
+
+  /* conversions */
+  g_assert_cmpfloat (
+    tempo_map_frames_to_ticks (map, -200), ==,
+    -10.0);
+  g_assert_cmpfloat (
+    tempo_map_frames_to_ticks (map, 76900), ==,
+    3850.0);
+  g_assert_cmpfloat (
+    tempo_map_frames_to_ticks (map, 115600), ==,
+    7690.0);
+  g_assert_cmpint (
+    tempo_map_ticks_to_frames (map, 3850.0), ==,
+    76900);
+  g_assert_cmpint (
+    tempo_map_ticks_to_frames (map, 7690.0), ==,
+    115600);
+
+  /* the array versions give the same results,
+   * in and out of order */
+  long frames[] = {
+    -50, 0, 1000, 76800, 80000, 115200, 200000,
+    3000, 120000, -1000 };
+  double ticks[G_N_ELEMENTS (frames)];
+  long frames_back[G_N_ELEMENTS (frames)];
+  tempo_map_frames_to_ticks_array (
+    map, frames, ticks, G_N_ELEMENTS (frames));
+  tempo_map_ticks_to_frames_array (
+    map, ticks, frames_back,
+    G_N_ELEMENTS (frames));
+  for (size_t i = 0; i < G_N_ELEMENTS (frames);
+       i++)
+    {
+      g_assert_cmpfloat (
+        ticks[i], ==,
+        tempo_map_frames_to_ticks (
+          map, frames[i]));
+      g_assert_cmpint (
+        frames_back[i], ==, frames[i]);
+    }
+
+  tempo_map_free (map);
+}
+
+static void
+test_is_equal (void)
+{
+  TempoMap * a =
+    tempo_map_new (4, 960, 48000, 120.f);
+  tempo_map_add_segment (a, 0.0, 120.f);
+  tempo_map_add_segment (a, 3840.0, 140.f);
+  TempoMap * b =
+    tempo_map_new (4, 960, 48000, 120.f);
+  tempo_map_add_segment (b, 0.0, 120.f);
+  tempo_map_add_segment (b, 3840.0, 140.f);
+  g_assert_true (tempo_map_is_equal (a, b));
+
+  /* different tempo */
+  tempo_map_add_segment (b, 7680.0, 90.f);
+  g_assert_false (tempo_map_is_equal (a, b));
+  tempo_map_free (b);
+
+  /* different sample rate */
+  b = tempo_map_new (4, 960, 44100, 120.f);
+  tempo_map_add_segment (b, 0.0, 120.f);
+  tempo_map_add_segment (b, 3840.0, 140.f);
+  g_assert_false (tempo_map_is_equal (a, b));
+  tempo_map_free (b);
+
+  /* different time signature */
+  b = tempo_map_new (3, 960, 48000, 120.f);
+  tempo_map_add_segment (b, 0.0, 120.f);
+  tempo_map_add_segment (b, 3840.0, 140.f);
+  g_assert_false (tempo_map_is_equal (a, b));
+  tempo_map_free (b);
+
+  tempo_map_free (a);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+#define TEST_PREFIX "/audio/tempo_map/"
+
+  g_test_add_func (
+    TEST_PREFIX "test musical time",
+    (GTestFunc) test_musical_time);
+  g_test_add_func (
+    TEST_PREFIX "test single segment",
+    (GTestFunc) test_single_segment);
+  g_test_add_func (
+    TEST_PREFIX "test multiple segments",
+    (GTestFunc) test_multiple_segments);
+  g_test_add_func (
+    TEST_PREFIX "test is equal",
+    (GTestFunc) test_is_equal);
+
+  return g_test_run ();
+}
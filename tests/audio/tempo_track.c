@@ -19,6 +19,10 @@
 
 #include "zrythm-test-config.h"
 
+#include "audio/automation_region.h"
+#include "audio/control_port.h"
+#include "audio/engine.h"
+#include "audio/tempo_map.h"
 #include "audio/transport.h"
 #include "project.h"
 #include "utils/flags.h"
@@ -53,6 +57,108 @@ test_load_project_bpm (void)
   test_helper_zrythm_cleanup ();
 }
 
+/**
+ * Adds a BPM automation region from bar 1 to bar
+ * 5 that ramps from 120 to 180 BPM in the first
+ * bar and then stays at 180 BPM.
+ */
+static ZRegion *
+add_bpm_automation (void)
+{
+  Port * port = P_TEMPO_TRACK->bpm_port;
+  AutomationTrack * at = port->at;
+  g_assert_nonnull (at);
+
+  Position pos, end_pos;
+  position_set_to_bar (&pos, 1);
+  position_set_to_bar (&end_pos, 5);
+  ZRegion * r =
+    automation_region_new (
+      &pos, &end_pos,
+      track_get_name_hash (P_TEMPO_TRACK),
+      at->index, 0);
+  track_add_region (
+    P_TEMPO_TRACK, r, at, 0, F_GEN_NAME,
+    F_NO_PUBLISH_EVENTS);
+
+  AutomationPoint * ap =
+    automation_point_new_float (
+      120.f,
+      control_port_real_val_to_normalized (
+        port, 120.f),
+      &pos);
+  automation_region_add_ap (
+    r, ap, F_NO_PUBLISH_EVENTS);
+  position_set_to_bar (&pos, 2);
+  ap =
+    automation_point_new_float (
+      180.f,
+      control_port_real_val_to_normalized (
+        port, 180.f),
+      &pos);
+  automation_region_add_ap (
+    r, ap, F_NO_PUBLISH_EVENTS);
+
+  return r;
+}
+
+static void
+test_bpm_automation (void)
+{
+  test_helper_zrythm_init ();
+
+  g_assert_false (
+    AUDIO_ENGINE->tempo_map->automated);
+
+  ZRegion * r = add_bpm_automation ();
+  engine_update_tempo_automation (AUDIO_ENGINE);
+
+  const TempoMap * map = AUDIO_ENGINE->tempo_map;
+  g_assert_true (map->automated);
+
+  /* ramp in the first bar */
+  Position pos;
+  position_from_ticks (
+    &pos, map->ticks_per_bar / 2.0);
+  bpm_t ramp_bpm =
+    tempo_track_get_bpm_at_pos (
+      P_TEMPO_TRACK, &pos);
+  g_assert_cmpfloat (ramp_bpm, >, 120.f);
+  g_assert_cmpfloat (ramp_bpm, <, 180.f);
+
+  /* constant after the last point and after the
+   * region */
+  position_set_to_bar (&pos, 3);
+  g_assert_cmpfloat_with_epsilon (
+    tempo_track_get_bpm_at_pos (
+      P_TEMPO_TRACK, &pos), 180.f, 0.001f);
+  position_set_to_bar (&pos, 9);
+  g_assert_cmpfloat_with_epsilon (
+    tempo_track_get_bpm_at_pos (
+      P_TEMPO_TRACK, &pos), 180.f, 0.001f);
+
+  /* positions follow the map */
+  ArrangerObject * r_obj = (ArrangerObject *) r;
+  g_assert_cmpint (
+    r_obj->end_pos.frames, ==,
+    tempo_map_ticks_to_frames (
+      map, r_obj->end_pos.ticks));
+  double frames_per_tick =
+    tempo_map_get_frames_per_tick (map, 180.f);
+  position_set_to_bar (&pos, 4);
+  Position pos2;
+  position_set_to_bar (&pos2, 3);
+  g_assert_cmpfloat_with_epsilon (
+    (double) (pos.frames - pos2.frames),
+    map->ticks_per_bar * frames_per_tick, 1.0);
+
+  /* without changes the map is kept */
+  g_assert_false (
+    engine_update_tempo_map (AUDIO_ENGINE, 0));
+
+  test_helper_zrythm_cleanup ();
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -63,6 +169,9 @@ main (int argc, char *argv[])
   g_test_add_func (
     TEST_PREFIX "test load project bpm",
     (GTestFunc) test_load_project_bpm);
+  g_test_add_func (
+    TEST_PREFIX "test bpm automation",
+    (GTestFunc) test_bpm_automation);
 
   return g_test_run ();
 }
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-test-config.h"
+
+#include "audio/engine.h"
+#include "audio/position.h"
+#include "audio/router.h"
+#include "audio/tempo_track.h"
+#include "audio/time_info_snapshot.h"
+#include "audio/transport.h"
+#include "plugins/plugin_manager.h"
+#include "project.h"
+#include "utils/math.h"
+#include "zrythm.h"
+
+#include "tests/helpers/project.h"
+#include "tests/helpers/zrythm.h"
+
+#include <glib.h>
+
+#include <lv2/atom/util.h>
+
+static void
+test_fill (void)
+{
+  test_helper_zrythm_init ();
+
+  /* bar 3, beat 2 and a half */
+  Position pos;
+  position_set_to_bar (&pos, 3);
+  position_add_beats (&pos, 1);
+  position_add_ticks (
+    &pos, TRANSPORT->ticks_per_beat / 2);
+
+  TimeInfoSnapshot ti;
+  LV2_Atom_Forge forge;
+  time_info_snapshot_init_forge (&forge);
+  time_info_snapshot_fill (
+    &ti, &forge, pos.frames);
+
+  g_assert_cmpint (ti.g_start_frames, ==, pos.frames);
+  g_assert_cmpint (ti.bar, ==, 3);
+  g_assert_cmpint (ti.beat, ==, 2);
+  g_assert_cmpfloat_with_epsilon (
+    ti.beat_ticks,
+    TRANSPORT->ticks_per_beat / 2.0, 1.0);
+  g_assert_cmpfloat_with_epsilon (
+    ti.bar_ticks,
+    TRANSPORT->ticks_per_beat * 1.5, 1.0);
+  g_assert_true (
+    math_floats_equal (
+      ti.bpm,
+      tempo_track_get_current_bpm (
+        P_TEMPO_TRACK)));
+  g_assert_cmpint (
+    ti.beats_per_bar, ==,
+    tempo_track_get_beats_per_bar (P_TEMPO_TRACK));
+
+  /* check the LV2 position */
+  const LV2_Atom_Object * obj =
+    (const LV2_Atom_Object *) &ti.lv2_pos.atom;
+  g_assert_cmpuint (
+    obj->atom.type, ==, forge.Object);
+  g_assert_cmpuint (
+    obj->body.otype, ==, PM_URIDS.time_Position);
+  const LV2_Atom * bar = NULL;
+  const LV2_Atom * bar_beat = NULL;
+  lv2_atom_object_get (
+    obj, PM_URIDS.time_bar, &bar,
+    PM_URIDS.time_barBeat, &bar_beat, 0);
+  g_assert_nonnull (bar);
+  g_assert_nonnull (bar_beat);
+  g_assert_cmpint (
+    ((const LV2_Atom_Long *) bar)->body, ==, 2);
+  g_assert_cmpfloat_with_epsilon (
+    ((const LV2_Atom_Float *) bar_beat)->body,
+    1.5f, 0.01f);
+
+  test_helper_zrythm_cleanup ();
+}
+
+/**
+ * Tests that a snapshot is computed for callers
+ * outside the processing threads.
+ */
+static void
+test_get_outside_cycle (void)
+{
+  test_helper_zrythm_init ();
+
+  test_project_stop_dummy_engine ();
+  transport_set_playhead_to_bar (TRANSPORT, 5);
+  engine_process (
+    AUDIO_ENGINE, AUDIO_ENGINE->block_length);
+
+  TimeInfoSnapshot tmp;
+  const TimeInfoSnapshot * ti =
+    router_get_time_info (
+      ROUTER, PLAYHEAD->frames, &tmp);
+  g_assert_true (ti == &tmp);
+  g_assert_cmpint (ti->bar, ==, 5);
+  g_assert_cmpint (ti->beat, ==, 1);
+
+  /* the snapshot of the last cycle was
+   * computed for the same position */
+  g_assert_cmpint (ROUTER->num_time_infos, >=, 1);
+  g_assert_cmpint (
+    ROUTER->time_infos[0].g_start_frames, ==,
+    PLAYHEAD->frames);
+  g_assert_cmpint (
+    ROUTER->time_infos[0].bar, ==, 5);
+
+  test_helper_zrythm_cleanup ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+#define TEST_PREFIX "/audio/time_info_snapshot/"
+
+  g_test_add_func (
+    TEST_PREFIX "test fill",
+    (GTestFunc) test_fill);
+  g_test_add_func (
+    TEST_PREFIX "test get outside cycle",
+    (GTestFunc) test_get_outside_cycle);
+
+  return g_test_run ();
+}
@@ -21,8 +21,16 @@
 
 #include <math.h>
 
+#include "audio/automation_tracklist.h"
+#include "audio/control_port.h"
 #include "audio/master_track.h"
+#include "audio/midi_event.h"
+#include "audio/midi_mapping.h"
+#include "audio/router.h"
+#include "audio/track.h"
 #include "audio/track_processor.h"
+#include "audio/tracklist.h"
+#include "audio/transport.h"
 #include "project.h"
 #include "utils/flags.h"
 #include "zrythm.h"
@@ -83,6 +91,236 @@ test_process_master ()
   test_helper_zrythm_cleanup ();
 }
 
+/**
+ * Checks that MIDI controls only get ports when
+ * they are used and that the ports are kept after
+ * a reload.
+ */
+static void
+test_midi_automatables_created_on_demand (void)
+{
+  test_helper_zrythm_init ();
+
+  track_create_empty_with_action (
+    TRACK_TYPE_MIDI, NULL);
+  Track * track =
+    TRACKLIST->tracks[TRACKLIST->num_tracks - 1];
+  TrackProcessor * tp = track->processor;
+  for (int i = 0;
+       i < TRACK_PROCESSOR_NUM_MIDI_AUTOMATABLES;
+       i++)
+    {
+      g_assert_null (
+        track_processor_get_midi_automatable (
+          tp, i));
+    }
+  AutomationTracklist * atl =
+    track_get_automation_tracklist (track);
+  int num_ats = atl->num_ats;
+
+  test_project_stop_dummy_engine ();
+
+  /* create the modwheel of channel 2 */
+  int idx = TRACK_PROCESSOR_MIDI_CC_IDX (1, 1);
+  AutomationTrack * at =
+    track_processor_ensure_midi_automatable (
+      tp, idx);
+  g_assert_nonnull (at);
+  g_assert_cmpint (atl->num_ats, ==, num_ats + 1);
+  Port * port =
+    track_processor_get_midi_automatable (tp, idx);
+  g_assert_nonnull (port);
+  g_assert_true (port->at == at);
+  g_assert_true (
+    port_find_from_identifier (&at->port_id) ==
+      port);
+  g_assert_cmpint (
+    track_processor_get_midi_automatable_idx (
+      &port->id), ==, idx);
+
+  /* ensuring it again does nothing */
+  g_assert_true (
+    track_processor_ensure_midi_automatable (
+      tp, idx) == at);
+  g_assert_cmpint (atl->num_ats, ==, num_ats + 1);
+
+  /* create the pitch bend of channel 4 */
+  idx = TRACK_PROCESSOR_PITCH_BEND_IDX (3);
+  at =
+    track_processor_ensure_midi_automatable (
+      tp, idx);
+  g_assert_nonnull (at);
+  port =
+    track_processor_get_midi_automatable (tp, idx);
+  g_assert_nonnull (port);
+  g_assert_true (
+    port->id.flags2 & PORT_FLAG2_MIDI_PITCH_BEND);
+  g_assert_cmpint (port->id.port_index, ==, 3);
+  g_assert_cmpint (
+    track_processor_get_midi_automatable_idx (
+      &port->id), ==, idx);
+
+  router_recalc_graph (ROUTER, F_NOT_SOFT);
+
+  test_project_save_and_reload ();
+
+  track =
+    TRACKLIST->tracks[TRACKLIST->num_tracks - 1];
+  tp = track->processor;
+  int num_ports = 0;
+  for (int i = 0;
+       i < TRACK_PROCESSOR_NUM_MIDI_AUTOMATABLES;
+       i++)
+    {
+      if (track_processor_get_midi_automatable (
+            tp, i))
+        num_ports++;
+    }
+  g_assert_cmpint (num_ports, ==, 2);
+  g_assert_nonnull (
+    track_processor_get_midi_automatable (
+      tp, TRACK_PROCESSOR_MIDI_CC_IDX (1, 1)));
+  g_assert_nonnull (
+    track_processor_get_midi_automatable (
+      tp, TRACK_PROCESSOR_PITCH_BEND_IDX (3)));
+  g_assert_true (track_validate (track));
+
+  test_helper_zrythm_cleanup ();
+}
+
+/**
+ * Checks that MIDI controls are only sent when
+ * they change.
+ */
+static void
+test_send_changed_midi_automatables (void)
+{
+  test_helper_zrythm_init ();
+
+  track_create_empty_with_action (
+    TRACK_TYPE_MIDI, NULL);
+  Track * track =
+    TRACKLIST->tracks[TRACKLIST->num_tracks - 1];
+  TrackProcessor * tp = track->processor;
+
+  test_project_stop_dummy_engine ();
+
+  int idx = TRACK_PROCESSOR_MIDI_CC_IDX (0, 1);
+  track_processor_ensure_midi_automatable (
+    tp, idx);
+  router_recalc_graph (ROUTER, F_NOT_SOFT);
+  Port * port =
+    track_processor_get_midi_automatable (tp, idx);
+  g_assert_nonnull (port);
+
+  EngineProcessTimeInfo time_nfo = {
+    .g_start_frames = 0,
+    .local_offset = 0,
+    .nframes = AUDIO_ENGINE->block_length, };
+  MidiEvents * events = tp->midi_out->midi_events;
+
+  /* nothing changed yet */
+  port_clear_buffer (tp->midi_out);
+  track_processor_process (tp, &time_nfo);
+  g_assert_cmpint (events->num_events, ==, 0);
+
+  port_set_control_value (
+    port, 0.5f, F_NORMALIZED, F_NO_PUBLISH_EVENTS);
+  port_clear_buffer (tp->midi_out);
+  track_processor_process (tp, &time_nfo);
+  g_assert_cmpint (events->num_events, ==, 1);
+  MidiEvent * ev = &events->events[0];
+  g_assert_cmpint (
+    midi_event_get_type (ev), ==,
+    MIDI_EVENT_TYPE_CONTROLLER);
+  g_assert_cmpint (
+    midi_event_get_channel (ev), ==, 1);
+  g_assert_cmpint (
+    midi_event_get_controller (ev), ==, 1);
+  g_assert_cmpint (
+    midi_event_get_control (ev), ==, 64);
+
+  /* sent only once */
+  port_clear_buffer (tp->midi_out);
+  track_processor_process (tp, &time_nfo);
+  g_assert_cmpint (events->num_events, ==, 0);
+
+  test_helper_zrythm_cleanup ();
+}
+
+/**
+ * Checks that MIDI input recorded into a MIDI
+ * control without a port is applied once the port
+ * is created, and that the port is then set from
+ * the CC mappings.
+ */
+static void
+test_record_into_midi_automatable_wo_port (void)
+{
+  test_helper_zrythm_init ();
+
+  track_create_empty_with_action (
+    TRACK_TYPE_MIDI, NULL);
+  Track * track =
+    TRACKLIST->tracks[TRACKLIST->num_tracks - 1];
+  TrackProcessor * tp = track->processor;
+
+  test_project_stop_dummy_engine ();
+
+  EngineProcessTimeInfo time_nfo = {
+    .g_start_frames = 0,
+    .local_offset = 0,
+    .nframes = AUDIO_ENGINE->block_length, };
+  TRANSPORT->recording = true;
+
+  /* volume of channel 1 */
+  int idx = TRACK_PROCESSOR_MIDI_CC_IDX (0, 7);
+  track_processor_get_and_clear_pending ();
+  port_clear_buffer (tp->midi_in);
+  midi_events_add_control_change (
+    tp->midi_in->midi_events, 1, 7, 100, 0,
+    F_NOT_QUEUED);
+  track_processor_process (tp, &time_nfo);
+  g_assert_null (
+    track_processor_get_midi_automatable (
+      tp, idx));
+  g_assert_true (
+    track_processor_get_and_clear_pending ());
+
+  /* the value received is kept */
+  g_assert_true (
+    track_processor_create_pending_midi_automatables (
+      tp));
+  router_recalc_graph (ROUTER, F_NOT_SOFT);
+  Port * port =
+    track_processor_get_midi_automatable (tp, idx);
+  g_assert_nonnull (port);
+  g_assert_cmpfloat_with_epsilon (
+    control_port_real_val_to_normalized (
+      port, port->control),
+    100.f / 127.f, 0.0001f);
+  g_assert_nonnull (tp->cc_mappings);
+  g_assert_cmpint (
+    tp->cc_mappings->num_mappings, ==, 1);
+
+  /* the port is now set from its mapping */
+  port_clear_buffer (tp->midi_in);
+  midi_events_add_control_change (
+    tp->midi_in->midi_events, 1, 7, 20, 0,
+    F_NOT_QUEUED);
+  track_processor_process (tp, &time_nfo);
+  g_assert_cmpfloat_with_epsilon (
+    control_port_real_val_to_normalized (
+      port, port->control),
+    20.f / 127.f, 0.0001f);
+  g_assert_false (
+    track_processor_get_and_clear_pending ());
+
+  TRANSPORT->recording = false;
+
+  test_helper_zrythm_cleanup ();
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -95,6 +333,21 @@ main (int argc, char *argv[])
   g_test_add_func (
     TEST_PREFIX "test process master",
     (GTestFunc) test_process_master);
+  g_test_add_func (
+    TEST_PREFIX
+    "test midi automatables created on demand",
+    (GTestFunc)
+    test_midi_automatables_created_on_demand);
+  g_test_add_func (
+    TEST_PREFIX
+    "test send changed midi automatables",
+    (GTestFunc)
+    test_send_changed_midi_automatables);
+  g_test_add_func (
+    TEST_PREFIX
+    "test record into midi automatable wo port",
+    (GTestFunc)
+    test_record_into_midi_automatable_wo_port);
 
   return g_test_run ();
 }
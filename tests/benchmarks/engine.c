@@ -0,0 +1,395 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Engine benchmarks on synthetic projects.
+ *
+ * Results are logged and, if the environment
+ * variable below is set to a file path, appended
+ * to that file as one JSON object per line so that
+ * runs can be compared between releases.
+ */
+
+#include "zrythm-test-config.h"
+
+#include <stdlib.h>
+#ifndef _WOE32
+#include <sys/resource.h>
+#endif
+
+#include "audio/engine.h"
+#include "audio/graph.h"
+#include "audio/midi_event.h"
+#include "audio/port.h"
+#include "audio/router.h"
+#include "audio/transport.h"
+#include "project.h"
+#include "utils/flags.h"
+#include "utils/objects.h"
+#include "utils/thread_affinity.h"
+#include "zrythm.h"
+
+#include "tests/helpers/project.h"
+#include "tests/helpers/synthetic_project.h"
+#include "tests/helpers/zrythm.h"
+
+/** File to append JSON results to. */
+#define BENCHMARK_OUTPUT_ENV \
+  "ZRYTHM_BENCHMARK_OUTPUT"
+
+#define NUM_WARMUP_CYCLES 20
+#define NUM_CYCLES 2000
+
+typedef struct EngineBenchmark
+{
+  const char * name;
+
+  /** Thread affinity policy nick. */
+  const char * affinity;
+
+  /** Microseconds per cycle. */
+  gint64       cycle_p50;
+  gint64       cycle_p99;
+  gint64       cycle_max;
+
+  /** Microseconds. */
+  gint64       graph_setup;
+  gint64       save;
+  gint64       load;
+
+  /** Peak resident set size in KiB, or -1 if
+   * unknown. */
+  long         peak_rss_kb;
+
+  /** Memory used by MIDI event buffers in
+   * KiB. */
+  long         midi_buffers_kb;
+
+  /** Number of event ports. */
+  int          num_midi_ports;
+} EngineBenchmark;
+
+static int
+cmp_gint64 (
+  const void * a,
+  const void * b)
+{
+  gint64 x = *(const gint64 *) a;
+  gint64 y = *(const gint64 *) b;
+  return (x > y) - (x < y);
+}
+
+static long
+get_peak_rss_kb (void)
+{
+#ifdef _WOE32
+  return -1;
+#else
+  struct rusage usage;
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return -1;
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
+
+/**
+ * Runs the engine from the start of the song and
+ * fills in the cycle times.
+ */
+static void
+run_cycles (
+  EngineBenchmark * benchmark)
+{
+  transport_set_playhead_to_bar (TRANSPORT, 1);
+  transport_request_roll (TRANSPORT);
+
+  for (int i = 0; i < NUM_WARMUP_CYCLES; i++)
+    {
+      engine_process (
+        AUDIO_ENGINE, AUDIO_ENGINE->block_length);
+    }
+
+  gint64 * cycles =
+    object_new_n (NUM_CYCLES, gint64);
+  for (int i = 0; i < NUM_CYCLES; i++)
+    {
+      gint64 start = g_get_monotonic_time ();
+      engine_process (
+        AUDIO_ENGINE, AUDIO_ENGINE->block_length);
+      cycles[i] = g_get_monotonic_time () - start;
+    }
+
+  qsort (
+    cycles, NUM_CYCLES, sizeof (gint64),
+    cmp_gint64);
+  benchmark->cycle_p50 =
+    cycles[NUM_CYCLES / 2];
+  benchmark->cycle_p99 =
+    cycles[(NUM_CYCLES * 99) / 100];
+  benchmark->cycle_max = cycles[NUM_CYCLES - 1];
+  free (cycles);
+}
+
+/**
+ * Sums up the memory used by the MIDI event
+ * buffers of all ports.
+ */
+static void
+get_midi_buffer_usage (
+  EngineBenchmark * benchmark)
+{
+  GPtrArray * ports = g_ptr_array_new ();
+  port_get_all (ports);
+  size_t size = 0;
+  int num_ports = 0;
+  for (size_t i = 0; i < ports->len; i++)
+    {
+      Port * port = g_ptr_array_index (ports, i);
+      if (port->id.type != TYPE_EVENT ||
+          !port->midi_events)
+        continue;
+
+      size +=
+        midi_events_get_memory_size (
+          port->midi_events);
+      num_ports++;
+    }
+  g_ptr_array_unref (ports);
+
+  benchmark->midi_buffers_kb =
+    (long) (size / 1024);
+  benchmark->num_midi_ports = num_ports;
+}
+
+static void
+print_results (
+  const EngineBenchmark * benchmark)
+{
+  char * json =
+    g_strdup_printf (
+      "{\"name\": \"%s\", "
+      "\"affinity\": \"%s\", "
+      "\"block_length\": %u, "
+      "\"sample_rate\": %u, "
+      "\"cycle_p50_us\": %" G_GINT64_FORMAT ", "
+      "\"cycle_p99_us\": %" G_GINT64_FORMAT ", "
+      "\"cycle_max_us\": %" G_GINT64_FORMAT ", "
+      "\"graph_setup_us\": %" G_GINT64_FORMAT ", "
+      "\"save_us\": %" G_GINT64_FORMAT ", "
+      "\"load_us\": %" G_GINT64_FORMAT ", "
+      "\"peak_rss_kb\": %ld, "
+      "\"midi_ports\": %d, "
+      "\"midi_buffers_kb\": %ld}",
+      benchmark->name,
+      benchmark->affinity,
+      AUDIO_ENGINE->block_length,
+      AUDIO_ENGINE->sample_rate,
+      benchmark->cycle_p50,
+      benchmark->cycle_p99,
+      benchmark->cycle_max,
+      benchmark->graph_setup,
+      benchmark->save,
+      benchmark->load,
+      benchmark->peak_rss_kb,
+      benchmark->num_midi_ports,
+      benchmark->midi_buffers_kb);
+
+  g_message ("%s", json);
+
+  const char * output =
+    g_getenv (BENCHMARK_OUTPUT_ENV);
+  if (output && *output)
+    {
+      FILE * f = fopen (output, "a");
+      if (f)
+        {
+          fprintf (f, "%s\n", json);
+          fclose (f);
+        }
+      else
+        {
+          g_warning (
+            "failed to open %s", output);
+        }
+    }
+
+  g_free (json);
+}
+
+static void
+run_benchmark (
+  const char *                   name,
+  const SyntheticProjectConfig * config)
+{
+  test_helper_zrythm_init ();
+
+  EngineBenchmark benchmark = {
+    .name = name,
+    .affinity =
+      thread_affinity_policy_nicks[
+        ROUTER->graph->affinity_policy],
+  };
+
+  test_project_stop_dummy_engine ();
+  test_synthetic_project_generate (config);
+
+  /* only time building the graph, swapping it in
+   * waits for the engine */
+  gint64 start = g_get_monotonic_time ();
+  graph_setup (ROUTER->graph, 1, 1);
+  benchmark.graph_setup =
+    g_get_monotonic_time () - start;
+  zix_sem_wait (&ROUTER->graph_access);
+  graph_rechain (ROUTER->graph);
+  zix_sem_post (&ROUTER->graph_access);
+
+  run_cycles (&benchmark);
+
+  /* stop rolling so that the reloaded project
+   * starts from the same state */
+  transport_request_pause (TRANSPORT);
+  engine_process (
+    AUDIO_ENGINE, AUDIO_ENGINE->block_length);
+
+  start = g_get_monotonic_time ();
+  int ret =
+    project_save (
+      PROJECT, PROJECT->dir, F_NOT_BACKUP, 0,
+      F_NO_ASYNC);
+  benchmark.save = g_get_monotonic_time () - start;
+  g_assert_cmpint (ret, ==, 0);
+
+  char * prj_file =
+    g_build_filename (
+      PROJECT->dir, PROJECT_FILE, NULL);
+  object_free_w_func_and_null (
+    project_free, PROJECT);
+  start = g_get_monotonic_time ();
+  test_project_reload (prj_file);
+  benchmark.load = g_get_monotonic_time () - start;
+  g_free (prj_file);
+
+  /* make sure the reloaded project still
+   * processes */
+  test_project_stop_dummy_engine ();
+  for (int i = 0; i < NUM_WARMUP_CYCLES; i++)
+    {
+      engine_process (
+        AUDIO_ENGINE, AUDIO_ENGINE->block_length);
+    }
+
+  benchmark.peak_rss_kb = get_peak_rss_kb ();
+  get_midi_buffer_usage (&benchmark);
+  print_results (&benchmark);
+
+  test_helper_zrythm_cleanup ();
+}
+
+static void
+test_small_project (void)
+{
+  SyntheticProjectConfig config = {
+    .num_midi_tracks = 8,
+    .num_audio_tracks = 8,
+    .num_lanes = 2,
+    .num_bars = 16,
+    .notes_per_region = 8,
+    .num_automated_params = 2,
+    .num_groups = 2,
+    .num_fx_buses = 1,
+  };
+  run_benchmark ("small", &config);
+}
+
+static void
+test_large_project (void)
+{
+  SyntheticProjectConfig config = {
+    .num_midi_tracks = 64,
+    .num_audio_tracks = 64,
+    .num_lanes = 4,
+    .num_bars = 64,
+    .notes_per_region = 32,
+    .num_automated_params = 4,
+    .num_groups = 8,
+    .num_fx_buses = 4,
+  };
+  run_benchmark ("large", &config);
+}
+
+/**
+ * Compares cycle times with the thread affinity
+ * policies that don't need any configuration.
+ */
+static void
+test_affinity_policies (void)
+{
+  SyntheticProjectConfig config = {
+    .num_midi_tracks = 32,
+    .num_audio_tracks = 32,
+    .num_lanes = 2,
+    .num_bars = 32,
+    .notes_per_region = 16,
+    .num_automated_params = 2,
+    .num_groups = 4,
+    .num_fx_buses = 2,
+  };
+  const char * policies[] = {
+    "none", "physical-cores", "no-smt-siblings",
+  };
+  for (size_t i = 0; i < G_N_ELEMENTS (policies);
+       i++)
+    {
+      /* read when the graph threads start */
+      g_setenv (
+        "ZRYTHM_DSP_THREAD_AFFINITY", policies[i],
+        true);
+      char * name =
+        g_strdup_printf ("affinity %s", policies[i]);
+      run_benchmark (name, &config);
+      g_free (name);
+    }
+  g_unsetenv ("ZRYTHM_DSP_THREAD_AFFINITY");
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+#define TEST_PREFIX "/benchmarks/engine/"
+
+  g_test_add_func (
+    TEST_PREFIX "test small project",
+    (GTestFunc) test_small_project);
+  g_test_add_func (
+    TEST_PREFIX "test large project",
+    (GTestFunc) test_large_project);
+  g_test_add_func (
+    TEST_PREFIX "test affinity policies",
+    (GTestFunc) test_affinity_policies);
+
+  return g_test_run ();
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-test-config.h"
+
+#include "actions/tracklist_selections.h"
+#include "audio/engine.h"
+#include "audio/graph.h"
+#include "audio/graph_buffer_plan.h"
+#include "audio/router.h"
+#include "audio/tracklist.h"
+#include "project.h"
+#include "utils/flags.h"
+#include "zrythm.h"
+
+#include "tests/helpers/project.h"
+#include "tests/helpers/zrythm.h"
+
+#define NUM_TRACKS 500
+#define NUM_CYCLES 2000
+
+/**
+ * Returns the microseconds taken to run the
+ * engine.
+ */
+static gint64
+run_engine (
+  bool share_port_buffers)
+{
+  ROUTER->graph->share_port_buffers =
+    share_port_buffers;
+  router_recalc_graph (ROUTER, F_NOT_SOFT);
+
+  /* warm up */
+  for (int i = 0; i < 20; i++)
+    {
+      engine_process (
+        AUDIO_ENGINE, AUDIO_ENGINE->block_length);
+    }
+
+  gint64 start = g_get_monotonic_time ();
+  for (int i = 0; i < NUM_CYCLES; i++)
+    {
+      engine_process (
+        AUDIO_ENGINE, AUDIO_ENGINE->block_length);
+    }
+  gint64 end = g_get_monotonic_time ();
+
+  GraphBufferPlan * plan =
+    ROUTER->graph->buffer_plan;
+  fprintf (
+    stderr,
+    "---- %s buffer sharing ----\n"
+    "ports using shared buffers: %d\n"
+    "shared buffers: %d\n"
+    "time: %ldms\n",
+    share_port_buffers ? "with" : "without",
+    plan ? plan->num_entries : 0,
+    plan ? plan->num_bufs : 0,
+    (long) (end - start) / 1000);
+
+  return end - start;
+}
+
+static void
+test_run_engine (void)
+{
+  test_helper_zrythm_init ();
+
+  AUDIO_ENGINE->stop_dummy_audio_thread = true;
+  g_usleep (20000);
+
+  tracklist_selections_action_perform_create_audio_fx (
+    NULL, TRACKLIST->num_tracks, NUM_TRACKS, NULL);
+
+  gint64 not_shared = run_engine (false);
+  gint64 shared = run_engine (true);
+  g_message (
+    "time with buffer sharing: %.1f%%",
+    not_shared > 0 ?
+      (double) shared * 100.0 / (double) not_shared :
+      0.0);
+
+  g_assert_nonnull (ROUTER->graph->buffer_plan);
+  g_assert_cmpint (
+    ROUTER->graph->buffer_plan->num_bufs, <,
+    ROUTER->graph->buffer_plan->num_entries);
+
+  test_helper_zrythm_cleanup ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+#define TEST_PREFIX "/benchmarks/graph_buffers/"
+
+  g_test_add_func (
+    TEST_PREFIX "test run engine",
+    (GTestFunc) test_run_engine);
+
+  return g_test_run ();
+}
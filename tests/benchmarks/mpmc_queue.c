@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2020-2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Benchmarks for pushing to and dequeuing from
+ * the MPMC queue one element at a time versus in
+ * batches, with several producers and consumers.
+ */
+
+#include "zrythm-test-config.h"
+
+#include <stdbool.h>
+
+#include "utils/mpmc_queue.h"
+
+#include <glib.h>
+
+#define NUM_THREADS 4
+#define NUM_ELEMENTS 65536
+#define NUM_ROUNDS 20
+#define BATCH_SIZE 32
+
+typedef struct QueueBenchmark
+{
+  MPMCQueue * queue;
+  bool        batched;
+
+  /** Elements left to dequeue in this round. */
+  volatile gint num_left;
+
+  /** Sum of the dequeued elements (to check that
+   * nothing was lost or duplicated). */
+  volatile gint sum;
+} QueueBenchmark;
+
+static void *
+producer_thread (void * data)
+{
+  QueueBenchmark * self = (QueueBenchmark *) data;
+  const int num_elements =
+    NUM_ELEMENTS / NUM_THREADS;
+
+  void * elements[BATCH_SIZE];
+  for (int i = 0; i < num_elements; )
+    {
+      if (self->batched)
+        {
+          size_t num =
+            (size_t)
+            MIN (BATCH_SIZE, num_elements - i);
+          for (size_t j = 0; j < num; j++)
+            {
+              elements[j] =
+                GINT_TO_POINTER (i + (int) j + 1);
+            }
+          size_t num_pushed =
+            mpmc_queue_push_back_batch (
+              self->queue, elements, num);
+          g_assert_cmpuint (num_pushed, ==, num);
+          i += (int) num;
+        }
+      else
+        {
+          int ret =
+            mpmc_queue_push_back (
+              self->queue, GINT_TO_POINTER (i + 1));
+          g_assert_cmpint (ret, ==, 1);
+          i++;
+        }
+    }
+
+  return NULL;
+}
+
+static void *
+consumer_thread (void * data)
+{
+  QueueBenchmark * self = (QueueBenchmark *) data;
+
+  void * elements[BATCH_SIZE];
+  gint sum = 0;
+  while (g_atomic_int_get (&self->num_left) > 0)
+    {
+      size_t num_dequeued = 0;
+      if (self->batched)
+        {
+          num_dequeued =
+            mpmc_queue_dequeue_batch (
+              self->queue, elements, BATCH_SIZE);
+        }
+      else
+        {
+          num_dequeued =
+            (size_t)
+            mpmc_queue_dequeue (
+              self->queue, &elements[0]);
+        }
+
+      for (size_t i = 0; i < num_dequeued; i++)
+        {
+          sum += GPOINTER_TO_INT (elements[i]);
+        }
+      if (num_dequeued > 0)
+        {
+          g_atomic_int_add (
+            &self->num_left, - (gint) num_dequeued);
+        }
+    }
+  g_atomic_int_add (&self->sum, sum);
+
+  return NULL;
+}
+
+/**
+ * Returns the microseconds taken to pass
+ * NUM_ELEMENTS through the queue NUM_ROUNDS times.
+ */
+static gint64
+run_rounds (
+  bool batched)
+{
+  QueueBenchmark self = {
+    .queue = mpmc_queue_new (),
+    .batched = batched,
+  };
+  mpmc_queue_reserve (self.queue, NUM_ELEMENTS);
+
+  /* each producer pushes 1..n */
+  const gint per_thread = NUM_ELEMENTS / NUM_THREADS;
+  const gint expected_sum =
+    NUM_THREADS * (per_thread * (per_thread + 1) / 2);
+
+  gint64 total = 0;
+  for (int round = 0; round < NUM_ROUNDS; round++)
+    {
+      mpmc_queue_clear (self.queue);
+      g_atomic_int_set (
+        &self.num_left, NUM_ELEMENTS);
+      g_atomic_int_set (&self.sum, 0);
+
+      GThread * threads[NUM_THREADS * 2];
+      gint64 start = g_get_monotonic_time ();
+      for (int i = 0; i < NUM_THREADS; i++)
+        {
+          threads[i] =
+            g_thread_new (
+              "consumer", consumer_thread, &self);
+          threads[NUM_THREADS + i] =
+            g_thread_new (
+              "producer", producer_thread, &self);
+        }
+      for (int i = 0; i < NUM_THREADS * 2; i++)
+        {
+          g_thread_join (threads[i]);
+        }
+      total += g_get_monotonic_time () - start;
+
+      g_assert_cmpint (
+        g_atomic_int_get (&self.num_left), ==, 0);
+      g_assert_cmpint (
+        g_atomic_int_get (&self.sum), ==,
+        expected_sum);
+    }
+
+  mpmc_queue_free (self.queue);
+
+  return total;
+}
+
+static void
+test_batched_vs_single (void)
+{
+  gint64 single = run_rounds (false);
+  gint64 batched = run_rounds (true);
+
+  fprintf (
+    stderr,
+    "---- MPMC queue (%d producers, "
+    "%d consumers, %d elements x %d) ----\n"
+    "single: %ldms\n"
+    "batched (%d): %ldms\n",
+    NUM_THREADS, NUM_THREADS, NUM_ELEMENTS,
+    NUM_ROUNDS, (long) single / 1000,
+    BATCH_SIZE, (long) batched / 1000);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+#define TEST_PREFIX "/benchmarks/mpmc_queue/"
+
+  g_test_add_func (
+    TEST_PREFIX "test batched vs single",
+    (GTestFunc) test_batched_vs_single);
+
+  return g_test_run ();
+}
@@ -0,0 +1,597 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-test-config.h"
+
+#include "audio/automation_point.h"
+#include "audio/midi_note.h"
+#include "audio/region.h"
+#include "gui/backend/arranger_object_index.h"
+#include "project.h"
+#include "zrythm.h"
+
+#include "tests/helpers/zrythm.h"
+
+#include <glib.h>
+#include <locale.h>
+#include <math.h>
+#include <stdlib.h>
+
+#define NUM_NOTES 500
+
+static void
+count_cb (
+  ArrangerObject * obj,
+  void *           data)
+{
+  GHashTable * found = (GHashTable *) data;
+  g_assert_false (
+    g_hash_table_contains (found, obj));
+  g_hash_table_add (found, obj);
+}
+
+/**
+ * Checks that the index finds every object that a
+ * linear scan finds, and only objects in the given
+ * array.
+ */
+static void
+check_range (
+  ArrangerObjectIndex * index,
+  MidiNote **           notes,
+  int                   num_notes,
+  double                start,
+  double                end,
+  int                   min_pitch,
+  int                   max_pitch)
+{
+  GHashTable * found =
+    g_hash_table_new (NULL, NULL);
+  arranger_object_index_foreach_in_range (
+    index, start, end, min_pitch, max_pitch,
+    count_cb, found);
+
+  GHashTable * members =
+    g_hash_table_new (NULL, NULL);
+  for (int i = 0; i < num_notes; i++)
+    {
+      ArrangerObject * obj =
+        (ArrangerObject *) notes[i];
+      g_hash_table_add (members, obj);
+      bool overlaps =
+        obj->pos.ticks <= end &&
+        obj->end_pos.ticks >= start &&
+        (index->num_buckets == 1 ||
+         (notes[i]->val >= min_pitch &&
+          notes[i]->val <= max_pitch));
+      if (overlaps)
+        {
+          g_assert_true (
+            g_hash_table_contains (found, obj));
+        }
+    }
+
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init (&iter, found);
+  while (g_hash_table_iter_next (
+           &iter, &key, NULL))
+    {
+      g_assert_true (
+        g_hash_table_contains (members, key));
+    }
+
+  g_hash_table_destroy (members);
+  g_hash_table_destroy (found);
+}
+
+static void
+check_ranges (
+  ArrangerObjectIndex * index,
+  MidiNote **           notes,
+  int                   num_notes)
+{
+  check_range (
+    index, notes, num_notes, 0, 0, 0, 127);
+  check_range (
+    index, notes, num_notes, 100, 400, 0, 127);
+  check_range (
+    index, notes, num_notes, 1500, 1500, 60, 64);
+  check_range (
+    index, notes, num_notes, -100, 5000, 0, 127);
+  check_range (
+    index, notes, num_notes, 3000, 4000, 0, 127);
+}
+
+static void
+create_notes (
+  MidiNote ** notes,
+  int         num_notes)
+{
+  RegionIdentifier id;
+  region_identifier_init (&id);
+
+  for (int i = 0; i < num_notes; i++)
+    {
+      Position start, end;
+      double start_ticks =
+        (double) ((i * 37) % 2000);
+      double len = (double) ((i * 13) % 300) + 1;
+      position_from_ticks (&start, start_ticks);
+      position_from_ticks (
+        &end, start_ticks + len);
+      notes[i] =
+        midi_note_new (
+          &id, &start, &end,
+          (uint8_t) ((i * 7) % 128), 90);
+    }
+}
+
+static void
+free_notes (
+  MidiNote ** notes,
+  int         num_notes)
+{
+  for (int i = 0; i < num_notes; i++)
+    {
+      arranger_object_free (
+        (ArrangerObject *) notes[i]);
+    }
+}
+
+/**
+ * Moves the note to a new position and pitch.
+ */
+static void
+move_note (
+  MidiNote * mn,
+  int        i)
+{
+  ArrangerObject * obj = (ArrangerObject *) mn;
+  double start_ticks =
+    (double) ((i * 53) % 2500);
+  double len = (double) ((i * 17) % 400) + 1;
+  position_from_ticks (&obj->pos, start_ticks);
+  position_from_ticks (
+    &obj->end_pos, start_ticks + len);
+  mn->val = (uint8_t) ((i * 11) % 128);
+}
+
+static void
+test_foreach_in_range (void)
+{
+  test_helper_zrythm_init ();
+
+  MidiNote * notes[NUM_NOTES];
+  create_notes (notes, NUM_NOTES);
+
+  for (int by_pitch = 0; by_pitch < 2; by_pitch++)
+    {
+      ArrangerObjectIndex * index =
+        arranger_object_index_new (
+          (ArrangerObject **) notes, NUM_NOTES,
+          by_pitch, NULL, NULL);
+      g_assert_true (
+        arranger_object_index_is_valid (
+          index, NUM_NOTES, by_pitch));
+      g_assert_false (
+        arranger_object_index_is_valid (
+          index, NUM_NOTES - 1, by_pitch));
+      g_assert_false (
+        arranger_object_index_is_valid (
+          index, NUM_NOTES, !by_pitch));
+
+      check_ranges (index, notes, NUM_NOTES);
+
+      arranger_object_index_free (index);
+    }
+
+  free_notes (notes, NUM_NOTES);
+
+  test_helper_zrythm_cleanup ();
+}
+
+static void
+test_add_remove_update (void)
+{
+  test_helper_zrythm_init ();
+
+  MidiNote * notes[NUM_NOTES];
+  create_notes (notes, NUM_NOTES);
+
+  for (int by_pitch = 0; by_pitch < 2; by_pitch++)
+    {
+      /* index the first half, then add the rest
+       * one by one */
+      int num_indexed = NUM_NOTES / 2;
+      ArrangerObjectIndex * index =
+        arranger_object_index_new (
+          (ArrangerObject **) notes, num_indexed,
+          by_pitch, NULL, NULL);
+      for (int i = num_indexed; i < NUM_NOTES; i++)
+        {
+          arranger_object_index_add (
+            index, (ArrangerObject *) notes[i]);
+        }
+      g_assert_true (
+        arranger_object_index_is_valid (
+          index, NUM_NOTES, by_pitch));
+      check_ranges (index, notes, NUM_NOTES);
+
+      /* move and change the pitch of every third
+       * note */
+      for (int i = 0; i < NUM_NOTES; i += 3)
+        {
+          move_note (notes[i], i);
+          g_assert_true (
+            arranger_object_index_update (
+              index, (ArrangerObject *) notes[i]));
+        }
+      check_ranges (index, notes, NUM_NOTES);
+
+      /* remove the second half */
+      for (int i = NUM_NOTES / 2; i < NUM_NOTES;
+           i++)
+        {
+          g_assert_true (
+            arranger_object_index_remove (
+              index, (ArrangerObject *) notes[i]));
+        }
+      g_assert_false (
+        arranger_object_index_remove (
+          index,
+          (ArrangerObject *) notes[NUM_NOTES - 1]));
+      g_assert_true (
+        arranger_object_index_is_valid (
+          index, NUM_NOTES / 2, by_pitch));
+      check_ranges (index, notes, NUM_NOTES / 2);
+
+      arranger_object_index_free (index);
+    }
+
+  free_notes (notes, NUM_NOTES);
+
+  test_helper_zrythm_cleanup ();
+}
+
+/**
+ * Checks the order, balance and maximum end
+ * positions of the subtree.
+ *
+ * @return The height of the subtree.
+ */
+static int
+check_node (
+  ArrangerObjectIndexNode * node,
+  double                    min_start,
+  double                    max_start)
+{
+  if (!node)
+    return 0;
+
+  g_assert_cmpfloat (
+    node->entry.start_ticks, >=, min_start);
+  g_assert_cmpfloat (
+    node->entry.start_ticks, <=, max_start);
+
+  int left_height =
+    check_node (
+      node->left, min_start,
+      node->entry.start_ticks);
+  int right_height =
+    check_node (
+      node->right, node->entry.start_ticks,
+      max_start);
+  g_assert_cmpint (
+    abs (left_height - right_height), <=, 1);
+  g_assert_cmpint (
+    node->height, ==,
+    1 + MAX (left_height, right_height));
+
+  double max_end = node->entry.end_ticks;
+  if (node->left)
+    max_end =
+      MAX (max_end, node->left->max_end_ticks);
+  if (node->right)
+    max_end =
+      MAX (max_end, node->right->max_end_ticks);
+  g_assert_cmpfloat (
+    node->max_end_ticks, ==, max_end);
+
+  return node->height;
+}
+
+/**
+ * Checks that the tree stays balanced when objects
+ * are added in order and removed.
+ */
+static void
+test_tree_balanced (void)
+{
+  test_helper_zrythm_init ();
+
+  MidiNote * notes[NUM_NOTES];
+  RegionIdentifier id;
+  region_identifier_init (&id);
+  for (int i = 0; i < NUM_NOTES; i++)
+    {
+      Position start, end;
+      position_from_ticks (&start, i * 10.0);
+      position_from_ticks (
+        &end, i * 10.0 + (i % 7) * 30.0);
+      notes[i] =
+        midi_note_new (
+          &id, &start, &end, 60, 90);
+    }
+
+  ArrangerObjectIndex * index =
+    arranger_object_index_new (
+      NULL, 0, false, NULL, NULL);
+  for (int i = 0; i < NUM_NOTES; i++)
+    {
+      arranger_object_index_add (
+        index, (ArrangerObject *) notes[i]);
+    }
+
+  /* an AVL tree is at most ~1.44 log2 (n) high */
+  ArrangerObjectIndexBucket * b =
+    &index->buckets[0];
+  g_assert_cmpint (b->num_entries, ==, NUM_NOTES);
+  int height =
+    check_node (b->root, -G_MAXDOUBLE, G_MAXDOUBLE);
+  g_assert_cmpfloat (
+    height, <=,
+    1.45 * log2 ((double) NUM_NOTES) + 2);
+  check_ranges (index, notes, NUM_NOTES);
+
+  /* remove every other note */
+  for (int i = 0; i < NUM_NOTES; i += 2)
+    {
+      g_assert_true (
+        arranger_object_index_remove (
+          index, (ArrangerObject *) notes[i]));
+    }
+  g_assert_cmpint (
+    b->num_entries, ==, NUM_NOTES / 2);
+  check_node (b->root, -G_MAXDOUBLE, G_MAXDOUBLE);
+  GHashTable * found =
+    g_hash_table_new (NULL, NULL);
+  arranger_object_index_foreach_in_range (
+    index, -1, NUM_NOTES * 10.0 + 1000, 0, 127,
+    count_cb, found);
+  g_assert_cmpuint (
+    g_hash_table_size (found), ==, NUM_NOTES / 2);
+  g_hash_table_destroy (found);
+
+  arranger_object_index_free (index);
+  free_notes (notes, NUM_NOTES);
+
+  test_helper_zrythm_cleanup ();
+}
+
+#define NUM_APS 50
+
+/**
+ * Extent of automation points whose curve is drawn
+ * up to the next point.
+ */
+static void
+ap_extent_func (
+  ArrangerObject * obj,
+  double *         start_ticks,
+  double *         end_ticks,
+  void *           user_data)
+{
+  AutomationPoint ** aps =
+    (AutomationPoint **) user_data;
+  AutomationPoint * ap = (AutomationPoint *) obj;
+  *start_ticks = obj->pos.ticks;
+  *end_ticks = obj->pos.ticks;
+  for (int i = 0; i < NUM_APS - 1; i++)
+    {
+      if (aps[i] == ap)
+        {
+          *end_ticks = aps[i + 1]->base.pos.ticks;
+          break;
+        }
+    }
+}
+
+/**
+ * Checks that objects without length are found
+ * anywhere within their drawn extent, not only at
+ * their position.
+ */
+static void
+test_extents (void)
+{
+  test_helper_zrythm_init ();
+
+  AutomationPoint * aps[NUM_APS];
+  for (int i = 0; i < NUM_APS; i++)
+    {
+      Position pos;
+      position_from_ticks (
+        &pos, (double) (i * 100));
+      aps[i] =
+        automation_point_new_float (
+          0.5f, 0.5f, &pos);
+    }
+
+  ArrangerObjectIndex * index =
+    arranger_object_index_new (
+      (ArrangerObject **) aps, NUM_APS, false,
+      ap_extent_func, aps);
+  ArrangerObjectIndex * pos_index =
+    arranger_object_index_new (
+      (ArrangerObject **) aps, NUM_APS, false,
+      NULL, NULL);
+
+  /* between points 10 and 11 */
+  GHashTable * found =
+    g_hash_table_new (NULL, NULL);
+  arranger_object_index_foreach_in_range (
+    index, 1040, 1060, 0, 0, count_cb, found);
+  g_assert_cmpuint (
+    g_hash_table_size (found), ==, 1);
+  g_assert_true (
+    g_hash_table_contains (found, aps[10]));
+
+  /* only the positions are indexed without an
+   * extent function */
+  g_hash_table_remove_all (found);
+  arranger_object_index_foreach_in_range (
+    pos_index, 1040, 1060, 0, 0, count_cb, found);
+  g_assert_cmpuint (
+    g_hash_table_size (found), ==, 0);
+
+  /* extents stay correct after moving a point
+   * left of its predecessor */
+  ArrangerObject * obj =
+    (ArrangerObject *) aps[20];
+  position_from_ticks (&obj->pos, 1850);
+  arranger_object_index_update (
+    index, (ArrangerObject *) aps[20]);
+  g_hash_table_remove_all (found);
+  arranger_object_index_foreach_in_range (
+    index, 2050, 2060, 0, 0, count_cb, found);
+  g_assert_true (
+    g_hash_table_contains (found, aps[20]));
+
+  g_hash_table_destroy (found);
+  arranger_object_index_free (index);
+  arranger_object_index_free (pos_index);
+  for (int i = 0; i < NUM_APS; i++)
+    {
+      arranger_object_free (
+        (ArrangerObject *) aps[i]);
+    }
+
+  test_helper_zrythm_cleanup ();
+}
+
+/**
+ * Checks that cached indices are updated in place
+ * when objects are added, removed or moved.
+ */
+static void
+test_cache_notifications (void)
+{
+  test_helper_zrythm_init ();
+
+  MidiNote * notes[NUM_NOTES];
+  create_notes (notes, NUM_NOTES);
+
+  /* any pointer works as the container */
+  const void * container = notes;
+
+  ArrangerObjectIndexCache * cache =
+    arranger_object_index_cache_new (NULL, NULL);
+  GHashTable * found =
+    g_hash_table_new (NULL, NULL);
+
+  int num_indexed = NUM_NOTES - 1;
+  arranger_object_index_cache_foreach_in_range (
+    cache, container, (ArrangerObject **) notes,
+    num_indexed, true, -100, 5000, 0, 127,
+    count_cb, found);
+  g_assert_cmpuint (
+    g_hash_table_size (found), ==,
+    (guint) num_indexed);
+  ArrangerObjectIndex * index =
+    (ArrangerObjectIndex *)
+    g_hash_table_lookup (
+      cache->indices, container);
+  g_assert_nonnull (index);
+
+  /* add */
+  arranger_object_index_object_added (
+    container,
+    (ArrangerObject *) notes[NUM_NOTES - 1]);
+  g_assert_true (
+    g_hash_table_lookup (
+      cache->indices, container) == index);
+  g_assert_true (
+    arranger_object_index_is_valid (
+      index, NUM_NOTES, true));
+  check_ranges (index, notes, NUM_NOTES);
+
+  /* move */
+  unsigned int generation =
+    arranger_object_index_get_generation ();
+  for (int i = 0; i < NUM_NOTES; i += 5)
+    {
+      move_note (notes[i], i);
+      arranger_object_index_object_changed (
+        (ArrangerObject *) notes[i]);
+    }
+  g_assert_cmpuint (
+    arranger_object_index_get_generation (), !=,
+    generation);
+  check_ranges (index, notes, NUM_NOTES);
+
+  /* remove */
+  arranger_object_index_object_removed (
+    (ArrangerObject *) notes[NUM_NOTES - 1]);
+  g_assert_true (
+    g_hash_table_lookup (
+      cache->indices, container) == index);
+  check_ranges (index, notes, NUM_NOTES - 1);
+
+  /* the index is dropped with its container */
+  arranger_object_index_container_freed (
+    container);
+  g_assert_null (
+    g_hash_table_lookup (
+      cache->indices, container));
+  g_assert_cmpuint (
+    g_hash_table_size (cache->obj_indices), ==, 0);
+
+  g_hash_table_destroy (found);
+  arranger_object_index_cache_free (cache);
+  free_notes (notes, NUM_NOTES);
+
+  test_helper_zrythm_cleanup ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+#define TEST_PREFIX "/gui/backend/arranger object index/"
+
+  g_test_add_func (
+    TEST_PREFIX "test foreach in range",
+    (GTestFunc) test_foreach_in_range);
+  g_test_add_func (
+    TEST_PREFIX "test add remove update",
+    (GTestFunc) test_add_remove_update);
+  g_test_add_func (
+    TEST_PREFIX "test tree balanced",
+    (GTestFunc) test_tree_balanced);
+  g_test_add_func (
+    TEST_PREFIX "test extents",
+    (GTestFunc) test_extents);
+  g_test_add_func (
+    TEST_PREFIX "test cache notifications",
+    (GTestFunc) test_cache_notifications);
+
+  return g_test_run ();
+}
@@ -169,6 +169,150 @@ test_contains_object_with_property (void)
   test_helper_zrythm_cleanup ();
 }
 
+static void
+test_add_remove_objects (void)
+{
+  test_helper_zrythm_init ();
+
+  Track * track =
+    track_create_empty_with_action (
+      TRACK_TYPE_MIDI, NULL);
+
+  Position p1, p2;
+  position_set_to_bar (&p1, 1);
+  position_set_to_bar (&p2, 64);
+  ZRegion * r =
+    midi_region_new (
+      &p1, &p2,
+      track_get_name_hash (track), 0, 0);
+  track_add_region (
+    track, r, NULL, 0, F_GEN_NAME,
+    F_NO_PUBLISH_EVENTS);
+
+#define NUM_NOTES 2000
+  ArrangerObject * objs[NUM_NOTES];
+  for (int i = 0; i < NUM_NOTES; i++)
+    {
+      position_from_ticks (&p1, i * 10.0);
+      position_from_ticks (&p2, i * 10.0 + 5.0);
+      MidiNote * mn =
+        midi_note_new (
+          &r->id, &p1, &p2,
+          (uint8_t) (i % 128), 60);
+      midi_region_add_midi_note (
+        r, mn, F_NO_PUBLISH_EVENTS);
+      objs[i] = (ArrangerObject *) mn;
+    }
+
+  ArrangerSelections * sel =
+    (ArrangerSelections *) MA_SELECTIONS;
+  arranger_selections_clear (
+    sel, F_NO_FREE, F_NO_PUBLISH_EVENTS);
+
+  /* adding twice should not duplicate */
+  arranger_selections_add_objects (
+    sel, objs, NUM_NOTES);
+  arranger_selections_add_objects (
+    sel, objs, NUM_NOTES / 2);
+  g_assert_cmpint (
+    arranger_selections_get_num_objects (sel), ==,
+    NUM_NOTES);
+  for (int i = 0; i < NUM_NOTES; i++)
+    {
+      g_assert_true (
+        arranger_selections_contains_object (
+          sel, objs[i]));
+    }
+
+  /* velocities resolve to their notes */
+  MidiNote * first_mn = (MidiNote *) objs[0];
+  g_assert_true (
+    arranger_selections_contains_object (
+      sel, (ArrangerObject *) first_mn->vel));
+
+  /* remove every other note (the last note
+   * takes the place of each removed one) */
+  for (int i = 0; i < NUM_NOTES / 2; i++)
+    {
+      arranger_selections_remove_object (
+        sel, objs[i * 2]);
+    }
+  g_assert_cmpint (
+    arranger_selections_get_num_objects (sel), ==,
+    NUM_NOTES / 2);
+  for (int i = 0; i < NUM_NOTES; i++)
+    {
+      g_assert_true (
+        arranger_selections_contains_object (
+          sel, objs[i]) == (i % 2 == 1));
+    }
+
+  /* sorting restores the order */
+  arranger_selections_sort_by_indices (sel, false);
+  for (int i = 0; i < NUM_NOTES / 2; i++)
+    {
+      g_assert_true (
+        (ArrangerObject *)
+        MA_SELECTIONS->midi_notes[i] ==
+          objs[i * 2 + 1]);
+    }
+
+  /* removals after sorting still find the
+   * moved objects */
+  arranger_selections_remove_object (
+    sel, objs[1]);
+  arranger_selections_remove_object (
+    sel, objs[NUM_NOTES - 1]);
+  arranger_selections_remove_object (
+    sel, objs[5]);
+  arranger_selections_add_object (
+    sel, objs[5]);
+  g_assert_false (
+    arranger_selections_contains_object (
+      sel, objs[1]));
+  g_assert_false (
+    arranger_selections_contains_object (
+      sel, objs[NUM_NOTES - 1]));
+  g_assert_true (
+    arranger_selections_contains_object (
+      sel, objs[5]));
+  g_assert_cmpint (
+    arranger_selections_get_num_objects (sel), ==,
+    NUM_NOTES / 2 - 2);
+  for (int i = 0; i < MA_SELECTIONS->num_midi_notes;
+       i++)
+    {
+      g_assert_true (
+        arranger_selections_contains_object (
+          sel,
+          (ArrangerObject *)
+          MA_SELECTIONS->midi_notes[i]));
+    }
+
+  /* clones get their own lookup set */
+  ArrangerSelections * clone_sel =
+    arranger_selections_clone (sel);
+  g_assert_false (
+    arranger_selections_contains_object (
+      clone_sel, objs[3]));
+  g_assert_cmpint (
+    arranger_selections_get_num_objects (
+      clone_sel), ==,
+    NUM_NOTES / 2 - 2);
+  arranger_selections_free_full (clone_sel);
+
+  arranger_selections_clear (
+    sel, F_NO_FREE, F_NO_PUBLISH_EVENTS);
+  g_assert_false (
+    arranger_selections_contains_object (
+      sel, objs[3]));
+  g_assert_false (
+    arranger_selections_has_any (sel));
+#undef NUM_NOTES
+
+  test_helper_zrythm_cleanup ();
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -176,6 +320,9 @@ main (int argc, char *argv[])
 
 #define TEST_PREFIX "/gui/backend/arranger selections/"
 
+  g_test_add_func (
+    TEST_PREFIX "test add remove objects",
+    (GTestFunc) test_add_remove_objects);
   g_test_add_func (
     TEST_PREFIX "test contains object with property",
     (GTestFunc) test_contains_object_with_property);
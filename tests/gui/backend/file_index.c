@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-test-config.h"
+
+#include "audio/supported_file.h"
+#include "gui/backend/file_index.h"
+#include "utils/flags.h"
+#include "utils/io.h"
+#include "zrythm.h"
+
+#include "tests/helpers/zrythm.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+/**
+ * Waits until the directory is indexed and
+ * returns its files.
+ */
+static GPtrArray *
+get_files (
+  FileIndex *  index,
+  const char * dir)
+{
+  GPtrArray * files =
+    g_ptr_array_new_with_free_func (
+      (GDestroyNotify) supported_file_free);
+  for (int i = 0; i < 1000; i++)
+    {
+      if (file_index_get_files (index, dir, files))
+        return files;
+
+      g_usleep (10000);
+    }
+  g_assert_not_reached ();
+}
+
+static SupportedFile *
+find_file (
+  GPtrArray *  files,
+  const char * label)
+{
+  for (guint i = 0; i < files->len; i++)
+    {
+      SupportedFile * file =
+        g_ptr_array_index (files, i);
+      if (g_str_equal (file->label, label))
+        return file;
+    }
+  return NULL;
+}
+
+/**
+ * Waits until the metadata of the given file is
+ * read and returns the files of its directory.
+ */
+static GPtrArray *
+get_files_with_metadata (
+  FileIndex *  index,
+  const char * dir,
+  const char * label)
+{
+  for (int i = 0; i < 1000; i++)
+    {
+      GPtrArray * files = get_files (index, dir);
+      SupportedFile * file =
+        find_file (files, label);
+      g_assert_nonnull (file);
+      if (file->has_metadata)
+        return files;
+
+      g_ptr_array_unref (files);
+      g_usleep (10000);
+    }
+  g_assert_not_reached ();
+}
+
+static void
+test_index_dir (void)
+{
+  test_helper_zrythm_init ();
+
+  char * tmp_dir =
+    g_dir_make_tmp ("zrythm_file_index_XXXXXX", NULL);
+  g_assert_nonnull (tmp_dir);
+  char * subdir =
+    g_build_filename (tmp_dir, "subdir", NULL);
+  g_assert_cmpint (g_mkdir (subdir, 0700), ==, 0);
+  char * txt_path =
+    g_build_filename (tmp_dir, "notes.txt", NULL);
+  g_assert_true (
+    g_file_set_contents (txt_path, "a", -1, NULL));
+  char * wav_src =
+    g_build_filename (
+      TESTS_SRCDIR, "test.wav", NULL);
+  char * wav_path =
+    g_build_filename (
+      subdir, "Kick Loop.wav", NULL);
+  GFile * src_file = g_file_new_for_path (wav_src);
+  GFile * dest_file = g_file_new_for_path (wav_path);
+  g_assert_true (
+    g_file_copy (
+      src_file, dest_file, G_FILE_COPY_NONE,
+      NULL, NULL, NULL, NULL));
+  g_object_unref (src_file);
+  g_object_unref (dest_file);
+  char * cache_path =
+    g_build_filename (
+      tmp_dir, FILE_INDEX_FILENAME, NULL);
+
+  FileIndex * index = file_index_new (cache_path);
+
+  /* the text file and the subdir are listed */
+  GPtrArray * files = get_files (index, tmp_dir);
+  SupportedFile * file =
+    find_file (files, "subdir");
+  g_assert_nonnull (file);
+  g_assert_cmpint (file->type, ==, FILE_TYPE_DIR);
+  file = find_file (files, "notes.txt");
+  g_assert_nonnull (file);
+  g_assert_false (file->has_metadata);
+  g_ptr_array_unref (files);
+
+  /* the audio file is listed and then gets its
+   * metadata */
+  files = get_files (index, subdir);
+  g_assert_cmpuint (files->len, ==, 1);
+  file = find_file (files, "Kick Loop.wav");
+  g_assert_nonnull (file);
+  g_assert_cmpint (file->type, ==, FILE_TYPE_WAV);
+  g_ptr_array_unref (files);
+  files =
+    get_files_with_metadata (
+      index, subdir, "Kick Loop.wav");
+  g_assert_cmpuint (files->len, ==, 1);
+  file = find_file (files, "Kick Loop.wav");
+  g_assert_nonnull (file);
+  g_assert_cmpint (file->type, ==, FILE_TYPE_WAV);
+  g_assert_true (file->has_metadata);
+  g_assert_cmpint (file->sample_rate, >, 0);
+  g_assert_cmpint (file->channels, >, 0);
+  g_assert_true (file->has_thumbnail);
+  g_ptr_array_unref (files);
+
+  /* search ignores case */
+  files = file_index_search (index, "kick", -1);
+  g_assert_cmpuint (files->len, ==, 1);
+  file = g_ptr_array_index (files, 0);
+  g_assert_cmpstr (file->abs_path, ==, wav_path);
+  g_ptr_array_unref (files);
+  files = file_index_search (index, "snare", -1);
+  g_assert_cmpuint (files->len, ==, 0);
+  g_ptr_array_unref (files);
+
+  file_index_free (index);
+  g_assert_true (
+    g_file_test (cache_path, G_FILE_TEST_EXISTS));
+
+  /* the metadata is loaded from the cache */
+  index = file_index_new (cache_path);
+  files = get_files (index, subdir);
+  file = find_file (files, "Kick Loop.wav");
+  g_assert_nonnull (file);
+  g_assert_true (file->has_metadata);
+  g_assert_true (file->has_thumbnail);
+  g_ptr_array_unref (files);
+  file_index_free (index);
+
+  io_remove (cache_path);
+  io_remove (wav_path);
+  io_remove (txt_path);
+  io_rmdir (subdir, F_NO_FORCE);
+  io_rmdir (tmp_dir, F_NO_FORCE);
+  g_free (cache_path);
+  g_free (wav_path);
+  g_free (wav_src);
+  g_free (txt_path);
+  g_free (subdir);
+  g_free (tmp_dir);
+
+  test_helper_zrythm_cleanup ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+#define TEST_PREFIX "/gui/backend/file_index/"
+
+  g_test_add_func (
+    TEST_PREFIX "test index dir",
+    (GTestFunc) test_index_dir);
+
+  return g_test_run ();
+}
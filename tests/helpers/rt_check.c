@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Interposed allocation and locking functions
+ * that report calls made from real-time threads
+ * to rt_check_record().
+ *
+ * Since the functions are defined in the test
+ * executable, they take precedence over the ones
+ * in libc and GLib for all libraries, including
+ * plugins. The checks only run when enabled (see
+ * RT_CHECK_ENV), otherwise the calls are simply
+ * forwarded.
+ *
+ * This is only linked into the tests that check
+ * the real-time threads (see tests/meson.build).
+ */
+
+#include "utils/rt_check.h"
+
+#if defined (__linux__) && defined (__GLIBC__)
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+/* only defined with _GNU_SOURCE */
+#ifndef RTLD_NEXT
+#define RTLD_NEXT ((void *) -1l)
+#endif
+
+extern void * __libc_malloc (size_t size);
+extern void * __libc_calloc (
+  size_t nmemb, size_t size);
+extern void * __libc_realloc (
+  void * ptr, size_t size);
+extern void __libc_free (void * ptr);
+extern void * __libc_memalign (
+  size_t alignment, size_t size);
+
+void *
+malloc (size_t size)
+{
+  rt_check_record (
+    RT_CHECK_VIOLATION_ALLOC, __func__);
+  return __libc_malloc (size);
+}
+
+void *
+calloc (
+  size_t nmemb,
+  size_t size)
+{
+  rt_check_record (
+    RT_CHECK_VIOLATION_ALLOC, __func__);
+  return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (
+  void * ptr,
+  size_t size)
+{
+  rt_check_record (
+    RT_CHECK_VIOLATION_ALLOC, __func__);
+  return __libc_realloc (ptr, size);
+}
+
+int
+posix_memalign (
+  void ** memptr,
+  size_t  alignment,
+  size_t  size)
+{
+  rt_check_record (
+    RT_CHECK_VIOLATION_ALLOC, __func__);
+  *memptr = __libc_memalign (alignment, size);
+  return *memptr ? 0 : ENOMEM;
+}
+
+void
+free (void * ptr)
+{
+  if (ptr)
+    {
+      rt_check_record (
+        RT_CHECK_VIOLATION_FREE, __func__);
+    }
+  __libc_free (ptr);
+}
+
+/**
+ * Defines a function that records a lock
+ * violation and calls the next definition of
+ * itself.
+ *
+ * @param ret Return statement prefix ("return" or
+ *   nothing for void functions).
+ */
+#define RT_CHECK_DEFINE_LOCK_FUNC( \
+  ret_type,ret,name,arg_type) \
+  ret_type \
+  name (arg_type arg) \
+  { \
+    static ret_type (*real_func) (arg_type) = \
+      NULL; \
+    if (G_UNLIKELY (!real_func)) \
+      { \
+        real_func = \
+          (ret_type (*) (arg_type)) \
+          dlsym (RTLD_NEXT, #name); \
+      } \
+    rt_check_record ( \
+      RT_CHECK_VIOLATION_LOCK, #name); \
+    ret real_func (arg); \
+  }
+
+RT_CHECK_DEFINE_LOCK_FUNC (
+  int, return, pthread_mutex_lock,
+  pthread_mutex_t *)
+RT_CHECK_DEFINE_LOCK_FUNC (
+  int, return, pthread_rwlock_rdlock,
+  pthread_rwlock_t *)
+RT_CHECK_DEFINE_LOCK_FUNC (
+  int, return, pthread_rwlock_wrlock,
+  pthread_rwlock_t *)
+RT_CHECK_DEFINE_LOCK_FUNC (
+  void, , g_mutex_lock, GMutex *)
+RT_CHECK_DEFINE_LOCK_FUNC (
+  void, , g_rec_mutex_lock, GRecMutex *)
+RT_CHECK_DEFINE_LOCK_FUNC (
+  void, , g_rw_lock_reader_lock, GRWLock *)
+RT_CHECK_DEFINE_LOCK_FUNC (
+  void, , g_rw_lock_writer_lock, GRWLock *)
+
+#undef RT_CHECK_DEFINE_LOCK_FUNC
+
+#endif /* __linux__ && __GLIBC__ */
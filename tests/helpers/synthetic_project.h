@@ -0,0 +1,402 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Generator for large synthetic projects.
+ */
+
+#ifndef __TEST_HELPERS_SYNTHETIC_PROJECT_H__
+#define __TEST_HELPERS_SYNTHETIC_PROJECT_H__
+
+#include "zrythm-test-config.h"
+
+#include <math.h>
+
+#include "actions/tracklist_selections.h"
+#include "audio/audio_region.h"
+#include "audio/automation_region.h"
+#include "audio/automation_tracklist.h"
+#include "audio/channel.h"
+#include "audio/channel_send.h"
+#include "audio/control_port.h"
+#include "audio/midi_note.h"
+#include "audio/midi_region.h"
+#include "audio/router.h"
+#include "audio/track.h"
+#include "audio/tracklist.h"
+#include "project.h"
+#include "utils/flags.h"
+#include "utils/objects.h"
+#include "zrythm.h"
+
+#include "tests/helpers/zrythm.h"
+
+#include <glib.h>
+
+/**
+ * @addtogroup tests
+ *
+ * @{
+ */
+
+/**
+ * Shape of a synthetic project.
+ */
+typedef struct SyntheticProjectConfig
+{
+  /** Number of MIDI tracks. */
+  int          num_midi_tracks;
+
+  /** Number of audio tracks. */
+  int          num_audio_tracks;
+
+  /** Lanes per MIDI/audio track. */
+  int          num_lanes;
+
+  /** Length of the arrangement in bars (each lane
+   * gets a 1-bar region on every bar). */
+  int          num_bars;
+
+  /** MIDI notes per MIDI region. */
+  int          notes_per_region;
+
+  /** Automated parameters per track (each gets
+   * an automation region spanning the
+   * arrangement). */
+  int          num_automated_params;
+
+  /** Audio group tracks that the audio tracks are
+   * routed to (round-robin). */
+  int          num_groups;
+
+  /** Audio FX tracks that the audio tracks send
+   * to (round-robin, post-fader). */
+  int          num_fx_buses;
+} SyntheticProjectConfig;
+
+/**
+ * Fills the current project with tracks, regions,
+ * automation and routing according to @p config
+ * and recalculates the graph.
+ *
+ * No plugins are used, so that the result only
+ * depends on Zrythm's own processing.
+ */
+void
+test_synthetic_project_generate (
+  const SyntheticProjectConfig * config);
+
+static Track *
+append_track (
+  TrackType    type,
+  const char * prefix,
+  int          idx)
+{
+  char * name =
+    g_strdup_printf ("%s %d", prefix, idx + 1);
+  Track * track =
+    track_new (
+      type, TRACKLIST->num_tracks, name,
+      type == TRACK_TYPE_MIDI ||
+        type == TRACK_TYPE_AUDIO ?
+          F_WITH_LANE : F_WITHOUT_LANE);
+  g_free (name);
+  tracklist_append_track (
+    TRACKLIST, track, F_NO_PUBLISH_EVENTS,
+    F_NO_RECALC_GRAPH);
+
+  return track;
+}
+
+/**
+ * Automates the first automatable parameters of
+ * the track with a ramp per bar.
+ */
+static void
+add_automation (
+  const SyntheticProjectConfig * config,
+  Track *                        track)
+{
+  AutomationTracklist * atl =
+    track_get_automation_tracklist (track);
+  g_return_if_fail (atl);
+
+  Position start, end;
+  position_set_to_bar (&start, 1);
+  position_set_to_bar (&end, config->num_bars + 1);
+  int num_automated = 0;
+  for (int i = 0;
+       i < atl->num_ats &&
+       num_automated < config->num_automated_params;
+       i++)
+    {
+      AutomationTrack * at = atl->ats[i];
+      Port * port =
+        port_find_from_identifier (&at->port_id);
+      if (!port)
+        continue;
+
+      at->created = true;
+      ZRegion * r =
+        automation_region_new (
+          &start, &end,
+          track_get_name_hash (track),
+          at->index, at->num_regions);
+      track_add_region (
+        track, r, at, -1, F_GEN_NAME,
+        F_NO_PUBLISH_EVENTS);
+
+      for (int bar = 0; bar <= config->num_bars;
+           bar++)
+        {
+          Position pos;
+          position_set_to_bar (&pos, bar + 1);
+          float normalized = bar % 2 ? 0.8f : 0.2f;
+          AutomationPoint * ap =
+            automation_point_new_float (
+              control_port_normalized_val_to_real (
+                port, normalized),
+              normalized, &pos);
+          automation_region_add_ap (
+            r, ap, F_NO_PUBLISH_EVENTS);
+        }
+      num_automated++;
+    }
+}
+
+static void
+add_midi_regions (
+  const SyntheticProjectConfig * config,
+  Track *                        track)
+{
+  for (int lane = 0; lane < config->num_lanes;
+       lane++)
+    {
+      for (int bar = 0; bar < config->num_bars;
+           bar++)
+        {
+          Position start, end;
+          position_set_to_bar (&start, bar + 1);
+          position_set_to_bar (&end, bar + 2);
+          ZRegion * r =
+            midi_region_new (
+              &start, &end,
+              track_get_name_hash (track),
+              lane, bar);
+          track_add_region (
+            track, r, NULL, lane, F_GEN_NAME,
+            F_NO_PUBLISH_EVENTS);
+
+          /* notes are relative to the region */
+          double note_ticks =
+            (position_to_ticks (&end) -
+               position_to_ticks (&start)) /
+            config->notes_per_region;
+          for (int i = 0;
+               i < config->notes_per_region; i++)
+            {
+              Position note_start, note_end;
+              position_init (&note_start);
+              position_add_ticks (
+                &note_start, i * note_ticks);
+              position_set_to_pos (
+                &note_end, &note_start);
+              position_add_ticks (
+                &note_end, note_ticks / 2);
+              MidiNote * mn =
+                midi_note_new (
+                  &r->id, &note_start, &note_end,
+                  (uint8_t) (36 + (lane * 12 + i) % 60),
+                  90);
+              midi_region_add_midi_note (
+                r, mn, F_NO_PUBLISH_EVENTS);
+            }
+        }
+    }
+}
+
+/**
+ * @param pool_id Pool clip to use (created on
+ *   first call).
+ */
+static void
+add_audio_regions (
+  const SyntheticProjectConfig * config,
+  Track *                        track,
+  int *                          pool_id)
+{
+  for (int lane = 0; lane < config->num_lanes;
+       lane++)
+    {
+      for (int bar = 0; bar < config->num_bars;
+           bar++)
+        {
+          Position start, end;
+          position_set_to_bar (&start, bar + 1);
+          position_set_to_bar (&end, bar + 2);
+          long nframes =
+            position_to_frames (&end) -
+            position_to_frames (&start);
+
+          ZRegion * r = NULL;
+          if (*pool_id < 0)
+            {
+              /* one bar of a stereo sine */
+              float * frames =
+                object_new_n (
+                  (size_t) nframes * 2, float);
+              for (long i = 0; i < nframes; i++)
+                {
+                  float val =
+                    0.2f *
+                    sinf (
+                      (float) (2.0 * M_PI * 440.0 *
+                        (double) i /
+                        AUDIO_ENGINE->sample_rate));
+                  frames[i * 2] = val;
+                  frames[i * 2 + 1] = val;
+                }
+              r =
+                audio_region_new (
+                  -1, NULL, true, frames, nframes,
+                  "synthetic", 2, BIT_DEPTH_32,
+                  &start,
+                  track_get_name_hash (track),
+                  lane, bar);
+              free (frames);
+              *pool_id = r->pool_id;
+            }
+          else
+            {
+              r =
+                audio_region_new (
+                  *pool_id, NULL, true, NULL, 0,
+                  NULL, 0, 0, &start,
+                  track_get_name_hash (track),
+                  lane, bar);
+            }
+          track_add_region (
+            track, r, NULL, lane, F_GEN_NAME,
+            F_NO_PUBLISH_EVENTS);
+        }
+    }
+}
+
+void
+test_synthetic_project_generate (
+  const SyntheticProjectConfig * config)
+{
+  for (int i = 0; i < config->num_midi_tracks; i++)
+    {
+      Track * track =
+        append_track (
+          TRACK_TYPE_MIDI, "Synthetic MIDI", i);
+      add_midi_regions (config, track);
+      add_automation (config, track);
+    }
+
+  Track ** groups =
+    object_new_n (
+      (size_t) MAX (config->num_groups, 1),
+      Track *);
+  for (int i = 0; i < config->num_groups; i++)
+    {
+      groups[i] =
+        append_track (
+          TRACK_TYPE_AUDIO_GROUP,
+          "Synthetic group", i);
+      add_automation (config, groups[i]);
+    }
+
+  Track ** fx_buses =
+    object_new_n (
+      (size_t) MAX (config->num_fx_buses, 1),
+      Track *);
+  for (int i = 0; i < config->num_fx_buses; i++)
+    {
+      fx_buses[i] =
+        append_track (
+          TRACK_TYPE_AUDIO_BUS,
+          "Synthetic FX", i);
+    }
+
+  int pool_id = -1;
+  int first_audio_track = TRACKLIST->num_tracks;
+  for (int i = 0; i < config->num_audio_tracks;
+       i++)
+    {
+      Track * track =
+        append_track (
+          TRACK_TYPE_AUDIO, "Synthetic audio", i);
+      add_audio_regions (config, track, &pool_id);
+      add_automation (config, track);
+
+      if (config->num_fx_buses > 0)
+        {
+          Track * bus =
+            fx_buses[i % config->num_fx_buses];
+          ChannelSend * send =
+            track->channel->sends[
+              CHANNEL_SEND_POST_FADER_START_SLOT];
+          bool connected =
+            channel_send_connect_stereo (
+              send, bus->processor->stereo_in,
+              NULL, NULL, false,
+              F_NO_RECALC_GRAPH, F_NO_VALIDATE,
+              NULL);
+          g_assert_true (connected);
+        }
+    }
+
+  /* route the audio tracks to the groups */
+  for (int i = 0; i < config->num_groups; i++)
+    {
+      tracklist_selections_clear (
+        TRACKLIST_SELECTIONS);
+      for (int j = i; j < config->num_audio_tracks;
+           j += config->num_groups)
+        {
+          track_select (
+            TRACKLIST->tracks[first_audio_track + j],
+            F_SELECT, F_NOT_EXCLUSIVE,
+            F_NO_PUBLISH_EVENTS);
+        }
+      if (TRACKLIST_SELECTIONS->num_tracks == 0)
+        continue;
+
+      bool ret =
+        tracklist_selections_action_perform_set_direct_out (
+          TRACKLIST_SELECTIONS,
+          PORT_CONNECTIONS_MGR, groups[i], NULL);
+      g_assert_true (ret);
+    }
+
+  free (groups);
+  free (fx_buses);
+
+  router_recalc_graph (ROUTER, F_NOT_SOFT);
+}
+
+/**
+ * @}
+ */
+
+#endif
@@ -39,10 +39,12 @@
 #include "utils/backtrace.h"
 #include "utils/cairo.h"
 #include "utils/datetime.h"
+#include "utils/env.h"
 #include "utils/objects.h"
 #include "utils/flags.h"
 #include "utils/io.h"
 #include "utils/log.h"
+#include "utils/rt_check.h"
 #include "utils/ui.h"
 #include "zrythm.h"
 #include "zrythm_app.h"
@@ -136,6 +138,11 @@ _test_helper_zrythm_init (
 
   LOG = log_new ();
 
+  /* check the audio threads if requested */
+  rt_check_clear ();
+  rt_check_set_enabled (
+    env_get_int (RT_CHECK_ENV, 0));
+
   ZRYTHM =
     zrythm_new (NULL, false, true, optimized);
   ZRYTHM->undo_stack_len = 64;
@@ -213,6 +220,13 @@ test_helper_zrythm_cleanup ()
   io_rmdir (ZRYTHM->testing_dir, true);
   object_free_w_func_and_null (
     zrythm_free, ZRYTHM);
+
+  /* the audio threads are stopped now */
+  rt_check_print_violations ();
+  g_assert_cmpint (
+    rt_check_get_num_violations (), ==, 0);
+  rt_check_set_enabled (false);
+
   object_free_w_func_and_null (
     log_free, LOG);
 }
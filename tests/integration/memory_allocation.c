@@ -22,11 +22,14 @@
 #include "audio/engine_dummy.h"
 #include "audio/midi_event.h"
 #include "audio/midi_track.h"
+#include "audio/supported_file.h"
 #include "audio/track.h"
+#include "audio/transport.h"
 #include "project.h"
 #include "utils/arrays.h"
 #include "utils/flags.h"
 #include "utils/io.h"
+#include "utils/rt_check.h"
 #include "zrythm.h"
 
 #include "tests/helpers/project.h"
@@ -47,6 +50,56 @@ test_memory_allocation ()
   test_helper_zrythm_cleanup ();
 }
 
+/**
+ * Verify that the graph threads don't allocate,
+ * log or lock while playing back audio.
+ */
+static void
+test_no_rt_violations_during_playback ()
+{
+  test_helper_zrythm_init ();
+
+  /* checked in test_helper_zrythm_cleanup() */
+  rt_check_set_enabled (true);
+
+  /* process the engine manually */
+  AUDIO_ENGINE->stop_dummy_audio_thread = true;
+  g_usleep (20000);
+
+  /* create audio track with region */
+  char * filepath =
+    g_build_filename (
+      TESTS_SRCDIR, "test.wav", NULL);
+  SupportedFile * file =
+    supported_file_new_from_path (filepath);
+  g_free (filepath);
+  Position pos;
+  position_set_to_bar (&pos, 1);
+  track_create_with_action (
+    TRACK_TYPE_AUDIO, NULL, file, &pos,
+    TRACKLIST->num_tracks, 1, NULL);
+  supported_file_free (file);
+
+  /* route it through an empty audio fx track */
+  track_create_with_action (
+    TRACK_TYPE_AUDIO_BUS, NULL, NULL, NULL,
+    TRACKLIST->num_tracks, 1, NULL);
+
+  transport_set_playhead_to_bar (TRANSPORT, 1);
+  transport_request_roll (TRANSPORT);
+
+  for (int i = 0; i < 200; i++)
+    {
+      engine_process (
+        AUDIO_ENGINE, AUDIO_ENGINE->block_length);
+    }
+
+  g_assert_cmpint (
+    rt_check_get_num_violations (), ==, 0);
+
+  test_helper_zrythm_cleanup ();
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -57,6 +110,9 @@ main (int argc, char *argv[])
   g_test_add_func (
     TEST_PREFIX "test memory allocation",
     (GTestFunc) test_memory_allocation);
+  g_test_add_func (
+    TEST_PREFIX "test no rt violations during playback",
+    (GTestFunc) test_no_rt_violations_during_playback);
 
   return g_test_run ();
 }
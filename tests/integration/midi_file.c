@@ -131,9 +131,9 @@ test_midi_file_playback ()
                 .g_start_frames = i,
                 .local_offset = (nframes_t) j,
                 .nframes = BUFFER_SIZE, };
+              midi_events_clear (events, F_NOT_QUEUED);
               track_fill_events (
                 track, &time_nfo, events, NULL);
-              midi_events_clear (events, true);
             }
         }
 
@@ -109,6 +109,8 @@ test_process (void)
     TRACKLIST->tracks[TRACKLIST->num_tracks - 1];
   Plugin * pl = track->channel->inserts[0];
   g_assert_true (IS_PLUGIN_AND_NONNULL (pl));
+  g_assert_cmpint (
+    pl->carla->carla_type, ==, CARLA_PLUGIN_RACK);
 
   /* stop dummy audio engine processing so we can
    * process manually */
@@ -138,6 +140,67 @@ test_process (void)
 #endif
 }
 
+/**
+ * Tests that plugins with more than 2 channels
+ * use a patchbay with all of their outputs.
+ */
+static void
+test_multichannel (void)
+{
+#if defined (HAVE_LSP_MULTISAMPLER_24_DO) && \
+  defined (HAVE_CARLA)
+
+  test_helper_zrythm_init ();
+
+  test_plugin_manager_create_tracks_from_plugin (
+    LSP_MULTISAMPLER_24_DO_BUNDLE,
+    LSP_MULTISAMPLER_24_DO_URI, true, true, 1);
+
+  Track * track =
+    TRACKLIST->tracks[TRACKLIST->num_tracks - 1];
+  Plugin * pl = track->channel->instrument;
+  g_assert_true (IS_PLUGIN_AND_NONNULL (pl));
+
+  const PluginDescriptor * descr =
+    pl->setting->descr;
+  g_assert_cmpint (descr->num_audio_outs, >, 2);
+  g_assert_cmpint (
+    pl->carla->carla_type, ==,
+    CARLA_PLUGIN_PATCHBAY64);
+  g_assert_cmpuint (
+    pl->carla->native_plugin_descriptor->audioOuts,
+    >=, (uint32_t) descr->num_audio_outs);
+
+  int num_audio_outs = 0;
+  for (int i = 0; i < pl->num_out_ports; i++)
+    {
+      if (pl->out_ports[i]->id.type == TYPE_AUDIO)
+        num_audio_outs++;
+    }
+  g_assert_cmpint (
+    num_audio_outs, ==, descr->num_audio_outs);
+
+  /* stop dummy audio engine processing so we can
+   * process manually */
+  AUDIO_ENGINE->stop_dummy_audio_thread = true;
+  g_usleep (1000000);
+
+  carla_native_plugin_process (
+    pl->carla, 0, 0, AUDIO_ENGINE->block_length);
+
+  /* the shared silent buffer must stay silent */
+  for (nframes_t i = 0;
+       i < AUDIO_ENGINE->block_length; i++)
+    {
+      g_assert_true (
+        math_floats_equal (
+          AUDIO_ENGINE->silent_buf[i], 0.f));
+    }
+
+  test_helper_zrythm_cleanup ();
+#endif
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -148,6 +211,9 @@ main (int argc, char *argv[])
   g_test_add_func (
     TEST_PREFIX "test process",
     (GTestFunc) test_process);
+  g_test_add_func (
+    TEST_PREFIX "test multichannel",
+    (GTestFunc) test_multichannel);
 #if 0
   g_test_add_func (
     TEST_PREFIX "test has custom UI",
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-test-config.h"
+
+#include "plugins/lv2/lv2_worker.h"
+#include "plugins/lv2/lv2_worker_pool.h"
+#include "plugins/lv2_plugin.h"
+#include "plugins/plugin_descriptor.h"
+#include "plugins/plugin_manager.h"
+#include "settings/plugin_settings.h"
+#include "zrythm.h"
+
+#include "tests/helpers/zrythm.h"
+
+#include <glib.h>
+
+#define NUM_PLUGINS 4
+#define NUM_REQUESTS 200
+
+/**
+ * Minimal plugin that records the order of its
+ * work and responses.
+ */
+typedef struct TestPlugin
+{
+  Plugin           pl;
+  Lv2Plugin        lv2;
+  PluginSetting    setting;
+  PluginDescriptor descr;
+  LilvInstance     instance;
+  LV2_Worker_Interface iface;
+
+  /** Number of threads running work() right
+   * now. */
+  volatile gint    num_running;
+
+  int              work[NUM_REQUESTS];
+  volatile gint    num_work;
+
+  int              responses[NUM_REQUESTS];
+  int              num_responses;
+} TestPlugin;
+
+static LV2_Worker_Status
+work (
+  LV2_Handle                  instance,
+  LV2_Worker_Respond_Function respond,
+  LV2_Worker_Respond_Handle   handle,
+  uint32_t                    size,
+  const void *                data)
+{
+  TestPlugin * self = (TestPlugin *) instance;
+
+  /* work of the same plugin must never run
+   * concurrently */
+  g_assert_cmpint (
+    g_atomic_int_add (&self->num_running, 1),
+    ==, 0);
+  g_assert_cmpuint (size, ==, sizeof (int));
+
+  int val = *(const int *) data;
+  int idx = g_atomic_int_get (&self->num_work);
+  self->work[idx] = val;
+  respond (handle, size, data);
+  g_atomic_int_inc (&self->num_work);
+
+  g_atomic_int_dec_and_test (&self->num_running);
+
+  return LV2_WORKER_SUCCESS;
+}
+
+static LV2_Worker_Status
+work_response (
+  LV2_Handle   instance,
+  uint32_t     size,
+  const void * body)
+{
+  TestPlugin * self = (TestPlugin *) instance;
+  self->responses[self->num_responses++] =
+    *(const int *) body;
+
+  return LV2_WORKER_SUCCESS;
+}
+
+static void
+init_test_plugin (
+  TestPlugin * self)
+{
+  self->descr.name = (char *) "Test worker plugin";
+  self->setting.descr = &self->descr;
+  self->pl.setting = &self->setting;
+  self->lv2.plugin = &self->pl;
+  self->lv2.worker.plugin = &self->lv2;
+  self->instance.lv2_handle = self;
+  self->lv2.instance = &self->instance;
+  self->iface.work = work;
+  self->iface.work_response = work_response;
+  zix_sem_init (&self->lv2.work_lock, 1);
+
+  lv2_worker_init (
+    &self->lv2, &self->lv2.worker, &self->iface,
+    true);
+  g_assert_true (self->lv2.worker.threaded);
+}
+
+static void
+test_work_order (void)
+{
+  test_helper_zrythm_init ();
+
+  Lv2WorkerPool * pool =
+    PLUGIN_MANAGER->lv2_worker_pool;
+  lv2_worker_pool_reset_stats (pool);
+
+  TestPlugin * plugins =
+    g_new0 (TestPlugin, NUM_PLUGINS);
+  for (int i = 0; i < NUM_PLUGINS; i++)
+    {
+      init_test_plugin (&plugins[i]);
+    }
+
+  Lv2WorkerPoolStats stats;
+  lv2_worker_pool_get_stats (pool, &stats);
+  g_assert_cmpint (stats.num_threads, >, 0);
+  g_assert_cmpint (
+    stats.num_threads, <=,
+    LV2_WORKER_POOL_MAX_THREADS);
+  g_assert_cmpint (
+    stats.num_workers, ==, NUM_PLUGINS);
+
+  /* schedule interleaved bursts like the
+   * processing threads would */
+  for (int i = 0; i < NUM_REQUESTS; i++)
+    {
+      for (int j = 0; j < NUM_PLUGINS; j++)
+        {
+          LV2_Worker_Status status =
+            lv2_worker_schedule (
+              &plugins[j].lv2.worker, sizeof (int),
+              &i);
+          g_assert_cmpint (
+            status, ==, LV2_WORKER_SUCCESS);
+        }
+
+      /* let the pool catch up so the rings
+       * don't fill up */
+      if (i % 50 == 49)
+        {
+          for (int j = 0; j < NUM_PLUGINS; j++)
+            {
+              while (g_atomic_int_get (
+                       &plugins[j].num_work) <= i)
+                {
+                  g_usleep (100);
+                }
+              lv2_worker_emit_responses (
+                &plugins[j].lv2.worker,
+                &plugins[j].instance);
+            }
+        }
+    }
+
+  for (int j = 0; j < NUM_PLUGINS; j++)
+    {
+      TestPlugin * tp = &plugins[j];
+      g_assert_cmpint (
+        tp->num_work, ==, NUM_REQUESTS);
+      g_assert_cmpint (
+        tp->num_responses, ==, NUM_REQUESTS);
+      for (int i = 0; i < NUM_REQUESTS; i++)
+        {
+          g_assert_cmpint (tp->work[i], ==, i);
+          g_assert_cmpint (tp->responses[i], ==, i);
+        }
+    }
+
+  lv2_worker_pool_get_stats (pool, &stats);
+  g_assert_cmpint (
+    stats.num_jobs, ==, NUM_PLUGINS * NUM_REQUESTS);
+  g_assert_cmpint (stats.max_busy_threads, >, 0);
+  g_assert_cmpint (
+    stats.max_busy_threads, <=, stats.num_threads);
+  g_assert_cmpint (
+    stats.min_wake_latency, <=,
+    stats.max_wake_latency);
+
+  for (int i = 0; i < NUM_PLUGINS; i++)
+    {
+      lv2_worker_finish (&plugins[i].lv2.worker);
+      zix_sem_destroy (&plugins[i].lv2.work_lock);
+    }
+  g_free (plugins);
+
+  lv2_worker_pool_get_stats (pool, &stats);
+  g_assert_cmpint (stats.num_workers, ==, 0);
+
+  test_helper_zrythm_cleanup ();
+}
+
+/**
+ * Tests that requests that are still pending when
+ * the plugin exits are dropped without running.
+ */
+static void
+test_finish_with_pending_work (void)
+{
+  test_helper_zrythm_init ();
+
+  TestPlugin * tp = g_new0 (TestPlugin, 1);
+  init_test_plugin (tp);
+
+  /* hold the work lock so the requests pile
+   * up */
+  zix_sem_wait (&tp->lv2.work_lock);
+  for (int i = 0; i < 10; i++)
+    {
+      lv2_worker_schedule (
+        &tp->lv2.worker, sizeof (int), &i);
+    }
+  tp->lv2.exit = true;
+  zix_sem_post (&tp->lv2.work_lock);
+
+  lv2_worker_finish (&tp->lv2.worker);
+  g_assert_cmpint (
+    tp->lv2.worker.num_pending, ==, 0);
+  g_assert_cmpint (tp->num_work, <=, 1);
+
+  zix_sem_destroy (&tp->lv2.work_lock);
+  g_free (tp);
+
+  test_helper_zrythm_cleanup ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+#define TEST_PREFIX "/plugins/lv2/lv2_worker_pool/"
+
+  g_test_add_func (
+    TEST_PREFIX "test work order",
+    (GTestFunc) test_work_order);
+  g_test_add_func (
+    TEST_PREFIX "test finish with pending work",
+    (GTestFunc) test_finish_with_pending_work);
+
+  return g_test_run ();
+}
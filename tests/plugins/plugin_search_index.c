@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-test-config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "plugins/collection.h"
+#include "plugins/plugin_descriptor.h"
+#include "plugins/plugin_search_index.h"
+#include "utils/string.h"
+
+#include "tests/helpers/zrythm.h"
+
+#include <glib.h>
+
+#define NUM_DESCRIPTORS 150
+
+static GPtrArray *
+create_descriptors (void)
+{
+  GPtrArray * descrs =
+    g_ptr_array_new_with_free_func (
+      (GDestroyNotify) plugin_descriptor_free);
+  for (int i = 0; i < NUM_DESCRIPTORS; i++)
+    {
+      PluginDescriptor * descr =
+        plugin_descriptor_new ();
+      if (i % 10 == 0)
+        {
+          descr->name =
+            g_strdup_printf ("Reverb Deluxe %d", i);
+          descr->author = g_strdup ("Acme");
+          descr->category = PC_REVERB;
+          descr->category_str = g_strdup ("Reverb");
+          descr->protocol = PROT_LV2;
+        }
+      else if (i % 7 == 0)
+        {
+          descr->name =
+            g_strdup_printf ("Synth %d", i);
+          descr->author = g_strdup ("Ünicode Labs");
+          descr->category = PC_INSTRUMENT;
+          descr->category_str =
+            g_strdup ("Instrument");
+          descr->protocol = PROT_VST3;
+          descr->num_midi_ins = 1;
+        }
+      else
+        {
+          descr->name =
+            g_strdup_printf ("Echo %d", i);
+          descr->author =
+            i % 2 ? g_strdup ("Other") : NULL;
+          descr->category = PC_DELAY;
+          descr->category_str = g_strdup ("Delay");
+          descr->protocol = PROT_VST;
+        }
+      descr->num_audio_outs = 2;
+      g_ptr_array_add (descrs, descr);
+    }
+
+  return descrs;
+}
+
+static bool
+matches_search (
+  PluginDescriptor * descr,
+  const char *       search)
+{
+  const char * parts[] = {
+    descr->name, descr->author,
+    descr->category_str };
+  for (size_t i = 0; i < G_N_ELEMENTS (parts); i++)
+    {
+      if (!parts[i])
+        continue;
+
+      char * part = g_utf8_casefold (parts[i], -1);
+      char * query = g_utf8_casefold (search, -1);
+      bool match = strstr (part, query) != NULL;
+      g_free (part);
+      g_free (query);
+      if (match)
+        return true;
+    }
+  return false;
+}
+
+/**
+ * Checks the index against a linear scan.
+ */
+static void
+check_filter (
+  PluginSearchIndex *        index,
+  GPtrArray *                descrs,
+  const PluginSearchFilter * filter)
+{
+  uint64_t * result =
+    plugin_search_index_new_bitset (index);
+  int count =
+    plugin_search_index_filter (
+      index, filter, result);
+
+  int expected_count = 0;
+  for (int i = 0; i < (int) descrs->len; i++)
+    {
+      PluginDescriptor * descr =
+        g_ptr_array_index (descrs, (guint) i);
+      bool visible = true;
+      if (filter->num_categories > 0)
+        {
+          bool found = false;
+          for (int j = 0;
+               j < filter->num_categories; j++)
+            {
+              if (descr->category ==
+                    filter->categories[j])
+                found = true;
+            }
+          visible = visible && found;
+        }
+      if (filter->num_authors > 0)
+        {
+          bool found = false;
+          for (int j = 0;
+               j < filter->num_authors; j++)
+            {
+              if (string_is_equal (
+                    descr->author,
+                    filter->authors[j]))
+                found = true;
+            }
+          visible = visible && found;
+        }
+      if (filter->num_protocols > 0)
+        {
+          bool found = false;
+          for (int j = 0;
+               j < filter->num_protocols; j++)
+            {
+              if (descr->protocol ==
+                    filter->protocols[j])
+                found = true;
+            }
+          visible = visible && found;
+        }
+      if (filter->types[
+            PLUGIN_SEARCH_TYPE_INSTRUMENT])
+        visible =
+          visible &&
+          plugin_descriptor_is_instrument (descr);
+      if (filter->types[PLUGIN_SEARCH_TYPE_EFFECT])
+        visible =
+          visible &&
+          plugin_descriptor_is_effect (descr);
+      if (filter->collection)
+        visible =
+          visible &&
+          plugin_collection_contains_descriptor (
+            filter->collection, descr, false);
+      if (filter->search)
+        visible =
+          visible &&
+          matches_search (descr, filter->search);
+
+      g_assert_cmpint (
+        (int)
+        plugin_search_index_bitset_get (result, i),
+        ==, visible);
+      if (visible)
+        expected_count++;
+    }
+  g_assert_cmpint (count, ==, expected_count);
+
+  free (result);
+}
+
+static void
+test_filter (void)
+{
+  GPtrArray * descrs = create_descriptors ();
+  PluginSearchIndex * index =
+    plugin_search_index_new (descrs);
+  g_assert_cmpint (
+    index->num_descriptors, ==, NUM_DESCRIPTORS);
+
+  /* no filter */
+  PluginSearchFilter filter = { 0 };
+  check_filter (index, descrs, &filter);
+
+  /* categories */
+  ZPluginCategory cats[] = {
+    PC_REVERB, PC_INSTRUMENT };
+  filter.categories = cats;
+  filter.num_categories = 2;
+  check_filter (index, descrs, &filter);
+  filter.num_categories = 0;
+
+  /* authors, including an unknown one */
+  const char * authors[] = { "Acme", "Nobody" };
+  filter.authors = authors;
+  filter.num_authors = 2;
+  check_filter (index, descrs, &filter);
+
+  /* authors and protocols */
+  PluginProtocol prots[] = { PROT_VST3 };
+  filter.protocols = prots;
+  filter.num_protocols = 1;
+  check_filter (index, descrs, &filter);
+  filter.num_authors = 0;
+  check_filter (index, descrs, &filter);
+  filter.num_protocols = 0;
+
+  /* types */
+  filter.types[PLUGIN_SEARCH_TYPE_INSTRUMENT] =
+    true;
+  check_filter (index, descrs, &filter);
+  filter.types[PLUGIN_SEARCH_TYPE_INSTRUMENT] =
+    false;
+  filter.types[PLUGIN_SEARCH_TYPE_EFFECT] = true;
+  check_filter (index, descrs, &filter);
+  filter.types[PLUGIN_SEARCH_TYPE_EFFECT] = false;
+
+  /* collection */
+  PluginCollection * collection =
+    plugin_collection_new ();
+  plugin_collection_add_descriptor (
+    collection, g_ptr_array_index (descrs, 3));
+  plugin_collection_add_descriptor (
+    collection, g_ptr_array_index (descrs, 140));
+  filter.collection = collection;
+  check_filter (index, descrs, &filter);
+  filter.collection = NULL;
+
+  /* searches of different lengths, in the name,
+   * author and category, ignoring case */
+  const char * searches[] = {
+    "e", "ec", "ECH", "echo 1", "deluxe 14",
+    "acme", "reverb", "ünicode", "ÜNI", "xyz",
+    "oche", "", "instrument" };
+  for (size_t i = 0; i < G_N_ELEMENTS (searches);
+       i++)
+    {
+      filter.search = searches[i];
+      check_filter (index, descrs, &filter);
+    }
+
+  /* search combined with other filters */
+  filter.search = "1";
+  filter.categories = cats;
+  filter.num_categories = 1;
+  check_filter (index, descrs, &filter);
+
+  plugin_collection_free (collection);
+  plugin_search_index_free (index);
+  g_ptr_array_unref (descrs);
+}
+
+static void
+test_empty (void)
+{
+  GPtrArray * descrs = g_ptr_array_new ();
+  PluginSearchIndex * index =
+    plugin_search_index_new (descrs);
+
+  PluginSearchFilter filter = {
+    .search = "test" };
+  uint64_t * result =
+    plugin_search_index_new_bitset (index);
+  g_assert_cmpint (
+    plugin_search_index_filter (
+      index, &filter, result), ==, 0);
+
+  free (result);
+  plugin_search_index_free (index);
+  g_ptr_array_unref (descrs);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+#define TEST_PREFIX "/plugins/plugin_search_index/"
+
+  g_test_add_func (
+    TEST_PREFIX "test filter",
+    (GTestFunc) test_filter);
+  g_test_add_func (
+    TEST_PREFIX "test empty",
+    (GTestFunc) test_empty);
+
+  return g_test_run ();
+}
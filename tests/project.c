@@ -19,6 +19,7 @@
 
 #include "zrythm-test-config.h"
 
+#include "actions/undo_manager.h"
 #include "audio/track.h"
 #include "audio/tempo_track.h"
 #include "project.h"
@@ -208,6 +209,57 @@ test_save_backup_w_pool ()
   test_helper_zrythm_cleanup ();
 }
 
+/**
+ * Tests that saving shares the undo history with
+ * the project and that it is saved.
+ */
+static void
+test_save_with_undo_history ()
+{
+  test_helper_zrythm_init ();
+
+  track_create_empty_at_idx_with_action (
+    TRACK_TYPE_MIDI, TRACKLIST->num_tracks, NULL);
+  track_create_empty_at_idx_with_action (
+    TRACK_TYPE_AUDIO, TRACKLIST->num_tracks, NULL);
+  UndoManager * undo_manager = UNDO_MANAGER;
+  int undo_size =
+    undo_stack_size (UNDO_MANAGER->undo_stack);
+  g_assert_cmpint (undo_size, ==, 2);
+
+  int ret =
+    project_save (
+      PROJECT, PROJECT->dir, false, false,
+      F_NO_ASYNC);
+  g_assert_cmpint (ret, ==, 0);
+
+  /* the undo manager is untouched and unlocked
+   * exactly once */
+  g_assert_true (UNDO_MANAGER == undo_manager);
+  g_assert_cmpint (
+    undo_stack_size (UNDO_MANAGER->undo_stack),
+    ==, undo_size);
+  g_assert_true (
+    zix_sem_try_wait (&UNDO_MANAGER->action_sem));
+  g_assert_false (
+    zix_sem_try_wait (&UNDO_MANAGER->action_sem));
+  zix_sem_post (&UNDO_MANAGER->action_sem);
+  undo_manager_undo (UNDO_MANAGER, NULL);
+  undo_manager_redo (UNDO_MANAGER, NULL);
+
+  /* the undo history was saved */
+  test_project_save_and_reload ();
+  g_assert_cmpint (
+    undo_stack_size (UNDO_MANAGER->undo_stack),
+    ==, undo_size);
+  undo_manager_undo (UNDO_MANAGER, NULL);
+  g_assert_cmpint (
+    undo_stack_size (UNDO_MANAGER->undo_stack),
+    ==, undo_size - 1);
+
+  test_helper_zrythm_cleanup ();
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -215,6 +267,9 @@ main (int argc, char *argv[])
 
 #define TEST_PREFIX "/project/"
 
+  g_test_add_func (
+    TEST_PREFIX "test save with undo history",
+    (GTestFunc) test_save_with_undo_history);
   g_test_add_func (
     TEST_PREFIX "test save backup w pool",
     (GTestFunc) test_save_backup_w_pool);
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-test-config.h"
+
+#include <stdlib.h>
+
+#include "utils/mpmc_queue.h"
+
+#include <glib.h>
+
+#define NUM_PRODUCERS 2
+#define NUM_CONSUMERS 2
+#define NUM_PER_PRODUCER 20000
+#define BATCH_SIZE 4
+
+static void
+test_dequeue_batch (void)
+{
+  MPMCQueue * q = mpmc_queue_new ();
+  mpmc_queue_reserve (q, 8);
+
+  for (int i = 1; i <= 5; i++)
+    {
+      mpmc_queue_push_back (
+        q, GINT_TO_POINTER (i));
+    }
+
+  /* only up to the requested number is taken */
+  void * data[16];
+  size_t num =
+    mpmc_queue_dequeue_batch (q, data, 3);
+  g_assert_cmpuint (num, ==, 3);
+  for (int i = 0; i < 3; i++)
+    {
+      g_assert_cmpint (
+        GPOINTER_TO_INT (data[i]), ==, i + 1);
+    }
+
+  /* the rest is taken even if more is
+   * requested */
+  num =
+    mpmc_queue_dequeue_batch (
+      q, data, G_N_ELEMENTS (data));
+  g_assert_cmpuint (num, ==, 2);
+  g_assert_cmpint (
+    GPOINTER_TO_INT (data[0]), ==, 4);
+  g_assert_cmpint (
+    GPOINTER_TO_INT (data[1]), ==, 5);
+
+  num =
+    mpmc_queue_dequeue_batch (
+      q, data, G_N_ELEMENTS (data));
+  g_assert_cmpuint (num, ==, 0);
+
+  /* fill the whole buffer, wrapping around */
+  void * in[8];
+  for (int i = 0; i < 8; i++)
+    {
+      in[i] = GINT_TO_POINTER (i + 10);
+    }
+  num =
+    mpmc_queue_push_back_batch (q, in, 8);
+  g_assert_cmpuint (num, ==, 8);
+
+  /* mix with single dequeues */
+  void * single;
+  g_assert_true (
+    mpmc_queue_dequeue (q, &single));
+  g_assert_cmpint (
+    GPOINTER_TO_INT (single), ==, 10);
+  num =
+    mpmc_queue_dequeue_batch (
+      q, data, G_N_ELEMENTS (data));
+  g_assert_cmpuint (num, ==, 7);
+  for (int i = 0; i < 7; i++)
+    {
+      g_assert_cmpint (
+        GPOINTER_TO_INT (data[i]), ==, i + 11);
+    }
+
+  mpmc_queue_free (q);
+}
+
+typedef struct QueueTestData
+{
+  MPMCQueue * q;
+
+  /** Index of the thread. */
+  int         idx;
+
+  /** Number of times each value was
+   * dequeued. */
+  volatile gint * counts;
+
+  volatile gint * num_dequeued;
+} QueueTestData;
+
+static void *
+produce (
+  void * data)
+{
+  QueueTestData * self = (QueueTestData *) data;
+  int start = self->idx * NUM_PER_PRODUCER;
+  for (int i = 0; i < NUM_PER_PRODUCER;
+       i += BATCH_SIZE)
+    {
+      void * in[BATCH_SIZE];
+      for (int j = 0; j < BATCH_SIZE; j++)
+        {
+          in[j] =
+            GINT_TO_POINTER (start + i + j + 1);
+        }
+      size_t num_pushed = 0;
+      while (num_pushed < BATCH_SIZE)
+        {
+          num_pushed +=
+            mpmc_queue_push_back_batch (
+              self->q, &in[num_pushed],
+              BATCH_SIZE - num_pushed);
+        }
+    }
+
+  return NULL;
+}
+
+static void *
+consume (
+  void * data)
+{
+  QueueTestData * self = (QueueTestData *) data;
+  const gint total =
+    NUM_PRODUCERS * NUM_PER_PRODUCER;
+  while (g_atomic_int_get (self->num_dequeued) <
+           total)
+    {
+      void * out[BATCH_SIZE];
+      size_t num =
+        mpmc_queue_dequeue_batch (
+          self->q, out, BATCH_SIZE);
+      for (size_t i = 0; i < num; i++)
+        {
+          g_atomic_int_inc (
+            &self->counts[
+              GPOINTER_TO_INT (out[i]) - 1]);
+        }
+      g_atomic_int_add (
+        self->num_dequeued, (gint) num);
+    }
+
+  return NULL;
+}
+
+static void
+test_batch_with_multiple_threads (void)
+{
+  const int total =
+    NUM_PRODUCERS * NUM_PER_PRODUCER;
+  MPMCQueue * q = mpmc_queue_new ();
+
+  /* large enough that the producers never find
+   * it full */
+  mpmc_queue_reserve (q, (size_t) total);
+
+  volatile gint * counts =
+    g_new0 (volatile gint, (size_t) total);
+  volatile gint num_dequeued = 0;
+
+  QueueTestData producers[NUM_PRODUCERS];
+  QueueTestData consumers[NUM_CONSUMERS];
+  GThread * threads[
+    NUM_PRODUCERS + NUM_CONSUMERS];
+  for (int i = 0; i < NUM_CONSUMERS; i++)
+    {
+      consumers[i].q = q;
+      consumers[i].idx = i;
+      consumers[i].counts = counts;
+      consumers[i].num_dequeued = &num_dequeued;
+      threads[i] =
+        g_thread_new (
+          "consumer", consume, &consumers[i]);
+    }
+  for (int i = 0; i < NUM_PRODUCERS; i++)
+    {
+      producers[i].q = q;
+      producers[i].idx = i;
+      producers[i].counts = counts;
+      producers[i].num_dequeued = &num_dequeued;
+      threads[NUM_CONSUMERS + i] =
+        g_thread_new (
+          "producer", produce, &producers[i]);
+    }
+  for (int i = 0;
+       i < NUM_PRODUCERS + NUM_CONSUMERS; i++)
+    {
+      g_thread_join (threads[i]);
+    }
+
+  /* every value was dequeued exactly once */
+  g_assert_cmpint (num_dequeued, ==, total);
+  for (int i = 0; i < total; i++)
+    {
+      g_assert_cmpint (counts[i], ==, 1);
+    }
+
+  g_free ((void *) counts);
+  mpmc_queue_free (q);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+#define TEST_PREFIX "/utils/mpmc_queue/"
+
+  g_test_add_func (
+    TEST_PREFIX "test dequeue batch",
+    (GTestFunc) test_dequeue_batch);
+  g_test_add_func (
+    TEST_PREFIX "test batch with multiple threads",
+    (GTestFunc) test_batch_with_multiple_threads);
+
+  return g_test_run ();
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2021 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of Zrythm
+ *
+ * Zrythm is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Zrythm is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Zrythm.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "zrythm-test-config.h"
+
+#include <string.h>
+
+#include "utils/thread_affinity.h"
+
+#include <glib.h>
+
+static void
+test_parse_cpu_list (void)
+{
+  int cpus[THREAD_AFFINITY_MAX_CPUS];
+
+  int num_cpus =
+    thread_affinity_parse_cpu_list (
+      "8,0-3, 10-11\n", cpus,
+      THREAD_AFFINITY_MAX_CPUS);
+  g_assert_cmpint (num_cpus, ==, 7);
+  int expected[] = { 0, 1, 2, 3, 8, 10, 11 };
+  for (int i = 0; i < num_cpus; i++)
+    {
+      g_assert_cmpint (cpus[i], ==, expected[i]);
+    }
+
+  /* duplicates are removed */
+  num_cpus =
+    thread_affinity_parse_cpu_list (
+      "2,2,1-2", cpus, THREAD_AFFINITY_MAX_CPUS);
+  g_assert_cmpint (num_cpus, ==, 2);
+  g_assert_cmpint (cpus[0], ==, 1);
+  g_assert_cmpint (cpus[1], ==, 2);
+
+  /* empty (eg, no isolated CPUs) */
+  num_cpus =
+    thread_affinity_parse_cpu_list (
+      "\n", cpus, THREAD_AFFINITY_MAX_CPUS);
+  g_assert_cmpint (num_cpus, ==, 0);
+
+  /* malformed */
+  g_assert_cmpint (
+    thread_affinity_parse_cpu_list (
+      "1-", cpus, THREAD_AFFINITY_MAX_CPUS),
+    ==, -1);
+  g_assert_cmpint (
+    thread_affinity_parse_cpu_list (
+      "3-1", cpus, THREAD_AFFINITY_MAX_CPUS),
+    ==, -1);
+  g_assert_cmpint (
+    thread_affinity_parse_cpu_list (
+      "a", cpus, THREAD_AFFINITY_MAX_CPUS),
+    ==, -1);
+}
+
+static void
+test_cpu_list_to_string (void)
+{
+  int cpus[] = { 0, 1, 2, 3, 8, 10, 11 };
+  char * str =
+    thread_affinity_cpu_list_to_string (
+      cpus, G_N_ELEMENTS (cpus));
+  g_assert_cmpstr (str, ==, "0-3,8,10-11");
+  g_free (str);
+
+  str =
+    thread_affinity_cpu_list_to_string (cpus, 0);
+  g_assert_cmpstr (str, ==, "");
+  g_free (str);
+}
+
+static void
+test_set_current_thread (void)
+{
+  g_assert_cmpint (
+    thread_affinity_get_cpus (
+      THREAD_AFFINITY_POLICY_NONE, NULL, NULL, 0),
+    ==, 0);
+
+#ifdef __linux__
+  int cpus[THREAD_AFFINITY_MAX_CPUS];
+  int num_cpus =
+    thread_affinity_get_current_thread (
+      cpus, THREAD_AFFINITY_MAX_CPUS);
+  g_assert_cmpint (num_cpus, >, 0);
+
+  /* pin to the last allowed CPU and restore */
+  int orig_cpus[THREAD_AFFINITY_MAX_CPUS];
+  memcpy (
+    orig_cpus, cpus,
+    (size_t) num_cpus * sizeof (int));
+  int cpu = cpus[num_cpus - 1];
+  g_assert_true (
+    thread_affinity_set_current_thread (&cpu, 1));
+  int new_num_cpus =
+    thread_affinity_get_current_thread (
+      cpus, THREAD_AFFINITY_MAX_CPUS);
+  g_assert_cmpint (new_num_cpus, ==, 1);
+  g_assert_cmpint (cpus[0], ==, cpu);
+
+  g_assert_true (
+    thread_affinity_set_current_thread (
+      orig_cpus, num_cpus));
+
+  /* physical cores are a subset of the CPUs */
+  num_cpus =
+    thread_affinity_get_cpus (
+      THREAD_AFFINITY_POLICY_PHYSICAL_CORES, NULL,
+      cpus, THREAD_AFFINITY_MAX_CPUS);
+  g_assert_cmpint (num_cpus, >=, 0);
+  g_assert_cmpint (
+    num_cpus, <=, (int) g_get_num_processors ());
+#endif
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+#define TEST_PREFIX "/utils/thread_affinity/"
+
+  g_test_add_func (
+    TEST_PREFIX "test parse cpu list",
+    (GTestFunc) test_parse_cpu_list);
+  g_test_add_func (
+    TEST_PREFIX "test cpu list to string",
+    (GTestFunc) test_cpu_list_to_string);
+  g_test_add_func (
+    TEST_PREFIX "test set current thread",
+    (GTestFunc) test_set_current_thread);
+
+  return g_test_run ();
+}
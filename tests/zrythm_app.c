@@ -148,6 +148,61 @@ test_project_conversion (void)
   test_helper_zrythm_cleanup ();
 }
 
+static void
+test_headless_render (void)
+{
+  if (g_test_subprocess ())
+    {
+      test_helper_zrythm_init ();
+
+      char * exe_path = NULL;
+      int dirname_length, length;
+      length =
+        wai_getExecutablePath (
+          NULL, 0, &dirname_length);
+      if (length > 0)
+      {
+        exe_path =
+          (char *) malloc ((size_t) length + 1);
+        wai_getExecutablePath (
+          exe_path, length, &dirname_length);
+        exe_path[length] = '\0';
+      }
+      g_assert_nonnull (exe_path);
+
+      char arg1[900];
+      sprintf (
+        arg1, "--render=%s/project.zpj",
+        PROJECT->dir);
+      char arg2[900];
+      sprintf (
+        arg2, "--output=%s/mixdown.wav",
+        PROJECT->dir);
+
+      /* the render creates its own instance */
+      object_free_w_func_and_null (
+        zrythm_free, ZRYTHM);
+
+      int argc = 3;
+      char * argv[] = {
+        exe_path, arg1, arg2 };
+
+      ZrythmApp * app =
+        zrythm_app_new (
+          argc, (const char **) argv);
+      g_application_run (
+        G_APPLICATION (app), argc, argv);
+
+      /* should exit before reaching here */
+      g_assert_not_reached ();
+    }
+
+  g_test_trap_subprocess (NULL, 0, 0);
+  g_test_trap_assert_passed ();
+  g_test_trap_assert_stdout ("*mixdown.wav*");
+  g_test_trap_assert_stdout ("*realtime*");
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -158,6 +213,9 @@ main (int argc, char *argv[])
   g_test_add_func (
     TEST_PREFIX "test project conversion",
     (GTestFunc) test_project_conversion);
+  g_test_add_func (
+    TEST_PREFIX "test headless render",
+    (GTestFunc) test_headless_render);
 
   return g_test_run ();
 }